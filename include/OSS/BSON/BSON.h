@@ -32,6 +32,8 @@
 #include "OSS/BSON/BSONDocument.h"
 #include "OSS/BSON/BSONIterator.h"
 #include "OSS/BSON/BSONParser.h"
+#include "OSS/BSON/BSONWriter.h"
+#include "OSS/BSON/BSONView.h"
 
 #include "OSS/build.h"
 #if ENABLE_FEATURE_ZMQ
@@ -25,7 +25,10 @@
 
 #include "OSS/BSON/BSONParser.h"
 #include "OSS/BSON/BSONDocument.h"
+#include "OSS/BSON/BSONWriter.h"
+#include "OSS/BSON/BSONView.h"
 #include "OSS/ZMQ/ZMQSocket.h"
+#include "OSS/ZMQ/ZMQPoller.h"
 
 namespace OSS {
 namespace BSON {
@@ -40,26 +43,60 @@ public:
     CONSUMER
   };
   
+  typedef boost::function<void(BSONView&)> Handler;
+  
   BSONQueue(Role role, const std::string& name);
+  BSONQueue(Role role, const std::string& name, const std::string& address);
+    /// Uses address instead of inproc://name, for example an ipc:// endpoint
+    /// shared with another daemon
   ~BSONQueue();
   bool enqueue(BSONParser& msg);
   bool dequeue(BSONParser& msg);
   bool enqueue(BSONDocument& msg);
   bool dequeue(BSONDocument& msg);
+  bool enqueue(BSONWriter& msg);
+    /// Sends a finished document.  A writer that owns its buffer hands it
+    /// over to ZMQ without a copy and starts over with a new buffer.
+  bool dequeue(BSONView& msg);
+    /// Indexes the received document in place.  The view stays valid until
+    /// the next call to dequeue().
+  bool tryDequeue(BSONView& msg);
+    /// Same as dequeue() but returns false right away if nothing is queued
+  std::size_t dequeue(const Handler& handler, std::size_t maxCount);
+    /// Drains up to maxCount queued documents without blocking.  The view
+    /// passed to handler is only valid during the call.
+  bool watch(ZMQ::ZMQPoller& poller, const Handler& handler, std::size_t batchSize = 64);
+    /// Delivers queued documents to handler from the poller's io_service
+    /// instead of a thread blocked in dequeue()
+  void unwatch(ZMQ::ZMQPoller& poller);
   const std::string& getName() const;
+  const std::string& getAddress() const;
     
 protected:
   virtual bool initSocket();
+  bool receive();
+  void onReceived(const Handler& handler, BSONView& view, zmq::message_t& cmd, zmq::message_t& data);
   Role _role;
   std::string _name;
   std::string _address;
   ZMQ::ZMQSocket* _pSocket;
+  zmq::message_t _message;
 };
 
 
 //
 // Inlines
 //
+
+inline const std::string& BSONQueue::getName() const
+{
+  return _name;
+}
+
+inline const std::string& BSONQueue::getAddress() const
+{
+  return _address;
+}
     
 } } // OSS::BSON
 
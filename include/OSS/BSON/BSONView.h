@@ -0,0 +1,133 @@
+// Library: OSS_CORE - Foundation API for SIP B2BUA
+// Copyright (c) OSS Software Solutions
+// Contributor: Joegen Baclor - mailto:joegen@ossapp.com
+//
+// Permission is hereby granted, to any person or organization
+// obtaining a copy of the software and accompanying documentation covered by
+// this license (the "Software") to use, execute, and to prepare
+// derivative works of the Software, all subject to the
+// "GNU Lesser General Public License (LGPL)".
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+// SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+// FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+
+
+#ifndef OSS_BSONVIEW_H_INCLUDED
+#define OSS_BSONVIEW_H_INCLUDED
+
+#include <string>
+#include <stdint.h>
+#include <boost/unordered_map.hpp>
+
+
+namespace OSS {
+namespace BSON {
+
+
+class BSONView
+  /// Read only view over an encoded BSON document that the caller owns.
+  /// The document is validated and indexed once by reset().  Every lookup
+  /// after that is a single hash lookup instead of the linear key search
+  /// done by BSONParser.  Keys of nested documents and arrays are indexed
+  /// with dotted paths the same way BSONParser resolves them ("a.b", "list.0").
+  ///
+  /// The view never copies the document.  The buffer must stay untouched
+  /// for as long as the view is used.
+{
+public:
+  enum
+  {
+    MAX_DEPTH = 32
+  };
+
+  struct Element
+  {
+    uint8_t type;
+    const uint8_t* value;
+    uint32_t length;
+  };
+
+  typedef boost::unordered_map<std::string, Element> Index;
+
+  BSONView();
+  BSONView(const uint8_t* data, std::size_t len);
+
+  bool reset(const uint8_t* data, std::size_t len);
+    /// Indexes a new document.  Returns false and leaves the view empty if
+    /// the document is malformed.
+
+  void clear();
+
+  bool isValid() const;
+  const uint8_t* getData() const;
+  std::size_t getDataLength() const;
+  std::size_t size() const;
+    /// Number of indexed keys including nested ones
+
+  bool hasKey(const std::string& key) const;
+  const Element* findElement(const std::string& key) const;
+
+  bool getString(const std::string& key, std::string& value) const;
+  bool getString(const std::string& key, const char*& value, std::size_t& len) const;
+    /// Points value at the string inside the document without copying it
+
+  bool getBoolean(const std::string& key, bool& value) const;
+  bool getInt32(const std::string& key, int32_t& value) const;
+  bool getInt64(const std::string& key, int64_t& value) const;
+  bool getIntptr(const std::string& key, intptr_t& value) const;
+  bool getDouble(const std::string& key, double& value) const;
+  bool getBinary(const std::string& key, const uint8_t*& data, std::size_t& len) const;
+
+protected:
+  bool indexDocument(const uint8_t* data, std::size_t len, std::string& prefix, std::size_t depth);
+
+  const uint8_t* _data;
+  std::size_t _len;
+  Index _index;
+};
+
+//
+// Inlines
+//
+
+inline bool BSONView::isValid() const
+{
+  return _data != 0;
+}
+
+inline const uint8_t* BSONView::getData() const
+{
+  return _data;
+}
+
+inline std::size_t BSONView::getDataLength() const
+{
+  return _len;
+}
+
+inline std::size_t BSONView::size() const
+{
+  return _index.size();
+}
+
+inline bool BSONView::hasKey(const std::string& key) const
+{
+  return _index.find(key) != _index.end();
+}
+
+inline const BSONView::Element* BSONView::findElement(const std::string& key) const
+{
+  Index::const_iterator iter = _index.find(key);
+  return iter != _index.end() ? &iter->second : 0;
+}
+
+} } // OSS::BSON
+
+
+#endif // OSS_BSONVIEW_H_INCLUDED
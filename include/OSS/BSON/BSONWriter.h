@@ -0,0 +1,196 @@
+// Library: OSS_CORE - Foundation API for SIP B2BUA
+// Copyright (c) OSS Software Solutions
+// Contributor: Joegen Baclor - mailto:joegen@ossapp.com
+//
+// Permission is hereby granted, to any person or organization
+// obtaining a copy of the software and accompanying documentation covered by
+// this license (the "Software") to use, execute, and to prepare
+// derivative works of the Software, all subject to the
+// "GNU Lesser General Public License (LGPL)".
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+// SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+// FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+
+
+#ifndef OSS_BSONWRITER_H_INCLUDED
+#define OSS_BSONWRITER_H_INCLUDED
+
+#include <string>
+#include <cstring>
+#include <stdint.h>
+#include <boost/noncopyable.hpp>
+
+
+namespace OSS {
+namespace BSON {
+
+
+class BSONWriter : boost::noncopyable
+  /// Encodes a BSON document directly into a buffer without going through
+  /// libbson.  The buffer is either owned by the writer (and can be released
+  /// to a ZMQ message as is), a caller owned std::string that keeps its capacity
+  /// between messages, or a fixed size arena that is never grown.
+  ///
+  /// Documents produced here are plain BSON and can be read back by BSONParser
+  /// and BSONView.
+{
+public:
+  enum
+  {
+    MAX_DEPTH = 32
+  };
+
+  BSONWriter();
+    /// Creates a writer that grows its own malloc'ed buffer
+
+  explicit BSONWriter(std::string& buffer);
+    /// Creates a writer that encodes into buffer.  The previous content of
+    /// buffer is discarded but its capacity is reused.
+
+  BSONWriter(uint8_t* buffer, std::size_t capacity);
+    /// Creates a writer that encodes into a fixed arena.  Appends that do not
+    /// fit fail and leave the writer in overflow state.
+
+  ~BSONWriter();
+
+  void reset();
+    /// Discards the current document and starts a new one in the same buffer
+
+  bool appendString(const char* key, const char* value, std::size_t len);
+  bool appendString(const std::string& key, const std::string& value);
+  bool appendBoolean(const char* key, bool value);
+  bool appendBoolean(const std::string& key, bool value);
+  bool appendInt32(const char* key, int32_t value);
+  bool appendInt32(const std::string& key, int32_t value);
+  bool appendInt64(const char* key, int64_t value);
+  bool appendInt64(const std::string& key, int64_t value);
+  bool appendIntptr(const std::string& key, intptr_t value);
+  bool appendDouble(const char* key, double value);
+  bool appendDouble(const std::string& key, double value);
+  bool appendUndefined(const std::string& key);
+  bool appendNull(const std::string& key);
+  bool appendBinary(const char* key, const uint8_t* data, std::size_t len);
+  bool appendBinary(const std::string& key, const std::string& data);
+
+  bool appendDocumentBegin(const std::string& key);
+  bool appendDocumentEnd();
+  bool appendArrayBegin(const std::string& key);
+  bool appendArrayEnd();
+
+  bool finish();
+    /// Terminates the document.  Returns false if a sub document or array
+    /// is still open or if an earlier append overflowed the arena.
+
+  bool isFinished() const;
+  bool hasOverflowed() const;
+
+  const uint8_t* getData() const;
+    /// Returns the encoded document.  Only complete after finish().
+
+  std::size_t getDataLength() const;
+
+  uint8_t* release();
+    /// Hands the finished document over to the caller who must free() it.
+    /// Only writers that own their buffer can release it.  Returns 0 otherwise.
+    /// The writer starts a new document in a fresh buffer.
+
+  bool ownsBuffer() const;
+
+protected:
+  bool beginElement(uint8_t type, const char* key, std::size_t valueLen);
+  bool beginContainer(uint8_t type, const std::string& key);
+  bool endContainer(uint8_t type);
+  bool reserve(std::size_t len);
+  void writeInt32(std::size_t offset, int32_t value);
+  void writeInt64(std::size_t offset, int64_t value);
+
+  uint8_t* _data;
+  std::size_t _size;
+  std::size_t _capacity;
+  std::string* _string;
+  bool _owned;
+  bool _overflow;
+  bool _finished;
+  std::size_t _depth;
+  std::size_t _stack[MAX_DEPTH];
+  uint8_t _types[MAX_DEPTH];
+};
+
+//
+// Inlines
+//
+
+inline bool BSONWriter::appendString(const std::string& key, const std::string& value)
+{
+  return appendString(key.c_str(), value.data(), value.size());
+}
+
+inline bool BSONWriter::appendBoolean(const std::string& key, bool value)
+{
+  return appendBoolean(key.c_str(), value);
+}
+
+inline bool BSONWriter::appendInt32(const std::string& key, int32_t value)
+{
+  return appendInt32(key.c_str(), value);
+}
+
+inline bool BSONWriter::appendInt64(const std::string& key, int64_t value)
+{
+  return appendInt64(key.c_str(), value);
+}
+
+inline bool BSONWriter::appendIntptr(const std::string& key, intptr_t value)
+{
+  if (sizeof(intptr_t) == sizeof(int32_t))
+  {
+    return appendInt32(key.c_str(), (int32_t)value);
+  }
+  return appendInt64(key.c_str(), (int64_t)value);
+}
+
+inline bool BSONWriter::appendDouble(const std::string& key, double value)
+{
+  return appendDouble(key.c_str(), value);
+}
+
+inline bool BSONWriter::appendBinary(const std::string& key, const std::string& data)
+{
+  return appendBinary(key.c_str(), (const uint8_t*)data.data(), data.size());
+}
+
+inline bool BSONWriter::isFinished() const
+{
+  return _finished;
+}
+
+inline bool BSONWriter::hasOverflowed() const
+{
+  return _overflow;
+}
+
+inline const uint8_t* BSONWriter::getData() const
+{
+  return _data;
+}
+
+inline std::size_t BSONWriter::getDataLength() const
+{
+  return _size;
+}
+
+inline bool BSONWriter::ownsBuffer() const
+{
+  return _owned;
+}
+
+} } // OSS::BSON
+
+
+#endif // OSS_BSONWRITER_H_INCLUDED
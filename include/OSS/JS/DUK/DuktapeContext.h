@@ -31,6 +31,7 @@
 #include "OSS/JS/DUK/duk_module_node.h"
 #include "OSS/UTL/Thread.h"
 #include "OSS/JS/DUK/DuktapeModule.h"
+#include "OSS/JS/JSCodeCache.h"
 
 
 namespace OSS {
@@ -59,6 +60,7 @@ public:
   int loadModule(const std::string& moduleId);
   bool evalFile(const std::string& file, FILE* foutput, FILE* ferror);
   DuktapeModule* getModule(const std::string& moduleId);
+  bool pushCompiledCode(const std::string& file, const std::string& code);
   
 
 protected:
@@ -79,6 +81,8 @@ public:
   static void deleteModule(const std::string& moduleId);
   static bool addModuleDirectory(const std::string& path);
   static bool resolvePath(const std::string& file, std::string& absolutePath);
+  static bool setCodeCacheDirectory(const std::string& path);
+  static JSCodeCache& codeCache();
   static ModuleMap _moduleMap;
   static ModuleDirectories _moduleDirectories;
   static InternalModules _internalModules;
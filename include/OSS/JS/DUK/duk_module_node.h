@@ -8,6 +8,11 @@ extern "C" {
 #endif
 extern void duk_module_node_init(duk_context *ctx);
 extern duk_ret_t duk_module_node_peval_file(duk_context *ctx, const char* filename, int main);
+#if DUK_VERSION >= 19999
+extern duk_ret_t duk_module_node_compile_source(duk_context *ctx, void *udata);
+#else
+extern duk_ret_t duk_module_node_compile_source(duk_context *ctx);
+#endif
 #ifdef __cplusplus
 }
 #endif
@@ -28,8 +28,11 @@
 #include <boost/filesystem.hpp>
 #include <boost/noncopyable.hpp>
 #include <boost/tuple/tuple.hpp>
+#include <boost/shared_ptr.hpp>
+#include <vector>
 
 #include "OSS/JS/JS.h"
+#include "OSS/JS/JSCodeCache.h"
 #include "OSS/UTL/Thread.h"
 #include "OSS/UTL/BlockingQueue.h"
 
@@ -44,8 +47,9 @@ OSS_CREATE_INLINE_EXCEPTION(JSBaseException, OSS::IOException, "Javascript SIPMe
 class OSS_API JSBase : boost::noncopyable
 {
 public:
-  JSBase(const std::string& contextName);
-    /// Create a new JSBase
+  JSBase(const std::string& contextName, std::size_t poolSize = 1);
+    /// Create a new JSBase.  poolSize is the number of independent
+    /// V8 isolates that will be created to service requests concurrently.
 
   virtual ~JSBase();
     /// Destroy the JSBase
@@ -58,6 +62,10 @@ public:
 
   bool recompile();
     /// Recompile the current active java script.
+    ///
+    /// The new script is compiled and verified in a single isolate.
+    /// The rest of the pool picks up the new script the next time
+    /// they service a request so processing never stops globally.
 
   bool processRequest(OSS_HANDLE request);
     /// Process the request
@@ -81,9 +89,75 @@ public:
     /// Set the helper scripts export. If not set, it will default to {scriptname}.detail
   
   bool callFunction(const std::string& funcName);
-    /// Call a JS funciton with zero arguments
+    /// Call a JS funciton with zero arguments.  The function is called
+    /// in every isolate of the pool so their states remain consistent.
+
+  void setPoolSize(std::size_t poolSize);
+    /// Set the number of isolates in the pool.  This must be called
+    /// prior to initialize() to take effect.
+
+  std::size_t getPoolSize() const;
+    /// Returns the number of isolates in the pool
+
+  OSS::UInt64 getScriptGeneration() const;
+    /// Returns the generation of the active script.  This is incremented
+    /// on every successful recompile()
+
+  static void countBoundaryCrossing();
+    /// Called by native functions each time a script crosses into C++.
+    /// Crossings are counted per thread for the request being processed.
+
+  static OSS::UInt64 getLastBoundaryCrossings();
+    /// Returns the number of boundary crossings made by the last request
+    /// processed by the calling thread
+
+  OSS::UInt64 getTotalBoundaryCrossings() const;
+    /// Returns the number of boundary crossings made by all requests
+
+  OSS::UInt64 getTotalProcessedRequests() const;
+    /// Returns the number of requests processed by the script
+
+  bool setCodeCacheDirectory(const std::string& codeCacheDirectory);
+    /// Set the directory where V8 pre-compilation data is persisted.
+    /// If not set, it will default to a {scriptdir}.jscache sibling of
+    /// the directory holding the script.
+
+  JSCodeCache& codeCache();
+    /// Returns the persistent code cache
 
 protected:
+  struct Isolate : boost::noncopyable
+  {
+    /// An independent V8 isolate and the context where the script
+    /// has been loaded.  Each isolate is guarded by its own mutex
+    /// so threads only contend when the entire pool is busy.
+    Isolate();
+    OSS_HANDLE isolate;
+    OSS_HANDLE context;
+    OSS_HANDLE processFunc;
+    OSS_HANDLE requestTemplate;
+    OSS_HANDLE globalTemplate;
+    OSS::UInt64 generation;
+    bool isInitialized;
+    OSS::mutex_critic_sec mutex;
+  };
+  typedef boost::shared_ptr<Isolate> IsolatePtr;
+  typedef std::vector<IsolatePtr> IsolatePool;
+
+  struct CompiledScript
+  {
+    /// Script source shared by all isolates in the pool.  preparseData
+    /// holds the V8 pre-compilation data computed by the first isolate
+    /// to compile the source so the rest of the pool can skip it.
+    /// It is also persisted in the code cache under key.
+    std::string name;
+    std::string source;
+    std::string key;
+    std::string preparseData;
+  };
+  typedef std::vector<CompiledScript> ScriptCache;
+  typedef boost::shared_ptr<ScriptCache> ScriptCachePtr;
+
   bool internalInitialize(const boost::filesystem::path& script,
     const std::string& functionName,
     void(*extensionGlobals)(OSS_HANDLE));
@@ -93,21 +167,44 @@ protected:
   bool internalProcessRequest(OSS_HANDLE request);
     /// Process the request
 
+  bool runProcessFunction(OSS_HANDLE request);
+    /// Call the process function of an isolate from the pool
+
   bool internalRecompile();
     /// Recompile the script
 
+  bool loadScriptCache(ScriptCache& cache) const;
+    /// Read the global, helper and main script sources
+
+  bool compileIsolate(Isolate& isolate, ScriptCache& cache, OSS::UInt64 generation, bool updateCache = true);
+    /// (Re)create the context of an isolate and run the cached scripts in it.
+    /// If updateCache is true, missing pre-compilation data is stored
+    /// back in the cache.  The isolate mutex must be held by the caller.
+
+  void disposeIsolate(Isolate& isolate);
+    /// Dispose the context and handles of an isolate
+
+  IsolatePtr acquireIsolate(boost::unique_lock<OSS::mutex_critic_sec>& lock);
+    /// Select an idle isolate from the pool and lock it.  If every isolate
+    /// is busy, this will block on the next isolate in round-robin order
+
   std::string _contextName;
   boost::filesystem::path _script;
   std::string _globalScriptsDirectory;
   std::string _helperScriptsDirectory;
-  OSS_HANDLE _context;
-  OSS_HANDLE _processFunc;
-  OSS_HANDLE _requestTemplate;
-  OSS_HANDLE _globalTemplate;
   bool _isInitialized;
-  static OSS::mutex _mutex;
   std::string _functionName;
   void(*_extensionGlobals)(OSS_HANDLE);
+  std::size_t _poolSize;
+  IsolatePool _pool;
+  std::size_t _nextIsolate;
+  ScriptCachePtr _scriptCache;
+  OSS::UInt64 _generation;
+  JSCodeCache _codeCache;
+  OSS::UInt64 _totalBoundaryCrossings;
+  OSS::UInt64 _totalProcessedRequests;
+  mutable OSS::mutex_critic_sec _cacheMutex;
+  OSS::mutex_critic_sec _recompileMutex;
   friend class JSWorker;
 };
 
@@ -143,6 +240,44 @@ inline void JSBase::setHelperScriptsDirectory(const std::string& helperScriptsDi
   _helperScriptsDirectory = helperScriptsDirectory;
 }
 
+inline void JSBase::setPoolSize(std::size_t poolSize)
+{
+  _poolSize = poolSize ? poolSize : 1;
+}
+
+inline std::size_t JSBase::getPoolSize() const
+{
+  return _poolSize;
+}
+
+inline OSS::UInt64 JSBase::getTotalBoundaryCrossings() const
+{
+  OSS::mutex_critic_sec_lock lock(_cacheMutex);
+  return _totalBoundaryCrossings;
+}
+
+inline OSS::UInt64 JSBase::getTotalProcessedRequests() const
+{
+  OSS::mutex_critic_sec_lock lock(_cacheMutex);
+  return _totalProcessedRequests;
+}
+
+inline JSCodeCache& JSBase::codeCache()
+{
+  return _codeCache;
+}
+
+inline bool JSBase::setCodeCacheDirectory(const std::string& codeCacheDirectory)
+{
+  return _codeCache.setDirectory(codeCacheDirectory);
+}
+
+inline OSS::UInt64 JSBase::getScriptGeneration() const
+{
+  OSS::mutex_critic_sec_lock lock(_cacheMutex);
+  return _generation;
+}
+
 } } // OSS::JS
 
 
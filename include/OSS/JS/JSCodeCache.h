@@ -0,0 +1,102 @@
+// Library: OSS_CORE - Foundation API for SIP B2BUA
+// Copyright (c) OSS Software Solutions
+// Contributor: Joegen Baclor - mailto:joegen@ossapp.com
+//
+// Permission is hereby granted, to any person or organization
+// obtaining a copy of the software and accompanying documentation covered by
+// this license (the "Software") to use, execute, and to prepare
+// derivative works of the Software, all subject to the
+// "GNU Lesser General Public License (LGPL)".
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+// SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+// FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+
+
+#ifndef OSS_JSCODECACHE_H_INCLUDED
+#define OSS_JSCODECACHE_H_INCLUDED
+
+
+#include <boost/filesystem.hpp>
+#include <boost/noncopyable.hpp>
+
+#include "OSS/OSS.h"
+#include "OSS/UTL/Thread.h"
+
+
+namespace OSS {
+namespace JS {
+
+
+class OSS_API JSCodeCache : boost::noncopyable
+{
+  /// Persistent store for compiled script data.
+  ///
+  /// Entries are keyed by the engine, the script name and an MD5 hash
+  /// of the script content so a modified script never picks up stale
+  /// bytecode.  The cache is disabled until a directory is set.
+  ///
+public:
+  JSCodeCache();
+    /// Create a disabled code cache
+
+  ~JSCodeCache();
+    /// Destroy the code cache
+
+  bool setDirectory(const boost::filesystem::path& directory);
+    /// Set the directory where compiled data is stored.
+    /// The directory is created if it does not exist.
+
+  const boost::filesystem::path& getDirectory() const;
+    /// Returns the cache directory
+
+  bool isEnabled() const;
+    /// Returns true if a cache directory has been set
+
+  bool load(const std::string& key, std::string& data) const;
+    /// Load compiled data for the key.  Returns false on a cache miss
+
+  bool store(const std::string& key, const std::string& data);
+    /// Store compiled data for the key.  The file is written to a
+    /// temporary name and renamed so concurrent readers never see
+    /// partial data.
+
+  void clear();
+    /// Remove all cached entries
+
+  static std::string createKey(const std::string& engine, const std::string& name, const std::string& source);
+    /// Create a cache key for a script
+
+  static boost::filesystem::path getDefaultDirectory(const boost::filesystem::path& scriptFile);
+    /// Returns the default cache directory for a script.  This is a sibling
+    /// of the directory containing the script, ie /etc/oss_core -> /etc/oss_core.jscache
+
+private:
+  boost::filesystem::path _directory;
+  bool _isEnabled;
+  mutable OSS::mutex_critic_sec _mutex;
+};
+
+//
+// Inlines
+//
+
+inline const boost::filesystem::path& JSCodeCache::getDirectory() const
+{
+  return _directory;
+}
+
+inline bool JSCodeCache::isEnabled() const
+{
+  return _isEnabled;
+}
+
+} } // OSS::JS
+
+#endif // OSS_JSCODECACHE_H_INCLUDED
+
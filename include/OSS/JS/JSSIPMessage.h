@@ -27,6 +27,7 @@
 
 #include "OSS/JS/JSBase.h"
 #include "OSS/SIP/SIPMessage.h"
+#include "OSS/UTL/CoreUtils.h"
 
 
 namespace OSS {
@@ -38,8 +39,10 @@ OSS_CREATE_INLINE_EXCEPTION(JSSIPMessageException, OSS::JS::JSBaseException, "Ja
 class OSS_API JSSIPMessage : public JSBase
 {
 public:
-  JSSIPMessage(const std::string& contextName);
-    /// Create a new JSSIPMessage
+  JSSIPMessage(const std::string& contextName, std::size_t poolSize = 0);
+    /// Create a new JSSIPMessage.  Requests are serviced by a pool of
+    /// poolSize independent isolates.  If poolSize is zero, one isolate
+    /// per hardware thread will be created.
 
   virtual ~JSSIPMessage();
     /// Destroy the JSSIPMessage
@@ -49,15 +52,27 @@ public:
   
   bool processRequest(OSS::OSS_HANDLE request);
 
+  void setRecordBoundaryCrossings(bool recordBoundaryCrossings);
+    /// If set, processRequest() stores the number of boundary crossings
+    /// made by the script in the js-boundary-crossings message property.
+    /// Disabled by default.  Set it before requests are processed.
+
+  bool getRecordBoundaryCrossings() const;
+    /// Returns true if boundary crossings are stored in the message
+
 protected:
   virtual void initGlobalFuncs(OSS_HANDLE objectTemplate);
     /// Initialize global functions that will be exposed to the java script engine
+
+  bool _recordBoundaryCrossings;
 };
 
 //
 // Inlines
 //
-inline JSSIPMessage::JSSIPMessage(const std::string& contextName) : JSBase(contextName)
+inline JSSIPMessage::JSSIPMessage(const std::string& contextName, std::size_t poolSize) : 
+  JSBase(contextName, poolSize ? poolSize : boost::thread::hardware_concurrency()),
+  _recordBoundaryCrossings(false)
 {
 }
 
@@ -67,7 +82,12 @@ inline JSSIPMessage::~JSSIPMessage()
 
 inline bool JSSIPMessage::processRequest(const OSS::SIP::SIPMessage::Ptr& request)
 {
-  return JSBase::processRequest((OSS_HANDLE)request.get());
+  bool ok = JSBase::processRequest((OSS_HANDLE)request.get());
+  if (_recordBoundaryCrossings)
+  {
+    request->setProperty("js-boundary-crossings", OSS::string_from_number(JSBase::getLastBoundaryCrossings()));
+  }
+  return ok;
 }
 
 inline bool JSSIPMessage::processRequest(OSS::OSS_HANDLE request)
@@ -75,6 +95,16 @@ inline bool JSSIPMessage::processRequest(OSS::OSS_HANDLE request)
   return JSBase::processRequest(request);
 }
 
+inline void JSSIPMessage::setRecordBoundaryCrossings(bool recordBoundaryCrossings)
+{
+  _recordBoundaryCrossings = recordBoundaryCrossings;
+}
+
+inline bool JSSIPMessage::getRecordBoundaryCrossings() const
+{
+  return _recordBoundaryCrossings;
+}
+
 } } //const JSSIPMessage& msg OSS::JS
 
 
@@ -24,8 +24,13 @@
 #include "OSS/OSS.h"
 #include "OSS/UTL/Thread.h"
 #include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/function.hpp>
+#include <boost/thread/condition_variable.hpp>
 #include <string>
+#include <vector>
 #include <ostream>
+#include <cstring>
 
 
 namespace OSS {
@@ -33,6 +38,7 @@ namespace LMDB {
 
   
 #define LMDB_SIZE_MB 50
+#define LMDB_MAX_READERS 126
 
 class LMDatabase : boost::noncopyable
 {
@@ -43,20 +49,31 @@ public:
     {
       size_mb = LMDB_SIZE_MB;
       env_flags = 0;
+      max_readers = LMDB_MAX_READERS;
     }
     
     std::size_t size_mb;
     std::string name;
     std::string path;
     int env_flags;
+    unsigned int max_readers; /// Upper bound of concurrent read-only transactions
+  };
+  
+  enum TransactionMode
+  {
+    READ_WRITE, /// Serialized with every other read-write transaction
+    READ_ONLY   /// Snapshot read that runs concurrently with everything else
   };
   
   class Transaction : boost::noncopyable
   {
   public:
-    Transaction(LMDatabase* db);
+    Transaction(LMDatabase* db, TransactionMode mode = READ_WRITE);
     ~Transaction();
     
+    inline TransactionMode mode() const { return _mode; }
+    inline bool isReadOnly() const { return _mode == READ_ONLY; }
+    
     inline LMDatabase* db() { return _db; }
     inline void* transaction() { return _transaction; };
     inline bool& cancelAdvised() { return _cancelAdvised; };
@@ -69,11 +86,42 @@ public:
     void cancel();
   private:
     LMDatabase* _db;
+    TransactionMode _mode;
     void* _transaction;
     bool _cancelAdvised;
     int _lastError;
   };
   
+  class View
+    /// Points at a key or value inside the memory map.  Nothing is copied.
+    /// A view stays valid until the transaction that produced it ends or
+    /// writes to the database.
+  {
+  public:
+    View();
+    View(const char* data, std::size_t size);
+    explicit View(const std::string& str);
+    
+    const char* data() const;
+    std::size_t size() const;
+    bool empty() const;
+    
+    std::string str() const;
+      /// Returns a copy that outlives the transaction
+    
+    int compare(const View& other) const;
+      /// Byte-wise comparison, the same order LMDB keeps keys in
+    
+    bool startsWith(const View& prefix) const;
+    
+  private:
+    const char* _data;
+    std::size_t _size;
+  };
+  
+  typedef boost::function<bool(const View& /*key*/, const View& /*value*/)> Visitor;
+    /// Called for every record of a scan.  Return false to stop the scan.
+  
   class TransactionLock : boost::noncopyable
   {
   public:
@@ -94,20 +142,27 @@ public:
     
     bool top();
     bool find(const std::string& key);
+    bool seek(const std::string& key);
+      /// Positions the cursor at the first key equal to or greater than key
     bool next();
+    bool prev();
     bool bottom();
     std::string value() const;
     std::string key() const;
+    const View& valueView() const;
+    const View& keyView() const;
+      /// Zero-copy access to the current record.  See View for lifetime.
     void destroy();
     
   protected:
     friend class LMDatabase;
     bool create(LMDatabase* db, LMDatabase::Transaction* transaction);
+    bool move(int op);
     void* _cursor;
     LMDatabase* _db;
 
-    std::string _key;
-    std::string _value;    
+    View _key;
+    View _value;
   };
   
   LMDatabase();
@@ -130,6 +185,7 @@ public:
   bool get(Transaction& transaction, const std::string& key, int32_t& value);
   bool get(Transaction& transaction, const std::string& key, int64_t& value);
   bool get(Transaction& transaction, const std::string& key, void** value, std::size_t& len);
+  bool get(Transaction& transaction, const std::string& key, View& value);
   
   bool del(Transaction& transaction, const std::string& key);
   
@@ -143,15 +199,107 @@ public:
 
   bool createCursor(Transaction& transaction, Cursor& cursor);
   
+  std::size_t scanPrefix(Transaction& transaction, const std::string& prefix, const Visitor& visitor);
+    /// Visits every record whose key starts with prefix in key order.
+    /// Returns the number of records visited.
+  
+  std::size_t scanRange(Transaction& transaction, const std::string& first, const std::string& last, const Visitor& visitor);
+    /// Visits records with first <= key < last in key order.  An empty last
+    /// scans to the end of the database.  Returns the number of records visited.
+  
+  //
+  // Fixed-width big-endian key encodings.  Keys are compared byte by byte
+  // so numbers only sort by value when encoded this way.  Signed values
+  // have their sign bit flipped so negative numbers sort first.  The
+  // append functions build composite keys such as prefix + number.
+  //
+  static std::string encodeUInt32(OSS::UInt32 value);
+  static std::string encodeInt32(OSS::Int32 value);
+  static std::string encodeUInt64(OSS::UInt64 value);
+  static std::string encodeInt64(OSS::Int64 value);
+  static void appendUInt32(std::string& key, OSS::UInt32 value);
+  static void appendInt32(std::string& key, OSS::Int32 value);
+  static void appendUInt64(std::string& key, OSS::UInt64 value);
+  static void appendInt64(std::string& key, OSS::Int64 value);
+  static bool decodeUInt32(const View& key, OSS::UInt32& value, std::size_t offset = 0);
+  static bool decodeInt32(const View& key, OSS::Int32& value, std::size_t offset = 0);
+  static bool decodeUInt64(const View& key, OSS::UInt64& value, std::size_t offset = 0);
+  static bool decodeInt64(const View& key, OSS::Int64& value, std::size_t offset = 0);
+    /// Decodes the number stored at offset.  Returns false if key is too short.
+  
+  bool batchSet(const std::string& key, const std::string& value);
+  bool batchDel(const std::string& key);
+    /// Group commit.  Writes from concurrent callers are coalesced into a
+    /// single read-write transaction.  The caller blocks until the
+    /// transaction holding its write has been committed and gets the
+    /// result of that commit.  A failed write aborts every write of its
+    /// group.  Deleting a key that does not exist is not an error.
+  
+  OSS::UInt64 getBatchCommitCount() const;
+    /// Returns the number of transactions committed by batchSet() and batchDel()
+  
+  OSS::UInt64 getBatchedWriteCount() const;
+    /// Returns the number of writes committed by batchSet() and batchDel()
+  
 protected:
   friend class Transaction;
   friend class TransactionLock;
   friend class Cursor;
+  
+  enum
+  {
+    READER_SHARDS = 16
+  };
+  
+  struct ReaderShard
+  {
+    OSS::mutex_critic_sec mutex;
+    std::vector<void*> transactions;
+  };
+  
+  struct BatchWrite
+  {
+    const std::string* key;
+    const std::string* value; /// null for a delete
+  };
+  
+  struct WriteBatch
+  {
+    WriteBatch() : done(false), ok(false) {}
+    std::vector<BatchWrite> writes;
+    bool done;
+    bool ok;
+  };
+  typedef boost::shared_ptr<WriteBatch> WriteBatchPtr;
+  
+  void* acquireReader();
+  void releaseReader(void* transaction);
+  bool batchWrite(const BatchWrite& write);
+  bool commitBatch(WriteBatch& batch);
+  
   void* _env;
   void* _db;
   Options _opt;
   OSS::mutex _mutex;
   bool _stopped;
+  
+  //
+  // Reset read-only transactions waiting to be renewed.  Threads are
+  // spread over the shards so a thread normally gets back the transaction
+  // it used last without contending with other readers.
+  //
+  ReaderShard _readers[READER_SHARDS];
+  volatile int _activeReaders;
+  
+  //
+  // Group commit state
+  //
+  OSS::mutex_critic_sec _batchMutex;
+  boost::condition_variable _batchCondition;
+  WriteBatchPtr _pendingBatch;
+  bool _batchLeader;
+  OSS::UInt64 _batchCommitCount;
+  OSS::UInt64 _batchedWriteCount;
 };
   
 //
@@ -163,6 +311,212 @@ inline const LMDatabase::Options& LMDatabase::opt() const
   return _opt;
 }
 
+inline LMDatabase::View::View() :
+  _data(0),
+  _size(0)
+{
+}
+
+inline LMDatabase::View::View(const char* data, std::size_t size) :
+  _data(data),
+  _size(size)
+{
+}
+
+inline LMDatabase::View::View(const std::string& str) :
+  _data(str.data()),
+  _size(str.size())
+{
+}
+
+inline const char* LMDatabase::View::data() const
+{
+  return _data;
+}
+
+inline std::size_t LMDatabase::View::size() const
+{
+  return _size;
+}
+
+inline bool LMDatabase::View::empty() const
+{
+  return _size == 0;
+}
+
+inline std::string LMDatabase::View::str() const
+{
+  return _size ? std::string(_data, _size) : std::string();
+}
+
+inline int LMDatabase::View::compare(const View& other) const
+{
+  std::size_t len = _size < other._size ? _size : other._size;
+  int ret = len ? memcmp(_data, other._data, len) : 0;
+  if (ret == 0 && _size != other._size)
+  {
+    ret = _size < other._size ? -1 : 1;
+  }
+  return ret;
+}
+
+inline bool LMDatabase::View::startsWith(const View& prefix) const
+{
+  return _size >= prefix._size && (!prefix._size || memcmp(_data, prefix._data, prefix._size) == 0);
+}
+
+inline const LMDatabase::View& LMDatabase::Cursor::valueView() const
+{
+  return _value;
+}
+
+inline const LMDatabase::View& LMDatabase::Cursor::keyView() const
+{
+  return _key;
+}
+
+inline std::string LMDatabase::Cursor::value() const
+{
+  return _value.str();
+}
+
+inline std::string LMDatabase::Cursor::key() const
+{
+  return _key.str();
+}
+
+inline std::string LMDatabase::encodeUInt32(OSS::UInt32 value)
+{
+  std::string key;
+  appendUInt32(key, value);
+  return key;
+}
+
+inline std::string LMDatabase::encodeInt32(OSS::Int32 value)
+{
+  std::string key;
+  appendInt32(key, value);
+  return key;
+}
+
+inline std::string LMDatabase::encodeUInt64(OSS::UInt64 value)
+{
+  std::string key;
+  appendUInt64(key, value);
+  return key;
+}
+
+inline std::string LMDatabase::encodeInt64(OSS::Int64 value)
+{
+  std::string key;
+  appendInt64(key, value);
+  return key;
+}
+
+inline void LMDatabase::appendUInt32(std::string& key, OSS::UInt32 value)
+{
+  char buf[4];
+  for (int i = 3; i >= 0; i--, value >>= 8)
+  {
+    buf[i] = (char)(value & 0xFF);
+  }
+  key.append(buf, sizeof(buf));
+}
+
+inline void LMDatabase::appendInt32(std::string& key, OSS::Int32 value)
+{
+  appendUInt32(key, (OSS::UInt32)value ^ 0x80000000U);
+}
+
+inline void LMDatabase::appendUInt64(std::string& key, OSS::UInt64 value)
+{
+  char buf[8];
+  for (int i = 7; i >= 0; i--, value >>= 8)
+  {
+    buf[i] = (char)(value & 0xFF);
+  }
+  key.append(buf, sizeof(buf));
+}
+
+inline void LMDatabase::appendInt64(std::string& key, OSS::Int64 value)
+{
+  appendUInt64(key, (OSS::UInt64)value ^ 0x8000000000000000ULL);
+}
+
+inline bool LMDatabase::decodeUInt32(const View& key, OSS::UInt32& value, std::size_t offset)
+{
+  if (key.size() < offset + 4)
+  {
+    return false;
+  }
+  const unsigned char* buf = (const unsigned char*)key.data() + offset;
+  value = 0;
+  for (int i = 0; i < 4; i++)
+  {
+    value = (value << 8) | buf[i];
+  }
+  return true;
+}
+
+inline bool LMDatabase::decodeInt32(const View& key, OSS::Int32& value, std::size_t offset)
+{
+  OSS::UInt32 encoded = 0;
+  if (!decodeUInt32(key, encoded, offset))
+  {
+    return false;
+  }
+  value = (OSS::Int32)(encoded ^ 0x80000000U);
+  return true;
+}
+
+inline bool LMDatabase::decodeUInt64(const View& key, OSS::UInt64& value, std::size_t offset)
+{
+  if (key.size() < offset + 8)
+  {
+    return false;
+  }
+  const unsigned char* buf = (const unsigned char*)key.data() + offset;
+  value = 0;
+  for (int i = 0; i < 8; i++)
+  {
+    value = (value << 8) | buf[i];
+  }
+  return true;
+}
+
+inline bool LMDatabase::decodeInt64(const View& key, OSS::Int64& value, std::size_t offset)
+{
+  OSS::UInt64 encoded = 0;
+  if (!decodeUInt64(key, encoded, offset))
+  {
+    return false;
+  }
+  value = (OSS::Int64)(encoded ^ 0x8000000000000000ULL);
+  return true;
+}
+
+inline OSS::UInt64 LMDatabase::getBatchCommitCount() const
+{
+  return _batchCommitCount;
+}
+
+inline OSS::UInt64 LMDatabase::getBatchedWriteCount() const
+{
+  return _batchedWriteCount;
+}
+
+inline bool LMDatabase::batchSet(const std::string& key, const std::string& value)
+{
+  BatchWrite write = { &key, &value };
+  return batchWrite(write);
+}
+
+inline bool LMDatabase::batchDel(const std::string& key)
+{
+  BatchWrite write = { &key, 0 };
+  return batchWrite(write);
+}
+
 inline bool LMDatabase::set(Transaction& transaction, const std::string& key, const std::string& value)
 {
   return set(transaction, key, (void*)value.data(), value.size());
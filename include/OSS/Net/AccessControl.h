@@ -31,6 +31,9 @@
 #include <boost/date_time/posix_time/posix_time.hpp>
 #include <boost/function.hpp>
 
+#include "OSS/Net/PrefixTrie.h"
+#include "OSS/Net/SourceRateTable.h"
+
 
 namespace OSS {
 namespace Net {
@@ -53,7 +56,6 @@ public:
   typedef std::set<std::string> NetworkWhiteList;
   typedef std::set<boost::asio::ip::address> IPBlackList;
   typedef std::set<boost::asio::ip::address> IPWhiteList;
-  typedef std::map<boost::asio::ip::address, unsigned int> PacketCounter;
   
   AccessControl();
   
@@ -82,6 +84,10 @@ public:
   void setThresholdViolationRate(unsigned long threshold);
 
   unsigned long getCurrentIterationCount() const;
+    /// Returns the number of packets logged in the current one second window
+
+  std::size_t getTrackedSourceCount() const;
+    /// Returns the number of sources with a live rate bucket
 
   bool& autoBanThresholdViolators();
 
@@ -94,6 +100,9 @@ public:
   void whiteListAddress(const boost::asio::ip::address& address, bool removeFromBlackList = true);
   void whiteListAddress(const std::string& address, bool removeFromBlackList = true);
   void whiteListNetwork(const std::string& network);
+  void whiteListNetworks(const NetworkWhiteList& networks);
+    /// Adds all networks and rebuilds the lookup trie once.  Use this
+    /// instead of repeated whiteListNetwork() calls when loading a config.
   bool isWhiteListed(const boost::asio::ip::address& address) const;
   bool isWhiteListed(const std::string& address) const;
   bool isWhiteListedNetwork(const boost::asio::ip::address& address) const;
@@ -105,6 +114,8 @@ public:
   void blackListAddress(const boost::asio::ip::address& address, bool removeFromWhiteList = true);
   void blackListAddress(const std::string& address, bool removeFromWhiteList = true);
   void blackListNetwork(const std::string& network);
+  void blackListNetworks(const NetworkBlackList& networks);
+    /// Adds all networks and rebuilds the lookup trie once
   bool isBlackListed(const boost::asio::ip::address& address) const;
   bool isBlackListed(const std::string& address) const;
   bool isBlackListedNetwork(const boost::asio::ip::address& address) const;
@@ -128,20 +139,28 @@ public:
   void setAutoNullRoute(bool autoNullRoute);
   
 private:
+  typedef boost::shared_ptr<const PrefixTrie> PrefixTriePtr;
+  void rebuildNetworkWhiteList();
+  void rebuildNetworkBlackList();
+  static PrefixTriePtr buildNetworkTrie(const std::set<std::string>& networks);
+
   bool _enabled;
   unsigned long _packetsPerSecondThreshold;
   unsigned long _thresholdViolationRate;
-  unsigned long _currentIterationCount;
+  volatile unsigned long _currentIterationCount;
   bool _autoBanThresholdViolators;
   int _banLifeTime;
   mutable boost::recursive_mutex _packetCounterMutex;
-  std::map<boost::asio::ip::address, unsigned int> _packetCounter;
+  SourceRateTable _sourceRates;
+  volatile unsigned long long _windowStart;
+  unsigned _evictShard;
   IPWhiteList _whiteList;
   NetworkWhiteList _networkWhiteList;
   IPBlackList _blackList;
   NetworkBlackList _networkBlackList;
+  PrefixTriePtr _networkWhiteListTrie;
+  PrefixTriePtr _networkBlackListTrie;
   BannedSources _banned;
-  boost::posix_time::ptime _lastTime;
   bool _denyAllIncoming;
   BanCallback _banCallback;
   bool _autoNullRoute;
@@ -179,6 +198,12 @@ inline unsigned long AccessControl::getCurrentIterationCount() const
 inline void AccessControl::setThresholdViolationRate(unsigned long threshold)
 {
   _thresholdViolationRate = threshold;
+  _sourceRates.setRate(threshold, threshold);
+}
+
+inline std::size_t AccessControl::getTrackedSourceCount() const
+{
+  return _sourceRates.size();
 }
 
 inline bool& AccessControl::autoBanThresholdViolators()
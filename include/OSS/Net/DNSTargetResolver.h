@@ -0,0 +1,240 @@
+// Library: OSS_CORE - Foundation API for SIP B2BUA
+// Copyright (c) OSS Software Solutions
+// Contributor: Joegen Baclor - mailto:joegen@ossapp.com
+//
+// Permission is hereby granted, to any person or organization
+// obtaining a copy of the software and accompanying documentation covered by
+// this license (the "Software") to use, execute, and to prepare
+// derivative works of the Software, all subject to the
+// "GNU Lesser General Public License (LGPL)".
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+// SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+// FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+
+
+#ifndef OSS_DNSTARGETRESOLVER_H_INCLUDED
+#define	OSS_DNSTARGETRESOLVER_H_INCLUDED
+
+
+#include <map>
+#include <string>
+#include <vector>
+#include <boost/noncopyable.hpp>
+#include <boost/function.hpp>
+#include <boost/thread.hpp>
+#include "OSS/OSS.h"
+#include "OSS/Net/DNS.h"
+
+
+struct dns_query;
+
+namespace udnspp {
+  class DNSContext;
+}
+
+
+namespace OSS {
+namespace Net {
+
+
+class OSS_API DNSTargetResolver : boost::noncopyable
+  ///
+  /// Asynchronous resolver for RFC 3263 target resolution.
+  ///
+  /// Queries are submitted to a udns context owned by the resolver and
+  /// answered from a dedicated event thread, so a lookup never blocks the
+  /// caller.  Follow-up queries are issued as soon as the answer they depend
+  /// on arrives.  The A and AAAA records of a host and the addresses of all
+  /// SRV targets are queried in parallel.
+  ///
+  /// Every answer is cached for its record TTL.  Negative answers are cached
+  /// for the negative TTL and failed queries for the failure TTL.  A query
+  /// for a name and type that is already on the wire is not sent again.  The
+  /// caller is added to the waiters of the outstanding query instead.
+  ///
+  /// Callbacks run on the resolver thread, or on the calling thread if the
+  /// answer is cached.  They must not block.
+  ///
+{
+public:
+  enum RecordType
+  {
+    TYPE_A = 1,
+    TYPE_AAAA = 28,
+    TYPE_SRV = 33,
+    TYPE_NAPTR = 35
+  };
+
+  enum
+  {
+    DEFAULT_NEGATIVE_TTL = 60, /// seconds
+    DEFAULT_FAILURE_TTL = 5, /// seconds
+    DEFAULT_MAX_TTL = 86400, /// seconds
+    DEFAULT_MAX_CACHE_SIZE = 8192,
+    DEFAULT_SYNC_TIMEOUT = 10000 /// milliseconds
+  };
+
+  struct Record
+  {
+    std::string target; /// Address for A and AAAA, target for SRV, replacement for NAPTR
+    unsigned short port; /// SRV
+    unsigned short priority; /// SRV priority or NAPTR order
+    unsigned short weight; /// SRV weight or NAPTR preference
+    std::string flags; /// NAPTR
+    std::string service; /// NAPTR
+    Record() : port(0), priority(0), weight(0) {}
+  };
+  typedef std::vector<Record> Records;
+
+  struct Target
+  {
+    std::string transport; /// udp, tcp, tls or ws
+    std::string host;
+    std::string address;
+    unsigned short port;
+    unsigned short priority;
+    unsigned short weight;
+    Target() : port(0), priority(0), weight(0) {}
+  };
+  typedef std::vector<Target> Targets;
+
+  typedef boost::function<void(const Records&)> RecordsCallback;
+  typedef boost::function<void(const dns_host_record_list&)> HostCallback;
+  typedef boost::function<void(const dns_srv_record_list&)> SRVCallback;
+  typedef boost::function<void(const Targets&)> TargetsCallback;
+
+  DNSTargetResolver();
+
+  ~DNSTargetResolver();
+
+  static DNSTargetResolver& instance();
+    /// Returns the resolver used by dns_lookup_host() and dns_lookup_srv()
+
+  bool setNameServer(const std::string& address, unsigned short port = 53);
+    /// Replace the name servers from resolv.conf.  Must be called before start().
+
+  void setNegativeTTL(unsigned int seconds);
+    /// How long NXDOMAIN and empty answers are cached
+
+  void setFailureTTL(unsigned int seconds);
+    /// How long timeouts and server failures are cached
+
+  void setMaxTTL(unsigned int seconds);
+    /// Upper bound for the TTL of positive answers
+
+  bool start();
+    /// Open the resolver socket and start the event thread
+
+  void stop();
+    /// Stop the event thread.  Outstanding queries complete with no records.
+
+  bool isRunning() const;
+
+  void lookup(RecordType type, const std::string& name, const RecordsCallback& cb);
+    /// Query a single record set
+
+  void resolveHost(const std::string& host, const HostCallback& cb);
+    /// Query A and AAAA records in parallel.  IPv4 addresses come first.
+
+  void resolveSRV(const std::string& name, const SRVCallback& cb);
+    /// Query SRV records and the addresses of every target in parallel
+
+  void resolveTargets(const std::string& domain, const std::string& transport, bool secure, const TargetsCallback& cb);
+    /// RFC 3263 NAPTR, SRV, A/AAAA resolution of a domain without an
+    /// explicit port.  transport may be empty to let NAPTR pick one.
+    /// Targets are returned in the order they should be tried.
+
+  dns_host_record_list resolveHost(const std::string& host, unsigned int timeout = DEFAULT_SYNC_TIMEOUT);
+  dns_srv_record_list resolveSRV(const std::string& name, unsigned int timeout = DEFAULT_SYNC_TIMEOUT);
+  Targets resolveTargets(const std::string& domain, const std::string& transport, bool secure, unsigned int timeout = DEFAULT_SYNC_TIMEOUT);
+    /// Blocking variants.  They return whatever is known once timeout
+    /// milliseconds have elapsed.
+
+  void flushCache();
+    /// Drop every cached answer
+
+  std::size_t getCacheSize() const;
+
+  OSS::UInt64 getQueryCount() const;
+    /// Returns the number of queries submitted to the name servers
+
+  OSS::UInt64 getCacheHitCount() const;
+    /// Returns the number of lookups answered from the cache
+
+  OSS::UInt64 getCoalescedCount() const;
+    /// Returns the number of lookups that joined a query already on the wire
+
+  //
+  // Called from the udns callbacks
+  //
+  void onQueryComplete(const std::string& key, const Records& records, unsigned int ttl, int status);
+
+private:
+  struct CacheEntry
+  {
+    Records records;
+    OSS::UInt64 expires;
+  };
+  typedef std::map<std::string, CacheEntry> Cache;
+  struct PendingQuery
+  {
+    std::vector<RecordsCallback> waiters;
+    dns_query* query;
+    void* data;
+  };
+  typedef std::map<std::string, PendingQuery> Pending;
+
+  void submit(RecordType type, const std::string& name, const std::string& key);
+  void run();
+
+  udnspp::DNSContext* _pContext;
+  mutable boost::recursive_mutex _contextMutex;
+  mutable boost::mutex _cacheMutex;
+  Cache _cache;
+  Pending _pending;
+  boost::thread* _pThread;
+  volatile bool _isRunning;
+  unsigned int _negativeTTL;
+  unsigned int _failureTTL;
+  unsigned int _maxTTL;
+  std::size_t _maxCacheSize;
+  OSS::UInt64 _queryCount;
+  OSS::UInt64 _cacheHitCount;
+  OSS::UInt64 _coalescedCount;
+};
+
+//
+// Inlines
+//
+
+inline void DNSTargetResolver::setNegativeTTL(unsigned int seconds)
+{
+  _negativeTTL = seconds;
+}
+
+inline void DNSTargetResolver::setFailureTTL(unsigned int seconds)
+{
+  _failureTTL = seconds;
+}
+
+inline void DNSTargetResolver::setMaxTTL(unsigned int seconds)
+{
+  _maxTTL = seconds;
+}
+
+inline bool DNSTargetResolver::isRunning() const
+{
+  return _isRunning;
+}
+
+
+} } // OSS::Net
+
+
+#endif	/* OSS_DNSTARGETRESOLVER_H_INCLUDED */
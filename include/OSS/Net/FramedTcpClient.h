@@ -26,9 +26,13 @@ public:
   ~FramedTcpClient();
   bool connect(const std::string& serviceAddress, const std::string& servicePort);
   bool sendAndReceive(const std::string& data, std::string& response);
+  bool send(const std::string& data);
+    /// Sends a frame without waiting for a response.  For peers that answer
+    /// on a connection of their own.
+  void close();
   bool isConnected() const;
 private:
-  short getNextReadSize();
+  bool getNextReadSize(std::size_t& size);
   boost::asio::io_service& _ioService;
   boost::asio::ip::tcp::resolver _resolver;
   boost::asio::ip::tcp::socket *_pSocket;
@@ -21,6 +21,16 @@ class FramedTcpListener;
 #define FTCP_VERSION 1
 #define FTCP_KEY 22172
 #define FTCP_READ_BUFFER_SIZE 8192
+#define FTCP_HEADER_SIZE 6
+#define FTCP_EXTENDED_LENGTH -1
+#define FTCP_MAX_PACKET_SIZE 0x1000000
+
+//
+// A frame is the version, the key and the length of the data as shorts
+// followed by the data.  Frames bigger than a short can describe set the
+// length to FTCP_EXTENDED_LENGTH and put the real length in the 32 bits
+// that follow it.
+//
 
 class FramedTcpConnection : public boost::enable_shared_from_this<FramedTcpConnection>, boost::noncopyable
 {
@@ -46,6 +56,10 @@ public:
   bool write(const std::string& data);
   boost::asio::ip::tcp::socket& socket();
 
+  static bool encodeFrame(const std::string& data, std::string& packet);
+    /// Prepends the frame header to data.  Returns false if data is larger
+    /// than FTCP_MAX_PACKET_SIZE.
+
   const std::string& getLocalAddress() const;
   unsigned short getLocalPort() const;
   const std::string& getRemoteAddress() const;
@@ -53,7 +67,7 @@ public:
   const std::string& getApplicationId() const;
   void setApplicationId(const std::string& id);
 protected:
-  void readMore(std::size_t bytes_transferred);
+  bool readMore(std::size_t bytes_transferred);
   void startInactivityTimer();
   void onInactivityTimeout(const boost::system::error_code&);
   boost::asio::io_service& _ioService;
@@ -63,7 +77,7 @@ protected:
   boost::array<char, 8192> _buffer;
 
   std::string _messageBuffer;
-  std::string _spillOverBuffer;
+  boost::mutex _writeMutex;
   std::size_t _moreReadRequired;
   std::size_t _lastExpectedPacketSize;
   std::string _localAddress;
@@ -19,8 +19,13 @@ public:
   typedef boost::recursive_mutex mutex;
   typedef boost::lock_guard<mutex> mutex_lock;
   FramedTcpListener();
-  ~FramedTcpListener();
+  virtual ~FramedTcpListener();
   void run(const std::string& address, const std::string& port);
+    /// Starts accepting connections.  Whoever owns the listener runs its
+    /// io service.
+  void stop();
+    /// Stops accepting and closes every connection
+  boost::asio::io_service& ioService();
   void handleAccept(const boost::system::error_code& e);
   
   void addConnection(FramedTcpConnection::Ptr conn);
@@ -29,7 +34,7 @@ public:
   void setInactivityThreshold(int threshold);
   int getInactivityThreshold() const;
 
-  void onIncomingRequest(FramedTcpConnection& connection, const char* data, std::size_t len);
+  virtual void onIncomingRequest(FramedTcpConnection& connection, const char* data, std::size_t len);
 
 protected:
   boost::asio::io_service _ioService;
@@ -55,6 +60,11 @@ inline int FramedTcpListener::getInactivityThreshold() const
   return _inactivityThreashold;
 }
 
+inline boost::asio::io_service& FramedTcpListener::ioService()
+{
+  return _ioService;
+}
+
 } // OSS
 
 
@@ -0,0 +1,133 @@
+// Library: OSS_CORE - Foundation API for SIP B2BUA
+// Copyright (c) OSS Software Solutions
+// Contributor: Joegen Baclor - mailto:joegen@ossapp.com
+//
+// Permission is hereby granted, to any person or organization
+// obtaining a copy of the software and accompanying documentation covered by
+// this license (the "Software") to use, execute, and to prepare
+// derivative works of the Software, all subject to the
+// "GNU Lesser General Public License (LGPL)".
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+// SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+// FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+
+#ifndef OSS_PREFIXTRIE_H_INCLUDED
+#define	OSS_PREFIXTRIE_H_INCLUDED
+
+
+#include <string>
+#include <vector>
+#include <boost/asio.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/cstdint.hpp>
+
+
+namespace OSS {
+namespace Net {
+
+class PrefixTrie : boost::noncopyable
+  ///
+  /// Longest prefix match table for IPv4 and IPv6 networks.
+  ///
+  /// Prefixes are compiled into a multibit trie with a 4 bit stride using
+  /// controlled prefix expansion.  Every node is a flat block of 16 entries
+  /// inside a single vector so a lookup is at most 8 (IPv4) or 32 (IPv6)
+  /// array reads with no allocation, no string conversion and no locking.
+  ///
+  /// The structure is meant to be built once and then only read.  Owners
+  /// that need to change the table build a new trie and swap the pointer.
+  ///
+{
+public:
+  enum
+  {
+    STRIDE = 4,
+    FANOUT = 1 << STRIDE,
+    DEFAULT_IPV4_BITS = 24 /// Matches socket_address_cidr_verify() when no mask is given
+  };
+
+  PrefixTrie();
+
+  ~PrefixTrie();
+
+  bool insert(const std::string& cidr);
+    /// Insert a network in a.b.c.d/bits or ipv6/bits notation.
+    /// Returns false if the network can't be parsed.
+
+  bool insert(const boost::asio::ip::address& network, unsigned bits);
+    /// Insert a network.  Host bits beyond the prefix length are ignored.
+
+  int lookup(const boost::asio::ip::address& address) const;
+    /// Returns the insertion index of the longest prefix that contains
+    /// address or -1 if there is none.  IPv4 mapped IPv6 addresses are
+    /// looked up in the IPv4 table.
+
+  bool match(const boost::asio::ip::address& address) const;
+    /// Returns true if any prefix contains address
+
+  const std::string& getPrefix(int index) const;
+    /// Returns the network string as it was inserted
+
+  std::size_t size() const;
+    /// Returns the number of prefixes
+
+  std::size_t getNodeCount() const;
+    /// Returns the number of trie nodes for both address families
+
+  static bool parseCidr(const std::string& cidr, boost::asio::ip::address& network, unsigned& bits);
+    /// Parse a network string.  The prefix length defaults to 24 for IPv4
+    /// and 128 for IPv6 if not specified.
+
+private:
+  struct Entry
+  {
+    boost::uint32_t child;
+    boost::int32_t prefix;
+  };
+  typedef std::vector<Entry> Nodes;
+
+  boost::uint32_t createNode(Nodes& nodes);
+  void insert(Nodes& nodes, const unsigned char* key, unsigned bits, int index);
+  int lookup(const Nodes& nodes, const unsigned char* key, unsigned keyBits) const;
+
+  Nodes _v4Nodes;
+  Nodes _v6Nodes;
+  std::vector<unsigned> _prefixBits;
+  std::vector<std::string> _prefixes;
+};
+
+//
+// Inlines
+//
+
+inline bool PrefixTrie::match(const boost::asio::ip::address& address) const
+{
+  return lookup(address) >= 0;
+}
+
+inline std::size_t PrefixTrie::size() const
+{
+  return _prefixes.size();
+}
+
+inline std::size_t PrefixTrie::getNodeCount() const
+{
+  return (_v4Nodes.size() + _v6Nodes.size()) / FANOUT;
+}
+
+inline const std::string& PrefixTrie::getPrefix(int index) const
+{
+  return _prefixes.at(index);
+}
+
+
+} } // OSS::Net
+
+
+#endif	/* OSS_PREFIXTRIE_H_INCLUDED */
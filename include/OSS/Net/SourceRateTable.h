@@ -0,0 +1,164 @@
+// Library: OSS_CORE - Foundation API for SIP B2BUA
+// Copyright (c) OSS Software Solutions
+// Contributor: Joegen Baclor - mailto:joegen@ossapp.com
+//
+// Permission is hereby granted, to any person or organization
+// obtaining a copy of the software and accompanying documentation covered by
+// this license (the "Software") to use, execute, and to prepare
+// derivative works of the Software, all subject to the
+// "GNU Lesser General Public License (LGPL)".
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+// SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+// FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+
+
+#ifndef OSS_SOURCERATETABLE_H_INCLUDED
+#define	OSS_SOURCERATETABLE_H_INCLUDED
+
+
+#include <vector>
+#include <boost/asio.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/cstdint.hpp>
+#include <boost/thread/mutex.hpp>
+
+
+namespace OSS {
+namespace Net {
+
+class SourceRateTable : boost::noncopyable
+  ///
+  /// Per source token buckets for packet rate limiting.
+  ///
+  /// Sources are spread over a fixed number of shards by hash.  Every shard
+  /// has its own lock and an open addressing table with linear probing, so
+  /// a check is a hash, one short lock and a few adjacent slot reads.
+  /// Packets from different sources rarely contend on the same lock.
+  ///
+  /// A bucket holds up to burst tokens and refills at rate tokens per
+  /// second.  Every packet takes one token.  IPv4 and IPv4 mapped IPv6
+  /// addresses share a bucket.
+  ///
+  /// Sources that have not sent anything for the idle timeout are dropped
+  /// whenever a shard is rehashed.  evictIdle() sweeps shards explicitly.
+  /// Once maxSources are tracked, packets from unknown sources are
+  /// let through and counted as overflow rather than growing the table.
+  ///
+{
+public:
+  enum Result
+  {
+    RATE_OK, /// The source is within its rate
+    RATE_EXCEEDED, /// The source just ran out of tokens
+    RATE_STILL_EXCEEDED /// The source has been out of tokens since its last RATE_EXCEEDED
+  };
+
+  enum
+  {
+    SHARD_BITS = 6,
+    SHARD_COUNT = 1 << SHARD_BITS,
+    INITIAL_SHARD_CAPACITY = 64,
+    DEFAULT_IDLE_TIMEOUT = 60000, /// milliseconds
+    DEFAULT_MAX_SOURCES = 4194304
+  };
+
+  SourceRateTable(unsigned long rate, unsigned long burst, std::size_t maxSources = DEFAULT_MAX_SOURCES);
+
+  ~SourceRateTable();
+
+  void setRate(unsigned long rate, unsigned long burst);
+    /// Set the refill rate in tokens per second and the bucket size.
+    /// Existing buckets keep their tokens up to the new bucket size.
+
+  unsigned long getRate() const;
+
+  unsigned long getBurst() const;
+
+  void setIdleTimeout(boost::uint64_t idleTimeout);
+    /// Set how long in milliseconds a silent source is kept
+
+  Result consume(const boost::asio::ip::address& source, boost::uint64_t now);
+    /// Take a token from the source's bucket.  now is in milliseconds.
+
+  unsigned long getTokens(const boost::asio::ip::address& source, boost::uint64_t now) const;
+    /// Returns the whole tokens left for source.  Unknown sources have a full bucket.
+
+  std::size_t evictIdle(boost::uint64_t now);
+    /// Drop idle sources from every shard.  Returns the number dropped.
+
+  std::size_t evictIdle(unsigned shard, boost::uint64_t now);
+    /// Drop idle sources from a single shard.  Returns the number dropped.
+
+  void clear();
+    /// Forget every source
+
+  std::size_t size() const;
+    /// Returns the number of tracked sources
+
+  boost::uint64_t getOverflowCount() const;
+    /// Returns the number of packets let through because the table was full
+
+private:
+  struct Slot
+  {
+    boost::uint64_t hi;
+    boost::uint64_t lo;
+    boost::uint64_t lastSeen; /// Zero marks an empty slot
+    boost::uint32_t tokens; /// Thousandths of a token
+    boost::uint32_t exceeded;
+  };
+
+  struct Shard
+  {
+    mutable boost::mutex mutex;
+    std::vector<Slot> slots;
+    std::size_t count;
+  };
+
+  static void makeKey(const boost::asio::ip::address& source, boost::uint64_t& hi, boost::uint64_t& lo);
+  static boost::uint64_t hash(boost::uint64_t hi, boost::uint64_t lo);
+  std::size_t rehash(Shard& shard, boost::uint64_t now);
+  void refill(Slot& slot, boost::uint64_t now) const;
+
+  Shard* _shards;
+  unsigned long _rate;
+  unsigned long _burst;
+  boost::uint64_t _idleTimeout;
+  std::size_t _maxShardSources;
+  volatile boost::uint64_t _overflow;
+};
+
+//
+// Inlines
+//
+
+inline unsigned long SourceRateTable::getRate() const
+{
+  return _rate;
+}
+
+inline unsigned long SourceRateTable::getBurst() const
+{
+  return _burst;
+}
+
+inline void SourceRateTable::setIdleTimeout(boost::uint64_t idleTimeout)
+{
+  _idleTimeout = idleTimeout;
+}
+
+inline boost::uint64_t SourceRateTable::getOverflowCount() const
+{
+  return _overflow;
+}
+
+} } // OSS::Net
+
+
+#endif	/* OSS_SOURCERATETABLE_H_INCLUDED */
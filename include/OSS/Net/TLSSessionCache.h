@@ -0,0 +1,172 @@
+// Library: OSS_CORE - Foundation API for SIP B2BUA
+// Copyright (c) OSS Software Solutions
+// Contributor: Joegen Baclor - mailto:joegen@ossapp.com
+//
+// Permission is hereby granted, to any person or organization
+// obtaining a copy of the software and accompanying documentation covered by
+// this license (the "Software") to use, execute, and to prepare
+// derivative works of the Software, all subject to the
+// "GNU Lesser General Public License (LGPL)".
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+// SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+// FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+
+#ifndef OSS_TLSSESSIONCACHE_H_INCLUDED
+#define	OSS_TLSSESSIONCACHE_H_INCLUDED
+
+
+#include <map>
+#include <vector>
+#include <string>
+#include <boost/noncopyable.hpp>
+#include <openssl/ssl.h>
+#include "OSS/OSS.h"
+#include "OSS/UTL/Thread.h"
+
+
+namespace OSS {
+namespace Net {
+
+
+class TLSSessionCache : boost::noncopyable
+  ///
+  /// TLS session resumption for server and client SSL contexts.
+  ///
+  /// On the server side the OpenSSL session cache is enabled and session
+  /// tickets are encrypted with keys owned by this object.  The ticket key is
+  /// rotated once it reaches its lifetime.  The previous key is kept so
+  /// tickets issued just before a rotation still resume (and get reissued
+  /// under the new key).
+  ///
+  /// On the client side sessions are cached per destination so a reconnect
+  /// to the same peer offers the last session it gave us.
+  ///
+  /// Both contexts point back to the cache through SSL_CTX ex data so the
+  /// transport only needs the SSL handle to offer a session or record the
+  /// outcome of a handshake.  The cache must be destroyed before the
+  /// contexts it is attached to.
+  ///
+{
+public:
+  enum
+  {
+    DEFAULT_SERVER_CACHE_SIZE = 20480,
+    DEFAULT_CLIENT_CACHE_SIZE = 4096,
+    DEFAULT_SESSION_TIMEOUT = 7200, /// seconds
+    DEFAULT_TICKET_KEY_LIFETIME = 43200, /// seconds
+    TICKET_KEY_NAME_SIZE = 16,
+    TICKET_KEY_SIZE = 32
+  };
+
+  struct Stats
+  {
+    OSS::UInt64 fullHandshakes;
+    OSS::UInt64 resumedHandshakes;
+    OSS::UInt64 failedHandshakes;
+    double handshakeRate; /// Completed handshakes per second over the last sample window
+    double resumptionRatio; /// Resumed over completed handshakes
+  };
+
+  TLSSessionCache();
+
+  ~TLSSessionCache();
+
+  void attachServer(SSL_CTX* pContext,
+    const std::string& sessionIdContext,
+    std::size_t cacheSize = DEFAULT_SERVER_CACHE_SIZE,
+    long sessionTimeout = DEFAULT_SESSION_TIMEOUT,
+    bool enableTickets = true);
+    /// Enable the server session cache and session tickets for the context.
+    /// The session id context is required for resumption when client
+    /// certificates are verified.  It is truncated to 32 bytes.
+    /// May be called again to change the settings.
+
+  void attachClient(SSL_CTX* pContext, std::size_t cacheSize = DEFAULT_CLIENT_CACHE_SIZE);
+    /// Enable per destination session caching for a client context
+
+  void setTicketKeyLifetime(long seconds);
+    /// Set how long a ticket key is used to issue new tickets
+
+  void rotateTicketKey();
+    /// Generate a new ticket key.  The current key is retained for decryption only.
+
+  bool offerSession(SSL* pSSL, const std::string& destination);
+    /// Offer the cached session for destination on a client connection that
+    /// has not started its handshake.  New sessions issued by the peer are
+    /// stored under destination.  Returns true if a session was offered.
+
+  void recordHandshake(SSL* pSSL, bool success);
+    /// Update the handshake counters.  A failed client handshake also drops
+    /// the cached session for its destination.
+
+  static TLSSessionCache* fromContext(SSL_CTX* pContext);
+    /// Returns the cache attached to the context or null
+
+  static bool offerSessionForContext(SSL* pSSL, const std::string& destination);
+    /// Calls offerSession() on the cache attached to the SSL context, if any
+
+  static void recordHandshakeForContext(SSL* pSSL, bool success);
+    /// Calls recordHandshake() on the cache attached to the SSL context, if any
+
+  Stats getStats();
+    /// Returns a snapshot of the handshake counters
+
+  std::size_t getClientSessionCount() const;
+    /// Returns the number of destinations with a cached session
+
+  void clearClientSessions();
+    /// Forget all client sessions
+
+  int handleTicketKey(unsigned char* name, unsigned char* iv, EVP_CIPHER_CTX* pCipher, unsigned char* hmacKey, int encrypt);
+    /// Selects the ticket key for the OpenSSL ticket callback.  Fills hmacKey
+    /// with TICKET_KEY_SIZE bytes.  Used internally.
+
+  int handleNewClientSession(SSL* pSSL, SSL_SESSION* pSession);
+    /// Stores a session issued by a server.  Used internally.
+
+private:
+  struct TicketKey
+  {
+    unsigned char name[TICKET_KEY_NAME_SIZE];
+    unsigned char aesKey[TICKET_KEY_SIZE];
+    unsigned char hmacKey[TICKET_KEY_SIZE];
+    OSS::UInt64 created;
+  };
+  typedef std::vector<TicketKey> TicketKeys;
+  typedef std::map<std::string, SSL_SESSION*> ClientSessions;
+
+  void rotateTicketKeyLocked(OSS::UInt64 now);
+  void removeClientSession(const std::string& destination);
+  void purgeClientSessions();
+  void sampleRate(OSS::UInt64 now);
+
+  std::vector<SSL_CTX*> _contexts;
+
+  OSS::mutex_critic_sec _ticketMutex;
+  TicketKeys _ticketKeys;
+  long _ticketKeyLifetime;
+
+  mutable OSS::mutex_critic_sec _clientMutex;
+  ClientSessions _clientSessions;
+  std::size_t _clientCacheSize;
+
+  OSS::mutex_critic_sec _statsMutex;
+  OSS::UInt64 _fullHandshakes;
+  OSS::UInt64 _resumedHandshakes;
+  OSS::UInt64 _failedHandshakes;
+  OSS::UInt64 _rateWindowStart;
+  OSS::UInt64 _rateWindowCount;
+  double _handshakeRate;
+};
+
+
+} } // OSS::Net
+
+
+#endif	/* OSS_TLSSESSIONCACHE_H_INCLUDED */
@@ -28,6 +28,7 @@
 #if OSS_HAVE_LEVELDB
 
 #include <leveldb/db.h>
+#include <boost/thread/condition_variable.hpp>
 
 #include "OSS/UTL/Thread.h"
 #include "OSS/Persistent/KeyValueStoreBase.h"
@@ -38,12 +39,33 @@ namespace Persistent {
 
 
 class KVLevelDB : boost::noncopyable
+  /// LevelDB backed key value store.
+  ///
+  /// Every value is stored behind a small header carrying its expiry time
+  /// so a get() costs a single lookup.  Keys with an expiry also get an
+  /// entry in a time-ordered index kept in a reserved key range at the end
+  /// of the database.  A background sweeper walks the index from the
+  /// oldest entry and purges what has expired.  It backs off while level-0
+  /// is congested and compacts the swept index range once enough
+  /// tombstones have piled up so they do not slow down later sweeps.
+  ///
+  /// Databases written by earlier versions, which kept the expiry in a
+  /// separate key + PERSISTENT_STORE_EXPIRES_SUFFIX record, are converted
+  /// the first time they are opened.
 {
 public: 
   typedef KVRecord Record;
   typedef KVKeys Keys;
   typedef KVRecords Records;
   
+  enum
+  {
+    DEFAULT_SWEEP_INTERVAL_MS = 1000,
+    SWEEP_BATCH_SIZE = 256,
+    SWEEP_COMPACT_THRESHOLD = 10000,
+    SWEEP_LEVEL0_BACKOFF = 8
+  };
+  
   KVLevelDB();
   
   ~KVLevelDB();
@@ -56,10 +78,34 @@ public:
 
   bool put(const std::string& key, const std::string& value);
 
+  bool put(const std::string& key, const std::string& value, unsigned int expireInSeconds);
+    /// An expireInSeconds of zero means the record never expires
+
   bool get(const std::string& key, std::string& value);
   
+  bool get(const std::string& key, std::string& value, bool purgeExpired);
+    /// When purgeExpired is false an expired record that has not been
+    /// swept yet is still returned
+  
   bool del(const std::string& key);
   
+  bool putRecords(const Records& records, unsigned int expireInSeconds = 0);
+    /// Writes all records in a single atomic WriteBatch
+  
+  bool delRecords(const Keys& keys);
+    /// Deletes all keys in a single atomic WriteBatch
+  
+  std::size_t purgeExpired(std::size_t maxRecords = 0);
+    /// Runs one sweep of the expiry index on the calling thread.  Returns
+    /// the number of records purged.  A maxRecords of zero sweeps
+    /// everything that has expired.
+  
+  void setSweepInterval(unsigned int milliseconds);
+    /// Sets how often the background sweeper runs.  Zero disables it.
+    /// Takes effect on the next open().
+  
+  unsigned int getSweepInterval() const;
+  
   bool getKeys(Keys& keys);
   
   bool getKeys(const std::string& filter, Keys& keys);
@@ -68,6 +114,11 @@ public:
   
   bool getRecords(const std::string& filter, Records& records);
   
+  bool visitRecords(const std::string& filter, const KVRecordVisitor& visitor);
+    /// Streams the matching records to visitor in key order without
+    /// collecting them first.  The strings passed to the visitor are reused
+    /// for the next record.  Returning false from the visitor ends the scan.
+  
   bool delKeys(const std::string& filter);
   
   const std::string getPath() const;
@@ -76,9 +127,28 @@ public:
   
   void setKeyPrefix(const std::string& keyPrefix);
 private:
+  bool migrateExpiresRecords();
+  bool purgeIfExpired(const std::string& key, OSS::UInt64 expires);
+  void runSweeper();
+  bool isLevel0Congested();
+  
   leveldb::DB* _pDb;
   std::string _path;
   std::string _keyPrefix;
+  
+  //
+  // Writers share this lock.  The sweeper takes it exclusively while it
+  // verifies and deletes a batch so it never removes a record that was
+  // rewritten after it was found to be expired.
+  //
+  OSS::mutex_read_write _writeMutex;
+  
+  unsigned int _sweepInterval;
+  boost::thread* _pSweeper;
+  bool _sweepStop;
+  OSS::mutex_critic_sec _sweepMutex;
+  boost::condition_variable _sweepCondition;
+  volatile std::size_t _tombstones;
 };
 
 
@@ -86,6 +156,16 @@ private:
 // Inlines
 //
 
+inline void KVLevelDB::setSweepInterval(unsigned int milliseconds)
+{
+  _sweepInterval = milliseconds;
+}
+
+inline unsigned int KVLevelDB::getSweepInterval() const
+{
+  return _sweepInterval;
+}
+
 inline const std::string& KVLevelDB::getKeyPrefix() const
 {
   return _keyPrefix;
@@ -32,6 +32,10 @@
 namespace OSS {
 namespace Persistent {
 
+//
+// Expiry records of the old format.  Stores now keep the expiry inside the
+// value and only look for these when converting an old database.
+//
 #define PERSISTENT_STORE_EXPIRES_SUFFIX ".KV_EXPIRES"
   
 struct KVRecord
@@ -42,6 +46,7 @@ struct KVRecord
 
 typedef std::vector<std::string> KVKeys;
 typedef std::vector<KVRecord> KVRecords;
+typedef boost::function<bool(const std::string& /*key*/, const std::string& /*value*/)> KVRecordVisitor;
 
  struct KVInputProcessor
 {
@@ -109,38 +114,30 @@ public:
           return false;
     }
     
-    OSS::UInt64 expires = OSS::getTime() + (expireInSeconds*1000);
-    std::string expireString = OSS::string_from_number(expires);
-    std::string expireKey = key + PERSISTENT_STORE_EXPIRES_SUFFIX;
-  
-    if (!_impl.put(expireKey, expireString))
-      return false;
-    
-    return _impl.put(key, value);
+    return _impl.put(key, value, expireInSeconds);
   }
 
-  bool get(const std::string& key, std::string& value)
+  bool putRecords(const KVRecords& records, unsigned int expireInSeconds = 0)
   {
-    if (is_expired(key))
+    for (KVInputProcessors::iterator iter = _inputProc.begin(); iter != _inputProc.end(); iter++)
     {
-      purge_expired(key);
-      return false;
+      if (!iter->put)
+        continue;
+      for (KVRecords::const_iterator record = records.begin(); record != records.end(); record++)
+        if (iter->put(record->key, record->value, expireInSeconds ? expireInSeconds : -1) == KVInputProcessor::Ignore)
+          return false;
     }
-    
-    return _impl.get(key, value);
+    return _impl.putRecords(records, expireInSeconds);
+  }
+
+  bool get(const std::string& key, std::string& value)
+  {
+    return _impl.get(key, value, true);
   }
   
   bool get(const std::string& key, std::string& value, bool purgeExpired)
   {
-    if (purgeExpired)
-    {
-      if (is_expired(key))
-      {
-        purge_expired(key);
-        return false;
-      }
-    }
-    return _impl.get(key, value);
+    return _impl.get(key, value, purgeExpired);
   }
 
   bool del(const std::string& key)
@@ -154,6 +151,19 @@ public:
     return _impl.del(key);
   }
   
+  bool delRecords(const KVKeys& keys)
+  {
+    for (KVInputProcessors::iterator iter = _inputProc.begin(); iter != _inputProc.end(); iter++)
+    {
+      if (!iter->del)
+        continue;
+      for (KVKeys::const_iterator key = keys.begin(); key != keys.end(); key++)
+        if (iter->del(*key) == KVInputProcessor::Ignore)
+          return false;
+    }
+    return _impl.delRecords(keys);
+  }
+  
   bool delKeys(const std::string& filter)
   {
     for (KVInputProcessors::iterator iter = _inputProc.begin(); iter != _inputProc.end(); iter++)
@@ -185,6 +195,11 @@ public:
     return _impl.getRecords(filter, records);
   }
   
+  bool visitRecords(const std::string& filter, const KVRecordVisitor& visitor)
+  {
+    return _impl.visitRecords(filter, visitor);
+  }
+  
   std::string getPath() const
   {
     return _impl.getPath();
@@ -210,28 +225,12 @@ public:
     _inputProc.push_back(inputProcessor);
   }
   
-protected:
-  bool is_expired(const std::string& key)
-  {
-    std::string expireKey = key + PERSISTENT_STORE_EXPIRES_SUFFIX;
-
-    std::string expires;
-    if (!get(expireKey, expires, false))
-      return false;
-
-    OSS::UInt64 expireTime = OSS::string_to_number<OSS::UInt64>(expires);
-
-    return expireTime <= OSS::getTime();
-  }
-
-  bool purge_expired(const std::string& key)
+  std::size_t purgeExpired(std::size_t maxRecords = 0)
   {
-    std::string expireKey = key + PERSISTENT_STORE_EXPIRES_SUFFIX;
-    if (!del(key))
-      return false;
-    return del(expireKey);
+    return _impl.purgeExpired(maxRecords);
   }
   
+protected:
   KV _impl;  
   KVInputProcessors _inputProc;
 };
@@ -26,6 +26,7 @@
 
 #if OSS_HAVE_LEVELDB
 
+#include <boost/atomic.hpp>
 #include "OSS/OSS.h"
 #include "OSS/Net/HTTPServer.h"
 #include "OSS/Persistent/KeyValueStore.h"
@@ -42,6 +43,7 @@ public:
   typedef OSS::Net::HTTPServer::Request Request;
   typedef OSS::Net::HTTPServer::Response Response;
   typedef std::map<std::string, KeyValueStore*> KVStore;
+  typedef boost::function<std::ostream&()> StreamOpener;
   
   class Client
   {
@@ -100,6 +102,8 @@ public:
   int restPUT(const std::string& path, const std::string& value, int expires);
     
   int restGET(const std::string& path, std::ostream& ostr);
+    /// Writes the subtree under path as JSON while it is read from the
+    /// store.  Nothing is written if the subtree is empty.
 
   int restDELETE(const std::string& path);
 
@@ -110,6 +114,11 @@ protected:
   
   bool isAuthorized(Request& request, Response& response);
   
+  int writeJSONDocument(const std::string& path, const StreamOpener& open);
+    /// Streams the subtree under path as JSON.  open is called for the
+    /// output stream when the first record is found so an empty subtree can
+    /// still be answered with a 404.
+  
   void sendRestRecordsAsJson(const std::vector<std::string>& pathVector, KVRecords& records, Response& response);
   
   void createJSONDocument(const std::vector<std::string>& pathVector, std::size_t depth, KVRecords& records, std::ostream& ostr, bool sortNeeded);
@@ -121,8 +130,9 @@ private:
   std::string _password;
   std::string _rootDocument;
   std::string _dataDirectory;
-  OSS::mutex _kvStoreMutex;
-  KVStore _kvStore;
+  OSS::mutex _kvStoreMutex; /// Serializes opening new stores
+  boost::atomic<KVStore*> _kvStore; /// Read without locking.  See getStore().
+  std::vector<KVStore*> _retiredKvStores;
   Handler _customHandler;
   RESTKeyValueStore* _pParentStore;
 };
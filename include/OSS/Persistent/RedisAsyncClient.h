@@ -0,0 +1,270 @@
+// Library: OSS_CORE - Foundation API for SIP B2BUA
+// Copyright (c) OSS Software Solutions
+// Contributor: Joegen Baclor - mailto:joegen@ossapp.com
+//
+// Permission is hereby granted, to any person or organization
+// obtaining a copy of the software and accompanying documentation covered by
+// this license (the "Software") to use, execute, and to prepare
+// derivative works of the Software, all subject to the
+// "GNU Lesser General Public License (LGPL)".
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+// SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+// FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+
+
+#ifndef OSS_REDISASYNCCLIENT_H_INCLUDED
+#define	OSS_REDISASYNCCLIENT_H_INCLUDED
+
+#include "OSS/build.h"
+
+#if ENABLE_FEATURE_REDIS
+#if OSS_HAVE_HIREDIS
+
+#include "OSS/UTL/Thread.h"
+#include <boost/asio.hpp>
+#include <boost/atomic.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/enable_shared_from_this.hpp>
+#include <boost/function.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <vector>
+#include <string>
+
+
+struct redisAsyncContext;
+
+
+namespace OSS {
+
+namespace Persistent {
+
+
+class RedisAsyncClient : public boost::enable_shared_from_this<RedisAsyncClient>, boost::noncopyable
+  /// Non-blocking redis client built on the hiredis async API.
+  ///
+  /// The connection is driven by the io_service passed to the constructor.
+  /// Commands may be issued from any thread.  They are handed to hiredis
+  /// on the client's strand and written out together, so everything issued
+  /// before the socket becomes writable goes out in one write and the
+  /// replies come back in order.  Callbacks run on the io_service.
+  ///
+  /// Clients must be created with create().  Pending reads keep the client
+  /// alive, so call disconnect() once it is no longer needed.
+{
+public:
+  typedef boost::shared_ptr<RedisAsyncClient> Ptr;
+  typedef std::vector<std::string> Command;
+  typedef std::vector<Command> Commands;
+
+  struct Reply
+  {
+    Reply() : type(0), integer(0) {}
+    
+    bool ok() const;
+      /// Returns false if there was no reply or the reply is an error
+    
+    bool isNil() const;
+    
+    int type; /// One of REDIS_REPLY_* or 0 if no reply was received
+    long long integer;
+    std::string str; /// Value of string, status and error replies
+    std::vector<Reply> elements;
+  };
+
+  typedef boost::function<void(const Reply& /*reply*/)> Callback;
+  typedef boost::function<bool(const std::vector<std::string>& /*keys*/, bool /*done*/)> ScanCallback;
+    /// Receives one batch of keys per SCAN round trip.  done is true on the
+    /// last batch.  Return false to stop the scan early.
+
+  enum State
+  {
+    DISCONNECTED,
+    CONNECTING,
+    CONNECTED
+  };
+  
+  enum
+  {
+    DEFAULT_SCAN_COUNT = 1000,
+    DEFAULT_TIMEOUT_MS = 5000,
+    DEFAULT_RECONNECT_MS = 1000
+  };
+
+  static Ptr create(boost::asio::io_service& ioService, const std::string& tcpHost, int tcpPort);
+
+  ~RedisAsyncClient();
+
+  void connect(const std::string& password = "", int db = 0);
+    /// Starts connecting.  AUTH and SELECT are queued ahead of any command
+    /// issued after this call.  A lost connection is re-established after
+    /// the reconnect interval until disconnect() is called.
+
+  void disconnect();
+    /// Closes the connection once every pending reply has arrived
+
+  void execute(const Command& command, const Callback& callback = Callback());
+  
+  void executeTransaction(const Commands& commands, const Callback& callback = Callback());
+    /// Queues commands between MULTI and EXEC.  The callback receives the
+    /// EXEC reply, an array holding the reply of each command, or an error
+    /// if redis rejected any of them.
+
+  void scan(const std::string& pattern, const ScanCallback& callback, unsigned int count = DEFAULT_SCAN_COUNT);
+    /// Walks the keyspace with SCAN.  Unlike KEYS this never blocks the
+    /// server for more than one batch.  A key may be reported more than once.
+
+  //
+  // Blocking helpers.  These must not be called from a thread running
+  // the io_service of this client.
+  //
+  bool executeSync(const Command& command, Reply& reply, unsigned int timeoutMs = DEFAULT_TIMEOUT_MS);
+  
+  bool executeTransactionSync(const Commands& commands, Reply& reply, unsigned int timeoutMs = DEFAULT_TIMEOUT_MS);
+  
+  bool scanSync(const std::string& pattern, std::vector<std::string>& keys, unsigned int count = DEFAULT_SCAN_COUNT);
+    /// Collects every key matching pattern.  Fails if DEFAULT_TIMEOUT_MS
+    /// elapses without a SCAN reply.  The timeout restarts on each reply.
+  
+  bool waitForConnection(unsigned int timeoutMs = DEFAULT_TIMEOUT_MS);
+    /// Blocks until the client is connected or timeoutMs has elapsed
+
+  State getState() const;
+  
+  bool isConnected() const;
+  
+  std::size_t getPendingCount() const;
+    /// Number of commands waiting for a reply
+  
+  std::string getLastError() const;
+  
+  const std::string& getHost() const;
+  
+  int getPort() const;
+  
+  void setReconnectInterval(unsigned int milliseconds);
+    /// Zero disables reconnection
+
+protected:
+  RedisAsyncClient(boost::asio::io_service& ioService, const std::string& tcpHost, int tcpPort);
+
+  struct PendingCommand
+  {
+    Ptr client;
+    Callback callback;
+    bool counted; /// Whether the reply settles a command counted in _pending
+  };
+  
+  struct ScanState;
+  typedef boost::shared_ptr<ScanState> ScanStatePtr;
+
+  void doConnect();
+  void doDisconnect();
+  void doExecute(const Command& command, const Callback& callback);
+  void doExecuteTransaction(const Commands& commands, const Callback& callback);
+  bool sendCommand(const Command& command, const Callback& callback);
+  bool sendCommand(const Command& command, PendingCommand* pending);
+  void failCommand(const Callback& callback);
+  void nextScan(const ScanStatePtr& state);
+  void onScanReply(const ScanStatePtr& state, const Reply& reply);
+  void scheduleReconnect();
+  void onReconnectTimer(const boost::system::error_code& e);
+  void setState(State state);
+
+  //
+  // hiredis event loop hooks
+  //
+  void startRead();
+  void stopRead();
+  void startWrite();
+  void stopWrite();
+  void cleanup();
+  void handleRead(const boost::system::error_code& e);
+  void handleWrite(const boost::system::error_code& e);
+
+  static void onAddRead(void* data);
+  static void onDelRead(void* data);
+  static void onAddWrite(void* data);
+  static void onDelWrite(void* data);
+  static void onCleanup(void* data);
+  static void onConnect(const redisAsyncContext* context, int status);
+  static void onDisconnect(const redisAsyncContext* context, int status);
+  static void onReply(redisAsyncContext* context, void* reply, void* privdata);
+  static void convertReply(const void* redisReply, Reply& reply);
+
+  boost::asio::io_service& _ioService;
+  boost::asio::io_service::strand _strand;
+  boost::asio::deadline_timer _reconnectTimer;
+  boost::shared_ptr<boost::asio::posix::stream_descriptor> _socket;
+  redisAsyncContext* _context;
+  std::string _tcpHost;
+  int _tcpPort;
+  std::string _password;
+  int _db;
+  bool _reading;
+  bool _writing;
+  bool _wantRead;
+  bool _wantWrite;
+  boost::atomic<bool> _stopped; /// Set by connect() and disconnect() from any thread
+  unsigned int _reconnectInterval;
+  volatile int _state;
+  volatile long _pending;
+  mutable OSS::mutex_critic_sec _stateMutex;
+  boost::condition_variable _stateCondition;
+  std::string _lastError;
+};
+
+
+//
+// Inlines
+//
+
+inline RedisAsyncClient::Ptr RedisAsyncClient::create(boost::asio::io_service& ioService, const std::string& tcpHost, int tcpPort)
+{
+  return Ptr(new RedisAsyncClient(ioService, tcpHost, tcpPort));
+}
+
+inline RedisAsyncClient::State RedisAsyncClient::getState() const
+{
+  return (State)_state;
+}
+
+inline bool RedisAsyncClient::isConnected() const
+{
+  return _state == CONNECTED;
+}
+
+inline std::size_t RedisAsyncClient::getPendingCount() const
+{
+  return (std::size_t)_pending;
+}
+
+inline const std::string& RedisAsyncClient::getHost() const
+{
+  return _tcpHost;
+}
+
+inline int RedisAsyncClient::getPort() const
+{
+  return _tcpPort;
+}
+
+inline void RedisAsyncClient::setReconnectInterval(unsigned int milliseconds)
+{
+  _reconnectInterval = milliseconds;
+}
+
+
+} } // OSS::Persistent
+
+
+#endif // OSS_HAVE_HIREDIS
+
+#endif // ENABLE_FEATURE_REDIS
+
+#endif	// OSS_REDISASYNCCLIENT_H_INCLUDED
@@ -34,6 +34,7 @@
 #include "OSS/JSON/writer.h"
 #include "OSS/JSON/elements.h"
 #include "OSS/UTL/CoreUtils.h"
+#include "OSS/Persistent/RedisAsyncClient.h"
 #include <map>
 
 
@@ -60,6 +61,11 @@ public:
     TCP,
     UNIX
   };
+  
+  enum
+  {
+    SCAN_COUNT = 1000 /// Keys per SCAN round trip and per MGET batch
+  };
 
 protected:
   mutable mutex _mutex;
@@ -109,6 +115,9 @@ protected:
 public:
   void execute(const std::vector<std::string>& args, std::ostream& strm) const;
   
+  bool executeCommand(const std::vector<std::string>& args);
+    /// Returns true if redis replied with anything other than an error
+  
   bool set(const std::string& key, const json::Object& value, int expires = -1);
 
   bool set(const std::string& key, const std::string& value, int expires = -1);
@@ -128,6 +137,7 @@ public:
   bool get(const std::string& key, std::string& value) const;
   
   bool getAll(std::vector<std::string>& values, const std::string& pattern = "*");
+    /// Collects the keys with SCAN and fetches their values with MGET
 
   bool getAll(std::vector<json::Object>& values, const std::string& pattern = "*");
 
@@ -138,6 +148,8 @@ public:
   bool hmget(const std::string& key, const std::vector<std::string>& fields, std::vector<std::string>& value) const;
 
   bool getKeys(const std::string& pattern, std::vector<std::string>& keys);
+    /// Iterates the keyspace with SCAN so a large database does not block
+    /// the server the way KEYS does
 
   bool del(const std::string& key);
 
@@ -152,9 +164,14 @@ public:
 };
 
 class RedisBroadcastClient
+  /// Mirrors writes to every connected server.  Writes are sent to all
+  /// servers in parallel over RedisAsyncClient connections and the call
+  /// returns once each server replied or the timeout elapsed.  Reads use
+  /// the blocking clients, starting with the default one.
 {
 public:
   typedef std::map<std::string, RedisClient*> Pool;
+  typedef std::map<std::string, RedisAsyncClient::Ptr> AsyncPool;
 
   RedisBroadcastClient();
 
@@ -180,9 +197,20 @@ public:
   
   RedisClient* defaultClient();
   
+  void setTimeout(unsigned int milliseconds);
+    /// How long a broadcast write waits for the slowest server
+  
 protected:
+  int broadcast(const std::vector<std::string>& args);
+    /// Returns the number of servers that accepted the command
+
   Pool _pool;
   RedisClient* _defaultClient;
+  AsyncPool _asyncPool;
+  boost::asio::io_service _ioService;
+  boost::asio::io_service::work* _pWork;
+  boost::thread* _pIoThread;
+  unsigned int _timeout;
 };
 
 
@@ -195,6 +223,11 @@ inline RedisClient* RedisBroadcastClient::defaultClient()
   return _defaultClient;
 }
 
+inline void RedisBroadcastClient::setTimeout(unsigned int milliseconds)
+{
+  _timeout = milliseconds;
+}
+
 } } // OSS::Persistent
 
 
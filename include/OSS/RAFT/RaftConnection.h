@@ -37,6 +37,30 @@ namespace RAFT {
 
 class RaftConsensus;
 
+//
+// InstallSnapshot is not part of libraft.  A snapshot is sent to a follower
+// that needs entries the leader already compacted, one chunk per message.
+// data only stays valid for the duration of the send call.
+//
+typedef struct
+{
+  int term;
+  int last_included_idx;
+  int last_included_term;
+  OSS::UInt64 size;     /// total size of the snapshot
+  OSS::UInt64 offset;   /// position of this chunk in the snapshot
+  const char* data;
+  unsigned int len;
+} msg_installsnapshot_t;
+
+typedef struct
+{
+  int term;
+  int last_included_idx;
+  OSS::UInt64 offset;   /// bytes of the snapshot the follower holds so far
+  int success;
+} msg_installsnapshot_response_t;
+
 class RaftConnection
 {
 public:
@@ -50,6 +74,10 @@ public:
   virtual int onSendAppendEntries(msg_appendentries_t& data) = 0;
   virtual int onSendRequestVoteResponse(msg_requestvote_response_t& data) = 0;
   virtual int onSendAppendEntriesResponse(msg_appendentries_response_t& data) = 0;
+  virtual int onSendInstallSnapshot(msg_installsnapshot_t& data);
+  virtual int onSendInstallSnapshotResponse(msg_installsnapshot_response_t& data);
+    /// Snapshot transfer.  The default implementations return -1 for
+    /// transports that do not carry snapshots.
 
   RaftNode& getNode();
   const RaftNode& getNode() const;
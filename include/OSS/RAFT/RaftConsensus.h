@@ -25,7 +25,11 @@
 #include "OSS/UTL/Thread.h"
 #include "OSS/RAFT/RaftNode.h"
 #include "OSS/RAFT/RaftConnection.h"
+#include "OSS/RAFT/RaftLog.h"
+#include <boost/thread/condition_variable.hpp>
 #include <map>
+#include <set>
+#include <vector>
 
 
 namespace OSS {
@@ -34,6 +38,8 @@ namespace RAFT {
   
 #define RAFT_ELECTION_TIMEOUT_MS 2000;
 #define RAFT_PERIODIC_TIMER_MS 1000;
+#define RAFT_MAX_ENTRIES_PER_MESSAGE 1024;
+#define RAFT_SNAPSHOT_CHUNK_SIZE 1048576;
   
   
 class RaftConsensus : public OSS::Thread
@@ -53,11 +59,18 @@ public:
       election_timeout_ms = RAFT_ELECTION_TIMEOUT_MS;
       periodic_timer_ms = RAFT_PERIODIC_TIMER_MS;
       is_master = false;
+      max_entries_per_message = RAFT_MAX_ENTRIES_PER_MESSAGE;
+      snapshot_threshold = 0;
+      snapshot_chunk_size = RAFT_SNAPSHOT_CHUNK_SIZE;
     }
     int node_id;
     int election_timeout_ms;
     int periodic_timer_ms;
     bool is_master;
+    int max_entries_per_message;
+    std::string log_directory; /// Keeps the log in memory only if empty
+    int snapshot_threshold;    /// Applied entries in the log that trigger a snapshot.  Zero disables automatic snapshots.
+    int snapshot_chunk_size;   /// Largest piece of a snapshot sent in one InstallSnapshot message
   };
     
   RaftConsensus();
@@ -72,6 +85,28 @@ public:
   bool addNoneVotingNode(int node_id);
   void removeNode(int node_id);
   bool findNode(int node_id, Node& node);
+
+  //
+  // Log related
+  //
+  bool submit(const std::string& data);
+    /// Queues data to be appended to the replicated log.  Returns false if
+    /// this node is not the leader.  Everything submitted while the previous
+    /// batch is being written goes out together, with a single log flush and
+    /// a single AppendEntries message per follower.
+
+  bool takeSnapshot();
+    /// Saves the application state through onCreateSnapshot() and drops
+    /// the log entries it covers.  Followers that need those entries are
+    /// sent the snapshot instead.
+
+  bool isLeader();
+  int getLeaderId();
+    /// Returns the id of the node this node believes is the leader or -1
+  int getCurrentIndex();
+  int getCommitIndex();
+  int getSnapshotIndex();
+  std::size_t getLogSyncCount();
   
   //
   // RAFT Protocol Handlers.  All returns zero when successful
@@ -82,6 +117,9 @@ public:
   virtual int onReceivedAppendEntries(const Connection::Ptr& pConnection, msg_appendentries_t& data);
   virtual int onReceivedRequestVoteResponse(const Connection::Ptr& pConnection, msg_requestvote_response_t& data);
   virtual int onReceivedAppendEntriesResponse(const Connection::Ptr& pConnection, msg_appendentries_response_t& data);
+  virtual int onSendInstallSnapshot(Node& node, msg_installsnapshot_t& data);
+  virtual int onReceivedInstallSnapshot(const Connection::Ptr& pConnection, msg_installsnapshot_t& data);
+  virtual int onReceivedInstallSnapshotResponse(const Connection::Ptr& pConnection, msg_installsnapshot_response_t& data);
   
   
   virtual int onApplyEntry(const raft_entry_t& entry);
@@ -90,6 +128,25 @@ public:
   virtual int onPersistTerm(int vote);
   virtual void onSufficientLogs(Node& node);
 
+  virtual bool onCreateSnapshot(std::string& data);
+    /// Serializes the application state as of the last applied entry.  It
+    /// is called with the raft mutex held so no entry is applied meanwhile.
+    /// The default returns false which disables snapshots.
+
+  virtual bool onInstallSnapshot(const std::string& data);
+    /// Replaces the application state with a snapshot.  Called when one
+    /// arrives from the leader and when restarting from a saved snapshot.
+
+  //
+  // libraft log and state callbacks.  These keep the durable log in step
+  // with libraft and then call the virtual handlers above.
+  //
+  int sendAppendEntries(Node& node, msg_appendentries_t& data);
+  int logAppend(const raft_entry_t& entry, int index);
+  int logPop(const raft_entry_t& entry, int index);
+  int persistVote(int vote);
+  int persistTerm(int term);
+
   //
   // Connection related handlers
   //
@@ -101,8 +158,18 @@ protected:
   virtual void main();
   virtual void onTerminate();
   
-  void callPeriodicTimer();
+  void callPeriodicTimer(int elapsed);
   void becomeMaster();
+  void processSubmitted();
+  bool restoreLog();
+
+  //
+  // Outgoing AppendEntries are collected while libraft is being called and
+  // sent by endBatch() once the log is flushed
+  //
+  void beginBatch();
+  void endBatch();
+  void fixupEntries();
 
   Connection::Ptr findConnection(const Node& node);
   Connection::Ptr findConnection(int id);
@@ -111,13 +178,42 @@ protected:
   void removeConnection(int id);
 
 private:
+  struct Peer
+  {
+    Peer() : sentIndex(-1), sentCommit(0), snapshotIndex(0), snapshotOffset(0), snapshotInFlight(false) {}
+    int sentIndex;          /// last index already sent to the peer or -1 if unknown
+    int sentCommit;         /// commit index carried by the last message to the peer
+    int snapshotIndex;      /// snapshot being transferred to the peer
+    OSS::UInt64 snapshotOffset;
+    bool snapshotInFlight;  /// a chunk was sent and its response is pending
+  };
+
+  void sendSnapshot(raft_node_t* node, Peer& peer);
+  bool installSnapshot(int index, int term);
+  bool isSnapshotDue();
+  typedef std::map<int, Peer> Peers;
+  typedef std::vector<std::string> Submitted;
+
   OSS::mutex _raftMutex;
   OSS::mutex_critic_sec _connectionMutex;
-  OSS::semaphore _sem;
+  OSS::mutex_critic_sec _submitMutex;
+  boost::condition_variable _submitCondition;
   raft_server_t* _raft;
   Options _opt;
   Connections _connections;
   Nodes _nodes;
+  RaftLog _log;
+  bool _restoring;
+  int _fixupIndex;
+  int _batchDepth;
+  bool _forceSends;
+  std::set<int> _pendingSends;
+  Peers _peers;
+  Submitted _submitted;
+  unsigned int _lastEntryId;
+  std::string _incomingSnapshot;
+  int _incomingSnapshotIndex;
+  int _incomingSnapshotTerm;
 };
 
 
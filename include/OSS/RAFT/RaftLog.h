@@ -0,0 +1,233 @@
+// Library: OSS_CORE - Foundation API for SIP B2BUA
+// Copyright (c) OSS Software Solutions
+// Contributor: Joegen Baclor - mailto:joegen@ossapp.com
+//
+// Permission is hereby granted, to any person or organization
+// obtaining a copy of the software and accompanying documentation covered by
+// this license (the "Software") to use, execute, and to prepare
+// derivative works of the Software, all subject to the
+// "GNU Lesser General Public License (LGPL)".
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+// SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+// FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+
+
+#ifndef OSS_RAFTLOG_H_INCLUDED
+#define OSS_RAFTLOG_H_INCLUDED
+
+
+#include "OSS/OSS.h"
+#include <boost/noncopyable.hpp>
+#include <deque>
+#include <vector>
+#include <string>
+
+extern "C"
+{
+  #include "OSS/RAFT/libraft.h"
+};
+
+
+namespace OSS {
+namespace RAFT {
+
+
+class RaftLog : boost::noncopyable
+  /// Storage for the replicated log of a RaftConsensus node.
+  ///
+  /// Entries are always kept in memory and libraft borrows their payload
+  /// pointers.  When opened on a directory the log is also written to an
+  /// append-only segment file.  append() only buffers a record.  sync()
+  /// writes everything buffered since the previous call with a single
+  /// write() and a single fdatasync() so a whole batch of entries costs one
+  /// flush.  Term and vote are kept in a separate small state file.
+  ///
+  /// A segment record is laid out as
+  ///
+  ///   length(4) crc32(4) term(4) id(4) type(4) data(length - 12)
+  ///
+  /// with all integers in network byte order.  The crc covers everything
+  /// after the crc field.  A torn or corrupt record left at the tail by a
+  /// crash is cut off when the log is opened.  The segment starts with an
+  /// 8 byte header holding the index just before its first record.
+  ///
+  /// compact() saves a snapshot of the application state and drops the
+  /// entries it covers.  The snapshot is written to its own file first and
+  /// the segment is then rewritten with only the remaining entries.  Both
+  /// files are replaced by rename so a crash leaves either the old or the
+  /// new version.
+  ///
+  /// The class is not thread safe.  RaftConsensus only uses it while
+  /// holding its raft mutex.
+{
+public:
+  struct Entry
+  {
+    unsigned int term;
+    unsigned int id;
+    int type;
+    std::string data;
+  };
+
+  RaftLog();
+  ~RaftLog();
+
+  bool open(const std::string& directory);
+    /// Opens or creates the log files in directory and loads the state and
+    /// the entries written by an earlier run.  A log that was never opened
+    /// lives in memory only.
+
+  void close();
+    /// Syncs pending entries and closes the files.  The entries stay in memory.
+
+  bool isOpen() const;
+    /// Returns true if the log is backed by files
+
+  bool append(const raft_entry_t& entry);
+    /// Copies entry after the last one.  It becomes durable at the next sync().
+
+  bool truncate(int index);
+    /// Removes the entry at index and every entry after it
+
+  bool sync();
+    /// Writes and flushes the entries appended and truncated since the last
+    /// call.  Returns right away if there is nothing to flush.
+
+  bool persistState(int term, int vote);
+    /// Stores term and vote and flushes them before returning
+
+  bool compact(int index, int term, const std::string& data);
+    /// Stores data as the snapshot of everything up to and including index
+    /// and removes those entries from the log
+
+  bool installSnapshot(int index, int term, const std::string& data);
+    /// Replaces the whole log with a snapshot received from the leader
+
+  int getSnapshotIndex() const;
+    /// Returns the last index covered by the snapshot or 0 if there is none
+
+  int getSnapshotTerm() const;
+    /// Returns the term of the entry at getSnapshotIndex()
+
+  const std::string& getSnapshotData() const;
+    /// Returns the application state saved by the last snapshot
+
+  int getTerm() const;
+    /// Returns the term loaded by open() or stored by persistState()
+
+  int getVote() const;
+    /// Returns the vote loaded by open() or stored by persistState()
+
+  const Entry* getEntry(int index) const;
+    /// Returns the entry at index or 0 if there is none
+
+  int getFirstIndex() const;
+    /// Returns the index of the first entry in the log
+
+  int getLastIndex() const;
+    /// Returns the index of the last entry or getFirstIndex() - 1 if the log is empty
+
+  std::size_t getSyncCount() const;
+    /// Returns the number of fdatasync() calls made for the segment file
+
+private:
+  bool load();
+  bool loadState();
+  bool loadSnapshot();
+  bool writeState();
+  bool writeSnapshot(int index, int term, const std::string& data);
+  bool rewriteSegment(int base, std::size_t first);
+  bool syncDirectory();
+  void encode(const Entry& entry);
+
+  typedef std::deque<Entry> Entries;
+  typedef std::vector<OSS::UInt64> Offsets;
+
+  std::string _directory;
+  int _logFd;
+  int _stateFd;
+  Entries _entries;
+  Offsets _offsets;           /// segment file offset of each entry in _entries
+  int _base;                  /// index of the entry just before the first one
+  int _snapshotTerm;
+  std::string _snapshot;
+  std::string _pending;       /// records appended since the last sync
+  OSS::UInt64 _fileSize;      /// bytes of the segment file already written
+  bool _dirty;                /// the segment file was truncated since the last sync
+  int _term;
+  int _vote;
+  OSS::UInt32 _stateSequence;
+  std::size_t _syncCount;
+};
+
+
+//
+// Inlines
+//
+
+inline bool RaftLog::isOpen() const
+{
+  return _logFd != -1;
+}
+
+inline int RaftLog::getTerm() const
+{
+  return _term;
+}
+
+inline int RaftLog::getVote() const
+{
+  return _vote;
+}
+
+inline int RaftLog::getFirstIndex() const
+{
+  return _base + 1;
+}
+
+inline int RaftLog::getLastIndex() const
+{
+  return _base + (int)_entries.size();
+}
+
+inline int RaftLog::getSnapshotIndex() const
+{
+  return _base;
+}
+
+inline int RaftLog::getSnapshotTerm() const
+{
+  return _snapshotTerm;
+}
+
+inline const std::string& RaftLog::getSnapshotData() const
+{
+  return _snapshot;
+}
+
+inline std::size_t RaftLog::getSyncCount() const
+{
+  return _syncCount;
+}
+
+inline const RaftLog::Entry* RaftLog::getEntry(int index) const
+{
+  if (index <= _base || index > getLastIndex())
+  {
+    return 0;
+  }
+  return &_entries[index - _base - 1];
+}
+
+
+} } // OSS::RAFT
+
+
+#endif // OSS_RAFTLOG_H_INCLUDED
+
@@ -0,0 +1,200 @@
+// Library: OSS_CORE - Foundation API for SIP B2BUA
+// Copyright (c) OSS Software Solutions
+// Contributor: Joegen Baclor - mailto:joegen@ossapp.com
+//
+// Permission is hereby granted, to any person or organization
+// obtaining a copy of the software and accompanying documentation covered by
+// this license (the "Software") to use, execute, and to prepare
+// derivative works of the Software, all subject to the
+// "GNU Lesser General Public License (LGPL)".
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+// SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+// FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+
+
+
+#ifndef OSS_RAFTTCPCONNECTION_H_INCLUDED
+#define OSS_RAFTTCPCONNECTION_H_INCLUDED
+
+
+#include "OSS/build.h"
+#if ENABLE_FEATURE_NET_EXTRA
+
+#include "OSS/OSS.h"
+#include "OSS/UTL/Thread.h"
+#include "OSS/Net/FramedTcpClient.h"
+#include "OSS/RAFT/RaftNode.h"
+#include "OSS/RAFT/RaftConnection.h"
+#include <boost/asio.hpp>
+#include <string>
+
+
+namespace OSS {
+namespace RAFT {
+
+
+#define RAFT_TCP_RECONNECT_INTERVAL_MS 500
+#define RAFT_TCP_MAX_PENDING_MESSAGES 4096
+
+
+class RaftTcpMessage
+  /// A RAFT message as carried in one FramedTcp frame.  It starts with the
+  /// message type and the id of the sending node followed by the fields of
+  /// the message.  Integers are in host byte order like the frame header.
+{
+public:
+  enum Type
+  {
+    REQUEST_VOTE = 1,
+    REQUEST_VOTE_RESPONSE,
+    APPEND_ENTRIES,
+    APPEND_ENTRIES_RESPONSE,
+    INSTALL_SNAPSHOT,
+    INSTALL_SNAPSHOT_RESPONSE,
+    FORWARD
+      /// Application data sent to the leader by a follower
+  };
+
+  enum
+  {
+    ENTRY_OVERHEAD = 4 * sizeof(int)
+      /// Encoded size of a log entry without its data
+  };
+
+  RaftTcpMessage(Type type, int from);
+    /// Starts a message for writing
+
+  RaftTcpMessage(const char* data, std::size_t len);
+    /// Reads a received message.  data must outlive the object.
+
+  bool isValid() const;
+    /// Returns false if a received message is too short for its header
+
+  Type getType() const;
+  int getFrom() const;
+
+  void write(int value);
+  void write(OSS::UInt64 value);
+  void write(const char* data, unsigned int len);
+    /// Writes len followed by the bytes
+
+  bool read(int& value);
+  bool read(OSS::UInt64& value);
+  bool read(const char*& data, unsigned int& len);
+    /// Points data at the bytes inside the received message
+
+  const std::string& data() const;
+  std::size_t size() const;
+
+  std::size_t getRemaining() const;
+    /// Returns the number of bytes of a received message not read yet
+
+private:
+  Type _type;
+  int _from;
+  std::string _data;
+  const char* _pRead;
+  std::size_t _readLen;
+  std::size_t _readPos;
+};
+
+
+class RaftTcpConnection : public RaftConnection
+  /// Sends RAFT messages to one peer over a FramedTcpClient connection.
+  ///
+  /// Messages are encoded by the caller and written by a thread of their
+  /// own so the RAFT mutex is never held across a connect or a blocking
+  /// write.  The peer answers over its own connection to our listener.  A
+  /// peer that is down costs one connect attempt every
+  /// RAFT_TCP_RECONNECT_INTERVAL_MS.  Messages are dropped meanwhile.  RAFT
+  /// resends whatever is still needed with the next heartbeat.
+{
+public:
+  RaftTcpConnection(RaftConsensus* pRaft, RaftNode& node, const std::string& address, const std::string& port);
+  ~RaftTcpConnection();
+
+  void shutdown();
+  int onSendRequestVote(msg_requestvote_t& data);
+  int onSendAppendEntries(msg_appendentries_t& data);
+  int onSendRequestVoteResponse(msg_requestvote_response_t& data);
+  int onSendAppendEntriesResponse(msg_appendentries_response_t& data);
+  int onSendInstallSnapshot(msg_installsnapshot_t& data);
+  int onSendInstallSnapshotResponse(msg_installsnapshot_response_t& data);
+
+  int sendForward(const std::string& data);
+    /// Sends application data to the peer.  Used to pass writes to the leader.
+
+  const std::string& getAddress() const;
+  const std::string& getPort() const;
+
+private:
+  int send(const RaftTcpMessage& message);
+  void write(const std::string& data);
+
+  boost::asio::io_service _ioService;
+  boost::asio::io_service::work* _pWork;
+  boost::thread* _pThread;
+  OSS::FramedTcpClient _client;
+  std::string _address;
+  std::string _port;
+  OSS::UInt64 _lastConnectAttempt;
+  int _pendingCount;
+  OSS::mutex_critic_sec _pendingMutex;
+};
+
+
+//
+// Inlines
+//
+
+inline bool RaftTcpMessage::isValid() const
+{
+  return _type != 0;
+}
+
+inline RaftTcpMessage::Type RaftTcpMessage::getType() const
+{
+  return _type;
+}
+
+inline int RaftTcpMessage::getFrom() const
+{
+  return _from;
+}
+
+inline const std::string& RaftTcpMessage::data() const
+{
+  return _data;
+}
+
+inline std::size_t RaftTcpMessage::size() const
+{
+  return _data.size();
+}
+
+inline std::size_t RaftTcpMessage::getRemaining() const
+{
+  return _readLen - _readPos;
+}
+
+inline const std::string& RaftTcpConnection::getAddress() const
+{
+  return _address;
+}
+
+inline const std::string& RaftTcpConnection::getPort() const
+{
+  return _port;
+}
+
+
+} } // OSS::RAFT
+
+#endif // ENABLE_FEATURE_NET_EXTRA
+#endif // OSS_RAFTTCPCONNECTION_H_INCLUDED
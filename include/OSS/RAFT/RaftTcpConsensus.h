@@ -0,0 +1,102 @@
+// Library: OSS_CORE - Foundation API for SIP B2BUA
+// Copyright (c) OSS Software Solutions
+// Contributor: Joegen Baclor - mailto:joegen@ossapp.com
+//
+// Permission is hereby granted, to any person or organization
+// obtaining a copy of the software and accompanying documentation covered by
+// this license (the "Software") to use, execute, and to prepare
+// derivative works of the Software, all subject to the
+// "GNU Lesser General Public License (LGPL)".
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+// SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+// FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+
+
+
+#ifndef OSS_RAFTTCPCONSENSUS_H_INCLUDED
+#define OSS_RAFTTCPCONSENSUS_H_INCLUDED
+
+
+#include "OSS/build.h"
+#if ENABLE_FEATURE_NET_EXTRA
+
+#include "OSS/RAFT/RaftConsensus.h"
+#include "OSS/RAFT/RaftTcpConnection.h"
+#include "OSS/Net/FramedTcpListener.h"
+#include <map>
+
+
+namespace OSS {
+namespace RAFT {
+
+
+class RaftTcpConsensus : public RaftConsensus
+  /// RaftConsensus with its nodes talking over TCP.
+  ///
+  /// Every node listens on a FramedTcpListener and reaches each peer with
+  /// a RaftTcpConnection of its own.  A message is answered over the
+  /// connection of the answering node so each direction has a single
+  /// writer.  Incoming messages are handled on the listener thread.
+{
+public:
+  RaftTcpConsensus();
+  virtual ~RaftTcpConsensus();
+
+  bool listen(const std::string& address, const std::string& port);
+    /// Starts accepting messages from the other nodes
+
+  bool addPeer(int node_id, const std::string& address, const std::string& port);
+    /// Adds a voting node reachable at address and port
+
+  void close();
+    /// Stops the listener and drops the peer connections.  stop() the
+    /// RAFT thread first.
+
+  bool forward(const std::string& data);
+    /// Submits data if this node is the leader.  A follower sends it to the
+    /// leader instead.  Returns false if no leader is known.
+
+  virtual Connection::Ptr createConnection(Node& node);
+
+  virtual void onReceivedForward(int node_id, const std::string& data);
+    /// Called on the leader for data a follower passed to forward().  The
+    /// default submits it.
+
+  void onIncomingMessage(const char* data, std::size_t len);
+    /// Decodes a RaftTcpMessage and hands it to the RAFT protocol handlers
+
+private:
+  class Listener : public OSS::FramedTcpListener
+  {
+  public:
+    Listener(RaftTcpConsensus& raft);
+    void onIncomingRequest(FramedTcpConnection& connection, const char* data, std::size_t len);
+  private:
+    RaftTcpConsensus& _raft;
+  };
+
+  struct PeerAddress
+  {
+    std::string address;
+    std::string port;
+  };
+  typedef std::map<int, PeerAddress> PeerAddresses;
+
+  Listener _listener;
+  boost::asio::io_service::work* _pListenerWork;
+  boost::thread* _pListenerThread;
+  PeerAddresses _peerAddresses;
+  OSS::mutex_critic_sec _peerMutex;
+};
+
+
+} } // OSS::RAFT
+
+#endif // ENABLE_FEATURE_NET_EXTRA
+#endif // OSS_RAFTTCPCONSENSUS_H_INCLUDED
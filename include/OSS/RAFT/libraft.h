@@ -682,6 +682,33 @@ int raft_entry_is_voting_cfg_change(raft_entry_t* ety);
  * @return 1 if this is a configuration change. */
 int raft_entry_is_cfg_change(raft_entry_t* ety);
 
+/** Remove all entries up to and including idx from the log.
+ * The entries must already be applied and captured by a snapshot taken at
+ * idx. log_poll is called for every entry removed.
+ * @param[in] idx The last index covered by the snapshot
+ * @param[in] term The term of the entry at idx
+ * @return 0 on success; -1 if idx has not been applied yet */
+int raft_compact_log(raft_server_t* me_, int idx, int term);
+
+/** Replace the whole log with a snapshot taken at idx.
+ * Used by a follower that received a snapshot from the leader and when
+ * restarting from a saved snapshot. Entries are dropped without calling
+ * log_pop. The commit and applied indexes move up to idx.
+ * @param[in] idx The last index covered by the snapshot
+ * @param[in] term The term of the entry at idx */
+void raft_load_snapshot(raft_server_t* me_, int idx, int term);
+
+/** @return the last index covered by the latest snapshot, 0 if none */
+int raft_get_snapshot_last_idx(raft_server_t* me_);
+
+/** @return the term of the last entry covered by the latest snapshot */
+int raft_get_snapshot_last_term(raft_server_t* me_);
+
+/** Process an InstallSnapshot request header from node.
+ * Steps down and records the sender as leader like an appendentries would.
+ * @return 0 if the request is from the current term; -1 if it is stale */
+int raft_recv_installsnapshot(raft_server_t* me_, raft_node_t* node, int term);
+
 #endif /* RAFT_H_ */
 #ifndef RAFT_LOG_H_
 #define RAFT_LOG_H_
@@ -718,6 +745,10 @@ void log_empty(log_t * me_);
  * @return oldest entry */
 void *log_poll(log_t * me_);
 
+/**
+ * Empty the queue and continue numbering after idx */
+void log_load_from_snapshot(log_t * me_, int idx);
+
 raft_entry_t* log_get_from_idx(log_t* me_, int idx, int *n_etys);
 
 raft_entry_t* log_get_at_idx(log_t* me_, int idx);
@@ -792,6 +823,10 @@ typedef struct {
 
     /* the log which has a voting cfg change, otherwise -1 */
     int voting_cfg_change_log_idx;
+
+    /* last index and term covered by the latest snapshot */
+    int snapshot_last_idx;
+    int snapshot_last_term;
 } raft_server_private_t;
 
 void raft_election_start(raft_server_t* me);
@@ -0,0 +1,148 @@
+// Library: OSS_CORE - Foundation API for SIP B2BUA
+// Copyright (c) OSS Software Solutions
+// Contributor: Joegen Baclor - mailto:joegen@ossapp.com
+//
+// Permission is hereby granted, to any person or organization
+// obtaining a copy of the software and accompanying documentation covered by
+// this license (the "Software") to use, execute, and to prepare
+// derivative works of the Software, all subject to the
+// "GNU Lesser General Public License (LGPL)".
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+// SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+// FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+
+
+#ifndef SIPB2BRAFTDATASTORE_H_INCLUDED
+#define	SIPB2BRAFTDATASTORE_H_INCLUDED
+
+#include "OSS/build.h"
+#if ENABLE_FEATURE_B2BUA && ENABLE_FEATURE_NET_EXTRA
+
+#include <deque>
+#include <boost/thread/condition_variable.hpp>
+
+#include "OSS/RAFT/RaftTcpConsensus.h"
+#include "OSS/SIP/B2BUA/SIPB2BDialogStateManager.h"
+
+
+namespace OSS {
+namespace SIP {
+namespace B2BUA {
+
+
+#define SIP_B2B_RAFT_MAX_BATCH_SIZE 1048576
+
+
+class SIPB2BRaftDataStore : public OSS::RAFT::RaftTcpConsensus
+  /// Dialog and registration state shared by every B2BUA of a cluster
+  /// through a RAFT replicated log.
+  ///
+  /// attach() points the callbacks of a SIPB2BDialogDataStoreCb at this
+  /// object.  Updates are queued and written as one log entry per batch.
+  /// While a batch is being committed the updates that arrive meanwhile are
+  /// collected for the next one.  A follower forwards its batches to the
+  /// leader.  Every node applies the committed entries to its own copy of
+  /// the state so reads never leave the node.  A follower may lag behind
+  /// the leader by the time it takes to learn about a commit.
+  ///
+  /// A batch carries the id of the node that created it and a sequence
+  /// number.  A batch that is resent because a leader went away before
+  /// committing it is applied only once.
+{
+public:
+  SIPB2BRaftDataStore();
+  ~SIPB2BRaftDataStore();
+
+  void attach(SIPB2BDialogDataStoreCb& dataStore);
+    /// Makes dataStore keep its dialogs and registrations here
+
+  //
+  // SIPB2BDialogDataStoreCb callbacks.  Writes return once the update is
+  // queued.
+  //
+  bool persist(const DialogData& dialogData);
+  void getAll(DialogList& dialogs);
+  void removeSession(const std::string& sessionId);
+  void removeAllDialogs(const std::string& callId);
+  bool persistReg(const RegData& regData);
+  bool getOneReg(const std::string& regId, RegData& regData);
+  bool getReg(const std::string& regIdPrefix, RegList& regs);
+  void removeReg(const std::string& regId);
+  void removeAllReg(const std::string& regIdPrefix);
+  void getAllReg(RegList& regs);
+
+  bool hasDialog(const std::string& sessionId);
+  std::size_t getDialogCount();
+  std::size_t getRegistrationCount();
+
+  bool waitForPending(int timeoutMs);
+    /// Waits until every update queued on this node has been applied here
+
+  //
+  // RaftConsensus state machine
+  //
+  int onApplyEntry(const raft_entry_t& entry);
+  bool onCreateSnapshot(std::string& data);
+  bool onInstallSnapshot(const std::string& data);
+
+protected:
+  enum Operation
+  {
+    PERSIST_DIALOG = 1,
+    REMOVE_SESSION,
+    REMOVE_ALL_DIALOGS,
+    PERSIST_REG,
+    REMOVE_REG,
+    REMOVE_ALL_REG
+  };
+
+  void queueUpdate(Operation operation, const std::string& key, const std::string& callId, const std::string& value);
+  void runWriter();
+  bool applyBatch(const char* data, std::size_t len);
+
+  struct Dialog
+  {
+    std::string callId;
+    std::string json;
+  };
+
+  struct Origin
+  {
+    Origin() : epoch(0), sequence(0) {}
+    OSS::UInt64 epoch;      /// start time of the node that sent the batch
+    OSS::UInt64 sequence;   /// last batch applied from that node
+  };
+
+  typedef std::map<std::string, Dialog> Dialogs;
+  typedef std::map<std::string, std::string> Registry;
+  typedef std::map<int, Origin> Origins;
+  typedef std::deque<std::string> Updates;
+
+  Dialogs _dialogs;
+  Registry _registry;
+  Origins _origins;
+  OSS::mutex_critic_sec _storageMutex;
+
+  Updates _pendingUpdates;
+  std::string _inFlight;
+  OSS::UInt64 _epoch;
+  OSS::UInt64 _sequence;
+  OSS::UInt64 _appliedSequence;
+  bool _terminating;
+  OSS::mutex_critic_sec _queueMutex;
+  boost::condition_variable _queueCondition;
+  boost::thread* _pWriterThread;
+};
+
+
+} } } // OSS::SIP::B2BUA
+
+#endif // ENABLE_FEATURE_B2BUA && ENABLE_FEATURE_NET_EXTRA
+
+#endif // SIPB2BRAFTDATASTORE_H_INCLUDED
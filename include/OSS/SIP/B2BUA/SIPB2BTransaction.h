@@ -215,10 +215,6 @@ protected:
   void releaseInternalRef();
     /// release the internal reference and signal transaction destruction
 
-  OSS::dns_srv_record_list _udpSrvTargets;
-  OSS::dns_srv_record_list _tcpSrvTargets;
-  OSS::dns_srv_record_list _wsSrvTargets;
-  OSS::dns_srv_record_list _tlsSrvTargets;
   OSS::Net::IPAddress _localInterface;
   SIPB2BDialogData _dialogData;
   bool _isChallenged;
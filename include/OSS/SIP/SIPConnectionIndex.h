@@ -0,0 +1,252 @@
+// Library: OSS_CORE - Foundation API for SIP B2BUA
+// Copyright (c) OSS Software Solutions
+// Contributor: Joegen Baclor - mailto:joegen@ossapp.com
+//
+// Permission is hereby granted, to any person or organization
+// obtaining a copy of the software and accompanying documentation covered by
+// this license (the "Software") to use, execute, and to prepare
+// derivative works of the Software, all subject to the
+// "GNU Lesser General Public License (LGPL)".
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+// SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+// FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+
+
+#ifndef SIP_SIPConnectionIndex_INCLUDED
+#define SIP_SIPConnectionIndex_INCLUDED
+
+
+#include <map>
+#include <string>
+#include <boost/asio.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/unordered_map.hpp>
+#include <boost/cstdint.hpp>
+#include <boost/functional/hash.hpp>
+#include "OSS/OSS.h"
+#include "OSS/Net/IPAddress.h"
+#include "OSS/UTL/Thread.h"
+
+
+namespace OSS {
+namespace SIP {
+
+
+struct SIPConnectionKey
+  /// Remote IP, port and transport scheme of a connection
+{
+  boost::asio::ip::address address;
+  unsigned short port;
+  std::string transport;
+
+  SIPConnectionKey() : port(0)
+  {
+  }
+
+  SIPConnectionKey(const OSS::Net::IPAddress& remote, const std::string& transport_) :
+    address(remote.address()),
+    port(remote.getPort()),
+    transport(transport_)
+  {
+  }
+
+  bool operator == (const SIPConnectionKey& key) const
+  {
+    return port == key.port && address == key.address && transport == key.transport;
+  }
+};
+
+inline std::size_t hash_value(const SIPConnectionKey& key)
+{
+  //
+  // Connections from a single NAT or proxy share the address and only differ
+  // by port, so fold everything into one word and mix it well instead of
+  // relying on hash_combine.
+  //
+  boost::uint64_t value = 0;
+  if (key.address.is_v4())
+  {
+    value = key.address.to_v4().to_ulong();
+  }
+  else
+  {
+    boost::asio::ip::address_v6::bytes_type bytes = key.address.to_v6().to_bytes();
+    for (std::size_t i = 0; i < bytes.size(); i++)
+    {
+      value = (value * 131) ^ bytes[i];
+    }
+  }
+  value = (value << 16) ^ key.port;
+  value ^= (boost::uint64_t)boost::hash_value(key.transport) << 48;
+  value *= 0xff51afd7ed558ccdULL;
+  value ^= value >> 33;
+  value *= 0xc4ceb9fe1a85ec53ULL;
+  value ^= value >> 33;
+  return (std::size_t)value;
+}
+
+
+template <typename Connection>
+class SIPConnectionIndex : boost::noncopyable
+  /// Maps the remote address of a connection to the connection itself.
+  ///
+  /// The table is split into stripes selected by the key hash.  Each stripe
+  /// owns its own read-write lock so lookups for different peers never
+  /// contend with each other or with the add and remove of unrelated
+  /// connections.  Lookups are a single hash probe instead of a scan over
+  /// every connection held by the manager.
+  ///
+  /// Entries are keyed by the remote address as it was known when the
+  /// connection was added.  The index remembers that key per identifier so
+  /// removal does not depend on the socket still being able to report its
+  /// peer.
+{
+public:
+  typedef boost::shared_ptr<Connection> ConnectionPtr;
+
+  enum
+  {
+    STRIPE_COUNT = 64
+  };
+
+  SIPConnectionIndex()
+  {
+  }
+
+  ~SIPConnectionIndex()
+  {
+  }
+
+  bool add(OSS::UInt64 identifier, const OSS::Net::IPAddress& remote, const std::string& transport, const ConnectionPtr& conn)
+    /// Index the connection.  A previous entry for the same identifier is
+    /// replaced.  If another connection is indexed under the same address,
+    /// the most recent one wins.  Returns false if the address is not valid.
+  {
+    if (!remote.isValid())
+    {
+      return false;
+    }
+
+    SIPConnectionKey key(remote, transport);
+    OSS::mutex_critic_sec_lock lock(_identifiersMutex);
+    typename Identifiers::iterator iter = _identifiers.find(identifier);
+    if (iter == _identifiers.end())
+    {
+      _identifiers[identifier] = key;
+    }
+    else if (!(iter->second == key))
+    {
+      erase(iter->second, identifier);
+      iter->second = key;
+    }
+
+    Stripe& stripe = getStripe(key);
+    OSS::mutex_write_lock wlock(stripe.mutex);
+    Entry& entry = stripe.connections[key];
+    entry.identifier = identifier;
+    entry.connection = conn;
+    return true;
+  }
+
+  void remove(OSS::UInt64 identifier)
+    /// Remove the entry for the connection if there is one
+  {
+    OSS::mutex_critic_sec_lock lock(_identifiersMutex);
+    typename Identifiers::iterator iter = _identifiers.find(identifier);
+    if (iter == _identifiers.end())
+    {
+      return;
+    }
+    erase(iter->second, identifier);
+    _identifiers.erase(iter);
+  }
+
+  ConnectionPtr find(const OSS::Net::IPAddress& remote, const std::string& transport) const
+    /// Returns the connection to remote or a null pointer
+  {
+    SIPConnectionKey key(remote, transport);
+    const Stripe& stripe = getStripe(key);
+    OSS::mutex_read_lock rlock(stripe.mutex);
+    typename Connections::const_iterator iter = stripe.connections.find(key);
+    if (iter != stripe.connections.end())
+    {
+      return iter->second.connection;
+    }
+    return ConnectionPtr();
+  }
+
+  void clear()
+    /// Remove all entries
+  {
+    OSS::mutex_critic_sec_lock lock(_identifiersMutex);
+    for (std::size_t i = 0; i < STRIPE_COUNT; i++)
+    {
+      OSS::mutex_write_lock wlock(_stripes[i].mutex);
+      _stripes[i].connections.clear();
+    }
+    _identifiers.clear();
+  }
+
+  std::size_t size() const
+    /// Returns the number of indexed connections
+  {
+    OSS::mutex_critic_sec_lock lock(_identifiersMutex);
+    return _identifiers.size();
+  }
+
+private:
+  struct Entry
+  {
+    OSS::UInt64 identifier;
+    ConnectionPtr connection;
+    Entry() : identifier(0) {}
+  };
+  typedef boost::unordered_map<SIPConnectionKey, Entry> Connections;
+  typedef std::map<OSS::UInt64, SIPConnectionKey> Identifiers;
+
+  struct Stripe
+  {
+    mutable OSS::mutex_read_write mutex;
+    Connections connections;
+  };
+
+  Stripe& getStripe(const SIPConnectionKey& key)
+  {
+    return _stripes[(hash_value(key) >> 24) % STRIPE_COUNT];
+  }
+
+  const Stripe& getStripe(const SIPConnectionKey& key) const
+  {
+    return _stripes[(hash_value(key) >> 24) % STRIPE_COUNT];
+  }
+
+  void erase(const SIPConnectionKey& key, OSS::UInt64 identifier)
+  {
+    //
+    // Only drop the entry if it still belongs to this connection.  A newer
+    // connection to the same peer may have taken over the slot.
+    //
+    Stripe& stripe = getStripe(key);
+    OSS::mutex_write_lock wlock(stripe.mutex);
+    typename Connections::iterator iter = stripe.connections.find(key);
+    if (iter != stripe.connections.end() && iter->second.identifier == identifier)
+    {
+      stripe.connections.erase(iter);
+    }
+  }
+
+  Stripe _stripes[STRIPE_COUNT];
+  mutable OSS::mutex_critic_sec _identifiersMutex;
+  Identifiers _identifiers;
+};
+
+
+} } // OSS::SIP
+#endif // SIP_SIPConnectionIndex_INCLUDED
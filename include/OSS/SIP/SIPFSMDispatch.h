@@ -29,6 +29,8 @@
 #include "OSS/SIP/SIPIstPool.h"
 #include "OSS/SIP/SIPNistPool.h"
 #include "OSS/SIP/SIPTransportService.h"
+#include "OSS/SIP/SIPOverloadControl.h"
+#include "OSS/SIP/SIPIngressQueue.h"
 
 namespace OSS {
 namespace SIP {
@@ -68,6 +70,13 @@ public:
     /// Take note that this is called directly from the 
     /// transport proactor thread and should therefore
     /// not block and result to a transport sleep.
+    ///
+    /// If the ingress queue is running, the message is
+    /// only queued on its priority lane here and processed
+    /// by the ingress queue workers.
+
+  void processMessage(const SIPMessage::Ptr& pMsg, const SIPTransportSession::Ptr& pTransport);
+    /// Parse the message and hand it to its transaction
 
   SIPTransaction::Ptr createClientTransaction(const SIPMessage::Ptr& pRequest);
     /// Create a new transaction for a new non-ACK outgoing request
@@ -128,7 +137,18 @@ public:
 
   bool getEnableIctForking() const;
     // Returns true if ICT forking is enabled
+
+  SIPOverloadControl& overloadControl();
+    /// Returns the admission control applied to new INVITE requests
+
+  SIPIngressQueue& ingressQueue();
+    /// Returns the priority lanes incoming messages are queued on.
+    /// Messages are processed on the transport thread unless the queue is started.
 private:
+  void sendOverloadResponse(const SIPMessage::Ptr& pMsg, const SIPTransportSession::Ptr& pTransport);
+    /// Statelessly reject a new INVITE with 503 and Retry-After
+
+
   SIPTransportService _transport;
   SIPIctPool _ict;
   SIPNictPool _nict;
@@ -137,7 +157,10 @@ private:
   SIPTransaction::RequestCallback _requestHandler;
   UnknownTransactionCallback _ackOr2xxTransactionHandler;
   StringPairCache _istBlocker;
+  StringPairCache _overloadBlocker;
   bool _enableIctForking;
+  SIPOverloadControl _overloadControl;
+  SIPIngressQueue _ingressQueue;
 };
 
 
@@ -155,6 +178,16 @@ inline bool SIPFSMDispatch::getEnableIctForking() const
   return _enableIctForking;
 }
 
+inline SIPOverloadControl& SIPFSMDispatch::overloadControl()
+{
+  return _overloadControl;
+}
+
+inline SIPIngressQueue& SIPFSMDispatch::ingressQueue()
+{
+  return _ingressQueue;
+}
+
 inline SIPTransportService& SIPFSMDispatch::transport()
 {
   return _transport;
@@ -0,0 +1,180 @@
+// Library: OSS_CORE - Foundation API for SIP B2BUA
+// Copyright (c) OSS Software Solutions
+// Contributor: Joegen Baclor - mailto:joegen@ossapp.com
+//
+// Permission is hereby granted, to any person or organization
+// obtaining a copy of the software and accompanying documentation covered by
+// this license (the "Software") to use, execute, and to prepare
+// derivative works of the Software, all subject to the
+// "GNU Lesser General Public License (LGPL)".
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+// SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+// FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+
+
+#ifndef SIP_SIPIngressQueue_INCLUDED
+#define SIP_SIPIngressQueue_INCLUDED
+
+
+#include <deque>
+#include <map>
+#include <set>
+#include <vector>
+#include <boost/function.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/thread.hpp>
+#include "OSS/OSS.h"
+#include "OSS/UTL/Thread.h"
+#include "OSS/SIP/SIPMessage.h"
+#include "OSS/SIP/SIPTransportSession.h"
+
+
+namespace OSS {
+namespace SIP {
+
+
+class OSS_API SIPIngressQueue : boost::noncopyable
+  /// Priority lanes between the transport and the transaction layer.
+  ///
+  /// Incoming messages are classified from their raw start line (and the
+  /// To tag for INVITEs) before they are parsed, and queued on one of four
+  /// lanes.  Each lane is bounded.  A message arriving on a full lane is
+  /// dropped and counted.
+  ///
+  /// Worker threads serve the lanes by weighted round robin.  Within a
+  /// round every lane may hand out as many messages as its weight, higher
+  /// priority lanes first.  A new round starts once every non-empty lane
+  /// has used up its weight, so an idle lane never holds back the others
+  /// and a REGISTER flood cannot starve responses or BYEs.
+  ///
+  /// Messages on different lanes may be processed out of arrival order.
+  /// Messages of the same call (Call-ID) are never handed to two workers
+  /// at once, and within a lane they are handed out in arrival order.
+  /// A CANCEL, or the ACK for a non-2xx response, whose INVITE is still
+  /// queued on the new INVITE lane is queued on that lane as well.
+{
+public:
+  enum Lane
+  {
+    LANE_RESPONSE, /// All responses
+    LANE_IN_DIALOG, /// ACK, BYE, CANCEL, PRACK, UPDATE, INFO, REFER, NOTIFY and re-INVITE
+    LANE_NEW_INVITE, /// INVITE without a To tag
+    LANE_BACKGROUND, /// REGISTER, OPTIONS, SUBSCRIBE, PUBLISH, MESSAGE and unknown methods
+    LANE_MAX
+  };
+
+  enum
+  {
+    DEFAULT_LANE_CAPACITY = 4096,
+    DEFAULT_THREAD_COUNT = 2
+  };
+
+  typedef boost::function<void(const SIPMessage::Ptr&, const SIPTransportSession::Ptr&)> Handler;
+
+  struct LaneStats
+  {
+    std::size_t depth; /// Messages currently queued
+    std::size_t highWaterMark; /// Largest depth observed
+    std::size_t capacity; /// Maximum depth
+    unsigned int weight; /// Messages served per round
+    OSS::UInt64 enqueued; /// Messages accepted
+    OSS::UInt64 dispatched; /// Messages handed to the handler
+    OSS::UInt64 dropped; /// Messages refused because the lane was full
+    OSS::UInt64 averageWait; /// Average time in milliseconds between enqueue and dispatch
+    OSS::UInt64 maxWait; /// Largest time in milliseconds between enqueue and dispatch
+  };
+
+  SIPIngressQueue();
+    /// Creates a stopped queue with the default lane capacities and weights
+
+  ~SIPIngressQueue();
+    /// Stops the workers.  Queued messages are discarded.
+
+  void setHandler(const Handler& handler);
+    /// Set the function that processes dequeued messages.  Must be set before start().
+
+  void setLaneCapacity(Lane lane, std::size_t capacity);
+    /// Set the maximum number of messages queued on a lane
+
+  void setLaneWeight(Lane lane, unsigned int weight);
+    /// Set the number of messages a lane may hand out per round.  The minimum is one.
+
+  void start(std::size_t threadCount = DEFAULT_THREAD_COUNT);
+    /// Start the worker threads
+
+  void stop();
+    /// Stop the worker threads and discard queued messages
+
+  bool isRunning() const;
+    /// Returns true if the worker threads are running
+
+  bool enqueue(const SIPMessage::Ptr& pMsg, const SIPTransportSession::Ptr& pTransport);
+    /// Classify and queue a message.  Returns false if the lane is full.
+
+  bool enqueue(Lane lane, const SIPMessage::Ptr& pMsg, const SIPTransportSession::Ptr& pTransport);
+    /// Queue a message on the given lane.  A CANCEL or ACK matching a queued
+    /// new INVITE is moved to the new INVITE lane.  Returns false if the lane is full.
+
+  bool dispatchOne();
+    /// Hand the next scheduled message to the handler on the calling thread.
+    /// Returns false if all lanes are empty.
+
+  LaneStats getLaneStats(Lane lane) const;
+    /// Returns a snapshot of the lane counters
+
+  static Lane classify(const SIPMessage::Ptr& pMsg);
+    /// Determine the lane of an unparsed message
+
+  static Lane classify(const std::string& data);
+    /// Determine the lane of raw message data
+
+  static const char* getLaneName(Lane lane);
+    /// Returns a printable name for the lane
+
+private:
+  struct Item
+  {
+    SIPMessage::Ptr message;
+    SIPTransportSession::Ptr transport;
+    OSS::UInt64 enqueueTime;
+    std::string inviteBranch; /// Via branch of a queued new INVITE
+    std::size_t callKey; /// Hash of the Call-ID.  Zero if there is none.
+  };
+
+  struct LaneState
+  {
+    std::deque<Item> items;
+    std::size_t capacity;
+    std::size_t highWaterMark;
+    unsigned int weight;
+    unsigned int credit;
+    OSS::UInt64 enqueued;
+    OSS::UInt64 dispatched;
+    OSS::UInt64 dropped;
+    OSS::UInt64 totalWait;
+    OSS::UInt64 maxWait;
+  };
+
+  bool next(Item& item);
+  void release(const Item& item);
+  void run();
+
+  mutable OSS::mutex_critic_sec _mutex;
+  boost::condition_variable _ready;
+  LaneState _lanes[LANE_MAX];
+  std::map<std::string, unsigned int> _pendingInvites; /// Via branches of the INVITEs on the new INVITE lane
+  std::set<std::size_t> _activeCalls; /// Call keys of the messages being handled
+  Handler _handler;
+  std::vector<boost::thread*> _threads;
+  bool _isRunning;
+};
+
+
+} } // OSS::SIP
+#endif // SIP_SIPIngressQueue_INCLUDED
@@ -414,6 +414,20 @@ public:
     /// To simply remove the first element in a list header,
     /// use hdrListPopFront instead.
   
+  void hdrGetAll(SIPHeaderList& headers, std::string& startLine) const;
+    /// Copies the start line and every header list under a single read lock.
+    ///
+    /// The header list is keyed by the lower case header name.  This is
+    /// meant for consumers like the script engine that would otherwise
+    /// call hdrGet() dozens of times per message.
+
+  bool hdrCommit(const SIPHeaderList& headers, const std::string& startLine = "");
+    /// Applies a batch of header changes under a single write lock.
+    ///
+    /// Each entry replaces the entire header list of the same (lower case) name.
+    /// An entry with no elements removes the header.  If startLine is not empty,
+    /// it replaces the current start line.
+
    const std::string& hdrListBottom(const char* headerName) const;
     /// Returns the last header in the list.
     ///
@@ -636,6 +650,15 @@ public:
   void setData(const std::string& data);
     /// Set the input for parsing
 
+  void setData(const char* data, std::size_t len);
+    /// Set the input for parsing.  Reuses the capacity of the current buffer.
+
+  void reset();
+    /// Return the message to the state of a newly constructed one.
+    /// String buffers keep their capacity so a recycled message can take
+    /// in a new packet without allocating.  The header list is emptied, so
+    /// the next parse() allocates its entries again.
+
   void setProperty(const std::string& property, const std::string& value);
     /// Set a custom property for this message.
     /// Custom properties are meant to simply hold
@@ -678,6 +701,15 @@ public:
   OSS_HANDLE& userData();
     /// Returns a reference to the user data
 
+  void setReceiveTime(OSS::UInt64 receiveTime);
+    /// Set the time in milliseconds when the transport read this message.
+    /// Like custom properties, the receive time is never inherited
+    /// when copying sip messages to another.
+
+  OSS::UInt64 getReceiveTime() const;
+    /// Returns the time in milliseconds when the transport read this message
+    /// or zero if the message did not come from the network.
+
   std::string createContextId(bool formatTabAndSpaces = false) const;
     /// Creates a 32 bit context id.  This is normally used for
     /// tagging transactions belonging to the same call-id.
@@ -761,6 +793,7 @@ protected:
   mutable boost::tribool _isRequest;
   CustomProperties _properties;
   OSS_HANDLE _userData;
+  OSS::UInt64 _receiveTime;
   std::string _idleBuffer;
   mutable std::string _logContext;
 };
@@ -795,6 +828,16 @@ inline OSS_HANDLE& SIPMessage::userData()
   return _userData;
 }
 
+inline void SIPMessage::setReceiveTime(OSS::UInt64 receiveTime)
+{
+  _receiveTime = receiveTime;
+}
+
+inline OSS::UInt64 SIPMessage::getReceiveTime() const
+{
+  return _receiveTime;
+}
+
 inline std::string SIPMessage::createLoggerData() const
 {
   return createLoggerData(const_cast<SIPMessage*>(this));
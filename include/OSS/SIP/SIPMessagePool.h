@@ -0,0 +1,95 @@
+// Library: OSS_CORE - Foundation API for SIP B2BUA
+// Copyright (c) OSS Software Solutions
+// Contributor: Joegen Baclor - mailto:joegen@ossapp.com
+//
+// Permission is hereby granted, to any person or organization
+// obtaining a copy of the software and accompanying documentation covered by
+// this license (the "Software") to use, execute, and to prepare
+// derivative works of the Software, all subject to the
+// "GNU Lesser General Public License (LGPL)".
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+// SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+// FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+
+
+#ifndef SIP_SIPMessagePool_INCLUDED
+#define SIP_SIPMessagePool_INCLUDED
+
+
+#include <vector>
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+#include "OSS/OSS.h"
+#include "OSS/UTL/Thread.h"
+#include "OSS/SIP/SIPMessage.h"
+
+
+namespace OSS {
+namespace SIP {
+
+
+class OSS_API SIPMessagePool : boost::noncopyable
+  /// Recycles SIPMessage objects for the receive path.
+  ///
+  /// acquire() hands out a message wrapped in a SIPMessage::Ptr whose
+  /// deleter resets the message and puts it back on the free list once the
+  /// last reference drops, no matter which thread drops it.  The reference
+  /// count block is carved from a fixed size pool and the data buffer keeps
+  /// its capacity, so acquiring and filling a recycled message does not
+  /// allocate.  parse() still builds a fresh header list because reset()
+  /// empties it.
+  ///
+  /// Messages whose data buffer grew beyond MAX_RECYCLED_DATA are deleted
+  /// instead of recycled so one large packet does not pin its memory
+  /// forever.  Messages may outlive the pool.
+{
+public:
+  enum
+  {
+    DEFAULT_CAPACITY = 1024,
+    MAX_RECYCLED_DATA = 65536
+  };
+
+  struct Stats
+  {
+    OSS::UInt64 created; /// Messages allocated because the free list was empty
+    OSS::UInt64 reused; /// Messages taken from the free list
+    OSS::UInt64 recycled; /// Messages returned to the free list
+    std::size_t available; /// Messages currently on the free list
+  };
+
+  explicit SIPMessagePool(std::size_t capacity = DEFAULT_CAPACITY);
+    /// Creates a pool that keeps at most capacity idle messages
+
+  ~SIPMessagePool();
+    /// Deletes the idle messages.  Messages still in use are deleted when released.
+
+  SIPMessage::Ptr acquire();
+    /// Returns an empty message
+
+  Stats getStats() const;
+    /// Returns a snapshot of the pool counters
+
+private:
+  class Store;
+  typedef boost::shared_ptr<Store> StorePtr;
+
+  struct Recycler
+  {
+    StorePtr store;
+    explicit Recycler(const StorePtr& store_) : store(store_) {}
+    void operator()(SIPMessage* pMessage);
+  };
+
+  StorePtr _store;
+};
+
+
+} } // OSS::SIP
+#endif // SIP_SIPMessagePool_INCLUDED
@@ -0,0 +1,157 @@
+// Library: OSS_CORE - Foundation API for SIP B2BUA
+// Copyright (c) OSS Software Solutions
+// Contributor: Joegen Baclor - mailto:joegen@ossapp.com
+//
+// Permission is hereby granted, to any person or organization
+// obtaining a copy of the software and accompanying documentation covered by
+// this license (the "Software") to use, execute, and to prepare
+// derivative works of the Software, all subject to the
+// "GNU Lesser General Public License (LGPL)".
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+// SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+// FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+
+
+#ifndef SIP_SIPOverloadControl_INCLUDED
+#define SIP_SIPOverloadControl_INCLUDED
+
+
+#include <boost/noncopyable.hpp>
+#include "OSS/OSS.h"
+#include "OSS/UTL/Thread.h"
+
+
+namespace OSS {
+namespace SIP {
+
+
+class OSS_API SIPOverloadControl : boost::noncopyable
+  /// Queue delay based admission control for new INVITE requests.
+  ///
+  /// The application reports how long each message waited between the
+  /// transport read and the start of its processing.  At the end of every
+  /// control interval the average delay is compared against the delay
+  /// budget.  While the budget is exceeded the reduction percentage is
+  /// raised so that the admitted INVITEs fit into what the server processed
+  /// during the interval.  Once the delay is back within budget the
+  /// reduction is lowered step by step.  This follows the loss based
+  /// algorithm of RFC 7339 with the server acting as its own throttle.
+  ///
+  /// admit() rejects that percentage of new INVITEs.  Rejections are spread
+  /// evenly across arrivals rather than drawn at random.  The dispatcher
+  /// answers rejected INVITEs with 503 and Retry-After before a transaction
+  /// is created.  In-dialog requests and responses are never subjected to
+  /// admission since they complete work the server has already accepted.
+{
+public:
+  enum
+  {
+    DEFAULT_DELAY_BUDGET = 200, /// milliseconds
+    DEFAULT_CONTROL_INTERVAL = 100, /// milliseconds
+    DEFAULT_RETRY_AFTER = 5, /// seconds
+    REDUCTION_STEP = 5,
+    MAX_REDUCTION = 95
+  };
+
+  struct Stats
+  {
+    bool enabled;
+    unsigned int reduction; /// Percentage of new INVITEs currently rejected
+    OSS::UInt64 averageDelay; /// Average queue delay of the last interval in milliseconds
+    OSS::UInt64 maxDelay; /// Largest queue delay of the last interval in milliseconds
+    OSS::UInt64 samples; /// Queue delay samples recorded
+    OSS::UInt64 admitted; /// New INVITEs admitted
+    OSS::UInt64 rejected; /// New INVITEs answered with 503
+    OSS::UInt64 prioritized; /// In-dialog requests and responses passed while overloaded
+    OSS::UInt64 depletions; /// Times the worker pool had no thread available
+  };
+
+  SIPOverloadControl();
+    /// Creates a disabled overload control
+
+  ~SIPOverloadControl();
+    /// Destroys the overload control
+
+  void setEnabled(bool enabled);
+    /// Enable or disable admission control.  Disabling clears the reduction.
+
+  bool isEnabled() const;
+    /// Returns true if admission control is enabled
+
+  void setDelayBudget(OSS::UInt64 delayBudget);
+    /// Set the average queue delay in milliseconds tolerated before new INVITEs are shed
+
+  OSS::UInt64 getDelayBudget() const;
+    /// Returns the delay budget in milliseconds
+
+  void setControlInterval(OSS::UInt64 controlInterval);
+    /// Set how often in milliseconds the reduction is recomputed
+
+  OSS::UInt64 getControlInterval() const;
+    /// Returns the control interval in milliseconds
+
+  void setRetryAfter(unsigned int retryAfter);
+    /// Set the Retry-After value in seconds sent with 503 responses
+
+  unsigned int getRetryAfter() const;
+    /// Returns the Retry-After value in seconds
+
+  void recordQueueDelay(OSS::UInt64 delay);
+  void recordQueueDelay(OSS::UInt64 delay, OSS::UInt64 now);
+    /// Report how long in milliseconds a message waited before processing
+
+  void recordDepletion();
+  void recordDepletion(OSS::UInt64 now);
+    /// Report that the worker pool had no thread available.  This counts
+    /// as a sample twice the delay budget since the wait cannot be measured.
+
+  bool admit();
+  bool admit(OSS::UInt64 now);
+    /// Returns true if a new INVITE may be processed.  Always true while disabled.
+
+  void prioritize();
+    /// Count an in-dialog request or response.  Only messages passed
+    /// while overloaded are counted.
+
+  bool isOverloaded() const;
+    /// Returns true if new INVITEs are currently being shed
+
+  unsigned int getReduction() const;
+    /// Returns the percentage of new INVITEs currently rejected
+
+  Stats getStats() const;
+    /// Returns a snapshot of the counters
+
+private:
+  void evaluate(OSS::UInt64 now);
+
+  mutable OSS::mutex_critic_sec _mutex;
+  bool _enabled;
+  OSS::UInt64 _delayBudget;
+  OSS::UInt64 _controlInterval;
+  unsigned int _retryAfter;
+  unsigned int _reduction;
+  unsigned int _lossCredit;
+  OSS::UInt64 _intervalStart;
+  OSS::UInt64 _intervalOffered;
+  OSS::UInt64 _intervalDelay;
+  OSS::UInt64 _intervalSamples;
+  OSS::UInt64 _intervalMaxDelay;
+  OSS::UInt64 _averageDelay;
+  OSS::UInt64 _maxDelay;
+  OSS::UInt64 _samples;
+  OSS::UInt64 _admitted;
+  OSS::UInt64 _rejected;
+  OSS::UInt64 _prioritized;
+  OSS::UInt64 _depletions;
+};
+
+
+} } // OSS::SIP
+#endif // SIP_SIPOverloadControl_INCLUDED
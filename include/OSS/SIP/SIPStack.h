@@ -283,6 +283,15 @@ public:
   
   SIPTransaction::Ptr createClientTransaction(const SIPMessage::Ptr& pRequest);
     /// Create a new transaction for a new non-ACK outgoing request
+
+  SIPOverloadControl& overloadControl();
+    /// Returns the admission control applied to new INVITE requests.
+    ///
+    /// The application must report the queue delay of the messages it
+    /// processes for the control to take effect.
+
+  SIPIngressQueue& ingressQueue();
+    /// Returns the priority lanes between the transport and the transactions
   
 private:
 
@@ -382,6 +391,16 @@ inline SIPTransaction::Ptr SIPStack::createClientTransaction(const SIPMessage::P
   return _fsmDispatch.createClientTransaction(pRequest);
 }
 
+inline SIPOverloadControl& SIPStack::overloadControl()
+{
+  return _fsmDispatch.overloadControl();
+}
+
+inline SIPIngressQueue& SIPStack::ingressQueue()
+{
+  return _fsmDispatch.ingressQueue();
+}
+
 
 } } // OSS::SIP
 #endif // SIP_SIPStack_INCLUDED
@@ -0,0 +1,125 @@
+// Library: OSS_CORE - Foundation API for SIP B2BUA
+// Copyright (c) OSS Software Solutions
+// Contributor: Joegen Baclor - mailto:joegen@ossapp.com
+//
+// Permission is hereby granted, to any person or organization
+// obtaining a copy of the software and accompanying documentation covered by
+// this license (the "Software") to use, execute, and to prepare
+// derivative works of the Software, all subject to the
+// "GNU Lesser General Public License (LGPL)".
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+// SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+// FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+
+
+#ifndef SIP_SIPStreamFramer_INCLUDED
+#define SIP_SIPStreamFramer_INCLUDED
+
+
+#include <string>
+#include <boost/noncopyable.hpp>
+#include "OSS/OSS.h"
+
+
+namespace OSS {
+namespace SIP {
+
+
+class OSS_API SIPStreamFramer : boost::noncopyable
+  /// Splits a TCP or TLS byte stream into complete SIP messages.
+  ///
+  /// Incoming bytes are read directly into a reusable buffer owned by the
+  /// framer.  Message boundaries are located with memchr() scans for the
+  /// CRLFCRLF header terminator and a single pass over the header block for
+  /// Content-Length, so the stream is never walked a character at a time.
+  /// Each complete frame is handed out as a contiguous range that can be
+  /// given to the regular SIPMessage parser.  Any number of pipelined
+  /// messages can be sliced out of a single read.
+{
+public:
+  enum FrameResult
+  {
+    FRAME_INCOMPLETE, /// More bytes are needed
+    FRAME_COMPLETE,   /// A complete SIP message is available
+    FRAME_KEEP_ALIVE, /// A CRLFCRLF keep-alive ping was consumed (RFC 5626)
+    FRAME_ERROR       /// The stream cannot be framed.  Buffered data was discarded.
+  };
+
+  enum
+  {
+    DEFAULT_MAX_HEADER_SIZE = 65536,
+    DEFAULT_MAX_BODY_SIZE = 1048576
+  };
+
+  SIPStreamFramer(std::size_t maxHeaderSize = DEFAULT_MAX_HEADER_SIZE, std::size_t maxBodySize = DEFAULT_MAX_BODY_SIZE);
+    /// Creates an empty framer
+
+  ~SIPStreamFramer();
+    /// Destroys the framer and its buffer
+
+  char* prepare(std::size_t size);
+    /// Returns a write pointer with room for at least size bytes.
+    /// The pointer remains valid until the next call to prepare() or next().
+    /// A buffer grown past 64 KB by a large message is released here once
+    /// the message has been consumed.
+
+  void commit(std::size_t size);
+    /// Marks size bytes written through the pointer returned by prepare()
+
+  void append(const char* data, std::size_t size);
+    /// Copies data into the buffer.  Equivalent to prepare() + memcpy + commit()
+
+  FrameResult next(const char*& frame, std::size_t& frameSize);
+    /// Extract the next frame.  If FRAME_COMPLETE is returned, frame points to
+    /// the message inside the internal buffer.  The range stays valid until the
+    /// next call to prepare(), append() or next().
+
+  std::size_t size() const;
+    /// Returns the number of buffered bytes not yet framed
+
+  std::size_t capacity() const;
+    /// Returns the size of the internal buffer
+
+  void reset();
+    /// Discard all buffered data
+
+  static bool findContentLength(const char* header, std::size_t headerSize, std::size_t& contentLength);
+    /// Locates the Content-Length (or compact l) header in a header block.
+    /// Returns false if the value is not a valid number.  contentLength is
+    /// set to zero if the header is absent.
+
+private:
+  void compact();
+  void shrink();
+
+  char* _buffer;
+  std::size_t _capacity;
+  std::size_t _begin;
+  std::size_t _end;
+  std::size_t _scanOffset;
+  std::size_t _maxHeaderSize;
+  std::size_t _maxBodySize;
+};
+
+//
+// Inlines
+//
+
+inline std::size_t SIPStreamFramer::size() const
+{
+  return _end - _begin;
+}
+
+inline std::size_t SIPStreamFramer::capacity() const
+{
+  return _capacity;
+}
+
+} } // OSS::SIP
+#endif // SIP_SIPStreamFramer_INCLUDED
@@ -0,0 +1,142 @@
+// Library: OSS_CORE - Foundation API for SIP B2BUA
+// Copyright (c) OSS Software Solutions
+// Contributor: Joegen Baclor - mailto:joegen@ossapp.com
+//
+// Permission is hereby granted, to any person or organization
+// obtaining a copy of the software and accompanying documentation covered by
+// this license (the "Software") to use, execute, and to prepare
+// derivative works of the Software, all subject to the
+// "GNU Lesser General Public License (LGPL)".
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+// SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+// FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+
+
+#ifndef SIP_SIPStreamSendQueue_INCLUDED
+#define SIP_SIPStreamSendQueue_INCLUDED
+
+
+#include <deque>
+#include <vector>
+#include <string>
+#include <boost/asio.hpp>
+#include <boost/noncopyable.hpp>
+#include "OSS/OSS.h"
+#include "OSS/UTL/Thread.h"
+
+
+namespace OSS {
+namespace SIP {
+
+
+class OSS_API SIPStreamSendQueue : boost::noncopyable
+  /// Outbound queue of a stream connection.
+  ///
+  /// Messages are copied into buffers owned by the queue so the caller's
+  /// data may go away as soon as push() returns.  At most one write is in
+  /// flight at any time.  Messages pushed while a write is in progress are
+  /// gathered into the next batch which is handed to the socket as a single
+  /// scatter/gather write.  Writers from different threads never
+  /// interleave their bytes.
+  ///
+  /// The queue refuses messages once the pending bytes or message count
+  /// reach their limits.  This keeps a stalled peer from consuming
+  /// unbounded memory.
+{
+public:
+  typedef std::vector<boost::asio::const_buffer> Buffers;
+
+  enum
+  {
+    DEFAULT_MAX_BYTES = 4194304,
+    DEFAULT_MAX_MESSAGES = 8192,
+    MAX_BATCH_BUFFERS = 64,
+    MAX_BATCH_BYTES = 262144
+  };
+
+  enum PushResult
+  {
+    PUSH_START_WRITE, /// Queued and no write is in flight.  Caller must call nextBatch() and write.
+    PUSH_QUEUED,      /// Queued behind the write in flight
+    PUSH_REJECTED     /// The queue is full.  The message was dropped.
+  };
+
+  SIPStreamSendQueue(std::size_t maxBytes = DEFAULT_MAX_BYTES, std::size_t maxMessages = DEFAULT_MAX_MESSAGES);
+    /// Creates an empty queue
+
+  ~SIPStreamSendQueue();
+    /// Destroys the queue
+
+  PushResult push(const char* data, std::size_t size);
+  PushResult push(const std::string& data);
+    /// Copy a message into the queue
+
+  bool acquire();
+    /// Claim the writer role without queueing anything.  Returns false if a
+    /// write is in flight.  Used for direct writes that must not interleave
+    /// with queued data.  The caller must follow up with nextBatch().
+
+  bool nextBatch(Buffers& buffers);
+    /// Move pending messages into the in-flight batch and fill buffers with
+    /// it.  Returns false and gives up the writer role if nothing is pending.
+    /// Only the writer may call this.
+
+  void completeBatch();
+    /// Release the buffers of the batch that has been written
+
+  void clear();
+    /// Drop everything including the in-flight batch.  Only call this when
+    /// no write is in flight, e.g. after a write error.
+
+  std::size_t getQueuedBytes() const;
+    /// Returns the number of bytes pending or in flight
+
+  std::size_t getQueuedMessages() const;
+    /// Returns the number of messages pending or in flight
+
+  std::size_t getHighWaterMark() const;
+    /// Returns the largest number of queued bytes observed
+
+  OSS::UInt64 getRejectedCount() const;
+    /// Returns the number of messages refused because the queue was full
+
+  OSS::UInt64 getBatchCount() const;
+    /// Returns the number of batches handed out by nextBatch()
+
+  OSS::UInt64 getMessageCount() const;
+    /// Returns the number of messages handed out by nextBatch()
+
+private:
+  typedef std::deque<std::string> Messages;
+
+  mutable OSS::mutex_critic_sec _mutex;
+  Messages _pending;
+  Messages _inflight;
+  std::size_t _queuedBytes;
+  std::size_t _maxBytes;
+  std::size_t _maxMessages;
+  std::size_t _highWaterMark;
+  bool _writing;
+  OSS::UInt64 _rejectedCount;
+  OSS::UInt64 _batchCount;
+  OSS::UInt64 _messageCount;
+};
+
+//
+// Inlines
+//
+
+inline SIPStreamSendQueue::PushResult SIPStreamSendQueue::push(const std::string& data)
+{
+  return push(data.data(), data.size());
+}
+
+
+} } // OSS::SIP
+#endif // SIP_SIPStreamSendQueue_INCLUDED
@@ -30,6 +30,8 @@
 #include <queue>
 #include "OSS/SIP/SIP.h"
 #include "OSS/SIP/SIPMessage.h"
+#include "OSS/SIP/SIPStreamFramer.h"
+#include "OSS/SIP/SIPStreamSendQueue.h"
 #include "OSS/SIP/SIPTransportSession.h"
 #include "OSS/UTL/Thread.h"
 
@@ -91,10 +93,11 @@ public:
     /// Stop all asynchronous operations associated with the connection.
 
   void writeMessage(const std::string& buf);
-    /// Write the content of the buffer
+    /// Queue the content of the buffer for writing.  The buffer is copied.
   
   void writeMessage(const std::string& buf, boost::system::error_code& ec);
-    /// Write the content of the buffer
+    /// Write the content of the buffer synchronously if no write is in
+    /// flight.  Otherwise it is queued behind the pending messages.
   
   void writeMessage(SIPMessage::Ptr msg);
     /// Send a SIP message using this transport.
@@ -103,6 +106,9 @@ public:
     /// Sends a keep-alive packet to remote to check if transport is still alive
   
   SIPStreamedConnectionManager& getConnectionManager();
+
+  const SIPStreamSendQueue& sendQueue() const;
+    /// Returns the outbound queue.  Used for metrics.
   
 private:
   void writeMessage(SIPMessage::Ptr msg, const std::string& ip, const std::string& port);
@@ -114,6 +120,10 @@ private:
   void handleWrite(const boost::system::error_code& e);
     /// Handle completion of a write operation.
 
+  void startWrite();
+    /// Write the next batch of queued messages if there is one.
+    /// Must only be called by the current writer.
+
   void handleConnect(const boost::system::error_code& e, boost::asio::ip::tcp::resolver::iterator endPointIter, boost::system::error_code* out_ec, Semaphore* pSem);
     /// Handle completion of async connect
 
@@ -161,11 +171,14 @@ protected:
   SIPStreamedConnectionManager& _connectionManager;
     /// The manager for this connection.
 
-  boost::array<char, STREAMED_CONNECTION_BUFFER_SIZE> _buffer;
-    /// Buffer for incoming data.
+  SIPStreamFramer _framer;
+    /// Reusable read buffer that slices incoming data into SIP messages
+
+  SIPStreamSendQueue _sendQueue;
+    /// Outbound messages waiting for the socket
 
-  SIPMessage::Ptr _pRequest;
-    /// Incoming SIP Message parser
+  SIPStreamSendQueue::Buffers _writeBuffers;
+    /// Gather list of the write in flight
 
   SIPFSMDispatch* _pDispatch;
 
@@ -190,5 +203,10 @@ inline SIPStreamedConnectionManager& SIPStreamedConnection::getConnectionManager
   return _connectionManager;
 }
 
+inline const SIPStreamSendQueue& SIPStreamedConnection::sendQueue() const
+{
+  return _sendQueue;
+}
+
 } } // OSS::SIP
 #endif // SIP_SIPStreamedConnection_INCLUDED
@@ -27,6 +27,7 @@
 #include <boost/asio.hpp>
 #include <boost/noncopyable.hpp>
 #include "SIPStreamedConnection.h"
+#include "SIPConnectionIndex.h"
 #include "OSS/UTL/Thread.h"
 
 
@@ -84,13 +85,19 @@ public:
     /// Set the port max.  the default is 12000
 
   SIPStreamedConnection::Ptr findConnectionByAddress(const OSS::Net::IPAddress& target);
-    /// Find a connection to a specific target if it exists
+    /// Find a connection to a specific target if it exists.  Both tcp and tls
+    /// entries are considered.
+
+  SIPStreamedConnection::Ptr findConnectionByAddress(const OSS::Net::IPAddress& target, const std::string& transport);
+    /// Find a connection to a specific target using the given transport scheme.
+    /// This is a hash lookup and does not take the connection list lock.
 
   SIPStreamedConnection::Ptr findConnectionById(OSS::UInt64 identifier);
 private:
   OSS::mutex_read_write _rwConnectionsMutex;
   OSS::UInt64 _currentIdentifier;
   std::map<OSS::UInt64, SIPStreamedConnection::Ptr> _connections;
+  SIPConnectionIndex<SIPTransportSession> _addressIndex;
   SIPTransportSession::Dispatch _dispatch;
   unsigned short _portBase;
   unsigned short _portMax;
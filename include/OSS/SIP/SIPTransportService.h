@@ -37,6 +37,7 @@
 #include "OSS/SIP/SIPTCPListener.h"
 #include "OSS/SIP/SIPWebSocketListener.h"
 #include "OSS/SIP/SIPTLSListener.h"
+#include "OSS/Net/TLSSessionCache.h"
 #include "OSS/EP/EndpointListener.h"
 
 
@@ -260,6 +261,9 @@ public:
   
   boost::asio::ssl::context& tlsServerContext();
   boost::asio::ssl::context& tlsClientContext();
+
+  OSS::Net::TLSSessionCache& tlsSessionCache();
+    /// Returns the session resumption cache shared by the TLS contexts
   
   SIPTransportSession::Dispatch& dispatch();
   
@@ -269,6 +273,7 @@ private:
   boost::asio::ip::tcp::resolver _resolver;
   boost::asio::ssl::context _tlsServerContext;
   boost::asio::ssl::context _tlsClientContext;
+  OSS::Net::TLSSessionCache _tlsSessionCache;
   SIPTransportSession::Dispatch _dispatch;
   SIPStreamedConnectionManager _tcpConMgr;
   SIPStreamedConnectionManager _tlsConMgr;
@@ -384,6 +389,11 @@ inline boost::asio::ssl::context& SIPTransportService::tlsClientContext()
   return _tlsClientContext;
 }
 
+inline OSS::Net::TLSSessionCache& SIPTransportService::tlsSessionCache()
+{
+  return _tlsSessionCache;
+}
+
 inline SIPTransportSession::Dispatch& SIPTransportService::dispatch()
 {
   return _dispatch;
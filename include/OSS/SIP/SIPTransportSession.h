@@ -294,6 +294,11 @@ inline void SIPTransportSession::dispatchMessage(const SIPMessage::Ptr& pMsg, co
     {
       pMsg->setProperty(OSS::PropertyMap::PROP_TransportAlias, _pListener->getTransportAlias());
     }
+    //
+    // The receive time is used by the overload control to measure
+    // how long the message waits before it is processed
+    //
+    pMsg->setReceiveTime(OSS::getTime());
     _messageDispatch(pMsg, pTransport);
   }
 }
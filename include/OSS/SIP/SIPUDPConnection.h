@@ -28,6 +28,7 @@
 #include <boost/enable_shared_from_this.hpp>
 #include "OSS/SIP/SIP.h"
 #include "OSS/SIP/SIPMessage.h"
+#include "OSS/SIP/SIPMessagePool.h"
 #include "OSS/SIP/SIPTransportSession.h"
 
 
@@ -117,6 +118,9 @@ protected:
   SIPMessage::Ptr _pRequest;
     /// Incoming SIP Message parser
 
+  SIPMessagePool _messagePool;
+    /// Recycled messages for incoming packets
+
   friend class SIPUDPConnectionClone;
 };
 
@@ -59,6 +59,7 @@
 #include <boost/asio.hpp>
 #include <boost/noncopyable.hpp>
 #include "OSS/SIP/SIPWebSocketConnection.h"
+#include "OSS/SIP/SIPConnectionIndex.h"
 #include "OSS/UTL/Thread.h"
 
 
@@ -116,7 +117,8 @@ public:
     /// Set the port max.  the default is 12000
 
   SIPWebSocketConnection::Ptr findConnectionByAddress(const OSS::Net::IPAddress& target);
-    /// Find a connection to a specific target if it exists
+    /// Find a connection to a specific target if it exists.  This is a hash
+    /// lookup and does not take the connection list lock.
 
   SIPWebSocketConnection::Ptr findConnectionById(OSS::UInt64 identifier);
 
@@ -124,6 +126,7 @@ public:
 private:
   OSS::mutex_read_write _rwConnectionsMutex;
   std::map<OSS::UInt64, SIPWebSocketConnection::Ptr> _connections;
+  SIPConnectionIndex<SIPTransportSession> _addressIndex;
   SIPTransportSession::Dispatch _dispatch;
   unsigned short _portBase;
   unsigned short _portMax;
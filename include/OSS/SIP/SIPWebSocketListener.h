@@ -120,6 +120,18 @@ public:
   
   virtual bool canBeRestarted() const;
     /// returns true if the listener can safely be restarted
+
+  void setPerMessageDeflate(bool enabled, bool contextTakeover = true, int level = 6, std::size_t minSize = 64);
+    /// Accept permessage-deflate (RFC 7692) from clients that offer it.
+    /// WebRTC clients send large SDPs with repeated ICE candidates which
+    /// compress well, especially with context takeover where each message
+    /// can refer back to the previous ones.  Context takeover costs about
+    /// 300KB of zlib state per connection.  Messages smaller than minSize
+    /// are sent uncompressed.  Enabled by default.  Only affects
+    /// connections accepted after the call.
+
+  const websocketpp::processor::deflate_config& getPerMessageDeflate() const;
+    /// Returns the permessage-deflate settings
  
 protected:
   void run_server();
@@ -134,6 +146,7 @@ protected:
 
   boost::thread* _pServerThread;
   boost::thread* _pClientThread;
+  websocketpp::processor::deflate_config _deflateConfig;
 };
 
 
@@ -141,6 +154,11 @@ protected:
 // Inlines
 //
 
+inline const websocketpp::processor::deflate_config& SIPWebSocketListener::getPerMessageDeflate() const
+{
+  return _deflateConfig;
+}
+
 } } // OSS::SIP
 
 #endif // ENABLE_FEATURE_WEBSOCKETS
@@ -0,0 +1,179 @@
+// Library: OSS_CORE - Foundation API for SIP B2BUA
+// Copyright (c) OSS Software Solutions
+// Contributor: Joegen Baclor - mailto:joegen@ossapp.com
+//
+// Permission is hereby granted, to any person or organization
+// obtaining a copy of the software and accompanying documentation covered by
+// this license (the "Software") to use, execute, and to prepare
+// derivative works of the Software, all subject to the
+// "GNU Lesser General Public License (LGPL)".
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+// SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+// FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+
+
+#ifndef OSS_LOGASYNCSINK_H_INCLUDED
+#define OSS_LOGASYNCSINK_H_INCLUDED
+
+
+#include <string>
+#include <vector>
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/function.hpp>
+#include <boost/thread.hpp>
+
+#include "OSS/UTL/Semaphore.h"
+
+
+namespace OSS {
+namespace UTL {
+
+
+class LogAsyncSink : public boost::noncopyable
+  ///
+  /// Bounded multi-producer/single-consumer ring buffer that moves log records
+  /// off the calling thread.  Producers (transport, B2BUA and RTP threads)
+  /// claim a slot with a single compare-and-swap and never block.  A dedicated
+  /// writer thread drains whatever has accumulated and hands it to the
+  /// BatchWriter in one call so the file is only verified, locked and written
+  /// once per batch.
+  ///
+  /// When the ring is full the record is dropped and counted.  Once the ring
+  /// is past its high water mark, records less severe than a warning are
+  /// dropped as well so that errors still get through under overload.  The
+  /// writer reports the number of dropped records as a warning record of
+  /// its own.
+  ///
+  {
+  public:
+    typedef boost::shared_ptr<LogAsyncSink> Ptr;
+
+    struct Record
+    {
+      int priority;
+      std::string text;
+    };
+
+    typedef boost::function<void(const Record* records, std::size_t count)> BatchWriter;
+
+    enum
+    {
+      DEFAULT_CAPACITY = 8192,
+      DEFAULT_BATCH_SIZE = 256,
+      DROP_PRIORITY = 4 /// Records with priority above PRIO_WARNING are shed first
+    };
+
+    LogAsyncSink(const BatchWriter& writer, std::size_t capacity = DEFAULT_CAPACITY);
+    ///
+    /// Creates the sink.  Capacity is rounded up to a power of two.
+    ///
+
+    ~LogAsyncSink();
+    ///
+    /// Stops the writer thread after draining the queue
+    ///
+
+    void start();
+    ///
+    /// Start the writer thread
+    ///
+
+    void stop();
+    ///
+    /// Drain all pending records and stop the writer thread
+    ///
+
+    bool enqueue(int priority, const std::string& text);
+    ///
+    /// Queue a record for the writer thread.  Returns false if the record
+    /// was dropped because of overload.
+    ///
+
+    void flush();
+    ///
+    /// Block until every record queued before this call has been written
+    ///
+
+    std::size_t getCapacity() const;
+    ///
+    /// Returns the number of slots in the ring
+    ///
+
+    std::size_t getDroppedCount() const;
+    ///
+    /// Returns the total number of records dropped since creation
+    ///
+
+    std::size_t getWrittenCount() const;
+    ///
+    /// Returns the total number of records handed to the writer
+    ///
+
+    bool isRunning() const;
+    ///
+    /// Returns true if the writer thread is running
+    ///
+
+  private:
+    struct Cell
+    {
+      volatile std::size_t sequence;
+      Record record;
+    };
+
+    bool dequeue(Record& record);
+    void wakeup();
+    void run();
+    void writeBatch(std::size_t count);
+
+    BatchWriter _writer;
+    std::size_t _capacity;
+    std::size_t _mask;
+    std::size_t _highWaterMark;
+    Cell* _cells;
+    volatile std::size_t _enqueuePos;
+    volatile std::size_t _dequeuePos;
+    volatile std::size_t _writtenPos;
+    volatile std::size_t _dropped;
+    std::size_t _reportedDrops;
+    volatile int _writerIdle;
+    volatile bool _isRunning;
+    std::vector<Record> _batch;
+    OSS::Semaphore _wakeup;
+    boost::thread* _pThread;
+    boost::mutex _runMutex;
+  };
+
+  //
+  // Inlines
+  //
+  inline std::size_t LogAsyncSink::getCapacity() const
+  {
+    return _capacity;
+  }
+
+  inline std::size_t LogAsyncSink::getDroppedCount() const
+  {
+    return _dropped;
+  }
+
+  inline std::size_t LogAsyncSink::getWrittenCount() const
+  {
+    return _writtenPos;
+  }
+
+  inline bool LogAsyncSink::isRunning() const
+  {
+    return _isRunning;
+  }
+
+} } // OSS::UTL
+
+#endif // OSS_LOGASYNCSINK_H_INCLUDED
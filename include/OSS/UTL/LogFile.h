@@ -27,6 +27,8 @@
 #include <boost/noncopyable.hpp>
 #include <boost/thread.hpp>
 
+#include "OSS/UTL/LogAsyncSink.h"
+
 
 namespace OSS {
 namespace UTL {
@@ -208,6 +210,31 @@ class LogFile : public boost::noncopyable
     /// Set the verification interval.  This is expressed un seconds.
     /// Default:  5 seconds
     ///
+
+    void enableAsync(bool enable, std::size_t capacity = LogAsyncSink::DEFAULT_CAPACITY);
+    ///
+    /// Enable/Disable the asynchronous writer.  When enabled, log calls
+    /// only queue the record and a dedicated thread performs verification,
+    /// rotation and the actual write in batches.  Records are dropped if
+    /// the writer cannot keep up.
+    /// Default:  false
+    ///
+
+    bool isAsync() const;
+    ///
+    /// Returns true if the asynchronous writer is enabled
+    ///
+
+    void flush();
+    ///
+    /// Block until all queued records have been written.  Does nothing
+    /// if the asynchronous writer is disabled.
+    ///
+
+    std::size_t getDroppedCount() const;
+    ///
+    /// Returns the number of records dropped by the asynchronous writer
+    ///
     
   protected:
     void close();
@@ -225,6 +252,18 @@ class LogFile : public boost::noncopyable
     /// if force is true, verification will take place irregardless of the
     /// verification interval.  This is not a thread safe call
     /// and is intended to be called within the logger internals only.
+
+    void writeBatch(const LogAsyncSink::Record* records, std::size_t count);
+    ///
+    /// Write a batch of queued records.  Called from the asynchronous
+    /// writer thread.
+    ///
+
+    bool enqueue(Priority priority, const std::string& log);
+    ///
+    /// Queue the record if the asynchronous writer is enabled.  Returns false
+    /// if the caller must write it synchronously.
+    ///
     
   private:
     static LogFile* _pLogFileInstance; /// Pointer to the default logger instance
@@ -242,6 +281,7 @@ class LogFile : public boost::noncopyable
     bool _isOpen;  /// Flag indicator if logger is open
     std::string _lastError;  /// last error encountered after a logger function is invoked
     mutex _mutex;  /// Internal mutex
+    LogAsyncSink::Ptr _pAsyncSink; /// Asynchronous writer if enabled.  Use atomic_load/atomic_store
   };
   
   //
@@ -292,6 +332,11 @@ class LogFile : public boost::noncopyable
   {
     _verificationInterval = seconds;
   }
+
+  inline bool LogFile::isAsync() const
+  {
+    return boost::atomic_load(&_pAsyncSink) != 0;
+  }
   
   
 } } // OSS::UTL
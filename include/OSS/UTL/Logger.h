@@ -61,6 +61,23 @@ void OSS_API log_reset_level(LogPriority level);
 LogPriority OSS_API log_get_level();
   /// Return the the log level
 
+bool OSS_API log_will_log(LogPriority priority);
+  /// Return true if a message with the given priority would be written.
+  /// The OSS_LOG_XXX macros call this before formatting so suppressed
+  /// levels never pay for the ostringstream.
+
+void OSS_API log_enable_async(bool yes, std::size_t capacity = 8192);
+  /// Hand file log records to a dedicated writer thread through a bounded
+  /// ring buffer instead of writing on the calling thread.  Records are
+  /// dropped, and counted, if the writer falls behind.  Console output
+  /// is not affected.
+
+void OSS_API log_flush();
+  /// Block until all queued log records have been written
+
+std::size_t OSS_API log_get_dropped_count();
+  /// Return the number of records dropped by the asynchronous writer
+
 const boost::filesystem::path& OSS_API logger_get_path();
 
 void OSS_API logger_set_directory(const boost::filesystem::path& directory);
@@ -73,9 +90,12 @@ void OSS_API log_fatal(const std::string& log);
 
 #define OSS_LOG_FATAL(log) \
 { \
-  std::ostringstream strm; \
-  strm << log; \
-  OSS::log_fatal(strm.str()); \
+  if (OSS::log_will_log(OSS::PRIO_FATAL)) \
+  { \
+    std::ostringstream strm; \
+    strm << log; \
+    OSS::log_fatal(strm.str()); \
+  } \
 }
 
 void OSS_API log_critical(const std::string& log);
@@ -83,9 +103,12 @@ void OSS_API log_critical(const std::string& log);
 
 #define OSS_LOG_CRITICAL(log) \
 { \
-  std::ostringstream strm; \
-  strm << log; \
-  OSS::log_critical(strm.str()); \
+  if (OSS::log_will_log(OSS::PRIO_CRITICAL)) \
+  { \
+    std::ostringstream strm; \
+    strm << log; \
+    OSS::log_critical(strm.str()); \
+  } \
 }
 
 void OSS_API log_error(const std::string& log);
@@ -100,9 +123,12 @@ void OSS_API log_enable_logging(bool yes);
 
 #define OSS_LOG_ERROR(log) \
 { \
-  std::ostringstream strm; \
-  strm << log; \
-  OSS::log_error(strm.str()); \
+  if (OSS::log_will_log(OSS::PRIO_ERROR)) \
+  { \
+    std::ostringstream strm; \
+    strm << log; \
+    OSS::log_error(strm.str()); \
+  } \
 }
 
 void OSS_API log_warning(const std::string& log);
@@ -110,9 +136,12 @@ void OSS_API log_warning(const std::string& log);
 
 #define OSS_LOG_WARNING(log) \
 { \
-  std::ostringstream strm; \
-  strm << log; \
-  OSS::log_warning(strm.str()); \
+  if (OSS::log_will_log(OSS::PRIO_WARNING)) \
+  { \
+    std::ostringstream strm; \
+    strm << log; \
+    OSS::log_warning(strm.str()); \
+  } \
 }
 
 void OSS_API log_notice(const std::string& log);
@@ -120,9 +149,12 @@ void OSS_API log_notice(const std::string& log);
 
 #define OSS_LOG_NOTICE(log) \
 { \
-  std::ostringstream strm; \
-  strm << log; \
-  OSS::log_notice(strm.str()); \
+  if (OSS::log_will_log(OSS::PRIO_NOTICE)) \
+  { \
+    std::ostringstream strm; \
+    strm << log; \
+    OSS::log_notice(strm.str()); \
+  } \
 }
 
 void OSS_API log_information(const std::string& log);
@@ -130,9 +162,12 @@ void OSS_API log_information(const std::string& log);
 
 #define OSS_LOG_INFO(log) \
 { \
-  std::ostringstream strm; \
-  strm << log; \
-  OSS::log_information(strm.str()); \
+  if (OSS::log_will_log(OSS::PRIO_INFORMATION)) \
+  { \
+    std::ostringstream strm; \
+    strm << log; \
+    OSS::log_information(strm.str()); \
+  } \
 }
 
 
@@ -141,9 +176,12 @@ void OSS_API log_debug(const std::string& log);
 
 #define OSS_LOG_DEBUG(log) \
 { \
-  std::ostringstream strm; \
-  strm << log; \
-  OSS::log_debug(strm.str()); \
+  if (OSS::log_will_log(OSS::PRIO_DEBUG)) \
+  { \
+    std::ostringstream strm; \
+    strm << log; \
+    OSS::log_debug(strm.str()); \
+  } \
 }
 
 void OSS_API log_trace(const std::string& log);
@@ -151,9 +189,12 @@ void OSS_API log_trace(const std::string& log);
 
 #define OSS_LOG_TRACE(log) \
 { \
-  std::ostringstream strm; \
-  strm << log; \
-  OSS::log_trace(strm.str()); \
+  if (OSS::log_will_log(OSS::PRIO_TRACE)) \
+  { \
+    std::ostringstream strm; \
+    strm << log; \
+    OSS::log_trace(strm.str()); \
+  } \
 }
 
 #ifdef _DEBUG
@@ -0,0 +1,107 @@
+// Library: OSS_CORE - Foundation API for SIP B2BUA
+// Copyright (c) OSS Software Solutions
+// Contributor: Joegen Baclor - mailto:joegen@ossapp.com
+//
+// Permission is hereby granted, to any person or organization
+// obtaining a copy of the software and accompanying documentation covered by
+// this license (the "Software") to use, execute, and to prepare
+// derivative works of the Software, all subject to the
+// "GNU Lesser General Public License (LGPL)".
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+// SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+// FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+
+
+#ifndef OSS_ZMQPOLLER_H_INCLUDED
+#define OSS_ZMQPOLLER_H_INCLUDED
+
+#include "OSS/build.h"
+#if ENABLE_FEATURE_ZMQ
+
+#include "OSS/ZMQ/ZMQSocket.h"
+
+#if OSS_HAVE_ZMQ
+
+#include <map>
+#include <boost/asio.hpp>
+#include <boost/enable_shared_from_this.hpp>
+
+namespace OSS {
+namespace ZMQ {
+
+
+class ZMQPoller : boost::noncopyable
+  /// Drives ZMQ sockets from a boost::asio io_service instead of a thread
+  /// blocked in receive for each socket.  The ZMQ_FD of every watched socket
+  /// is registered with the io_service and the read handler is called on one
+  /// of its threads whenever messages are queued.
+  ///
+  /// The handler must not block.  It is expected to drain what is queued,
+  /// typically with ZMQSocket::receiveRequests(), and is called again for
+  /// as long as the socket stays readable.  It may also be called when
+  /// nothing is queued.
+{
+public:
+  typedef boost::function<void()> ReadHandler;
+
+  explicit ZMQPoller(boost::asio::io_service& ioService);
+  ~ZMQPoller();
+
+  bool watch(ZMQSocket& socket, const ReadHandler& handler);
+    /// Starts calling handler when socket has messages.  The socket must be
+    /// bound or connected and must outlive the watch.
+
+  void unwatch(ZMQSocket& socket);
+    /// Stops watching socket.  A handler that is already running completes.
+
+  void unwatchAll();
+
+  boost::asio::io_service& ioService();
+
+protected:
+  class Watch : public boost::enable_shared_from_this<Watch>, boost::noncopyable
+  {
+  public:
+    typedef boost::shared_ptr<Watch> Ptr;
+    Watch(boost::asio::io_service& ioService, ZMQSocket& socket, int fd, const ReadHandler& handler);
+    void start();
+    void stop();
+  private:
+    void arm();
+    void onReadable(const boost::system::error_code& e);
+    boost::asio::io_service& _ioService;
+    ZMQSocket& _socket;
+    boost::asio::posix::stream_descriptor _descriptor;
+    ReadHandler _handler;
+    OSS::mutex_critic_sec _mutex;
+    bool _isActive;
+  };
+
+  typedef std::map<ZMQSocket*, Watch::Ptr> Watches;
+  boost::asio::io_service& _ioService;
+  Watches _watches;
+  OSS::mutex_critic_sec _watchesMutex;
+};
+
+//
+// Inlines
+//
+
+inline boost::asio::io_service& ZMQPoller::ioService()
+{
+  return _ioService;
+}
+
+} } // OSS::ZMQ
+
+#endif // OSS_HAVE_ZMQ
+
+#endif // ENABLE_FEATURE_ZMQ
+
+#endif // OSS_ZMQPOLLER_H_INCLUDED
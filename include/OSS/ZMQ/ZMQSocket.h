@@ -31,6 +31,7 @@
 #include "OSS/UTL/CoreUtils.h"
 #include "OSS/Net/IPAddress.h"
 #include "OSS/UTL/Thread.h"
+#include <boost/function.hpp>
 #include "OSS/build.h"
 
 
@@ -55,9 +56,16 @@ public:
   
   typedef zmq::pollitem_t PollItem;
   typedef std::vector<PollItem> PollItems;
+  typedef zmq::message_t Message;
+  typedef boost::function<void(Message& cmd, Message& data)> RequestHandler;
   
   ZMQSocket(SocketType type);
   
+  ZMQSocket(SocketType type, bool isShared);
+    /// A socket that is only ever used by a single thread, for example one
+    /// driven by a ZMQPoller, can be created with isShared set to false.
+    /// Calls on it skip the mutex.
+  
   ~ZMQSocket();
   
   bool connect(const std::string& peerAddress);
@@ -68,6 +76,9 @@ public:
   bool sendAndReceive(const std::string& cmd, const std::string& data, std::string& response);
 
   bool sendRequest(const std::string& cmd, const std::string& data);
+  bool sendRequest(const std::string& cmd, zmq::message_t& data);
+    /// Sends data as is.  A message built over a caller buffer with a free
+    /// function reaches the peer without being copied.
   
   bool sendReply(const std::string& data);
   
@@ -76,6 +87,37 @@ public:
   
   bool receiveRequest(std::string& cmd, std::string& data, unsigned int timeoutms);
   bool receiveRequest(std::string& cmd, std::string& data);
+  bool receiveRequest(std::string& cmd, zmq::message_t& data, unsigned int timeoutms = 0);
+    /// Receives the payload without copying it out of the ZMQ message
+  
+  bool sendMultipart(Message* parts, std::size_t count);
+    /// Sends count frames as one multipart message.  The frames are handed
+    /// over to ZMQ and are empty when the call returns.
+  
+  std::size_t receiveMultipart(Message* parts, std::size_t maxParts, unsigned int timeoutms = 0);
+    /// Receives one multipart message and returns the number of frames
+    /// stored in parts.  Frames beyond maxParts are dropped.  Returns 0 on
+    /// timeout or error.
+  
+  bool tryReceiveRequest(Message& cmd, Message& data);
+    /// Receives a request if one is already queued.  Never blocks.
+  
+  std::size_t receiveRequests(const RequestHandler& handler, std::size_t maxCount);
+    /// Drains up to maxCount requests that are already queued and calls
+    /// handler for each one.  Never blocks and takes the mutex once for the
+    /// whole batch, so handler must not call back into this socket.
+  
+  int getDescriptor();
+    /// The ZMQ_FD of the socket for use with an external event loop.
+    /// Returns -1 if the socket is not open.
+  
+  bool isReadable();
+    /// Whether a message can be received without blocking.  Must be called
+    /// after the descriptor signals since it is edge triggered.
+  
+  static void moveToMessage(std::string& data, Message& message);
+    /// Rebuilds message over the content of data without copying it.  data
+    /// is left empty and its buffer is freed when ZMQ is done with it.
   
   void close();
   
@@ -88,6 +130,19 @@ protected:
   bool internal_connect(const std::string& peerAddress);
   bool internal_send_reply(const std::string& data);
   bool internal_send_request(const std::string& cmd, const std::string& data);
+  bool internal_send_request(const std::string& cmd, zmq::message_t& data);
+  bool internal_send_multipart(Message* parts, std::size_t count);
+  std::size_t internal_receive_multipart(Message* parts, std::size_t maxParts, int flags);
+  
+  class SocketLock : boost::noncopyable
+  {
+  public:
+    SocketLock(ZMQSocket& socket);
+    ~SocketLock();
+  private:
+    OSS::mutex_critic_sec* _mutex;
+  };
+  
   bool internal_receive_reply(std::string& reply, unsigned int timeoutms);
   bool internal_receive_request(std::string& cmd, std::string& data, unsigned int timeoutms);
   SocketType _type;
@@ -98,6 +153,7 @@ protected:
   OSS::mutex_critic_sec _mutex;
   bool _canReconnect;
   bool _isInproc;
+  bool _isShared;
   static zmq::context_t* _inproc_context;
 };
 
@@ -124,6 +180,23 @@ inline zmq::socket_t* ZMQSocket::socket()
 {
   return _socket;
 }
+
+inline ZMQSocket::SocketLock::SocketLock(ZMQSocket& socket) :
+  _mutex(socket._isShared ? &socket._mutex : 0)
+{
+  if (_mutex)
+  {
+    _mutex->lock();
+  }
+}
+
+inline ZMQSocket::SocketLock::~SocketLock()
+{
+  if (_mutex)
+  {
+    _mutex->unlock();
+  }
+}
     
 } } // OSS::ZMQ
 
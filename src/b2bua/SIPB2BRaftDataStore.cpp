@@ -0,0 +1,499 @@
+// Library: OSS_CORE - Foundation API for SIP B2BUA
+// Copyright (c) OSS Software Solutions
+// Contributor: Joegen Baclor - mailto:joegen@ossapp.com
+//
+// Permission is hereby granted, to any person or organization
+// obtaining a copy of the software and accompanying documentation covered by
+// this license (the "Software") to use, execute, and to prepare
+// derivative works of the Software, all subject to the
+// "GNU Lesser General Public License (LGPL)".
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+// SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+// FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+
+
+
+#include "OSS/SIP/B2BUA/SIPB2BRaftDataStore.h"
+#if ENABLE_FEATURE_B2BUA && ENABLE_FEATURE_NET_EXTRA
+
+#include <cstring>
+#include <boost/bind.hpp>
+
+
+namespace OSS {
+namespace SIP {
+namespace B2BUA {
+
+
+//
+// Batches and snapshots are sequences of integers and length prefixed
+// strings in host byte order like the rest of the RAFT messages
+//
+template <typename T>
+static void append_value(std::string& buf, T value)
+{
+  buf.append((const char*)&value, sizeof(value));
+}
+
+static void append_string(std::string& buf, const std::string& value)
+{
+  append_value(buf, (boost::uint32_t)value.size());
+  buf.append(value);
+}
+
+template <typename T>
+static bool read_value(const char*& pos, const char* end, T& value)
+{
+  if ((std::size_t)(end - pos) < sizeof(value))
+  {
+    return false;
+  }
+  memcpy(&value, pos, sizeof(value));
+  pos += sizeof(value);
+  return true;
+}
+
+static bool read_string(const char*& pos, const char* end, std::string& value)
+{
+  boost::uint32_t len = 0;
+  if (!read_value(pos, end, len) || (std::size_t)(end - pos) < len)
+  {
+    return false;
+  }
+  value.assign(pos, len);
+  pos += len;
+  return true;
+}
+
+
+SIPB2BRaftDataStore::SIPB2BRaftDataStore() :
+  _epoch(OSS::getTime()),
+  _sequence(0),
+  _appliedSequence(0),
+  _terminating(false),
+  _pWriterThread(0)
+{
+  _pWriterThread = new boost::thread(boost::bind(&SIPB2BRaftDataStore::runWriter, this));
+}
+
+SIPB2BRaftDataStore::~SIPB2BRaftDataStore()
+{
+  {
+    OSS::mutex_critic_sec_lock lock(_queueMutex);
+    _terminating = true;
+    _queueCondition.notify_all();
+  }
+  _pWriterThread->join();
+  delete _pWriterThread;
+  
+  stop();
+  close();
+}
+
+void SIPB2BRaftDataStore::attach(SIPB2BDialogDataStoreCb& dataStore)
+{
+  dataStore.persist = boost::bind(&SIPB2BRaftDataStore::persist, this, _1);
+  dataStore.getAll = boost::bind(&SIPB2BRaftDataStore::getAll, this, _1);
+  dataStore.removeSession = boost::bind(&SIPB2BRaftDataStore::removeSession, this, _1);
+  dataStore.removeAllDialogs = boost::bind(&SIPB2BRaftDataStore::removeAllDialogs, this, _1);
+  dataStore.persistReg = boost::bind(&SIPB2BRaftDataStore::persistReg, this, _1);
+  dataStore.getOneReg = boost::bind(&SIPB2BRaftDataStore::getOneReg, this, _1, _2);
+  dataStore.getReg = boost::bind(&SIPB2BRaftDataStore::getReg, this, _1, _2);
+  dataStore.removeReg = boost::bind(&SIPB2BRaftDataStore::removeReg, this, _1);
+  dataStore.removeAllReg = boost::bind(&SIPB2BRaftDataStore::removeAllReg, this, _1);
+  dataStore.getAllReg = boost::bind(&SIPB2BRaftDataStore::getAllReg, this, _1);
+}
+
+bool SIPB2BRaftDataStore::persist(const DialogData& dialogData)
+{
+  std::string data;
+  dialogData.toJsonString(data);
+  queueUpdate(PERSIST_DIALOG, dialogData.sessionId, dialogData.leg1.callId, data);
+  return true;
+}
+
+void SIPB2BRaftDataStore::getAll(DialogList& dialogs)
+{
+  OSS::mutex_critic_sec_lock lock(_storageMutex);
+  for (Dialogs::const_iterator iter = _dialogs.begin(); iter != _dialogs.end(); iter++)
+  {
+    DialogData dialog;
+    dialog.fromJsonString(iter->second.json);
+    dialogs.push_back(dialog);
+  }
+}
+
+void SIPB2BRaftDataStore::removeSession(const std::string& sessionId)
+{
+  queueUpdate(REMOVE_SESSION, sessionId, std::string(), std::string());
+}
+
+void SIPB2BRaftDataStore::removeAllDialogs(const std::string& callId)
+{
+  queueUpdate(REMOVE_ALL_DIALOGS, callId, std::string(), std::string());
+}
+
+bool SIPB2BRaftDataStore::persistReg(const RegData& regData)
+{
+  if (regData.key.empty() || regData.aor.empty() || regData.contact.empty())
+  {
+    OSS_LOG_ERROR("Invalid registration record.");
+    return false;
+  }
+  std::string data;
+  regData.toJsonString(data);
+  queueUpdate(PERSIST_REG, regData.key, regData.callId, data);
+  return true;
+}
+
+bool SIPB2BRaftDataStore::getOneReg(const std::string& regId, RegData& regData)
+{
+  OSS::mutex_critic_sec_lock lock(_storageMutex);
+  Registry::const_iterator iter = _registry.find(regId);
+  if (iter == _registry.end())
+  {
+    return false;
+  }
+  regData.fromJsonString(iter->second);
+  return true;
+}
+
+bool SIPB2BRaftDataStore::getReg(const std::string& regIdPrefix, RegList& regs)
+{
+  OSS::mutex_critic_sec_lock lock(_storageMutex);
+  for (Registry::const_iterator iter = _registry.lower_bound(regIdPrefix); iter != _registry.end() && OSS::string_starts_with(iter->first, regIdPrefix.c_str()); iter++)
+  {
+    RegData data;
+    data.fromJsonString(iter->second);
+    regs.push_back(data);
+  }
+  return true;
+}
+
+void SIPB2BRaftDataStore::removeReg(const std::string& regId)
+{
+  queueUpdate(REMOVE_REG, regId, std::string(), std::string());
+}
+
+void SIPB2BRaftDataStore::removeAllReg(const std::string& regIdPrefix)
+{
+  queueUpdate(REMOVE_ALL_REG, regIdPrefix, std::string(), std::string());
+}
+
+void SIPB2BRaftDataStore::getAllReg(RegList& regs)
+{
+  OSS::mutex_critic_sec_lock lock(_storageMutex);
+  for (Registry::const_iterator iter = _registry.begin(); iter != _registry.end(); iter++)
+  {
+    RegData data;
+    data.fromJsonString(iter->second);
+    regs.push_back(data);
+  }
+}
+
+bool SIPB2BRaftDataStore::hasDialog(const std::string& sessionId)
+{
+  OSS::mutex_critic_sec_lock lock(_storageMutex);
+  return _dialogs.find(sessionId) != _dialogs.end();
+}
+
+std::size_t SIPB2BRaftDataStore::getDialogCount()
+{
+  OSS::mutex_critic_sec_lock lock(_storageMutex);
+  return _dialogs.size();
+}
+
+std::size_t SIPB2BRaftDataStore::getRegistrationCount()
+{
+  OSS::mutex_critic_sec_lock lock(_storageMutex);
+  return _registry.size();
+}
+
+bool SIPB2BRaftDataStore::waitForPending(int timeoutMs)
+{
+  boost::system_time deadline = boost::get_system_time() + boost::posix_time::milliseconds(timeoutMs);
+  boost::unique_lock<OSS::mutex_critic_sec> lock(_queueMutex);
+  while (!_pendingUpdates.empty() || !_inFlight.empty())
+  {
+    if (!_queueCondition.timed_wait(lock, deadline))
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+void SIPB2BRaftDataStore::queueUpdate(Operation operation, const std::string& key, const std::string& callId, const std::string& value)
+{
+  std::string update;
+  update.reserve(1 + 3 * sizeof(boost::uint32_t) + key.size() + callId.size() + value.size());
+  update.push_back((char)operation);
+  append_string(update, key);
+  append_string(update, callId);
+  append_string(update, value);
+  
+  OSS::mutex_critic_sec_lock lock(_queueMutex);
+  _pendingUpdates.push_back(update);
+  _queueCondition.notify_all();
+}
+
+void SIPB2BRaftDataStore::runWriter()
+{
+  boost::unique_lock<OSS::mutex_critic_sec> lock(_queueMutex);
+  while (!_terminating)
+  {
+    if (!_inFlight.empty() && _appliedSequence >= _sequence)
+    {
+      _inFlight.clear();
+      _queueCondition.notify_all();
+    }
+    
+    if (_inFlight.empty())
+    {
+      if (_pendingUpdates.empty())
+      {
+        _queueCondition.wait(lock);
+        continue;
+      }
+      
+      //
+      // Everything queued while the previous batch was committed goes
+      // into the next entry
+      //
+      _sequence++;
+      append_value(_inFlight, (int)opt().node_id);
+      append_value(_inFlight, _epoch);
+      append_value(_inFlight, _sequence);
+      while (!_pendingUpdates.empty() && (_inFlight.size() < SIP_B2B_RAFT_MAX_BATCH_SIZE || _inFlight.size() == 2 * sizeof(OSS::UInt64) + sizeof(int)))
+      {
+        _inFlight.append(_pendingUpdates.front());
+        _pendingUpdates.pop_front();
+      }
+    }
+    
+    //
+    // The batch is resent if it is not applied in time.  The leader may
+    // have gone away before committing it.
+    //
+    std::string batch = _inFlight;
+    OSS::UInt64 sequence = _sequence;
+    lock.unlock();
+    bool sent = forward(batch);
+    lock.lock();
+    
+    int timeout = sent ? opt().election_timeout_ms : opt().periodic_timer_ms;
+    boost::system_time deadline = boost::get_system_time() + boost::posix_time::milliseconds(timeout);
+    while (!_terminating && _appliedSequence < sequence)
+    {
+      if (!_queueCondition.timed_wait(lock, deadline))
+      {
+        break;
+      }
+    }
+  }
+}
+
+int SIPB2BRaftDataStore::onApplyEntry(const raft_entry_t& entry)
+{
+  if (entry.type == RAFT_LOGTYPE_NORMAL && !applyBatch((const char*)entry.data.buf, entry.data.len))
+  {
+    OSS_LOG_ERROR("SIPB2BRaftDataStore::onApplyEntry - Malformed batch in entry " << entry.id);
+  }
+  return 0;
+}
+
+bool SIPB2BRaftDataStore::applyBatch(const char* data, std::size_t len)
+{
+  const char* pos = data;
+  const char* end = data + len;
+  int nodeId = 0;
+  OSS::UInt64 epoch = 0;
+  OSS::UInt64 sequence = 0;
+  if (!read_value(pos, end, nodeId) || !read_value(pos, end, epoch) || !read_value(pos, end, sequence))
+  {
+    return false;
+  }
+  
+  {
+    OSS::mutex_critic_sec_lock lock(_storageMutex);
+    Origin& origin = _origins[nodeId];
+    if (origin.epoch == epoch && sequence <= origin.sequence)
+    {
+      //
+      // A resent batch that was already committed
+      //
+      pos = end;
+    }
+    else
+    {
+      origin.epoch = epoch;
+      origin.sequence = sequence;
+    }
+    
+    while (pos < end)
+    {
+      char operation = *pos++;
+      std::string key;
+      std::string callId;
+      std::string value;
+      if (!read_string(pos, end, key) || !read_string(pos, end, callId) || !read_string(pos, end, value))
+      {
+        return false;
+      }
+      
+      switch (operation)
+      {
+        case PERSIST_DIALOG:
+        {
+          Dialog& dialog = _dialogs[key];
+          dialog.callId.swap(callId);
+          dialog.json.swap(value);
+          break;
+        }
+        case REMOVE_SESSION:
+          _dialogs.erase(key);
+          break;
+        case REMOVE_ALL_DIALOGS:
+          for (Dialogs::iterator iter = _dialogs.begin(); iter != _dialogs.end();)
+          {
+            if (iter->second.callId == key)
+            {
+              _dialogs.erase(iter++);
+            }
+            else
+            {
+              iter++;
+            }
+          }
+          break;
+        case PERSIST_REG:
+          _registry[key].swap(value);
+          break;
+        case REMOVE_REG:
+          _registry.erase(key);
+          break;
+        case REMOVE_ALL_REG:
+        {
+          Registry::iterator iter = _registry.lower_bound(key);
+          while (iter != _registry.end() && OSS::string_starts_with(iter->first, key.c_str()))
+          {
+            _registry.erase(iter++);
+          }
+          break;
+        }
+        default:
+          return false;
+      }
+    }
+  }
+  
+  if (nodeId == opt().node_id && epoch == _epoch)
+  {
+    OSS::mutex_critic_sec_lock lock(_queueMutex);
+    if (sequence > _appliedSequence)
+    {
+      _appliedSequence = sequence;
+      _queueCondition.notify_all();
+    }
+  }
+  return true;
+}
+
+bool SIPB2BRaftDataStore::onCreateSnapshot(std::string& data)
+{
+  OSS::mutex_critic_sec_lock lock(_storageMutex);
+  data.clear();
+  append_value(data, (boost::uint32_t)_origins.size());
+  for (Origins::const_iterator iter = _origins.begin(); iter != _origins.end(); iter++)
+  {
+    append_value(data, iter->first);
+    append_value(data, iter->second.epoch);
+    append_value(data, iter->second.sequence);
+  }
+  append_value(data, (boost::uint32_t)_dialogs.size());
+  for (Dialogs::const_iterator iter = _dialogs.begin(); iter != _dialogs.end(); iter++)
+  {
+    append_string(data, iter->first);
+    append_string(data, iter->second.callId);
+    append_string(data, iter->second.json);
+  }
+  append_value(data, (boost::uint32_t)_registry.size());
+  for (Registry::const_iterator iter = _registry.begin(); iter != _registry.end(); iter++)
+  {
+    append_string(data, iter->first);
+    append_string(data, iter->second);
+  }
+  return true;
+}
+
+bool SIPB2BRaftDataStore::onInstallSnapshot(const std::string& data)
+{
+  const char* pos = data.data();
+  const char* end = pos + data.size();
+  Origins origins;
+  Dialogs dialogs;
+  Registry registry;
+  
+  boost::uint32_t count = 0;
+  if (!read_value(pos, end, count))
+  {
+    return false;
+  }
+  for (boost::uint32_t i = 0; i < count; i++)
+  {
+    int nodeId = 0;
+    Origin origin;
+    if (!read_value(pos, end, nodeId) || !read_value(pos, end, origin.epoch) || !read_value(pos, end, origin.sequence))
+    {
+      return false;
+    }
+    origins[nodeId] = origin;
+  }
+  
+  if (!read_value(pos, end, count))
+  {
+    return false;
+  }
+  for (boost::uint32_t i = 0; i < count; i++)
+  {
+    std::string key;
+    Dialog dialog;
+    if (!read_string(pos, end, key) || !read_string(pos, end, dialog.callId) || !read_string(pos, end, dialog.json))
+    {
+      return false;
+    }
+    dialogs[key] = dialog;
+  }
+  
+  if (!read_value(pos, end, count))
+  {
+    return false;
+  }
+  for (boost::uint32_t i = 0; i < count; i++)
+  {
+    std::string key;
+    std::string value;
+    if (!read_string(pos, end, key) || !read_string(pos, end, value))
+    {
+      return false;
+    }
+    registry[key] = value;
+  }
+  
+  OSS::mutex_critic_sec_lock lock(_storageMutex);
+  _origins.swap(origins);
+  _dialogs.swap(dialogs);
+  _registry.swap(registry);
+  return true;
+}
+
+
+} } } // OSS::SIP::B2BUA
+
+#endif // ENABLE_FEATURE_B2BUA && ENABLE_FEATURE_NET_EXTRA
@@ -25,6 +25,7 @@
 #include "OSS/ABNF/ABNFSIPIPV4Address.h"
 #include "OSS/ABNF/ABNFSIPIPV6Address.h"
 #include "OSS/SIP/SIPVia.h"
+#include "OSS/Net/DNSTargetResolver.h"
 
 #define THREADED_RESPONSE 0 /// Disable threadpool for response handling.  This is the desired default to avoid race conditions!
 
@@ -126,6 +127,16 @@ void SIPB2BTransaction::runTask()
       throw OSS::SIP::SIPException("Transaction info is missing while calling SIPB2BTransaction::runTask()");
     }
 
+    //
+    // Report how long the request waited since the transport read it
+    //
+    if (_pServerRequest->getReceiveTime())
+    {
+      OSS::UInt64 now = OSS::getTime();
+      OSS::UInt64 receiveTime = _pServerRequest->getReceiveTime();
+      _pManager->stack().overloadControl().recordQueueDelay(now > receiveTime ? now - receiveTime : 0, now);
+    }
+
     _logId =  _pServerTransaction->getLogId();
     _pServerTransaction->attachB2BTransaction(shared_from_this());
 
@@ -684,130 +695,32 @@ bool SIPB2BTransaction::resolveSessionTarget(SIPMessage::Ptr& pClientRequest, OS
   static OSS::ABNF::ABNFEvaluate<OSS::ABNF::ABNFSIPIPV6Address> isIPV6;
 
   std::string logId = pClientRequest->createContextId(true);
-  //TODO: Duplicate code below. Can be refactored to use one helper func for all protos
   if (!port && !isIPV4(host.c_str()) && !isIPV6(host.c_str()))
   {
     OSS_LOG_DEBUG(logId << "SIPB2BTransaction::resolveSessionTarget - Resolving host " << host);
     //
-    // Try DNS/SRV
+    // RFC 3263 NAPTR, SRV then A/AAAA.  The SRV targets are resolved in
+    // parallel and every answer is cached for its TTL.
     //
     OSS::string_to_lower(transport);
-    std::string srvHost = "_sip._udp.";
-    srvHost += host;
-    if ((transport.empty() || transport == "udp") && scheme != "sips")
-      _udpSrvTargets =  OSS::dns_lookup_srv(srvHost);
-
-    srvHost = "_sip._tcp.";
-    srvHost += host;
-
-    if (transport == "tcp" && scheme != "sips")
-      _tcpSrvTargets = OSS::dns_lookup_srv(srvHost);
-
-    srvHost = "_sip._ws.";
-    srvHost += host;
-
-    if (transport == "ws" && scheme != "sips")
-      _wsSrvTargets = OSS::dns_lookup_srv(srvHost);
-    
-    srvHost = "_sip._tls.";
-    srvHost += host;
-    if (transport == "tls" || scheme == "sips")
-      _tlsSrvTargets  = OSS::dns_lookup_srv(srvHost);
-
-    if (!_udpSrvTargets.empty())
+    OSS::Net::DNSTargetResolver::Targets targets =
+      OSS::Net::DNSTargetResolver::instance().resolveTargets(host, transport, scheme == "sips");
+    if (!targets.empty())
     {
-      //
-      // Sort then get the first
-      //
-      unsigned short targetPort = _udpSrvTargets.begin()->get<2>();
-      if (targetPort == 0)
-        targetPort = 5060;
-      target = _udpSrvTargets.begin()->get<1>();
-      target.setPort(targetPort);
+      const OSS::Net::DNSTargetResolver::Target& first = targets.front();
+      target = first.address;
+      target.setPort(first.port);
 
-      OSS_LOG_DEBUG(logId << "SIPB2BTransaction::resolveSessionTarget - DNS/SRV _sip._udp." << host << " -> " << target.toIpPortString());
-      
-      pClientRequest->setProperty(OSS::PropertyMap::PROP_TargetTransport, "udp");
-    }
-    else
-    {
-      if (transport == "udp")
-      {
-        OSS_LOG_DEBUG(logId << "SIPB2BTransaction::resolveSessionTarget - DNS/SRV _sip._udp." << host << " not found ");
-      }
-    }
+      OSS_LOG_DEBUG(logId << "SIPB2BTransaction::resolveSessionTarget - DNS (" << host << ") -> "
+        << first.transport << " " << target.toIpPortString());
 
-    if (!target.isValid() && !_tcpSrvTargets.empty())
-    {
-      //
-      // sort then get the first transport
-      //
-      unsigned short targetPort = _tcpSrvTargets.begin()->get<2>();
-      if (targetPort == 0)
-        targetPort = 5060;
-      target = _tcpSrvTargets.begin()->get<1>();
-      target.setPort(targetPort);
-      
-      OSS_LOG_DEBUG(logId << "SIPB2BTransaction::resolveSessionTarget - DNS/SRV _sip._tcp." << host << " -> " << target.toIpPortString());
-      
-      pClientRequest->setProperty(OSS::PropertyMap::PROP_TargetTransport, "tcp");
+      pClientRequest->setProperty(OSS::PropertyMap::PROP_TargetTransport, first.transport);
     }
-    else if (!target.isValid())
-    {
-      if (transport == "tcp")
-      {
-        OSS_LOG_DEBUG(logId << "SIPB2BTransaction::resolveSessionTarget - DNS/SRV _sip._tcp." << host << " not found ");
-      }
-    }
-    
-    if (!target.isValid() && !_tlsSrvTargets.empty())
-    {
-      //
-      // sort then get the first transport
-      //
-      unsigned short targetPort = _tlsSrvTargets.begin()->get<2>();
-      if (targetPort == 0)
-        targetPort = 5061;
-      target = _tlsSrvTargets.begin()->get<1>();
-      target.setPort(targetPort);
-      
-      OSS_LOG_DEBUG(logId << "SIPB2BTransaction::resolveSessionTarget - DNS/SRV _sip._tls." << host << " -> " << target.toIpPortString());
-      
-      pClientRequest->setProperty(OSS::PropertyMap::PROP_TargetTransport, "tls");
-    }
-    else if (!target.isValid())
-    {
-      if (transport == "tls")
-      {
-        OSS_LOG_DEBUG(logId << "SIPB2BTransaction::resolveSessionTarget - DNS/SRV _sip._tls." << host << " not found ");
-      }
-    }
-
-    if (!target.isValid() && !_wsSrvTargets.empty())
+    else
     {
       //
-      // sort then get the first transport
+      // Not in DNS.  The system resolver may still know it from the hosts file.
       //
-      unsigned short targetPort = _wsSrvTargets.begin()->get<2>();
-      if (targetPort == 0)
-        targetPort = 5060;
-      target = _wsSrvTargets.begin()->get<1>();
-      target.setPort(targetPort);
-      
-      OSS_LOG_DEBUG(logId << "SIPB2BTransaction::resolveSessionTarget - DNS/SRV _sip._ws." << host << " -> " << target.toIpPortString());
-      
-      pClientRequest->setProperty(OSS::PropertyMap::PROP_TargetTransport, "ws");
-    }
-    else if (!target.isValid())
-    {
-      if (transport == "ws")
-      {
-        OSS_LOG_DEBUG(logId << "SIPB2BTransaction::resolveSessionTarget - DNS/SRV _sip._ws." << host << " not found ");
-      }
-    }
-
-    if (!target.isValid())
-    {
       OSS::dns_host_record_list hosts = OSS::dns_lookup_host(host);
       if (hosts.empty())
       {
@@ -817,7 +730,7 @@ bool SIPB2BTransaction::resolveSessionTarget(SIPMessage::Ptr& pClientRequest, OS
         port = 5060;
       target = *(hosts.begin());
       target.setPort(port);
-      
+
       OSS_LOG_DEBUG(logId << "SIPB2BTransaction::resolveSessionTarget - FQDN-1 (" << host << ") -> " << target.toIpPortString());
     }
   }
@@ -109,6 +109,7 @@ void SIPB2BTransactionManager::handleRequest(
 #if SEND_ERROR_ON_B2BUA_THREAD_DEPLETION
     if (_threadPool.schedule(boost::bind(&SIPB2BTransaction::runTask, b2bTransaction)) == -1)
     {
+      stack().overloadControl().recordDepletion();
       OSS::log_error(pMsg->createContextId(true) + "No available thread to handle SIPB2BTransactionManager::handleRequest");
       SIPMessage::Ptr serverError = pMsg->createResponse(500, "Thread Resource Depleted");
       pTransaction->sendResponse(serverError, pTransport->getRemoteAddress());
@@ -122,7 +123,10 @@ void SIPB2BTransactionManager::handleRequest(
     // allowing it to recover.
     //
     if (_threadPool.schedule(boost::bind(&SIPB2BTransaction::runTask, b2bTransaction)) == -1)
+    {
+      stack().overloadControl().recordDepletion();
       b2bTransaction->runTask();
+    }
 #endif
   }
 }
@@ -19,6 +19,9 @@
 //
 
 #include "OSS/BSON/BSONQueue.h"
+#include <cstring>
+#include <cstdlib>
+#include <boost/bind.hpp>
 
 #if ENABLE_FEATURE_ZMQ
 
@@ -28,6 +31,9 @@ namespace BSON {
   
 using OSS::ZMQ::ZMQSocket; 
 
+static const char BSON_QUEUE_ENQUEUE[] = "BSONQueue::enqueue";
+static const std::size_t BSON_QUEUE_ENQUEUE_LEN = sizeof(BSON_QUEUE_ENQUEUE) - 1;
+
     
 BSONQueue::BSONQueue(Role role, const std::string& name) :
   _role(role),
@@ -38,6 +44,15 @@ BSONQueue::BSONQueue(Role role, const std::string& name) :
   _address += _name;
   initSocket();
 }
+
+BSONQueue::BSONQueue(Role role, const std::string& name, const std::string& address) :
+  _role(role),
+  _name(name),
+  _address(address),
+  _pSocket(0)
+{
+  initSocket();
+}
     
 BSONQueue::~BSONQueue()
 {
@@ -61,31 +76,139 @@ bool BSONQueue::enqueue(BSONParser& msg)
     return false;
   }
   
-  std::string data((const char*)msg.getData(), msg.getDataLength());
-  return _pSocket->sendRequest("BSONQueue::enqueue", data);
+  zmq::message_t data(msg.getDataLength());
+  memcpy(data.data(), msg.getData(), msg.getDataLength());
+  return _pSocket->sendRequest(BSON_QUEUE_ENQUEUE, data);
 }
 
 bool BSONQueue::dequeue(BSONParser& msg)
 {
-  if (_role != CONSUMER)
+  if (!receive())
+  {
+    return false;
+  }
+  msg.reset((const uint8_t*)_message.data(), _message.size());
+  return true;
+}
+
+static void bson_queue_free(void* data, void* hint)
+{
+  free(data);
+}
+
+bool BSONQueue::enqueue(BSONWriter& msg)
+{
+  if (!_pSocket || _role != PRODUCER)
+  {
+    return false;
+  }
+  
+  if (!msg.finish())
+  {
+    return false;
+  }
+  
+  std::size_t len = msg.getDataLength();
+  if (msg.ownsBuffer())
+  {
+    uint8_t* data = msg.release();
+    zmq::message_t message(data, len, bson_queue_free, 0);
+    return _pSocket->sendRequest(BSON_QUEUE_ENQUEUE, message);
+  }
+  
+  zmq::message_t message(len);
+  memcpy(message.data(), msg.getData(), len);
+  return _pSocket->sendRequest(BSON_QUEUE_ENQUEUE, message);
+}
+
+bool BSONQueue::dequeue(BSONView& msg)
+{
+  msg.clear();
+  if (!receive())
+  {
+    return false;
+  }
+  return msg.reset((const uint8_t*)_message.data(), _message.size());
+}
+
+bool BSONQueue::receive()
+{
+  if (!_pSocket || _role != CONSUMER)
   {
     return false;
   }
   
   std::string cmd;
-  std::string bson;
-  if (!_pSocket->receiveRequest(cmd, bson))
+  if (!_pSocket->receiveRequest(cmd, _message))
   {
     return false;
   }
   
-  if (cmd != "BSONQueue::enqueue" || bson.empty())
+  return cmd == BSON_QUEUE_ENQUEUE && _message.size() != 0;
+}
+
+bool BSONQueue::tryDequeue(BSONView& msg)
+{
+  msg.clear();
+  if (!_pSocket || _role != CONSUMER)
   {
     return false;
   }
   
-  msg.reset((uint8_t*)bson.data(), bson.size());
-  return true;
+  zmq::message_t cmd;
+  if (!_pSocket->tryReceiveRequest(cmd, _message))
+  {
+    return false;
+  }
+  
+  if (cmd.size() != BSON_QUEUE_ENQUEUE_LEN || memcmp(cmd.data(), BSON_QUEUE_ENQUEUE, BSON_QUEUE_ENQUEUE_LEN) != 0)
+  {
+    return false;
+  }
+  return msg.reset((const uint8_t*)_message.data(), _message.size());
+}
+
+std::size_t BSONQueue::dequeue(const Handler& handler, std::size_t maxCount)
+{
+  if (!_pSocket || _role != CONSUMER)
+  {
+    return 0;
+  }
+  
+  BSONView view;
+  return _pSocket->receiveRequests(boost::bind(&BSONQueue::onReceived, this, boost::cref(handler), boost::ref(view), _1, _2), maxCount);
+}
+
+void BSONQueue::onReceived(const Handler& handler, BSONView& view, zmq::message_t& cmd, zmq::message_t& data)
+{
+  if (cmd.size() != BSON_QUEUE_ENQUEUE_LEN || memcmp(cmd.data(), BSON_QUEUE_ENQUEUE, BSON_QUEUE_ENQUEUE_LEN) != 0)
+  {
+    return;
+  }
+  
+  if (view.reset((const uint8_t*)data.data(), data.size()))
+  {
+    handler(view);
+  }
+}
+
+bool BSONQueue::watch(ZMQ::ZMQPoller& poller, const Handler& handler, std::size_t batchSize)
+{
+  if (!_pSocket || _role != CONSUMER)
+  {
+    return false;
+  }
+  
+  std::size_t (BSONQueue::*drain)(const Handler&, std::size_t) = &BSONQueue::dequeue;
+  return poller.watch(*_pSocket, boost::bind(drain, this, handler, batchSize));
+}
+
+void BSONQueue::unwatch(ZMQ::ZMQPoller& poller)
+{
+  if (_pSocket)
+  {
+    poller.unwatch(*_pSocket);
+  }
 }
 
 bool BSONQueue::enqueue(BSONDocument& msg)
@@ -0,0 +1,354 @@
+// Library: OSS_CORE - Foundation API for SIP B2BUA
+// Copyright (c) OSS Software Solutions
+// Contributor: Joegen Baclor - mailto:joegen@ossapp.com
+//
+// Permission is hereby granted, to any person or organization
+// obtaining a copy of the software and accompanying documentation covered by
+// this license (the "Software") to use, execute, and to prepare
+// derivative works of the Software, all subject to the
+// "GNU Lesser General Public License (LGPL)".
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+// SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+// FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+
+
+#include "OSS/BSON/BSONView.h"
+#include <cstring>
+
+
+namespace OSS {
+namespace BSON {
+
+
+static inline uint32_t bson_view_read_uint32(const uint8_t* p)
+{
+  return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static inline uint64_t bson_view_read_uint64(const uint8_t* p)
+{
+  return (uint64_t)bson_view_read_uint32(p) | ((uint64_t)bson_view_read_uint32(p + 4) << 32);
+}
+
+static inline bool bson_view_cstring_length(const uint8_t* p, std::size_t avail, std::size_t& len)
+{
+  const void* end = memchr(p, 0, avail);
+  if (!end)
+  {
+    return false;
+  }
+  len = (const uint8_t*)end - p;
+  return true;
+}
+
+static bool bson_view_string_length(const uint8_t* p, std::size_t avail, std::size_t& len)
+{
+  if (avail < 4)
+  {
+    return false;
+  }
+  uint32_t strLen = bson_view_read_uint32(p);
+  if (strLen < 1 || strLen > avail - 4 || p[4 + strLen - 1] != 0)
+  {
+    return false;
+  }
+  len = 4 + strLen;
+  return true;
+}
+
+BSONView::BSONView() :
+  _data(0),
+  _len(0)
+{
+}
+
+BSONView::BSONView(const uint8_t* data, std::size_t len) :
+  _data(0),
+  _len(0)
+{
+  reset(data, len);
+}
+
+void BSONView::clear()
+{
+  _data = 0;
+  _len = 0;
+  _index.clear();
+}
+
+bool BSONView::reset(const uint8_t* data, std::size_t len)
+{
+  clear();
+  if (!data)
+  {
+    return false;
+  }
+  std::string prefix;
+  if (!indexDocument(data, len, prefix, 0))
+  {
+    _index.clear();
+    return false;
+  }
+  _data = data;
+  _len = len;
+  return true;
+}
+
+bool BSONView::indexDocument(const uint8_t* data, std::size_t len, std::string& prefix, std::size_t depth)
+{
+  if (depth > MAX_DEPTH || len < 5 || bson_view_read_uint32(data) != len || data[len - 1] != 0)
+  {
+    return false;
+  }
+
+  std::size_t prefixLen = prefix.size();
+  const uint8_t* end = data + len - 1;
+  const uint8_t* p = data + 4;
+
+  while (p < end)
+  {
+    uint8_t type = *p++;
+
+    std::size_t keyLen = 0;
+    if (!bson_view_cstring_length(p, end - p, keyLen))
+    {
+      return false;
+    }
+    const char* key = (const char*)p;
+    p += keyLen + 1;
+
+    std::size_t avail = end - p;
+    std::size_t valueLen = 0;
+    std::size_t len1 = 0;
+    std::size_t len2 = 0;
+    bool isContainer = false;
+
+    switch (type)
+    {
+    case 0x01: // double
+    case 0x09: // date time
+    case 0x11: // timestamp
+    case 0x12: // int64
+      valueLen = 8;
+      break;
+    case 0x02: // utf8
+    case 0x0D: // javascript
+    case 0x0E: // symbol
+      if (!bson_view_string_length(p, avail, valueLen))
+      {
+        return false;
+      }
+      break;
+    case 0x03: // document
+    case 0x04: // array
+      if (avail < 5)
+      {
+        return false;
+      }
+      valueLen = bson_view_read_uint32(p);
+      isContainer = true;
+      break;
+    case 0x05: // binary
+      if (avail < 5)
+      {
+        return false;
+      }
+      valueLen = 5 + (std::size_t)bson_view_read_uint32(p);
+      if (valueLen < 5)
+      {
+        return false;
+      }
+      break;
+    case 0x06: // undefined
+    case 0x0A: // null
+    case 0x7F: // max key
+    case 0xFF: // min key
+      valueLen = 0;
+      break;
+    case 0x07: // object id
+      valueLen = 12;
+      break;
+    case 0x08: // bool
+      valueLen = 1;
+      if (avail >= 1 && p[0] > 1)
+      {
+        return false;
+      }
+      break;
+    case 0x0B: // regex
+      if (!bson_view_cstring_length(p, avail, len1) ||
+        !bson_view_cstring_length(p + len1 + 1, avail - len1 - 1, len2))
+      {
+        return false;
+      }
+      valueLen = len1 + 1 + len2 + 1;
+      break;
+    case 0x0C: // db pointer
+      if (!bson_view_string_length(p, avail, len1))
+      {
+        return false;
+      }
+      valueLen = len1 + 12;
+      break;
+    case 0x0F: // javascript with scope
+      if (avail < 4)
+      {
+        return false;
+      }
+      valueLen = bson_view_read_uint32(p);
+      break;
+    case 0x10: // int32
+      valueLen = 4;
+      break;
+    case 0x13: // decimal128
+      valueLen = 16;
+      break;
+    default:
+      return false;
+    }
+
+    if (valueLen > avail)
+    {
+      return false;
+    }
+
+    prefix.append(key, keyLen);
+
+    Element element;
+    element.type = type;
+    element.value = p;
+    element.length = (uint32_t)valueLen;
+    //
+    // insert() keeps the first occurrence of a duplicate key which is
+    // what libbson returns for a linear search
+    //
+    _index.insert(Index::value_type(prefix, element));
+
+    if (isContainer)
+    {
+      prefix.push_back('.');
+      if (!indexDocument(p, valueLen, prefix, depth + 1))
+      {
+        return false;
+      }
+    }
+
+    prefix.resize(prefixLen);
+    p += valueLen;
+  }
+
+  return p == end;
+}
+
+bool BSONView::getString(const std::string& key, const char*& value, std::size_t& len) const
+{
+  const Element* element = findElement(key);
+  if (!element || element->type != 0x02)
+  {
+    return false;
+  }
+  value = (const char*)element->value + 4;
+  len = element->length - 5;
+  return true;
+}
+
+bool BSONView::getString(const std::string& key, std::string& value) const
+{
+  const char* str = 0;
+  std::size_t len = 0;
+  if (!getString(key, str, len))
+  {
+    return false;
+  }
+  value.assign(str, len);
+  return true;
+}
+
+bool BSONView::getBoolean(const std::string& key, bool& value) const
+{
+  const Element* element = findElement(key);
+  if (!element || element->type != 0x08)
+  {
+    return false;
+  }
+  value = element->value[0] != 0;
+  return true;
+}
+
+bool BSONView::getInt32(const std::string& key, int32_t& value) const
+{
+  const Element* element = findElement(key);
+  if (!element || element->type != 0x10)
+  {
+    return false;
+  }
+  value = (int32_t)bson_view_read_uint32(element->value);
+  return true;
+}
+
+bool BSONView::getInt64(const std::string& key, int64_t& value) const
+{
+  const Element* element = findElement(key);
+  if (!element || element->type != 0x12)
+  {
+    return false;
+  }
+  value = (int64_t)bson_view_read_uint64(element->value);
+  return true;
+}
+
+bool BSONView::getIntptr(const std::string& key, intptr_t& value) const
+{
+  if (sizeof(intptr_t) == sizeof(int32_t))
+  {
+    int32_t val;
+    if (!getInt32(key, val))
+    {
+      return false;
+    }
+    value = (intptr_t)val;
+  }
+  else
+  {
+    int64_t val;
+    if (!getInt64(key, val))
+    {
+      return false;
+    }
+    value = (intptr_t)val;
+  }
+  return true;
+}
+
+bool BSONView::getDouble(const std::string& key, double& value) const
+{
+  const Element* element = findElement(key);
+  if (!element || element->type != 0x01)
+  {
+    return false;
+  }
+  uint64_t bits = bson_view_read_uint64(element->value);
+  memcpy(&value, &bits, sizeof(value));
+  return true;
+}
+
+bool BSONView::getBinary(const std::string& key, const uint8_t*& data, std::size_t& len) const
+{
+  const Element* element = findElement(key);
+  if (!element || element->type != 0x05)
+  {
+    return false;
+  }
+  data = element->value + 5;
+  len = element->length - 5;
+  return true;
+}
+
+
+} } // OSS::BSON
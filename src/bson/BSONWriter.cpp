@@ -0,0 +1,382 @@
+// Library: OSS_CORE - Foundation API for SIP B2BUA
+// Copyright (c) OSS Software Solutions
+// Contributor: Joegen Baclor - mailto:joegen@ossapp.com
+//
+// Permission is hereby granted, to any person or organization
+// obtaining a copy of the software and accompanying documentation covered by
+// this license (the "Software") to use, execute, and to prepare
+// derivative works of the Software, all subject to the
+// "GNU Lesser General Public License (LGPL)".
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+// SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+// FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+
+
+#include "OSS/BSON/BSONWriter.h"
+#include <cstdlib>
+
+
+namespace OSS {
+namespace BSON {
+
+
+enum
+{
+  BSON_WRITER_TYPE_DOUBLE = 0x01,
+  BSON_WRITER_TYPE_UTF8 = 0x02,
+  BSON_WRITER_TYPE_DOCUMENT = 0x03,
+  BSON_WRITER_TYPE_ARRAY = 0x04,
+  BSON_WRITER_TYPE_BINARY = 0x05,
+  BSON_WRITER_TYPE_UNDEFINED = 0x06,
+  BSON_WRITER_TYPE_BOOL = 0x08,
+  BSON_WRITER_TYPE_NULL = 0x0A,
+  BSON_WRITER_TYPE_INT32 = 0x10,
+  BSON_WRITER_TYPE_INT64 = 0x12
+};
+
+static const std::size_t BSON_WRITER_INITIAL_SIZE = 256;
+
+
+BSONWriter::BSONWriter() :
+  _data(0),
+  _size(0),
+  _capacity(0),
+  _string(0),
+  _owned(true),
+  _overflow(false),
+  _finished(false),
+  _depth(0)
+{
+  reset();
+}
+
+BSONWriter::BSONWriter(std::string& buffer) :
+  _data(0),
+  _size(0),
+  _capacity(0),
+  _string(&buffer),
+  _owned(false),
+  _overflow(false),
+  _finished(false),
+  _depth(0)
+{
+  reset();
+}
+
+BSONWriter::BSONWriter(uint8_t* buffer, std::size_t capacity) :
+  _data(buffer),
+  _size(0),
+  _capacity(capacity),
+  _string(0),
+  _owned(false),
+  _overflow(false),
+  _finished(false),
+  _depth(0)
+{
+  reset();
+}
+
+BSONWriter::~BSONWriter()
+{
+  if (_owned)
+  {
+    free(_data);
+  }
+}
+
+void BSONWriter::reset()
+{
+  _size = 0;
+  _depth = 0;
+  _overflow = false;
+  _finished = false;
+  if (_string)
+  {
+    //
+    // Use whatever the string already holds.  clear() followed by resize()
+    // keeps the allocation around.
+    //
+    _string->resize(_string->capacity() < BSON_WRITER_INITIAL_SIZE ? BSON_WRITER_INITIAL_SIZE : _string->capacity());
+    _data = (uint8_t*)&(*_string)[0];
+    _capacity = _string->size();
+  }
+  //
+  // Space for the length of the top level document.  It is filled in by finish()
+  //
+  if (!reserve(4))
+  {
+    _overflow = true;
+    return;
+  }
+  _size = 4;
+}
+
+bool BSONWriter::reserve(std::size_t len)
+{
+  std::size_t required = _size + len;
+  if (required <= _capacity)
+  {
+    return true;
+  }
+
+  if (required > (std::size_t)0x7fffffff)
+  {
+    return false;
+  }
+
+  std::size_t capacity = _capacity ? _capacity : BSON_WRITER_INITIAL_SIZE;
+  while (capacity < required)
+  {
+    capacity *= 2;
+  }
+
+  if (_string)
+  {
+    _string->resize(capacity);
+    _data = (uint8_t*)&(*_string)[0];
+  }
+  else if (_owned)
+  {
+    uint8_t* data = (uint8_t*)realloc(_data, capacity);
+    if (!data)
+    {
+      return false;
+    }
+    _data = data;
+  }
+  else
+  {
+    //
+    // Fixed arena
+    //
+    return false;
+  }
+  _capacity = capacity;
+  return true;
+}
+
+void BSONWriter::writeInt32(std::size_t offset, int32_t value)
+{
+  uint32_t v = (uint32_t)value;
+  _data[offset] = (uint8_t)(v);
+  _data[offset + 1] = (uint8_t)(v >> 8);
+  _data[offset + 2] = (uint8_t)(v >> 16);
+  _data[offset + 3] = (uint8_t)(v >> 24);
+}
+
+void BSONWriter::writeInt64(std::size_t offset, int64_t value)
+{
+  uint64_t v = (uint64_t)value;
+  writeInt32(offset, (int32_t)(uint32_t)(v));
+  writeInt32(offset + 4, (int32_t)(uint32_t)(v >> 32));
+}
+
+bool BSONWriter::beginElement(uint8_t type, const char* key, std::size_t valueLen)
+{
+  if (_overflow || _finished)
+  {
+    return false;
+  }
+  std::size_t keyLen = strlen(key);
+  if (!reserve(1 + keyLen + 1 + valueLen))
+  {
+    _overflow = true;
+    return false;
+  }
+  _data[_size++] = type;
+  memcpy(_data + _size, key, keyLen + 1);
+  _size += keyLen + 1;
+  return true;
+}
+
+bool BSONWriter::appendString(const char* key, const char* value, std::size_t len)
+{
+  if (!beginElement(BSON_WRITER_TYPE_UTF8, key, 4 + len + 1))
+  {
+    return false;
+  }
+  writeInt32(_size, (int32_t)(len + 1));
+  _size += 4;
+  memcpy(_data + _size, value, len);
+  _size += len;
+  _data[_size++] = 0;
+  return true;
+}
+
+bool BSONWriter::appendBoolean(const char* key, bool value)
+{
+  if (!beginElement(BSON_WRITER_TYPE_BOOL, key, 1))
+  {
+    return false;
+  }
+  _data[_size++] = value ? 1 : 0;
+  return true;
+}
+
+bool BSONWriter::appendInt32(const char* key, int32_t value)
+{
+  if (!beginElement(BSON_WRITER_TYPE_INT32, key, 4))
+  {
+    return false;
+  }
+  writeInt32(_size, value);
+  _size += 4;
+  return true;
+}
+
+bool BSONWriter::appendInt64(const char* key, int64_t value)
+{
+  if (!beginElement(BSON_WRITER_TYPE_INT64, key, 8))
+  {
+    return false;
+  }
+  writeInt64(_size, value);
+  _size += 8;
+  return true;
+}
+
+bool BSONWriter::appendDouble(const char* key, double value)
+{
+  if (!beginElement(BSON_WRITER_TYPE_DOUBLE, key, 8))
+  {
+    return false;
+  }
+  int64_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  writeInt64(_size, bits);
+  _size += 8;
+  return true;
+}
+
+bool BSONWriter::appendUndefined(const std::string& key)
+{
+  return beginElement(BSON_WRITER_TYPE_UNDEFINED, key.c_str(), 0);
+}
+
+bool BSONWriter::appendNull(const std::string& key)
+{
+  return beginElement(BSON_WRITER_TYPE_NULL, key.c_str(), 0);
+}
+
+bool BSONWriter::appendBinary(const char* key, const uint8_t* data, std::size_t len)
+{
+  if (!beginElement(BSON_WRITER_TYPE_BINARY, key, 4 + 1 + len))
+  {
+    return false;
+  }
+  writeInt32(_size, (int32_t)len);
+  _size += 4;
+  _data[_size++] = 0; // generic subtype
+  if (len)
+  {
+    memcpy(_data + _size, data, len);
+    _size += len;
+  }
+  return true;
+}
+
+bool BSONWriter::beginContainer(uint8_t type, const std::string& key)
+{
+  if (_depth >= MAX_DEPTH)
+  {
+    return false;
+  }
+  if (!beginElement(type, key.c_str(), 4))
+  {
+    return false;
+  }
+  _stack[_depth] = _size;
+  _types[_depth] = type;
+  _depth++;
+  _size += 4;
+  return true;
+}
+
+bool BSONWriter::endContainer(uint8_t type)
+{
+  if (_overflow || _finished || !_depth || _types[_depth - 1] != type)
+  {
+    return false;
+  }
+  if (!reserve(1))
+  {
+    _overflow = true;
+    return false;
+  }
+  _data[_size++] = 0;
+  _depth--;
+  writeInt32(_stack[_depth], (int32_t)(_size - _stack[_depth]));
+  return true;
+}
+
+bool BSONWriter::appendDocumentBegin(const std::string& key)
+{
+  return beginContainer(BSON_WRITER_TYPE_DOCUMENT, key);
+}
+
+bool BSONWriter::appendDocumentEnd()
+{
+  return endContainer(BSON_WRITER_TYPE_DOCUMENT);
+}
+
+bool BSONWriter::appendArrayBegin(const std::string& key)
+{
+  return beginContainer(BSON_WRITER_TYPE_ARRAY, key);
+}
+
+bool BSONWriter::appendArrayEnd()
+{
+  return endContainer(BSON_WRITER_TYPE_ARRAY);
+}
+
+bool BSONWriter::finish()
+{
+  if (_finished)
+  {
+    return true;
+  }
+  if (_overflow || _depth)
+  {
+    return false;
+  }
+  if (!reserve(1))
+  {
+    _overflow = true;
+    return false;
+  }
+  _data[_size++] = 0;
+  writeInt32(0, (int32_t)_size);
+  if (_string)
+  {
+    //
+    // Shrinking a string never gives back its capacity
+    //
+    _string->resize(_size);
+    _data = (uint8_t*)&(*_string)[0];
+    _capacity = _size;
+  }
+  _finished = true;
+  return true;
+}
+
+uint8_t* BSONWriter::release()
+{
+  if (!_owned || !_finished)
+  {
+    return 0;
+  }
+  uint8_t* data = _data;
+  _data = 0;
+  _capacity = 0;
+  reset();
+  return data;
+}
+
+
+} } // OSS::BSON
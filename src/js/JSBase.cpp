@@ -222,10 +222,10 @@ static v8::Handle<v8::Value> log_error_callback(const v8::Arguments& args)
   return v8::Undefined();
 }
 
-// Reads a file into a v8 string.
-static v8::Handle<v8::String> read_file(const std::string& name) {
+// Reads a file into a string.
+static bool read_file(const std::string& name, std::string& data) {
   FILE* file = fopen(name.c_str(), "rb");
-  if (file == NULL) return v8::Handle<v8::String>();
+  if (file == NULL) return false;
 
   fseek(file, 0, SEEK_END);
   int size = ftell(file);
@@ -238,12 +238,12 @@ static v8::Handle<v8::String> read_file(const std::string& name) {
     i += read;
   }
   fclose(file);
-  v8::Handle<v8::String> result = v8::String::New(chars, size);
+  data = std::string(chars, size);
   delete[] chars;
-  return result;
+  return true;
 }
 
-static v8::Handle<v8::String> read_global_scripts()
+static const std::string& read_global_scripts()
 {
   static std::string gAccessList(
     #include "./scripts/JS_AccessList.h"
@@ -269,15 +269,14 @@ static v8::Handle<v8::String> read_global_scripts()
     #include "./scripts/JS_TransactionProfile.h"
   ); 
   
-  std::ostringstream data;
-  data  << gAccessList 
-        << gAuthProfile
-        << gPropertyObject
-        << gRouteProfile
-        << gSIPMessage
-        << gTransactionProfile;
+  static std::string gGlobalScripts = gAccessList
+    + gAuthProfile
+    + gPropertyObject
+    + gRouteProfile
+    + gSIPMessage
+    + gTransactionProfile;
   
-  return  v8::String::New(data.str().c_str(), data.str().size());
+  return gGlobalScripts;
 }
 
 v8::Handle<v8::String> load_scripts_from_directory(const boost::filesystem::path& directory)
@@ -346,8 +345,6 @@ v8::Handle<v8::String> load_scripts_from_directory(const boost::filesystem::path
 
 
 
-static std::string V8ErrorReport;
-static bool _hasSetErrorCB = false;
 static void V8ErrorMessageCallback(v8::Handle<v8::Message> message,
 v8::Handle<v8::Value> data)
 {
@@ -358,32 +355,78 @@ v8::Handle<v8::Value> data)
   OSS::log_error(error);
 }
 
-JSBase::JSBase(const std::string& contextName) :
+struct BoundaryCrossings
+{
+  BoundaryCrossings() : current(0), last(0) {}
+  OSS::UInt64 current;
+  OSS::UInt64 last;
+};
+static boost::thread_specific_ptr<BoundaryCrossings> gBoundaryCrossings;
+
+static BoundaryCrossings& boundary_crossings()
+{
+  BoundaryCrossings* pCrossings = gBoundaryCrossings.get();
+  if (!pCrossings)
+  {
+    pCrossings = new BoundaryCrossings();
+    gBoundaryCrossings.reset(pCrossings);
+  }
+  return *pCrossings;
+}
+
+void JSBase::countBoundaryCrossing()
+{
+  boundary_crossings().current++;
+}
+
+OSS::UInt64 JSBase::getLastBoundaryCrossings()
+{
+  return boundary_crossings().last;
+}
+
+JSBase::Isolate::Isolate() :
+  isolate(0),
+  context(0),
+  processFunc(0),
+  requestTemplate(0),
+  globalTemplate(0),
+  generation(0),
+  isInitialized(false)
+{
+}
+
+JSBase::JSBase(const std::string& contextName, std::size_t poolSize) :
   _contextName(contextName),
-  _context(0),
-  _processFunc(0),
-  _requestTemplate(0),
-  _globalTemplate(0),
   _isInitialized(false),
-  _extensionGlobals(0)
+  _extensionGlobals(0),
+  _poolSize(poolSize ? poolSize : 1),
+  _nextIsolate(0),
+  _generation(0),
+  _totalBoundaryCrossings(0),
+  _totalProcessedRequests(0)
 {
 }
 
 JSBase::~JSBase()
 {
-  if (_globalTemplate)
+  for (IsolatePool::iterator iter = _pool.begin(); iter != _pool.end(); iter++)
   {
-    static_cast<v8::Persistent<v8::ObjectTemplate>*>(_globalTemplate)->Dispose();
-    static_cast<v8::Persistent<v8::ObjectTemplate>*>(_requestTemplate)->Dispose();
-    static_cast<v8::Persistent<v8::Function>*>(_processFunc)->Dispose();
-    static_cast<v8::Persistent<v8::Context>*>(_context)->Dispose();
+    Isolate& isolate = *(*iter);
+    OSS::mutex_critic_sec_lock lock(isolate.mutex);
+    v8::Isolate* pIsolate = static_cast<v8::Isolate*>(isolate.isolate);
+    if (!pIsolate)
+      continue;
+    
+    do
+    {
+      v8::Locker __v8Locker__(pIsolate);
+      v8::Isolate::Scope isolate_scope(pIsolate);
+      disposeIsolate(isolate);
+    } while (false);
+    
+    pIsolate->Dispose();
+    isolate.isolate = 0;
   }
-
-  delete static_cast<v8::Persistent<v8::ObjectTemplate>*>(_globalTemplate);
-  delete static_cast<v8::Persistent<v8::ObjectTemplate>*>(_requestTemplate);
-  delete static_cast<v8::Persistent<v8::Function>*>(_processFunc);
-  delete static_cast<v8::Persistent<v8::Context>*>(_context);
-
 }
 
 bool JSBase::initialize(const boost::filesystem::path& scriptFile, const std::string& functionName,
@@ -392,84 +435,162 @@ bool JSBase::initialize(const boost::filesystem::path& scriptFile, const std::st
   return internalInitialize(scriptFile, functionName, extensionGlobals);
 }
 
-bool JSBase::internalInitialize(
-  const boost::filesystem::path& scriptFile, const std::string& functionName,
-  void(*extensionGlobals)(OSS_HANDLE) )
+void JSBase::disposeIsolate(Isolate& isolate)
 {
-  v8::Locker __v8Locker__;
-  
-  if (!boost::filesystem::exists(scriptFile))
-  {
-    OSS_LOG_ERROR("Google V8 is unable to locate file " << scriptFile);
-    return false;
-  }
-
-  //OSS_LOG_INFO("Google V8 JSBase::internalInitialize INVOKED");
-
-  // Create a handle scope to hold the temporary references.
-  v8::HandleScope handle_scope;
-  
-  v8::Persistent<v8::ObjectTemplate>* oldGlobalTemplate = static_cast<v8::Persistent<v8::ObjectTemplate>*>(_globalTemplate);
-  v8::Persistent<v8::ObjectTemplate>* oldRequestTemplate = static_cast<v8::Persistent<v8::ObjectTemplate>*>(_requestTemplate);
-  v8::Persistent<v8::Function>* oldProcessFunc = static_cast<v8::Persistent<v8::Function>*>(_processFunc);
-  v8::Persistent<v8::Context>* oldContext = static_cast<v8::Persistent<v8::Context>*>(_context);
+  v8::Persistent<v8::ObjectTemplate>* oldGlobalTemplate = static_cast<v8::Persistent<v8::ObjectTemplate>*>(isolate.globalTemplate);
+  v8::Persistent<v8::ObjectTemplate>* oldRequestTemplate = static_cast<v8::Persistent<v8::ObjectTemplate>*>(isolate.requestTemplate);
+  v8::Persistent<v8::Function>* oldProcessFunc = static_cast<v8::Persistent<v8::Function>*>(isolate.processFunc);
+  v8::Persistent<v8::Context>* oldContext = static_cast<v8::Persistent<v8::Context>*>(isolate.context);
 
   if (oldContext)
   {
+    v8::HandleScope handle_scope;
     (*oldContext)->DetachGlobal();
     oldContext->Dispose();
-    delete static_cast<v8::Persistent<v8::Context>*>(oldContext);
-    _context = 0;
+    delete oldContext;
+    isolate.context = 0;
   }
   
   if (oldGlobalTemplate)
   {
     oldGlobalTemplate->Dispose();
-    delete static_cast<v8::Persistent<v8::ObjectTemplate>*>(oldGlobalTemplate);
-    _globalTemplate = 0;
+    delete oldGlobalTemplate;
+    isolate.globalTemplate = 0;
   }
 
   if (oldRequestTemplate)
   {
     oldRequestTemplate->Dispose();
-    delete static_cast<v8::Persistent<v8::ObjectTemplate>*>(oldRequestTemplate);
-    _requestTemplate = 0;
+    delete oldRequestTemplate;
+    isolate.requestTemplate = 0;
   }
 
   if (oldProcessFunc)
   {
     oldProcessFunc->Dispose();
-    delete static_cast<v8::Persistent<v8::Function>*>(oldProcessFunc);
-    _processFunc = 0;
+    delete oldProcessFunc;
+    isolate.processFunc = 0;
   }
+  
+  isolate.isInitialized = false;
+}
 
+bool JSBase::loadScriptCache(ScriptCache& cache) const
+{
+  //
+  // The global exports are always compiled first
+  //
+  CompiledScript globals;
+  globals.name = "global.detail";
+  globals.source = read_global_scripts();
+  cache.push_back(globals);
+  
+  //
+  // Followed by the helpers
+  //
+  boost::filesystem::path helpers;
+  if (!_helperScriptsDirectory.empty())
+    helpers = boost::filesystem::path(_helperScriptsDirectory);
+  else
+    helpers = OSS::boost_path(_script) + ".detail";
+  if (boost::filesystem::exists(helpers))
+  {
+    //
+    // This script has a heper directory
+    //
+    try
+    {
+      boost::filesystem::directory_iterator end_itr; // default construction yields past-the-end
+      for (boost::filesystem::directory_iterator itr(helpers); itr != end_itr; ++itr)
+      {
+        if (boost::filesystem::is_directory(itr->status()))
+        {
+          continue;
+        }
+        
+        std::string fileName = OSS::boost_file_name(itr->path());
+        boost::filesystem::path currentFile = itr->path();
 
-  v8::Persistent<v8::Context>* context_ = new v8::Persistent<v8::Context>();
-  v8::Persistent<v8::Function>* processFunc_ = new v8::Persistent<v8::Function>();
-  v8::Persistent<v8::ObjectTemplate>* requestTemplate_ = new v8::Persistent<v8::ObjectTemplate>;
-  v8::Persistent<v8::ObjectTemplate>* globalTemplate_ = new v8::Persistent<v8::ObjectTemplate>;
-  _context = context_;
-  _processFunc = processFunc_;
-  _requestTemplate = requestTemplate_;
-  _globalTemplate = globalTemplate_;
-  _functionName = functionName;
-  _script = scriptFile;
-  _extensionGlobals = extensionGlobals;
-
-  if (!_hasSetErrorCB)
+        if (boost::filesystem::is_regular(currentFile) && OSS::string_ends_with(fileName, ".js"))
+        {
+          CompiledScript helper;
+          helper.name = OSS::boost_path(currentFile);
+          if (!read_file(helper.name, helper.source))
+          {
+            OSS_LOG_ERROR("Google V8 failed to open file " << currentFile);
+            return false;
+          }
+          cache.push_back(helper);
+        }
+      }
+    }
+    catch(OSS::Exception e)
+    {
+      std::ostringstream logMsg;
+      logMsg << "Filesystem error while compiling script helpers - " << e.message();
+      OSS::log_warning(logMsg.str());
+    }
+  }
+  
+  //
+  // And lastly the main script
+  //
+  CompiledScript main;
+  main.name = OSS::boost_path(_script);
+  if (!read_file(main.name, main.source))
   {
-    if (!_hasSetErrorCB)
-      v8::V8::AddMessageListener(V8ErrorMessageCallback);
+    OSS_LOG_ERROR("Google V8 failed to open file " << _script);
+    return false;
   }
+  cache.push_back(main);
   
+  //
+  // Pick up persisted pre-compilation data
+  //
+  for (ScriptCache::iterator iter = cache.begin(); iter != cache.end(); iter++)
+  {
+    iter->key = JSCodeCache::createKey(std::string("v8-") + v8::V8::GetVersion(), iter->name, iter->source);
+    _codeCache.load(iter->key, iter->preparseData);
+  }
   
+  return true;
+}
+
+bool JSBase::compileIsolate(Isolate& isolate, ScriptCache& cache, OSS::UInt64 generation, bool updateCache)
+{
+  if (!isolate.isolate)
+    isolate.isolate = v8::Isolate::New();
+  
+  v8::Isolate* pIsolate = static_cast<v8::Isolate*>(isolate.isolate);
+  v8::Locker __v8Locker__(pIsolate);
+  v8::Isolate::Scope isolate_scope(pIsolate);
+  
+  if (!isolate.context)
+  {
+    //
+    // Message listeners are registered per isolate
+    //
+    v8::V8::AddMessageListener(V8ErrorMessageCallback);
+  }
+  
+  disposeIsolate(isolate);
+
+  // Create a handle scope to hold the temporary references.
+  v8::HandleScope handle_scope;
+
+  v8::Persistent<v8::Context>* context_ = new v8::Persistent<v8::Context>();
+  v8::Persistent<v8::Function>* processFunc_ = new v8::Persistent<v8::Function>();
+  v8::Persistent<v8::ObjectTemplate>* requestTemplate_ = new v8::Persistent<v8::ObjectTemplate>;
+  v8::Persistent<v8::ObjectTemplate>* globalTemplate_ = new v8::Persistent<v8::ObjectTemplate>;
+  isolate.context = context_;
+  isolate.processFunc = processFunc_;
+  isolate.requestTemplate = requestTemplate_;
+  isolate.globalTemplate = globalTemplate_;
 
-  //OSS_LOG_INFO("Google V8 is loading context for " << _script);
   // Create a template for the global object where we set the
   // built-in global functions.
-  //v8::Handle<v8::ObjectTemplate> global = v8::ObjectTemplate::New();
   v8::Handle<v8::ObjectTemplate> global = v8::ObjectTemplate::New();
-  *(static_cast<v8::Persistent<v8::ObjectTemplate>*>(_globalTemplate)) = v8::Persistent<v8::ObjectTemplate>::New(global);
+  *globalTemplate_ = v8::Persistent<v8::ObjectTemplate>::New(global);
   global->Set(v8::String::New("log_info"), v8::FunctionTemplate::New(log_info_callback));
   global->Set(v8::String::New("log_debug"), v8::FunctionTemplate::New(log_debug_callback));
   global->Set(v8::String::New("log_error"), v8::FunctionTemplate::New(log_error_callback));
@@ -477,189 +598,90 @@ bool JSBase::internalInitialize(
   //
   // Initialize subclass global functions
   //
-  //OSS_LOG_INFO("Google V8 is initializing global exports for " << _script);
-  initGlobalFuncs(_globalTemplate);
+  initGlobalFuncs(isolate.globalTemplate);
 
   //
   // Initialize extension funcs
   //
   if (_extensionGlobals)
-    _extensionGlobals(_globalTemplate);
+    _extensionGlobals(isolate.globalTemplate);
 
-  // Each processor gets its own context so different processors
-  // don't affect each other (ignore the first three lines).
+  // Each isolate gets its own context so different workers
+  // don't affect each other
   v8::Handle<v8::Context> context = v8::Context::New(0, global);
 
   // Store the context in the processor object in a persistent handle,
   // since we want the reference to remain after we return from this
   // method.
-  *(static_cast<v8::Persistent<v8::Context>*>(_context)) = v8::Persistent<v8::Context>::New(context);
+  *context_ = v8::Persistent<v8::Context>::New(context);
 
   // Enter the new context so all the following operations take place
   // within it.
   v8::Context::Scope context_scope(context);
 
-  //OSS_LOG_INFO("Google V8 context for " << _script << " CREATED");
-
   //
   // We're just about to compile the script; set up an error handler to
   // catch any exceptions the script might throw.
   v8::TryCatch try_catch;
   try_catch.SetVerbose(true);
 
- 
-  try
+  for (ScriptCache::iterator iter = cache.begin(); iter != cache.end(); iter++)
   {
+    v8::Handle<v8::String> source = v8::String::New(iter->source.c_str(), iter->source.size());
+    v8::ScriptOrigin origin(v8::String::New(iter->name.c_str()));
+    
     //
-    // Compile it!
+    // The first isolate to compile the source leaves the pre-compilation
+    // data in the cache.  The rest of the pool reuses it.
     //
-    v8::Handle<v8::String> helperScript;
-    helperScript = read_global_scripts();
-
-
-
-    if (helperScript.IsEmpty())
+    v8::ScriptData* preparseData = 0;
+    if (iter->preparseData.empty())
     {
-      OSS_LOG_ERROR("Failed to compile global exports for " << _script);
-      // The script failed to compile; bail out.
-      return false;
+      preparseData = v8::ScriptData::PreCompile(source);
+      if (updateCache && preparseData && !preparseData->HasError())
+      {
+        iter->preparseData = std::string(preparseData->Data(), preparseData->Length());
+        _codeCache.store(iter->key, iter->preparseData);
+      }
+    }
+    else
+    {
+      preparseData = v8::ScriptData::New(iter->preparseData.data(), iter->preparseData.size());
     }
 
-    //OSS_LOG_INFO("Google V8 is compiling global.detail for " << _script);
-    v8::Handle<v8::Script> compiledHelper = v8::Script::Compile(helperScript);
-    if (compiledHelper.IsEmpty())
+    //
+    // Compile it!
+    //
+    v8::Handle<v8::Script> compiled = v8::Script::Compile(source, &origin, 
+      preparseData && !preparseData->HasError() ? preparseData : 0);
+    delete preparseData;
+    
+    if (compiled.IsEmpty())
     {
       reportException(try_catch, true);
       return false;
     }
 
-   // OSS_LOG_INFO("Google V8 is running global.detail for " << _script);
-     // Run the script!
-    v8::Handle<v8::Value> result = compiledHelper->Run();
+    // Run the script!
+    v8::Handle<v8::Value> result = compiled->Run();
     if (result.IsEmpty())
     {
       // The TryCatch above is still in effect and will have caught the error.
       reportException(try_catch, true);
       return false;
     }
-   // OSS_LOG_INFO("Google V8 global.detail for " << _script << " EXECUTED");
-  }
-  catch(OSS::Exception e)
-  {
-    std::ostringstream logMsg;
-    logMsg << "Filesystem error while compiling script global helpers - " << e.message();
-    OSS::log_warning(logMsg.str());
   }
 
-  //
-  // Compile the helpers
-  //
-  boost::filesystem::path helpers;
-  if (!_helperScriptsDirectory.empty())
-    helpers = boost::filesystem::path(_helperScriptsDirectory);
-  else
-    helpers = OSS::boost_path(_script) + ".detail";
-  if (boost::filesystem::exists(helpers))
-  {
-    //
-    // This script has a heper directory
-    //
-    try
-    {
-      boost::filesystem::directory_iterator end_itr; // default construction yields past-the-end
-      for (boost::filesystem::directory_iterator itr(helpers); itr != end_itr; ++itr)
-      {
-        if (boost::filesystem::is_directory(itr->status()))
-        {
-          continue;
-        }
-        else
-        {
-          std::string fileName = OSS::boost_file_name(itr->path());
-          boost::filesystem::path currentFile = itr->path();
-          
-          if (boost::filesystem::is_regular(currentFile))
-          {
-            if (OSS::string_ends_with(fileName, ".js"))
-            {
-              //
-              // Compile it!
-              //
-              //OSS_LOG_INFO("Google V8 is compiling helper script " << currentFile);
-              v8::Handle<v8::String> helperScript;
-              helperScript = read_file(OSS::boost_path(currentFile));
-              if (helperScript.IsEmpty())
-              {
-                reportException(try_catch, true);
-                return false;
-              }
-
-              v8::Handle<v8::Script> compiledHelper = v8::Script::Compile(helperScript);
-
-              if (compiledHelper.IsEmpty())
-              {
-                reportException(try_catch, true);
-                return false;
-              }
-
-               // Run the script!
-              v8::Handle<v8::Value> result = compiledHelper->Run();
-              if (result.IsEmpty())
-              {
-                // The TryCatch above is still in effect and will have caught the error.
-                reportException(try_catch, true);
-                return false;
-              }
-            }
-          }
-        }
-      }
-    }
-    catch(OSS::Exception e)
-    {
-      std::ostringstream logMsg;
-      logMsg << "Filesystem error while compiling script helpers - " << e.message();
-      OSS::log_warning(logMsg.str());
-    }
-  }
-
-  //
-  // Compile the main script script
-  //
-  //OSS_LOG_INFO("Google V8 is compiling main script " << _script);
-  v8::Handle<v8::String> script;
-  script = read_file(OSS::boost_path(_script));
-
-  v8::Handle<v8::Script> compiled_script = v8::Script::Compile(script);
-
-  if (compiled_script.IsEmpty())
-  {
-    reportException(try_catch, true);
-    return false;
-  }
-
-  //OSS_LOG_INFO("Google V8 is running main script " << _script);
-  // Run the script!
-  v8::Handle<v8::Value> result = compiled_script->Run();
-  if (result.IsEmpty())
-  {
-    // The TryCatch above is still in effect and will have caught the error.
-    reportException(try_catch, true);
-    return false;
-  }
-
-
-
   // The script compiled and ran correctly.  Now we fetch out the
   // Process function from the global object.
-  v8::Handle<v8::String> process_name = v8::String::New(functionName.c_str());
+  v8::Handle<v8::String> process_name = v8::String::New(_functionName.c_str());
   v8::Handle<v8::Value> process_val = context->Global()->Get(process_name);
 
   // If there is no Process function, or if it is not a function,
   // bail out
   if (!process_val->IsFunction())
   {
-    OSS_LOG_ERROR("Google V8 is unable to load function " << functionName);
+    OSS_LOG_ERROR("Google V8 is unable to load function " << _functionName);
     return false;
   }
 
@@ -668,16 +690,69 @@ bool JSBase::internalInitialize(
 
   // Store the function in a Persistent handle, since we also want
   // that to remain after this call returns
-  *(static_cast<v8::Persistent<v8::Function>*>(_processFunc)) = v8::Persistent<v8::Function>::New(process_fun);
+  *processFunc_ = v8::Persistent<v8::Function>::New(process_fun);
 
   // all went well.  request the template creation as the final step
   v8::Handle<v8::ObjectTemplate> objectTemplate = v8::ObjectTemplate::New();
   objectTemplate->SetInternalFieldCount(1);
-  *(static_cast<v8::Persistent<v8::ObjectTemplate>*>(_requestTemplate)) = v8::Persistent<v8::ObjectTemplate>::New(objectTemplate);
+  *requestTemplate_ = v8::Persistent<v8::ObjectTemplate>::New(objectTemplate);
 
-  _isInitialized = true;
+  isolate.generation = generation;
+  isolate.isInitialized = true;
+  return true;
+}
 
-  return  _isInitialized;
+bool JSBase::internalInitialize(
+  const boost::filesystem::path& scriptFile, const std::string& functionName,
+  void(*extensionGlobals)(OSS_HANDLE) )
+{
+  OSS::mutex_critic_sec_lock recompileLock(_recompileMutex);
+  
+  if (!boost::filesystem::exists(scriptFile))
+  {
+    OSS_LOG_ERROR("Google V8 is unable to locate file " << scriptFile);
+    return false;
+  }
+
+  _functionName = functionName;
+  _script = scriptFile;
+  _extensionGlobals = extensionGlobals;
+  
+  if (!_codeCache.isEnabled())
+    _codeCache.setDirectory(JSCodeCache::getDefaultDirectory(_script));
+  
+  ScriptCachePtr cache(new ScriptCache());
+  if (!loadScriptCache(*cache))
+    return false;
+  
+  if (_pool.empty())
+  {
+    for (std::size_t i = 0; i < _poolSize; i++)
+      _pool.push_back(IsolatePtr(new Isolate()));
+  }
+  
+  OSS::UInt64 generation = 0;
+  do
+  {
+    OSS::mutex_critic_sec_lock lock(_cacheMutex);
+    generation = _generation + 1;
+  } while (false);
+  
+  //
+  // Compile every isolate in the pool up front
+  //
+  for (IsolatePool::iterator iter = _pool.begin(); iter != _pool.end(); iter++)
+  {
+    OSS::mutex_critic_sec_lock lock((*iter)->mutex);
+    if (!compileIsolate(*(*iter), *cache, generation))
+      return false;
+  }
+  
+  OSS::mutex_critic_sec_lock lock(_cacheMutex);
+  _scriptCache = cache;
+  _generation = generation;
+  _isInitialized = true;
+  return _isInitialized;
 }
 
 bool JSBase::recompile()
@@ -687,14 +762,88 @@ bool JSBase::recompile()
 
 bool JSBase::internalRecompile()
 {
+  if (!_isInitialized || _pool.empty())
+    return internalInitialize(_script, _functionName, _extensionGlobals);
   
-  if (!internalInitialize(_script, _functionName, _extensionGlobals))
-  {
+  OSS::mutex_critic_sec_lock recompileLock(_recompileMutex);
+  
+  ScriptCachePtr cache(new ScriptCache());
+  if (!loadScriptCache(*cache))
     return false;
-  }
+  
+  OSS::UInt64 generation = 0;
+  do
+  {
+    OSS::mutex_critic_sec_lock lock(_cacheMutex);
+    generation = _generation + 1;
+  } while (false);
+  
+  //
+  // Verify the new script in a single isolate.  If this fails, the rest
+  // of the pool will continue to run the previous generation.
+  //
+  do
+  {
+    boost::unique_lock<OSS::mutex_critic_sec> lock;
+    IsolatePtr pIsolate = acquireIsolate(lock);
+    if (!compileIsolate(*pIsolate, *cache, generation))
+    {
+      //
+      // Restore the previous script in this isolate
+      //
+      ScriptCachePtr previous;
+      OSS::UInt64 previousGeneration = 0;
+      do
+      {
+        OSS::mutex_critic_sec_lock cacheLock(_cacheMutex);
+        previous = _scriptCache;
+        previousGeneration = _generation;
+      } while (false);
+      if (previous)
+        compileIsolate(*pIsolate, *previous, previousGeneration, false);
+      return false;
+    }
+  } while (false);
+  
+  //
+  // Publish the new generation.  Other isolates will roll over to it
+  // the next time they are acquired.
+  //
+  OSS::mutex_critic_sec_lock lock(_cacheMutex);
+  _scriptCache = cache;
+  _generation = generation;
   return true;
 }
 
+JSBase::IsolatePtr JSBase::acquireIsolate(boost::unique_lock<OSS::mutex_critic_sec>& lock)
+{
+  std::size_t start = 0;
+  do
+  {
+    OSS::mutex_critic_sec_lock cacheLock(_cacheMutex);
+    start = _nextIsolate++;
+  } while (false);
+  
+  std::size_t poolSize = _pool.size();
+  for (std::size_t i = 0; i < poolSize; i++)
+  {
+    IsolatePtr pIsolate = _pool[(start + i) % poolSize];
+    boost::unique_lock<OSS::mutex_critic_sec> isolateLock(pIsolate->mutex, boost::try_to_lock);
+    if (isolateLock.owns_lock())
+    {
+      lock.swap(isolateLock);
+      return pIsolate;
+    }
+  }
+  
+  //
+  // Everyone is busy.  Wait for our turn in round-robin order.
+  //
+  IsolatePtr pIsolate = _pool[start % poolSize];
+  boost::unique_lock<OSS::mutex_critic_sec> isolateLock(pIsolate->mutex);
+  lock.swap(isolateLock);
+  return pIsolate;
+}
 
 bool JSBase::processRequest(OSS_HANDLE request)
 {
@@ -706,18 +855,59 @@ bool JSBase::internalProcessRequest(OSS_HANDLE request)
   if (!_isInitialized)
     return false;
   
-  v8::Locker __v8Locker__;
+  BoundaryCrossings& crossings = boundary_crossings();
+  crossings.current = 0;
+  bool ok = runProcessFunction(request);
+  crossings.last = crossings.current;
+  
+  OSS::mutex_critic_sec_lock cacheLock(_cacheMutex);
+  _totalBoundaryCrossings += crossings.current;
+  _totalProcessedRequests++;
+  return ok;
+}
+
+bool JSBase::runProcessFunction(OSS_HANDLE request)
+{
+  boost::unique_lock<OSS::mutex_critic_sec> lock;
+  IsolatePtr pIsolate = acquireIsolate(lock);
+  Isolate& isolate = *pIsolate;
+  
+  //
+  // Roll this isolate over to the latest script if a recompile happened
+  //
+  ScriptCachePtr cache;
+  OSS::UInt64 generation = 0;
+  do
+  {
+    OSS::mutex_critic_sec_lock cacheLock(_cacheMutex);
+    cache = _scriptCache;
+    generation = _generation;
+  } while (false);
+  
+  if (cache && (!isolate.isInitialized || isolate.generation != generation))
+  {
+    if (!compileIsolate(isolate, *cache, generation, false))
+      return false;
+  }
+  
+  if (!isolate.isInitialized)
+    return false;
+  
+  v8::Isolate* pV8Isolate = static_cast<v8::Isolate*>(isolate.isolate);
+  v8::Locker __v8Locker__(pV8Isolate);
+  v8::Isolate::Scope isolate_scope(pV8Isolate);
   
   v8::HandleScope handle_scope;
 
+  v8::Persistent<v8::Context>& context = *(static_cast<v8::Persistent<v8::Context>*>(isolate.context));
   
   // Enter this processor's context so all the remaining operations
   // take place there
-  v8::Context::Scope context_scope(*(static_cast<v8::Persistent<v8::Context>*>(_context)));
+  v8::Context::Scope context_scope(context);
 
   // Fetch the template for creating JavaScript request wrappers.
   // It only has to be created once, which we do on demand.
-  v8::Handle<v8::ObjectTemplate> templ = *(static_cast<v8::Persistent<v8::ObjectTemplate>*>(_requestTemplate));
+  v8::Handle<v8::ObjectTemplate> templ = *(static_cast<v8::Persistent<v8::ObjectTemplate>*>(isolate.requestTemplate));
 
     // Set up an exception handler before calling the Process function
   v8::TryCatch try_catch;
@@ -743,7 +933,7 @@ bool JSBase::internalProcessRequest(OSS_HANDLE request)
   // and one argument, the request.
   const int argc = 1;
   v8::Handle<v8::Value> argv[argc] = { request_obj };
-  v8::Handle<v8::Value> result = (*(static_cast<v8::Persistent<v8::Function>*>(_processFunc)))->Call((*(static_cast<v8::Persistent<v8::Context>*>(_context)))->Global(), argc, argv);
+  v8::Handle<v8::Value> result = (*(static_cast<v8::Persistent<v8::Function>*>(isolate.processFunc)))->Call(context->Global(), argc, argv);
   if (result.IsEmpty())
   {
     reportException(try_catch, true);
@@ -755,48 +945,51 @@ bool JSBase::internalProcessRequest(OSS_HANDLE request)
 
 bool JSBase::callFunction(const std::string& funcName)
 {
-  if (!_isInitialized || !_context)
+  if (!_isInitialized)
     return false;
   
-  v8::Locker __v8Locker__;
-  
-  v8::HandleScope handle_scope;
+  for (IsolatePool::iterator iter = _pool.begin(); iter != _pool.end(); iter++)
+  {
+    Isolate& isolate = *(*iter);
+    OSS::mutex_critic_sec_lock lock(isolate.mutex);
+    if (!isolate.isInitialized)
+      continue;
+    
+    v8::Isolate* pV8Isolate = static_cast<v8::Isolate*>(isolate.isolate);
+    v8::Locker __v8Locker__(pV8Isolate);
+    v8::Isolate::Scope isolate_scope(pV8Isolate);
+    
+    v8::HandleScope handle_scope;
+
+    v8::Persistent<v8::Context>& context = *(static_cast<v8::Persistent<v8::Context>*>(isolate.context));
+    // Enter this processor's context so all the remaining operations
+    // take place there
+    v8::Context::Scope context_scope(context);
+
+    // The script compiled and ran correctly.  Now we fetch out the
+    // Process function from the global object.
+    v8::Handle<v8::String> func_name = v8::String::New(funcName.c_str());
+    v8::Handle<v8::Value> func_val = context->Global()->Get(func_name);
+
+    // If there is no Process function, or if it is not a function,
+    // bail out
+    if (!func_val->IsFunction())
+    {
+      OSS_LOG_ERROR("JSBase::callFunction - Google V8 is unable to load function " << funcName);
+      return false;
+    }
 
-  v8::Persistent<v8::Context>& context = *(static_cast<v8::Persistent<v8::Context>*>(_context));
-  // Enter this processor's context so all the remaining operations
-  // take place there
-  v8::Context::Scope context_scope(context);
-   
-  // The script compiled and ran correctly.  Now we fetch out the
-  // Process function from the global object.
-  v8::Handle<v8::String> func_name = v8::String::New(funcName.c_str());
-  v8::Handle<v8::Value> func_val = context->Global()->Get(func_name);
+    // It is a function; cast it to a Function
+    v8::Handle<v8::Function> process_fun = v8::Handle<v8::Function>::Cast(func_val);
 
-  // If there is no Process function, or if it is not a function,
-  // bail out
-  if (!func_val->IsFunction())
-  {
-    OSS_LOG_ERROR("JSBase::callFunction - Google V8 is unable to load function " << funcName);
-    return false;
+    // call it without any arguments
+    process_fun->Call(context->Global(), 0, 0);
   }
-
-  // It is a function; cast it to a Function
-  v8::Handle<v8::Function> process_fun = v8::Handle<v8::Function>::Cast(func_val);
-  
-  // call it without any arguments
-  
-  process_fun->Call(context->Global(), 0, 0);
   
   return true;
-
 }
 
 
 
 
 } } // OSS::JS
-
-
-
-
-
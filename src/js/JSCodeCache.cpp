@@ -0,0 +1,161 @@
+// Library: OSS_CORE - Foundation API for SIP B2BUA
+// Copyright (c) OSS Software Solutions
+// Contributor: Joegen Baclor - mailto:joegen@ossapp.com
+//
+// Permission is hereby granted, to any person or organization
+// obtaining a copy of the software and accompanying documentation covered by
+// this license (the "Software") to use, execute, and to prepare
+// derivative works of the Software, all subject to the
+// "GNU Lesser General Public License (LGPL)".
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+// SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+// FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+
+
+#include <fstream>
+#include <streambuf>
+
+#include "OSS/JS/JSCodeCache.h"
+#include "OSS/UTL/CoreUtils.h"
+#include "OSS/UTL/Logger.h"
+
+
+namespace OSS {
+namespace JS {
+
+
+static const char* CODE_CACHE_EXTENSION = ".jsc";
+
+
+JSCodeCache::JSCodeCache() :
+  _isEnabled(false)
+{
+}
+
+JSCodeCache::~JSCodeCache()
+{
+}
+
+bool JSCodeCache::setDirectory(const boost::filesystem::path& directory)
+{
+  OSS::mutex_critic_sec_lock lock(_mutex);
+  _isEnabled = false;
+  _directory = directory;
+  try
+  {
+    if (!boost::filesystem::exists(_directory) && !boost::filesystem::create_directories(_directory))
+    {
+      OSS_LOG_WARNING("JSCodeCache::setDirectory - Unable to create " << OSS::boost_path(_directory));
+      return false;
+    }
+  }
+  catch(const std::exception& e)
+  {
+    OSS_LOG_WARNING("JSCodeCache::setDirectory - " << e.what());
+    return false;
+  }
+  _isEnabled = true;
+  return true;
+}
+
+bool JSCodeCache::load(const std::string& key, std::string& data) const
+{
+  boost::filesystem::path file;
+  do
+  {
+    OSS::mutex_critic_sec_lock lock(_mutex);
+    if (!_isEnabled)
+      return false;
+    file = OSS::boost_path_concatenate(_directory, key + CODE_CACHE_EXTENSION);
+  } while (false);
+  
+  std::ifstream cached(OSS::boost_path(file).c_str(), std::ios::in | std::ios::binary);
+  if (!cached.is_open())
+    return false;
+  
+  data.assign((std::istreambuf_iterator<char>(cached)), std::istreambuf_iterator<char>());
+  return !data.empty();
+}
+
+bool JSCodeCache::store(const std::string& key, const std::string& data)
+{
+  boost::filesystem::path file;
+  boost::filesystem::path tempFile;
+  do
+  {
+    OSS::mutex_critic_sec_lock lock(_mutex);
+    if (!_isEnabled || data.empty())
+      return false;
+    file = OSS::boost_path_concatenate(_directory, key + CODE_CACHE_EXTENSION);
+    tempFile = OSS::boost_path_concatenate(_directory, key + "." + OSS::string_create_uuid() + ".tmp");
+  } while (false);
+  
+  try
+  {
+    do
+    {
+      std::ofstream cached(OSS::boost_path(tempFile).c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+      if (!cached.is_open())
+        return false;
+      cached.write(data.data(), data.size());
+      if (!cached.good())
+      {
+        cached.close();
+        boost::filesystem::remove(tempFile);
+        return false;
+      }
+    } while (false);
+    boost::filesystem::rename(tempFile, file);
+  }
+  catch(const std::exception& e)
+  {
+    OSS_LOG_WARNING("JSCodeCache::store - " << e.what());
+    return false;
+  }
+  return true;
+}
+
+void JSCodeCache::clear()
+{
+  OSS::mutex_critic_sec_lock lock(_mutex);
+  if (!_isEnabled)
+    return;
+  try
+  {
+    boost::filesystem::directory_iterator end_itr;
+    for (boost::filesystem::directory_iterator itr(_directory); itr != end_itr; ++itr)
+    {
+      if (OSS::string_ends_with(OSS::boost_file_name(itr->path()), CODE_CACHE_EXTENSION))
+        boost::filesystem::remove(itr->path());
+    }
+  }
+  catch(const std::exception& e)
+  {
+    OSS_LOG_WARNING("JSCodeCache::clear - " << e.what());
+  }
+}
+
+std::string JSCodeCache::createKey(const std::string& engine, const std::string& name, const std::string& source)
+{
+  std::string nameHash = OSS::string_md5_hash(name.c_str());
+  std::string sourceHash = OSS::string_md5_hash(source.c_str());
+  return engine + "-" + nameHash + "-" + sourceHash;
+}
+
+boost::filesystem::path JSCodeCache::getDefaultDirectory(const boost::filesystem::path& scriptFile)
+{
+  boost::filesystem::path parent = scriptFile.parent_path();
+  if (parent.empty())
+    parent = boost::filesystem::current_path();
+  return boost::filesystem::path(OSS::boost_path(parent) + ".jscache");
+}
+
+
+} } // OSS::JS
+
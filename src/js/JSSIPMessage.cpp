@@ -57,6 +57,7 @@ static OSS::SIP::SIPMessage* unwrapRequest(const jsargs& args)
     return 0;
   jsfield field = jsfield::Cast(obj->ToObject()->GetInternalField(0));
   void* ptr = field->Value();
+  JSBase::countBoundaryCrossing();
   return static_cast<OSS::SIP::SIPMessage*>(ptr);
 }
 
@@ -677,6 +678,89 @@ static jsval msgCommitData(const jsargs& args)
   return jsstring::New(pMsg->data().c_str());
 }
 
+static jsval msgHdrSnapshot(const jsargs& args)
+{
+  if (args.Length() < 1)
+    return jsvoid();
+  jsscope scope;
+  OSS::SIP::SIPMessage* pMsg = unwrapRequest(args);
+  if (!pMsg)
+    return jsvoid();
+
+  OSS::SIP::SIPHeaderList headers;
+  std::string startLine;
+  pMsg->hdrGetAll(headers, startLine);
+
+  v8::Handle<v8::Object> headerObject = v8::Object::New();
+  for (OSS::SIP::SIPHeaderList::const_iterator iter = headers.begin(); iter != headers.end(); iter++)
+  {
+    v8::Handle<v8::Array> list = v8::Array::New(iter->second.size());
+    for (std::size_t i = 0; i < iter->second.size(); i++)
+      list->Set(i, jsstring::New(iter->second[i].c_str(), iter->second[i].size()));
+    headerObject->Set(jsstring::New(iter->first.c_str(), iter->first.size()), list);
+  }
+
+  v8::Handle<v8::Object> snapshot = v8::Object::New();
+  snapshot->Set(jsstring::New("startLine"), jsstring::New(startLine.c_str(), startLine.size()));
+  snapshot->Set(jsstring::New("headers"), headerObject);
+  return scope.Close(snapshot);
+}
+
+static jsval msgHdrCommit(const jsargs& args/*object headers, string startLine*/)
+{
+  if (args.Length() < 2 || !args[1]->IsObject())
+    return jsbool::New(false);
+  jsscope scope;
+  OSS::SIP::SIPMessage* pMsg = unwrapRequest(args);
+  if (!pMsg)
+    return jsbool::New(false);
+
+  OSS::SIP::SIPHeaderList headers;
+  v8::Handle<v8::Object> headerObject = args[1]->ToObject();
+  v8::Handle<v8::Array> names = headerObject->GetPropertyNames();
+  for (uint32_t i = 0; i < names->Length(); i++)
+  {
+    v8::Handle<v8::Value> name = names->Get(i);
+    std::string headerName = jsvalToString(name);
+    if (headerName.empty())
+      continue;
+    OSS::SIP::SIPHeaderTokens& tokens = headers[headerName];
+    v8::Handle<v8::Value> value = headerObject->Get(name);
+    if (value->IsArray())
+    {
+      v8::Handle<v8::Array> list = v8::Handle<v8::Array>::Cast(value);
+      for (uint32_t j = 0; j < list->Length(); j++)
+      {
+        std::string element = jsvalToString(list->Get(j));
+        if (!element.empty())
+          tokens.push_back(element);
+      }
+    }
+    else
+    {
+      std::string element = jsvalToString(value);
+      if (!element.empty())
+        tokens.push_back(element);
+    }
+  }
+
+  std::string startLine;
+  if (args.Length() > 2)
+    startLine = jsvalToString(args[2]);
+
+  try
+  {
+    return jsbool::New(pMsg->hdrCommit(headers, startLine));
+  }
+  catch(OSS::Exception e)
+  {
+    std::ostringstream msg;
+    msg << "JavaScript->C++ Exception: msgHdrCommit - " << e.message();
+    OSS::log_error(msg.str());
+    return jsbool::New(false);
+  }
+}
+
 //
 // Request-Line Processing
 //
@@ -1693,6 +1777,8 @@ void JSSIPMessage::initGlobalFuncs(OSS_HANDLE objectTemplate)
   global->Set(jsstring::New("msgSetStartLine"), jsfunc::New(msgSetStartLine));
   global->Set(jsstring::New("msgGetData"), jsfunc::New(msgGetData));
   global->Set(jsstring::New("msgCommitData"), jsfunc::New(msgCommitData));
+  global->Set(jsstring::New("msgHdrSnapshot"), jsfunc::New(msgHdrSnapshot));
+  global->Set(jsstring::New("msgHdrCommit"), jsfunc::New(msgHdrCommit));
   global->Set(jsstring::New("msgGetRequestUri"), jsfunc::New(msgGetRequestUri));
   global->Set(jsstring::New("msgSetRequestUri"), jsfunc::New(msgSetRequestUri));
   global->Set(jsstring::New("msgGetRequestUriUser"), jsfunc::New(msgGetRequestUriUser));
@@ -261,6 +261,66 @@ int DuktapeContext::loadModule(const std::string& moduleId)
   return -1;
 }
 
+JSCodeCache& DuktapeContext::codeCache()
+{
+  static JSCodeCache cache;
+  return cache;
+}
+
+bool DuktapeContext::setCodeCacheDirectory(const std::string& path)
+{
+  return DuktapeContext::codeCache().setDirectory(boost::filesystem::path(path.c_str()));
+}
+
+bool DuktapeContext::pushCompiledCode(const std::string& file, const std::string& code)
+{
+  std::string source;
+  if (code.size() > 1 && code.at(0) == '#' && code.at(1) == '!')
+  {
+    //
+    // We got a shebang.  Comment it out.
+    //
+    source = std::string("//") + code;
+  }
+  else
+  {
+    source = code;
+  }
+  
+  JSCodeCache& cache = DuktapeContext::codeCache();
+  if (!cache.isEnabled())
+  {
+    return !!duk_push_lstring(_pContext, source.c_str(), source.length());
+  }
+  
+  std::string bytecode;
+  std::string key = JSCodeCache::createKey("duk-" + OSS::string_from_number<long>(DUK_VERSION), file, source);
+  if (!cache.load(key, bytecode))
+  {
+    //
+    // Compile and dump the bytecode.  If compilation fails, we push the
+    // source instead so errors get reported by the normal evaluation path.
+    //
+    duk_push_lstring(_pContext, source.c_str(), source.length());
+    duk_push_string(_pContext, file.c_str());
+    if (duk_safe_call(_pContext, duk_module_node_compile_source, 2, 1) != DUK_EXEC_SUCCESS)
+    {
+      OSS_LOG_WARNING("DuktapeContext::pushCompiledCode - Unable to compile " << file << " - " << duk_safe_to_string(_pContext, -1));
+      duk_pop(_pContext);
+      return !!duk_push_lstring(_pContext, source.c_str(), source.length());
+    }
+    duk_size_t size = 0;
+    const char* data = static_cast<const char*>(duk_get_buffer(_pContext, -1, &size));
+    bytecode = std::string(data, size);
+    cache.store(key, bytecode);
+    return true;
+  }
+  
+  void* buf = duk_push_fixed_buffer(_pContext, bytecode.size());
+  memcpy(buf, bytecode.data(), bytecode.size());
+  return true;
+}
+
 bool DuktapeContext::evalFile(const std::string& file, FILE* foutput, FILE* ferror)
 {
   if (!boost::filesystem::exists(file.c_str()))
@@ -276,7 +336,7 @@ bool DuktapeContext::evalFile(const std::string& file, FILE* foutput, FILE* ferr
   js.seekg(0, std::ios::beg);
   body.assign((std::istreambuf_iterator<char>(js)), std::istreambuf_iterator<char>());
   
-  duk_push_lstring(_pContext, body.c_str(), body.length());
+  pushCompiledCode(file, body);
   int r = duk_module_node_peval_file(_pContext, file.c_str(), 1); 
   duktape_dump_result(_pContext, r, foutput, ferror);
   return true;
@@ -98,12 +98,13 @@ bool DuktapeModule::loadJS(const std::string& path)
   js.seekg(0, std::ios::beg);
   body.assign((std::istreambuf_iterator<char>(js)), std::istreambuf_iterator<char>());
   
-  if (body.empty())
+  if (body.empty() || _library)
   {
     return false;
   }
   
-  return loadCode(body);
+  _isLoaded = _pContext->pushCompiledCode(path, body);
+  return _isLoaded;
 }
 
 
@@ -119,7 +119,7 @@ static duk_ret_t duk__handle_require(duk_context *ctx) {
 		duk_throw(ctx);  /* rethrow */
 	}
 
-	if (duk_is_string(ctx, -1)) {
+	if (duk_is_string(ctx, -1) || duk_is_buffer(ctx, -1)) {
 		duk_int_t ret;
 
 		/* [ ... module source ] */
@@ -219,21 +219,34 @@ static duk_int_t duk__eval_module_source(duk_context *ctx) {
 	(void) udata;
 #endif
 
-	/* Wrap the module code in a function expression.  This is the simplest
-	 * way to implement CommonJS closure semantics and matches the behavior of
-	 * e.g. Node.js.
-	 */
-	duk_push_string(ctx, "(function(exports,require,module,__filename,__dirname){");
-	duk_dup(ctx, -2);  /* source */
-	duk_push_string(ctx, "})");
-	duk_concat(ctx, 3);
-
-	/* [ ... module source func_src ] */
+	if (duk_is_buffer(ctx, -1)) {
+		/* The source is bytecode produced by duk_module_node_compile_source().
+		 * Load it directly and skip the compiler.
+		 */
+		(void) duk_get_prop_string(ctx, -2, "filename");
+		filename = duk_get_string(ctx, -1);
+		strcpy(tmp, filename);
+		duk_pop(ctx);
 
-	(void) duk_get_prop_string(ctx, -3, "filename");
-	filename = duk_get_string(ctx, -1);
-	strcpy(tmp, filename);
-	duk_compile(ctx, DUK_COMPILE_EVAL);
+		duk_dup(ctx, -1);  /* bytecode */
+		duk_load_function(ctx);
+	} else {
+		/* Wrap the module code in a function expression.  This is the simplest
+		 * way to implement CommonJS closure semantics and matches the behavior of
+		 * e.g. Node.js.
+		 */
+		duk_push_string(ctx, "(function(exports,require,module,__filename,__dirname){");
+		duk_dup(ctx, -2);  /* source */
+		duk_push_string(ctx, "})");
+		duk_concat(ctx, 3);
+
+		/* [ ... module source func_src ] */
+
+		(void) duk_get_prop_string(ctx, -3, "filename");
+		filename = duk_get_string(ctx, -1);
+		strcpy(tmp, filename);
+		duk_compile(ctx, DUK_COMPILE_EVAL);
+	}
 	duk_call(ctx, 0);
 
 	/* [ ... module source func ] */
@@ -284,6 +297,39 @@ duk_ret_t duk_module_node_peval_file(duk_context *ctx, const char* filename, int
 #endif
 }
 
+#if DUK_VERSION >= 19999
+duk_ret_t duk_module_node_compile_source(duk_context *ctx, void *udata) {
+#else
+duk_ret_t duk_module_node_compile_source(duk_context *ctx) {
+#endif
+	/*
+	 *  Stack: [ ... source filename ] => [ ... bytecode ]
+	 */
+
+#if DUK_VERSION >= 19999
+	(void) udata;
+#endif
+
+	duk_push_string(ctx, "(function(exports,require,module,__filename,__dirname){");
+	duk_dup(ctx, -3);  /* source */
+	duk_push_string(ctx, "})");
+	duk_concat(ctx, 3);
+
+	/* [ ... source filename func_src ] */
+
+	duk_swap_top(ctx, -2);
+
+	/* [ ... source func_src filename ] */
+
+	duk_compile(ctx, DUK_COMPILE_EVAL);
+	duk_dump_function(ctx);
+
+	/* [ ... source bytecode ] */
+
+	duk_remove(ctx, -2);
+	return 1;
+}
+
 void duk_module_node_init(duk_context *ctx) {
 	/*
 	 *  Stack: [ ... options ] => [ ... ]
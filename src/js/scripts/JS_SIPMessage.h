@@ -1014,3 +1014,123 @@
 "{\n"
 "    return msgResetMaxForwards(this._request, maxForwards);\n"
 "}\n"
+"\n"
+"SIPMessage.prototype.getHeaders = function()\n"
+"  //\n"
+"  // This function returns a snapshot of the start-line and every header of\n"
+"  // the SIPMessage.  The snapshot is fetched from the engine in a single call\n"
+"  // the first time it is needed and is reused afterwards.  Use this instead of\n"
+"  // repeated hdrGet() calls when a script inspects many headers.\n"
+"  //\n"
+"  // Parameters: void\n"
+"  //\n"
+"  // Return Type: Object\n"
+"  //  startLine: (String) The start-line\n"
+"  //  headers: (Object) Arrays of header values keyed by lower case header name\n"
+"  //\n"
+"  // Usage:\n"
+"  //  var msg = new SIPMessage(request);\n"
+"  //  var vias = msg.getHeaders().headers[\"via\"];\n"
+"  //\n"
+"{\n"
+"  if (typeof this._snapshot == \"undefined\")\n"
+"  {\n"
+"    this._snapshot = msgHdrSnapshot(this._request);\n"
+"    this._dirty = {};\n"
+"    this._dirtyStartLine = false;\n"
+"  }\n"
+"  return this._snapshot;\n"
+"}\n"
+"\n"
+"SIPMessage.prototype.hdrGetCached = function(headerName, index)\n"
+"  //\n"
+"  // This function returns a header value from the header snapshot.\n"
+"  // See getHeaders().\n"
+"  //\n"
+"  // Parameters:\n"
+"  //  headerName: (String) The name of the header to retrieve.\n"
+"  //  index: (Integer) Optional index for list headers.  Defaults to 0.\n"
+"  //\n"
+"  // Return Type: String\n"
+"  //\n"
+"  // Usage:\n"
+"  //  var msg = new SIPMessage(request);\n"
+"  //  var from = msg.hdrGetCached(\"from\");\n"
+"  //\n"
+"{\n"
+"  var list = this.getHeaders().headers[headerName.toLowerCase()];\n"
+"  if (typeof index == \"undefined\")\n"
+"    index = 0;\n"
+"  if (typeof list == \"undefined\" || index >= list.length)\n"
+"    return \"\";\n"
+"  return list[index];\n"
+"}\n"
+"\n"
+"SIPMessage.prototype.hdrSetBatched = function(headerName, hdrValue)\n"
+"  //\n"
+"  // This function sets a header in the header snapshot.  Changes are\n"
+"  // only applied to the SIPMessage when commit() is called.  Passing\n"
+"  // an array as hdrValue replaces the entire header list.  Passing an\n"
+"  // empty string or an empty array removes the header.\n"
+"  //\n"
+"  // Parameters:\n"
+"  //  headerName: (String) The name of the header to set.\n"
+"  //  hdrValue: (String|Array) The new value of the header.\n"
+"  //\n"
+"  // Return Type: void\n"
+"  //\n"
+"  // Usage:\n"
+"  //  var msg = new SIPMessage(request);\n"
+"  //  msg.hdrSetBatched(\"x-route-id\", \"1234\");\n"
+"  //  msg.hdrSetBatched(\"route\", [\"<sip:10.0.0.1;lr>\", \"<sip:10.0.0.2;lr>\"]);\n"
+"  //  msg.commit();\n"
+"  //\n"
+"{\n"
+"  var key = headerName.toLowerCase();\n"
+"  var list = (hdrValue instanceof Array) ? hdrValue : (hdrValue == \"\" ? [] : [hdrValue]);\n"
+"  var headers = this.getHeaders().headers;\n"
+"  if (list.length == 0)\n"
+"    delete headers[key];\n"
+"  else\n"
+"    headers[key] = list;\n"
+"  this._dirty[key] = list;\n"
+"}\n"
+"\n"
+"SIPMessage.prototype.setStartLineBatched = function(sline)\n"
+"  //\n"
+"  // This function sets the start-line in the header snapshot.  The change is\n"
+"  // only applied to the SIPMessage when commit() is called.\n"
+"  //\n"
+"  // Parameters:\n"
+"  //  sline: (String) The new startline value\n"
+"  //\n"
+"  // Return Type: void\n"
+"  //\n"
+"{\n"
+"  this.getHeaders().startLine = sline;\n"
+"  this._dirtyStartLine = true;\n"
+"}\n"
+"\n"
+"SIPMessage.prototype.commit = function()\n"
+"  //\n"
+"  // This function applies every change made through hdrSetBatched() and\n"
+"  // setStartLineBatched() to the SIPMessage in a single call.\n"
+"  //\n"
+"  // Parameters: void\n"
+"  //\n"
+"  // Return Type: Bool\n"
+"  //\n"
+"  // Usage:\n"
+"  //  var msg = new SIPMessage(request);\n"
+"  //  msg.hdrSetBatched(\"x-route-id\", \"1234\");\n"
+"  //  msg.commit();\n"
+"  //\n"
+"{\n"
+"  if (typeof this._snapshot == \"undefined\")\n"
+"    return true;\n"
+"  var startLine = this._dirtyStartLine ? this._snapshot.startLine : \"\";\n"
+"  var ok = msgHdrCommit(this._request, this._dirty, startLine);\n"
+"  this._dirty = {};\n"
+"  this._dirtyStartLine = false;\n"
+"  return ok;\n"
+"}\n"
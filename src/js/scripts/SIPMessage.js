@@ -1014,3 +1014,123 @@ SIPMessage.prototype.resetMaxForwards = function(maxForwards)
 {
     return msgResetMaxForwards(this._request, maxForwards);
 }
+
+SIPMessage.prototype.getHeaders = function()
+  //
+  // This function returns a snapshot of the start-line and every header of
+  // the SIPMessage.  The snapshot is fetched from the engine in a single call
+  // the first time it is needed and is reused afterwards.  Use this instead of
+  // repeated hdrGet() calls when a script inspects many headers.
+  //
+  // Parameters: void
+  //
+  // Return Type: Object
+  //  startLine: (String) The start-line
+  //  headers: (Object) Arrays of header values keyed by lower case header name
+  //
+  // Usage:
+  //  var msg = new SIPMessage(request);
+  //  var vias = msg.getHeaders().headers["via"];
+  //
+{
+  if (typeof this._snapshot == "undefined")
+  {
+    this._snapshot = msgHdrSnapshot(this._request);
+    this._dirty = {};
+    this._dirtyStartLine = false;
+  }
+  return this._snapshot;
+}
+
+SIPMessage.prototype.hdrGetCached = function(headerName, index)
+  //
+  // This function returns a header value from the header snapshot.
+  // See getHeaders().
+  //
+  // Parameters:
+  //  headerName: (String) The name of the header to retrieve.
+  //  index: (Integer) Optional index for list headers.  Defaults to 0.
+  //
+  // Return Type: String
+  //
+  // Usage:
+  //  var msg = new SIPMessage(request);
+  //  var from = msg.hdrGetCached("from");
+  //
+{
+  var list = this.getHeaders().headers[headerName.toLowerCase()];
+  if (typeof index == "undefined")
+    index = 0;
+  if (typeof list == "undefined" || index >= list.length)
+    return "";
+  return list[index];
+}
+
+SIPMessage.prototype.hdrSetBatched = function(headerName, hdrValue)
+  //
+  // This function sets a header in the header snapshot.  Changes are
+  // only applied to the SIPMessage when commit() is called.  Passing
+  // an array as hdrValue replaces the entire header list.  Passing an
+  // empty string or an empty array removes the header.
+  //
+  // Parameters:
+  //  headerName: (String) The name of the header to set.
+  //  hdrValue: (String|Array) The new value of the header.
+  //
+  // Return Type: void
+  //
+  // Usage:
+  //  var msg = new SIPMessage(request);
+  //  msg.hdrSetBatched("x-route-id", "1234");
+  //  msg.hdrSetBatched("route", ["<sip:10.0.0.1;lr>", "<sip:10.0.0.2;lr>"]);
+  //  msg.commit();
+  //
+{
+  var key = headerName.toLowerCase();
+  var list = (hdrValue instanceof Array) ? hdrValue : (hdrValue == "" ? [] : [hdrValue]);
+  var headers = this.getHeaders().headers;
+  if (list.length == 0)
+    delete headers[key];
+  else
+    headers[key] = list;
+  this._dirty[key] = list;
+}
+
+SIPMessage.prototype.setStartLineBatched = function(sline)
+  //
+  // This function sets the start-line in the header snapshot.  The change is
+  // only applied to the SIPMessage when commit() is called.
+  //
+  // Parameters:
+  //  sline: (String) The new startline value
+  //
+  // Return Type: void
+  //
+{
+  this.getHeaders().startLine = sline;
+  this._dirtyStartLine = true;
+}
+
+SIPMessage.prototype.commit = function()
+  //
+  // This function applies every change made through hdrSetBatched() and
+  // setStartLineBatched() to the SIPMessage in a single call.
+  //
+  // Parameters: void
+  //
+  // Return Type: Bool
+  //
+  // Usage:
+  //  var msg = new SIPMessage(request);
+  //  msg.hdrSetBatched("x-route-id", "1234");
+  //  msg.commit();
+  //
+{
+  if (typeof this._snapshot == "undefined")
+    return true;
+  var startLine = this._dirtyStartLine ? this._snapshot.startLine : "";
+  var ok = msgHdrCommit(this._request, this._dirty, startLine);
+  this._dirty = {};
+  this._dirtyStartLine = false;
+  return ok;
+}
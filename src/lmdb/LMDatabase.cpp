@@ -25,6 +25,7 @@
 #include "OSS/UTL/Logger.h"
 #include "OSS/UTL/Exception.h"
 #include "OSS/UTL/CoreUtils.h"
+#include <boost/functional/hash.hpp>
 
 
 namespace OSS {
@@ -33,8 +34,9 @@ namespace LMDB {
 
 typedef LMDatabase::TransactionLock transaction_lock;  
  
-LMDatabase::Transaction::Transaction(LMDatabase* db) :
+LMDatabase::Transaction::Transaction(LMDatabase* db, TransactionMode mode) :
   _db(db),
+  _mode(mode),
   _transaction(0),
   _cancelAdvised(false),
   _lastError(0)
@@ -48,6 +50,18 @@ LMDatabase::Transaction::~Transaction()
 
 bool LMDatabase::Transaction::begin()
 {
+  if (_mode == READ_ONLY)
+  {
+    //
+    // Readers never touch the database mutex.  LMDB gives each of them a
+    // consistent snapshot and they run in parallel with each other and
+    // with the single writer.
+    //
+    assert(!_transaction);
+    _transaction = _db->acquireReader();
+    return _transaction != 0;
+  }
+  
   _db->_mutex.lock();
   if (_db->_stopped)
   {
@@ -55,12 +69,26 @@ bool LMDatabase::Transaction::begin()
     return false;
   }
   assert(!_transaction);
-  return mdb_txn_begin((MDB_env*)_db->_env, 0, 0, (MDB_txn**)&_transaction) == 0;
+  if (mdb_txn_begin((MDB_env*)_db->_env, 0, 0, (MDB_txn**)&_transaction) != 0)
+  {
+    _transaction = 0;
+    _db->_mutex.unlock();
+    return false;
+  }
+  return true;
 }
 
 bool LMDatabase::Transaction::end()
 {
   assert(_transaction);
+  if (_mode == READ_ONLY)
+  {
+    _db->releaseReader(_transaction);
+    _transaction = 0;
+    _cancelAdvised = false;
+    return true;
+  }
+  
   int ret = 0;
   ret = mdb_txn_commit((MDB_txn*)_transaction);
   _transaction = 0;
@@ -75,6 +103,14 @@ bool LMDatabase::Transaction::end()
 void LMDatabase::Transaction::cancel()
 {
   assert(_transaction);
+  if (_mode == READ_ONLY)
+  {
+    _db->releaseReader(_transaction);
+    _transaction = 0;
+    _cancelAdvised = false;
+    return;
+  }
+  
   mdb_txn_abort((MDB_txn*)_transaction);
   _transaction = 0;
   _cancelAdvised = false;
@@ -128,32 +164,34 @@ void LMDatabase::Cursor::destroy()
 {
   mdb_cursor_close((MDB_cursor*)_cursor);
   _cursor = 0;
+  _key = View();
+  _value = View();
 }
 
-static bool lmdb_cursor_get(MDB_cursor* cursor, MDB_cursor_op op, std::string& key, std::string& value)
+bool LMDatabase::Cursor::move(int op)
 {
-  MDB_val k, v;
+  if (!_cursor)
+  {
+    return false;
+  }
   
-  if (mdb_cursor_get(cursor, &k, &v, op) == 0 && 
+  MDB_val k, v;
+  if (mdb_cursor_get((MDB_cursor*)_cursor, &k, &v, (MDB_cursor_op)op) == 0 && 
     k.mv_data && k.mv_size && v.mv_data && v.mv_size)
   {
-    key = std::string((char*)k.mv_data, k.mv_size);
-    value = std::string((char*)v.mv_data, v.mv_size);
+    _key = View((const char*)k.mv_data, k.mv_size);
+    _value = View((const char*)v.mv_data, v.mv_size);
     return true;
   }
   
-  key = std::string();
-  value = std::string();
+  _key = View();
+  _value = View();
   return false;
 }
 
 bool LMDatabase::Cursor::top()
 {
-  if (!_cursor)
-  {
-    return false;
-  }
-  return lmdb_cursor_get((MDB_cursor*)_cursor, MDB_FIRST, _key, _value);
+  return move(MDB_FIRST);
 }
 
 bool LMDatabase::Cursor::find(const std::string& key)
@@ -167,65 +205,67 @@ bool LMDatabase::Cursor::find(const std::string& key)
   k.mv_data = (void*)key.data();
   k.mv_size = key.size();
   
-  if (mdb_cursor_get((MDB_cursor*)_cursor, &k, &v, MDB_SET) == 0 && 
+  if (mdb_cursor_get((MDB_cursor*)_cursor, &k, &v, MDB_SET_KEY) == 0 && 
     k.mv_data && k.mv_size && v.mv_data && v.mv_size)
   {
-    _key = std::string((char*)k.mv_data, k.mv_size);
-    _value = std::string((char*)v.mv_data, v.mv_size);
+    _key = View((const char*)k.mv_data, k.mv_size);
+    _value = View((const char*)v.mv_data, v.mv_size);
     return true;
   }
   
-  _key = std::string();
-  _value = std::string();
+  _key = View();
+  _value = View();
   return false;
 }
 
-bool LMDatabase::Cursor::next()
+bool LMDatabase::Cursor::seek(const std::string& key)
 {
   if (!_cursor)
   {
     return false;
   }
-  return lmdb_cursor_get((MDB_cursor*)_cursor, MDB_NEXT, _key, _value);
-}
-
-bool LMDatabase::Cursor::bottom()
-{
-  if (!_cursor)
+  
+  MDB_val k, v;
+  k.mv_data = (void*)key.data();
+  k.mv_size = key.size();
+  
+  if (mdb_cursor_get((MDB_cursor*)_cursor, &k, &v, MDB_SET_RANGE) == 0 && 
+    k.mv_data && k.mv_size && v.mv_data && v.mv_size)
   {
-    return false;
+    _key = View((const char*)k.mv_data, k.mv_size);
+    _value = View((const char*)v.mv_data, v.mv_size);
+    return true;
   }
-  return lmdb_cursor_get((MDB_cursor*)_cursor, MDB_LAST, _key, _value);
+  
+  _key = View();
+  _value = View();
+  return false;
 }
 
-std::string LMDatabase::Cursor::value() const
+bool LMDatabase::Cursor::next()
 {
-  if (!_cursor)
-  {
-    return std::string();
-  }
-  return _value;
+  return move(MDB_NEXT);
 }
 
-std::string LMDatabase::Cursor::key() const
+bool LMDatabase::Cursor::prev()
 {
-  if (!_cursor)
-  {
-    return std::string();
-  }
-  return _key;
+  return move(MDB_PREV);
 }
 
-
-    
-
-    
+bool LMDatabase::Cursor::bottom()
+{
+  return move(MDB_LAST);
+}
   
   
 LMDatabase::LMDatabase() :
   _env(0),
   _db(0),
-  _stopped(false)
+  _stopped(false),
+  _activeReaders(0),
+  _batchLeader(false),
+  _batchCommitCount(0),
+  _batchedWriteCount(0)
 {
   _db = malloc(sizeof(MDB_dbi));
 }
@@ -241,6 +281,27 @@ void LMDatabase::close()
   if (!_stopped)
   {
     _stopped = true;
+    __sync_synchronize();
+    
+    //
+    // Wait for readers that got in before we stopped.  New ones see
+    // _stopped and bail out.
+    //
+    while (__sync_fetch_and_add(&_activeReaders, 0) > 0)
+    {
+      OSS::thread_sleep(1);
+    }
+    
+    for (int i = 0; i < READER_SHARDS; i++)
+    {
+      OSS::mutex_critic_sec_lock lock(_readers[i].mutex);
+      for (std::vector<void*>::iterator iter = _readers[i].transactions.begin(); iter != _readers[i].transactions.end(); iter++)
+      {
+        mdb_txn_abort((MDB_txn*)*iter);
+      }
+      _readers[i].transactions.clear();
+    }
+    
     if (_env)
     {
       mdb_dbi_close((MDB_env*)_env, *((MDB_dbi*)_db));
@@ -311,7 +372,22 @@ bool LMDatabase::initialize(const Options& opt)
     return false;
   }
   
-  err = mdb_env_open((MDB_env*)_env, resolvedPath.c_str(), opt.env_flags, 0664);
+  if (opt.max_readers)
+  {
+    err = mdb_env_set_maxreaders((MDB_env*)_env, opt.max_readers);
+    if (err != 0)
+    {
+      return false;
+    }
+  }
+  
+  //
+  // Read-only transactions are pooled and renewed by whichever thread
+  // needs one next.  MDB_NOTLS ties the reader slot to the transaction
+  // instead of the thread that created it so this is allowed.
+  //
+  _opt = opt;
+  err = mdb_env_open((MDB_env*)_env, resolvedPath.c_str(), opt.env_flags | MDB_NOTLS, 0664);
   if (err != 0)
   {
     return false;
@@ -354,7 +430,7 @@ bool LMDatabase::set(Transaction& transaction, const std::string& key, void* val
   int ret = 0;
   
   MDB_val k, v;
-  k.mv_size = strlen(key.c_str());
+  k.mv_size = key.size();
   k.mv_data = (void*)key.data();
   
   v.mv_size = len;
@@ -375,7 +451,7 @@ bool LMDatabase::get(Transaction& transaction, const std::string& key, void** va
   assert(transaction.transaction());
   
   MDB_val k, v;
-  k.mv_size = strlen(key.c_str());
+  k.mv_size = key.size();
   k.mv_data = (void*)key.data();
   
   if (mdb_get((MDB_txn*)transaction.transaction(), *(MDB_dbi*)_db, &k, &v) == 0 && v.mv_data && v.mv_size)
@@ -399,6 +475,19 @@ bool LMDatabase::get(Transaction& transaction, const std::string& key, std::stri
   return false;
 }
 
+bool LMDatabase::get(Transaction& transaction, const std::string& key, View& value)
+{
+  void* data = 0;
+  std::size_t len = 0;
+  if (get(transaction, key, &data, len))
+  {
+    value = View((const char*)data, len);
+    return true;
+  }
+  value = View();
+  return false;
+}
+
 template <typename T>
 bool lmdb_get_value(LMDatabase::Transaction& transaction, LMDatabase* db, const std::string& key, T& value)
 {
@@ -437,7 +526,7 @@ bool LMDatabase::del(Transaction& transaction, const std::string& key)
   assert(transaction.transaction());
   MDB_val k, v;
   int ret = 0;
-  k.mv_size = strlen(key.c_str());
+  k.mv_size = key.size();
   k.mv_data = (void*)key.data();
   ret = mdb_del((MDB_txn*)transaction.transaction(), *((MDB_dbi*)_db), &k, &v);
   
@@ -466,6 +555,203 @@ bool LMDatabase::createCursor(Transaction& transaction, Cursor& cursor)
   return cursor.create(this, &transaction);
 }
 
+std::size_t LMDatabase::scanPrefix(Transaction& transaction, const std::string& prefix, const Visitor& visitor)
+{
+  Cursor cursor;
+  if (!createCursor(transaction, cursor))
+  {
+    return 0;
+  }
+  
+  View match(prefix);
+  std::size_t visited = 0;
+  bool found = prefix.empty() ? cursor.top() : cursor.seek(prefix);
+  for (; found && cursor.keyView().startsWith(match); found = cursor.next())
+  {
+    visited++;
+    if (!visitor(cursor.keyView(), cursor.valueView()))
+    {
+      break;
+    }
+  }
+  return visited;
+}
+
+std::size_t LMDatabase::scanRange(Transaction& transaction, const std::string& first, const std::string& last, const Visitor& visitor)
+{
+  Cursor cursor;
+  if (!createCursor(transaction, cursor))
+  {
+    return 0;
+  }
+  
+  View end(last);
+  std::size_t visited = 0;
+  bool found = first.empty() ? cursor.top() : cursor.seek(first);
+  for (; found && (last.empty() || cursor.keyView().compare(end) < 0); found = cursor.next())
+  {
+    visited++;
+    if (!visitor(cursor.keyView(), cursor.valueView()))
+    {
+      break;
+    }
+  }
+  return visited;
+}
+
+static std::size_t lmdb_reader_shard()
+{
+  static boost::hash<boost::thread::id> hasher;
+  return hasher(boost::this_thread::get_id());
+}
+
+void* LMDatabase::acquireReader()
+{
+  __sync_add_and_fetch(&_activeReaders, 1);
+  if (_stopped || !_env)
+  {
+    __sync_sub_and_fetch(&_activeReaders, 1);
+    return 0;
+  }
+  
+  MDB_txn* txn = 0;
+  ReaderShard& shard = _readers[lmdb_reader_shard() % READER_SHARDS];
+  {
+    OSS::mutex_critic_sec_lock lock(shard.mutex);
+    if (!shard.transactions.empty())
+    {
+      txn = (MDB_txn*)shard.transactions.back();
+      shard.transactions.pop_back();
+    }
+  }
+  
+  if (txn && mdb_txn_renew(txn) != 0)
+  {
+    mdb_txn_abort(txn);
+    txn = 0;
+  }
+  
+  if (!txn && mdb_txn_begin((MDB_env*)_env, 0, MDB_RDONLY, &txn) != 0)
+  {
+    //
+    // Most likely MDB_READERS_FULL.  Raise Options::max_readers if this
+    // happens under normal load.
+    //
+    OSS_LOG_ERROR("LMDatabase::acquireReader - unable to begin read-only transaction");
+    __sync_sub_and_fetch(&_activeReaders, 1);
+    return 0;
+  }
+  
+  return txn;
+}
+
+void LMDatabase::releaseReader(void* transaction)
+{
+  //
+  // Resetting releases the snapshot so writers can reuse its pages but
+  // keeps the reader slot for the next mdb_txn_renew.
+  //
+  mdb_txn_reset((MDB_txn*)transaction);
+  ReaderShard& shard = _readers[lmdb_reader_shard() % READER_SHARDS];
+  {
+    OSS::mutex_critic_sec_lock lock(shard.mutex);
+    shard.transactions.push_back(transaction);
+  }
+  __sync_sub_and_fetch(&_activeReaders, 1);
+}
+
+bool LMDatabase::batchWrite(const BatchWrite& write)
+{
+  boost::unique_lock<OSS::mutex_critic_sec> lock(_batchMutex);
+  
+  if (!_pendingBatch)
+  {
+    _pendingBatch = WriteBatchPtr(new WriteBatch());
+  }
+  WriteBatchPtr batch = _pendingBatch;
+  batch->writes.push_back(write);
+  
+  while (!batch->done)
+  {
+    if (_batchLeader)
+    {
+      //
+      // Another caller is committing.  Our write rides along with
+      // the next group once it is done.
+      //
+      _batchCondition.wait(lock);
+      continue;
+    }
+    
+    //
+    // Become the leader and commit everything queued so far.  Callers
+    // arriving while we commit start the next group.
+    //
+    _batchLeader = true;
+    WriteBatchPtr group = _pendingBatch;
+    _pendingBatch.reset();
+    
+    lock.unlock();
+    bool ok = commitBatch(*group);
+    lock.lock();
+    
+    group->ok = ok;
+    group->done = true;
+    if (ok)
+    {
+      _batchCommitCount++;
+      _batchedWriteCount += group->writes.size();
+    }
+    _batchLeader = false;
+    _batchCondition.notify_all();
+  }
+  
+  return batch->ok;
+}
+
+bool LMDatabase::commitBatch(WriteBatch& batch)
+{
+  Transaction transaction(this);
+  if (!transaction.begin())
+  {
+    return false;
+  }
+  
+  MDB_txn* txn = (MDB_txn*)transaction.transaction();
+  MDB_dbi dbi = *((MDB_dbi*)_db);
+  
+  for (std::vector<BatchWrite>::iterator iter = batch.writes.begin(); iter != batch.writes.end(); iter++)
+  {
+    MDB_val k, v;
+    k.mv_size = iter->key->size();
+    k.mv_data = (void*)iter->key->data();
+    
+    int ret = 0;
+    if (iter->value)
+    {
+      v.mv_size = iter->value->size();
+      v.mv_data = (void*)iter->value->data();
+      ret = mdb_put(txn, dbi, &k, &v, 0);
+    }
+    else
+    {
+      ret = mdb_del(txn, dbi, &k, 0);
+      if (ret == MDB_NOTFOUND)
+      {
+        ret = 0;
+      }
+    }
+    
+    if (ret != 0)
+    {
+      transaction.cancel();
+      return false;
+    }
+  }
+  
+  return transaction.end();
+}
+
   
 } } // OSS::LMDB
 
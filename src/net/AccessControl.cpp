@@ -21,6 +21,7 @@
 #include "OSS/Net/AccessControl.h"
 #include "OSS/UTL/Logger.h"
 #include "OSS/Net/Net.h"
+#include "OSS/UTL/CoreUtils.h"
 
 #include <sys/types.h>
 #include <sys/socket.h>
@@ -39,10 +40,14 @@ AccessControl::AccessControl() :
   _currentIterationCount(0),
   _autoBanThresholdViolators(true),
   _banLifeTime(0),
+  _sourceRates(_thresholdViolationRate, _thresholdViolationRate),
+  _windowStart(OSS::getTime()),
+  _evictShard(0),
+  _networkWhiteListTrie(new PrefixTrie()),
+  _networkBlackListTrie(new PrefixTrie()),
   _denyAllIncoming(false),
   _autoNullRoute(false)
 {
-  _lastTime = boost::posix_time::microsec_clock::local_time();
 }
 
 
@@ -50,6 +55,35 @@ AccessControl::~AccessControl()
 {
 }
 
+AccessControl::PrefixTriePtr AccessControl::buildNetworkTrie(const std::set<std::string>& networks)
+{
+  PrefixTrie* trie = new PrefixTrie();
+  for (std::set<std::string>::const_iterator iter = networks.begin(); iter != networks.end(); iter++)
+  {
+    if (!trie->insert(*iter))
+    {
+      OSS_LOG_WARNING("AccessControl::buildNetworkTrie - Invalid network " << *iter);
+    }
+  }
+  return PrefixTriePtr(trie);
+}
+
+//
+// Readers load the trie with boost::atomic_load() instead of taking
+// _packetCounterMutex.  A replaced trie is freed by whichever holder
+// releases it last, so a lookup that started before the swap can still
+// finish.  Must be called with _packetCounterMutex held.
+//
+void AccessControl::rebuildNetworkWhiteList()
+{
+  boost::atomic_store(&_networkWhiteListTrie, buildNetworkTrie(_networkWhiteList));
+}
+
+void AccessControl::rebuildNetworkBlackList()
+{
+  boost::atomic_store(&_networkBlackListTrie, buildNetworkTrie(_networkBlackList));
+}
+
 void AccessControl::logPacket(const boost::asio::ip::address& source, std::size_t bytesRead, ViolationReport* pReport)
 {
    /****************************************************************************
@@ -66,76 +100,76 @@ void AccessControl::logPacket(const boost::asio::ip::address& source, std::size_
   
   if (!_enabled)
     return;
-  _packetCounterMutex.lock();
 
-  std::map<boost::asio::ip::address, unsigned int>::iterator iter = _packetCounter.find(source);
-  if (iter != _packetCounter.end())
-    _packetCounter[source] = ++iter->second;
-  else
-    _packetCounter[source] = 1;
+  //
+  // The one second window only counts packets.  Rolling it over is claimed
+  // by a single thread with a compare and swap, which also sweeps one shard
+  // of the rate table so idle sources are let go without a periodic scan.
+  //
+  unsigned long long now = OSS::getTime();
+  unsigned long long windowStart = _windowStart;
+  if (now - windowStart >= 1000 && __sync_bool_compare_and_swap(&_windowStart, windowStart, now))
+  {
+    __sync_lock_test_and_set(&_currentIterationCount, 0);
+    _sourceRates.evictIdle(_evictShard++, now);
+  }
+  unsigned long count = __sync_add_and_fetch(&_currentIterationCount, 1);
+
+  SourceRateTable::Result result = _sourceRates.consume(source, now);
 
-  if (++_currentIterationCount >= _packetsPerSecondThreshold)
+  if (count < _packetsPerSecondThreshold)
+    return;
+
+  if (count == _packetsPerSecondThreshold)
   {
-    boost::posix_time::ptime now(boost::posix_time::microsec_clock::local_time());
-    _currentIterationCount = 0;
-    boost::posix_time::time_duration timeDiff = now - _lastTime;
-    if (timeDiff.total_milliseconds() <=  1000)
+    OSS_LOG_WARNING("ALERT: Threshold Violation Detected.  Rate " << count << " >= " << _packetsPerSecondThreshold);
+  }
+
+  if (pReport)
+    pReport->thresholdViolated = true;
+
+  if (result == SourceRateTable::RATE_OK)
+    return;
+
+  //
+  // The source has used up its bucket while the overall rate is above the
+  // alert level.
+  //
+  if (!_autoBanThresholdViolators)
+  {
+    if (result == SourceRateTable::RATE_EXCEEDED)
     {
-      //
-      // We got a ratelimit violation
-      //
-      OSS_LOG_WARNING("ALERT: Threshold Violation Detected.  Rate" << _currentIterationCount << " >= " << _packetsPerSecondThreshold);
-
-      if (pReport)
-        pReport->thresholdViolated = true;
-      
-      std::size_t watermark = 0;
-      boost::asio::ip::address suspect;
-      for (std::map<boost::asio::ip::address, unsigned int>::iterator iter = _packetCounter.begin();
-        iter != _packetCounter.end(); iter++)
-      {
-        if (iter->second > watermark)
-        {
-          watermark = iter->second;
-          suspect = iter->first;
-          
-          if (watermark >= _thresholdViolationRate && _autoBanThresholdViolators )
-          {
-            if (!isWhiteListed(suspect))
-            {
-              OSS_LOG_WARNING("ALERT: Threshold Violator Address = " << suspect.to_string() <<
-                " Packets sent within the last second is " << watermark
-                << ". Violator is now in jail for a maximum of " << _banLifeTime << " seconds.");
-              banAddress(suspect);
-              
-              if (pReport)
-                pReport->violators.push_back(suspect.to_string());
-            }
-            else
-            {
-              OSS_LOG_WARNING("ALERT: Threshold Violator Address = " << suspect.to_string() <<
-                " Packets sent within the last second is " << watermark
-                << ". Violator is TRUSTED and will be allowed to bombard.");
-            }
-          }
-          else if (watermark >= _thresholdViolationRate && !_autoBanThresholdViolators )
-          {
-            OSS_LOG_WARNING("ALERT: Threshold Violator Address = " << suspect.to_string() <<
-                " Packets sent within the last second is " << watermark
-                << ". Automatic ban is disabled.  Allowing this IP to bombard.");
-          }
-        }
-      }     
+      OSS_LOG_WARNING("ALERT: Threshold Violator Address = " << source.to_string() <<
+        " Packet rate exceeds " << _thresholdViolationRate
+        << " per second. Automatic ban is disabled.  Allowing this IP to bombard.");
     }
-    //
-    // Reset
-    //
-    _packetCounter.clear();
-    _lastTime = now;
+    return;
   }
 
+  if (isWhiteListed(source))
+  {
+    if (result == SourceRateTable::RATE_EXCEEDED)
+    {
+      OSS_LOG_WARNING("ALERT: Threshold Violator Address = " << source.to_string() <<
+        " Packet rate exceeds " << _thresholdViolationRate
+        << " per second. Violator is TRUSTED and will be allowed to bombard.");
+    }
+    return;
+  }
 
+  _packetCounterMutex.lock();
+  bool banned = _banned.find(source) != _banned.end();
+  if (!banned)
+  {
+    OSS_LOG_WARNING("ALERT: Threshold Violator Address = " << source.to_string() <<
+      " Packet rate exceeds " << _thresholdViolationRate
+      << " per second. Violator is now in jail for a maximum of " << _banLifeTime << " seconds.");
+    banAddress(source);
+  }
   _packetCounterMutex.unlock();
+
+  if (!banned && pReport)
+    pReport->violators.push_back(source.to_string());
 }
 
 bool AccessControl::isBannedAddress(const boost::asio::ip::address& source)
@@ -269,6 +303,19 @@ void AccessControl::whiteListNetwork(const std::string& network)
   OSS_LOG_NOTICE("AccessControl::whiteListNetwork - " << network);
   
    _networkWhiteList.insert(network);
+   rebuildNetworkWhiteList();
+
+  _packetCounterMutex.unlock();
+}
+
+void AccessControl::whiteListNetworks(const NetworkWhiteList& networks)
+{
+  _packetCounterMutex.lock();
+  
+  OSS_LOG_NOTICE("AccessControl::whiteListNetworks - " << networks.size() << " networks");
+  
+  _networkWhiteList.insert(networks.begin(), networks.end());
+  rebuildNetworkWhiteList();
 
   _packetCounterMutex.unlock();
 }
@@ -277,6 +324,7 @@ void AccessControl::clearWhiteListNetwork(const std::string& network)
 {
   _packetCounterMutex.lock();
   _networkWhiteList.erase(network);
+  rebuildNetworkWhiteList();
   _packetCounterMutex.unlock();
 }
 
@@ -297,24 +345,11 @@ bool AccessControl::isWhiteListed(const boost::asio::ip::address& address) const
 
 bool AccessControl::isWhiteListedNetwork(const boost::asio::ip::address& address) const
 {
-  boost::system::error_code ec;
-  std::string ipAddress = address.to_string(ec);
-  if (ec)
-    return false;
-
-  _packetCounterMutex.lock();
-  for (std::set<std::string>::const_iterator iter = _networkWhiteList.begin();
-    iter != _networkWhiteList.end(); iter++)
-  {
-    if (OSS::socket_address_cidr_verify(ipAddress, *iter))
-    {
-      _packetCounterMutex.unlock();
-      return true;
-    }
-  }
-  
-  _packetCounterMutex.unlock();
-  return false;
+  //
+  // No mutex.  See rebuildNetworkWhiteList()
+  //
+  PrefixTriePtr trie = boost::atomic_load(&_networkWhiteListTrie);
+  return trie->match(address);
 }
 
 
@@ -339,6 +374,19 @@ void AccessControl::blackListNetwork(const std::string& network)
   OSS_LOG_NOTICE("AccessControl::blackListNetwork - " << network);
   
   _networkBlackList.insert(network);
+  rebuildNetworkBlackList();
+
+  _packetCounterMutex.unlock();
+}
+
+void AccessControl::blackListNetworks(const NetworkBlackList& networks)
+{
+  _packetCounterMutex.lock();
+  
+  OSS_LOG_NOTICE("AccessControl::blackListNetworks - " << networks.size() << " networks");
+  
+  _networkBlackList.insert(networks.begin(), networks.end());
+  rebuildNetworkBlackList();
 
   _packetCounterMutex.unlock();
 }
@@ -369,32 +417,18 @@ bool AccessControl::isBlackListed(const boost::asio::ip::address& address) const
 
 bool AccessControl::isBlackListedNetwork(const boost::asio::ip::address& address) const
 {
-  boost::system::error_code ec;
-  std::string ipAddress = address.to_string(ec);
-  if (ec)
-  {
-    return false;
-  }
-
-  _packetCounterMutex.lock();
-  for (std::set<std::string>::const_iterator iter = _networkBlackList.begin();
-    iter != _networkBlackList.end(); iter++)
-  {
-    if (OSS::socket_address_cidr_verify(ipAddress, *iter))
-    {
-      _packetCounterMutex.unlock();
-      return true;
-    }
-  }
-  
-  _packetCounterMutex.unlock();
-  return false;
+  //
+  // No mutex.  See rebuildNetworkWhiteList()
+  //
+  PrefixTriePtr trie = boost::atomic_load(&_networkBlackListTrie);
+  return trie->match(address);
 }
 
 void AccessControl::clearNetwork(const std::string& cidr)
 {
   _packetCounterMutex.lock();
   _networkBlackList.erase(cidr);
+  rebuildNetworkBlackList();
   _packetCounterMutex.unlock();
 }
 
@@ -0,0 +1,813 @@
+// Library: OSS_CORE - Foundation API for SIP B2BUA
+// Copyright (c) OSS Software Solutions
+// Contributor: Joegen Baclor - mailto:joegen@ossapp.com
+//
+// Permission is hereby granted, to any person or organization
+// obtaining a copy of the software and accompanying documentation covered by
+// this license (the "Software") to use, execute, and to prepare
+// derivative works of the Software, all subject to the
+// "GNU Lesser General Public License (LGPL)".
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+// SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+// FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+
+
+
+#include <poll.h>
+#include <algorithm>
+#include <sstream>
+#include <boost/bind.hpp>
+#include <boost/shared_ptr.hpp>
+#include <udnspp/dnscontext.h>
+#include <udnspp/dnsarecord.h>
+#include <udnspp/dnssrvrecord.h>
+#include <udnspp/dnsnaptrrecord.h>
+#include "OSS/Net/DNSTargetResolver.h"
+#include "OSS/Net/IPAddress.h"
+#include "OSS/UTL/CoreUtils.h"
+#include "OSS/UTL/Thread.h"
+#include "OSS/UTL/Logger.h"
+
+
+namespace OSS {
+namespace Net {
+
+
+static const int EVENT_POLL_INTERVAL = 100; /// milliseconds
+
+
+static std::string dns_lower(const std::string& str)
+{
+  std::string lower = str;
+  OSS::string_to_lower(lower);
+  return lower;
+}
+
+
+//
+// udns callbacks
+//
+
+struct DNSQueryData
+{
+  DNSTargetResolver* resolver;
+  std::string key;
+};
+
+static void dns_query_complete(void* data, const DNSTargetResolver::Records& records, unsigned int ttl, int status)
+{
+  DNSQueryData* pData = static_cast<DNSQueryData*>(data);
+  DNSTargetResolver* pResolver = pData->resolver;
+  std::string key;
+  key.swap(pData->key);
+  delete pData;
+  pResolver->onQueryComplete(key, records, ttl, status);
+}
+
+static void dns_query_a4_cb(dns_ctx* ctx, dns_rr_a4* result, void* data)
+{
+  DNSTargetResolver::Records records;
+  unsigned int ttl = 0;
+  if (result)
+  {
+    udnspp::DNSARecordV4 rr(result);
+    free(result);
+    ttl = rr.getTTL();
+    for (udnspp::DNSAddressList::const_iterator iter = rr.getRecords().begin(); iter != rr.getRecords().end(); iter++)
+    {
+      DNSTargetResolver::Record record;
+      record.target = *iter;
+      records.push_back(record);
+    }
+  }
+  dns_query_complete(data, records, ttl, result ? DNS_E_NOERROR : dns_status(ctx));
+}
+
+static void dns_query_a6_cb(dns_ctx* ctx, dns_rr_a6* result, void* data)
+{
+  DNSTargetResolver::Records records;
+  unsigned int ttl = 0;
+  if (result)
+  {
+    udnspp::DNSARecordV6 rr(result);
+    free(result);
+    ttl = rr.getTTL();
+    for (udnspp::DNSAddressList::const_iterator iter = rr.getRecords().begin(); iter != rr.getRecords().end(); iter++)
+    {
+      DNSTargetResolver::Record record;
+      record.target = *iter;
+      records.push_back(record);
+    }
+  }
+  dns_query_complete(data, records, ttl, result ? DNS_E_NOERROR : dns_status(ctx));
+}
+
+static void dns_query_srv_cb(dns_ctx* ctx, dns_rr_srv* result, void* data)
+{
+  DNSTargetResolver::Records records;
+  unsigned int ttl = 0;
+  if (result)
+  {
+    udnspp::DNSSRVRecord rr(result);
+    free(result);
+    ttl = rr.getTTL();
+    for (udnspp::DNSSRVRecordList::const_iterator iter = rr.getRecords().begin(); iter != rr.getRecords().end(); iter++)
+    {
+      DNSTargetResolver::Record record;
+      record.target = iter->name;
+      record.port = iter->port;
+      record.priority = iter->priority;
+      record.weight = iter->weight;
+      records.push_back(record);
+    }
+  }
+  dns_query_complete(data, records, ttl, result ? DNS_E_NOERROR : dns_status(ctx));
+}
+
+static void dns_query_naptr_cb(dns_ctx* ctx, dns_rr_naptr* result, void* data)
+{
+  DNSTargetResolver::Records records;
+  unsigned int ttl = 0;
+  if (result)
+  {
+    udnspp::DNSNAPTRRecord rr(result);
+    free(result);
+    ttl = rr.getTTL();
+    for (udnspp::DNSNAPTRRecordList::const_iterator iter = rr.getRecords().begin(); iter != rr.getRecords().end(); iter++)
+    {
+      DNSTargetResolver::Record record;
+      record.target = iter->replacement;
+      record.priority = iter->order;
+      record.weight = iter->preference;
+      record.flags = iter->flags;
+      record.service = iter->service;
+      records.push_back(record);
+    }
+  }
+  dns_query_complete(data, records, ttl, result ? DNS_E_NOERROR : dns_status(ctx));
+}
+
+
+//
+// Lookup pipelines
+//
+
+struct DNSHostJob
+{
+  boost::mutex mutex;
+  int outstanding;
+  DNSTargetResolver::Records v4;
+  DNSTargetResolver::Records v6;
+  DNSTargetResolver::HostCallback cb;
+};
+typedef boost::shared_ptr<DNSHostJob> DNSHostJobPtr;
+
+static void dns_host_job_answer(DNSHostJobPtr job, bool v6, const DNSTargetResolver::Records& records)
+{
+  {
+    boost::mutex::scoped_lock lock(job->mutex);
+    (v6 ? job->v6 : job->v4) = records;
+    if (--job->outstanding)
+      return;
+  }
+
+  dns_host_record_list hosts;
+  for (DNSTargetResolver::Records::const_iterator iter = job->v4.begin(); iter != job->v4.end(); iter++)
+    hosts.push_back(iter->target);
+  for (DNSTargetResolver::Records::const_iterator iter = job->v6.begin(); iter != job->v6.end(); iter++)
+    hosts.push_back(iter->target);
+  job->cb(hosts);
+}
+
+struct DNSSRVJob
+{
+  boost::mutex mutex;
+  std::size_t outstanding;
+  std::vector<dns_srv_record> records;
+  DNSTargetResolver::SRVCallback cb;
+};
+typedef boost::shared_ptr<DNSSRVJob> DNSSRVJobPtr;
+
+static void dns_srv_job_address(DNSSRVJobPtr job, std::size_t index, const dns_host_record_list& hosts)
+{
+  {
+    boost::mutex::scoped_lock lock(job->mutex);
+    if (index < job->records.size() && !hosts.empty())
+      job->records[index].get<1>() = hosts.front();
+    if (--job->outstanding)
+      return;
+  }
+
+  dns_srv_record_list srvRecords;
+  for (std::vector<dns_srv_record>::const_iterator iter = job->records.begin(); iter != job->records.end(); iter++)
+  {
+    if (!iter->get<1>().empty())
+      srvRecords.insert(*iter);
+  }
+  job->cb(srvRecords);
+}
+
+static void dns_srv_job_answer(DNSTargetResolver* pResolver, DNSSRVJobPtr job, const DNSTargetResolver::Records& records)
+{
+  for (DNSTargetResolver::Records::const_iterator iter = records.begin(); iter != records.end(); iter++)
+  {
+    if (iter->target.empty() || iter->target == ".")
+      continue;
+    job->records.push_back(dns_srv_record(iter->target, "", iter->port, iter->priority, iter->weight));
+  }
+
+  //
+  // One extra count keeps the job open until every address lookup has been
+  // started, since cached answers complete before resolveHost() returns.
+  //
+  std::size_t count = job->records.size();
+  job->outstanding = count + 1;
+  for (std::size_t i = 0; i < count; i++)
+  {
+    const std::string& target = job->records[i].get<0>();
+    if (IPAddress::isIPAddress(target))
+      dns_srv_job_address(job, i, dns_host_record_list(1, target));
+    else
+      pResolver->resolveHost(target, boost::bind(dns_srv_job_address, job, i, _1));
+  }
+  dns_srv_job_address(job, count, dns_host_record_list());
+}
+
+struct DNSTargetsJob
+{
+  boost::mutex mutex;
+  std::string domain;
+  std::string transport;
+  bool secure;
+  std::size_t outstanding;
+  std::vector<DNSTargetResolver::Targets> groups;
+  DNSTargetResolver::TargetsCallback cb;
+};
+typedef boost::shared_ptr<DNSTargetsJob> DNSTargetsJobPtr;
+
+static unsigned short dns_default_port(const std::string& transport)
+{
+  return transport == "tls" ? 5061 : 5060;
+}
+
+static std::string dns_srv_prefix(const std::string& transport)
+{
+  if (transport == "tcp")
+    return "_sip._tcp.";
+  else if (transport == "tls")
+    return "_sips._tcp.";
+  else if (transport == "ws")
+    return "_sip._ws.";
+  return "_sip._udp.";
+}
+
+static std::string dns_naptr_transport(const std::string& service)
+{
+  std::string lower = dns_lower(service);
+  if (lower == "sip+d2u")
+    return "udp";
+  else if (lower == "sip+d2t")
+    return "tcp";
+  else if (lower == "sips+d2t")
+    return "tls";
+  else if (lower == "sip+d2w")
+    return "ws";
+  return std::string();
+}
+
+static bool dns_naptr_order(const DNSTargetResolver::Record& r1, const DNSTargetResolver::Record& r2)
+{
+  if (r1.priority != r2.priority)
+    return r1.priority < r2.priority;
+  return r1.weight < r2.weight;
+}
+
+static void dns_targets_job_host(DNSTargetsJobPtr job, const dns_host_record_list& hosts)
+{
+  std::string transport = job->transport;
+  if (transport.empty())
+    transport = job->secure ? "tls" : "udp";
+
+  DNSTargetResolver::Targets targets;
+  for (dns_host_record_list::const_iterator iter = hosts.begin(); iter != hosts.end(); iter++)
+  {
+    DNSTargetResolver::Target target;
+    target.transport = transport;
+    target.host = job->domain;
+    target.address = *iter;
+    target.port = dns_default_port(transport);
+    targets.push_back(target);
+  }
+  job->cb(targets);
+}
+
+static bool dns_same_target(const DNSTargetResolver::Target& t1, const DNSTargetResolver::Target& t2)
+{
+  return t1.transport == t2.transport && t1.address == t2.address && t1.port == t2.port;
+}
+
+static void dns_targets_job_srv(DNSTargetResolver* pResolver, DNSTargetsJobPtr job, std::size_t index, const std::string& transport, const dns_srv_record_list& srvRecords)
+{
+  {
+    boost::mutex::scoped_lock lock(job->mutex);
+    if (index < job->groups.size())
+    {
+      for (dns_srv_record_list::const_iterator iter = srvRecords.begin(); iter != srvRecords.end(); iter++)
+      {
+        DNSTargetResolver::Target target;
+        target.transport = transport;
+        target.host = iter->get<0>();
+        target.address = iter->get<1>();
+        target.port = iter->get<2>() ? iter->get<2>() : dns_default_port(transport);
+        target.priority = iter->get<3>();
+        target.weight = iter->get<4>();
+        job->groups[index].push_back(target);
+      }
+    }
+    if (--job->outstanding)
+      return;
+  }
+
+  //
+  // The same target may be published under both _sips._tcp and _sip._tls.
+  // Keep the first occurrence.
+  //
+  DNSTargetResolver::Targets targets;
+  for (std::vector<DNSTargetResolver::Targets>::const_iterator iter = job->groups.begin(); iter != job->groups.end(); iter++)
+  {
+    for (DNSTargetResolver::Targets::const_iterator target = iter->begin(); target != iter->end(); target++)
+    {
+      if (std::find_if(targets.begin(), targets.end(), boost::bind(dns_same_target, _1, boost::cref(*target))) == targets.end())
+        targets.push_back(*target);
+    }
+  }
+
+  if (targets.empty())
+  {
+    //
+    // No SRV records.  Fall back to the addresses of the domain itself.
+    //
+    pResolver->resolveHost(job->domain, boost::bind(dns_targets_job_host, job, _1));
+    return;
+  }
+  job->cb(targets);
+}
+
+static void dns_targets_job_naptr(DNSTargetResolver* pResolver, DNSTargetsJobPtr job, const DNSTargetResolver::Records& records)
+{
+  std::vector<std::pair<std::string, std::string> > queries;
+
+  DNSTargetResolver::Records naptr;
+  for (DNSTargetResolver::Records::const_iterator iter = records.begin(); iter != records.end(); iter++)
+  {
+    std::string transport = dns_naptr_transport(iter->service);
+    if (transport.empty() || dns_lower(iter->flags) != "s" || iter->target.empty())
+      continue;
+    if (!job->transport.empty() && transport != job->transport)
+      continue;
+    if (job->secure && transport != "tls")
+      continue;
+    naptr.push_back(*iter);
+  }
+  std::stable_sort(naptr.begin(), naptr.end(), dns_naptr_order);
+
+  for (DNSTargetResolver::Records::const_iterator iter = naptr.begin(); iter != naptr.end(); iter++)
+    queries.push_back(std::make_pair(iter->target, dns_naptr_transport(iter->service)));
+
+  if (queries.empty())
+  {
+    //
+    // No usable NAPTR records.  Query SRV for the requested transport or for
+    // every transport in order of preference.
+    //
+    std::vector<std::string> transports;
+    if (!job->transport.empty())
+      transports.push_back(job->transport);
+    else if (job->secure)
+      transports.push_back("tls");
+    else
+    {
+      transports.push_back("udp");
+      transports.push_back("tcp");
+      transports.push_back("tls");
+    }
+    for (std::vector<std::string>::const_iterator iter = transports.begin(); iter != transports.end(); iter++)
+    {
+      queries.push_back(std::make_pair(dns_srv_prefix(*iter) + job->domain, *iter));
+      //
+      // Older deployments only publish _sip._tls which is what the
+      // synchronous resolver used to query
+      //
+      if (*iter == "tls")
+        queries.push_back(std::make_pair("_sip._tls." + job->domain, *iter));
+    }
+  }
+
+  std::size_t count = queries.size();
+  job->groups.resize(count);
+  job->outstanding = count + 1;
+  for (std::size_t i = 0; i < count; i++)
+    pResolver->resolveSRV(queries[i].first, boost::bind(dns_targets_job_srv, pResolver, job, i, queries[i].second, _1));
+  dns_targets_job_srv(pResolver, job, count, std::string(), dns_srv_record_list());
+}
+
+
+//
+// Blocking wrappers
+//
+
+template <typename T>
+struct DNSSyncResult
+{
+  OSS::semaphore sem;
+  boost::mutex mutex;
+  T value;
+};
+
+template <typename T>
+static void dns_sync_complete(boost::shared_ptr<DNSSyncResult<T> > result, const T& value)
+{
+  {
+    boost::mutex::scoped_lock lock(result->mutex);
+    result->value = value;
+  }
+  result->sem.set();
+}
+
+template <typename T>
+static T dns_sync_wait(boost::shared_ptr<DNSSyncResult<T> > result, unsigned int timeout)
+{
+  result->sem.tryWait(timeout);
+  boost::mutex::scoped_lock lock(result->mutex);
+  return result->value;
+}
+
+
+//
+// DNSTargetResolver
+//
+
+DNSTargetResolver::DNSTargetResolver() :
+  _pContext(new udnspp::DNSContext()),
+  _pThread(0),
+  _isRunning(false),
+  _negativeTTL(DEFAULT_NEGATIVE_TTL),
+  _failureTTL(DEFAULT_FAILURE_TTL),
+  _maxTTL(DEFAULT_MAX_TTL),
+  _maxCacheSize(DEFAULT_MAX_CACHE_SIZE),
+  _queryCount(0),
+  _cacheHitCount(0),
+  _coalescedCount(0)
+{
+}
+
+DNSTargetResolver::~DNSTargetResolver()
+{
+  stop();
+  delete _pContext;
+}
+
+DNSTargetResolver& DNSTargetResolver::instance()
+{
+  static DNSTargetResolver resolver;
+  if (!resolver.isRunning())
+    resolver.start();
+  return resolver;
+}
+
+bool DNSTargetResolver::setNameServer(const std::string& address, unsigned short port)
+{
+  boost::recursive_mutex::scoped_lock lock(_contextMutex);
+  if (_pContext->isOpen())
+    return false;
+
+  dns_ctx* ctx = _pContext->context(false);
+  dns_add_serv(ctx, 0);
+  if (dns_add_serv(ctx, address.c_str()) < 0)
+    return false;
+  return dns_set_opt(ctx, DNS_OPT_PORT, port) >= 0;
+}
+
+bool DNSTargetResolver::start()
+{
+  boost::recursive_mutex::scoped_lock lock(_contextMutex);
+  if (_isRunning)
+    return true;
+
+  _pContext->context(true);
+  if (!_pContext->isOpen())
+  {
+    OSS_LOG_ERROR("DNSTargetResolver::start - Unable to open resolver socket");
+    return false;
+  }
+
+  _isRunning = true;
+  _pThread = new boost::thread(boost::bind(&DNSTargetResolver::run, this));
+  return true;
+}
+
+void DNSTargetResolver::stop()
+{
+  if (!_pThread)
+    return;
+
+  _isRunning = false;
+  _pThread->join();
+  delete _pThread;
+  _pThread = 0;
+
+  //
+  // Cancel whatever is still on the wire and let the waiters go
+  //
+  std::vector<RecordsCallback> waiters;
+  {
+    boost::recursive_mutex::scoped_lock contextLock(_contextMutex);
+    boost::mutex::scoped_lock cacheLock(_cacheMutex);
+    for (Pending::iterator iter = _pending.begin(); iter != _pending.end(); iter++)
+    {
+      if (iter->second.query)
+      {
+        dns_cancel(_pContext->context(false), iter->second.query);
+        delete static_cast<DNSQueryData*>(iter->second.data);
+      }
+      waiters.insert(waiters.end(), iter->second.waiters.begin(), iter->second.waiters.end());
+    }
+    _pending.clear();
+  }
+
+  for (std::vector<RecordsCallback>::iterator iter = waiters.begin(); iter != waiters.end(); iter++)
+    (*iter)(Records());
+}
+
+void DNSTargetResolver::run()
+{
+  pollfd pfd;
+  pfd.fd = _pContext->getSocketFd();
+  pfd.events = POLLIN;
+
+  while (_isRunning)
+  {
+    int wait;
+    {
+      boost::recursive_mutex::scoped_lock lock(_contextMutex);
+      wait = dns_timeouts(_pContext->context(false), 1, 0);
+    }
+
+    int timeout = EVENT_POLL_INTERVAL;
+    if (wait >= 0 && wait * 1000 < timeout)
+      timeout = wait * 1000;
+
+    pfd.revents = 0;
+    if (poll(&pfd, 1, timeout) > 0 && _isRunning)
+    {
+      boost::recursive_mutex::scoped_lock lock(_contextMutex);
+      dns_ioevent(_pContext->context(false), 0);
+    }
+  }
+}
+
+void DNSTargetResolver::lookup(RecordType type, const std::string& name, const RecordsCallback& cb)
+{
+  if (name.empty())
+  {
+    cb(Records());
+    return;
+  }
+
+  std::ostringstream strm;
+  strm << type << ":" << dns_lower(name);
+  std::string key = strm.str();
+
+  Records records;
+  {
+    boost::mutex::scoped_lock lock(_cacheMutex);
+    Cache::iterator cached = _cache.find(key);
+    if (cached != _cache.end())
+    {
+      if (cached->second.expires > OSS::getTime())
+      {
+        ++_cacheHitCount;
+        records = cached->second.records;
+        lock.unlock();
+        cb(records);
+        return;
+      }
+      _cache.erase(cached);
+    }
+
+    if (!_isRunning)
+    {
+      lock.unlock();
+      cb(records);
+      return;
+    }
+
+    Pending::iterator pending = _pending.find(key);
+    if (pending != _pending.end())
+    {
+      ++_coalescedCount;
+      pending->second.waiters.push_back(cb);
+      return;
+    }
+
+    ++_queryCount;
+    PendingQuery& query = _pending[key];
+    query.query = 0;
+    query.data = 0;
+    query.waiters.push_back(cb);
+  }
+
+  submit(type, name, key);
+}
+
+void DNSTargetResolver::submit(RecordType type, const std::string& name, const std::string& key)
+{
+  boost::recursive_mutex::scoped_lock lock(_contextMutex);
+  dns_ctx* ctx = _pContext->context(false);
+
+  DNSQueryData* pData = new DNSQueryData();
+  pData->resolver = this;
+  pData->key = key;
+
+  dns_query* pQuery = 0;
+  switch (type)
+  {
+  case TYPE_A:
+    pQuery = dns_submit_a4(ctx, name.c_str(), 0, dns_query_a4_cb, pData);
+    break;
+  case TYPE_AAAA:
+    pQuery = dns_submit_a6(ctx, name.c_str(), 0, dns_query_a6_cb, pData);
+    break;
+  case TYPE_SRV:
+    pQuery = dns_submit_srv(ctx, name.c_str(), 0, 0, 0, dns_query_srv_cb, pData);
+    break;
+  case TYPE_NAPTR:
+    pQuery = dns_submit_naptr(ctx, name.c_str(), 0, dns_query_naptr_cb, pData);
+    break;
+  }
+
+  if (!pQuery)
+  {
+    dns_query_complete(pData, Records(), 0, dns_status(ctx));
+    return;
+  }
+
+  {
+    boost::mutex::scoped_lock cacheLock(_cacheMutex);
+    Pending::iterator pending = _pending.find(key);
+    if (pending != _pending.end())
+    {
+      pending->second.query = pQuery;
+      pending->second.data = pData;
+    }
+  }
+
+  //
+  // udns only puts the query on the wire from dns_timeouts()
+  //
+  dns_timeouts(ctx, -1, 0);
+}
+
+void DNSTargetResolver::onQueryComplete(const std::string& key, const Records& records, unsigned int ttl, int status)
+{
+  std::vector<RecordsCallback> waiters;
+  {
+    boost::mutex::scoped_lock lock(_cacheMutex);
+    Pending::iterator pending = _pending.find(key);
+    if (pending != _pending.end())
+    {
+      waiters.swap(pending->second.waiters);
+      _pending.erase(pending);
+    }
+
+    if (records.empty())
+      ttl = (status == DNS_E_NXDOMAIN || status == DNS_E_NODATA) ? _negativeTTL : _failureTTL;
+    else if (ttl > _maxTTL)
+      ttl = _maxTTL;
+
+    if (ttl && _isRunning)
+    {
+      OSS::UInt64 now = OSS::getTime();
+      if (_cache.size() >= _maxCacheSize)
+      {
+        for (Cache::iterator iter = _cache.begin(); iter != _cache.end();)
+        {
+          if (iter->second.expires <= now)
+            _cache.erase(iter++);
+          else
+            ++iter;
+        }
+        if (_cache.size() >= _maxCacheSize)
+          _cache.erase(_cache.begin());
+      }
+
+      CacheEntry& entry = _cache[key];
+      entry.records = records;
+      entry.expires = now + (OSS::UInt64)ttl * 1000;
+    }
+  }
+
+  for (std::vector<RecordsCallback>::iterator iter = waiters.begin(); iter != waiters.end(); iter++)
+    (*iter)(records);
+}
+
+void DNSTargetResolver::resolveHost(const std::string& host, const HostCallback& cb)
+{
+  if (IPAddress::isIPAddress(host))
+  {
+    cb(dns_host_record_list(1, host));
+    return;
+  }
+
+  DNSHostJobPtr job(new DNSHostJob());
+  job->outstanding = 2;
+  job->cb = cb;
+  lookup(TYPE_A, host, boost::bind(dns_host_job_answer, job, false, _1));
+  lookup(TYPE_AAAA, host, boost::bind(dns_host_job_answer, job, true, _1));
+}
+
+void DNSTargetResolver::resolveSRV(const std::string& name, const SRVCallback& cb)
+{
+  DNSSRVJobPtr job(new DNSSRVJob());
+  job->outstanding = 0;
+  job->cb = cb;
+  lookup(TYPE_SRV, name, boost::bind(dns_srv_job_answer, this, job, _1));
+}
+
+void DNSTargetResolver::resolveTargets(const std::string& domain, const std::string& transport, bool secure, const TargetsCallback& cb)
+{
+  DNSTargetsJobPtr job(new DNSTargetsJob());
+  job->domain = domain;
+  job->transport = dns_lower(transport);
+  job->secure = secure;
+  job->outstanding = 0;
+  job->cb = cb;
+
+  if (IPAddress::isIPAddress(domain))
+  {
+    dns_targets_job_host(job, dns_host_record_list(1, domain));
+    return;
+  }
+
+  lookup(TYPE_NAPTR, domain, boost::bind(dns_targets_job_naptr, this, job, _1));
+}
+
+dns_host_record_list DNSTargetResolver::resolveHost(const std::string& host, unsigned int timeout)
+{
+  boost::shared_ptr<DNSSyncResult<dns_host_record_list> > result(new DNSSyncResult<dns_host_record_list>());
+  resolveHost(host, HostCallback(boost::bind(dns_sync_complete<dns_host_record_list>, result, _1)));
+  return dns_sync_wait(result, timeout);
+}
+
+dns_srv_record_list DNSTargetResolver::resolveSRV(const std::string& name, unsigned int timeout)
+{
+  boost::shared_ptr<DNSSyncResult<dns_srv_record_list> > result(new DNSSyncResult<dns_srv_record_list>());
+  resolveSRV(name, SRVCallback(boost::bind(dns_sync_complete<dns_srv_record_list>, result, _1)));
+  return dns_sync_wait(result, timeout);
+}
+
+DNSTargetResolver::Targets DNSTargetResolver::resolveTargets(const std::string& domain, const std::string& transport, bool secure, unsigned int timeout)
+{
+  boost::shared_ptr<DNSSyncResult<Targets> > result(new DNSSyncResult<Targets>());
+  resolveTargets(domain, transport, secure, TargetsCallback(boost::bind(dns_sync_complete<Targets>, result, _1)));
+  return dns_sync_wait(result, timeout);
+}
+
+void DNSTargetResolver::flushCache()
+{
+  boost::mutex::scoped_lock lock(_cacheMutex);
+  _cache.clear();
+}
+
+std::size_t DNSTargetResolver::getCacheSize() const
+{
+  boost::mutex::scoped_lock lock(_cacheMutex);
+  return _cache.size();
+}
+
+OSS::UInt64 DNSTargetResolver::getQueryCount() const
+{
+  boost::mutex::scoped_lock lock(_cacheMutex);
+  return _queryCount;
+}
+
+OSS::UInt64 DNSTargetResolver::getCacheHitCount() const
+{
+  boost::mutex::scoped_lock lock(_cacheMutex);
+  return _cacheHitCount;
+}
+
+OSS::UInt64 DNSTargetResolver::getCoalescedCount() const
+{
+  boost::mutex::scoped_lock lock(_cacheMutex);
+  return _coalescedCount;
+}
+
+
+} } // OSS::Net
@@ -47,6 +47,11 @@ bool FramedTcpClient::connect(const std::string& serviceAddress, const std::stri
     // boost::asio::connect(*_pSocket, hosts);
        _pSocket->connect(hosts->endpoint()); // so we use the connect member
     //////////////////////////////////////////////////////////////////////////
+    
+    //
+    // Frames are complete messages.  Do not hold them back waiting for more.
+    //
+    _pSocket->set_option(boost::asio::ip::tcp::no_delay(true));
 
     _isConnected = true;
   }
@@ -60,50 +65,60 @@ bool FramedTcpClient::connect(const std::string& serviceAddress, const std::stri
 
 bool FramedTcpClient::sendAndReceive(const std::string& data, std::string& response)
 {
-  assert(_pSocket);
-  short version = FTCP_VERSION;
-  short key = FTCP_KEY;
-  short len = (short)data.size();
-  std::stringstream strm;
-  strm.write((char*)(&version), sizeof(version));
-  strm.write((char*)(&key), sizeof(key));
-  strm.write((char*)(&len), sizeof(len));
-  strm << data;
-  std::string packet = strm.str();
-  boost::system::error_code ec;
-
-  if (packet.size() > FTCP_READ_BUFFER_SIZE)
+  if (!send(data))
   {
-    OSS_LOG_DEBUG( "FramedTcpClient::sendAndReceive "
-                << "Packet exceeds allowable frame size " << FTCP_READ_BUFFER_SIZE);
     return false;
   }
 
+  std::size_t len = 0;
+  if (!getNextReadSize(len) || !len)
+    return false;
 
-  bool ok = _pSocket->write_some(boost::asio::buffer(packet.c_str(), packet.size()), ec) > 0;
-  if (!ok)
+  boost::system::error_code ec;
+  response.resize(len);
+  boost::asio::read(*_pSocket, boost::asio::buffer(&response[0], len), ec);
+  if (ec)
   {
     _isConnected = false;
     return false;
   }
 
-  len = getNextReadSize();
-  if (!len)
+  return true;
+}
+
+bool FramedTcpClient::send(const std::string& data)
+{
+  assert(_pSocket);
+  std::string packet;
+  if (!FramedTcpConnection::encodeFrame(data, packet))
+  {
+    OSS_LOG_DEBUG( "FramedTcpClient::send "
+                << "Packet exceeds allowable frame size " << FTCP_MAX_PACKET_SIZE);
     return false;
+  }
 
-  char responseBuff[len];
-  _pSocket->read_some(boost::asio::buffer((char*)responseBuff, len), ec);
+  boost::system::error_code ec;
+  boost::asio::write(*_pSocket, boost::asio::buffer(packet.data(), packet.size()), ec);
   if (ec)
   {
     _isConnected = false;
     return false;
   }
-
-  response = std::string(responseBuff, len);
   return true;
 }
 
-short FramedTcpClient::getNextReadSize()
+void FramedTcpClient::close()
+{
+  if (_pSocket)
+  {
+    boost::system::error_code ignored_ec;
+    _pSocket->shutdown(boost::asio::ip::tcp::socket::shutdown_both, ignored_ec);
+    _pSocket->close(ignored_ec);
+  }
+  _isConnected = false;
+}
+
+bool FramedTcpClient::getNextReadSize(std::size_t& size)
 {
   short version = FTCP_VERSION;
   short key = FTCP_KEY;
@@ -122,14 +137,14 @@ short FramedTcpClient::getNextReadSize()
     {
 
       boost::system::error_code ec;
-      _pSocket->read_some(boost::asio::buffer((char*)&remoteVersion, sizeof(remoteVersion)), ec);
+      boost::asio::read(*_pSocket, boost::asio::buffer((char*)&remoteVersion, sizeof(remoteVersion)), ec);
       if (ec)
       {
         OSS_LOG_DEBUG( "FramedTcpClient::getNextReadSize "
                 << "Unable to read version "
                 << "ERROR: " << ec.message());
         _isConnected = false;
-        return 0;
+        return false;
       }
       else
       {
@@ -148,14 +163,14 @@ short FramedTcpClient::getNextReadSize()
     {
 
       boost::system::error_code ec;
-      _pSocket->read_some(boost::asio::buffer((char*)&remoteKey, sizeof(remoteKey)), ec);
+      boost::asio::read(*_pSocket, boost::asio::buffer((char*)&remoteKey, sizeof(remoteKey)), ec);
       if (ec)
       {
         OSS_LOG_DEBUG( "FramedTcpClient::getNextReadSize "
                 << "Unable to read secret key "
                 << "ERROR: " << ec.message());
         _isConnected = false;
-        return 0;
+        return false;
       }
       else
       {
@@ -169,17 +184,35 @@ short FramedTcpClient::getNextReadSize()
   }
 
   boost::system::error_code ec;
-  _pSocket->read_some(boost::asio::buffer((char*)&remoteLen, sizeof(remoteLen)), ec);
+  boost::asio::read(*_pSocket, boost::asio::buffer((char*)&remoteLen, sizeof(remoteLen)), ec);
   if (ec)
   {
     OSS_LOG_DEBUG( "FramedTcpClient::getNextReadSize "
             << "Unable to read secret packet length "
             << "ERROR: " << ec.message());
     _isConnected = false;
-    return 0;
+    return false;
+  }
+
+  if (remoteLen == FTCP_EXTENDED_LENGTH)
+  {
+    boost::uint32_t extendedLen = 0;
+    boost::asio::read(*_pSocket, boost::asio::buffer((char*)&extendedLen, sizeof(extendedLen)), ec);
+    if (ec || extendedLen > FTCP_MAX_PACKET_SIZE)
+    {
+      _isConnected = false;
+      return false;
+    }
+    size = extendedLen;
+    return true;
+  }
+  else if (remoteLen < 0)
+  {
+    return false;
   }
 
-  return remoteLen;
+  size = remoteLen;
+  return true;
 }
 
 bool FramedTcpClient::isConnected() const
@@ -1,6 +1,7 @@
 #include "OSS/Net/FramedTcpConnection.h"
 #include "OSS/Net/FramedTcpListener.h"
 #include "OSS/UTL/Logger.h"
+#include <cstring>
 
 
 namespace OSS {
@@ -28,20 +29,46 @@ FramedTcpConnection::~FramedTcpConnection()
   OSS_LOG_DEBUG( "FramedTcpConnection DESTROYED.");
 }
 
-bool FramedTcpConnection::write(const std::string& data)
+bool FramedTcpConnection::encodeFrame(const std::string& data, std::string& packet)
 {
+  if (data.size() > FTCP_MAX_PACKET_SIZE)
+  {
+    return false;
+  }
+  
   short version = FTCP_VERSION;
   short key = FTCP_KEY;
-  short len = (short)data.size();
-  std::stringstream strm;
-  strm.write((char*)(&version), sizeof(version));
-  strm.write((char*)(&key), sizeof(key));
-  strm.write((char*)(&len), sizeof(len));
-  strm << data;
-  std::string packet = strm.str();
+  short len = data.size() > 0x7FFF ? (short)FTCP_EXTENDED_LENGTH : (short)data.size();
+  packet.clear();
+  packet.reserve(FTCP_HEADER_SIZE + sizeof(boost::uint32_t) + data.size());
+  packet.append((const char*)(&version), sizeof(version));
+  packet.append((const char*)(&key), sizeof(key));
+  packet.append((const char*)(&len), sizeof(len));
+  if (len == FTCP_EXTENDED_LENGTH)
+  {
+    boost::uint32_t extendedLen = (boost::uint32_t)data.size();
+    packet.append((const char*)(&extendedLen), sizeof(extendedLen));
+  }
+  packet.append(data);
+  return true;
+}
+
+bool FramedTcpConnection::write(const std::string& data)
+{
+  std::string packet;
+  if (!encodeFrame(data, packet))
+  {
+    return false;
+  }
+  
+  //
+  // write_some may only send part of the packet.  Writes from different
+  // threads must not interleave.
+  //
+  boost::mutex::scoped_lock lock(_writeMutex);
   boost::system::error_code ec;
-  bool ok = _socket.write_some(boost::asio::buffer(packet.c_str(), packet.size()), ec) > 0;
-  return ok;
+  boost::asio::write(_socket, boost::asio::buffer(packet.data(), packet.size()), ec);
+  return !ec;
 }
 
 void FramedTcpConnection::handleRead(const boost::system::error_code& e, std::size_t bytes_transferred)
@@ -79,69 +106,14 @@ void FramedTcpConnection::handleRead(const boost::system::error_code& e, std::si
             << " SRC: " << _localAddress << ":" << _localPort
             << " DST: " << _remoteAddress << ":" << _remotePort );
 
-    if (_moreReadRequired == 0)
-    {
-      std::stringstream strm;
-      if (!_spillOverBuffer.empty())
-        strm << _spillOverBuffer;
-
- 
-      strm.write(_buffer.data(), bytes_transferred);
-
-      if (!_spillOverBuffer.empty())
-      {
-        bytes_transferred += _spillOverBuffer.size();
-        OSS_LOG_DEBUG("FramedTcpConnection::handleRead "
-                << "Spillover buffer is not empty.  "
-                << "Resulting BYTES: " << bytes_transferred);
-      }
-
-      short version;
-      strm.read((char*)(&version), sizeof(version));
-      short key;
-      strm.read((char*)(&key), sizeof(key));
-      if (version == FTCP_VERSION && key == FTCP_KEY)
-      {
-        short len;
-        strm.read((char*)(&len), sizeof(len));
-        
-        _lastExpectedPacketSize = len + sizeof(version) + sizeof(key) + (sizeof(len));
-        _moreReadRequired =  bytes_transferred - _lastExpectedPacketSize;
-        
-        if (!_moreReadRequired)
-        {
-          char buf[FTCP_READ_BUFFER_SIZE];
-          strm.read(buf, len);
-          _listener.onIncomingRequest(*this, buf, len);
-          _spillOverBuffer = std::string();
-          if (_lastExpectedPacketSize < bytes_transferred)
-          {
-            //
-            // We have spill over bytes
-            //
-            std::size_t extraBytes = bytes_transferred - _lastExpectedPacketSize;
-            char spillbuf[extraBytes];
-            strm.read(spillbuf, extraBytes);
-            _spillOverBuffer = std::string(spillbuf, extraBytes);
-            OSS_LOG_DEBUG("FramedTcpConnection::handleRead "
-                << "Spillover bytes from last read detected.  "
-                << "BYTES: " << extraBytes);
-          }
-        }
-        else
-        {
-          _messageBuffer += _spillOverBuffer;
-          _messageBuffer += std::string(_buffer.data(), bytes_transferred);
-          _spillOverBuffer = std::string();
-          OSS_LOG_DEBUG("FramedTcpConnection::handleRead "
-                << "More bytes required to complete message.  "
-                << "Required BYTES: " << _moreReadRequired);
-        }
-      }
-    }
-    else
+    if (!readMore(bytes_transferred))
     {
-      readMore(bytes_transferred);
+      OSS_LOG_WARNING( "FramedTcpConnection::handleRead "
+                << "Invalid frame header.  Closing connection.");
+      boost::system::error_code ignored_ec;
+      _socket.shutdown(boost::asio::ip::tcp::socket::shutdown_both, ignored_ec);
+      _listener.destroyConnection(shared_from_this());
+      return;
     }
   }
   else if (e)
@@ -158,55 +130,67 @@ void FramedTcpConnection::handleRead(const boost::system::error_code& e, std::si
   start();
 }
 
-void FramedTcpConnection::readMore(std::size_t bytes_transferred)
+bool FramedTcpConnection::readMore(std::size_t bytes_transferred)
 {
-  _messageBuffer += std::string(_buffer.data(), bytes_transferred);
-
-  std::stringstream strm;
-  strm << _messageBuffer;
-
-  short version;
-  strm.read((char*)(&version), sizeof(version));
-  short key;
-  strm.read((char*)(&key), sizeof(key));
-  if (version == FTCP_VERSION && key == FTCP_KEY)
+  _messageBuffer.append(_buffer.data(), bytes_transferred);
+
+  //
+  // A read may end in the middle of a frame or carry several frames.
+  // Deliver every complete one and keep the rest for the next read.
+  //
+  std::size_t offset = 0;
+  while (_messageBuffer.size() - offset >= FTCP_HEADER_SIZE)
   {
+    const char* header = _messageBuffer.data() + offset;
+    std::size_t available = _messageBuffer.size() - offset;
+    short version;
+    short key;
     short len;
-    strm.read((char*)(&len), sizeof(len));
-
-    _lastExpectedPacketSize = len + sizeof(version) + sizeof(key) + (sizeof(len));
-    if (_messageBuffer.size() < _lastExpectedPacketSize)
-      _moreReadRequired = _lastExpectedPacketSize - _messageBuffer.size();
-    else
-      _moreReadRequired = 0;
+    memcpy(&version, header, sizeof(version));
+    memcpy(&key, header + sizeof(version), sizeof(key));
+    memcpy(&len, header + sizeof(version) + sizeof(key), sizeof(len));
+    if (version != FTCP_VERSION || key != FTCP_KEY || (len < 0 && len != FTCP_EXTENDED_LENGTH))
+    {
+      _messageBuffer.clear();
+      return false;
+    }
 
-    if (!_moreReadRequired)
+    std::size_t headerSize = FTCP_HEADER_SIZE;
+    std::size_t packetSize = len;
+    if (len == FTCP_EXTENDED_LENGTH)
     {
-      char buf[FTCP_READ_BUFFER_SIZE];
-      strm.read(buf, len);
-      _listener.onIncomingRequest(*this, buf, len);
-      _spillOverBuffer = std::string();
-      if (_lastExpectedPacketSize < _messageBuffer.size())
+      boost::uint32_t extendedLen;
+      if (available < headerSize + sizeof(extendedLen))
+      {
+        break;
+      }
+      memcpy(&extendedLen, header + headerSize, sizeof(extendedLen));
+      if (extendedLen > FTCP_MAX_PACKET_SIZE)
       {
-        //
-        // We have spill over bytes
-        //
-        std::size_t extraBytes = _messageBuffer.size() - _lastExpectedPacketSize;
-        char spillbuf[extraBytes];
-        strm.read(spillbuf, extraBytes);
-        _spillOverBuffer = std::string(spillbuf, extraBytes);
-        OSS_LOG_DEBUG( "FramedTcpConnection::readMore "
-                << "Spillover bytes from last read detected.  "
-                << "BYTES: " << extraBytes);
+        _messageBuffer.clear();
+        return false;
       }
+      headerSize += sizeof(extendedLen);
+      packetSize = extendedLen;
     }
-    else
+
+    _lastExpectedPacketSize = headerSize + packetSize;
+    if (available < _lastExpectedPacketSize)
     {
+      _moreReadRequired = _lastExpectedPacketSize - available;
       OSS_LOG_DEBUG( "FramedTcpConnection::readMore "
                 << "More bytes required to complete message.  "
                 << "Required BYTES: " << _moreReadRequired);
+      break;
     }
+
+    _moreReadRequired = 0;
+    _listener.onIncomingRequest(*this, header + headerSize, packetSize);
+    offset += _lastExpectedPacketSize;
   }
+
+  _messageBuffer.erase(0, offset);
+  return true;
 }
 
 void FramedTcpConnection::start()
@@ -35,9 +35,38 @@ void FramedTcpListener::run(const std::string& address, const std::string& port)
     << " started accepting connections at bind address tcp://" << address << ":" << port);
 }
 
+void FramedTcpListener::stop()
+{
+  boost::system::error_code ignored_ec;
+  _acceptor.close(ignored_ec);
+  
+  std::map<FramedTcpConnection*, FramedTcpConnection::Ptr> connections;
+  {
+    mutex_lock lock(_mutex);
+    connections.swap(_connections);
+  }
+  for (std::map<FramedTcpConnection*, FramedTcpConnection::Ptr>::iterator iter = connections.begin(); iter != connections.end(); iter++)
+  {
+    iter->second->stop();
+  }
+}
+
 void FramedTcpListener::handleAccept(const boost::system::error_code& e)
 {
-  addConnection(_pNewConnection);
+  if (e)
+  {
+    //
+    // The acceptor was closed or ran out of descriptors.  There is no
+    // connection to add.
+    //
+    OSS_LOG_WARNING( "FramedTcpListener::handleAccept "
+      << " unable to accept connection - " << e.message());
+  }
+  else
+  {
+    addConnection(_pNewConnection);
+  }
+  
   if (_acceptor.is_open())
   {
     _pNewConnection.reset(new FramedTcpConnection(*this));
@@ -0,0 +1,217 @@
+// Library: OSS_CORE - Foundation API for SIP B2BUA
+// Copyright (c) OSS Software Solutions
+// Contributor: Joegen Baclor - mailto:joegen@ossapp.com
+//
+// Permission is hereby granted, to any person or organization
+// obtaining a copy of the software and accompanying documentation covered by
+// this license (the "Software") to use, execute, and to prepare
+// derivative works of the Software, all subject to the
+// "GNU Lesser General Public License (LGPL)".
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+// SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+// FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+
+#include <cstdlib>
+#include <sstream>
+#include "OSS/Net/PrefixTrie.h"
+
+
+namespace OSS {
+namespace Net {
+
+
+static inline unsigned get_nibble(const unsigned char* key, unsigned depth)
+{
+  unsigned char byte = key[depth / 8];
+  return (depth % 8) ? (byte & 0x0F) : (byte >> 4);
+}
+
+
+PrefixTrie::PrefixTrie()
+{
+  //
+  // Root nodes are always present so lookups never have to check for empty tables
+  //
+  createNode(_v4Nodes);
+  createNode(_v6Nodes);
+}
+
+PrefixTrie::~PrefixTrie()
+{
+}
+
+boost::uint32_t PrefixTrie::createNode(Nodes& nodes)
+{
+  boost::uint32_t index = nodes.size() / FANOUT;
+  Entry entry;
+  entry.child = 0;
+  entry.prefix = -1;
+  nodes.resize(nodes.size() + FANOUT, entry);
+  return index;
+}
+
+bool PrefixTrie::parseCidr(const std::string& cidr, boost::asio::ip::address& network, unsigned& bits)
+{
+  std::string ip = cidr;
+  std::string mask;
+  std::size_t sep = cidr.find_first_of("/-");
+  if (sep != std::string::npos)
+  {
+    ip = cidr.substr(0, sep);
+    mask = cidr.substr(sep + 1);
+  }
+
+  boost::system::error_code ec;
+  network = boost::asio::ip::address::from_string(ip, ec);
+  if (ec)
+  {
+    return false;
+  }
+
+  unsigned maxBits = network.is_v4() ? 32 : 128;
+  if (mask.empty())
+  {
+    bits = network.is_v4() ? (unsigned)DEFAULT_IPV4_BITS : maxBits;
+    return true;
+  }
+
+  char* end = 0;
+  long value = std::strtol(mask.c_str(), &end, 10);
+  if (!end || *end != '\0' || value < 0 || value > (long)maxBits)
+  {
+    return false;
+  }
+  bits = (unsigned)value;
+  return true;
+}
+
+bool PrefixTrie::insert(const std::string& cidr)
+{
+  boost::asio::ip::address network;
+  unsigned bits = 0;
+  if (!parseCidr(cidr, network, bits) || !insert(network, bits))
+  {
+    return false;
+  }
+  _prefixes.back() = cidr;
+  return true;
+}
+
+bool PrefixTrie::insert(const boost::asio::ip::address& network, unsigned bits)
+{
+  int index = _prefixes.size();
+  if (network.is_v4())
+  {
+    if (bits > 32)
+    {
+      return false;
+    }
+    boost::asio::ip::address_v4::bytes_type key = network.to_v4().to_bytes();
+    insert(_v4Nodes, key.data(), bits, index);
+  }
+  else
+  {
+    if (bits > 128)
+    {
+      return false;
+    }
+    boost::asio::ip::address_v6::bytes_type key = network.to_v6().to_bytes();
+    insert(_v6Nodes, key.data(), bits, index);
+  }
+
+  std::ostringstream strm;
+  strm << network.to_string() << "/" << bits;
+  _prefixes.push_back(strm.str());
+  _prefixBits.push_back(bits);
+  return true;
+}
+
+void PrefixTrie::insert(Nodes& nodes, const unsigned char* key, unsigned bits, int index)
+{
+  boost::uint32_t node = 0;
+  unsigned depth = 0;
+
+  //
+  // Walk down full strides creating nodes as needed
+  //
+  while (bits - depth > STRIDE)
+  {
+    std::size_t offset = node * FANOUT + get_nibble(key, depth);
+    if (!nodes[offset].child)
+    {
+      //
+      // createNode() may reallocate so don't hold a reference across it
+      //
+      boost::uint32_t child = createNode(nodes);
+      nodes[offset].child = child;
+    }
+    node = nodes[offset].child;
+    depth += STRIDE;
+  }
+
+  //
+  // Expand the remaining bits over the entries they cover.  A longer prefix
+  // always wins regardless of insertion order.
+  //
+  unsigned remaining = bits - depth;
+  unsigned span = 1 << (STRIDE - remaining);
+  unsigned first = remaining ? (get_nibble(key, depth) & ~(span - 1)) : 0;
+  for (unsigned i = first; i < first + span; i++)
+  {
+    Entry& entry = nodes[node * FANOUT + i];
+    if (entry.prefix < 0 || _prefixBits[entry.prefix] <= bits)
+    {
+      entry.prefix = index;
+    }
+  }
+}
+
+int PrefixTrie::lookup(const Nodes& nodes, const unsigned char* key, unsigned keyBits) const
+{
+  const Entry* base = &nodes[0];
+  int prefix = -1;
+  boost::uint32_t node = 0;
+
+  for (unsigned depth = 0; depth < keyBits; depth += STRIDE)
+  {
+    const Entry& entry = base[node * FANOUT + get_nibble(key, depth)];
+    if (entry.prefix >= 0)
+    {
+      prefix = entry.prefix;
+    }
+    if (!entry.child)
+    {
+      break;
+    }
+    node = entry.child;
+  }
+  return prefix;
+}
+
+int PrefixTrie::lookup(const boost::asio::ip::address& address) const
+{
+  if (address.is_v4())
+  {
+    boost::asio::ip::address_v4::bytes_type key = address.to_v4().to_bytes();
+    return lookup(_v4Nodes, key.data(), 32);
+  }
+
+  boost::asio::ip::address_v6 v6 = address.to_v6();
+  if (v6.is_v4_mapped())
+  {
+    boost::asio::ip::address_v4::bytes_type key = v6.to_v4().to_bytes();
+    return lookup(_v4Nodes, key.data(), 32);
+  }
+
+  boost::asio::ip::address_v6::bytes_type key = v6.to_bytes();
+  return lookup(_v6Nodes, key.data(), 128);
+}
+
+
+} } // OSS::Net
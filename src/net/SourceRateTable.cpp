@@ -0,0 +1,287 @@
+// Library: OSS_CORE - Foundation API for SIP B2BUA
+// Copyright (c) OSS Software Solutions
+// Contributor: Joegen Baclor - mailto:joegen@ossapp.com
+//
+// Permission is hereby granted, to any person or organization
+// obtaining a copy of the software and accompanying documentation covered by
+// this license (the "Software") to use, execute, and to prepare
+// derivative works of the Software, all subject to the
+// "GNU Lesser General Public License (LGPL)".
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+// SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+// FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+
+
+
+#include "OSS/Net/SourceRateTable.h"
+
+
+namespace OSS {
+namespace Net {
+
+
+static const boost::uint64_t V4_MAPPED_PREFIX = 0x0000FFFF00000000ULL;
+
+
+SourceRateTable::SourceRateTable(unsigned long rate, unsigned long burst, std::size_t maxSources) :
+  _shards(new Shard[SHARD_COUNT]),
+  _rate(rate),
+  _burst(burst ? burst : 1),
+  _idleTimeout(DEFAULT_IDLE_TIMEOUT),
+  _maxShardSources(maxSources / SHARD_COUNT ? maxSources / SHARD_COUNT : 1),
+  _overflow(0)
+{
+  for (unsigned i = 0; i < SHARD_COUNT; i++)
+  {
+    _shards[i].count = 0;
+  }
+}
+
+SourceRateTable::~SourceRateTable()
+{
+  delete [] _shards;
+}
+
+void SourceRateTable::setRate(unsigned long rate, unsigned long burst)
+{
+  _rate = rate;
+  _burst = burst ? burst : 1;
+}
+
+void SourceRateTable::makeKey(const boost::asio::ip::address& source, boost::uint64_t& hi, boost::uint64_t& lo)
+{
+  if (source.is_v4())
+  {
+    hi = 0;
+    lo = V4_MAPPED_PREFIX | source.to_v4().to_ulong();
+    return;
+  }
+
+  boost::asio::ip::address_v6::bytes_type bytes = source.to_v6().to_bytes();
+  hi = 0;
+  lo = 0;
+  for (int i = 0; i < 8; i++)
+  {
+    hi = (hi << 8) | bytes[i];
+    lo = (lo << 8) | bytes[i + 8];
+  }
+}
+
+boost::uint64_t SourceRateTable::hash(boost::uint64_t hi, boost::uint64_t lo)
+{
+  boost::uint64_t h = (hi * 0x9E3779B97F4A7C15ULL) ^ (lo * 0xC2B2AE3D27D4EB4FULL);
+  h ^= h >> 29;
+  h *= 0xBF58476D1CE4E5B9ULL;
+  h ^= h >> 32;
+  return h;
+}
+
+void SourceRateTable::refill(Slot& slot, boost::uint64_t now) const
+{
+  boost::uint64_t capacity = (boost::uint64_t)_burst * 1000;
+  if (now > slot.lastSeen)
+  {
+    //
+    // rate tokens per second is rate thousandths of a token per millisecond
+    //
+    boost::uint64_t tokens = slot.tokens + (now - slot.lastSeen) * _rate;
+    slot.tokens = (boost::uint32_t)(tokens < capacity ? tokens : capacity);
+    slot.lastSeen = now;
+  }
+  else if (slot.tokens > capacity)
+  {
+    slot.tokens = (boost::uint32_t)capacity;
+  }
+}
+
+SourceRateTable::Result SourceRateTable::consume(const boost::asio::ip::address& source, boost::uint64_t now)
+{
+  boost::uint64_t hi, lo;
+  makeKey(source, hi, lo);
+  boost::uint64_t h = hash(hi, lo);
+  Shard& shard = _shards[h >> (64 - SHARD_BITS)];
+
+  boost::mutex::scoped_lock lock(shard.mutex);
+
+  if (!shard.slots.empty())
+  {
+    std::size_t mask = shard.slots.size() - 1;
+    for (std::size_t i = h & mask;; i = (i + 1) & mask)
+    {
+      Slot& slot = shard.slots[i];
+      if (!slot.lastSeen)
+      {
+        break;
+      }
+      if (slot.hi == hi && slot.lo == lo)
+      {
+        refill(slot, now);
+        if (slot.tokens >= 1000)
+        {
+          slot.tokens -= 1000;
+          slot.exceeded = 0;
+          return RATE_OK;
+        }
+        return slot.exceeded++ ? RATE_STILL_EXCEEDED : RATE_EXCEEDED;
+      }
+    }
+  }
+
+  //
+  // New source.  A full shard fails open rather than scanning for idle
+  // sources on every packet.  Keep the load factor at or below three quarters.
+  //
+  if (shard.count >= _maxShardSources)
+  {
+    __sync_fetch_and_add(&_overflow, 1);
+    return RATE_OK;
+  }
+
+  if ((shard.count + 1) * 4 > shard.slots.size() * 3)
+  {
+    rehash(shard, now);
+  }
+
+  std::size_t mask = shard.slots.size() - 1;
+  std::size_t i = h & mask;
+  while (shard.slots[i].lastSeen)
+  {
+    i = (i + 1) & mask;
+  }
+
+  Slot& slot = shard.slots[i];
+  slot.hi = hi;
+  slot.lo = lo;
+  slot.lastSeen = now ? now : 1;
+  slot.tokens = (boost::uint32_t)(_burst * 1000 - 1000);
+  slot.exceeded = 0;
+  shard.count++;
+  return RATE_OK;
+}
+
+unsigned long SourceRateTable::getTokens(const boost::asio::ip::address& source, boost::uint64_t now) const
+{
+  boost::uint64_t hi, lo;
+  makeKey(source, hi, lo);
+  boost::uint64_t h = hash(hi, lo);
+  const Shard& shard = _shards[h >> (64 - SHARD_BITS)];
+
+  boost::mutex::scoped_lock lock(shard.mutex);
+  if (!shard.slots.empty())
+  {
+    std::size_t mask = shard.slots.size() - 1;
+    for (std::size_t i = h & mask; shard.slots[i].lastSeen; i = (i + 1) & mask)
+    {
+      if (shard.slots[i].hi == hi && shard.slots[i].lo == lo)
+      {
+        Slot slot = shard.slots[i];
+        refill(slot, now);
+        return slot.tokens / 1000;
+      }
+    }
+  }
+  return _burst;
+}
+
+std::size_t SourceRateTable::rehash(Shard& shard, boost::uint64_t now)
+{
+  //
+  // Idle sources are dropped first.  The table only grows if what remains
+  // would still fill more than half of it, and never beyond the room needed
+  // for the per shard source limit.
+  //
+  std::size_t live = 0;
+  for (std::vector<Slot>::const_iterator iter = shard.slots.begin(); iter != shard.slots.end(); iter++)
+  {
+    if (iter->lastSeen && now < iter->lastSeen + _idleTimeout)
+    {
+      live++;
+    }
+  }
+
+  std::size_t capacity = INITIAL_SHARD_CAPACITY;
+  std::size_t limit = live + 1 < _maxShardSources ? live + 1 : _maxShardSources;
+  while (capacity < limit * 2)
+  {
+    capacity <<= 1;
+  }
+
+  std::vector<Slot> slots(capacity);
+  for (std::vector<Slot>::iterator iter = slots.begin(); iter != slots.end(); iter++)
+  {
+    iter->lastSeen = 0;
+  }
+
+  std::size_t mask = capacity - 1;
+  std::size_t kept = 0;
+  for (std::vector<Slot>::const_iterator iter = shard.slots.begin(); iter != shard.slots.end(); iter++)
+  {
+    if (!iter->lastSeen || now >= iter->lastSeen + _idleTimeout)
+    {
+      continue;
+    }
+    std::size_t i = hash(iter->hi, iter->lo) & mask;
+    while (slots[i].lastSeen)
+    {
+      i = (i + 1) & mask;
+    }
+    slots[i] = *iter;
+    kept++;
+  }
+
+  std::size_t dropped = shard.count - kept;
+  shard.slots.swap(slots);
+  shard.count = kept;
+  return dropped;
+}
+
+std::size_t SourceRateTable::evictIdle(boost::uint64_t now)
+{
+  std::size_t dropped = 0;
+  for (unsigned i = 0; i < SHARD_COUNT; i++)
+  {
+    dropped += evictIdle(i, now);
+  }
+  return dropped;
+}
+
+std::size_t SourceRateTable::evictIdle(unsigned shard, boost::uint64_t now)
+{
+  Shard& target = _shards[shard % SHARD_COUNT];
+  boost::mutex::scoped_lock lock(target.mutex);
+  if (target.slots.empty())
+  {
+    return 0;
+  }
+  return rehash(target, now);
+}
+
+void SourceRateTable::clear()
+{
+  for (unsigned i = 0; i < SHARD_COUNT; i++)
+  {
+    boost::mutex::scoped_lock lock(_shards[i].mutex);
+    std::vector<Slot>().swap(_shards[i].slots);
+    _shards[i].count = 0;
+  }
+}
+
+std::size_t SourceRateTable::size() const
+{
+  std::size_t count = 0;
+  for (unsigned i = 0; i < SHARD_COUNT; i++)
+  {
+    boost::mutex::scoped_lock lock(_shards[i].mutex);
+    count += _shards[i].count;
+  }
+  return count;
+}
+
+
+} } // OSS::Net
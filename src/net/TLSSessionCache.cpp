@@ -0,0 +1,530 @@
+// Library: OSS_CORE - Foundation API for SIP B2BUA
+// Copyright (c) OSS Software Solutions
+// Contributor: Joegen Baclor - mailto:joegen@ossapp.com
+//
+// Permission is hereby granted, to any person or organization
+// obtaining a copy of the software and accompanying documentation covered by
+// this license (the "Software") to use, execute, and to prepare
+// derivative works of the Software, all subject to the
+// "GNU Lesser General Public License (LGPL)".
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+// SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+// FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+
+#include <ctime>
+#include <cstring>
+#include <algorithm>
+#include <openssl/evp.h>
+#include <openssl/rand.h>
+#include <openssl/crypto.h>
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+#include <openssl/core_names.h>
+#else
+#include <openssl/hmac.h>
+#endif
+
+#include "OSS/Net/TLSSessionCache.h"
+#include "OSS/UTL/CoreUtils.h"
+#include "OSS/UTL/Logger.h"
+
+
+namespace OSS {
+namespace Net {
+
+
+static void free_destination(void* parent, void* ptr, CRYPTO_EX_DATA* ad, int idx, long argl, void* argp)
+{
+  delete static_cast<std::string*>(ptr);
+}
+
+static int context_index()
+{
+  static int index = SSL_CTX_get_ex_new_index(0, 0, 0, 0, 0);
+  return index;
+}
+
+static int destination_index()
+{
+  static int index = SSL_get_ex_new_index(0, 0, 0, 0, free_destination);
+  return index;
+}
+
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+
+static int ticket_key_callback(SSL* pSSL, unsigned char* name, unsigned char* iv, EVP_CIPHER_CTX* pCipher, EVP_MAC_CTX* pMac, int encrypt)
+{
+  TLSSessionCache* pCache = TLSSessionCache::fromContext(SSL_get_SSL_CTX(pSSL));
+  if (!pCache)
+  {
+    return 0;
+  }
+
+  unsigned char hmacKey[TLSSessionCache::TICKET_KEY_SIZE];
+  int result = pCache->handleTicketKey(name, iv, pCipher, hmacKey, encrypt);
+  if (result > 0)
+  {
+    OSSL_PARAM params[3];
+    params[0] = OSSL_PARAM_construct_octet_string(OSSL_MAC_PARAM_KEY, hmacKey, sizeof(hmacKey));
+    params[1] = OSSL_PARAM_construct_utf8_string(OSSL_MAC_PARAM_DIGEST, const_cast<char*>("SHA256"), 0);
+    params[2] = OSSL_PARAM_construct_end();
+    if (!EVP_MAC_CTX_set_params(pMac, params))
+    {
+      result = -1;
+    }
+  }
+  OPENSSL_cleanse(hmacKey, sizeof(hmacKey));
+  return result;
+}
+
+#else
+
+static int ticket_key_callback(SSL* pSSL, unsigned char* name, unsigned char* iv, EVP_CIPHER_CTX* pCipher, HMAC_CTX* pHmac, int encrypt)
+{
+  TLSSessionCache* pCache = TLSSessionCache::fromContext(SSL_get_SSL_CTX(pSSL));
+  if (!pCache)
+  {
+    return 0;
+  }
+
+  unsigned char hmacKey[TLSSessionCache::TICKET_KEY_SIZE];
+  int result = pCache->handleTicketKey(name, iv, pCipher, hmacKey, encrypt);
+  if (result > 0 && !HMAC_Init_ex(pHmac, hmacKey, sizeof(hmacKey), EVP_sha256(), 0))
+  {
+    result = -1;
+  }
+  OPENSSL_cleanse(hmacKey, sizeof(hmacKey));
+  return result;
+}
+
+#endif
+
+static int new_session_callback(SSL* pSSL, SSL_SESSION* pSession)
+{
+  TLSSessionCache* pCache = TLSSessionCache::fromContext(SSL_get_SSL_CTX(pSSL));
+  if (!pCache)
+  {
+    return 0;
+  }
+  return pCache->handleNewClientSession(pSSL, pSession);
+}
+
+static bool is_session_expired(SSL_SESSION* pSession)
+{
+  return SSL_SESSION_get_time(pSession) + SSL_SESSION_get_timeout(pSession) < (long)std::time(0);
+}
+
+
+TLSSessionCache::TLSSessionCache() :
+  _ticketKeyLifetime(DEFAULT_TICKET_KEY_LIFETIME),
+  _clientCacheSize(DEFAULT_CLIENT_CACHE_SIZE),
+  _fullHandshakes(0),
+  _resumedHandshakes(0),
+  _failedHandshakes(0),
+  _rateWindowStart(OSS::getTime()),
+  _rateWindowCount(0),
+  _handshakeRate(0)
+{
+}
+
+TLSSessionCache::~TLSSessionCache()
+{
+  for (std::vector<SSL_CTX*>::iterator iter = _contexts.begin(); iter != _contexts.end(); iter++)
+  {
+    SSL_CTX_set_ex_data(*iter, context_index(), 0);
+  }
+
+  clearClientSessions();
+
+  for (TicketKeys::iterator iter = _ticketKeys.begin(); iter != _ticketKeys.end(); iter++)
+  {
+    OPENSSL_cleanse(&(*iter), sizeof(TicketKey));
+  }
+}
+
+TLSSessionCache* TLSSessionCache::fromContext(SSL_CTX* pContext)
+{
+  if (!pContext)
+  {
+    return 0;
+  }
+  return static_cast<TLSSessionCache*>(SSL_CTX_get_ex_data(pContext, context_index()));
+}
+
+bool TLSSessionCache::offerSessionForContext(SSL* pSSL, const std::string& destination)
+{
+  TLSSessionCache* pCache = fromContext(SSL_get_SSL_CTX(pSSL));
+  return pCache && pCache->offerSession(pSSL, destination);
+}
+
+void TLSSessionCache::recordHandshakeForContext(SSL* pSSL, bool success)
+{
+  TLSSessionCache* pCache = fromContext(SSL_get_SSL_CTX(pSSL));
+  if (pCache)
+  {
+    pCache->recordHandshake(pSSL, success);
+  }
+}
+
+void TLSSessionCache::attachServer(SSL_CTX* pContext,
+  const std::string& sessionIdContext,
+  std::size_t cacheSize,
+  long sessionTimeout,
+  bool enableTickets)
+{
+  if (std::find(_contexts.begin(), _contexts.end(), pContext) == _contexts.end())
+  {
+    _contexts.push_back(pContext);
+  }
+  SSL_CTX_set_ex_data(pContext, context_index(), this);
+
+  SSL_CTX_set_session_cache_mode(pContext, SSL_SESS_CACHE_SERVER);
+  SSL_CTX_sess_set_cache_size(pContext, (long)cacheSize);
+  SSL_CTX_set_timeout(pContext, sessionTimeout);
+
+  std::string id = sessionIdContext.substr(0, SSL_MAX_SID_CTX_LENGTH);
+  SSL_CTX_set_session_id_context(pContext, (const unsigned char*)id.data(), id.size());
+
+  if (enableTickets)
+  {
+    SSL_CTX_clear_options(pContext, SSL_OP_NO_TICKET);
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+    SSL_CTX_set_tlsext_ticket_key_evp_cb(pContext, ticket_key_callback);
+#else
+    SSL_CTX_set_tlsext_ticket_key_cb(pContext, ticket_key_callback);
+#endif
+  }
+  else
+  {
+    SSL_CTX_set_options(pContext, SSL_OP_NO_TICKET);
+  }
+
+  OSS_LOG_INFO("TLSSessionCache::attachServer - cache-size=" << cacheSize
+    << " timeout=" << sessionTimeout << " tickets=" << (enableTickets ? "enabled" : "disabled"));
+}
+
+void TLSSessionCache::attachClient(SSL_CTX* pContext, std::size_t cacheSize)
+{
+  if (std::find(_contexts.begin(), _contexts.end(), pContext) == _contexts.end())
+  {
+    _contexts.push_back(pContext);
+  }
+  SSL_CTX_set_ex_data(pContext, context_index(), this);
+
+  //
+  // OpenSSL hands us every new session through the callback.  Its own
+  // client cache is keyed by session id which is useless for picking a
+  // session by destination.
+  //
+  SSL_CTX_set_session_cache_mode(pContext, SSL_SESS_CACHE_CLIENT | SSL_SESS_CACHE_NO_INTERNAL_STORE);
+  SSL_CTX_sess_set_new_cb(pContext, new_session_callback);
+
+  OSS::mutex_critic_sec_lock lock(_clientMutex);
+  _clientCacheSize = cacheSize;
+}
+
+void TLSSessionCache::setTicketKeyLifetime(long seconds)
+{
+  OSS::mutex_critic_sec_lock lock(_ticketMutex);
+  _ticketKeyLifetime = seconds;
+}
+
+void TLSSessionCache::rotateTicketKey()
+{
+  OSS::mutex_critic_sec_lock lock(_ticketMutex);
+  rotateTicketKeyLocked(OSS::getTime() / 1000);
+}
+
+void TLSSessionCache::rotateTicketKeyLocked(OSS::UInt64 now)
+{
+  TicketKey key;
+  if (RAND_bytes(key.name, sizeof(key.name)) != 1 ||
+    RAND_bytes(key.aesKey, sizeof(key.aesKey)) != 1 ||
+    RAND_bytes(key.hmacKey, sizeof(key.hmacKey)) != 1)
+  {
+    OSS_LOG_ERROR("TLSSessionCache::rotateTicketKey - Unable to generate a new ticket key");
+    return;
+  }
+  key.created = now;
+
+  //
+  // Newest key first.  Only the previous key is kept for decryption.
+  //
+  _ticketKeys.insert(_ticketKeys.begin(), key);
+  while (_ticketKeys.size() > 2)
+  {
+    OPENSSL_cleanse(&_ticketKeys.back(), sizeof(TicketKey));
+    _ticketKeys.pop_back();
+  }
+  OPENSSL_cleanse(&key, sizeof(key));
+}
+
+int TLSSessionCache::handleTicketKey(unsigned char* name, unsigned char* iv, EVP_CIPHER_CTX* pCipher, unsigned char* hmacKey, int encrypt)
+{
+  OSS::mutex_critic_sec_lock lock(_ticketMutex);
+  OSS::UInt64 now = OSS::getTime() / 1000;
+
+  if (encrypt)
+  {
+    if (_ticketKeys.empty() || now - _ticketKeys.front().created >= (OSS::UInt64)_ticketKeyLifetime)
+    {
+      rotateTicketKeyLocked(now);
+      if (_ticketKeys.empty())
+      {
+        return 0;
+      }
+    }
+
+    const TicketKey& key = _ticketKeys.front();
+    if (RAND_bytes(iv, EVP_CIPHER_iv_length(EVP_aes_256_cbc())) != 1 ||
+      !EVP_EncryptInit_ex(pCipher, EVP_aes_256_cbc(), 0, key.aesKey, iv))
+    {
+      return -1;
+    }
+    std::memcpy(name, key.name, TICKET_KEY_NAME_SIZE);
+    std::memcpy(hmacKey, key.hmacKey, TICKET_KEY_SIZE);
+    return 1;
+  }
+
+  for (std::size_t i = 0; i < _ticketKeys.size(); i++)
+  {
+    const TicketKey& key = _ticketKeys[i];
+    if (std::memcmp(name, key.name, TICKET_KEY_NAME_SIZE) != 0)
+    {
+      continue;
+    }
+
+    if (!EVP_DecryptInit_ex(pCipher, EVP_aes_256_cbc(), 0, key.aesKey, iv))
+    {
+      return -1;
+    }
+    std::memcpy(hmacKey, key.hmacKey, TICKET_KEY_SIZE);
+
+    //
+    // 2 tells OpenSSL to accept the ticket and issue a new one under the
+    // current key
+    //
+    return i == 0 ? 1 : 2;
+  }
+
+  //
+  // Unknown or retired key.  Fall back to a full handshake.
+  //
+  return 0;
+}
+
+bool TLSSessionCache::offerSession(SSL* pSSL, const std::string& destination)
+{
+  std::string* pDestination = static_cast<std::string*>(SSL_get_ex_data(pSSL, destination_index()));
+  if (pDestination)
+  {
+    *pDestination = destination;
+  }
+  else
+  {
+    pDestination = new std::string(destination);
+    if (!SSL_set_ex_data(pSSL, destination_index(), pDestination))
+    {
+      delete pDestination;
+      return false;
+    }
+  }
+
+  OSS::mutex_critic_sec_lock lock(_clientMutex);
+  ClientSessions::iterator iter = _clientSessions.find(destination);
+  if (iter == _clientSessions.end())
+  {
+    return false;
+  }
+
+  if (is_session_expired(iter->second))
+  {
+    SSL_SESSION_free(iter->second);
+    _clientSessions.erase(iter);
+    return false;
+  }
+
+#if OPENSSL_VERSION_NUMBER >= 0x10101000L
+  //
+  // Offer a copy for the same reason handleNewClientSession() stores one.
+  // The connection may well end without a close_notify.
+  //
+  SSL_SESSION* pOffer = SSL_SESSION_dup(iter->second);
+  if (!pOffer)
+  {
+    return false;
+  }
+  bool offered = SSL_set_session(pSSL, pOffer) == 1;
+  SSL_SESSION_free(pOffer);
+  return offered;
+#else
+  return SSL_set_session(pSSL, iter->second) == 1;
+#endif
+}
+
+int TLSSessionCache::handleNewClientSession(SSL* pSSL, SSL_SESSION* pSession)
+{
+  std::string* pDestination = static_cast<std::string*>(SSL_get_ex_data(pSSL, destination_index()));
+  if (!pDestination || pDestination->empty())
+  {
+    return 0;
+  }
+
+#if OPENSSL_VERSION_NUMBER >= 0x10101000L
+  //
+  // Keep a private copy.  OpenSSL marks the session of a connection that
+  // is freed without a close_notify as not resumable which would spoil the
+  // cached entry as soon as the connection that produced it goes away.
+  //
+  SSL_SESSION* pCopy = SSL_SESSION_dup(pSession);
+  if (!pCopy)
+  {
+    return 0;
+  }
+  int taken = 0;
+#else
+  SSL_SESSION* pCopy = pSession;
+  int taken = 1;
+#endif
+
+  OSS::mutex_critic_sec_lock lock(_clientMutex);
+  ClientSessions::iterator iter = _clientSessions.find(*pDestination);
+  if (iter != _clientSessions.end())
+  {
+    SSL_SESSION_free(iter->second);
+    iter->second = pCopy;
+    return taken;
+  }
+
+  if (_clientSessions.size() >= _clientCacheSize)
+  {
+    purgeClientSessions();
+    if (_clientSessions.size() >= _clientCacheSize)
+    {
+      if (!taken)
+      {
+        SSL_SESSION_free(pCopy);
+      }
+      return 0;
+    }
+  }
+
+  //
+  // Returning 1 tells OpenSSL we kept the reference it passed to us
+  //
+  _clientSessions[*pDestination] = pCopy;
+  return taken;
+}
+
+void TLSSessionCache::purgeClientSessions()
+{
+  for (ClientSessions::iterator iter = _clientSessions.begin(); iter != _clientSessions.end();)
+  {
+    if (is_session_expired(iter->second))
+    {
+      SSL_SESSION_free(iter->second);
+      _clientSessions.erase(iter++);
+    }
+    else
+    {
+      ++iter;
+    }
+  }
+}
+
+void TLSSessionCache::removeClientSession(const std::string& destination)
+{
+  OSS::mutex_critic_sec_lock lock(_clientMutex);
+  ClientSessions::iterator iter = _clientSessions.find(destination);
+  if (iter != _clientSessions.end())
+  {
+    SSL_SESSION_free(iter->second);
+    _clientSessions.erase(iter);
+  }
+}
+
+void TLSSessionCache::clearClientSessions()
+{
+  OSS::mutex_critic_sec_lock lock(_clientMutex);
+  for (ClientSessions::iterator iter = _clientSessions.begin(); iter != _clientSessions.end(); iter++)
+  {
+    SSL_SESSION_free(iter->second);
+  }
+  _clientSessions.clear();
+}
+
+std::size_t TLSSessionCache::getClientSessionCount() const
+{
+  OSS::mutex_critic_sec_lock lock(_clientMutex);
+  return _clientSessions.size();
+}
+
+void TLSSessionCache::recordHandshake(SSL* pSSL, bool success)
+{
+  if (!success)
+  {
+    if (!SSL_is_server(pSSL))
+    {
+      //
+      // Don't keep offering a session the peer may be choking on
+      //
+      std::string* pDestination = static_cast<std::string*>(SSL_get_ex_data(pSSL, destination_index()));
+      if (pDestination)
+      {
+        removeClientSession(*pDestination);
+      }
+    }
+
+    OSS::mutex_critic_sec_lock lock(_statsMutex);
+    _failedHandshakes++;
+    return;
+  }
+
+  bool resumed = SSL_session_reused(pSSL) == 1;
+
+  OSS::mutex_critic_sec_lock lock(_statsMutex);
+  if (resumed)
+  {
+    _resumedHandshakes++;
+  }
+  else
+  {
+    _fullHandshakes++;
+  }
+  _rateWindowCount++;
+  sampleRate(OSS::getTime());
+}
+
+void TLSSessionCache::sampleRate(OSS::UInt64 now)
+{
+  OSS::UInt64 elapsed = now - _rateWindowStart;
+  if (elapsed >= 1000)
+  {
+    _handshakeRate = (double)_rateWindowCount * 1000.0 / (double)elapsed;
+    _rateWindowStart = now;
+    _rateWindowCount = 0;
+  }
+}
+
+TLSSessionCache::Stats TLSSessionCache::getStats()
+{
+  OSS::mutex_critic_sec_lock lock(_statsMutex);
+  sampleRate(OSS::getTime());
+
+  Stats stats;
+  stats.fullHandshakes = _fullHandshakes;
+  stats.resumedHandshakes = _resumedHandshakes;
+  stats.failedHandshakes = _failedHandshakes;
+  stats.handshakeRate = _handshakeRate;
+  OSS::UInt64 completed = _fullHandshakes + _resumedHandshakes;
+  stats.resumptionRatio = completed ? (double)_resumedHandshakes / (double)completed : 0;
+  return stats;
+}
+
+
+} } // OSS::Net
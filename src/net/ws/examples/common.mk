@@ -17,3 +17,6 @@ else
 	LDFLAGS := $(LDFLAGS) ../../libwebsocketpp.a
 	LDFLAGS := $(LDFLAGS) $(BOOST_LIBS:%=$(BOOST_LIB_PATH)/lib%.a)
 endif
+
+# permessage-deflate
+LDFLAGS := $(LDFLAGS) -lz
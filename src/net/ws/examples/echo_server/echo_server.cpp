@@ -33,15 +33,30 @@ using websocketpp::server;
 
 class echo_server_handler : public server::handler {
 public:
+    echo_server_handler(bool deflate) {
+        m_deflate.enabled = deflate;
+    }
+    
+    void validate(connection_ptr con) {
+        con->set_permessage_deflate(m_deflate);
+    }
+    
     void on_message(connection_ptr con, message_ptr msg) {
         con->send(msg->get_payload(),msg->get_opcode());
     }
+private:
+    websocketpp::processor::deflate_config m_deflate;
 };
 
 int main(int argc, char* argv[]) {
     unsigned short port = 9002;
-        
-    if (argc == 2) {
+    bool deflate = false;
+    
+    if (argc == 3) {
+        deflate = (std::string(argv[2]) == "deflate");
+    }
+    
+    if (argc >= 2) {
         port = atoi(argv[1]);
         
         if (port == 0) {
@@ -51,7 +66,7 @@ int main(int argc, char* argv[]) {
     }
     
     try {       
-        server::handler::ptr h(new echo_server_handler());
+        server::handler::ptr h(new echo_server_handler(deflate));
         server echo_endpoint(h);
         
         echo_endpoint.alog().unset_level(websocketpp::log::alevel::ALL);
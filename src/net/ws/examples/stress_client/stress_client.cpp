@@ -32,6 +32,7 @@
 #include <boost/thread.hpp>
 
 #include <iostream>
+#include <map>
 
 // PLATFORM SPECIFIC STUFF
 #include <unistd.h>
@@ -144,6 +145,224 @@ private:
     boost::shared_ptr<boost::asio::deadline_timer>  m_timer;
 };
 
+// SIP over WebSocket benchmark
+//
+// Every connection keeps `window` WebRTC INVITEs in flight against an echo
+// server (examples/echo_server or a SIP listener that reflects messages) and
+// sends the next one as each echo arrives. When all connections are done
+// the throughput and the bytes that actually crossed the socket are printed
+// so runs with and without permessage-deflate can be compared.
+class sip_bench_handler : public plain_endpoint_type::handler {
+public:
+    typedef sip_bench_handler type;
+    typedef plain_endpoint_type::connection_ptr connection_ptr;
+    
+    sip_bench_handler(int num_connections, int messages, int window)
+     : m_connections_max(num_connections),
+       m_messages(messages),
+       m_window(window),
+       m_done(0),
+       m_received(0),
+       m_payload_bytes(0),
+       m_wire_sent(0),
+       m_wire_received(0),
+       m_frames_sent(0),
+       m_write_batches(0) {}
+    
+    void on_open(connection_ptr connection) {
+        boost::lock_guard<boost::mutex> lock(m_lock);
+        
+        if (m_sent.empty()) {
+            m_start_time = boost::posix_time::microsec_clock::local_time();
+        }
+        m_sent[connection] = 0;
+        
+        for (int i = 0; i < m_window && m_sent[connection] < m_messages; i++) {
+            send_invite(connection);
+        }
+    }
+    
+    void on_message(connection_ptr connection, websocketpp::message::data::ptr msg) {
+        boost::lock_guard<boost::mutex> lock(m_lock);
+        
+        m_received++;
+        m_payload_bytes += msg->get_payload().size();
+        
+        int& received = m_echoed[connection];
+        received++;
+        
+        if (m_sent[connection] < m_messages) {
+            send_invite(connection);
+        } else if (received == m_messages) {
+            m_wire_sent += connection->get_wire_bytes_sent();
+            m_wire_received += connection->get_wire_bytes_received();
+            m_frames_sent += connection->get_frames_sent();
+            m_write_batches += connection->get_write_batches();
+            
+            if (++m_done == m_connections_max) {
+                report();
+                connection->get_io_service().stop();
+            }
+        }
+    }
+    
+    void on_fail(connection_ptr connection) {
+        std::cout << "connection failed" << std::endl;
+    }
+private:
+    void send_invite(connection_ptr connection) {
+        int seq = m_sent[connection]++;
+        
+        std::stringstream branch;
+        branch << std::hex << reinterpret_cast<size_t>(connection.get()) << "." << seq;
+        
+        std::string sip = 
+            "INVITE sip:bob@example.com SIP/2.0\r\n"
+            "Via: SIP/2.0/WSS df7jal23ls0d.invalid;branch=z9hG4bK" + branch.str() + ";rport\r\n"
+            "Max-Forwards: 70\r\n"
+            "To: <sip:bob@example.com>\r\n"
+            "From: \"Alice\" <sip:alice@example.com>;tag=" + branch.str() + "\r\n"
+            "Call-ID: " + branch.str() + "@df7jal23ls0d.invalid\r\n"
+            "CSeq: 1 INVITE\r\n"
+            "Contact: <sip:alice@df7jal23ls0d.invalid;transport=ws;ob>\r\n"
+            "Allow: INVITE,ACK,CANCEL,BYE,UPDATE,MESSAGE,OPTIONS,REFER,INFO\r\n"
+            "Supported: ice,replaces,outbound\r\n"
+            "User-Agent: stress_client\r\n"
+            "Content-Type: application/sdp\r\n"
+            "\r\n"
+            "v=0\r\n"
+            "o=- 4611731400430051336 2 IN IP4 127.0.0.1\r\n"
+            "s=-\r\n"
+            "t=0 0\r\n"
+            "a=group:BUNDLE 0 1\r\n"
+            "a=msid-semantic: WMS stream\r\n"
+            "m=audio 9 UDP/TLS/RTP/SAVPF 111 103 104 9 0 8 106 105 13 110 112 113 126\r\n"
+            "c=IN IP4 0.0.0.0\r\n"
+            "a=rtcp:9 IN IP4 0.0.0.0\r\n"
+            "a=candidate:842163049 1 udp 1677729535 203.0.113.10 53962 typ srflx raddr 192.168.1.10 rport 53962 generation 0\r\n"
+            "a=candidate:3098175849 1 udp 2122260223 192.168.1.10 53962 typ host generation 0\r\n"
+            "a=candidate:4233069003 1 tcp 1518280447 192.168.1.10 9 typ host tcptype active generation 0\r\n"
+            "a=candidate:1509957375 1 udp 25108223 198.51.100.20 61012 typ relay raddr 203.0.113.10 rport 53962 generation 0\r\n"
+            "a=ice-ufrag:Xo3t\r\n"
+            "a=ice-pwd:FtcbBaLZQ1mXhxFhtTzr6M2c\r\n"
+            "a=ice-options:trickle\r\n"
+            "a=fingerprint:sha-256 6B:8B:F0:65:5F:78:E2:51:3B:AC:6F:F3:3F:46:1B:35:DC:B8:5F:64:1A:24:C2:43:F0:A1:58:D0:A1:2C:19:08\r\n"
+            "a=setup:actpass\r\n"
+            "a=mid:0\r\n"
+            "a=extmap:1 urn:ietf:params:rtp-hdrext:ssrc-audio-level\r\n"
+            "a=sendrecv\r\n"
+            "a=rtcp-mux\r\n"
+            "a=rtpmap:111 opus/48000/2\r\n"
+            "a=rtcp-fb:111 transport-cc\r\n"
+            "a=fmtp:111 minptime=10;useinbandfec=1\r\n"
+            "a=rtpmap:103 ISAC/16000\r\n"
+            "a=rtpmap:104 ISAC/32000\r\n"
+            "a=rtpmap:9 G722/8000\r\n"
+            "a=rtpmap:0 PCMU/8000\r\n"
+            "a=rtpmap:8 PCMA/8000\r\n"
+            "a=rtpmap:106 CN/32000\r\n"
+            "a=rtpmap:105 CN/16000\r\n"
+            "a=rtpmap:13 CN/8000\r\n"
+            "a=rtpmap:126 telephone-event/8000\r\n"
+            "a=ssrc:1001 cname:4TOk42mSjXCkVIa6\r\n"
+            "a=ssrc:1001 msid:stream audio0\r\n"
+            "m=video 9 UDP/TLS/RTP/SAVPF 96 97 98 99 100\r\n"
+            "c=IN IP4 0.0.0.0\r\n"
+            "a=rtcp:9 IN IP4 0.0.0.0\r\n"
+            "a=candidate:842163049 1 udp 1677729535 203.0.113.10 53962 typ srflx raddr 192.168.1.10 rport 53962 generation 0\r\n"
+            "a=candidate:3098175849 1 udp 2122260223 192.168.1.10 53962 typ host generation 0\r\n"
+            "a=ice-ufrag:Xo3t\r\n"
+            "a=ice-pwd:FtcbBaLZQ1mXhxFhtTzr6M2c\r\n"
+            "a=fingerprint:sha-256 6B:8B:F0:65:5F:78:E2:51:3B:AC:6F:F3:3F:46:1B:35:DC:B8:5F:64:1A:24:C2:43:F0:A1:58:D0:A1:2C:19:08\r\n"
+            "a=setup:actpass\r\n"
+            "a=mid:1\r\n"
+            "a=sendrecv\r\n"
+            "a=rtcp-mux\r\n"
+            "a=rtpmap:96 VP8/90000\r\n"
+            "a=rtcp-fb:96 ccm fir\r\n"
+            "a=rtcp-fb:96 nack\r\n"
+            "a=rtcp-fb:96 nack pli\r\n"
+            "a=rtcp-fb:96 goog-remb\r\n"
+            "a=rtpmap:97 rtx/90000\r\n"
+            "a=fmtp:97 apt=96\r\n"
+            "a=ssrc:2002 cname:4TOk42mSjXCkVIa6\r\n"
+            "a=ssrc:2002 msid:stream video0\r\n";
+        
+        connection->send(sip, websocketpp::frame::opcode::TEXT);
+    }
+    
+    void report() {
+        boost::posix_time::ptime now = boost::posix_time::microsec_clock::local_time();
+        double seconds = boost::posix_time::time_period(m_start_time,now).length().total_microseconds() / 1000000.0;
+        
+        std::cout << "connections:        " << m_connections_max << std::endl;
+        std::cout << "messages echoed:    " << m_received << std::endl;
+        std::cout << "elapsed:            " << seconds << "s" << std::endl;
+        std::cout << "messages/s:         " << m_received / seconds << std::endl;
+        std::cout << "payload bytes:      " << m_payload_bytes << std::endl;
+        std::cout << "wire bytes sent:    " << m_wire_sent << std::endl;
+        std::cout << "wire bytes recv:    " << m_wire_received << std::endl;
+        std::cout << "wire/payload ratio: " << (m_wire_sent + m_wire_received) / (2.0 * m_payload_bytes) << std::endl;
+        std::cout << "frames per write:   " << m_frames_sent / std::max(1.0, double(m_write_batches)) << std::endl;
+    }
+    
+    int                                 m_connections_max;
+    int                                 m_messages;
+    int                                 m_window;
+    int                                 m_done;
+    uint64_t                            m_received;
+    uint64_t                            m_payload_bytes;
+    uint64_t                            m_wire_sent;
+    uint64_t                            m_wire_received;
+    uint64_t                            m_frames_sent;
+    uint64_t                            m_write_batches;
+    std::map<connection_ptr,int>        m_sent;
+    std::map<connection_ptr,int>        m_echoed;
+    boost::posix_time::ptime            m_start_time;
+    boost::mutex                        m_lock;
+};
+
+int run_sip_bench(int argc, char* argv[]) {
+    if (argc < 5) {
+        std::cout << "Usage: `stress_client sip test_url num_connections messages_per_connection [window] [deflate]`" << std::endl;
+        return 1;
+    }
+    
+    std::string uri = argv[2];
+    int num_connections = atoi(argv[3]);
+    int messages = atoi(argv[4]);
+    int window = argc > 5 ? atoi(argv[5]) : 8;
+    
+    websocketpp::processor::deflate_config deflate;
+    deflate.enabled = argc > 6 && std::string(argv[6]) == "deflate";
+    
+    try {
+        plain_handler_ptr handler(new sip_bench_handler(num_connections, messages, window));
+        plain_endpoint_type endpoint(handler);
+        
+        endpoint.alog().unset_level(websocketpp::log::alevel::ALL);
+        endpoint.elog().set_level(websocketpp::log::elevel::RERROR);
+        
+        std::cout << "sending " << messages << " INVITEs on each of " 
+                  << num_connections << " connections to " << uri 
+                  << " window " << window 
+                  << (deflate.enabled ? " with" : " without") 
+                  << " permessage-deflate" << std::endl;
+        
+        for (int i = 0; i < num_connections; i++) {
+            connection_ptr con = endpoint.get_connection(uri);
+            con->set_permessage_deflate(deflate);
+            endpoint.connect(con);
+        }
+        
+        endpoint.run();
+    } catch (std::exception& e) {
+        std::cerr << "Exception: " << e.what() << std::endl;
+        return 1;
+    }
+    
+    return 0;
+}
 
 int main(int argc, char* argv[]) {
     std::string uri = "ws://localhost:9002/";
@@ -151,6 +370,10 @@ int main(int argc, char* argv[]) {
     int batch_size = 25;
     int delay_ms = 16;
 
+    if (argc > 1 && std::string(argv[1]) == "sip") {
+        return run_sip_bench(argc, argv);
+    }
+    
     if (argc > 1) {
         if (argc != 5) {
             std::cout << "Usage: `echo_client test_url num_connections batch_size delay_ms`" << std::endl;
@@ -99,6 +99,11 @@ public:
         INTURRUPT = 2
     };
     
+    enum {
+        MAX_WRITE_BATCH = 64,           // frames per gather write
+        MAX_WRITE_BATCH_BYTES = 262144  // soft byte limit per gather write
+    };
+    
     enum read_state {
         READING = 0,
         WAITING = 1
@@ -117,7 +122,13 @@ public:
      , m_state(session::state::CONNECTING)
      , m_protocol_error(false)
      , m_write_buffer(0)
+     , m_write_batch(0)
      , m_write_state(IDLE)
+     , m_wire_bytes_sent(0)
+     , m_wire_bytes_received(0)
+     , m_frames_sent(0)
+     , m_write_batches(0)
+     , m_read_carry(0)
      , m_fail_code(fail::status::GOOD)
      , m_local_close_code(close::status::ABNORMAL_CLOSE)
      , m_remote_close_code(close::status::ABNORMAL_CLOSE)
@@ -332,6 +343,32 @@ public:
         return m_write_buffer;
     }
     
+    /// Wire statistics
+    /**
+     * Bytes and frames as they went over the socket, i.e. after framing and
+     * compression. Used by benchmarks to compare the cost of a workload.
+     * 
+     * Visibility: public
+     * State: Valid from any state.
+     * Concurrency: callable from any thread
+     */
+    uint64_t get_wire_bytes_sent() const {
+        boost::lock_guard<boost::recursive_mutex> lock(m_lock);
+        return m_wire_bytes_sent;
+    }
+    uint64_t get_wire_bytes_received() const {
+        boost::lock_guard<boost::recursive_mutex> lock(m_lock);
+        return m_wire_bytes_received;
+    }
+    uint64_t get_frames_sent() const {
+        boost::lock_guard<boost::recursive_mutex> lock(m_lock);
+        return m_frames_sent;
+    }
+    uint64_t get_write_batches() const {
+        boost::lock_guard<boost::recursive_mutex> lock(m_lock);
+        return m_write_batches;
+    }
+    
     /// Get library fail code
     /**
      * Returns the internal WS++ fail code. This code starts at a value of
@@ -833,6 +870,9 @@ public:
             }
         }
         
+        // bytes left over from the previous read were already counted
+        m_wire_bytes_received += m_buf.size() - m_read_carry;
+        
         // process data from the buffer just read into
         std::istream s(&m_buf);
                 
@@ -881,6 +921,7 @@ public:
                         // client. We exit the read loop. handle_read_frame
                         // will be restarted by recycle()
                         //m_read_state = WAITING;
+                        m_read_carry = m_buf.size();
                         m_endpoint.wait(type::shared_from_this());
                         return;
                     default:
@@ -895,6 +936,8 @@ public:
             }
         }
         
+        m_read_carry = m_buf.size();
+        
         // try and read more
         if (m_state != session::state::CLOSED && 
             m_processor->get_bytes_needed() > 0 && 
@@ -1171,7 +1214,7 @@ public:
         if (m_write_state == INTURRUPT) {return;}
         
         m_write_buffer += msg->get_payload().size();
-        m_write_queue.push(msg);
+        m_write_queue.push_back(msg);
         
         write();
     }
@@ -1194,7 +1237,7 @@ public:
                 // clear the queue except for the last message
                 while (m_write_queue.size() > 1) {
                     m_write_buffer -= m_write_queue.front()->get_payload().size();
-                    m_write_queue.pop();
+                    m_write_queue.pop_front();
                 }
                 break;
             default:
@@ -1206,11 +1249,33 @@ public:
             if (m_write_state == IDLE) {
                 m_write_state = WRITING;
             }
-                        
-            m_write_buf.push_back(boost::asio::buffer(m_write_queue.front()->get_header()));
-            m_write_buf.push_back(boost::asio::buffer(m_write_queue.front()->get_payload()));
             
-            //m_endpoint.alog().at(log::alevel::DEVEL) << "write header: " << zsutil::to_hex(m_write_queue.front()->get_header()) << log::endl;
+            // Gather every queued frame, up to a limit, into one gather
+            // write. Under load this turns a syscall per frame into a
+            // syscall per batch. A close frame always ends the batch since
+            // nothing may follow it on the wire.
+            size_t batch_bytes = 0;
+            
+            m_write_batch = 0;
+            while (m_write_batch < m_write_queue.size() &&
+                   m_write_batch < MAX_WRITE_BATCH &&
+                   (m_write_batch == 0 || batch_bytes < MAX_WRITE_BATCH_BYTES))
+            {
+                const message::data_ptr& msg = m_write_queue[m_write_batch];
+                
+                m_write_buf.push_back(boost::asio::buffer(msg->get_header()));
+                m_write_buf.push_back(boost::asio::buffer(msg->get_payload()));
+                batch_bytes += msg->get_header().size() + msg->get_payload().size();
+                m_write_batch++;
+                
+                if (msg->get_opcode() == frame::opcode::CLOSE) {
+                    break;
+                }
+            }
+            
+            m_wire_bytes_sent += batch_bytes;
+            m_frames_sent += m_write_batch;
+            m_write_batches++;
             
             boost::asio::async_write(
                 socket_type::get_socket(),
@@ -1273,12 +1338,17 @@ public:
             return;
         }
         
-        m_write_buffer -= m_write_queue.front()->get_payload().size();
-        m_write_buf.clear();
-        
-        frame::opcode::value code = m_write_queue.front()->get_opcode();
+        // retire every frame of the batch that was just written
+        frame::opcode::value code = frame::opcode::CONTINUATION;
         
-        m_write_queue.pop();
+        while (m_write_batch > 0 && !m_write_queue.empty()) {
+            m_write_buffer -= m_write_queue.front()->get_payload().size();
+            code = m_write_queue.front()->get_opcode();
+            m_write_queue.pop_front();
+            m_write_batch--;
+        }
+        m_write_batch = 0;
+        m_write_buf.clear();
         
         if (m_write_state == WRITING) {
             m_write_state = IDLE;
@@ -1499,10 +1569,18 @@ public:
     
     // Write queue
     std::vector<boost::asio::const_buffer> m_write_buf;
-    std::queue<message::data_ptr>   m_write_queue;
+    std::deque<message::data_ptr>   m_write_queue;
     uint64_t                        m_write_buffer;
+    size_t                          m_write_batch;      // frames in flight
     write_state                     m_write_state;
     
+    // Wire statistics
+    uint64_t                        m_wire_bytes_sent;
+    uint64_t                        m_wire_bytes_received;
+    uint64_t                        m_frames_sent;
+    uint64_t                        m_write_batches;
+    size_t                          m_read_carry;       // unread bytes in m_buf
+    
     // Close state
     fail::status::value         m_fail_code;
     boost::system::error_code   m_fail_system;
@@ -191,6 +191,9 @@ public:
     // http://www.open-std.org/jtc1/sc22/wg21/docs/papers/2012/n3334.html
     void set_payload(const void *payload, size_t length);
     void append_payload(const std::string& payload);
+    // Exchange the payload with buffer without copying. Used to move
+    // compressed and decompressed payloads in and out of reusable buffers.
+    void swap_payload(std::string& buffer);
     
     void set_header(const std::string& header);
     
@@ -114,11 +114,38 @@ class hybi : public processor_base {
 public:
     hybi(connection_type &connection) 
      : m_connection(connection),
+       m_compressed(false),
+       m_message_opcode(frame::opcode::BINARY),
        m_write_frame(connection)
     {
         reset();
     }       
     
+    bool negotiate_deflate(const std::vector<std::string>& offers,
+                           const deflate_config& config,
+                           std::string& response)
+    {
+        if (!m_deflate.negotiate(offers, config, response)) {
+            return false;
+        }
+        m_header.set_allow_rsv1(true);
+        m_write_header.set_allow_rsv1(true);
+        return true;
+    }
+    
+    std::string offer_deflate(const deflate_config& config) {
+        return m_deflate.offer(config);
+    }
+    
+    bool accept_deflate(const std::string& response) {
+        if (!m_deflate.accept(response)) {
+            return false;
+        }
+        m_header.set_allow_rsv1(true);
+        m_write_header.set_allow_rsv1(true);
+        return true;
+    }
+    
     void validate_handshake(const http::parser::request& request) const {
         std::stringstream err;
         std::string h;
@@ -348,12 +375,19 @@ public:
                                            processor::error::OUT_OF_MESSAGES);
             }
             
-            m_data_message->reset(m_header.get_opcode());
+            // A compressed message is collected as binary so the UTF8 check
+            // runs on the inflated payload instead of the deflate stream.
+            m_compressed = m_header.get_rsv1();
+            m_message_opcode = m_header.get_opcode();
+            m_data_message->reset(m_compressed ? frame::opcode::BINARY : m_message_opcode);
         } else {
             // A message has already been started. Continuation frames only!
             if (m_header.get_opcode() != frame::opcode::CONTINUATION) {
                 throw processor::exception("Received new message before the completion of the existing one.",processor::error::PROTOCOL_VIOLATION);
             }
+            if (m_header.get_rsv1()) {
+                throw processor::exception("RSV1 set on a continuation frame",processor::error::PROTOCOL_VIOLATION);
+            }
         }
         
         m_payload_left = static_cast<size_t>(m_header.get_payload_size());
@@ -406,6 +440,8 @@ public:
         if (m_header.get_fin()) {
             if (m_header.is_control()) {
                 m_control_message->complete();
+            } else if (m_compressed) {
+                inflate_message();
             } else {
                 m_data_message->complete();
             }
@@ -415,6 +451,23 @@ public:
         }
     }
     
+    // Replace the compressed payload of the completed data message with the
+    // inflated one. The two buffers trade places so neither is freed.
+    void inflate_message() {
+        m_deflate.decompress(m_data_message->get_payload(), m_inflate_buffer);
+        
+        m_data_message->reset(m_message_opcode);
+        m_data_message->swap_payload(m_inflate_buffer);
+        m_compressed = false;
+        
+        try {
+            m_data_message->validate_payload();
+        } catch (const websocketpp::exception&) {
+            throw processor::exception("Invalid UTF8 data",
+                                       processor::error::PAYLOAD_VIOLATION);
+        }
+    }
+    
     bool ready() const {
         return m_state == hybi_state::READY;
     }
@@ -562,11 +615,25 @@ public:
         
         msg->validate_payload();
         
+        // Compression has to happen here, under the connection lock that
+        // also orders the write queue, because with context takeover the
+        // peer inflates messages in the order we deflated them.
+        bool compressed = false;
+        if (m_deflate.is_active() &&
+            !frame::opcode::is_control(msg->get_opcode()) &&
+            msg->get_payload().size() >= m_deflate.get_min_size() &&
+            m_deflate.compress(msg->get_payload(), m_deflate_buffer))
+        {
+            msg->swap_payload(m_deflate_buffer);
+            compressed = true;
+        }
+        
         bool masked = !m_connection.is_server();
         int32_t key = m_connection.rand();
         
         m_write_header.reset();
         m_write_header.set_fin(true);
+        m_write_header.set_rsv1(compressed);
         m_write_header.set_opcode(msg->get_opcode());
         m_write_header.set_masked(masked,key);
         m_write_header.set_payload_size(msg->get_payload().size());
@@ -618,6 +685,14 @@ private:
     
     char                    m_payload_buffer[PAYLOAD_BUFFER_SIZE];
     
+    // permessage-deflate state. The buffers are swapped with message
+    // payloads and keep their capacity for the life of the connection.
+    permessage_deflate      m_deflate;
+    bool                    m_compressed;
+    frame::opcode::value    m_message_opcode;
+    std::string             m_deflate_buffer;
+    std::string             m_inflate_buffer;
+    
     frame::parser<connection_type>  m_write_frame; // TODO: refactor this out
 };  
 
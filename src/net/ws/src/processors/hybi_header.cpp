@@ -31,7 +31,7 @@
 
 using websocketpp::processor::hybi_header;
 
-hybi_header::hybi_header() {
+hybi_header::hybi_header() : m_allow_rsv1(false) {
     reset();
 }
 void hybi_header::reset() {
@@ -89,6 +89,9 @@ bool hybi_header::ready() const {
 void hybi_header::set_fin(bool fin) {
     set_header_bit(BPB0_FIN,0,fin);
 }
+void hybi_header::set_allow_rsv1(bool b) {
+    m_allow_rsv1 = b;
+}
 void hybi_header::set_rsv1(bool b) {
     set_header_bit(BPB0_RSV1,0,b);
 }
@@ -223,8 +226,11 @@ void hybi_header::validate_basic_header() const {
         throw processor::exception("Control Frame is too large",processor::error::PROTOCOL_VIOLATION);
     }
     
-    // check for reserved bits
-    if (get_rsv1() || get_rsv2() || get_rsv3()) {
+    // check for reserved bits. RSV1 marks a compressed message once
+    // permessage-deflate has been negotiated, and only on data frames.
+    if ((get_rsv1() && (!m_allow_rsv1 || is_control())) ||
+        get_rsv2() || get_rsv3())
+    {
         throw processor::exception("Reserved bit used",processor::error::PROTOCOL_VIOLATION);
     }
     
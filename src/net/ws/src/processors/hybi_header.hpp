@@ -60,6 +60,8 @@ public:
     hybi_header();
     /// Reset a header processor for writing
     void reset();
+    /// Accept RSV1 on data frames (permessage-deflate). Survives reset().
+    void set_allow_rsv1(bool b);
     
     // Writing interface (parse a byte stream)
     // valid only if ready() returns false
@@ -135,6 +137,7 @@ private:
     static const uint8_t STATE_READY = 3;
     static const uint8_t STATE_WRITE = 4;
     
+    bool        m_allow_rsv1;
     uint8_t     m_state;
     std::streamsize m_bytes_needed;
     uint64_t    m_payload_size;
@@ -0,0 +1,358 @@
+// Library: OSS_CORE - Foundation API for SIP B2BUA
+// Copyright (c) OSS Software Solutions
+// Contributor: Joegen Baclor - mailto:joegen@ossapp.com
+//
+// Permission is hereby granted, to any person or organization
+// obtaining a copy of the software and accompanying documentation covered by
+// this license (the "Software") to use, execute, and to prepare
+// derivative works of the Software, all subject to the
+// "GNU Lesser General Public License (LGPL)".
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+// SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+// FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+
+#include "permessage_deflate.hpp"
+#include "processor.hpp"
+
+#include <boost/algorithm/string.hpp>
+#include <boost/lexical_cast.hpp>
+
+#include <zlib.h>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+namespace websocketpp {
+namespace processor {
+
+const size_t permessage_deflate::MAX_INFLATED_SIZE;
+
+namespace {
+    const char EXTENSION_NAME[] = "permessage-deflate";
+
+    // Every message compressed with Z_SYNC_FLUSH ends with an empty stored
+    // block.  RFC 7692 strips it on the wire and the receiver adds it back.
+    const unsigned char SYNC_TAIL[4] = {0x00, 0x00, 0xff, 0xff};
+
+    // zlib refuses raw deflate windows of 8 bits
+    const int MIN_WINDOW_BITS = 9;
+    const int MAX_WINDOW_BITS = 15;
+
+    const size_t OUTPUT_CHUNK = 4096;
+
+    bool parse_window_bits(const std::string& value, int& bits) {
+        if (value.empty() || value.size() > 2 ||
+            value.find_first_not_of("0123456789") != std::string::npos)
+        {
+            return false;
+        }
+        bits = atoi(value.c_str());
+        return bits >= 8 && bits <= MAX_WINDOW_BITS;
+    }
+}
+
+permessage_deflate::permessage_deflate()
+ : m_active(false),
+   m_deflate_reset(false),
+   m_deflate(NULL),
+   m_inflate(NULL),
+   m_bytes_in(0),
+   m_bytes_out(0) {}
+
+permessage_deflate::~permessage_deflate() {
+    release_streams();
+}
+
+void permessage_deflate::parse_header(const std::string& value,
+                                      std::vector<std::string>& offers)
+{
+    std::vector<std::string> tokens;
+    boost::split(tokens, value, boost::is_any_of(","));
+
+    for (size_t i = 0; i < tokens.size(); i++) {
+        std::string offer = boost::trim_copy(tokens[i]);
+        if (!offer.empty()) {
+            offers.push_back(offer);
+        }
+    }
+}
+
+bool permessage_deflate::parse_params(const std::string& extension, params& p) {
+    std::vector<std::string> tokens;
+    boost::split(tokens, extension, boost::is_any_of(";"));
+
+    if (tokens.empty() ||
+        !boost::iequals(boost::trim_copy(tokens[0]), EXTENSION_NAME))
+    {
+        return false;
+    }
+
+    for (size_t i = 1; i < tokens.size(); i++) {
+        std::string name = boost::trim_copy(tokens[i]);
+        std::string value;
+        bool has_value = false;
+
+        size_t eq = name.find('=');
+        if (eq != std::string::npos) {
+            value = boost::trim_copy(name.substr(eq + 1));
+            boost::trim_if(value, boost::is_any_of("\""));
+            name = boost::trim_copy(name.substr(0, eq));
+            has_value = true;
+        }
+
+        if (name == "server_no_context_takeover" && !has_value) {
+            p.server_no_context_takeover = true;
+        } else if (name == "client_no_context_takeover" && !has_value) {
+            p.client_no_context_takeover = true;
+        } else if (name == "server_max_window_bits" && has_value) {
+            if (!parse_window_bits(value, p.server_max_window_bits)) {
+                return false;
+            }
+        } else if (name == "client_max_window_bits") {
+            // Without a value this only says the client supports the
+            // parameter. It does not limit anything.
+            if (has_value && !parse_window_bits(value, p.client_max_window_bits)) {
+                return false;
+            }
+        } else {
+            // Unknown or malformed parameters invalidate the whole offer
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool permessage_deflate::negotiate(const std::vector<std::string>& offers,
+                                   const deflate_config& config,
+                                   std::string& response)
+{
+    if (!config.enabled) {
+        return false;
+    }
+
+    for (size_t i = 0; i < offers.size(); i++) {
+        params p;
+
+        if (!parse_params(offers[i], p)) {
+            continue;
+        }
+
+        // We can not honour a client that asks us to compress with a window
+        // zlib does not support.  Try its next offer instead.
+        if (p.server_max_window_bits < MIN_WINDOW_BITS) {
+            continue;
+        }
+
+        m_config = config;
+
+        bool server_reset = p.server_no_context_takeover || !config.context_takeover;
+
+        if (!init_streams(p.server_max_window_bits, server_reset)) {
+            return false;
+        }
+
+        response = EXTENSION_NAME;
+        if (server_reset) {
+            response += "; server_no_context_takeover";
+        }
+        if (p.client_no_context_takeover) {
+            response += "; client_no_context_takeover";
+        }
+        if (p.server_max_window_bits != MAX_WINDOW_BITS) {
+            response += "; server_max_window_bits=";
+            response += boost::lexical_cast<std::string>(p.server_max_window_bits);
+        }
+
+        return true;
+    }
+
+    return false;
+}
+
+std::string permessage_deflate::offer(const deflate_config& config) {
+    m_config = config;
+
+    if (!config.enabled) {
+        return "";
+    }
+
+    std::string value = EXTENSION_NAME;
+    value += "; client_max_window_bits";
+    if (!config.context_takeover) {
+        value += "; client_no_context_takeover";
+    }
+    return value;
+}
+
+bool permessage_deflate::accept(const std::string& response) {
+    params p;
+
+    if (!m_config.enabled || !parse_params(response, p)) {
+        return false;
+    }
+
+    if (p.client_max_window_bits < MIN_WINDOW_BITS) {
+        return false;
+    }
+
+    return init_streams(p.client_max_window_bits,
+                        p.client_no_context_takeover || !m_config.context_takeover);
+}
+
+bool permessage_deflate::init_streams(int deflate_bits, bool deflate_reset) {
+    release_streams();
+
+    z_stream* d = new z_stream();
+    z_stream* i = new z_stream();
+
+    // Negative window bits select a raw deflate stream without zlib header
+    // and checksum
+    if (deflateInit2(d, m_config.level, Z_DEFLATED, -deflate_bits,
+                     m_config.mem_level, Z_DEFAULT_STRATEGY) != Z_OK)
+    {
+        delete d;
+        delete i;
+        return false;
+    }
+
+    // The peer may use any window up to 15 bits so always inflate with the
+    // largest one
+    if (inflateInit2(i, -MAX_WINDOW_BITS) != Z_OK) {
+        deflateEnd(d);
+        delete d;
+        delete i;
+        return false;
+    }
+
+    m_deflate = d;
+    m_inflate = i;
+    m_deflate_reset = deflate_reset;
+    m_active = true;
+    return true;
+}
+
+void permessage_deflate::release_streams() {
+    if (m_deflate) {
+        deflateEnd(static_cast<z_stream*>(m_deflate));
+        delete static_cast<z_stream*>(m_deflate);
+        m_deflate = NULL;
+    }
+    if (m_inflate) {
+        inflateEnd(static_cast<z_stream*>(m_inflate));
+        delete static_cast<z_stream*>(m_inflate);
+        m_inflate = NULL;
+    }
+    m_active = false;
+}
+
+bool permessage_deflate::compress(const std::string& in, std::string& out) {
+    if (!m_active) {
+        return false;
+    }
+
+    z_stream* s = static_cast<z_stream*>(m_deflate);
+
+    // Start with the worst case size so a single deflate call is the normal
+    // case. out keeps its capacity between messages.
+    size_t produced = 0;
+    out.resize(std::max(out.capacity(),
+                        static_cast<size_t>(deflateBound(s, in.size())) + 8));
+
+    s->next_in = reinterpret_cast<Bytef*>(const_cast<char*>(in.data()));
+    s->avail_in = static_cast<uInt>(in.size());
+
+    do {
+        if (produced == out.size()) {
+            out.resize(out.size() + OUTPUT_CHUNK);
+        }
+        s->next_out = reinterpret_cast<Bytef*>(&out[produced]);
+        s->avail_out = static_cast<uInt>(out.size() - produced);
+
+        int ret = deflate(s, Z_SYNC_FLUSH);
+        produced = out.size() - s->avail_out;
+
+        if (ret != Z_OK && ret != Z_BUF_ERROR) {
+            deflateReset(s);
+            return false;
+        }
+    } while (s->avail_out == 0);
+
+    // Drop the empty stored block added by the sync flush
+    if (produced >= sizeof(SYNC_TAIL) &&
+        memcmp(&out[produced - sizeof(SYNC_TAIL)], SYNC_TAIL, sizeof(SYNC_TAIL)) == 0)
+    {
+        produced -= sizeof(SYNC_TAIL);
+    }
+    out.resize(produced);
+
+    if (m_deflate_reset) {
+        deflateReset(s);
+    }
+
+    m_bytes_in += in.size();
+    m_bytes_out += produced;
+    return true;
+}
+
+void permessage_deflate::decompress(const std::string& in, std::string& out) {
+    if (!m_active) {
+        throw processor::exception("Compressed message without permessage-deflate",
+                                   processor::error::PROTOCOL_VIOLATION);
+    }
+
+    z_stream* s = static_cast<z_stream*>(m_inflate);
+
+    size_t produced = 0;
+    out.resize(std::max(out.capacity(), in.size() * 4 + OUTPUT_CHUNK));
+
+    // Feed the payload and then the tail that the sender stripped
+    for (int part = 0; part < 2; part++) {
+        if (part == 0) {
+            s->next_in = reinterpret_cast<Bytef*>(const_cast<char*>(in.data()));
+            s->avail_in = static_cast<uInt>(in.size());
+        } else {
+            s->next_in = const_cast<Bytef*>(SYNC_TAIL);
+            s->avail_in = sizeof(SYNC_TAIL);
+        }
+
+        for (;;) {
+            if (produced == out.size()) {
+                if (out.size() >= MAX_INFLATED_SIZE) {
+                    inflateReset(s);
+                    throw processor::exception("Inflated message too big",
+                                               processor::error::MESSAGE_TOO_BIG);
+                }
+                out.resize(std::min(out.size() * 2, MAX_INFLATED_SIZE));
+            }
+            s->next_out = reinterpret_cast<Bytef*>(&out[produced]);
+            s->avail_out = static_cast<uInt>(out.size() - produced);
+
+            int ret = inflate(s, Z_SYNC_FLUSH);
+            produced = out.size() - s->avail_out;
+
+            if (ret != Z_OK && ret != Z_BUF_ERROR) {
+                inflateReset(s);
+                throw processor::exception("Invalid compressed payload",
+                                           processor::error::PAYLOAD_VIOLATION);
+            }
+
+            // A full output buffer may hide pending output even when all
+            // input has been consumed
+            if (s->avail_in == 0 && s->avail_out > 0) {
+                break;
+            }
+        }
+    }
+
+    out.resize(produced);
+}
+
+} // namespace processor
+} // namespace websocketpp
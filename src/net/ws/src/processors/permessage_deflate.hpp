@@ -0,0 +1,145 @@
+// Library: OSS_CORE - Foundation API for SIP B2BUA
+// Copyright (c) OSS Software Solutions
+// Contributor: Joegen Baclor - mailto:joegen@ossapp.com
+//
+// Permission is hereby granted, to any person or organization
+// obtaining a copy of the software and accompanying documentation covered by
+// this license (the "Software") to use, execute, and to prepare
+// derivative works of the Software, all subject to the
+// "GNU Lesser General Public License (LGPL)".
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+// SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+// FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+
+#ifndef WEBSOCKET_PROCESSOR_PERMESSAGE_DEFLATE_HPP
+#define WEBSOCKET_PROCESSOR_PERMESSAGE_DEFLATE_HPP
+
+#include <string>
+#include <vector>
+#include <boost/noncopyable.hpp>
+#include <boost/cstdint.hpp>
+
+namespace websocketpp {
+namespace processor {
+
+/// Settings for the permessage-deflate extension (RFC 7692)
+struct deflate_config {
+    deflate_config()
+     : enabled(false),
+       context_takeover(true),
+       level(6),
+       mem_level(8),
+       min_size(64) {}
+
+    // Offer (client) or accept (server) permessage-deflate
+    bool        enabled;
+    // Keep the LZ77 window between messages we send.  Turning this off
+    // trades compression ratio for about 256KB less memory per connection.
+    bool        context_takeover;
+    // zlib compression level, 1 (fastest) to 9 (smallest)
+    int         level;
+    // zlib memory level, 1 (least memory) to 9 (fastest)
+    int         mem_level;
+    // Messages smaller than this are sent uncompressed
+    size_t      min_size;
+};
+
+/// One side of a negotiated permessage-deflate session
+/**
+ * Holds the deflate stream used for outgoing messages and the inflate stream
+ * used for incoming messages of a single connection.  With context takeover
+ * both streams keep their window across messages so repeated headers, SDP
+ * attributes and ICE candidates compress to back references.  This means
+ * messages must be compressed in exactly the order they are put on the wire
+ * and a compressed message can not be shared between connections.
+ *
+ * Output buffers are owned by the caller and are only grown, never shrunk,
+ * so a connection that reuses its buffers stops allocating once it has seen
+ * its largest message.
+ *
+ * @par Thread Safety
+ * @e Distinct @e objects: Safe.@n
+ * @e Shared @e objects: Unsafe. Compression and decompression use separate
+ * streams and may run concurrently with each other.
+ */
+class permessage_deflate : boost::noncopyable {
+public:
+    // Same limit as a data message.  Guards against decompression bombs.
+    static const size_t MAX_INFLATED_SIZE = 100000000;
+
+    permessage_deflate();
+    ~permessage_deflate();
+
+    // Server side. Choose the first acceptable offer out of the values of the
+    // client's Sec-WebSocket-Extensions header.  Returns true and fills in the
+    // response header value if one was accepted.
+    bool negotiate(const std::vector<std::string>& offers,
+                   const deflate_config& config,
+                   std::string& response);
+
+    // Client side. Returns the Sec-WebSocket-Extensions offer for config.
+    std::string offer(const deflate_config& config);
+    // Client side. Activates the extension from the server's response value.
+    // Returns false if the response is not acceptable for the offer.
+    bool accept(const std::string& response);
+
+    bool is_active() const {
+        return m_active;
+    }
+
+    size_t get_min_size() const {
+        return m_config.min_size;
+    }
+
+    // Compress one complete message into out.  Returns false on a zlib error.
+    bool compress(const std::string& in, std::string& out);
+    // Decompress one complete message into out.  Throws processor::exception
+    // if the payload is corrupt or inflates beyond MAX_INFLATED_SIZE.
+    void decompress(const std::string& in, std::string& out);
+
+    uint64_t get_bytes_in() const {
+        return m_bytes_in;
+    }
+    uint64_t get_bytes_out() const {
+        return m_bytes_out;
+    }
+
+    // Splits a Sec-WebSocket-Extensions header into individual offers.
+    static void parse_header(const std::string& value,
+                             std::vector<std::string>& offers);
+private:
+    struct params {
+        params()
+         : server_no_context_takeover(false),
+           client_no_context_takeover(false),
+           server_max_window_bits(15),
+           client_max_window_bits(15) {}
+        bool server_no_context_takeover;
+        bool client_no_context_takeover;
+        int  server_max_window_bits;
+        int  client_max_window_bits;
+    };
+
+    static bool parse_params(const std::string& extension, params& p);
+    bool init_streams(int deflate_bits, bool deflate_reset);
+    void release_streams();
+
+    deflate_config  m_config;
+    bool            m_active;
+    bool            m_deflate_reset;
+    void*           m_deflate;
+    void*           m_inflate;
+    uint64_t        m_bytes_in;     // uncompressed bytes handed to compress()
+    uint64_t        m_bytes_out;    // compressed bytes produced by compress()
+};
+
+} // namespace processor
+} // namespace websocketpp
+
+#endif // WEBSOCKET_PROCESSOR_PERMESSAGE_DEFLATE_HPP
@@ -74,10 +74,12 @@ public:
 
 #include "../messages/data.hpp"
 #include "../messages/control.hpp"
+#include "permessage_deflate.hpp"
 
 #include <boost/shared_ptr.hpp>
 
 #include <iostream>
+#include <vector>
 
 namespace websocketpp {
 namespace processor {
@@ -138,6 +140,26 @@ public:
                                      close::status::value code,
                                      const std::string& reason) = 0;
     
+    // permessage-deflate (RFC 7692). Processors without extension support
+    // keep these defaults and never compress.
+    
+    // Server: pick an offer from the client's extensions and fill in the
+    // response value. Returns false if none was accepted.
+    virtual bool negotiate_deflate(const std::vector<std::string>& offers,
+                                   const deflate_config& config,
+                                   std::string& response)
+    {
+        return false;
+    }
+    // Client: returns the offer to send or an empty string
+    virtual std::string offer_deflate(const deflate_config& config) {
+        return "";
+    }
+    // Client: activate the extension the server agreed to
+    virtual bool accept_deflate(const std::string& response) {
+        return false;
+    }
+    
 };
 
 typedef boost::shared_ptr<processor_base> ptr;
@@ -98,6 +98,11 @@ public:
             m_requested_subprotocols.push_back(value);
         }
         
+        // Offer permessage-deflate to the server
+        void set_permessage_deflate(const processor::deflate_config& config) {
+            m_deflate_config = config;
+        }
+        
         void set_origin(const std::string& value) {
             m_origin = value;
         }
@@ -170,6 +175,7 @@ public:
         std::vector<std::string>    m_requested_extensions;
         std::string                 m_subprotocol;
         std::vector<std::string>    m_extensions;
+        processor::deflate_config   m_deflate_config;
         
         std::string                 m_handshake_key;
         http::parser::request       m_request;
@@ -502,6 +508,11 @@ void client<endpoint>::connection<connection_type>::write_request() {
         m_request.replace_header("Sec-WebSocket-Protocol",vals);
     }
     
+    std::string extension = m_connection.m_processor->offer_deflate(m_deflate_config);
+    if (extension != "") {
+        m_request.replace_header("Sec-WebSocket-Extensions",extension);
+    }
+    
     // Generate client key
     int32_t raw_key[4];
     
@@ -662,6 +673,17 @@ void client<endpoint>::connection<connection_type>::handle_read_response (
             }
         }
         
+        h = m_response.header("Sec-WebSocket-Extensions");
+        if (h != "") {
+            // The server may only agree to what we offered
+            if (!m_connection.m_processor->accept_deflate(h)) {
+                throw http::exception("Server selected an extension that was not offered.",
+                                      m_response.get_status_code(),
+                                      m_response.get_status_msg());
+            }
+            m_extensions.push_back(h);
+        }
+        
         log_open_result();
         
         m_connection.m_state = session::state::OPEN;
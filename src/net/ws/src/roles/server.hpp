@@ -114,6 +114,11 @@ public:
         }
         void select_subprotocol(const std::string& value);
         void select_extension(const std::string& value);
+        // Accept permessage-deflate if the client offers it. Call from
+        // handler::validate.
+        void set_permessage_deflate(const processor::deflate_config& config) {
+            m_deflate_config = config;
+        }
         
         // Valid if get_version() returns -1 (ie this is an http connection)
         void set_body(const std::string& value);
@@ -158,6 +163,7 @@ public:
         std::vector<std::string>    m_requested_extensions;
         std::string                 m_subprotocol;
         std::vector<std::string>    m_extensions;
+        processor::deflate_config   m_deflate_config;
         
         http::parser::request       m_request;
         http::parser::response      m_response;
@@ -650,6 +656,12 @@ void server<endpoint>::connection<connection_type>::handle_read_request(
                 }
             }
             
+            // Extract extension offers
+            processor::permessage_deflate::parse_header(
+                m_request.header("Sec-WebSocket-Extensions"),
+                m_requested_extensions
+            );
+            
             m_origin = m_connection.m_processor->get_origin(m_request);
             m_uri = m_connection.m_processor->get_uri(m_request);
             
@@ -775,7 +787,26 @@ void server<endpoint>::connection<connection_type>::write_response() {
             m_response.replace_header("Sec-WebSocket-Protocol",m_subprotocol);
         }
         
-        // TODO: return negotiated extensions
+        std::string extension;
+        if (m_connection.m_processor->negotiate_deflate(m_requested_extensions,
+                                                        m_deflate_config,
+                                                        extension))
+        {
+            m_extensions.push_back(extension);
+        }
+        
+        if (!m_extensions.empty()) {
+            std::string vals;
+            std::string sep = "";
+            
+            std::vector<std::string>::iterator it;
+            for (it = m_extensions.begin(); it != m_extensions.end(); ++it) {
+                vals += sep + *it;
+                sep = ", ";
+            }
+            
+            m_response.replace_header("Sec-WebSocket-Extensions",vals);
+        }
     } else {
         // TODO: HTTP response
         ws_response = false;
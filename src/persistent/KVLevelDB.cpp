@@ -23,12 +23,205 @@
 
 #if OSS_HAVE_LEVELDB
 
+#include <leveldb/write_batch.h>
+#include "OSS/UTL/Logger.h"
+
+
 namespace OSS {
 namespace Persistent {
 
+
+//
+// Value header.  Values without the magic were written by older versions
+// and never expire.
+//
+static const char VALUE_MAGIC[] = { '\0', 'K', 'V', '\1' };
+static const std::size_t VALUE_MAGIC_SIZE = sizeof(VALUE_MAGIC);
+static const std::size_t VALUE_HEADER_SIZE = VALUE_MAGIC_SIZE + 8;
+
+//
+// Reserved keys live after every printable key so full scans can stop at
+// the first one.  The expiry index is ordered by big-endian expiry time.
+//
+static const char RESERVED_PREFIX[] = "\xff\xff" "KV.";
+static const std::string EXPIRES_INDEX_PREFIX = std::string(RESERVED_PREFIX) + "ttl.";
+static const std::string FORMAT_KEY = std::string(RESERVED_PREFIX) + "format";
+static const std::string FORMAT_VERSION = "1";
+
+static void kv_append_uint64(std::string& out, OSS::UInt64 value)
+{
+  char buf[8];
+  for (int i = 7; i >= 0; i--, value >>= 8)
+  {
+    buf[i] = (char)(value & 0xFF);
+  }
+  out.append(buf, sizeof(buf));
+}
+
+static OSS::UInt64 kv_read_uint64(const char* data)
+{
+  const unsigned char* buf = (const unsigned char*)data;
+  OSS::UInt64 value = 0;
+  for (int i = 0; i < 8; i++)
+  {
+    value = (value << 8) | buf[i];
+  }
+  return value;
+}
+
+static void kv_encode_value(std::string& out, const std::string& value, OSS::UInt64 expires)
+{
+  out.reserve(VALUE_HEADER_SIZE + value.size());
+  out.assign(VALUE_MAGIC, VALUE_MAGIC_SIZE);
+  kv_append_uint64(out, expires);
+  out.append(value);
+}
+
+static bool kv_has_header(const char* data, std::size_t size)
+{
+  return size >= VALUE_HEADER_SIZE && memcmp(data, VALUE_MAGIC, VALUE_MAGIC_SIZE) == 0;
+}
+
+static OSS::UInt64 kv_value_expires(const leveldb::Slice& raw)
+{
+  return kv_has_header(raw.data(), raw.size()) ? kv_read_uint64(raw.data() + VALUE_MAGIC_SIZE) : 0;
+}
+
+static leveldb::Slice kv_value_data(const leveldb::Slice& raw)
+{
+  if (kv_has_header(raw.data(), raw.size()))
+  {
+    return leveldb::Slice(raw.data() + VALUE_HEADER_SIZE, raw.size() - VALUE_HEADER_SIZE);
+  }
+  return raw;
+}
+
+static std::string kv_index_key(OSS::UInt64 expires, const leveldb::Slice& key)
+{
+  std::string indexKey;
+  indexKey.reserve(EXPIRES_INDEX_PREFIX.size() + 8 + key.size());
+  indexKey = EXPIRES_INDEX_PREFIX;
+  kv_append_uint64(indexKey, expires);
+  indexKey.append(key.data(), key.size());
+  return indexKey;
+}
+
+static bool kv_is_reserved(const leveldb::Slice& key)
+{
+  return key.starts_with(leveldb::Slice(RESERVED_PREFIX, sizeof(RESERVED_PREFIX) - 1));
+}
+
+static OSS::UInt64 kv_expires_from_now(unsigned int expireInSeconds)
+{
+  return expireInSeconds ? OSS::getTime() + ((OSS::UInt64)expireInSeconds * 1000) : 0;
+}
+
+//
+// Returns the part of a wildcard filter before the first wildcard
+//
+static std::string kv_filter_prefix(const std::string& filter)
+{
+  std::size_t wildcard = filter.find_first_of("*?");
+  return wildcard == std::string::npos ? filter : filter.substr(0, wildcard);
+}
+
+//
+// Bounded scan over the keys matching filter.  The iterator seeks to the
+// literal prefix of the filter and stops as soon as a key no longer
+// starts with it.  Keys inside the range that do not match the rest of
+// the filter are skipped.  Expired records are skipped too.  The scan
+// ends early when the visitor returns false.
+//
+template <typename Visitor>
+static bool kv_scan(leveldb::DB* db, const std::string& filter, Visitor& visitor)
+{
+  bool all = filter.empty() || filter == "*";
+  std::string prefix = all ? std::string() : kv_filter_prefix(filter);
+  bool exact = !all && prefix.size() == filter.size();
+  
+  leveldb::ReadOptions options;
+  //
+  // Bulk scans would push the hot working set out of the block cache
+  //
+  options.fill_cache = false;
+  
+  OSS::UInt64 now = OSS::getTime();
+  leveldb::Iterator* it = db->NewIterator(options);
+  for (prefix.empty() ? it->SeekToFirst() : it->Seek(prefix); it->Valid(); it->Next())
+  {
+    leveldb::Slice key = it->key();
+    if (!key.starts_with(prefix) || kv_is_reserved(key))
+      break;
+    
+    if (exact && key.size() != prefix.size())
+      break;
+    
+    if (!all && !exact && !OSS::string_wildcard_compare(filter.c_str(), key.ToString()))
+      continue;
+    
+    leveldb::Slice raw = it->value();
+    OSS::UInt64 expires = kv_value_expires(raw);
+    if (expires && expires <= now)
+      continue;
+    
+    if (!visitor(key, kv_value_data(raw)))
+      break;
+  }
+  
+  bool status = it->status().ok();
+  delete it;
+  return status;
+}
+
+struct KVKeyCollector
+{
+  KVKeyCollector(KVLevelDB::Keys& keys) : _keys(keys) {}
+  bool operator()(const leveldb::Slice& key, const leveldb::Slice& value)
+  {
+    _keys.push_back(key.ToString());
+    return true;
+  }
+  KVLevelDB::Keys& _keys;
+};
+
+struct KVRecordCollector
+{
+  KVRecordCollector(KVLevelDB::Records& records) : _records(records) {}
+  bool operator()(const leveldb::Slice& key, const leveldb::Slice& value)
+  {
+    _records.push_back(KVLevelDB::Record());
+    _records.back().key.assign(key.data(), key.size());
+    _records.back().value.assign(value.data(), value.size());
+    return true;
+  }
+  KVLevelDB::Records& _records;
+};
+
+//
+// Hands records to a caller supplied visitor through two buffers that are
+// reused for the whole scan so memory stays bounded by the largest record
+//
+struct KVRecordStreamer
+{
+  KVRecordStreamer(const KVRecordVisitor& visitor) : _visitor(visitor) {}
+  bool operator()(const leveldb::Slice& key, const leveldb::Slice& value)
+  {
+    _key.assign(key.data(), key.size());
+    _value.assign(value.data(), value.size());
+    return _visitor(_key, _value);
+  }
+  const KVRecordVisitor& _visitor;
+  std::string _key;
+  std::string _value;
+};
+
  
 KVLevelDB::KVLevelDB() :
-  _pDb(0)
+  _pDb(0),
+  _sweepInterval(DEFAULT_SWEEP_INTERVAL_MS),
+  _pSweeper(0),
+  _sweepStop(false),
+  _tombstones(0)
 {
   
 }
@@ -44,7 +237,25 @@ bool KVLevelDB::open(const std::string& path)
   leveldb::Options options;
   options.create_if_missing = true;
   leveldb::Status status = leveldb::DB::Open(options, path, &_pDb);
-  return status.ok();
+  if (!status.ok())
+  {
+    _pDb = 0;
+    return false;
+  }
+  
+  if (!migrateExpiresRecords())
+  {
+    OSS_LOG_ERROR("KVLevelDB::open - unable to convert expiry records of " << path);
+    close();
+    return false;
+  }
+  
+  if (_sweepInterval)
+  {
+    _sweepStop = false;
+    _pSweeper = new boost::thread(boost::bind(&KVLevelDB::runSweeper, this));
+  }
+  return true;
 }
 
 bool KVLevelDB::isOpen()
@@ -54,123 +265,355 @@ bool KVLevelDB::isOpen()
 
 bool KVLevelDB::close()
 {
+  if (_pSweeper)
+  {
+    {
+      OSS::mutex_critic_sec_lock lock(_sweepMutex);
+      _sweepStop = true;
+      _sweepCondition.notify_all();
+    }
+    _pSweeper->join();
+    delete _pSweeper;
+    _pSweeper = 0;
+  }
+  
   delete _pDb;
   _pDb = 0;
   return true;
 }
 
+bool KVLevelDB::migrateExpiresRecords()
+{
+  std::string version;
+  if (_pDb->Get(leveldb::ReadOptions(), FORMAT_KEY, &version).ok() && version == FORMAT_VERSION)
+  {
+    return true;
+  }
+  
+  //
+  // Fold every key + PERSISTENT_STORE_EXPIRES_SUFFIX record into the
+  // header of the value it belongs to and index it
+  //
+  leveldb::WriteBatch batch;
+  leveldb::Slice suffix(PERSISTENT_STORE_EXPIRES_SUFFIX);
+  leveldb::ReadOptions options;
+  options.fill_cache = false;
+  std::size_t converted = 0;
+  
+  leveldb::Iterator* it = _pDb->NewIterator(options);
+  for (it->SeekToFirst(); it->Valid() && !kv_is_reserved(it->key()); it->Next())
+  {
+    leveldb::Slice key = it->key();
+    if (key.size() <= suffix.size() ||
+      memcmp(key.data() + key.size() - suffix.size(), suffix.data(), suffix.size()) != 0)
+    {
+      continue;
+    }
+    
+    std::string baseKey(key.data(), key.size() - suffix.size());
+    OSS::UInt64 expires = OSS::string_to_number<OSS::UInt64>(it->value().ToString().c_str());
+    std::string raw;
+    if (expires && _pDb->Get(leveldb::ReadOptions(), baseKey, &raw).ok() && !kv_has_header(raw.data(), raw.size()))
+    {
+      std::string encoded;
+      kv_encode_value(encoded, raw, expires);
+      batch.Put(baseKey, encoded);
+      batch.Put(kv_index_key(expires, baseKey), leveldb::Slice());
+    }
+    batch.Delete(key);
+    converted++;
+  }
+  bool ok = it->status().ok();
+  delete it;
+  
+  if (!ok)
+  {
+    return false;
+  }
+  
+  if (converted)
+  {
+    OSS_LOG_INFO("KVLevelDB::migrateExpiresRecords - converted " << converted << " expiry records of " << _path);
+  }
+  
+  batch.Put(FORMAT_KEY, FORMAT_VERSION);
+  return _pDb->Write(leveldb::WriteOptions(), &batch).ok();
+}
+
 bool KVLevelDB::put(const std::string& key, const std::string& value)
 {
-  return _pDb->Put(leveldb::WriteOptions(), key, value).ok();
+  return put(key, value, 0);
+}
+
+bool KVLevelDB::put(const std::string& key, const std::string& value, unsigned int expireInSeconds)
+{
+  OSS::UInt64 expires = kv_expires_from_now(expireInSeconds);
+  std::string encoded;
+  kv_encode_value(encoded, value, expires);
+  
+  //
+  // Index entries of earlier versions of the record are left for the
+  // sweeper to drop.  It checks them against the live value so a put never
+  // has to read first.
+  //
+  OSS::mutex_read_lock lock(_writeMutex);
+  if (!expires)
+  {
+    return _pDb->Put(leveldb::WriteOptions(), key, encoded).ok();
+  }
+  
+  leveldb::WriteBatch batch;
+  batch.Put(key, encoded);
+  batch.Put(kv_index_key(expires, key), leveldb::Slice());
+  return _pDb->Write(leveldb::WriteOptions(), &batch).ok();
+}
+
+bool KVLevelDB::putRecords(const Records& records, unsigned int expireInSeconds)
+{
+  OSS::UInt64 expires = kv_expires_from_now(expireInSeconds);
+  leveldb::WriteBatch batch;
+  std::string encoded;
+  
+  for (Records::const_iterator iter = records.begin(); iter != records.end(); iter++)
+  {
+    kv_encode_value(encoded, iter->value, expires);
+    batch.Put(iter->key, encoded);
+    if (expires)
+    {
+      batch.Put(kv_index_key(expires, iter->key), leveldb::Slice());
+    }
+  }
+  
+  OSS::mutex_read_lock lock(_writeMutex);
+  return _pDb->Write(leveldb::WriteOptions(), &batch).ok();
 }
 
 bool KVLevelDB::get(const std::string& key, std::string& value)
 {
-  return _pDb->Get(leveldb::ReadOptions(), key, &value).ok();
+  return get(key, value, true);
+}
+
+bool KVLevelDB::get(const std::string& key, std::string& value, bool purgeExpired)
+{
+  if (!_pDb->Get(leveldb::ReadOptions(), key, &value).ok())
+  {
+    return false;
+  }
+  
+  if (!kv_has_header(value.data(), value.size()))
+  {
+    return true;
+  }
+  
+  OSS::UInt64 expires = kv_read_uint64(value.data() + VALUE_MAGIC_SIZE);
+  if (purgeExpired && expires && expires <= OSS::getTime())
+  {
+    purgeIfExpired(key, expires);
+    value.clear();
+    return false;
+  }
+  
+  value.erase(0, VALUE_HEADER_SIZE);
+  return true;
 }
 
 bool KVLevelDB::del(const std::string& key)
 {
+  OSS::mutex_read_lock lock(_writeMutex);
   return _pDb->Delete(leveldb::WriteOptions(), key).ok();
 }
 
-bool KVLevelDB::getKeys(Keys& keys)
+bool KVLevelDB::delRecords(const Keys& keys)
 {
-  leveldb::Iterator* it = _pDb->NewIterator(leveldb::ReadOptions());
-  for (it->SeekToFirst(); it->Valid(); it->Next()) 
+  leveldb::WriteBatch batch;
+  for (Keys::const_iterator iter = keys.begin(); iter != keys.end(); iter++)
   {
-    std::string key = it->key().ToString();
-    keys.push_back(key);
+    batch.Delete(*iter);
   }
   
-  bool status = it->status().ok();
-  delete it;
-  return status;
+  OSS::mutex_read_lock lock(_writeMutex);
+  return _pDb->Write(leveldb::WriteOptions(), &batch).ok();
 }
 
-bool KVLevelDB::getKeys(const std::string& filter, Keys& keys)
+bool KVLevelDB::purgeIfExpired(const std::string& key, OSS::UInt64 expires)
 {
-  if (filter == "*" || filter.empty())
-    return getKeys(keys);
-  
-  std::string startKey = OSS::string_left(filter, filter.size() - 1);
+  OSS::mutex_write_lock lock(_writeMutex);
   
-  leveldb::Iterator* it = _pDb->NewIterator(leveldb::ReadOptions());
-  for (it->Seek(startKey); it->Valid(); it->Next()) 
+  //
+  // Check again under the lock.  The record may have been rewritten since
+  // it was read.
+  //
+  std::string raw;
+  if (!_pDb->Get(leveldb::ReadOptions(), key, &raw).ok() || kv_value_expires(raw) != expires)
   {
-    std::string key = it->key().ToString();
-    bool validKey = true;
-    validKey = OSS::string_wildcard_compare(filter.c_str(), key);
-
-    if (validKey)
-      keys.push_back(key);
-    else
-      break;
+    return false;
   }
   
-  bool status = it->status().ok();
-  delete it;
-  return status;
+  leveldb::WriteBatch batch;
+  batch.Delete(key);
+  batch.Delete(kv_index_key(expires, key));
+  return _pDb->Write(leveldb::WriteOptions(), &batch).ok();
 }
 
-bool KVLevelDB::getRecords(Records& records)
+bool KVLevelDB::isLevel0Congested()
 {
-  leveldb::Iterator* it = _pDb->NewIterator(leveldb::ReadOptions());
-  for (it->SeekToFirst(); it->Valid(); it->Next()) 
+  std::string files;
+  if (!_pDb->GetProperty("leveldb.num-files-at-level0", &files))
   {
-    Record record;
-    record.key = it->key().ToString();
-    record.value = it->value().ToString();
-    records.push_back(record);
+    return false;
   }
-  
-  bool status = it->status().ok();
-  delete it;
-  return status;
+  return OSS::string_to_number<int>(files.c_str()) >= SWEEP_LEVEL0_BACKOFF;
 }
 
-bool KVLevelDB::getRecords(const std::string& filter, Records& records)
+std::size_t KVLevelDB::purgeExpired(std::size_t maxRecords)
 {
-  if (filter == "*" || filter.empty())
-    return getRecords(records);
+  if (!_pDb)
+  {
+    return 0;
+  }
   
-  std::string key = OSS::string_left(filter, filter.size() - 1);
+  std::size_t purged = 0;
+  std::string lastIndexKey;
   
-  leveldb::Iterator* it = _pDb->NewIterator(leveldb::ReadOptions());
-  for (it->Seek(key); it->Valid(); it->Next()) 
+  for (;;)
   {
-    Record record;
-    record.key = it->key().ToString();
-    bool validKey = true;
-    if (!filter.empty() && filter != "*")
-      validKey = OSS::string_wildcard_compare(filter.c_str(), record.key);
-
-    if (validKey)
+    //
+    // Collect a batch of due index entries without holding the lock
+    //
+    std::vector<std::string> due;
+    OSS::UInt64 now = OSS::getTime();
+    leveldb::ReadOptions options;
+    options.fill_cache = false;
+    leveldb::Iterator* it = _pDb->NewIterator(options);
+    for (it->Seek(lastIndexKey.empty() ? EXPIRES_INDEX_PREFIX : lastIndexKey);
+      it->Valid() && due.size() < SWEEP_BATCH_SIZE; it->Next())
+    {
+      leveldb::Slice indexKey = it->key();
+      if (!indexKey.starts_with(EXPIRES_INDEX_PREFIX) || indexKey.size() < EXPIRES_INDEX_PREFIX.size() + 8)
+        break;
+      if (kv_read_uint64(indexKey.data() + EXPIRES_INDEX_PREFIX.size()) > now)
+        break;
+      due.push_back(indexKey.ToString());
+    }
+    delete it;
+    
+    if (due.empty())
     {
-      record.value = it->value().ToString();
-      records.push_back(record);
+      break;
     }
-    else
+    
+    //
+    // Verify and delete under the exclusive lock.  Entries that no longer
+    // match their record are stale and only the entry goes.
+    //
+    leveldb::WriteBatch batch;
+    std::string raw;
+    do
+    {
+      OSS::mutex_write_lock lock(_writeMutex);
+      for (std::vector<std::string>::const_iterator iter = due.begin(); iter != due.end(); iter++)
+      {
+        OSS::UInt64 expires = kv_read_uint64(iter->data() + EXPIRES_INDEX_PREFIX.size());
+        leveldb::Slice key(iter->data() + EXPIRES_INDEX_PREFIX.size() + 8, iter->size() - EXPIRES_INDEX_PREFIX.size() - 8);
+        if (_pDb->Get(leveldb::ReadOptions(), key, &raw).ok() && kv_value_expires(raw) == expires)
+        {
+          batch.Delete(key);
+          purged++;
+        }
+        batch.Delete(*iter);
+      }
+      if (!_pDb->Write(leveldb::WriteOptions(), &batch).ok())
+      {
+        return purged;
+      }
+    } while (false);
+    
+    __sync_add_and_fetch(&_tombstones, due.size());
+    lastIndexKey = due.back();
+    
+    if (maxRecords && purged >= maxRecords)
     {
       break;
     }
   }
   
-  bool status = it->status().ok();
-  delete it;
-  return status;
+  //
+  // Deleted index entries stay behind as tombstones until compaction
+  // reaches them and every sweep has to step over them.  Compact the
+  // swept part of the index once enough have accumulated.
+  //
+  if (!lastIndexKey.empty() && __sync_fetch_and_add(&_tombstones, 0) >= SWEEP_COMPACT_THRESHOLD)
+  {
+    __sync_lock_test_and_set(&_tombstones, 0);
+    leveldb::Slice begin(EXPIRES_INDEX_PREFIX);
+    leveldb::Slice end(lastIndexKey);
+    _pDb->CompactRange(&begin, &end);
+  }
+  
+  return purged;
+}
+
+void KVLevelDB::runSweeper()
+{
+  boost::unique_lock<OSS::mutex_critic_sec> lock(_sweepMutex);
+  while (!_sweepStop)
+  {
+    _sweepCondition.timed_wait(lock, boost::posix_time::milliseconds(_sweepInterval));
+    if (_sweepStop)
+    {
+      break;
+    }
+    
+    lock.unlock();
+    //
+    // Writes stall once level-0 fills up.  Leave the deletes for later
+    // instead of adding to the backlog.
+    //
+    if (!isLevel0Congested())
+    {
+      purgeExpired(0);
+    }
+    lock.lock();
+  }
+}
+
+bool KVLevelDB::getKeys(Keys& keys)
+{
+  KVKeyCollector collector(keys);
+  return kv_scan(_pDb, std::string(), collector);
+}
+
+bool KVLevelDB::getKeys(const std::string& filter, Keys& keys)
+{
+  KVKeyCollector collector(keys);
+  return kv_scan(_pDb, filter, collector);
+}
+
+bool KVLevelDB::getRecords(Records& records)
+{
+  KVRecordCollector collector(records);
+  return kv_scan(_pDb, std::string(), collector);
+}
+
+bool KVLevelDB::getRecords(const std::string& filter, Records& records)
+{
+  KVRecordCollector collector(records);
+  return kv_scan(_pDb, filter, collector);
+}
+
+bool KVLevelDB::visitRecords(const std::string& filter, const KVRecordVisitor& visitor)
+{
+  KVRecordStreamer streamer(visitor);
+  return kv_scan(_pDb, filter, streamer);
 }
 
 bool KVLevelDB::delKeys(const std::string& filter)
 {
   Keys keys;
   if (!getKeys(filter, keys))
-  return false;
+    return false;
   
-  for (Keys::const_iterator iter= keys.begin(); iter != keys.end(); iter++)
-    del(*iter);
-  
-  return true;
+  return delRecords(keys);
 }
 
 const std::string KVLevelDB::getPath() const
@@ -183,4 +626,3 @@ const std::string KVLevelDB::getPath() const
 } } // OSS::Persistent
 
 #endif // OSS_HAVE_LEVELDB
-
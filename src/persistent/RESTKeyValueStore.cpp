@@ -85,76 +85,132 @@ static std::string create_filter(const std::string& path)
   return path + std::string("*");
 }
 
-static bool printOneRecord(std::size_t filterDepth, const std::string& resourceName, std::list<KVRecord>& records, std::list<KVRecord>::iterator& iter, std::ostream& ostr)
+//
+// Same as get_path_vector but reuses the strings already in tokens
+//
+static void split_path(const std::string& path, std::vector<std::string>& tokens)
 {
-  //
-  // return false if there are no more records
-  //
-  if (iter == records.end())
-    return false;
-  
-  //
-  // This will hold the tokens of the current key
-  //
-  std::vector<std::string> keyTokens;
-  get_path_vector(iter->key, keyTokens);
-  
-  //
-  // This will hold the depth of the current item in the tree
-  //
-  std::size_t keyDepth = keyTokens.size() - 1;
-  
-  //
-  // This will hold the offSet of the current key relative to the filter depth
-  //
-  std::size_t keyOffSet = keyDepth - filterDepth;
-  
-  if (keyOffSet == 0 && keyTokens[keyDepth] == resourceName)
+  std::size_t count = 0;
+  std::size_t start = 0;
+  while (start < path.size())
   {
-    //
-    // This is an exact match.  We print it out and consume the iterator
-    //
-    ostr << "\"" << keyTokens[keyTokens.size() -1] << "\": " << "\"" << iter->value << "\"";
-    iter++;
+    std::size_t end = path.find('/', start);
+    if (end == std::string::npos)
+      end = path.size();
+    
+    if (end > start)
+    {
+      if (count == tokens.size())
+        tokens.push_back(std::string());
+      tokens[count++].assign(path, start, end - start);
+    }
+    start = end + 1;
   }
-  else if (keyOffSet > 0)
+  tokens.resize(count);
+}
+
+static std::ostream& open_stream(std::ostream* ostr)
+{
+  return *ostr;
+}
+
+static std::ostream& open_json_response(RESTKeyValueStore::Response* response)
+{
+  response->setStatus(HTTPResponse::HTTP_OK);
+  response->setReason("GET Operation Completed");
+  response->setChunkedTransferEncoding(true);
+  response->setContentType("application/json");
+  return response->send();
+}
+
+//
+// Writes records as a nested JSON document as they come off the store
+// iterator.  Records must arrive sorted by key, the order LevelDB returns
+// them in.  Only the names of the currently open objects are kept so memory
+// does not grow with the size of the subtree.  The output stream is opened
+// when the first record arrives.
+//
+class RESTJSONWriter
+{
+public:
+  RESTJSONWriter(std::size_t depth, const RESTKeyValueStore::StreamOpener& open) :
+    _depth(depth),
+    _open(open),
+    _pStream(0),
+    _needComma(false),
+    _count(0)
+  {
+  }
+  
+  bool operator()(const std::string& key, const std::string& value)
   {
+    split_path(key, _tokens);
+    if (_tokens.size() <= _depth)
+      return true;
+    
+    if (!_pStream)
+    {
+      _pStream = &_open();
+      *_pStream << "{";
+    }
+    std::ostream& ostr = *_pStream;
+    
     //
-    // The item falls under a group of elements under the filter tree
+    // Close the objects this key is not part of and open the ones it is in
     //
-    ostr << "\"" << keyTokens[filterDepth] << "\":  {";
+    std::size_t objects = _tokens.size() - 1 - _depth;
+    std::size_t common = 0;
+    while (common < _openObjects.size() && common < objects && _openObjects[common] == _tokens[_depth + common])
+      common++;
     
-   
-    while (true)
-    { 
-      std::string previousResource = keyTokens[filterDepth];
-      if (!printOneRecord(filterDepth + 1, keyTokens[filterDepth + 1], records, iter, ostr))
-        break;
-      
-      keyTokens.clear();
-      get_path_vector(iter->key, keyTokens);
-      
-      if (filterDepth + 1 >= keyTokens.size())
-        break;
-      
-      if (previousResource != keyTokens[filterDepth])
-        break;
-      
-      ostr << ",";
+    for (; _openObjects.size() > common; _openObjects.pop_back())
+    {
+      ostr << "}";
+      _needComma = true;
     }
     
-    ostr << "}";
+    for (std::size_t i = common; i < objects; i++)
+    {
+      if (_needComma)
+        ostr << ",";
+      ostr << "\"" << _tokens[_depth + i] << "\":  {";
+      _openObjects.push_back(_tokens[_depth + i]);
+      _needComma = false;
+    }
+    
+    if (_needComma)
+      ostr << ",";
+    ostr << "\"" << _tokens.back() << "\": " << "\"" << value << "\"";
+    _needComma = true;
+    _count++;
+    return true;
   }
-  else 
+  
+  std::size_t finish()
   {
-    return false;
+    if (_pStream)
+    {
+      for (; !_openObjects.empty(); _openObjects.pop_back())
+        *_pStream << "}";
+      *_pStream << "}";
+      _pStream->flush();
+    }
+    return _count;
   }
   
-  return iter != records.end();
-}
+private:
+  std::size_t _depth;
+  RESTKeyValueStore::StreamOpener _open;
+  std::ostream* _pStream;
+  std::vector<std::string> _tokens;
+  std::vector<std::string> _openObjects;
+  bool _needComma;
+  std::size_t _count;
+};
   
 RESTKeyValueStore::RESTKeyValueStore(RESTKeyValueStore* pParentStore) :
   _rootDocument(REST_DEFAULT_ROOT_DOCUMENT),
+  _kvStore(new KVStore()),
   _pParentStore(pParentStore)
 {
   setHandler(boost::bind(&RESTKeyValueStore::onHandleRequest, this, _1, _2));
@@ -169,6 +225,7 @@ RESTKeyValueStore::RESTKeyValueStore(RESTKeyValueStore* pParentStore) :
 RESTKeyValueStore::RESTKeyValueStore(int maxQueuedConnections, int maxThreads, RESTKeyValueStore* pParentStore) :
   OSS::Net::HTTPServer(maxQueuedConnections, maxThreads),
   _rootDocument(REST_DEFAULT_ROOT_DOCUMENT),
+  _kvStore(new KVStore()),
   _pParentStore(pParentStore)
 {
   setHandler(boost::bind(&RESTKeyValueStore::onHandleRequest, this, _1, _2));
@@ -181,11 +238,16 @@ RESTKeyValueStore::RESTKeyValueStore(int maxQueuedConnections, int maxThreads, R
 
 RESTKeyValueStore::~RESTKeyValueStore()
 {
-  for (KVStore::const_iterator iter = _kvStore.begin(); iter != _kvStore.end(); iter++)
+  KVStore* pStores = _kvStore.load(boost::memory_order_acquire);
+  for (KVStore::const_iterator iter = pStores->begin(); iter != pStores->end(); iter++)
   {
     iter->second->close();
     delete iter->second;
   }
+  delete pStores;
+  
+  for (std::vector<KVStore*>::iterator iter = _retiredKvStores.begin(); iter != _retiredKvStores.end(); iter++)
+    delete *iter;
 }
 
 KeyValueStore* RESTKeyValueStore::getStore(const std::string& path, bool createIfMissing)
@@ -197,12 +259,26 @@ KeyValueStore* RESTKeyValueStore::getStore(const std::string& path, bool createI
   if(tokens.size() < 3)
     return 0;
   
+  const std::string& document = tokens[2];
+  
+  //
+  // Stores are only added while the server runs and a published map is
+  // never modified, so the lookup reads the current map without locking.
+  // Opening a store publishes an extended copy.  The map it replaces is
+  // kept until destruction since readers may still be walking it.
+  //
+  KVStore* pStores = _kvStore.load(boost::memory_order_acquire);
+  KVStore::const_iterator found = pStores->find(document);
+  if (found != pStores->end())
+    return found->second;
+  
   OSS::mutex_lock lock(_kvStoreMutex);
   
   KeyValueStore* pStore = 0;
-  std::string document = tokens[2];
+  pStores = _kvStore.load(boost::memory_order_acquire);
+  found = pStores->find(document);
   
-  if (_kvStore.find(document) == _kvStore.end())
+  if (found == pStores->end())
   {
     //
     // Create a new store
@@ -220,7 +296,10 @@ KeyValueStore* RESTKeyValueStore::getStore(const std::string& path, bool createI
       pStore->open(strm.str());
       if (pStore->isOpen())
       {
-       _kvStore.insert(std::pair<std::string, KeyValueStore*>(document, pStore));
+        KVStore* pPublished = new KVStore(*pStores);
+        pPublished->insert(std::pair<std::string, KeyValueStore*>(document, pStore));
+        _retiredKvStores.push_back(pStores);
+        _kvStore.store(pPublished, boost::memory_order_release);
       }
       else
       {
@@ -235,7 +314,7 @@ KeyValueStore* RESTKeyValueStore::getStore(const std::string& path, bool createI
   }
   else
   {
-    pStore = _kvStore.at(document);
+    pStore = found->second;
   }
   
   return pStore;
@@ -304,8 +383,25 @@ int RESTKeyValueStore::restPUT(const std::string& path, const std::string& value
     return HTTPResponse::HTTP_INTERNAL_SERVER_ERROR;
   }
   
-  std::string data = value;
-  OSS::string_replace(data, "\"", "\\\"");
+  //
+  // Values are stored with their quotes escaped so GET can write them into
+  // the document as they are.  Only copy the value if there is something to
+  // escape.
+  //
+  const std::string* pData = &value;
+  std::string escaped;
+  if (value.find('"') != std::string::npos)
+  {
+    escaped.reserve(value.size() + 16);
+    for (std::string::const_iterator iter = value.begin(); iter != value.end(); iter++)
+    {
+      if (*iter == '"')
+        escaped.push_back('\\');
+      escaped.push_back(*iter);
+    }
+    pData = &escaped;
+  }
+  const std::string& data = *pData;
   
   if (expires > 0)
   {
@@ -330,6 +426,11 @@ int RESTKeyValueStore::restPUT(const std::string& path, const std::string& value
 }
     
 int RESTKeyValueStore::restGET(const std::string& path, std::ostream& ostr)
+{
+  return writeJSONDocument(path, boost::bind(open_stream, &ostr));
+}
+
+int RESTKeyValueStore::writeJSONDocument(const std::string& path, const StreamOpener& open)
 {
   std::string resource = path;
   prepare_path(resource);
@@ -342,17 +443,19 @@ int RESTKeyValueStore::restGET(const std::string& path, std::ostream& ostr)
   
   std::vector<std::string> tokens;
   get_path_vector(resource, tokens);
+  if (tokens.empty())
+  {
+    return HTTPResponse::HTTP_NOT_FOUND;
+  }
   std::string filter = create_filter(resource);
   
-  KVRecords records;
-  pStore->getRecords(filter, records);
+  RESTJSONWriter writer(tokens.size() - 1, open);
+  pStore->visitRecords(filter, boost::ref(writer));
   
-  if (records.empty())
+  if (!writer.finish())
   {
     return HTTPResponse::HTTP_NOT_FOUND;
   }
- 
-  createJSONDocument(tokens, tokens.size() - 1, records, ostr, false);
   
   return HTTPResponse::HTTP_OK;
 }
@@ -399,21 +502,18 @@ void RESTKeyValueStore::onHandleRestRequest(Request& request, Response& response
     
   if (action == HTTPRequest::HTTP_GET)
   {
-    std::ostringstream result;
-    HTTPResponse::HTTPStatus status = (HTTPResponse::HTTPStatus)restGET(request.getURI(), result);
-    response.setStatus(status);
+    //
+    // The headers go out with the first record and the rest of the
+    // document follows in chunks while the store is being scanned
+    //
+    HTTPResponse::HTTPStatus status = (HTTPResponse::HTTPStatus)writeJSONDocument(request.getURI(), boost::bind(open_json_response, &response));
     
     if (status != HTTPResponse::HTTP_OK)
     {
-      response.setStatus("Resource Not Found");
+      response.setStatus(status);
+      response.setReason("Resource Not Found");
       response.send();
-      return;
     }
-    
-    response.setReason("GET Operation Completed");
-    response.setChunkedTransferEncoding(true);
-    response.setContentType("application/json");
-    response.send() << result.str();
     return;
   }
   else if (action == HTTPRequest::HTTP_DELETE)
@@ -454,24 +554,27 @@ void RESTKeyValueStore::onHandleRestRequest(Request& request, Response& response
 
 void RESTKeyValueStore::createJSONDocument(const std::vector<std::string>& pathVector, std::size_t depth, KVRecords& unsorted, std::ostream& ostr, bool sortNeeded)
 {
-  //
-  // sort the records
-  //
-  std::list<KVRecord> records;
-  std::copy( unsorted.begin(), unsorted.end(), std::back_inserter(records));
+  std::list<KVRecord> sorted;
+  if (sortNeeded)
+  {
+    std::copy( unsorted.begin(), unsorted.end(), std::back_inserter(sorted));
+    sorted.sort(compare_records);
+  }
   
+  RESTJSONWriter writer(depth, boost::bind(open_stream, &ostr));
   if (sortNeeded)
-    records.sort(compare_records);
+  {
+    for (std::list<KVRecord>::const_iterator iter = sorted.begin(); iter != sorted.end(); iter++)
+      writer(iter->key, iter->value);
+  }
+  else
+  {
+    for (KVRecords::const_iterator iter = unsorted.begin(); iter != unsorted.end(); iter++)
+      writer(iter->key, iter->value);
+  }
   
- 
-  //
-  // Loop through the records
-  //
-  ostr << "{";
-  std::list<KVRecord>::iterator iter = records.begin();
-  while (printOneRecord(depth, pathVector[depth], records, iter, ostr))
-    ostr << ",";
-  ostr << "}";
+  if (!writer.finish())
+    ostr << "{}";
 }
 
 void RESTKeyValueStore::sendRestRecordsAsJson(const std::vector<std::string>& pathVector, KVRecords& records, Response& response)
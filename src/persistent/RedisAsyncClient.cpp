@@ -0,0 +1,695 @@
+// Library: OSS_CORE - Foundation API for SIP B2BUA
+// Copyright (c) OSS Software Solutions
+// Contributor: Joegen Baclor - mailto:joegen@ossapp.com
+//
+// Permission is hereby granted, to any person or organization
+// obtaining a copy of the software and accompanying documentation covered by
+// this license (the "Software") to use, execute, and to prepare
+// derivative works of the Software, all subject to the
+// "GNU Lesser General Public License (LGPL)".
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+// SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+// FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+
+
+#include "OSS/Persistent/RedisAsyncClient.h"
+
+#if ENABLE_FEATURE_REDIS
+#if OSS_HAVE_HIREDIS
+
+#include "OSS/UTL/Logger.h"
+#include "hiredis/hiredis.h"
+#include "hiredis/async.h"
+#include <boost/lexical_cast.hpp>
+#include <algorithm>
+
+
+namespace OSS {
+namespace Persistent {
+
+
+bool RedisAsyncClient::Reply::ok() const
+{
+  return type != 0 && type != REDIS_REPLY_ERROR;
+}
+
+bool RedisAsyncClient::Reply::isNil() const
+{
+  return type == REDIS_REPLY_NIL;
+}
+
+RedisAsyncClient::RedisAsyncClient(boost::asio::io_service& ioService, const std::string& tcpHost, int tcpPort) :
+  _ioService(ioService),
+  _strand(ioService),
+  _reconnectTimer(ioService),
+  _context(0),
+  _tcpHost(tcpHost),
+  _tcpPort(tcpPort),
+  _db(0),
+  _reading(false),
+  _writing(false),
+  _wantRead(false),
+  _wantWrite(false),
+  _stopped(true),
+  _reconnectInterval(DEFAULT_RECONNECT_MS),
+  _state(DISCONNECTED),
+  _pending(0)
+{
+}
+
+RedisAsyncClient::~RedisAsyncClient()
+{
+  _stopped = true;
+  if (_context)
+  {
+    redisAsyncFree(_context);
+    _context = 0;
+  }
+}
+
+void RedisAsyncClient::connect(const std::string& password, int db)
+{
+  _password = password;
+  _db = db;
+  _stopped = false;
+  _strand.post(boost::bind(&RedisAsyncClient::doConnect, shared_from_this()));
+}
+
+void RedisAsyncClient::disconnect()
+{
+  _stopped = true;
+  _strand.post(boost::bind(&RedisAsyncClient::doDisconnect, shared_from_this()));
+}
+
+void RedisAsyncClient::setState(State state)
+{
+  OSS::mutex_critic_sec_lock lock(_stateMutex);
+  _state = state;
+  _stateCondition.notify_all();
+}
+
+std::string RedisAsyncClient::getLastError() const
+{
+  OSS::mutex_critic_sec_lock lock(_stateMutex);
+  return _lastError;
+}
+
+void RedisAsyncClient::doConnect()
+{
+  if (_context || _stopped)
+  {
+    return;
+  }
+  
+  _context = redisAsyncConnect(_tcpHost.c_str(), _tcpPort);
+  if (!_context || _context->err)
+  {
+    {
+      OSS::mutex_critic_sec_lock lock(_stateMutex);
+      _lastError = _context && _context->errstr ? _context->errstr : "Unable to allocate redis context";
+    }
+    OSS_LOG_ERROR("[REDIS] Unable to connect to tcp:" << _tcpHost << ":" << _tcpPort << " - " << getLastError());
+    if (_context)
+    {
+      redisAsyncFree(_context);
+      _context = 0;
+    }
+    setState(DISCONNECTED);
+    scheduleReconnect();
+    return;
+  }
+  
+  //
+  // Attach hiredis to the io_service.  The descriptor is released, not
+  // closed, in cleanup() because hiredis owns the socket.
+  //
+  _context->data = this;
+  _context->ev.data = this;
+  _context->ev.addRead = &RedisAsyncClient::onAddRead;
+  _context->ev.delRead = &RedisAsyncClient::onDelRead;
+  _context->ev.addWrite = &RedisAsyncClient::onAddWrite;
+  _context->ev.delWrite = &RedisAsyncClient::onDelWrite;
+  _context->ev.cleanup = &RedisAsyncClient::onCleanup;
+  redisAsyncSetConnectCallback(_context, &RedisAsyncClient::onConnect);
+  redisAsyncSetDisconnectCallback(_context, &RedisAsyncClient::onDisconnect);
+  _socket.reset(new boost::asio::posix::stream_descriptor(_ioService, _context->c.fd));
+  setState(CONNECTING);
+  
+  //
+  // Pipelined ahead of everything issued after connect()
+  //
+  if (!_password.empty())
+  {
+    Command auth;
+    auth.push_back("AUTH");
+    auth.push_back(_password);
+    sendCommand(auth, Callback());
+  }
+  
+  if (_db != 0)
+  {
+    Command select;
+    select.push_back("SELECT");
+    select.push_back(boost::lexical_cast<std::string>(_db));
+    sendCommand(select, Callback());
+  }
+  
+  //
+  // The connection completes when the socket first becomes writable
+  //
+  startWrite();
+}
+
+void RedisAsyncClient::doDisconnect()
+{
+  boost::system::error_code ignored;
+  _reconnectTimer.cancel(ignored);
+  if (_context)
+  {
+    redisAsyncDisconnect(_context);
+  }
+}
+
+void RedisAsyncClient::scheduleReconnect()
+{
+  if (_stopped || !_reconnectInterval)
+  {
+    return;
+  }
+  _reconnectTimer.expires_from_now(boost::posix_time::milliseconds(_reconnectInterval));
+  _reconnectTimer.async_wait(_strand.wrap(boost::bind(&RedisAsyncClient::onReconnectTimer, shared_from_this(), boost::asio::placeholders::error)));
+}
+
+void RedisAsyncClient::onReconnectTimer(const boost::system::error_code& e)
+{
+  if (e != boost::asio::error::operation_aborted)
+  {
+    doConnect();
+  }
+}
+
+void RedisAsyncClient::execute(const Command& command, const Callback& callback)
+{
+  __sync_add_and_fetch(&_pending, 1);
+  _strand.post(boost::bind(&RedisAsyncClient::doExecute, shared_from_this(), command, callback));
+}
+
+void RedisAsyncClient::executeTransaction(const Commands& commands, const Callback& callback)
+{
+  __sync_add_and_fetch(&_pending, 1);
+  _strand.post(boost::bind(&RedisAsyncClient::doExecuteTransaction, shared_from_this(), commands, callback));
+}
+
+void RedisAsyncClient::doExecute(const Command& command, const Callback& callback)
+{
+  PendingCommand* pending = new PendingCommand();
+  pending->client = shared_from_this();
+  pending->callback = callback;
+  pending->counted = true;
+  
+  if (!_context || !sendCommand(command, pending))
+  {
+    delete pending;
+    failCommand(callback);
+  }
+}
+
+void RedisAsyncClient::doExecuteTransaction(const Commands& commands, const Callback& callback)
+{
+  if (!_context)
+  {
+    failCommand(callback);
+    return;
+  }
+  
+  //
+  // Only EXEC carries the caller's callback.  The replies to MULTI and to
+  // the queued commands are just +OK and +QUEUED.
+  //
+  Command multi;
+  multi.push_back("MULTI");
+  bool sent = sendCommand(multi, Callback());
+  for (Commands::const_iterator iter = commands.begin(); sent && iter != commands.end(); iter++)
+  {
+    sent = sendCommand(*iter, Callback());
+  }
+  
+  PendingCommand* pending = new PendingCommand();
+  pending->client = shared_from_this();
+  pending->callback = callback;
+  pending->counted = true;
+  
+  Command exec;
+  exec.push_back("EXEC");
+  if (!sent || !sendCommand(exec, pending))
+  {
+    delete pending;
+    failCommand(callback);
+  }
+}
+
+bool RedisAsyncClient::sendCommand(const Command& command, const Callback& callback)
+{
+  PendingCommand* pending = 0;
+  if (callback)
+  {
+    pending = new PendingCommand();
+    pending->client = shared_from_this();
+    pending->callback = callback;
+    pending->counted = false;
+  }
+  
+  if (!sendCommand(command, pending))
+  {
+    delete pending;
+    return false;
+  }
+  return true;
+}
+
+bool RedisAsyncClient::sendCommand(const Command& command, PendingCommand* pending)
+{
+  std::vector<const char*> argv(command.size());
+  std::vector<size_t> argvlen(command.size());
+  for (std::size_t i = 0; i < command.size(); i++)
+  {
+    argv[i] = command[i].data();
+    argvlen[i] = command[i].size();
+  }
+  
+  return redisAsyncCommandArgv(_context, pending ? &RedisAsyncClient::onReply : 0, pending,
+    (int)command.size(), argv.empty() ? 0 : &argv[0], argvlen.empty() ? 0 : &argvlen[0]) == REDIS_OK;
+}
+
+void RedisAsyncClient::failCommand(const Callback& callback)
+{
+  __sync_sub_and_fetch(&_pending, 1);
+  if (callback)
+  {
+    callback(Reply());
+  }
+}
+
+void RedisAsyncClient::convertReply(const void* data, Reply& reply)
+{
+  const redisReply* r = (const redisReply*)data;
+  reply.type = r->type;
+  switch (r->type)
+  {
+  case REDIS_REPLY_INTEGER:
+    reply.integer = r->integer;
+    break;
+  case REDIS_REPLY_STRING:
+  case REDIS_REPLY_STATUS:
+  case REDIS_REPLY_ERROR:
+    reply.str.assign(r->str, r->len);
+    break;
+  case REDIS_REPLY_ARRAY:
+    reply.elements.resize(r->elements);
+    for (size_t i = 0; i < r->elements; i++)
+    {
+      if (r->element[i])
+      {
+        convertReply(r->element[i], reply.elements[i]);
+      }
+    }
+    break;
+  default:
+    break;
+  }
+}
+
+void RedisAsyncClient::onReply(redisAsyncContext* context, void* data, void* privdata)
+{
+  //
+  // hiredis calls this with a null reply for every command still pending
+  // when the connection goes away
+  //
+  PendingCommand* pending = (PendingCommand*)privdata;
+  Reply reply;
+  if (data)
+  {
+    convertReply(data, reply);
+  }
+  
+  if (pending->counted)
+  {
+    __sync_sub_and_fetch(&pending->client->_pending, 1);
+  }
+  
+  if (pending->callback)
+  {
+    pending->callback(reply);
+  }
+  delete pending;
+}
+
+void RedisAsyncClient::onConnect(const redisAsyncContext* context, int status)
+{
+  RedisAsyncClient* client = (RedisAsyncClient*)context->data;
+  if (status != REDIS_OK)
+  {
+    {
+      OSS::mutex_critic_sec_lock lock(client->_stateMutex);
+      client->_lastError = context->errstr ? context->errstr : "Connection failed";
+    }
+    OSS_LOG_ERROR("[REDIS] Error connecting to tcp:" << client->_tcpHost << ":" << client->_tcpPort << " - " << client->getLastError());
+    //
+    // hiredis frees the context after this returns
+    //
+    client->_context = 0;
+    client->setState(DISCONNECTED);
+    client->scheduleReconnect();
+    return;
+  }
+  
+  OSS_LOG_DEBUG("[REDIS] Async client connected to tcp:" << client->_tcpHost << ":" << client->_tcpPort);
+  client->setState(CONNECTED);
+}
+
+void RedisAsyncClient::onDisconnect(const redisAsyncContext* context, int status)
+{
+  RedisAsyncClient* client = (RedisAsyncClient*)context->data;
+  if (status != REDIS_OK)
+  {
+    {
+      OSS::mutex_critic_sec_lock lock(client->_stateMutex);
+      client->_lastError = context->errstr ? context->errstr : "Connection lost";
+    }
+    OSS_LOG_WARNING("[REDIS] Async client lost tcp:" << client->_tcpHost << ":" << client->_tcpPort << " - " << client->getLastError());
+  }
+  client->_context = 0;
+  client->setState(DISCONNECTED);
+  client->scheduleReconnect();
+}
+
+//
+// Event loop hooks.  hiredis calls these from within the strand.
+//
+
+void RedisAsyncClient::onAddRead(void* data)
+{
+  ((RedisAsyncClient*)data)->startRead();
+}
+
+void RedisAsyncClient::onDelRead(void* data)
+{
+  ((RedisAsyncClient*)data)->stopRead();
+}
+
+void RedisAsyncClient::onAddWrite(void* data)
+{
+  ((RedisAsyncClient*)data)->startWrite();
+}
+
+void RedisAsyncClient::onDelWrite(void* data)
+{
+  ((RedisAsyncClient*)data)->stopWrite();
+}
+
+void RedisAsyncClient::onCleanup(void* data)
+{
+  ((RedisAsyncClient*)data)->cleanup();
+}
+
+void RedisAsyncClient::startRead()
+{
+  _wantRead = true;
+  if (_reading || !_socket)
+  {
+    return;
+  }
+  _reading = true;
+  _socket->async_read_some(boost::asio::null_buffers(),
+    _strand.wrap(boost::bind(&RedisAsyncClient::handleRead, shared_from_this(), boost::asio::placeholders::error)));
+}
+
+void RedisAsyncClient::stopRead()
+{
+  _wantRead = false;
+}
+
+void RedisAsyncClient::startWrite()
+{
+  _wantWrite = true;
+  if (_writing || !_socket)
+  {
+    return;
+  }
+  _writing = true;
+  _socket->async_write_some(boost::asio::null_buffers(),
+    _strand.wrap(boost::bind(&RedisAsyncClient::handleWrite, shared_from_this(), boost::asio::placeholders::error)));
+}
+
+void RedisAsyncClient::stopWrite()
+{
+  _wantWrite = false;
+}
+
+void RedisAsyncClient::cleanup()
+{
+  _wantRead = false;
+  _wantWrite = false;
+  if (_socket)
+  {
+    boost::system::error_code ignored;
+    _socket->cancel(ignored);
+    _socket->release();
+    _socket.reset();
+  }
+  //
+  // Handlers of the released descriptor still come back, aborted.  Let
+  // the next connection start its own.
+  //
+  _reading = false;
+  _writing = false;
+}
+
+void RedisAsyncClient::handleRead(const boost::system::error_code& e)
+{
+  if (e == boost::asio::error::operation_aborted)
+  {
+    return;
+  }
+  _reading = false;
+  
+  //
+  // Errors are left for hiredis to find when it reads the socket
+  //
+  if (_context && _wantRead)
+  {
+    redisAsyncHandleRead(_context);
+  }
+  
+  if (_context && _wantRead)
+  {
+    startRead();
+  }
+}
+
+void RedisAsyncClient::handleWrite(const boost::system::error_code& e)
+{
+  if (e == boost::asio::error::operation_aborted)
+  {
+    return;
+  }
+  _writing = false;
+  
+  if (_context && _wantWrite)
+  {
+    redisAsyncHandleWrite(_context);
+  }
+  
+  if (_context && _wantWrite)
+  {
+    startWrite();
+  }
+}
+
+struct RedisAsyncClient::ScanState
+{
+  std::string pattern;
+  std::string count;
+  std::string cursor;
+  ScanCallback callback;
+};
+
+void RedisAsyncClient::scan(const std::string& pattern, const ScanCallback& callback, unsigned int count)
+{
+  ScanStatePtr state(new ScanState());
+  state->pattern = pattern;
+  state->count = boost::lexical_cast<std::string>(count);
+  state->cursor = "0";
+  state->callback = callback;
+  nextScan(state);
+}
+
+void RedisAsyncClient::nextScan(const ScanStatePtr& state)
+{
+  Command command;
+  command.reserve(6);
+  command.push_back("SCAN");
+  command.push_back(state->cursor);
+  command.push_back("MATCH");
+  command.push_back(state->pattern);
+  command.push_back("COUNT");
+  command.push_back(state->count);
+  execute(command, boost::bind(&RedisAsyncClient::onScanReply, shared_from_this(), state, _1));
+}
+
+void RedisAsyncClient::onScanReply(const ScanStatePtr& state, const Reply& reply)
+{
+  std::vector<std::string> keys;
+  if (!reply.ok() || reply.type != REDIS_REPLY_ARRAY || reply.elements.size() != 2)
+  {
+    state->callback(keys, true);
+    return;
+  }
+  
+  state->cursor = reply.elements[0].str;
+  const std::vector<Reply>& elements = reply.elements[1].elements;
+  keys.reserve(elements.size());
+  for (std::vector<Reply>::const_iterator iter = elements.begin(); iter != elements.end(); iter++)
+  {
+    keys.push_back(iter->str);
+  }
+  
+  bool done = state->cursor == "0";
+  if (state->callback(keys, done) && !done)
+  {
+    nextScan(state);
+  }
+}
+
+//
+// Blocking helpers
+//
+
+struct RedisAsyncSyncState
+{
+  RedisAsyncSyncState() : done(false), cancelled(false), pages(0) {}
+  OSS::mutex_critic_sec mutex;
+  boost::condition_variable condition;
+  bool done;
+  bool cancelled; /// Set when the waiter gave up so the scan stops
+  std::size_t pages; /// Number of SCAN replies received
+  RedisAsyncClient::Reply reply;
+  std::vector<std::string> keys;
+};
+typedef boost::shared_ptr<RedisAsyncSyncState> RedisAsyncSyncStatePtr;
+
+static void redis_async_sync_reply(const RedisAsyncSyncStatePtr& state, const RedisAsyncClient::Reply& reply)
+{
+  OSS::mutex_critic_sec_lock lock(state->mutex);
+  state->reply = reply;
+  state->done = true;
+  state->condition.notify_all();
+}
+
+static bool redis_async_sync_scan(const RedisAsyncSyncStatePtr& state, const std::vector<std::string>& keys, bool done)
+{
+  OSS::mutex_critic_sec_lock lock(state->mutex);
+  state->keys.insert(state->keys.end(), keys.begin(), keys.end());
+  ++state->pages;
+  state->done = done;
+  state->condition.notify_all();
+  return !state->cancelled;
+}
+
+static bool redis_async_sync_wait(const RedisAsyncSyncStatePtr& state, unsigned int timeoutMs)
+{
+  boost::unique_lock<OSS::mutex_critic_sec> lock(state->mutex);
+  boost::system_time deadline = boost::get_system_time() + boost::posix_time::milliseconds(timeoutMs);
+  while (!state->done)
+  {
+    if (!state->condition.timed_wait(lock, deadline))
+    {
+      return state->done;
+    }
+  }
+  return true;
+}
+
+bool RedisAsyncClient::executeSync(const Command& command, Reply& reply, unsigned int timeoutMs)
+{
+  RedisAsyncSyncStatePtr state(new RedisAsyncSyncState());
+  execute(command, boost::bind(redis_async_sync_reply, state, _1));
+  if (!redis_async_sync_wait(state, timeoutMs))
+  {
+    return false;
+  }
+  reply = state->reply;
+  return reply.ok();
+}
+
+bool RedisAsyncClient::executeTransactionSync(const Commands& commands, Reply& reply, unsigned int timeoutMs)
+{
+  RedisAsyncSyncStatePtr state(new RedisAsyncSyncState());
+  executeTransaction(commands, boost::bind(redis_async_sync_reply, state, _1));
+  if (!redis_async_sync_wait(state, timeoutMs))
+  {
+    return false;
+  }
+  reply = state->reply;
+  return reply.ok() && reply.type == REDIS_REPLY_ARRAY;
+}
+
+bool RedisAsyncClient::scanSync(const std::string& pattern, std::vector<std::string>& keys, unsigned int count)
+{
+  RedisAsyncSyncStatePtr state(new RedisAsyncSyncState());
+  scan(pattern, boost::bind(redis_async_sync_scan, state, _1, _2), count);
+  
+  //
+  // Each round trip gets its own timeout.  A page without matching keys
+  // still counts as progress.
+  //
+  boost::unique_lock<OSS::mutex_critic_sec> lock(state->mutex);
+  std::size_t pages = state->pages;
+  boost::system_time deadline = boost::get_system_time() + boost::posix_time::milliseconds((long)DEFAULT_TIMEOUT_MS);
+  while (!state->done)
+  {
+    if (!state->condition.timed_wait(lock, deadline) && !state->done && state->pages == pages)
+    {
+      state->cancelled = true;
+      return false;
+    }
+    if (state->pages != pages)
+    {
+      pages = state->pages;
+      deadline = boost::get_system_time() + boost::posix_time::milliseconds((long)DEFAULT_TIMEOUT_MS);
+    }
+  }
+  
+  std::sort(state->keys.begin(), state->keys.end());
+  state->keys.erase(std::unique(state->keys.begin(), state->keys.end()), state->keys.end());
+  keys.insert(keys.end(), state->keys.begin(), state->keys.end());
+  return true;
+}
+
+bool RedisAsyncClient::waitForConnection(unsigned int timeoutMs)
+{
+  boost::unique_lock<OSS::mutex_critic_sec> lock(_stateMutex);
+  boost::system_time deadline = boost::get_system_time() + boost::posix_time::milliseconds(timeoutMs);
+  while (_state != CONNECTED)
+  {
+    if (!_stateCondition.timed_wait(lock, deadline))
+    {
+      return _state == CONNECTED;
+    }
+  }
+  return true;
+}
+
+
+} } // OSS::Persistent
+
+
+#endif // OSS_HAVE_HIREDIS
+
+#endif // ENABLE_FEATURE_REDIS
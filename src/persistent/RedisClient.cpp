@@ -21,6 +21,9 @@
 
 #if OSS_HAVE_HIREDIS
 
+#include <set>
+#include <algorithm>
+
 namespace OSS {
 namespace Persistent {
   
@@ -463,6 +466,14 @@ std::string RedisClient::getStatusString(const std::vector<std::string>& args) c
 }
 
 
+bool RedisClient::executeCommand(const std::vector<std::string>& args)
+{
+  redisReply* reply = execute(args);
+  bool ok = reply && reply->type != REDIS_REPLY_ERROR;
+  freeReply(reply);
+  return ok;
+}
+
 void RedisClient::execute(const std::vector<std::string>& args, std::ostream& strm) const
 {
   redisReply* reply = const_cast<RedisClient*>(this)->execute(args);
@@ -715,9 +726,10 @@ bool RedisClient::hset(const std::string& key, const std::string& name, const st
   std::vector<std::string> args;
   args.push_back("HSET");
   args.push_back(key);
+  args.push_back(name);
   args.push_back(value);
-  std::string status = getStatusString(args);
-  return status == "0" || status == "1";
+  long long result = 0;
+  return getReplyInt(args, result);
 }
 
 bool RedisClient::hincrby(const std::string& key, const std::string& name, int increment, long long& result)
@@ -741,6 +753,7 @@ bool RedisClient::hmset(const std::string& key, const std::map<std::string, std:
 {
   std::vector<std::string> args;
   args.push_back("HMSET");
+  args.push_back(key);
 
   for (std::map<std::string, std::string>::const_iterator iter = hmap.begin(); iter != hmap.end(); iter++)
   {
@@ -748,7 +761,8 @@ bool RedisClient::hmset(const std::string& key, const std::map<std::string, std:
     args.push_back(iter->second);
   }
   std::string status = getStatusString(args);
-  return status == "0" || status == "1";
+  OSS::string_to_lower(status);
+  return status == "ok";
 }
 
 bool RedisClient::get(const std::string& key, json::Object& value) const
@@ -783,11 +797,33 @@ bool RedisClient::getAll(std::vector<std::string>& values, const std::string& pa
 {
   std::vector<std::string> keys;
   getKeys(pattern, keys);
-  for (std::vector<std::string>::const_iterator iter = keys.begin(); iter != keys.end(); iter++)
+  
+  //
+  // Fetch the values with one MGET per batch instead of one GET per key.
+  // Keys deleted since the scan come back as nil and are skipped.  Empty
+  // values are kept.
+  //
+  for (std::size_t offset = 0; offset < keys.size(); offset += SCAN_COUNT)
   {
-    std::string value;
-    if (get(*iter, value))
-      values.push_back(value);
+    std::size_t end = std::min(keys.size(), offset + SCAN_COUNT);
+    std::vector<std::string> args;
+    args.reserve(end - offset + 1);
+    args.push_back("MGET");
+    args.insert(args.end(), keys.begin() + offset, keys.begin() + end);
+    
+    redisReply* reply = execute(args);
+    if (reply && reply->type == REDIS_REPLY_ARRAY)
+    {
+      for (size_t i = 0; i < reply->elements; i++)
+      {
+        redisReply* item = reply->element[i];
+        if (item && item->type == REDIS_REPLY_STRING)
+        {
+          values.push_back(std::string(item->str, item->len));
+        }
+      }
+    }
+    freeReply(reply);
   }
 
   return !values.empty();
@@ -854,10 +890,46 @@ bool RedisClient::hmget(const std::string& key, const std::vector<std::string>&
 
 bool RedisClient::getKeys(const std::string& pattern, std::vector<std::string>& keys)
 {
-  std::vector<std::string> args;
-  args.push_back("KEYS");
-  args.push_back(pattern);
-  keys = getReplyStringArray(args);
+  //
+  // KEYS walks the whole keyspace in one command and stalls every other
+  // client while it runs.  SCAN does the same walk in small batches.  It may
+  // return a key more than once so the result is deduplicated.
+  //
+  std::set<std::string> found;
+  std::string cursor = "0";
+  std::string count = boost::lexical_cast<std::string>((int)SCAN_COUNT);
+  do
+  {
+    std::vector<std::string> args;
+    args.push_back("SCAN");
+    args.push_back(cursor);
+    args.push_back("MATCH");
+    args.push_back(pattern);
+    args.push_back("COUNT");
+    args.push_back(count);
+    
+    redisReply* reply = execute(args);
+    if (!reply || reply->type != REDIS_REPLY_ARRAY || reply->elements != 2 ||
+      reply->element[0]->type != REDIS_REPLY_STRING || reply->element[1]->type != REDIS_REPLY_ARRAY)
+    {
+      freeReply(reply);
+      break;
+    }
+    
+    cursor = std::string(reply->element[0]->str, reply->element[0]->len);
+    redisReply* batch = reply->element[1];
+    for (size_t i = 0; i < batch->elements; i++)
+    {
+      redisReply* item = batch->element[i];
+      if (item && item->type == REDIS_REPLY_STRING)
+      {
+        found.insert(std::string(item->str, item->len));
+      }
+    }
+    freeReply(reply);
+  } while (cursor != "0");
+  
+  keys.assign(found.begin(), found.end());
   return !keys.empty();
 }
 
@@ -881,7 +953,10 @@ bool RedisClient::hdel(const std::string& key, const std::string& field)
 }
 
 RedisBroadcastClient::RedisBroadcastClient() :
-  _defaultClient(0)
+  _defaultClient(0),
+  _pWork(0),
+  _pIoThread(0),
+  _timeout(RedisAsyncClient::DEFAULT_TIMEOUT_MS)
 {
 }
 
@@ -938,6 +1013,21 @@ bool RedisBroadcastClient::connect(const std::string& tcpHost, int tcpPort, cons
       }
     }
     _pool[key.str()] = client;
+    
+    //
+    // Writes go to every server at once through an async client driven by
+    // our own io thread.  It keeps retrying in the background, the same as
+    // allowReconnect does for the blocking client.
+    //
+    if (!_pIoThread)
+    {
+      _ioService.reset();
+      _pWork = new boost::asio::io_service::work(_ioService);
+      _pIoThread = new boost::thread(boost::bind(&boost::asio::io_service::run, &_ioService));
+    }
+    RedisAsyncClient::Ptr asyncClient = RedisAsyncClient::create(_ioService, tcpHost, tcpPort);
+    asyncClient->connect(password, db);
+    _asyncPool[key.str()] = asyncClient;
   }
   return true;
 }
@@ -951,38 +1041,150 @@ void RedisBroadcastClient::disconnect()
     delete client;
   }
   _pool.clear();
+  _defaultClient = 0;
+  
+  for (AsyncPool::iterator iter = _asyncPool.begin(); iter != _asyncPool.end(); iter++)
+  {
+    iter->second->disconnect();
+  }
+  _asyncPool.clear();
+  
+  if (_pIoThread)
+  {
+    //
+    // Give pending writes a chance to complete before tearing down the
+    // io_service
+    //
+    delete _pWork;
+    _pWork = 0;
+    if (!_pIoThread->timed_join(boost::posix_time::milliseconds(_timeout)))
+    {
+      _ioService.stop();
+      _pIoThread->join();
+    }
+    delete _pIoThread;
+    _pIoThread = 0;
+  }
 }
 
-bool RedisBroadcastClient::set(const std::string& key, const json::Object& value, int expires)
+struct RedisBroadcastState
+{
+  RedisBroadcastState() : pending(0), succeeded(0) {}
+  OSS::mutex_critic_sec mutex;
+  boost::condition_variable condition;
+  int pending;
+  int succeeded;
+};
+typedef boost::shared_ptr<RedisBroadcastState> RedisBroadcastStatePtr;
+
+static void redis_broadcast_reply(const RedisBroadcastStatePtr& state, const RedisAsyncClient::Reply& reply)
 {
+  OSS::mutex_critic_sec_lock lock(state->mutex);
+  if (reply.ok())
+  {
+    ++state->succeeded;
+  }
+  if (--state->pending == 0)
+  {
+    state->condition.notify_all();
+  }
+}
+
+int RedisBroadcastClient::broadcast(const std::vector<std::string>& args)
+{
+  //
+  // Send to every connected server before waiting on any of them so the
+  // call costs one round trip to the slowest server instead of the sum of
+  // all of them.  Servers without a live async connection go through the
+  // blocking client which reconnects on demand.
+  //
+  std::vector<RedisAsyncClient::Ptr> targets;
+  std::vector<RedisClient*> fallback;
+  targets.reserve(_pool.size());
   for (Pool::iterator iter = _pool.begin(); iter != _pool.end(); iter++)
   {
-    RedisClient* client = iter->second;
-    client->set(key, value, expires);
+    AsyncPool::iterator asyncClient = _asyncPool.find(iter->first);
+    if (asyncClient != _asyncPool.end() && asyncClient->second->isConnected())
+    {
+      targets.push_back(asyncClient->second);
+    }
+    else
+    {
+      fallback.push_back(iter->second);
+    }
+  }
+  
+  RedisBroadcastStatePtr state(new RedisBroadcastState());
+  state->pending = targets.size();
+  for (std::vector<RedisAsyncClient::Ptr>::iterator iter = targets.begin(); iter != targets.end(); iter++)
+  {
+    (*iter)->execute(args, boost::bind(redis_broadcast_reply, state, _1));
+  }
+  
+  int succeeded = 0;
+  for (std::vector<RedisClient*>::iterator iter = fallback.begin(); iter != fallback.end(); iter++)
+  {
+    if ((*iter)->executeCommand(args))
+    {
+      ++succeeded;
+    }
+  }
+  
+  boost::unique_lock<OSS::mutex_critic_sec> lock(state->mutex);
+  boost::system_time deadline = boost::get_system_time() + boost::posix_time::milliseconds(_timeout);
+  while (state->pending > 0)
+  {
+    if (!state->condition.timed_wait(lock, deadline))
+    {
+      OSS_LOG_WARNING("[REDIS] Broadcast timed out waiting for " << state->pending << " server(s)");
+      break;
+    }
+  }
+  return succeeded + state->succeeded;
+}
+
+bool RedisBroadcastClient::set(const std::string& key, const json::Object& value, int expires)
+{
+  try
+  {
+    std::ostringstream strm;
+    json::Writer::Write(value, strm);
+    set(key, strm.str(), expires);
+  }
+  catch(std::exception& error)
+  {
+    OSS_LOG_ERROR("[REDIS] RedisBroadcastClient::Set ERROR: " << error.what());
   }
   return true;
 }
 
 bool RedisBroadcastClient::set(const std::string& key, const std::string& value, int expires)
 {
-  bool ok = false;
-  for (Pool::iterator iter = _pool.begin(); iter != _pool.end(); iter++)
+  std::vector<std::string> args;
+  if (expires == -1)
   {
-    RedisClient* client = iter->second;
-    ok ? client->set(key, value, expires) : ok = client->set(key, value, expires);
+    args.push_back("SET");
+    args.push_back(key);
+    args.push_back(value);
   }
-  return ok;
+  else
+  {
+    args.push_back("SETEX");
+    args.push_back(key);
+    args.push_back(boost::lexical_cast<std::string>(expires));
+    args.push_back(value);
+  }
+  return broadcast(args) > 0;
 }
 
 bool RedisBroadcastClient::hset(const std::string& key, const std::string& name, const std::string& value)
 {
-  bool ok = false;
-  for (Pool::iterator iter = _pool.begin(); iter != _pool.end(); iter++)
-  {
-    RedisClient* client = iter->second;
-    ok ? client->hset(key, name, value) : ok = client->hset(key, name, value);
-  }
-  return ok;
+  std::vector<std::string> args;
+  args.push_back("HSET");
+  args.push_back(key);
+  args.push_back(name);
+  args.push_back(value);
+  return broadcast(args) > 0;
 }
 
 bool RedisBroadcastClient::get(const std::string& key, json::Object& value) const
@@ -1104,11 +1306,10 @@ bool RedisBroadcastClient::getKeys(const std::string& pattern, std::vector<std::
 
 bool RedisBroadcastClient::del(const std::string& key)
 {
-  for (Pool::iterator iter = _pool.begin(); iter != _pool.end(); iter++)
-  {
-    RedisClient* client = iter->second;
-    client->del(key);
-  }
+  std::vector<std::string> args;
+  args.push_back("DEL");
+  args.push_back(key);
+  broadcast(args);
   return true;
 }
   
@@ -35,6 +35,16 @@ RaftConnection::~RaftConnection()
 {
 }
 
+int RaftConnection::onSendInstallSnapshot(msg_installsnapshot_t& data)
+{
+  return -1;
+}
+
+int RaftConnection::onSendInstallSnapshotResponse(msg_installsnapshot_response_t& data)
+{
+  return -1;
+}
+
 
 } } // OSS::RAFT
 
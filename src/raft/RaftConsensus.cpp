@@ -19,6 +19,7 @@
 //
 
 #include "OSS/UTL/CoreUtils.h"
+#include "OSS/UTL/Logger.h"
 #include "OSS/RAFT/RaftConsensus.h"
 
 
@@ -47,7 +48,6 @@ static int rc_send_requestvote(
   raft_node_t* node,
   msg_requestvote_t* m)
 {
-  std::cout << ((RaftConsensus*)user_data)->opt().node_id <<  "----> rc_send_requestvote" << std::endl;
   Node raftNode(node);
   return ((RaftConsensus*)user_data)->onSendRequestVote(raftNode, *m);
 }
@@ -61,9 +61,8 @@ static int rc_send_appendentries(
   raft_node_t* node,
   msg_appendentries_t* m)
 {
-  std::cout << ((RaftConsensus*)user_data)->opt().node_id << "----> rc_send_appendentries" << std::endl;
   Node raftNode(node);
-  return ((RaftConsensus*)user_data)->onSendAppendEntries(raftNode, *m);
+  return ((RaftConsensus*)user_data)->sendAppendEntries(raftNode, *m);
 }
 
 //
@@ -74,7 +73,6 @@ static int rc_applylog(
   void* user_data,
   raft_entry_t* ety)
 {
-  std::cout << ((RaftConsensus*)user_data)->opt().node_id << "----> rc_applylog" << std::endl;
   return ((RaftConsensus*)user_data)->onApplyEntry(*ety);
 }
 
@@ -87,8 +85,7 @@ static int rc_persist_vote(
     void *user_data,
     const int voted_for )
 {
-  std::cout << ((RaftConsensus*)user_data)->opt().node_id << "----> rc_persist_vote" << std::endl;
-  return ((RaftConsensus*)user_data)->onPersistVote(voted_for);
+  return ((RaftConsensus*)user_data)->persistVote(voted_for);
 }
 
 //
@@ -100,12 +97,13 @@ static int rc_persist_term(
   void* user_data,
   const int current_term )
 {
-  std::cout << ((RaftConsensus*)user_data)->opt().node_id << "----> rc_persist_term" << std::endl;
-  return ((RaftConsensus*)user_data)->onPersistTerm(current_term);
+  return ((RaftConsensus*)user_data)->persistTerm(current_term);
 }
 
 //
-// Raft callback for appending an item to the log
+// Raft callback for appending an item to the log.
+// ety_idx is the slot in the libraft ring buffer.  The entry is always
+// appended after the current last index.
 //
 static int rc_log_offer(
     raft_server_t* raft,
@@ -113,8 +111,7 @@ static int rc_log_offer(
     raft_entry_t* ety,
     int ety_idx )
 {
-  std::cout << ((RaftConsensus*)user_data)->opt().node_id << "----> rc_log_offer" << std::endl;
-  return ((RaftConsensus*)user_data)->onAppendEntry(*ety, ety_idx);
+  return ((RaftConsensus*)user_data)->logAppend(*ety, raft_get_current_idx(raft) + 1);
 }
 
 //
@@ -126,14 +123,14 @@ static void rc_node_has_sufficient_logs(
     void *user_data,
     raft_node_t* node)
 { 
-  std::cout << ((RaftConsensus*)user_data)->opt().node_id << "----> rc_node_has_sufficient_logs" << std::endl;
   Node raftNode(node);
   ((RaftConsensus*)user_data)->onSufficientLogs(raftNode);
 }
 
 //
-// Raft callback for removing the first entry from the log
-// note this is provided to support log compaction in the future
+// Raft callback for removing the first entry from the log.  This happens
+// when the log is compacted behind a snapshot.  RaftLog drops its copy of
+// the entries itself in takeSnapshot().
 //
 static int rc_log_poll(
     raft_server_t* raft,
@@ -141,14 +138,14 @@ static int rc_log_poll(
     raft_entry_t* entry,
     int ety_idx )
 {
-  std::cout << ((RaftConsensus*)user_data)->opt().node_id <<  "----> rc_log_poll" << std::endl;
   return 0;
 }
 
 //
 // Raft callback for deleting the most recent entry from the log.
 // This happens when an invalid leader finds a valid leader and has to delete
-// superseded log entries. 
+// superseded log entries.  Entries are popped one at a time from the tail
+// so the entry being removed is always the current last index.
 //
 static int rc_log_try_pop(
   raft_server_t* raft,
@@ -156,8 +153,7 @@ static int rc_log_try_pop(
   raft_entry_t* entry,
   int ety_idx)
 {
-  std::cout << ((RaftConsensus*)user_data)->opt().node_id << "----> rc_log_try_pop" << std::endl;
-  return 0;
+  return ((RaftConsensus*)user_data)->logPop(*entry, raft_get_current_idx(raft));
 }
 
 //
@@ -169,7 +165,7 @@ static void rc_log(
   void *user_data,
   const char *buf)
 {
-  std::cout << ((RaftConsensus*)user_data)->opt().node_id <<  "----> rc_log " << buf << std::endl;
+  OSS_LOG_DEBUG("RaftConsensus node " << ((RaftConsensus*)user_data)->opt().node_id << " - " << buf);
 }
   
 void rc_init_func()
@@ -192,7 +188,14 @@ void rc_init_func()
 
 
 RaftConsensus::RaftConsensus() :
-  _raft(0)
+  _raft(0),
+  _restoring(false),
+  _fixupIndex(0),
+  _batchDepth(0),
+  _forceSends(false),
+  _lastEntryId(0),
+  _incomingSnapshotIndex(0),
+  _incomingSnapshotTerm(0)
 {
 }
 
@@ -237,6 +240,14 @@ bool RaftConsensus::initialize(const Options& options)
     return false;
   }
   
+  //
+  // Reload term, vote and entries from an earlier run
+  //
+  if (!_opt.log_directory.empty() && !restoreLog())
+  {
+    return false;
+  }
+  
   //
   // Start as master
   //
@@ -253,6 +264,62 @@ bool RaftConsensus::initialize(const Options& options)
   return true;
 }
 
+bool RaftConsensus::restoreLog()
+{
+  OSS::mutex_lock lock(_raftMutex);
+  if (!_log.open(_opt.log_directory))
+  {
+    return false;
+  }
+  
+  //
+  // Everything handed to libraft here is already on disk.  _restoring keeps
+  // the callbacks from writing it again.
+  //
+  _restoring = true;
+  raft_set_current_term(_raft, _log.getTerm());
+  if (_log.getVote() != -1)
+  {
+    raft_vote_for_nodeid(_raft, _log.getVote());
+  }
+  
+  bool restored = true;
+  if (_log.getSnapshotIndex() > 0)
+  {
+    raft_load_snapshot(_raft, _log.getSnapshotIndex(), _log.getSnapshotTerm());
+    if (!onInstallSnapshot(_log.getSnapshotData()))
+    {
+      OSS_LOG_ERROR("RaftConsensus::restoreLog - Unable to install snapshot at index " << _log.getSnapshotIndex());
+      restored = false;
+    }
+  }
+  
+  for (int index = _log.getFirstIndex(); restored && index <= _log.getLastIndex(); index++)
+  {
+    const RaftLog::Entry* pEntry = _log.getEntry(index);
+    raft_entry_t entry;
+    entry.term = pEntry->term;
+    entry.id = pEntry->id;
+    entry.type = pEntry->type;
+    entry.data.buf = (void*)pEntry->data.data();
+    entry.data.len = pEntry->data.size();
+    if (raft_append_entry(_raft, &entry) != 0)
+    {
+      OSS_LOG_ERROR("RaftConsensus::restoreLog - Unable to restore entry " << index);
+      restored = false;
+      break;
+    }
+    if (entry.id > _lastEntryId)
+    {
+      _lastEntryId = entry.id;
+    }
+  }
+  _restoring = false;
+  
+  OSS_LOG_INFO("RaftConsensus::restoreLog - Restored snapshot at index " << _log.getSnapshotIndex() << " and " << raft_get_log_count(_raft) << " entries at term " << _log.getTerm() << " from " << _opt.log_directory);
+  return restored;
+}
+
 bool RaftConsensus::addNode(int node_id)
 {
   OSS::mutex_lock lock(_raftMutex);
@@ -283,6 +350,8 @@ void RaftConsensus::removeNode(int node_id)
   {
     raft_remove_node(_raft, iter->second.node());
     _nodes.erase(node_id);
+    _peers.erase(node_id);
+    _pendingSends.erase(node_id);
   }
 }
 
@@ -297,30 +366,437 @@ bool RaftConsensus::findNode(int node_id, Node& node)
   }
   return false;
 }
+
+bool RaftConsensus::submit(const std::string& data)
+{
+  if (!isLeader())
+  {
+    return false;
+  }
+  OSS::mutex_critic_sec_lock lock(_submitMutex);
+  _submitted.push_back(data);
+  _submitCondition.notify_one();
+  return true;
+}
+
+bool RaftConsensus::isLeader()
+{
+  OSS::mutex_lock lock(_raftMutex);
+  return !!raft_is_leader(_raft);
+}
+
+int RaftConsensus::getLeaderId()
+{
+  OSS::mutex_lock lock(_raftMutex);
+  return raft_get_current_leader(_raft);
+}
+
+int RaftConsensus::getCurrentIndex()
+{
+  OSS::mutex_lock lock(_raftMutex);
+  return raft_get_current_idx(_raft);
+}
+
+int RaftConsensus::getCommitIndex()
+{
+  OSS::mutex_lock lock(_raftMutex);
+  return raft_get_commit_idx(_raft);
+}
+
+int RaftConsensus::getSnapshotIndex()
+{
+  OSS::mutex_lock lock(_raftMutex);
+  return _log.getSnapshotIndex();
+}
+
+bool RaftConsensus::takeSnapshot()
+{
+  OSS::mutex_lock lock(_raftMutex);
+  int index = raft_get_last_applied_idx(_raft);
+  if (index <= _log.getSnapshotIndex())
+  {
+    return true;
+  }
+  
+  const RaftLog::Entry* pEntry = _log.getEntry(index);
+  if (!pEntry)
+  {
+    return false;
+  }
+  int term = pEntry->term;
+  
+  std::string data;
+  if (!onCreateSnapshot(data) || !_log.compact(index, term, data))
+  {
+    return false;
+  }
+  
+  //
+  // RaftLog no longer holds the entries libraft points to.  Drop them from
+  // libraft before anything else can look at them.
+  //
+  raft_compact_log(_raft, index, term);
+  
+  OSS_LOG_INFO("RaftConsensus::takeSnapshot - Node " << _opt.node_id << " compacted its log up to index " << index << " (" << data.size() << " bytes of state)");
+  return true;
+}
+
+bool RaftConsensus::isSnapshotDue()
+{
+  OSS::mutex_lock lock(_raftMutex);
+  return raft_get_last_applied_idx(_raft) - _log.getSnapshotIndex() >= _opt.snapshot_threshold;
+}
+
+std::size_t RaftConsensus::getLogSyncCount()
+{
+  OSS::mutex_lock lock(_raftMutex);
+  return _log.getSyncCount();
+}
   
-void RaftConsensus::callPeriodicTimer()
+void RaftConsensus::callPeriodicTimer(int elapsed)
 {
   OSS::mutex_lock lock(_raftMutex);
-  raft_periodic(_raft, _opt.periodic_timer_ms);
+  beginBatch();
+  //
+  // Whatever libraft sends from here is a heartbeat and must go out even
+  // if it carries nothing new
+  //
+  _forceSends = true;
+  raft_periodic(_raft, elapsed);
+  endBatch();
+}
+
+void RaftConsensus::processSubmitted()
+{
+  Submitted submitted;
+  {
+    OSS::mutex_critic_sec_lock lock(_submitMutex);
+    submitted.swap(_submitted);
+  }
+  if (submitted.empty())
+  {
+    return;
+  }
+  
+  OSS::mutex_lock lock(_raftMutex);
+  beginBatch();
+  for (Submitted::iterator iter = submitted.begin(); iter != submitted.end(); iter++)
+  {
+    msg_entry_t entry;
+    msg_entry_response_t response;
+    entry.id = ++_lastEntryId;
+    if (!entry.id)
+    {
+      // libraft rejects an id of zero
+      entry.id = ++_lastEntryId;
+    }
+    entry.type = RAFT_LOGTYPE_NORMAL;
+    entry.data.buf = (void*)iter->data();
+    entry.data.len = iter->size();
+    if (raft_recv_entry(_raft, &entry, &response) != 0)
+    {
+      OSS_LOG_WARNING("RaftConsensus::processSubmitted - Dropped " << (submitted.end() - iter) << " entries.  Node " << _opt.node_id << " is not the leader");
+      break;
+    }
+  }
+  
+  //
+  // libraft only sends a new entry to followers that have everything
+  // before it.  Queue every follower so the ones that are still behind get
+  // the batch pipelined after what is already in flight to them.
+  //
+  for (Nodes::iterator iter = _nodes.begin(); iter != _nodes.end(); iter++)
+  {
+    if (iter->first != _opt.node_id)
+    {
+      _pendingSends.insert(iter->first);
+    }
+  }
+  endBatch();
 }
 
 void RaftConsensus::onTerminate()
 {
-  _sem.set();
+  OSS::mutex_critic_sec_lock lock(_submitMutex);
+  _submitCondition.notify_all();
 }
 
 void RaftConsensus::main()
 {
-  while (!_terminateFlag && !_sem.wait(_opt.periodic_timer_ms))
+  OSS::UInt64 lastTick = OSS::getTime();
+  while (!_terminateFlag)
   {
-    callPeriodicTimer();
+    {
+      OSS::UInt64 elapsed = OSS::getTime() - lastTick;
+      boost::unique_lock<OSS::mutex_critic_sec> lock(_submitMutex);
+      if (_submitted.empty() && elapsed < (OSS::UInt64)_opt.periodic_timer_ms)
+      {
+        _submitCondition.timed_wait(lock, boost::posix_time::milliseconds((long)(_opt.periodic_timer_ms - elapsed)));
+      }
+    }
+    
+    processSubmitted();
+    
+    if (_opt.snapshot_threshold > 0 && isSnapshotDue())
+    {
+      takeSnapshot();
+    }
+    
+    OSS::UInt64 now = OSS::getTime();
+    if (now - lastTick >= (OSS::UInt64)_opt.periodic_timer_ms)
+    {
+      callPeriodicTimer((int)(now - lastTick));
+      lastTick = OSS::getTime();
+    }
   }
 }
 
 void RaftConsensus::becomeMaster()
 {
   OSS::mutex_lock lock(_raftMutex);
+  beginBatch();
+  _forceSends = true;
   raft_become_leader(_raft);
+  endBatch();
+}
+
+void RaftConsensus::beginBatch()
+{
+  _batchDepth++;
+}
+
+void RaftConsensus::endBatch()
+{
+  if (--_batchDepth > 0)
+  {
+    return;
+  }
+  
+  fixupEntries();
+  
+  //
+  // A single flush makes every entry appended during the batch durable.
+  // Nothing may be sent or acknowledged before it completes.
+  //
+  if (!_log.sync())
+  {
+    _pendingSends.clear();
+    _forceSends = false;
+    return;
+  }
+  
+  raft_apply_all(_raft);
+  
+  if (!raft_is_leader(_raft))
+  {
+    _pendingSends.clear();
+    _peers.clear();
+    _forceSends = false;
+    return;
+  }
+  
+  std::set<int> pendingSends;
+  pendingSends.swap(_pendingSends);
+  bool forceSends = _forceSends;
+  _forceSends = false;
+  
+  int currentIndex = raft_get_current_idx(_raft);
+  int commitIndex = raft_get_commit_idx(_raft);
+  for (std::set<int>::iterator iter = pendingSends.begin(); iter != pendingSends.end(); iter++)
+  {
+    raft_node_t* node = raft_get_node(_raft, *iter);
+    if (!node || *iter == _opt.node_id)
+    {
+      continue;
+    }
+    
+    //
+    // Entries up to sentIndex are already on their way to the peer.  Send
+    // the ones after them instead of waiting for the response.
+    //
+    Peer& peer = _peers[*iter];
+    int nextIndex = raft_node_get_next_idx(node);
+    if (peer.sentIndex >= nextIndex)
+    {
+      raft_node_set_next_idx(node, peer.sentIndex + 1);
+    }
+    else
+    {
+      peer.sentIndex = nextIndex - 1;
+    }
+    
+    //
+    // The entries this peer needs next were compacted.  It gets the
+    // snapshot one chunk at a time, each sent when the previous one was
+    // acknowledged or again with the heartbeat.
+    //
+    if (peer.sentIndex < _log.getSnapshotIndex())
+    {
+      if (forceSends || !peer.snapshotInFlight)
+      {
+        sendSnapshot(node, peer);
+      }
+      continue;
+    }
+    
+    if (!forceSends && peer.sentIndex >= currentIndex && peer.sentCommit >= commitIndex)
+    {
+      continue;
+    }
+    raft_send_appendentries(_raft, node);
+  }
+}
+
+void RaftConsensus::fixupEntries()
+{
+  //
+  // libraft keeps the payload pointer of the message an entry arrived in.
+  // Point it at the copy owned by the log before that message goes away.
+  //
+  if (!_fixupIndex)
+  {
+    return;
+  }
+  int currentIndex = raft_get_current_idx(_raft);
+  for (int index = _fixupIndex; index <= currentIndex; index++)
+  {
+    raft_entry_t* pEntry = raft_get_entry_from_idx(_raft, index);
+    const RaftLog::Entry* pLogEntry = _log.getEntry(index);
+    if (pEntry && pLogEntry)
+    {
+      pEntry->data.buf = (void*)pLogEntry->data.data();
+      pEntry->data.len = pLogEntry->data.size();
+    }
+  }
+  _fixupIndex = 0;
+}
+
+int RaftConsensus::sendAppendEntries(Node& node, msg_appendentries_t& data)
+{
+  if (_batchDepth > 0)
+  {
+    _pendingSends.insert(node.getId());
+    return 0;
+  }
+  
+  if (_opt.max_entries_per_message > 0 && data.n_entries > _opt.max_entries_per_message)
+  {
+    data.n_entries = _opt.max_entries_per_message;
+  }
+  
+  //
+  // The connection may send fewer entries than offered if they do not fit
+  // in one message
+  //
+  int ret = onSendAppendEntries(node, data);
+  Peer& peer = _peers[node.getId()];
+  peer.sentIndex = data.prev_log_idx + data.n_entries;
+  peer.sentCommit = data.leader_commit;
+  return ret;
+}
+
+void RaftConsensus::sendSnapshot(raft_node_t* node, Peer& peer)
+{
+  const std::string& snapshot = _log.getSnapshotData();
+  if (peer.snapshotIndex != _log.getSnapshotIndex())
+  {
+    peer.snapshotIndex = _log.getSnapshotIndex();
+    peer.snapshotOffset = 0;
+  }
+  
+  msg_installsnapshot_t data;
+  data.term = raft_get_current_term(_raft);
+  data.last_included_idx = _log.getSnapshotIndex();
+  data.last_included_term = _log.getSnapshotTerm();
+  data.size = snapshot.size();
+  data.offset = peer.snapshotOffset;
+  data.data = snapshot.data() + peer.snapshotOffset;
+  data.len = (unsigned int)std::min<OSS::UInt64>(snapshot.size() - peer.snapshotOffset, _opt.snapshot_chunk_size);
+  
+  peer.snapshotInFlight = true;
+  Node raftNode(node);
+  onSendInstallSnapshot(raftNode, data);
+}
+
+bool RaftConsensus::installSnapshot(int index, int term)
+{
+  if (!_log.installSnapshot(index, term, _incomingSnapshot))
+  {
+    return false;
+  }
+  
+  //
+  // Same as in takeSnapshot().  libraft must forget the entries RaftLog
+  // just dropped.
+  //
+  raft_load_snapshot(_raft, index, term);
+  _fixupIndex = 0;
+  
+  std::string().swap(_incomingSnapshot);
+  _incomingSnapshotIndex = 0;
+  _incomingSnapshotTerm = 0;
+  
+  OSS_LOG_INFO("RaftConsensus::installSnapshot - Node " << _opt.node_id << " installed snapshot at index " << index);
+  return onInstallSnapshot(_log.getSnapshotData());
+}
+
+int RaftConsensus::logAppend(const raft_entry_t& entry, int index)
+{
+  if (_restoring)
+  {
+    return 0;
+  }
+  if (!_log.append(entry))
+  {
+    return -1;
+  }
+  if (!_fixupIndex || index < _fixupIndex)
+  {
+    _fixupIndex = index;
+  }
+  return onAppendEntry(entry, index);
+}
+
+int RaftConsensus::logPop(const raft_entry_t& entry, int index)
+{
+  if (_restoring)
+  {
+    return 0;
+  }
+  if (_fixupIndex >= index)
+  {
+    _fixupIndex = 0;
+  }
+  return _log.truncate(index) ? 0 : -1;
+}
+
+int RaftConsensus::persistVote(int vote)
+{
+  if (_restoring)
+  {
+    return 0;
+  }
+  if (!_log.persistState(raft_get_current_term(_raft), vote))
+  {
+    return -1;
+  }
+  return onPersistVote(vote);
+}
+
+int RaftConsensus::persistTerm(int term)
+{
+  if (_restoring)
+  {
+    return 0;
+  }
+  //
+  // libraft clears the vote whenever the term changes
+  //
+  if (!_log.persistState(term, -1))
+  {
+    return -1;
+  }
+  return onPersistTerm(term);
 }
 
 int RaftConsensus::onSendRequestVote(Node& node, msg_requestvote_t& data)
@@ -343,6 +819,16 @@ int RaftConsensus::onSendAppendEntries(Node& node, msg_appendentries_t& data)
   return -1;
 }
 
+int RaftConsensus::onSendInstallSnapshot(Node& node, msg_installsnapshot_t& data)
+{
+  Connection::Ptr pConnection = findOrCreateConnection(node);
+  if (pConnection)
+  {
+    return pConnection->onSendInstallSnapshot(data);
+  }
+  return -1;
+}
+
 int RaftConsensus::onReceivedRequestVote(const Connection::Ptr& pConnection, msg_requestvote_t& data)
 {
   OSS::mutex_lock lock(_raftMutex);
@@ -362,23 +848,158 @@ int RaftConsensus::onReceivedAppendEntries(const Connection::Ptr& pConnection, m
   
   int ret = 0;
   msg_appendentries_response_t response;
+  beginBatch();
   ret = raft_recv_appendentries(_raft, pConnection->getNode().node(), &data, &response);
-  if (ret != 0)
-  {
-    return ret;
-  }
-  return pConnection->onSendAppendEntriesResponse(response);
+  endBatch();
+  
+  //
+  // A rejection is answered too.  The leader needs it to back up nextIndex
+  // for this node.
+  //
+  int sent = pConnection->onSendAppendEntriesResponse(response);
+  return ret != 0 ? ret : sent;
 }
 
 int RaftConsensus::onReceivedRequestVoteResponse(const Connection::Ptr& pConnection, msg_requestvote_response_t& data)
 {
   OSS::mutex_lock lock(_raftMutex);
-  return raft_recv_requestvote_response(_raft, pConnection->getNode().node(), &data);
+  beginBatch();
+  if (!raft_is_leader(_raft))
+  {
+    // Winning the election sends the first heartbeats from here
+    _forceSends = true;
+  }
+  int ret = raft_recv_requestvote_response(_raft, pConnection->getNode().node(), &data);
+  endBatch();
+  return ret;
 }
 int RaftConsensus::onReceivedAppendEntriesResponse(const Connection::Ptr& pConnection, msg_appendentries_response_t& data)
 {
   OSS::mutex_lock lock(_raftMutex);
-  return raft_recv_appendentries_response(_raft, pConnection->getNode().node(), &data);
+  raft_node_t* node = pConnection->getNode().node();
+  int nextIndex = node ? raft_node_get_next_idx(node) : 0;
+  int commitIndex = raft_get_commit_idx(_raft);
+  
+  beginBatch();
+  int ret = raft_recv_appendentries_response(_raft, node, &data);
+  if (node && !data.success && raft_node_get_next_idx(node) < nextIndex)
+  {
+    //
+    // The peer is missing entries.  Whatever was sent after the gap is
+    // useless so resend from the new nextIndex.
+    //
+    Peer& peer = _peers[raft_node_get_id(node)];
+    peer.sentIndex = raft_node_get_next_idx(node) - 1;
+  }
+  if (raft_is_leader(_raft) && raft_get_commit_idx(_raft) > commitIndex)
+  {
+    //
+    // Tell the followers about the new commit index now rather than with
+    // the next heartbeat so they can apply the entries too
+    //
+    for (Nodes::iterator iter = _nodes.begin(); iter != _nodes.end(); iter++)
+    {
+      _pendingSends.insert(iter->first);
+    }
+  }
+  endBatch();
+  return ret;
+}
+
+int RaftConsensus::onReceivedInstallSnapshot(const Connection::Ptr& pConnection, msg_installsnapshot_t& data)
+{
+  OSS::mutex_lock lock(_raftMutex);
+  
+  msg_installsnapshot_response_t response;
+  response.last_included_idx = data.last_included_idx;
+  response.offset = 0;
+  response.success = 0;
+  
+  beginBatch();
+  int ret = raft_recv_installsnapshot(_raft, pConnection->getNode().node(), data.term);
+  if (ret == 0)
+  {
+    response.success = 1;
+    if (data.last_included_idx <= raft_get_commit_idx(_raft))
+    {
+      //
+      // Everything in the snapshot is already here
+      //
+      response.offset = data.size;
+    }
+    else
+    {
+      if (data.offset == 0 || data.last_included_idx != _incomingSnapshotIndex || data.last_included_term != _incomingSnapshotTerm)
+      {
+        _incomingSnapshot.clear();
+        _incomingSnapshotIndex = data.last_included_idx;
+        _incomingSnapshotTerm = data.last_included_term;
+      }
+      
+      //
+      // A chunk that does not continue what we have is answered with the
+      // offset we need so the leader resends from there
+      //
+      if (data.offset == _incomingSnapshot.size())
+      {
+        _incomingSnapshot.append(data.data, data.len);
+      }
+      response.offset = _incomingSnapshot.size();
+      
+      if (_incomingSnapshot.size() == data.size && !installSnapshot(data.last_included_idx, data.last_included_term))
+      {
+        response.success = 0;
+        response.offset = 0;
+      }
+    }
+  }
+  response.term = raft_get_current_term(_raft);
+  endBatch();
+  
+  int sent = pConnection->onSendInstallSnapshotResponse(response);
+  return ret != 0 ? ret : sent;
+}
+
+int RaftConsensus::onReceivedInstallSnapshotResponse(const Connection::Ptr& pConnection, msg_installsnapshot_response_t& data)
+{
+  OSS::mutex_lock lock(_raftMutex);
+  raft_node_t* node = pConnection->getNode().node();
+  
+  beginBatch();
+  if (raft_get_current_term(_raft) < data.term)
+  {
+    raft_set_current_term(_raft, data.term);
+    raft_become_follower(_raft);
+  }
+  else if (node && raft_is_leader(_raft))
+  {
+    Peer& peer = _peers[raft_node_get_id(node)];
+    if (peer.snapshotIndex && data.last_included_idx == peer.snapshotIndex)
+    {
+      peer.snapshotInFlight = false;
+      if (data.success && data.offset >= _log.getSnapshotData().size())
+      {
+        //
+        // Installed.  Replication continues with the entries after it.
+        //
+        raft_node_set_next_idx(node, peer.snapshotIndex + 1);
+        if (raft_node_get_match_idx(node) < peer.snapshotIndex)
+        {
+          raft_node_set_match_idx(node, peer.snapshotIndex);
+        }
+        peer.sentIndex = peer.snapshotIndex;
+        peer.snapshotIndex = 0;
+        peer.snapshotOffset = 0;
+      }
+      else
+      {
+        peer.snapshotOffset = data.offset;
+      }
+      _pendingSends.insert(raft_node_get_id(node));
+    }
+  }
+  endBatch();
+  return 0;
 }
 
 int RaftConsensus::onApplyEntry(const raft_entry_t& entry)
@@ -405,6 +1026,16 @@ void RaftConsensus::onSufficientLogs(Node& node)
 {
 }
 
+bool RaftConsensus::onCreateSnapshot(std::string& data)
+{
+  return false;
+}
+
+bool RaftConsensus::onInstallSnapshot(const std::string& data)
+{
+  return true;
+}
+
 
 RaftConsensus::Connection::Ptr RaftConsensus::findConnection(int id)
 {
@@ -443,7 +1074,7 @@ void RaftConsensus::removeConnection(int id)
 {
   Connection::Ptr pConnection;
   pConnection = findConnection(id);
-  if (!pConnection)
+  if (pConnection)
   {
     pConnection->shutdown();
     OSS::mutex_critic_sec_lock lock(_connectionMutex);
@@ -452,5 +1083,3 @@ void RaftConsensus::removeConnection(int id)
 }
 
 } } // OSS::RAFT
-
-
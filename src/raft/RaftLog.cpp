@@ -0,0 +1,624 @@
+// Library: OSS_CORE - Foundation API for SIP B2BUA
+// Copyright (c) OSS Software Solutions
+// Contributor: Joegen Baclor - mailto:joegen@ossapp.com
+//
+// Permission is hereby granted, to any person or organization
+// obtaining a copy of the software and accompanying documentation covered by
+// this license (the "Software") to use, execute, and to prepare
+// derivative works of the Software, all subject to the
+// "GNU Lesser General Public License (LGPL)".
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+// SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+// FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+
+
+#include "OSS/RAFT/RaftLog.h"
+#include "OSS/UTL/Logger.h"
+#include <boost/filesystem.hpp>
+#include <boost/crc.hpp>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+
+
+namespace OSS {
+namespace RAFT {
+
+
+static const std::size_t RECORD_HEADER_SIZE = 20;   // length, crc, term, id, type
+static const std::size_t STATE_SLOT_SIZE = 16;      // sequence, term, vote, crc
+static const std::size_t SEGMENT_HEADER_SIZE = 8;   // magic, index before the first record
+static const std::size_t SNAPSHOT_HEADER_SIZE = 24; // magic, index, term, size(8), crc
+static const char SEGMENT_MAGIC[] = "RLOG";
+static const char SNAPSHOT_MAGIC[] = "RSNP";
+
+
+static void rl_put_u32(char* buf, OSS::UInt32 value)
+{
+  buf[0] = (char)(value >> 24);
+  buf[1] = (char)(value >> 16);
+  buf[2] = (char)(value >> 8);
+  buf[3] = (char)(value);
+}
+
+static OSS::UInt32 rl_get_u32(const char* buf)
+{
+  const unsigned char* p = (const unsigned char*)buf;
+  return ((OSS::UInt32)p[0] << 24) | ((OSS::UInt32)p[1] << 16) | ((OSS::UInt32)p[2] << 8) | (OSS::UInt32)p[3];
+}
+
+static OSS::UInt32 rl_crc(const char* buf, std::size_t len)
+{
+  boost::crc_32_type crc;
+  crc.process_bytes(buf, len);
+  return (OSS::UInt32)crc.checksum();
+}
+
+static bool rl_read_all(int fd, std::string& buf)
+{
+  char chunk[65536];
+  for (;;)
+  {
+    ssize_t len = ::pread(fd, chunk, sizeof(chunk), (off_t)buf.size());
+    if (len < 0 && errno == EINTR)
+    {
+      continue;
+    }
+    if (len < 0)
+    {
+      return false;
+    }
+    if (len == 0)
+    {
+      return true;
+    }
+    buf.append(chunk, len);
+  }
+}
+
+static bool rl_write_all(int fd, const char* buf, std::size_t len)
+{
+  while (len)
+  {
+    ssize_t written = ::write(fd, buf, len);
+    if (written < 0)
+    {
+      if (errno == EINTR)
+      {
+        continue;
+      }
+      return false;
+    }
+    buf += written;
+    len -= written;
+  }
+  return true;
+}
+
+
+RaftLog::RaftLog() :
+  _logFd(-1),
+  _stateFd(-1),
+  _base(0),
+  _snapshotTerm(0),
+  _fileSize(0),
+  _dirty(false),
+  _term(0),
+  _vote(-1),
+  _stateSequence(0),
+  _syncCount(0)
+{
+}
+
+RaftLog::~RaftLog()
+{
+  close();
+}
+
+bool RaftLog::open(const std::string& directory)
+{
+  if (isOpen())
+  {
+    return false;
+  }
+
+  boost::system::error_code ec;
+  boost::filesystem::create_directories(directory, ec);
+
+  std::string logFile = (boost::filesystem::path(directory) / "raft.log").string();
+  std::string stateFile = (boost::filesystem::path(directory) / "raft.state").string();
+
+  _logFd = ::open(logFile.c_str(), O_RDWR | O_CREAT | O_APPEND, 0644);
+  if (_logFd == -1)
+  {
+    OSS_LOG_ERROR("RaftLog::open - Unable to open " << logFile << ": " << strerror(errno));
+    return false;
+  }
+
+  _stateFd = ::open(stateFile.c_str(), O_RDWR | O_CREAT, 0644);
+  if (_stateFd == -1)
+  {
+    OSS_LOG_ERROR("RaftLog::open - Unable to open " << stateFile << ": " << strerror(errno));
+    ::close(_logFd);
+    _logFd = -1;
+    return false;
+  }
+
+  _directory = directory;
+  if (!loadState() || !loadSnapshot() || !load())
+  {
+    close();
+    return false;
+  }
+  return true;
+}
+
+void RaftLog::close()
+{
+  if (_logFd != -1)
+  {
+    sync();
+    ::close(_logFd);
+    _logFd = -1;
+  }
+  if (_stateFd != -1)
+  {
+    ::close(_stateFd);
+    _stateFd = -1;
+  }
+}
+
+bool RaftLog::load()
+{
+  std::string buf;
+  if (!rl_read_all(_logFd, buf))
+  {
+    OSS_LOG_ERROR("RaftLog::load - Unable to read segment file: " << strerror(errno));
+    return false;
+  }
+
+  _entries.clear();
+  _offsets.clear();
+  _pending.clear();
+
+  if (buf.size() < SEGMENT_HEADER_SIZE)
+  {
+    //
+    // New segment or one that crashed before its header was written.
+    // Numbering continues after the snapshot.
+    //
+    char header[SEGMENT_HEADER_SIZE];
+    memcpy(header, SEGMENT_MAGIC, 4);
+    rl_put_u32(header + 4, (OSS::UInt32)_base);
+    if (::ftruncate(_logFd, 0) != 0 || !rl_write_all(_logFd, header, sizeof(header)) || ::fdatasync(_logFd) != 0)
+    {
+      OSS_LOG_ERROR("RaftLog::load - Unable to initialize segment file: " << strerror(errno));
+      return false;
+    }
+    _fileSize = SEGMENT_HEADER_SIZE;
+    _dirty = false;
+    return true;
+  }
+
+  if (memcmp(buf.data(), SEGMENT_MAGIC, 4) != 0)
+  {
+    OSS_LOG_ERROR("RaftLog::load - " << _directory << " does not contain a raft log segment");
+    return false;
+  }
+
+  //
+  // Records the snapshot already covers are left over from a crash between
+  // writing the snapshot and rewriting the segment.  They are skipped.
+  //
+  int index = (int)rl_get_u32(buf.data() + 4);
+  bool stale = index < _base;
+  if (index > _base)
+  {
+    OSS_LOG_ERROR("RaftLog::load - Segment in " << _directory << " starts after index " << index << " but the snapshot ends at " << _base);
+    return false;
+  }
+
+  std::size_t offset = SEGMENT_HEADER_SIZE;
+  while (buf.size() - offset >= RECORD_HEADER_SIZE)
+  {
+    const char* record = buf.data() + offset;
+    OSS::UInt32 length = rl_get_u32(record);
+    if (length < RECORD_HEADER_SIZE - 8 || length > buf.size() - offset - 8)
+    {
+      break;
+    }
+    if (rl_get_u32(record + 4) != rl_crc(record + 8, length))
+    {
+      break;
+    }
+
+    if (++index > _base)
+    {
+      _entries.push_back(Entry());
+      Entry& entry = _entries.back();
+      entry.term = rl_get_u32(record + 8);
+      entry.id = rl_get_u32(record + 12);
+      entry.type = (int)rl_get_u32(record + 16);
+      entry.data.assign(record + RECORD_HEADER_SIZE, length + 8 - RECORD_HEADER_SIZE);
+      _offsets.push_back(offset);
+    }
+    offset += length + 8;
+  }
+
+  if (offset != buf.size())
+  {
+    //
+    // The tail was not written completely.  Nothing after it was ever
+    // acknowledged so it is safe to drop.
+    //
+    OSS_LOG_WARNING("RaftLog::load - Dropping " << buf.size() - offset << " bytes of incomplete log in " << _directory);
+    if (::ftruncate(_logFd, (off_t)offset) != 0 || ::fdatasync(_logFd) != 0)
+    {
+      OSS_LOG_ERROR("RaftLog::load - Unable to truncate segment file: " << strerror(errno));
+      return false;
+    }
+  }
+
+  _fileSize = offset;
+  _dirty = false;
+
+  if (stale)
+  {
+    //
+    // Finish the interrupted rewrite.  Otherwise new records would be
+    // appended after the stale ones and numbered from the old header on
+    // the next load, which would drop acknowledged entries.
+    //
+    OSS_LOG_WARNING("RaftLog::load - Rebasing segment in " << _directory << " on snapshot index " << _base);
+    if (!rewriteSegment(_base, 0))
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool RaftLog::loadSnapshot()
+{
+  std::string snapshotFile = (boost::filesystem::path(_directory) / "raft.snapshot").string();
+  int fd = ::open(snapshotFile.c_str(), O_RDONLY);
+  if (fd == -1)
+  {
+    return errno == ENOENT;
+  }
+
+  std::string buf;
+  bool read = rl_read_all(fd, buf);
+  ::close(fd);
+
+  //
+  // The snapshot is renamed into place only once complete.  A bad one
+  // means the disk is damaged and the compacted entries are gone.
+  //
+  OSS::UInt64 size = 0;
+  if (read && buf.size() >= SNAPSHOT_HEADER_SIZE)
+  {
+    size = ((OSS::UInt64)rl_get_u32(buf.data() + 12) << 32) | rl_get_u32(buf.data() + 16);
+  }
+  if (!read || buf.size() < SNAPSHOT_HEADER_SIZE ||
+    memcmp(buf.data(), SNAPSHOT_MAGIC, 4) != 0 ||
+    size != buf.size() - SNAPSHOT_HEADER_SIZE ||
+    rl_get_u32(buf.data() + 20) != rl_crc(buf.data() + SNAPSHOT_HEADER_SIZE, size))
+  {
+    OSS_LOG_ERROR("RaftLog::loadSnapshot - " << snapshotFile << " is corrupt");
+    return false;
+  }
+
+  _base = (int)rl_get_u32(buf.data() + 4);
+  _snapshotTerm = (int)rl_get_u32(buf.data() + 8);
+  _snapshot.assign(buf, SNAPSHOT_HEADER_SIZE, std::string::npos);
+  return true;
+}
+
+bool RaftLog::writeSnapshot(int index, int term, const std::string& data)
+{
+  boost::filesystem::path directory(_directory);
+  std::string snapshotFile = (directory / "raft.snapshot").string();
+  std::string tempFile = (directory / "raft.snapshot.tmp").string();
+
+  char header[SNAPSHOT_HEADER_SIZE];
+  memcpy(header, SNAPSHOT_MAGIC, 4);
+  rl_put_u32(header + 4, (OSS::UInt32)index);
+  rl_put_u32(header + 8, (OSS::UInt32)term);
+  rl_put_u32(header + 12, (OSS::UInt32)((OSS::UInt64)data.size() >> 32));
+  rl_put_u32(header + 16, (OSS::UInt32)data.size());
+  rl_put_u32(header + 20, rl_crc(data.data(), data.size()));
+
+  int fd = ::open(tempFile.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  bool written = fd != -1 &&
+    rl_write_all(fd, header, sizeof(header)) &&
+    rl_write_all(fd, data.data(), data.size()) &&
+    ::fdatasync(fd) == 0;
+  if (fd != -1)
+  {
+    ::close(fd);
+  }
+
+  if (!written || ::rename(tempFile.c_str(), snapshotFile.c_str()) != 0 || !syncDirectory())
+  {
+    OSS_LOG_ERROR("RaftLog::writeSnapshot - Unable to write " << snapshotFile << ": " << strerror(errno));
+    ::unlink(tempFile.c_str());
+    return false;
+  }
+  return true;
+}
+
+bool RaftLog::rewriteSegment(int base, std::size_t first)
+{
+  boost::filesystem::path directory(_directory);
+  std::string logFile = (directory / "raft.log").string();
+  std::string tempFile = (directory / "raft.log.tmp").string();
+
+  //
+  // Build the new segment next to the old one and swap it in with a rename
+  // so a crash leaves one or the other, never a mix
+  //
+  std::string pending;
+  pending.swap(_pending);
+  _pending.resize(SEGMENT_HEADER_SIZE);
+  memcpy(&_pending[0], SEGMENT_MAGIC, 4);
+  rl_put_u32(&_pending[4], (OSS::UInt32)base);
+  Offsets offsets;
+  for (std::size_t i = first; i < _entries.size(); i++)
+  {
+    offsets.push_back(_pending.size());
+    encode(_entries[i]);
+  }
+  std::string segment;
+  segment.swap(_pending);
+  _pending.swap(pending);
+
+  int fd = ::open(tempFile.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_APPEND, 0644);
+  if (fd == -1 ||
+    !rl_write_all(fd, segment.data(), segment.size()) ||
+    ::fdatasync(fd) != 0 ||
+    ::rename(tempFile.c_str(), logFile.c_str()) != 0 ||
+    !syncDirectory())
+  {
+    OSS_LOG_ERROR("RaftLog::rewriteSegment - Unable to write " << logFile << ": " << strerror(errno));
+    if (fd != -1)
+    {
+      ::close(fd);
+    }
+    ::unlink(tempFile.c_str());
+    return false;
+  }
+
+  ::close(_logFd);
+  _logFd = fd;
+  _offsets.swap(offsets);
+  _fileSize = segment.size();
+  _pending.clear();
+  _dirty = false;
+  _syncCount++;
+  return true;
+}
+
+bool RaftLog::syncDirectory()
+{
+  int fd = ::open(_directory.c_str(), O_RDONLY | O_DIRECTORY);
+  if (fd == -1)
+  {
+    return false;
+  }
+  bool synced = ::fsync(fd) == 0;
+  ::close(fd);
+  return synced;
+}
+
+bool RaftLog::compact(int index, int term, const std::string& data)
+{
+  if (index <= _base || index > getLastIndex())
+  {
+    return false;
+  }
+
+  std::size_t count = index - _base;
+  if (isOpen() && (!writeSnapshot(index, term, data) || !rewriteSegment(index, count)))
+  {
+    return false;
+  }
+
+  //
+  // rewriteSegment() already replaced the offsets with the ones of the
+  // entries that are kept
+  //
+  _entries.erase(_entries.begin(), _entries.begin() + count);
+  _base = index;
+  _snapshotTerm = term;
+  _snapshot = data;
+  return true;
+}
+
+bool RaftLog::installSnapshot(int index, int term, const std::string& data)
+{
+  if (isOpen() && (!writeSnapshot(index, term, data) || !rewriteSegment(index, _entries.size())))
+  {
+    return false;
+  }
+
+  _entries.clear();
+  _offsets.clear();
+  _base = index;
+  _snapshotTerm = term;
+  _snapshot = data;
+  return true;
+}
+
+bool RaftLog::loadState()
+{
+  char buf[STATE_SLOT_SIZE * 2];
+  ssize_t len = ::pread(_stateFd, buf, sizeof(buf), 0);
+  if (len < 0)
+  {
+    OSS_LOG_ERROR("RaftLog::loadState - Unable to read state file: " << strerror(errno));
+    return false;
+  }
+
+  //
+  // The state is written to two slots in turn so a torn write never
+  // destroys the last good copy.  The valid slot with the highest
+  // sequence wins.
+  //
+  bool found = false;
+  for (std::size_t slot = 0; (slot + 1) * STATE_SLOT_SIZE <= (std::size_t)len; slot++)
+  {
+    const char* state = buf + slot * STATE_SLOT_SIZE;
+    if (rl_get_u32(state + 12) != rl_crc(state, 12))
+    {
+      continue;
+    }
+    OSS::UInt32 sequence = rl_get_u32(state);
+    if (!found || sequence > _stateSequence)
+    {
+      found = true;
+      _stateSequence = sequence;
+      _term = (int)rl_get_u32(state + 4);
+      _vote = (int)rl_get_u32(state + 8);
+    }
+  }
+  return true;
+}
+
+bool RaftLog::writeState()
+{
+  if (_stateFd == -1)
+  {
+    return true;
+  }
+
+  char state[STATE_SLOT_SIZE];
+  _stateSequence++;
+  rl_put_u32(state, _stateSequence);
+  rl_put_u32(state + 4, (OSS::UInt32)_term);
+  rl_put_u32(state + 8, (OSS::UInt32)_vote);
+  rl_put_u32(state + 12, rl_crc(state, 12));
+
+  off_t offset = (off_t)((_stateSequence % 2) * STATE_SLOT_SIZE);
+  if (::pwrite(_stateFd, state, sizeof(state), offset) != (ssize_t)sizeof(state) || ::fdatasync(_stateFd) != 0)
+  {
+    OSS_LOG_ERROR("RaftLog::writeState - Unable to write state file: " << strerror(errno));
+    return false;
+  }
+  return true;
+}
+
+bool RaftLog::persistState(int term, int vote)
+{
+  _term = term;
+  _vote = vote;
+  return writeState();
+}
+
+void RaftLog::encode(const Entry& entry)
+{
+  std::size_t start = _pending.size();
+  _pending.resize(start + RECORD_HEADER_SIZE);
+  _pending.append(entry.data);
+
+  char* record = &_pending[start];
+  rl_put_u32(record, (OSS::UInt32)(entry.data.size() + RECORD_HEADER_SIZE - 8));
+  rl_put_u32(record + 8, entry.term);
+  rl_put_u32(record + 12, entry.id);
+  rl_put_u32(record + 16, (OSS::UInt32)entry.type);
+  rl_put_u32(record + 4, rl_crc(record + 8, _pending.size() - start - 8));
+}
+
+bool RaftLog::append(const raft_entry_t& entry)
+{
+  _entries.push_back(Entry());
+  Entry& stored = _entries.back();
+  stored.term = entry.term;
+  stored.id = entry.id;
+  stored.type = entry.type;
+  if (entry.data.buf && entry.data.len)
+  {
+    stored.data.assign((const char*)entry.data.buf, entry.data.len);
+  }
+
+  if (isOpen())
+  {
+    _offsets.push_back(_fileSize + _pending.size());
+    encode(stored);
+  }
+  return true;
+}
+
+bool RaftLog::truncate(int index)
+{
+  if (index <= _base)
+  {
+    return false;
+  }
+  if (index > getLastIndex())
+  {
+    return true;
+  }
+
+  std::size_t position = index - _base - 1;
+  if (isOpen())
+  {
+    OSS::UInt64 offset = _offsets[position];
+    if (offset >= _fileSize)
+    {
+      _pending.resize(offset - _fileSize);
+    }
+    else
+    {
+      _pending.clear();
+      if (::ftruncate(_logFd, (off_t)offset) != 0)
+      {
+        OSS_LOG_ERROR("RaftLog::truncate - Unable to truncate segment file: " << strerror(errno));
+        return false;
+      }
+      _fileSize = offset;
+      _dirty = true;
+    }
+    _offsets.resize(position);
+  }
+  _entries.resize(position);
+  return true;
+}
+
+bool RaftLog::sync()
+{
+  if (!isOpen() || (_pending.empty() && !_dirty))
+  {
+    return true;
+  }
+
+  if (!rl_write_all(_logFd, _pending.data(), _pending.size()) || ::fdatasync(_logFd) != 0)
+  {
+    OSS_LOG_ERROR("RaftLog::sync - Unable to write segment file: " << strerror(errno));
+    //
+    // Drop whatever part of the batch made it to the file.  The entries
+    // stay pending and are written again by the next sync.
+    //
+    if (::ftruncate(_logFd, (off_t)_fileSize) == 0)
+    {
+      _dirty = true;
+    }
+    return false;
+  }
+
+  _fileSize += _pending.size();
+  _pending.clear();
+  _dirty = false;
+  _syncCount++;
+  return true;
+}
+
+
+} } // OSS::RAFT
@@ -0,0 +1,311 @@
+// Library: OSS_CORE - Foundation API for SIP B2BUA
+// Copyright (c) OSS Software Solutions
+// Contributor: Joegen Baclor - mailto:joegen@ossapp.com
+//
+// Permission is hereby granted, to any person or organization
+// obtaining a copy of the software and accompanying documentation covered by
+// this license (the "Software") to use, execute, and to prepare
+// derivative works of the Software, all subject to the
+// "GNU Lesser General Public License (LGPL)".
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+// SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+// FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+
+
+
+#include "OSS/RAFT/RaftTcpConnection.h"
+#if ENABLE_FEATURE_NET_EXTRA
+
+#include "OSS/RAFT/RaftConsensus.h"
+#include "OSS/Net/FramedTcpConnection.h"
+#include "OSS/UTL/CoreUtils.h"
+#include "OSS/UTL/Logger.h"
+#include <cstring>
+
+
+namespace OSS {
+namespace RAFT {
+
+
+//
+// Room left in a frame for the fields of a message around its payload
+//
+static const std::size_t RAFT_TCP_MESSAGE_OVERHEAD = 64;
+
+
+RaftTcpMessage::RaftTcpMessage(Type type, int from) :
+  _type(type),
+  _from(from),
+  _pRead(0),
+  _readLen(0),
+  _readPos(0)
+{
+  write((int)type);
+  write(from);
+}
+
+RaftTcpMessage::RaftTcpMessage(const char* data, std::size_t len) :
+  _type((Type)0),
+  _from(0),
+  _pRead(data),
+  _readLen(len),
+  _readPos(0)
+{
+  int type = 0;
+  int from = 0;
+  if (read(type) && read(from) && type >= REQUEST_VOTE && type <= FORWARD)
+  {
+    _type = (Type)type;
+    _from = from;
+  }
+}
+
+void RaftTcpMessage::write(int value)
+{
+  _data.append((const char*)&value, sizeof(value));
+}
+
+void RaftTcpMessage::write(OSS::UInt64 value)
+{
+  _data.append((const char*)&value, sizeof(value));
+}
+
+void RaftTcpMessage::write(const char* data, unsigned int len)
+{
+  write((int)len);
+  _data.append(data, len);
+}
+
+bool RaftTcpMessage::read(int& value)
+{
+  if (_readLen - _readPos < sizeof(value))
+  {
+    return false;
+  }
+  memcpy(&value, _pRead + _readPos, sizeof(value));
+  _readPos += sizeof(value);
+  return true;
+}
+
+bool RaftTcpMessage::read(OSS::UInt64& value)
+{
+  if (_readLen - _readPos < sizeof(value))
+  {
+    return false;
+  }
+  memcpy(&value, _pRead + _readPos, sizeof(value));
+  _readPos += sizeof(value);
+  return true;
+}
+
+bool RaftTcpMessage::read(const char*& data, unsigned int& len)
+{
+  int size = 0;
+  if (!read(size) || size < 0 || _readLen - _readPos < (std::size_t)size)
+  {
+    return false;
+  }
+  data = _pRead + _readPos;
+  len = size;
+  _readPos += size;
+  return true;
+}
+
+
+RaftTcpConnection::RaftTcpConnection(RaftConsensus* pRaft, RaftNode& node, const std::string& address, const std::string& port) :
+  RaftConnection(pRaft, node),
+  _pWork(new boost::asio::io_service::work(_ioService)),
+  _pThread(0),
+  _client(_ioService),
+  _address(address),
+  _port(port),
+  _lastConnectAttempt(0),
+  _pendingCount(0)
+{
+  _pThread = new boost::thread(boost::bind(&boost::asio::io_service::run, &_ioService));
+}
+
+RaftTcpConnection::~RaftTcpConnection()
+{
+  shutdown();
+}
+
+void RaftTcpConnection::shutdown()
+{
+  boost::thread* pThread = 0;
+  {
+    OSS::mutex_critic_sec_lock lock(_pendingMutex);
+    std::swap(pThread, _pThread);
+  }
+  if (!pThread)
+  {
+    return;
+  }
+  delete _pWork;
+  _pWork = 0;
+  _ioService.stop();
+  pThread->join();
+  delete pThread;
+  _client.close();
+}
+
+int RaftTcpConnection::send(const RaftTcpMessage& message)
+{
+  {
+    OSS::mutex_critic_sec_lock lock(_pendingMutex);
+    if (!_pThread || _pendingCount >= RAFT_TCP_MAX_PENDING_MESSAGES)
+    {
+      return -1;
+    }
+    _pendingCount++;
+  }
+  _ioService.post(boost::bind(&RaftTcpConnection::write, this, message.data()));
+  return 0;
+}
+
+void RaftTcpConnection::write(const std::string& data)
+{
+  {
+    OSS::mutex_critic_sec_lock lock(_pendingMutex);
+    _pendingCount--;
+  }
+  
+  if (!_client.isConnected())
+  {
+    OSS::UInt64 now = OSS::getTime();
+    if (now - _lastConnectAttempt < RAFT_TCP_RECONNECT_INTERVAL_MS)
+    {
+      return;
+    }
+    _lastConnectAttempt = now;
+    if (!_client.connect(_address, _port))
+    {
+      OSS_LOG_DEBUG("RaftTcpConnection::write - Unable to connect to node " << _node.getId() << " at " << _address << ":" << _port);
+      return;
+    }
+    OSS_LOG_INFO("RaftTcpConnection::write - Connected to node " << _node.getId() << " at " << _address << ":" << _port);
+  }
+  
+  if (!_client.send(data))
+  {
+    OSS_LOG_WARNING("RaftTcpConnection::write - Lost connection to node " << _node.getId() << " at " << _address << ":" << _port);
+    _client.close();
+  }
+}
+
+int RaftTcpConnection::onSendRequestVote(msg_requestvote_t& data)
+{
+  RaftTcpMessage message(RaftTcpMessage::REQUEST_VOTE, _pRaft->opt().node_id);
+  message.write(data.term);
+  message.write(data.candidate_id);
+  message.write(data.last_log_idx);
+  message.write(data.last_log_term);
+  return send(message);
+}
+
+int RaftTcpConnection::onSendAppendEntries(msg_appendentries_t& data)
+{
+  //
+  // Send only as many entries as fit in a frame.  RaftConsensus sends the
+  // rest with the next message.
+  //
+  int count = 0;
+  std::size_t size = RAFT_TCP_MESSAGE_OVERHEAD;
+  for (; count < data.n_entries; count++)
+  {
+    size += RaftTcpMessage::ENTRY_OVERHEAD + data.entries[count].data.len;
+    if (size > FTCP_MAX_PACKET_SIZE)
+    {
+      break;
+    }
+  }
+  if (count == 0 && data.n_entries > 0)
+  {
+    OSS_LOG_ERROR("RaftTcpConnection::onSendAppendEntries - Entry " << data.prev_log_idx + 1 << " is too large to send (" << data.entries[0].data.len << " bytes)");
+    return -1;
+  }
+  data.n_entries = count;
+  
+  RaftTcpMessage message(RaftTcpMessage::APPEND_ENTRIES, _pRaft->opt().node_id);
+  message.write(data.term);
+  message.write(data.prev_log_idx);
+  message.write(data.prev_log_term);
+  message.write(data.leader_commit);
+  message.write(data.n_entries);
+  for (int i = 0; i < data.n_entries; i++)
+  {
+    const msg_entry_t& entry = data.entries[i];
+    message.write((int)entry.term);
+    message.write((int)entry.id);
+    message.write(entry.type);
+    message.write((const char*)entry.data.buf, entry.data.len);
+  }
+  return send(message);
+}
+
+int RaftTcpConnection::onSendRequestVoteResponse(msg_requestvote_response_t& data)
+{
+  RaftTcpMessage message(RaftTcpMessage::REQUEST_VOTE_RESPONSE, _pRaft->opt().node_id);
+  message.write(data.term);
+  message.write(data.vote_granted);
+  return send(message);
+}
+
+int RaftTcpConnection::onSendAppendEntriesResponse(msg_appendentries_response_t& data)
+{
+  RaftTcpMessage message(RaftTcpMessage::APPEND_ENTRIES_RESPONSE, _pRaft->opt().node_id);
+  message.write(data.term);
+  message.write(data.success);
+  message.write(data.current_idx);
+  message.write(data.first_idx);
+  return send(message);
+}
+
+int RaftTcpConnection::onSendInstallSnapshot(msg_installsnapshot_t& data)
+{
+  if (data.len + RAFT_TCP_MESSAGE_OVERHEAD > FTCP_MAX_PACKET_SIZE)
+  {
+    data.len = FTCP_MAX_PACKET_SIZE - RAFT_TCP_MESSAGE_OVERHEAD;
+  }
+  
+  RaftTcpMessage message(RaftTcpMessage::INSTALL_SNAPSHOT, _pRaft->opt().node_id);
+  message.write(data.term);
+  message.write(data.last_included_idx);
+  message.write(data.last_included_term);
+  message.write(data.size);
+  message.write(data.offset);
+  message.write(data.data, data.len);
+  return send(message);
+}
+
+int RaftTcpConnection::onSendInstallSnapshotResponse(msg_installsnapshot_response_t& data)
+{
+  RaftTcpMessage message(RaftTcpMessage::INSTALL_SNAPSHOT_RESPONSE, _pRaft->opt().node_id);
+  message.write(data.term);
+  message.write(data.last_included_idx);
+  message.write(data.offset);
+  message.write(data.success);
+  return send(message);
+}
+
+int RaftTcpConnection::sendForward(const std::string& data)
+{
+  if (data.size() + RAFT_TCP_MESSAGE_OVERHEAD > FTCP_MAX_PACKET_SIZE)
+  {
+    return -1;
+  }
+  RaftTcpMessage message(RaftTcpMessage::FORWARD, _pRaft->opt().node_id);
+  message.write(data.data(), data.size());
+  return send(message);
+}
+
+
+} } // OSS::RAFT
+
+#endif // ENABLE_FEATURE_NET_EXTRA
@@ -0,0 +1,278 @@
+// Library: OSS_CORE - Foundation API for SIP B2BUA
+// Copyright (c) OSS Software Solutions
+// Contributor: Joegen Baclor - mailto:joegen@ossapp.com
+//
+// Permission is hereby granted, to any person or organization
+// obtaining a copy of the software and accompanying documentation covered by
+// this license (the "Software") to use, execute, and to prepare
+// derivative works of the Software, all subject to the
+// "GNU Lesser General Public License (LGPL)".
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+// SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+// FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+
+
+
+#include "OSS/RAFT/RaftTcpConsensus.h"
+#if ENABLE_FEATURE_NET_EXTRA
+
+#include "OSS/UTL/Logger.h"
+#include <vector>
+
+
+namespace OSS {
+namespace RAFT {
+
+
+RaftTcpConsensus::Listener::Listener(RaftTcpConsensus& raft) :
+  _raft(raft)
+{
+}
+
+void RaftTcpConsensus::Listener::onIncomingRequest(FramedTcpConnection& connection, const char* data, std::size_t len)
+{
+  _raft.onIncomingMessage(data, len);
+}
+
+
+RaftTcpConsensus::RaftTcpConsensus() :
+  _listener(*this),
+  _pListenerWork(0),
+  _pListenerThread(0)
+{
+}
+
+RaftTcpConsensus::~RaftTcpConsensus()
+{
+  stop();
+  close();
+}
+
+bool RaftTcpConsensus::listen(const std::string& address, const std::string& port)
+{
+  if (_pListenerThread)
+  {
+    return true;
+  }
+  
+  try
+  {
+    _listener.run(address, port);
+  }
+  catch(const std::exception& e)
+  {
+    OSS_LOG_ERROR("RaftTcpConsensus::listen - Unable to listen on " << address << ":" << port << " - " << e.what());
+    return false;
+  }
+  
+  _pListenerWork = new boost::asio::io_service::work(_listener.ioService());
+  _pListenerThread = new boost::thread(boost::bind(&boost::asio::io_service::run, &_listener.ioService()));
+  return true;
+}
+
+bool RaftTcpConsensus::addPeer(int node_id, const std::string& address, const std::string& port)
+{
+  {
+    OSS::mutex_critic_sec_lock lock(_peerMutex);
+    PeerAddress& peer = _peerAddresses[node_id];
+    peer.address = address;
+    peer.port = port;
+  }
+  return addNode(node_id);
+}
+
+void RaftTcpConsensus::close()
+{
+  if (_pListenerThread)
+  {
+    _listener.stop();
+    delete _pListenerWork;
+    _pListenerWork = 0;
+    _listener.ioService().stop();
+    _pListenerThread->join();
+    delete _pListenerThread;
+    _pListenerThread = 0;
+  }
+  
+  std::vector<int> peers;
+  {
+    OSS::mutex_critic_sec_lock lock(_peerMutex);
+    for (PeerAddresses::iterator iter = _peerAddresses.begin(); iter != _peerAddresses.end(); iter++)
+    {
+      peers.push_back(iter->first);
+    }
+  }
+  for (std::vector<int>::iterator iter = peers.begin(); iter != peers.end(); iter++)
+  {
+    removeConnection(*iter);
+  }
+}
+
+bool RaftTcpConsensus::forward(const std::string& data)
+{
+  if (submit(data))
+  {
+    return true;
+  }
+  
+  Node leader;
+  int leaderId = getLeaderId();
+  if (leaderId == -1 || leaderId == opt().node_id || !findNode(leaderId, leader))
+  {
+    return false;
+  }
+  
+  Connection::Ptr pConnection = findOrCreateConnection(leader);
+  RaftTcpConnection* pTcpConnection = dynamic_cast<RaftTcpConnection*>(pConnection.get());
+  return pTcpConnection && pTcpConnection->sendForward(data) == 0;
+}
+
+RaftConsensus::Connection::Ptr RaftTcpConsensus::createConnection(Node& node)
+{
+  PeerAddress peer;
+  {
+    OSS::mutex_critic_sec_lock lock(_peerMutex);
+    PeerAddresses::iterator iter = _peerAddresses.find(node.getId());
+    if (iter == _peerAddresses.end())
+    {
+      return Connection::Ptr();
+    }
+    peer = iter->second;
+  }
+  return Connection::Ptr(new RaftTcpConnection(this, node, peer.address, peer.port));
+}
+
+void RaftTcpConsensus::onReceivedForward(int node_id, const std::string& data)
+{
+  if (!submit(data))
+  {
+    OSS_LOG_WARNING("RaftTcpConsensus::onReceivedForward - Dropping data from node " << node_id << ".  This node is not the leader.");
+  }
+}
+
+void RaftTcpConsensus::onIncomingMessage(const char* data, std::size_t len)
+{
+  RaftTcpMessage message(data, len);
+  Node node;
+  if (!message.isValid() || !findNode(message.getFrom(), node))
+  {
+    OSS_LOG_WARNING("RaftTcpConsensus::onIncomingMessage - Dropping message from unknown node");
+    return;
+  }
+  
+  Connection::Ptr pConnection = findOrCreateConnection(node);
+  if (!pConnection)
+  {
+    return;
+  }
+  
+  bool ok = false;
+  switch (message.getType())
+  {
+    case RaftTcpMessage::REQUEST_VOTE:
+    {
+      msg_requestvote_t msg;
+      ok = message.read(msg.term) && message.read(msg.candidate_id) && message.read(msg.last_log_idx) && message.read(msg.last_log_term);
+      if (ok)
+      {
+        onReceivedRequestVote(pConnection, msg);
+      }
+      break;
+    }
+    case RaftTcpMessage::REQUEST_VOTE_RESPONSE:
+    {
+      msg_requestvote_response_t msg;
+      ok = message.read(msg.term) && message.read(msg.vote_granted);
+      if (ok)
+      {
+        onReceivedRequestVoteResponse(pConnection, msg);
+      }
+      break;
+    }
+    case RaftTcpMessage::APPEND_ENTRIES:
+    {
+      //
+      // The entries point into the frame.  RaftConsensus copies them into
+      // its log before the handler returns.  The entry count is checked
+      // against what is left of the frame before anything is allocated.
+      //
+      msg_appendentries_t msg;
+      ok = message.read(msg.term) && message.read(msg.prev_log_idx) && message.read(msg.prev_log_term) && message.read(msg.leader_commit) && message.read(msg.n_entries) && msg.n_entries >= 0 &&
+        (std::size_t)msg.n_entries <= message.getRemaining() / RaftTcpMessage::ENTRY_OVERHEAD;
+      std::vector<msg_entry_t> entries(ok ? msg.n_entries : 0);
+      for (int i = 0; ok && i < msg.n_entries; i++)
+      {
+        int term = 0;
+        int id = 0;
+        const char* buf = 0;
+        ok = message.read(term) && message.read(id) && message.read(entries[i].type) && message.read(buf, entries[i].data.len);
+        entries[i].term = term;
+        entries[i].id = id;
+        entries[i].data.buf = (void*)buf;
+      }
+      if (ok)
+      {
+        msg.entries = entries.empty() ? 0 : &entries[0];
+        onReceivedAppendEntries(pConnection, msg);
+      }
+      break;
+    }
+    case RaftTcpMessage::APPEND_ENTRIES_RESPONSE:
+    {
+      msg_appendentries_response_t msg;
+      ok = message.read(msg.term) && message.read(msg.success) && message.read(msg.current_idx) && message.read(msg.first_idx);
+      if (ok)
+      {
+        onReceivedAppendEntriesResponse(pConnection, msg);
+      }
+      break;
+    }
+    case RaftTcpMessage::INSTALL_SNAPSHOT:
+    {
+      msg_installsnapshot_t msg;
+      ok = message.read(msg.term) && message.read(msg.last_included_idx) && message.read(msg.last_included_term) && message.read(msg.size) && message.read(msg.offset) && message.read(msg.data, msg.len);
+      if (ok)
+      {
+        onReceivedInstallSnapshot(pConnection, msg);
+      }
+      break;
+    }
+    case RaftTcpMessage::INSTALL_SNAPSHOT_RESPONSE:
+    {
+      msg_installsnapshot_response_t msg;
+      ok = message.read(msg.term) && message.read(msg.last_included_idx) && message.read(msg.offset) && message.read(msg.success);
+      if (ok)
+      {
+        onReceivedInstallSnapshotResponse(pConnection, msg);
+      }
+      break;
+    }
+    case RaftTcpMessage::FORWARD:
+    {
+      const char* buf = 0;
+      unsigned int bufLen = 0;
+      ok = message.read(buf, bufLen);
+      if (ok)
+      {
+        onReceivedForward(message.getFrom(), std::string(buf, bufLen));
+      }
+      break;
+    }
+  }
+  
+  if (!ok)
+  {
+    OSS_LOG_WARNING("RaftTcpConsensus::onIncomingMessage - Malformed message type " << message.getType() << " from node " << message.getFrom());
+  }
+}
+
+
+} } // OSS::RAFT
+
+#endif // ENABLE_FEATURE_NET_EXTRA
@@ -104,6 +104,8 @@ int log_append_entry(log_t* me_, raft_entry_t* c)
     memcpy(&me->entries[me->back], c, sizeof(raft_entry_t));
     me->count++;
     me->back++;
+    if (me->back == me->size)
+        me->back = 0;
     return 0;
 }
 
@@ -114,7 +116,7 @@ raft_entry_t* log_get_from_idx(log_t* me_, int idx, int *n_etys)
 
     assert(0 <= idx - 1);
 
-    if (me->base + me->count < idx || idx < me->base)
+    if (me->base + me->count < idx || idx <= me->base)
     {
         *n_etys = 0;
         return NULL;
@@ -143,7 +145,7 @@ raft_entry_t* log_get_at_idx(log_t* me_, int idx)
 
     assert(0 <= idx - 1);
 
-    if (me->base + me->count < idx || idx < me->base)
+    if (me->base + me->count < idx || idx <= me->base)
         return NULL;
 
     /* idx starts at 1 */
@@ -170,10 +172,11 @@ void log_delete(log_t* me_, int idx)
 
     for (end = log_count(me_); idx < end; idx++)
     {
+        int tail = (0 == me->back ? me->size : me->back) - 1;
         if (me->cb && me->cb->log_pop)
             me->cb->log_pop(me->raft, raft_get_udata(me->raft),
-                            &me->entries[me->back - 1], me->back);
-        me->back--;
+                            &me->entries[tail], tail);
+        me->back = tail;
         me->count--;
     }
 }
@@ -190,11 +193,21 @@ void *log_poll(log_t * me_)
         me->cb->log_poll(me->raft, raft_get_udata(me->raft),
                          &me->entries[me->front], me->front);
     me->front++;
+    if (me->front == me->size)
+        me->front = 0;
     me->count--;
     me->base++;
     return (void*)elem;
 }
 
+void log_load_from_snapshot(log_t * me_, int idx)
+{
+    log_private_t* me = (log_private_t*)me_;
+
+    log_empty(me_);
+    me->base = idx;
+}
+
 raft_entry_t *log_peektail(log_t * me_)
 {
     log_private_t* me = (log_private_t*)me_;
@@ -609,7 +622,7 @@ int raft_recv_appendentries_response(raft_server_t* me_,
         if (0 < match_idx)
         {
             raft_entry_t* ety = raft_get_entry_from_idx(me_, match_idx);
-            if (ety->term == me->current_term && point <= match_idx)
+            if (ety && ety->term == me->current_term && point <= match_idx)
                 votes++;
         }
     }
@@ -670,7 +683,8 @@ int raft_recv_appendentries(
 
     /* Not the first appendentries we've received */
     /* NOTE: the log starts at 1 */
-    if (0 < ae->prev_log_idx)
+    /* Entries covered by our snapshot are committed and always match */
+    if (me->snapshot_last_idx < ae->prev_log_idx)
     {
         raft_entry_t* e = raft_get_entry_from_idx(me_, ae->prev_log_idx);
 
@@ -700,7 +714,7 @@ int raft_recv_appendentries(
     /* 3. If an existing entry conflicts with a new one (same index
        but different terms), delete the existing entry and all that
        follow it (§5.3) */
-    if (ae->n_entries == 0 && 0 < ae->prev_log_idx && ae->prev_log_idx + 1 < raft_get_current_idx(me_))
+    if (ae->n_entries == 0 && me->snapshot_last_idx < ae->prev_log_idx && ae->prev_log_idx + 1 < raft_get_current_idx(me_))
     {
         assert(me->commit_idx < ae->prev_log_idx + 1);
         log_delete(me->log, ae->prev_log_idx + 1);
@@ -713,8 +727,10 @@ int raft_recv_appendentries(
     {
         msg_entry_t* ety = &ae->entries[i];
         int ety_index = ae->prev_log_idx + 1 + i;
-        raft_entry_t* existing_ety = raft_get_entry_from_idx(me_, ety_index);
         r->current_idx = ety_index;
+        if (ety_index <= me->snapshot_last_idx)
+            continue;
+        raft_entry_t* existing_ety = raft_get_entry_from_idx(me_, ety_index);
         if (existing_ety && existing_ety->term != ety->term)
         {
             assert(me->commit_idx < ety_index);
@@ -781,11 +797,11 @@ static int __raft__should_grant_vote(raft_server_private_t* me, msg_requestvote_
     if (0 == current_idx)
         return 1;
 
-    raft_entry_t* e = raft_get_entry_from_idx((void*)me, current_idx);
-    if (e->term < vr->last_log_term)
+    int last_log_term = raft_get_last_log_term((void*)me);
+    if (last_log_term < vr->last_log_term)
         return 1;
 
-    if (vr->last_log_term == e->term && current_idx <= vr->last_log_idx)
+    if (vr->last_log_term == last_log_term && current_idx <= vr->last_log_idx)
         return 1;
 
     return 0;
@@ -1022,6 +1038,8 @@ int raft_send_appendentries(raft_server_t* me_, raft_node_t* node)
         ae.prev_log_idx = next_idx - 1;
         if (prev_ety)
             ae.prev_log_term = prev_ety->term;
+        else if (ae.prev_log_idx == me->snapshot_last_idx)
+            ae.prev_log_term = me->snapshot_last_term;
     }
 
     __raft__log(me_, node, "sending appendentries node: ci:%d t:%d lc:%d pli:%d plt:%d",
@@ -1354,6 +1372,65 @@ int raft_get_last_log_term(raft_server_t* me_)
         raft_entry_t* ety = raft_get_entry_from_idx(me_, current_idx);
         if (ety)
             return ety->term;
+        if (current_idx == raft_get_snapshot_last_idx(me_))
+            return raft_get_snapshot_last_term(me_);
     }
     return 0;
 }
+
+int raft_compact_log(raft_server_t* me_, int idx, int term)
+{
+    raft_server_private_t* me = (raft_server_private_t*)me_;
+
+    if (me->last_applied_idx < idx)
+        return -1;
+
+    while (0 < log_count(me->log) && log_get_current_idx(me->log) - log_count(me->log) < idx)
+        log_poll(me->log);
+
+    me->snapshot_last_idx = idx;
+    me->snapshot_last_term = term;
+    return 0;
+}
+
+void raft_load_snapshot(raft_server_t* me_, int idx, int term)
+{
+    raft_server_private_t* me = (raft_server_private_t*)me_;
+
+    log_load_from_snapshot(me->log, idx);
+    me->snapshot_last_idx = idx;
+    me->snapshot_last_term = term;
+    if (me->commit_idx < idx)
+        me->commit_idx = idx;
+    me->last_applied_idx = idx;
+    me->voting_cfg_change_log_idx = -1;
+}
+
+int raft_get_snapshot_last_idx(raft_server_t* me_)
+{
+    return ((raft_server_private_t*)me_)->snapshot_last_idx;
+}
+
+int raft_get_snapshot_last_term(raft_server_t* me_)
+{
+    return ((raft_server_private_t*)me_)->snapshot_last_term;
+}
+
+int raft_recv_installsnapshot(raft_server_t* me_, raft_node_t* node, int term)
+{
+    raft_server_private_t* me = (raft_server_private_t*)me_;
+
+    if (term < me->current_term)
+        return -1;
+
+    me->timeout_elapsed = 0;
+
+    if (me->current_term < term)
+        raft_set_current_term(me_, term);
+
+    if (!raft_is_follower(me_))
+        raft_become_follower(me_);
+
+    me->current_leader = node;
+    return 0;
+}
@@ -22,6 +22,7 @@
 #include "OSS/SIP/SIPFSMDispatch.h"
 #include "OSS/SIP/SIPTransportService.h"
 #include "OSS/SIP/SIPException.h"
+#include "OSS/SIP/SIPFrom.h"
 #include "OSS/UTL/Logger.h"
 
 namespace OSS {
@@ -37,8 +38,10 @@ SIPFSMDispatch::SIPFSMDispatch() :
   _ist(this),
   _nist(this),
   _istBlocker(60),
+  _overloadBlocker(32),
   _enableIctForking(false)
 {
+  _ingressQueue.setHandler(boost::bind(&SIPFSMDispatch::processMessage, this, _1, _2));
 }
 
 SIPFSMDispatch::~SIPFSMDispatch()
@@ -56,6 +59,20 @@ void SIPFSMDispatch::deinitialize()
 }
 
 void SIPFSMDispatch::onReceivedMessage(SIPMessage::Ptr pMsg, SIPTransportSession::Ptr pTransport)
+{
+  if (_ingressQueue.isRunning())
+  {
+    if (!_ingressQueue.enqueue(pMsg, pTransport))
+    {
+      OSS_LOG_DEBUG("SIPFSMDispatch::onReceivedMessage - Ingress lane full.  Dropped message from "
+        << pTransport->getRemoteAddress().toIpPortString());
+    }
+    return;
+  }
+  processMessage(pMsg, pTransport);
+}
+
+void SIPFSMDispatch::processMessage(const SIPMessage::Ptr& pMsg, const SIPTransportSession::Ptr& pTransport)
 {
   if (!pTransport->isEndpoint() && pTransport->getLastReadCount() < MIN_DATAGRAM_SIZE && !pTransport->isReliableTransport())
   {
@@ -100,25 +117,67 @@ void SIPFSMDispatch::onReceivedMessage(SIPMessage::Ptr pMsg, SIPTransportSession
         OSS_LOG_WARNING("Blocked request retransmission - " <<  pMsg->startLine());
         return;
       }
-      
-      trn = _ist.findTransaction(pMsg, pTransport);
+
+      if (_overloadBlocker.has(id))
+      {
+        //
+        // Retransmission of an INVITE we have already shed
+        //
+        sendOverloadResponse(pMsg, pTransport);
+        return;
+      }
+
+      SIPTo to;
+      to = pMsg->hdrGet(OSS::SIP::HDR_TO);
+      if (_overloadControl.isEnabled() && !pTransport->isEndpoint() && to.getHeaderParam("tag").empty())
+      {
+        //
+        // Admission is decided before a transaction is created.  Only
+        // INVITEs starting a new dialog are shed.  Retransmissions of
+        // admitted INVITEs find their transaction here.
+        //
+        trn = _ist.findTransaction(pMsg, pTransport, false);
+        if (!trn && !_overloadControl.admit())
+        {
+          _overloadBlocker.add(id, id);
+          sendOverloadResponse(pMsg, pTransport);
+          return;
+        }
+      }
+      else
+      {
+        _overloadControl.prioritize();
+      }
+
+      if (!trn)
+        trn = _ist.findTransaction(pMsg, pTransport);
     }
     else if (OSS::string_caseless_starts_with(pMsg->startLine(), "ack"))
     {
+      if (_overloadBlocker.has(id))
+      {
+        //
+        // ACK for a 503 sent by the overload control
+        //
+        return;
+      }
       //
       // ACK for error responses will get matched to a transaction
       //
       transactionType = SIPTransaction::TYPE_IST;
       trn = _ist.findTransaction(pMsg, pTransport, false);
+      _overloadControl.prioritize();
     }
     else
     {
       transactionType = SIPTransaction::TYPE_NIST;
       trn = _nist.findTransaction(pMsg, pTransport);
+      _overloadControl.prioritize();
     }
   }
   else if (!pMsg->isRequest())
   {
+    _overloadControl.prioritize();
     std::string cseq;
     cseq = pMsg->hdrGet(OSS::SIP::HDR_CSEQ);
     if (OSS::string_caseless_ends_with(cseq, "invite"))
@@ -189,6 +248,43 @@ void SIPFSMDispatch::onReceivedMessage(SIPMessage::Ptr pMsg, SIPTransportSession
   }
 }
 
+void SIPFSMDispatch::sendOverloadResponse(const SIPMessage::Ptr& pMsg, const SIPTransportSession::Ptr& pTransport)
+{
+  try
+  {
+    SIPMessage::Ptr pResponse = pMsg->createResponse(SIPMessage::CODE_503_ServiceUnavailable);
+    pResponse->hdrSet(OSS::SIP::HDR_RETRY_AFTER, OSS::string_from_number<unsigned int>(_overloadControl.getRetryAfter()));
+    pResponse->commitData();
+
+#if ENABLE_FEATURE_XOR
+    std::string isXOR;
+    if (pMsg->getProperty(OSS::PropertyMap::PROP_XOR, isXOR) && isXOR == "1")
+    {
+      pResponse->setProperty(OSS::PropertyMap::PROP_XOR, "1");
+    }
+#endif
+
+    OSS_LOG_DEBUG(pMsg->createContextId(true) << "SIPFSMDispatch::sendOverloadResponse - Rejected "
+      << pMsg->startLine() << " SRC: " << pTransport->getRemoteAddress().toIpPortString()
+      << " REDUCTION: " << _overloadControl.getReduction() << "%");
+
+    if (pTransport->isReliableTransport())
+    {
+      pTransport->writeMessage(pResponse);
+    }
+    else
+    {
+      pTransport->writeMessage(pResponse,
+        pTransport->getRemoteAddress().toString(),
+        OSS::string_from_number<unsigned short>(pTransport->getRemoteAddress().getPort()));
+    }
+  }
+  catch(OSS::Exception e)
+  {
+    OSS_LOG_WARNING("SIPFSMDispatch::sendOverloadResponse - Unable to send 503: " << e.message());
+  }
+}
+
 SIPTransaction::Ptr SIPFSMDispatch::createClientTransaction(const SIPMessage::Ptr& pRequest)
 {
   if (!pRequest->isRequest())
@@ -249,6 +345,7 @@ void SIPFSMDispatch::sendRequest(
 
 void SIPFSMDispatch::stop()
 {
+  _ingressQueue.stop();
   _ict.stop();
   _nict.stop();
   _ist.stop();
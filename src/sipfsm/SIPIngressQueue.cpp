@@ -0,0 +1,538 @@
+// Library: OSS_CORE - Foundation API for SIP B2BUA
+// Copyright (c) OSS Software Solutions
+// Contributor: Joegen Baclor - mailto:joegen@ossapp.com
+//
+// Permission is hereby granted, to any person or organization
+// obtaining a copy of the software and accompanying documentation covered by
+// this license (the "Software") to use, execute, and to prepare
+// derivative works of the Software, all subject to the
+// "GNU Lesser General Public License (LGPL)".
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+// SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+// FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+
+
+
+#include <cctype>
+#include <cstring>
+#include <strings.h>
+#include "OSS/SIP/SIPIngressQueue.h"
+#include "OSS/UTL/CoreUtils.h"
+#include "OSS/UTL/Logger.h"
+
+
+namespace OSS {
+namespace SIP {
+
+
+static const unsigned int DEFAULT_LANE_WEIGHTS[SIPIngressQueue::LANE_MAX] = { 8, 6, 3, 1 };
+static const std::size_t MAX_DISPATCH_SCAN = 32; /// Queued messages looked at per lane to get past busy calls
+
+static bool findHeader(const char* data, std::size_t len, const char* longName, char compactName, const char*& value, const char*& eol)
+{
+  //
+  // Walk the header lines until the blank line and return the first header
+  // matching either the long or the compact name.  value points just past
+  // the header name.
+  //
+  std::size_t longLen = strlen(longName);
+  const char* end = data + len;
+  const char* line = static_cast<const char*>(memchr(data, '\n', len));
+  while (line && ++line < end && *line != '\r' && *line != '\n')
+  {
+    eol = static_cast<const char*>(memchr(line, '\n', end - line));
+    if (!eol)
+      eol = end;
+
+    const char* name = line;
+    const char* colon = name;
+    while (colon < eol && *colon != ':' && *colon != ' ' && *colon != '\t')
+      colon++;
+    std::size_t nameLen = colon - name;
+
+    if ((nameLen == longLen && strncasecmp(name, longName, longLen) == 0) || (nameLen == 1 && tolower(*name) == compactName))
+    {
+      value = colon;
+      return true;
+    }
+    line = eol;
+  }
+  return false;
+}
+
+static const char* findParam(const char* value, const char* eol, const char* paramName)
+{
+  //
+  // Returns a pointer just past the '=' of the first ;paramName= in the
+  // header value or null if there is none
+  //
+  std::size_t paramLen = strlen(paramName);
+  for (const char* p = value; p < eol; p++)
+  {
+    if (*p != ';')
+      continue;
+    const char* param = p + 1;
+    while (param < eol && (*param == ' ' || *param == '\t'))
+      param++;
+    if (static_cast<std::size_t>(eol - param) > paramLen && strncasecmp(param, paramName, paramLen) == 0)
+    {
+      const char* eq = param + paramLen;
+      while (eq < eol && (*eq == ' ' || *eq == '\t'))
+        eq++;
+      if (eq < eol && *eq == '=')
+        return eq + 1;
+    }
+  }
+  return 0;
+}
+
+static bool hasToTag(const char* data, std::size_t len)
+{
+  const char* value = 0;
+  const char* eol = 0;
+  return findHeader(data, len, "to", 't', value, eol) && findParam(value, eol, "tag");
+}
+
+static bool getViaBranch(const std::string& data, std::string& branch)
+{
+  const char* value = 0;
+  const char* eol = 0;
+  if (!findHeader(data.c_str(), data.size(), "via", 'v', value, eol))
+    return false;
+
+  //
+  // Only the topmost via-parm counts if the header carries several
+  //
+  const char* comma = static_cast<const char*>(memchr(value, ',', eol - value));
+  if (comma)
+    eol = comma;
+
+  const char* start = findParam(value, eol, "branch");
+  if (!start)
+    return false;
+  while (start < eol && (*start == ' ' || *start == '\t'))
+    start++;
+
+  const char* end = start;
+  while (end < eol && *end != ';' && *end != ',' && *end != ' ' && *end != '\t' && *end != '\r')
+    end++;
+  if (end == start)
+    return false;
+
+  branch.assign(start, end);
+  return true;
+}
+
+static std::size_t getCallKey(const std::string& data)
+{
+  //
+  // FNV-1a of the Call-ID.  Zero means the message has none and is not
+  // serialized against anything.  A collision only serializes two calls.
+  //
+  const char* value = 0;
+  const char* eol = 0;
+  if (!findHeader(data.c_str(), data.size(), "call-id", 'i', value, eol))
+    return 0;
+
+  while (value < eol && (*value == ':' || *value == ' ' || *value == '\t'))
+    value++;
+  while (eol > value && (eol[-1] == '\r' || eol[-1] == ' ' || eol[-1] == '\t'))
+    eol--;
+  if (value == eol)
+    return 0;
+
+  std::size_t hash = 2166136261u;
+  for (const char* p = value; p < eol; p++)
+  {
+    hash ^= static_cast<unsigned char>(*p);
+    hash *= 16777619u;
+  }
+  return hash ? hash : 1;
+}
+
+static bool hasMethod(const std::string& data, const char* method)
+{
+  std::size_t len = strlen(method);
+  return data.size() > len && data.compare(0, len, method) == 0 && data[len] == ' ';
+}
+
+SIPIngressQueue::SIPIngressQueue() :
+  _isRunning(false)
+{
+  for (int i = 0; i < LANE_MAX; i++)
+  {
+    LaneState& lane = _lanes[i];
+    lane.capacity = DEFAULT_LANE_CAPACITY;
+    lane.highWaterMark = 0;
+    lane.weight = DEFAULT_LANE_WEIGHTS[i];
+    lane.credit = lane.weight;
+    lane.enqueued = 0;
+    lane.dispatched = 0;
+    lane.dropped = 0;
+    lane.totalWait = 0;
+    lane.maxWait = 0;
+  }
+}
+
+SIPIngressQueue::~SIPIngressQueue()
+{
+  stop();
+}
+
+void SIPIngressQueue::setHandler(const Handler& handler)
+{
+  OSS::mutex_critic_sec_lock lock(_mutex);
+  _handler = handler;
+}
+
+void SIPIngressQueue::setLaneCapacity(Lane lane, std::size_t capacity)
+{
+  OSS::mutex_critic_sec_lock lock(_mutex);
+  _lanes[lane].capacity = capacity;
+}
+
+void SIPIngressQueue::setLaneWeight(Lane lane, unsigned int weight)
+{
+  OSS::mutex_critic_sec_lock lock(_mutex);
+  _lanes[lane].weight = weight ? weight : 1;
+  _lanes[lane].credit = _lanes[lane].weight;
+}
+
+void SIPIngressQueue::start(std::size_t threadCount)
+{
+  OSS::mutex_critic_sec_lock lock(_mutex);
+  if (_isRunning)
+  {
+    return;
+  }
+  _isRunning = true;
+  for (std::size_t i = 0; i < (threadCount ? threadCount : 1); i++)
+  {
+    _threads.push_back(new boost::thread(boost::bind(&SIPIngressQueue::run, this)));
+  }
+}
+
+void SIPIngressQueue::stop()
+{
+  std::vector<boost::thread*> threads;
+  {
+    OSS::mutex_critic_sec_lock lock(_mutex);
+    if (!_isRunning)
+    {
+      return;
+    }
+    _isRunning = false;
+    threads.swap(_threads);
+    for (int i = 0; i < LANE_MAX; i++)
+    {
+      _lanes[i].items.clear();
+    }
+    _pendingInvites.clear();
+    _activeCalls.clear();
+  }
+
+  _ready.notify_all();
+  for (std::vector<boost::thread*>::iterator iter = threads.begin(); iter != threads.end(); iter++)
+  {
+    (*iter)->join();
+    delete *iter;
+  }
+}
+
+bool SIPIngressQueue::isRunning() const
+{
+  OSS::mutex_critic_sec_lock lock(_mutex);
+  return _isRunning;
+}
+
+bool SIPIngressQueue::enqueue(const SIPMessage::Ptr& pMsg, const SIPTransportSession::Ptr& pTransport)
+{
+  return enqueue(classify(pMsg), pMsg, pTransport);
+}
+
+bool SIPIngressQueue::enqueue(Lane lane, const SIPMessage::Ptr& pMsg, const SIPTransportSession::Ptr& pTransport)
+{
+  {
+    OSS::mutex_critic_sec_lock lock(_mutex);
+    Item item;
+    const std::string& data = pMsg->data();
+
+    if (lane == LANE_NEW_INVITE && hasMethod(data, "INVITE"))
+    {
+      getViaBranch(data, item.inviteBranch);
+    }
+    else if (lane == LANE_IN_DIALOG && !_pendingInvites.empty() && (hasMethod(data, "CANCEL") || hasMethod(data, "ACK")))
+    {
+      //
+      // A CANCEL, or the ACK for a non-2xx response, carries the branch of
+      // the INVITE it belongs to.  If that INVITE is still waiting on the
+      // new INVITE lane, queue behind it so the higher weight of this lane
+      // cannot let it overtake the INVITE and find no transaction.  An ACK
+      // for a 2xx response has a branch of its own and is not affected.
+      //
+      std::string branch;
+      if (getViaBranch(data, branch) && _pendingInvites.find(branch) != _pendingInvites.end())
+      {
+        lane = LANE_NEW_INVITE;
+      }
+    }
+
+    LaneState& state = _lanes[lane];
+    if (state.items.size() >= state.capacity)
+    {
+      state.dropped++;
+      return false;
+    }
+
+    item.message = pMsg;
+    item.transport = pTransport;
+    item.enqueueTime = OSS::getTime();
+    item.callKey = getCallKey(data);
+    if (!item.inviteBranch.empty())
+    {
+      _pendingInvites[item.inviteBranch]++;
+    }
+    state.items.push_back(item);
+    state.enqueued++;
+    if (state.items.size() > state.highWaterMark)
+    {
+      state.highWaterMark = state.items.size();
+    }
+  }
+  _ready.notify_one();
+  return true;
+}
+
+bool SIPIngressQueue::dispatchOne()
+{
+  Item item;
+  {
+    OSS::mutex_critic_sec_lock lock(_mutex);
+    if (!next(item))
+    {
+      return false;
+    }
+  }
+
+  if (_handler)
+  {
+    _handler(item.message, item.transport);
+  }
+  release(item);
+  return true;
+}
+
+SIPIngressQueue::LaneStats SIPIngressQueue::getLaneStats(Lane lane) const
+{
+  OSS::mutex_critic_sec_lock lock(_mutex);
+  const LaneState& state = _lanes[lane];
+  LaneStats stats;
+  stats.depth = state.items.size();
+  stats.highWaterMark = state.highWaterMark;
+  stats.capacity = state.capacity;
+  stats.weight = state.weight;
+  stats.enqueued = state.enqueued;
+  stats.dispatched = state.dispatched;
+  stats.dropped = state.dropped;
+  stats.averageWait = state.dispatched ? state.totalWait / state.dispatched : 0;
+  stats.maxWait = state.maxWait;
+  return stats;
+}
+
+SIPIngressQueue::Lane SIPIngressQueue::classify(const SIPMessage::Ptr& pMsg)
+{
+  return classify(pMsg->data());
+}
+
+SIPIngressQueue::Lane SIPIngressQueue::classify(const std::string& data)
+{
+  const char* start = data.c_str();
+  std::size_t len = data.size();
+
+  if (len >= 4 && strncmp(start, "SIP/", 4) == 0)
+  {
+    return LANE_RESPONSE;
+  }
+
+  const char* space = static_cast<const char*>(memchr(start, ' ', len));
+  if (!space)
+  {
+    return LANE_BACKGROUND;
+  }
+
+  std::string method(start, space);
+  if (method == "INVITE")
+  {
+    return hasToTag(start, len) ? LANE_IN_DIALOG : LANE_NEW_INVITE;
+  }
+  else if (method == "ACK" ||
+    method == "BYE" ||
+    method == "CANCEL" ||
+    method == "PRACK" ||
+    method == "UPDATE" ||
+    method == "INFO" ||
+    method == "REFER" ||
+    method == "NOTIFY")
+  {
+    return LANE_IN_DIALOG;
+  }
+
+  return LANE_BACKGROUND;
+}
+
+const char* SIPIngressQueue::getLaneName(Lane lane)
+{
+  switch (lane)
+  {
+  case LANE_RESPONSE:
+    return "response";
+  case LANE_IN_DIALOG:
+    return "in-dialog";
+  case LANE_NEW_INVITE:
+    return "new-invite";
+  case LANE_BACKGROUND:
+    return "background";
+  default:
+    return "unknown";
+  }
+}
+
+bool SIPIngressQueue::next(Item& item)
+{
+  //
+  // Two passes at most.  If every lane with a ready message has used up its
+  // credit the credits are refilled and the lanes are scanned again.
+  //
+  // A message whose call is being handled by another worker is not ready.
+  // Taking the first ready message of a lane keeps the messages of a call
+  // in order and never runs two of them at once, so a CANCEL cannot start
+  // before its INVITE is done.
+  //
+  for (int pass = 0; pass < 2; pass++)
+  {
+    bool hasReady = false;
+    for (int i = 0; i < LANE_MAX; i++)
+    {
+      LaneState& state = _lanes[i];
+      std::deque<Item>::iterator ready = state.items.end();
+      std::size_t scanned = 0;
+      for (std::deque<Item>::iterator iter = state.items.begin(); iter != state.items.end() && scanned < MAX_DISPATCH_SCAN; iter++, scanned++)
+      {
+        if (!iter->callKey || _activeCalls.find(iter->callKey) == _activeCalls.end())
+        {
+          ready = iter;
+          break;
+        }
+      }
+      if (ready == state.items.end())
+      {
+        continue;
+      }
+      hasReady = true;
+      if (state.credit == 0)
+      {
+        continue;
+      }
+
+      state.credit--;
+      item = *ready;
+      state.items.erase(ready);
+      if (item.callKey)
+      {
+        _activeCalls.insert(item.callKey);
+      }
+      if (!item.inviteBranch.empty())
+      {
+        std::map<std::string, unsigned int>::iterator pending = _pendingInvites.find(item.inviteBranch);
+        if (pending != _pendingInvites.end() && --pending->second == 0)
+        {
+          _pendingInvites.erase(pending);
+        }
+      }
+      state.dispatched++;
+
+      OSS::UInt64 now = OSS::getTime();
+      OSS::UInt64 wait = now > item.enqueueTime ? now - item.enqueueTime : 0;
+      state.totalWait += wait;
+      if (wait > state.maxWait)
+      {
+        state.maxWait = wait;
+      }
+      return true;
+    }
+
+    if (!hasReady)
+    {
+      return false;
+    }
+
+    for (int i = 0; i < LANE_MAX; i++)
+    {
+      _lanes[i].credit = _lanes[i].weight;
+    }
+  }
+  return false;
+}
+
+void SIPIngressQueue::run()
+{
+  for (;;)
+  {
+    Item item;
+    {
+      boost::unique_lock<OSS::mutex_critic_sec> lock(_mutex);
+      while (_isRunning && !next(item))
+      {
+        _ready.wait(lock);
+      }
+      if (!_isRunning)
+      {
+        return;
+      }
+    }
+
+    try
+    {
+      if (_handler)
+      {
+        _handler(item.message, item.transport);
+      }
+    }
+    catch(OSS::Exception e)
+    {
+      OSS_LOG_ERROR("SIPIngressQueue::run - Unhandled exception: " << e.message());
+    }
+    catch(std::exception e)
+    {
+      OSS_LOG_ERROR("SIPIngressQueue::run - Unhandled exception: " << e.what());
+    }
+    release(item);
+  }
+}
+
+void SIPIngressQueue::release(const Item& item)
+{
+  if (!item.callKey)
+  {
+    return;
+  }
+
+  {
+    OSS::mutex_critic_sec_lock lock(_mutex);
+    _activeCalls.erase(item.callKey);
+  }
+
+  //
+  // Messages of this call that were held back are ready now
+  //
+  _ready.notify_one();
+}
+
+
+} } // OSS::SIP
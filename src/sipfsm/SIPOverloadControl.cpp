@@ -0,0 +1,282 @@
+// Library: OSS_CORE - Foundation API for SIP B2BUA
+// Copyright (c) OSS Software Solutions
+// Contributor: Joegen Baclor - mailto:joegen@ossapp.com
+//
+// Permission is hereby granted, to any person or organization
+// obtaining a copy of the software and accompanying documentation covered by
+// this license (the "Software") to use, execute, and to prepare
+// derivative works of the Software, all subject to the
+// "GNU Lesser General Public License (LGPL)".
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+// SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+// FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+
+
+
+#include "OSS/SIP/SIPOverloadControl.h"
+#include "OSS/UTL/CoreUtils.h"
+
+
+namespace OSS {
+namespace SIP {
+
+
+SIPOverloadControl::SIPOverloadControl() :
+  _enabled(false),
+  _delayBudget(DEFAULT_DELAY_BUDGET),
+  _controlInterval(DEFAULT_CONTROL_INTERVAL),
+  _retryAfter(DEFAULT_RETRY_AFTER),
+  _reduction(0),
+  _lossCredit(0),
+  _intervalStart(0),
+  _intervalOffered(0),
+  _intervalDelay(0),
+  _intervalSamples(0),
+  _intervalMaxDelay(0),
+  _averageDelay(0),
+  _maxDelay(0),
+  _samples(0),
+  _admitted(0),
+  _rejected(0),
+  _prioritized(0),
+  _depletions(0)
+{
+}
+
+SIPOverloadControl::~SIPOverloadControl()
+{
+}
+
+void SIPOverloadControl::setEnabled(bool enabled)
+{
+  OSS::mutex_critic_sec_lock lock(_mutex);
+  _enabled = enabled;
+  _reduction = 0;
+  _lossCredit = 0;
+  _intervalStart = 0;
+  _intervalOffered = 0;
+  _intervalDelay = 0;
+  _intervalSamples = 0;
+  _intervalMaxDelay = 0;
+}
+
+bool SIPOverloadControl::isEnabled() const
+{
+  OSS::mutex_critic_sec_lock lock(_mutex);
+  return _enabled;
+}
+
+void SIPOverloadControl::setDelayBudget(OSS::UInt64 delayBudget)
+{
+  OSS::mutex_critic_sec_lock lock(_mutex);
+  _delayBudget = delayBudget;
+}
+
+OSS::UInt64 SIPOverloadControl::getDelayBudget() const
+{
+  OSS::mutex_critic_sec_lock lock(_mutex);
+  return _delayBudget;
+}
+
+void SIPOverloadControl::setControlInterval(OSS::UInt64 controlInterval)
+{
+  OSS::mutex_critic_sec_lock lock(_mutex);
+  _controlInterval = controlInterval ? controlInterval : 1;
+}
+
+OSS::UInt64 SIPOverloadControl::getControlInterval() const
+{
+  OSS::mutex_critic_sec_lock lock(_mutex);
+  return _controlInterval;
+}
+
+void SIPOverloadControl::setRetryAfter(unsigned int retryAfter)
+{
+  OSS::mutex_critic_sec_lock lock(_mutex);
+  _retryAfter = retryAfter;
+}
+
+unsigned int SIPOverloadControl::getRetryAfter() const
+{
+  OSS::mutex_critic_sec_lock lock(_mutex);
+  return _retryAfter;
+}
+
+void SIPOverloadControl::recordQueueDelay(OSS::UInt64 delay)
+{
+  recordQueueDelay(delay, OSS::getTime());
+}
+
+void SIPOverloadControl::recordQueueDelay(OSS::UInt64 delay, OSS::UInt64 now)
+{
+  OSS::mutex_critic_sec_lock lock(_mutex);
+  if (!_enabled)
+  {
+    return;
+  }
+  _samples++;
+  _intervalSamples++;
+  _intervalDelay += delay;
+  if (delay > _intervalMaxDelay)
+  {
+    _intervalMaxDelay = delay;
+  }
+  evaluate(now);
+}
+
+void SIPOverloadControl::recordDepletion()
+{
+  recordDepletion(OSS::getTime());
+}
+
+void SIPOverloadControl::recordDepletion(OSS::UInt64 now)
+{
+  OSS::UInt64 delay = 0;
+  {
+    OSS::mutex_critic_sec_lock lock(_mutex);
+    _depletions++;
+    delay = _delayBudget * 2;
+  }
+  recordQueueDelay(delay, now);
+}
+
+bool SIPOverloadControl::admit()
+{
+  return admit(OSS::getTime());
+}
+
+bool SIPOverloadControl::admit(OSS::UInt64 now)
+{
+  OSS::mutex_critic_sec_lock lock(_mutex);
+  if (!_enabled)
+  {
+    return true;
+  }
+
+  evaluate(now);
+  _intervalOffered++;
+
+  //
+  // Reject exactly reduction out of every hundred arrivals by carrying
+  // the fractional rejection over to the next call
+  //
+  _lossCredit += _reduction;
+  if (_lossCredit >= 100)
+  {
+    _lossCredit -= 100;
+    _rejected++;
+    return false;
+  }
+  _admitted++;
+  return true;
+}
+
+void SIPOverloadControl::prioritize()
+{
+  OSS::mutex_critic_sec_lock lock(_mutex);
+  if (_enabled && _reduction > 0)
+  {
+    _prioritized++;
+  }
+}
+
+bool SIPOverloadControl::isOverloaded() const
+{
+  OSS::mutex_critic_sec_lock lock(_mutex);
+  return _enabled && _reduction > 0;
+}
+
+unsigned int SIPOverloadControl::getReduction() const
+{
+  OSS::mutex_critic_sec_lock lock(_mutex);
+  return _reduction;
+}
+
+SIPOverloadControl::Stats SIPOverloadControl::getStats() const
+{
+  OSS::mutex_critic_sec_lock lock(_mutex);
+  Stats stats;
+  stats.enabled = _enabled;
+  stats.reduction = _reduction;
+  stats.averageDelay = _averageDelay;
+  stats.maxDelay = _maxDelay;
+  stats.samples = _samples;
+  stats.admitted = _admitted;
+  stats.rejected = _rejected;
+  stats.prioritized = _prioritized;
+  stats.depletions = _depletions;
+  return stats;
+}
+
+void SIPOverloadControl::evaluate(OSS::UInt64 now)
+{
+  if (!_intervalStart)
+  {
+    _intervalStart = now;
+    return;
+  }
+
+  if (now < _intervalStart + _controlInterval)
+  {
+    return;
+  }
+
+  OSS::UInt64 previousDelay = _averageDelay;
+  _averageDelay = _intervalSamples ? _intervalDelay / _intervalSamples : 0;
+  _maxDelay = _intervalMaxDelay;
+
+  if (_averageDelay > _delayBudget)
+  {
+    //
+    // The samples taken during the interval tell how many messages the
+    // server actually got through.  Admit ninety percent of that so the
+    // backlog drains, and hold the reduction while the delay is already
+    // falling since the samples lag behind the queue.
+    //
+    if (_intervalOffered && _averageDelay >= previousDelay)
+    {
+      OSS::UInt64 target = (_intervalSamples * 9) / 10;
+      unsigned int reduction = 0;
+      if (target < _intervalOffered)
+      {
+        reduction = (unsigned int)(100 - (target * 100) / _intervalOffered);
+      }
+      if (reduction < _reduction + REDUCTION_STEP)
+      {
+        reduction = _reduction + REDUCTION_STEP;
+      }
+      _reduction = reduction < MAX_REDUCTION ? reduction : MAX_REDUCTION;
+    }
+  }
+  else
+  {
+    //
+    // Give back capacity faster when the delay is well inside the budget
+    //
+    unsigned int step = _averageDelay < _delayBudget / 2 ? REDUCTION_STEP * 2 : REDUCTION_STEP;
+    if (_reduction > step)
+    {
+      _reduction -= step;
+    }
+    else
+    {
+      _reduction = 0;
+      _lossCredit = 0;
+    }
+  }
+
+  _intervalStart = now;
+  _intervalOffered = 0;
+  _intervalDelay = 0;
+  _intervalSamples = 0;
+  _intervalMaxDelay = 0;
+}
+
+
+} } // OSS::SIP
@@ -561,6 +561,37 @@ bool SIPStack::initTlsContextFromConfig(const boost::filesystem::path& cfgFile)
   {
     tls_verify_peer = (bool)listeners["tls-verify-peer"];
   }
+
+ /****************************************************************************
+  * TLS Session Resumption.  The session cache and tickets are enabled by    *
+  * default.  The ticket key is rotated after tls-ticket-key-lifetime        *
+  * seconds.                                                                 *
+  ****************************************************************************/
+  int tls_session_cache_size = OSS::Net::TLSSessionCache::DEFAULT_SERVER_CACHE_SIZE;
+  if (listeners.exists("tls-session-cache-size"))
+  {
+    tls_session_cache_size = (int)listeners["tls-session-cache-size"];
+  }
+
+  int tls_session_timeout = OSS::Net::TLSSessionCache::DEFAULT_SESSION_TIMEOUT;
+  if (listeners.exists("tls-session-timeout"))
+  {
+    tls_session_timeout = (int)listeners["tls-session-timeout"];
+  }
+
+  bool tls_session_tickets = true;
+  if (listeners.exists("tls-session-tickets"))
+  {
+    tls_session_tickets = (bool)listeners["tls-session-tickets"];
+  }
+
+  if (listeners.exists("tls-ticket-key-lifetime"))
+  {
+    transport().tlsSessionCache().setTicketKeyLifetime((int)listeners["tls-ticket-key-lifetime"]);
+  }
+
+  transport().tlsSessionCache().attachServer(transport().tlsServerContext().native_handle(),
+    "oss_core_sip", tls_session_cache_size, tls_session_timeout, tls_session_tickets);
   
   return initializeTlsContext(tls_certificate_file, tls_private_key_file, tls_cert_password, tls_ca_file, tls_ca_path, tls_verify_peer);
 }
@@ -862,6 +893,55 @@ void SIPStack::initTransportFromConfig(const boost::filesystem::path& cfgFile)
   }
 #endif
 
+  //
+  // Overload control.  New INVITEs are shed once the average queue delay
+  // exceeds overload-delay-budget milliseconds.
+  //
+  if (listeners.exists("overload-delay-budget") && (int)listeners["overload-delay-budget"] > 0)
+  {
+    overloadControl().setDelayBudget((int)listeners["overload-delay-budget"]);
+    if (listeners.exists("overload-control-interval"))
+    {
+      overloadControl().setControlInterval((int)listeners["overload-control-interval"]);
+    }
+    if (listeners.exists("overload-retry-after"))
+    {
+      overloadControl().setRetryAfter((int)listeners["overload-retry-after"]);
+    }
+    overloadControl().setEnabled(true);
+    OSS_LOG_INFO("SIPStack::initTransportFromConfig() - Overload control enabled with a delay budget of "
+      << overloadControl().getDelayBudget() << " ms");
+  }
+
+  //
+  // Ingress priority lanes.  Messages are processed on the transport threads
+  // unless ingress-queue-threads is set.  Lane weights are given in the order
+  // response/in-dialog/new-invite/background.
+  //
+  if (listeners.exists("ingress-queue-threads") && (int)listeners["ingress-queue-threads"] > 0)
+  {
+    if (listeners.exists("ingress-queue-lane-size"))
+    {
+      int laneSize = (int)listeners["ingress-queue-lane-size"];
+      for (int i = 0; i < SIPIngressQueue::LANE_MAX; i++)
+      {
+        ingressQueue().setLaneCapacity((SIPIngressQueue::Lane)i, laneSize);
+      }
+    }
+    if (listeners.exists("ingress-queue-weights"))
+    {
+      std::string weights = (const char*)listeners["ingress-queue-weights"];
+      std::vector<std::string> tokens = OSS::string_tokenize(weights, "/");
+      for (std::size_t i = 0; i < tokens.size() && i < SIPIngressQueue::LANE_MAX; i++)
+      {
+        ingressQueue().setLaneWeight((SIPIngressQueue::Lane)i, OSS::string_to_number<unsigned int>(tokens[i].c_str()));
+      }
+    }
+    ingressQueue().start((int)listeners["ingress-queue-threads"]);
+    OSS_LOG_INFO("SIPStack::initTransportFromConfig() - Ingress queue started with "
+      << (int)listeners["ingress-queue-threads"] << " thread(s)");
+  }
+
   if (listeners.exists("packet-rate-ratio"))
   {
     std::string packetRateRatio = (const char*)listeners["packet-rate-ratio"];
@@ -881,6 +961,7 @@ void SIPStack::initTransportFromConfig(const boost::filesystem::path& cfgFile)
       {
         DataType whiteList = listeners["packet-rate-white-list"];
         int count = whiteList.getElementCount();
+        OSS::Net::AccessControl::NetworkWhiteList networks;
         for (int i = 0; i < count; i++)
         {
           DataType wl = whiteList[i];
@@ -900,9 +981,11 @@ void SIPStack::initTransportFromConfig(const boost::filesystem::path& cfgFile)
           {
             entry = (const char*)wl["source-network"];
             if (!entry.empty())
-            SIPTransportSession::rateLimit().whiteListNetwork(entry);
+              networks.insert(entry);
           }
         }
+        if (!networks.empty())
+          SIPTransportSession::rateLimit().whiteListNetworks(networks);
       }
     }
   }
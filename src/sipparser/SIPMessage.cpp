@@ -53,7 +53,8 @@ SIPMessage::SIPMessage() :
   _expectedBodyLen(0),
   _isResponse(boost::indeterminate),
   _isRequest(boost::indeterminate),
-  _userData(0)
+  _userData(0),
+  _receiveTime(0)
 {
   _idleBuffer.reserve(4);
 }
@@ -68,7 +69,8 @@ SIPMessage::SIPMessage(const std::string& packet) :
   _expectedBodyLen(0),
   _isResponse(boost::indeterminate),
   _isRequest(boost::indeterminate),
-  _userData(0)
+  _userData(0),
+  _receiveTime(0)
 {
   _data = packet;
   parse();
@@ -80,7 +82,8 @@ SIPMessage::SIPMessage(const unsigned char* packet, std::size_t len)  :
   _expectedBodyLen(0),
   _isResponse(boost::indeterminate),
   _isRequest(boost::indeterminate),
-  _userData(0)
+  _userData(0),
+  _receiveTime(0)
 {
   if (len)
   {
@@ -95,7 +98,8 @@ SIPMessage::SIPMessage(const char* packet, std::size_t len)  :
   _expectedBodyLen(0),
   _isResponse(boost::indeterminate),
   _isRequest(boost::indeterminate),
-  _userData(0)
+  _userData(0),
+  _receiveTime(0)
 {
   if (len)
   {
@@ -104,7 +108,8 @@ SIPMessage::SIPMessage(const char* packet, std::size_t len)  :
   }
 }
 
-SIPMessage::SIPMessage(const SIPMessage& packet)
+SIPMessage::SIPMessage(const SIPMessage& packet) :
+  _receiveTime(0)
 {
   ReadLock lock(packet._rwlock); 
 
@@ -549,6 +554,65 @@ bool SIPMessage::hdrRemove(const char* headerName)
 }
 
 
+void SIPMessage::hdrGetAll(SIPHeaderList& headers, std::string& startLine) const
+{
+  ReadLock lock(_rwlock);
+  startLine = _startLine;
+  if (!_finalized)
+  {
+    return;
+  }
+  headers = _headers;
+}
+
+bool SIPMessage::hdrCommit(const SIPHeaderList& headers, const std::string& startLine)
+{
+  WriteLock lock(_rwlock);
+
+  if (!_finalized)
+  {
+    return false;
+  }
+
+  if (!startLine.empty())
+  {
+    _startLine = startLine;
+  }
+
+  for (SIPHeaderList::const_iterator iter = headers.begin(); iter != headers.end(); iter++)
+  {
+    std::string key = iter->first;
+    boost::to_lower(key);
+    if (iter->second.empty())
+    {
+      _headers.erase(key);
+      continue;
+    }
+
+    SIPHeaderList::iterator current = _headers.find(key);
+    if (current == _headers.end())
+    {
+      SIPHeaderTokens tokens(iter->second);
+      if (tokens.rawHeaderName().empty())
+        tokens.rawHeaderName() = iter->first;
+      tokens.headerOffSet() = _headerOffSet++;
+      _headers[key] = tokens;
+    }
+    else
+    {
+      //
+      // Preserve the original header name and position
+      //
+      std::string rawHeaderName = current->second.rawHeaderName();
+      size_t headerOffSet = current->second.headerOffSet();
+      current->second = iter->second;
+      current->second.rawHeaderName() = rawHeaderName;
+      current->second.headerOffSet() = headerOffSet;
+    }
+  }
+  return true;
+}
+
 bool SIPMessage::hdrListAppend(const char* name, const std::string & value)
 {
   WriteLock lock(_rwlock);
@@ -1550,6 +1614,34 @@ void SIPMessage::setData(const std::string& data)
   _data = data;
 }
 
+void SIPMessage::setData(const char* data, std::size_t len)
+{
+  WriteLock lock(_rwlock);
+  _finalized = false;
+  _data.assign(data, len);
+}
+
+void SIPMessage::reset()
+{
+  WriteLock lock(_rwlock);
+  _data.clear();
+  _consumeState = IDLE;
+  _finalized = true;
+  _startLine.clear();
+  _body.clear();
+  _badHeaders.clear();
+  _headers.clear();
+  _headerOffSet = 0;
+  _expectedBodyLen = 0;
+  _isResponse = boost::indeterminate;
+  _isRequest = boost::indeterminate;
+  _properties.clear();
+  _userData = 0;
+  _receiveTime = 0;
+  _idleBuffer.clear();
+  _logContext.clear();
+}
+
 const std::string& SIPMessage::getBody() const
 {
   ReadLock lock(_rwlock);
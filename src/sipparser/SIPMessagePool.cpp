@@ -0,0 +1,153 @@
+// Library: OSS_CORE - Foundation API for SIP B2BUA
+// Copyright (c) OSS Software Solutions
+// Contributor: Joegen Baclor - mailto:joegen@ossapp.com
+//
+// Permission is hereby granted, to any person or organization
+// obtaining a copy of the software and accompanying documentation covered by
+// this license (the "Software") to use, execute, and to prepare
+// derivative works of the Software, all subject to the
+// "GNU Lesser General Public License (LGPL)".
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+// SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+// FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+
+
+#include <boost/pool/pool_alloc.hpp>
+#include "OSS/SIP/SIPMessagePool.h"
+
+
+namespace OSS {
+namespace SIP {
+
+
+class SIPMessagePool::Store : boost::noncopyable
+{
+public:
+  Store(std::size_t capacity) :
+    _capacity(capacity),
+    _isOpen(true),
+    _created(0),
+    _reused(0),
+    _recycled(0)
+  {
+    _free.reserve(capacity);
+  }
+
+  ~Store()
+  {
+    purge();
+  }
+
+  SIPMessage* take()
+  {
+    {
+      OSS::mutex_critic_sec_lock lock(_mutex);
+      if (!_free.empty())
+      {
+        SIPMessage* pMessage = _free.back();
+        _free.pop_back();
+        _reused++;
+        return pMessage;
+      }
+      _created++;
+    }
+    return new SIPMessage();
+  }
+
+  void give(SIPMessage* pMessage)
+  {
+    if (pMessage->data().capacity() <= MAX_RECYCLED_DATA)
+    {
+      pMessage->reset();
+      OSS::mutex_critic_sec_lock lock(_mutex);
+      if (_isOpen && _free.size() < _capacity)
+      {
+        _free.push_back(pMessage);
+        _recycled++;
+        return;
+      }
+    }
+    delete pMessage;
+  }
+
+  void close()
+  {
+    {
+      OSS::mutex_critic_sec_lock lock(_mutex);
+      _isOpen = false;
+    }
+    purge();
+  }
+
+  Stats getStats() const
+  {
+    OSS::mutex_critic_sec_lock lock(_mutex);
+    Stats stats;
+    stats.created = _created;
+    stats.reused = _reused;
+    stats.recycled = _recycled;
+    stats.available = _free.size();
+    return stats;
+  }
+
+private:
+  void purge()
+  {
+    std::vector<SIPMessage*> messages;
+    {
+      OSS::mutex_critic_sec_lock lock(_mutex);
+      messages.swap(_free);
+    }
+    for (std::vector<SIPMessage*>::iterator iter = messages.begin(); iter != messages.end(); iter++)
+    {
+      delete *iter;
+    }
+  }
+
+  mutable OSS::mutex_critic_sec _mutex;
+  std::vector<SIPMessage*> _free;
+  std::size_t _capacity;
+  bool _isOpen;
+  OSS::UInt64 _created;
+  OSS::UInt64 _reused;
+  OSS::UInt64 _recycled;
+};
+
+
+void SIPMessagePool::Recycler::operator()(SIPMessage* pMessage)
+{
+  store->give(pMessage);
+}
+
+SIPMessagePool::SIPMessagePool(std::size_t capacity) :
+  _store(new Store(capacity))
+{
+}
+
+SIPMessagePool::~SIPMessagePool()
+{
+  _store->close();
+}
+
+SIPMessage::Ptr SIPMessagePool::acquire()
+{
+  //
+  // The reference count block comes from a process wide pool of fixed size
+  // chunks.  Chunks are recycled but never handed back to the system.
+  //
+  return SIPMessage::Ptr(_store->take(), Recycler(_store), boost::fast_pool_allocator<SIPMessage>());
+}
+
+SIPMessagePool::Stats SIPMessagePool::getStats() const
+{
+  return _store->getStats();
+}
+
+
+} } // OSS::SIP
@@ -0,0 +1,332 @@
+// Library: OSS_CORE - Foundation API for SIP B2BUA
+// Copyright (c) OSS Software Solutions
+// Contributor: Joegen Baclor - mailto:joegen@ossapp.com
+//
+// Permission is hereby granted, to any person or organization
+// obtaining a copy of the software and accompanying documentation covered by
+// this license (the "Software") to use, execute, and to prepare
+// derivative works of the Software, all subject to the
+// "GNU Lesser General Public License (LGPL)".
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+// SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+// FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+
+
+#include <cstring>
+#include <strings.h>
+#include "OSS/SIP/SIPStreamFramer.h"
+
+
+namespace OSS {
+namespace SIP {
+
+
+static const std::size_t INITIAL_FRAMER_CAPACITY = 16384;
+static const std::size_t MAX_RETAINED_CAPACITY = 65536; /// Larger buffers are released once drained
+
+
+static inline bool is_lws(char c)
+{
+  return c == ' ' || c == '\t';
+}
+
+SIPStreamFramer::SIPStreamFramer(std::size_t maxHeaderSize, std::size_t maxBodySize) :
+  _buffer(0),
+  _capacity(0),
+  _begin(0),
+  _end(0),
+  _scanOffset(0),
+  _maxHeaderSize(maxHeaderSize),
+  _maxBodySize(maxBodySize)
+{
+}
+
+SIPStreamFramer::~SIPStreamFramer()
+{
+  delete [] _buffer;
+}
+
+void SIPStreamFramer::compact()
+{
+  if (!_begin)
+  {
+    return;
+  }
+
+  std::size_t pending = _end - _begin;
+  if (pending)
+  {
+    std::memmove(_buffer, _buffer + _begin, pending);
+  }
+  _begin = 0;
+  _end = pending;
+}
+
+char* SIPStreamFramer::prepare(std::size_t size)
+{
+  if (_capacity > MAX_RETAINED_CAPACITY && _end - _begin + size <= INITIAL_FRAMER_CAPACITY)
+  {
+    shrink();
+  }
+
+  if (_capacity - _end >= size)
+  {
+    return _buffer + _end;
+  }
+
+  compact();
+  if (_capacity - _end >= size)
+  {
+    return _buffer + _end;
+  }
+
+  std::size_t capacity = _capacity ? _capacity : INITIAL_FRAMER_CAPACITY;
+  while (capacity - _end < size)
+  {
+    capacity *= 2;
+  }
+
+  char* buffer = new char[capacity];
+  if (_end)
+  {
+    std::memcpy(buffer, _buffer, _end);
+  }
+  delete [] _buffer;
+  _buffer = buffer;
+  _capacity = capacity;
+  return _buffer + _end;
+}
+
+void SIPStreamFramer::shrink()
+{
+  //
+  // A single large frame grows the buffer up to the body size limit.  Go
+  // back to the initial size once it has been consumed so that idle
+  // connections do not each hold on to a megabyte.
+  //
+  std::size_t pending = _end - _begin;
+  char* buffer = new char[INITIAL_FRAMER_CAPACITY];
+  if (pending)
+  {
+    std::memcpy(buffer, _buffer + _begin, pending);
+  }
+  delete [] _buffer;
+  _buffer = buffer;
+  _capacity = INITIAL_FRAMER_CAPACITY;
+  _begin = 0;
+  _end = pending;
+}
+
+void SIPStreamFramer::commit(std::size_t size)
+{
+  _end += size;
+  if (_end > _capacity)
+  {
+    _end = _capacity;
+  }
+}
+
+void SIPStreamFramer::append(const char* data, std::size_t size)
+{
+  std::memcpy(prepare(size), data, size);
+  commit(size);
+}
+
+void SIPStreamFramer::reset()
+{
+  _begin = 0;
+  _end = 0;
+  _scanOffset = 0;
+}
+
+bool SIPStreamFramer::findContentLength(const char* header, std::size_t headerSize, std::size_t& contentLength)
+{
+  contentLength = 0;
+  const char* end = header + headerSize;
+
+  //
+  // Skip the start line.  Every header starts right after a LF
+  //
+  const char* line = static_cast<const char*>(std::memchr(header, '\n', headerSize));
+  while (line && ++line < end)
+  {
+    const char* value = 0;
+    std::size_t remaining = end - line;
+    if (remaining > 14 && ::strncasecmp(line, "content-length", 14) == 0)
+    {
+      value = line + 14;
+    }
+    else if (remaining > 1 && (*line == 'l' || *line == 'L') && (line[1] == ':' || is_lws(line[1])))
+    {
+      value = line + 1;
+    }
+
+    if (value)
+    {
+      while (value < end && is_lws(*value))
+      {
+        ++value;
+      }
+
+      if (value < end && *value == ':')
+      {
+        ++value;
+        while (value < end && is_lws(*value))
+        {
+          ++value;
+        }
+
+        std::size_t length = 0;
+        const char* digits = value;
+        while (value < end && *value >= '0' && *value <= '9')
+        {
+          length = length * 10 + (*value - '0');
+          if (length > 0xFFFFFFFF)
+          {
+            return false;
+          }
+          ++value;
+        }
+
+        while (value < end && is_lws(*value))
+        {
+          ++value;
+        }
+
+        if (value == digits || value >= end || *value != '\r')
+        {
+          return false;
+        }
+
+        contentLength = length;
+        return true;
+      }
+    }
+
+    line = static_cast<const char*>(std::memchr(line, '\n', end - line));
+  }
+
+  return true;
+}
+
+SIPStreamFramer::FrameResult SIPStreamFramer::next(const char*& frame, std::size_t& frameSize)
+{
+  frame = 0;
+  frameSize = 0;
+
+  //
+  // Leading CRLF are either keep-alive pings, pongs or padding between
+  // messages.  A full CRLFCRLF is reported so the transport can respond.
+  //
+  std::size_t start = _begin;
+  while (start < _end && (_buffer[start] == '\r' || _buffer[start] == '\n'))
+  {
+    ++start;
+  }
+
+  if (start != _begin)
+  {
+    if (start - _begin >= 4 && std::memcmp(_buffer + _begin, "\r\n\r\n", 4) == 0)
+    {
+      _begin += 4;
+      _scanOffset = 0;
+      return FRAME_KEEP_ALIVE;
+    }
+
+    if (start == _end)
+    {
+      //
+      // Might be the start of a ping that is not complete yet
+      //
+      return FRAME_INCOMPLETE;
+    }
+
+    _begin = start;
+    _scanOffset = 0;
+  }
+
+  if (_begin == _end)
+  {
+    _begin = _end = _scanOffset = 0;
+    return FRAME_INCOMPLETE;
+  }
+
+  //
+  // Find the end of the header block.  _scanOffset remembers how far a
+  // previous call got so partial reads are not rescanned.
+  //
+  const char* base = _buffer + _begin;
+  const char* end = _buffer + _end;
+  const char* cursor = base + _scanOffset;
+  const char* headerEnd = 0;
+  while (cursor < end)
+  {
+    cursor = static_cast<const char*>(std::memchr(cursor, '\r', end - cursor));
+    if (!cursor || end - cursor < 4)
+    {
+      break;
+    }
+    if (cursor[1] == '\n' && cursor[2] == '\r' && cursor[3] == '\n')
+    {
+      headerEnd = cursor + 4;
+      break;
+    }
+    ++cursor;
+  }
+
+  std::size_t pending = _end - _begin;
+  if (!headerEnd)
+  {
+    if (pending > _maxHeaderSize)
+    {
+      reset();
+      return FRAME_ERROR;
+    }
+    _scanOffset = pending > 3 ? pending - 3 : 0;
+    return FRAME_INCOMPLETE;
+  }
+
+  std::size_t headerSize = headerEnd - base;
+  std::size_t contentLength = 0;
+  if (headerSize > _maxHeaderSize ||
+    !findContentLength(base, headerSize, contentLength) ||
+    contentLength > _maxBodySize)
+  {
+    reset();
+    return FRAME_ERROR;
+  }
+
+  if (pending < headerSize + contentLength)
+  {
+    //
+    // Header is complete but the body is not.  Resume right at the header
+    // terminator next time.
+    //
+    _scanOffset = headerSize - 4;
+    return FRAME_INCOMPLETE;
+  }
+
+  frame = base;
+  frameSize = headerSize + contentLength;
+  _begin += frameSize;
+  _scanOffset = 0;
+
+  if (_begin == _end)
+  {
+    //
+    // Rewind without touching the bytes so frame stays valid
+    //
+    _begin = _end = 0;
+  }
+
+  return FRAME_COMPLETE;
+}
+
+
+} } // OSS::SIP
@@ -0,0 +1,170 @@
+// Library: OSS_CORE - Foundation API for SIP B2BUA
+// Copyright (c) OSS Software Solutions
+// Contributor: Joegen Baclor - mailto:joegen@ossapp.com
+//
+// Permission is hereby granted, to any person or organization
+// obtaining a copy of the software and accompanying documentation covered by
+// this license (the "Software") to use, execute, and to prepare
+// derivative works of the Software, all subject to the
+// "GNU Lesser General Public License (LGPL)".
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+// SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+// FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+
+
+#include "OSS/SIP/SIPStreamSendQueue.h"
+
+
+namespace OSS {
+namespace SIP {
+
+
+SIPStreamSendQueue::SIPStreamSendQueue(std::size_t maxBytes, std::size_t maxMessages) :
+  _queuedBytes(0),
+  _maxBytes(maxBytes),
+  _maxMessages(maxMessages),
+  _highWaterMark(0),
+  _writing(false),
+  _rejectedCount(0),
+  _batchCount(0),
+  _messageCount(0)
+{
+}
+
+SIPStreamSendQueue::~SIPStreamSendQueue()
+{
+}
+
+SIPStreamSendQueue::PushResult SIPStreamSendQueue::push(const char* data, std::size_t size)
+{
+  OSS::mutex_critic_sec_lock lock(_mutex);
+
+  if (_queuedBytes + size > _maxBytes || _pending.size() + _inflight.size() >= _maxMessages)
+  {
+    _rejectedCount++;
+    return PUSH_REJECTED;
+  }
+
+  _pending.push_back(std::string());
+  _pending.back().assign(data, size);
+  _queuedBytes += size;
+  if (_queuedBytes > _highWaterMark)
+  {
+    _highWaterMark = _queuedBytes;
+  }
+
+  if (_writing)
+  {
+    return PUSH_QUEUED;
+  }
+  _writing = true;
+  return PUSH_START_WRITE;
+}
+
+bool SIPStreamSendQueue::acquire()
+{
+  OSS::mutex_critic_sec_lock lock(_mutex);
+  if (_writing)
+  {
+    return false;
+  }
+  _writing = true;
+  return true;
+}
+
+bool SIPStreamSendQueue::nextBatch(Buffers& buffers)
+{
+  buffers.clear();
+
+  OSS::mutex_critic_sec_lock lock(_mutex);
+  if (_pending.empty())
+  {
+    _writing = false;
+    return false;
+  }
+
+  //
+  // Moving the strings into the in-flight list only swaps their internals.
+  // References into a deque stay valid while we append at the back.
+  //
+  std::size_t batchBytes = 0;
+  while (!_pending.empty() && buffers.size() < MAX_BATCH_BUFFERS &&
+    (buffers.empty() || batchBytes + _pending.front().size() <= MAX_BATCH_BYTES))
+  {
+    _inflight.push_back(std::string());
+    _inflight.back().swap(_pending.front());
+    _pending.pop_front();
+
+    const std::string& message = _inflight.back();
+    buffers.push_back(boost::asio::buffer(message.data(), message.size()));
+    batchBytes += message.size();
+  }
+
+  _batchCount++;
+  _messageCount += buffers.size();
+  return true;
+}
+
+void SIPStreamSendQueue::completeBatch()
+{
+  OSS::mutex_critic_sec_lock lock(_mutex);
+  for (Messages::iterator iter = _inflight.begin(); iter != _inflight.end(); iter++)
+  {
+    _queuedBytes -= iter->size();
+  }
+  _inflight.clear();
+}
+
+void SIPStreamSendQueue::clear()
+{
+  OSS::mutex_critic_sec_lock lock(_mutex);
+  _pending.clear();
+  _inflight.clear();
+  _queuedBytes = 0;
+  _writing = false;
+}
+
+std::size_t SIPStreamSendQueue::getQueuedBytes() const
+{
+  OSS::mutex_critic_sec_lock lock(_mutex);
+  return _queuedBytes;
+}
+
+std::size_t SIPStreamSendQueue::getQueuedMessages() const
+{
+  OSS::mutex_critic_sec_lock lock(_mutex);
+  return _pending.size() + _inflight.size();
+}
+
+std::size_t SIPStreamSendQueue::getHighWaterMark() const
+{
+  OSS::mutex_critic_sec_lock lock(_mutex);
+  return _highWaterMark;
+}
+
+OSS::UInt64 SIPStreamSendQueue::getRejectedCount() const
+{
+  OSS::mutex_critic_sec_lock lock(_mutex);
+  return _rejectedCount;
+}
+
+OSS::UInt64 SIPStreamSendQueue::getBatchCount() const
+{
+  OSS::mutex_critic_sec_lock lock(_mutex);
+  return _batchCount;
+}
+
+OSS::UInt64 SIPStreamSendQueue::getMessageCount() const
+{
+  OSS::mutex_critic_sec_lock lock(_mutex);
+  return _messageCount;
+}
+
+
+} } // OSS::SIP
@@ -58,6 +58,7 @@
 #include "OSS/SIP/SIPStreamedConnectionManager.h"
 #include "OSS/SIP/SIPFSMDispatch.h"
 #include "OSS/SIP/SIPListener.h"
+#include "OSS/Net/TLSSessionCache.h"
 
 
 namespace OSS {
@@ -193,6 +194,14 @@ void SIPStreamedConnection::stop()
 {
   OSS_LOG_WARNING("SIPStreamedConnection stopped reading from transport (" << getIdentifier() << ") " << getLocalAddress().toIpPortString() <<
     "->" << getRemoteAddress().toIpPortString() );
+  if (_pTlsStream)
+  {
+    //
+    // Closing without a close_notify makes OpenSSL evict the session from
+    // the server cache.  We are closing on purpose so keep it resumable.
+    //
+    SSL_set_shutdown(_pTlsStream->native_handle(), SSL_SENT_SHUTDOWN | SSL_RECEIVED_SHUTDOWN);
+  }
   _pTcpSocket->close();
 }
 
@@ -205,14 +214,14 @@ void SIPStreamedConnection::readSome()
   
   if (_pTlsStream)
   {
-    _pTlsStream->async_read_some(boost::asio::buffer(_buffer),
+    _pTlsStream->async_read_some(boost::asio::buffer(_framer.prepare(STREAMED_CONNECTION_BUFFER_SIZE), STREAMED_CONNECTION_BUFFER_SIZE),
         boost::bind(&SIPStreamedConnection::handleRead, shared_from_this(),
           boost::asio::placeholders::error,
           boost::asio::placeholders::bytes_transferred, (void*)0));
   }
   else
   {
-    _pTcpSocket->async_read_some(boost::asio::buffer(_buffer),
+    _pTcpSocket->async_read_some(boost::asio::buffer(_framer.prepare(STREAMED_CONNECTION_BUFFER_SIZE), STREAMED_CONNECTION_BUFFER_SIZE),
         boost::bind(&SIPStreamedConnection::handleRead, shared_from_this(),
           boost::asio::placeholders::error,
           boost::asio::placeholders::bytes_transferred, (void*)0));
@@ -226,36 +235,76 @@ void SIPStreamedConnection::writeMessage(const std::string& buf)
     return;
   }
   
+  switch (_sendQueue.push(buf))
+  {
+    case SIPStreamSendQueue::PUSH_START_WRITE:
+      startWrite();
+      break;
+    case SIPStreamSendQueue::PUSH_REJECTED:
+      OSS_LOG_WARNING("SIPStreamedConnection::writeMessage - send queue full for transport (" << getIdentifier() << ") "
+        << _sendQueue.getQueuedBytes() << " bytes pending.  Message dropped.");
+      break;
+    default:
+      break;
+  }
+}
+
+void SIPStreamedConnection::writeMessage(const std::string& buf, boost::system::error_code& ec)
+{
+  if (_isStopping)
+  {
+    return;
+  }
+  
+  if (!_sendQueue.acquire())
+  {
+    //
+    // A write is in flight.  Writing now would splice our bytes into the
+    // middle of a message.
+    //
+    writeMessage(buf);
+    return;
+  }
+
   if (_pTlsStream)
   {
-    ssl_socket& sock = *_pTlsStream;
-    boost::asio::async_write(sock, boost::asio::buffer(buf, buf.size()),
-          boost::bind(&SIPStreamedConnection::handleWrite, shared_from_this(),
-            boost::asio::placeholders::error));
+    boost::asio::write(*_pTlsStream, boost::asio::buffer(buf, buf.size()), ec);
   }
   else
   {
-    tcp_socket& sock = *_pTcpSocket;
-    boost::asio::async_write(sock, boost::asio::buffer(buf, buf.size()),
-          boost::bind(&SIPStreamedConnection::handleWrite, shared_from_this(),
-            boost::asio::placeholders::error));
+    boost::asio::write(*_pTcpSocket, boost::asio::buffer(buf, buf.size()), ec);
   }
+
+  if (ec)
+  {
+    _sendQueue.clear();
+    return;
+  }
+
+  //
+  // Hand the writer role back, flushing whatever was queued meanwhile
+  //
+  startWrite();
 }
 
-void SIPStreamedConnection::writeMessage(const std::string& buf, boost::system::error_code& ec)
+void SIPStreamedConnection::startWrite()
 {
-  if (_isStopping)
+  if (!_sendQueue.nextBatch(_writeBuffers))
   {
     return;
   }
-  
+
   if (_pTlsStream)
   {
-    _pTlsStream->write_some(boost::asio::buffer(buf, buf.size()), ec);
+    boost::asio::async_write(*_pTlsStream, _writeBuffers,
+          boost::bind(&SIPStreamedConnection::handleWrite, shared_from_this(),
+            boost::asio::placeholders::error));
   }
   else
   {
-    _pTcpSocket->write_some(boost::asio::buffer(buf, buf.size()), ec);
+    boost::asio::async_write(*_pTcpSocket, _writeBuffers,
+          boost::bind(&SIPStreamedConnection::handleWrite, shared_from_this(),
+            boost::asio::placeholders::error));
   }
 }
 
@@ -333,115 +382,29 @@ void SIPStreamedConnection::handleRead(const boost::system::error_code& e, std::
     //
     _readExceptionCount = 0;
 
-    if (!_pRequest)
-      _pRequest = SIPMessage::Ptr(new SIPMessage());
-
     _bytesRead =  bytes_transferred;
-    
-    boost::tribool result;
-    const char* begin = _buffer.data();
-    const char* end = _buffer.data() + bytes_transferred;
-    //boost::tie(result, boost::tuples::ignore) =
-    boost::tuple<boost::tribool, const char*> ret =  _pRequest->consume(begin, end);
-    result = ret.get<0>();
-    const char* tail = ret.get<1>();
-    if (result)
+    _framer.commit(bytes_transferred);
+
+    //
+    // Slice every complete message out of the read buffer.  Trunks pipeline
+    // many messages per read so this loop may run hundreds of times.
+    //
+    const char* frame = 0;
+    std::size_t frameSize = 0;
+    for (;;)
     {
-      //
-      // Message has been read in full
-      //
-      if (rateLimit().isBannedAddress(_lastReadAddress.address()))
+      SIPStreamFramer::FrameResult result = _framer.next(frame, frameSize);
+      if (result == SIPStreamFramer::FRAME_INCOMPLETE)
       {
-        OSS_LOG_DEBUG("ALERT: Dropping " << _pRequest->data().size() << " bytes from blocked address "
-          << _lastReadAddress.address().to_string());
-      }
-      else
-      {
-        dispatchMessage(_pRequest->shared_from_this(), shared_from_this());
-        rateLimit().logPacket(_lastReadAddress.address(), _pRequest->data().size());
-      }
-      
-      if (tail >= end)
-      {
-        //
-        // The end of the SIPMessage is reached so we can simply reset the
-        // request buffer and start the read operation all over again
-        //
-        _pRequest.reset();
-        readSome();
-        //
-        // We are done
-        //
-        return;
-      }
-      else
-      {
-        //
-        // This will happen if the tail is within the range of the end of the read buffer.
-        // We need to parse it as the start of the next message segment
-        //
-        OSS_LOG_DEBUG("SIPStreamedConnection::handleRead() detects compound message frames");
-        int tailIteration = 0;
-        while (tail < end && tailIteration < 10)
-        {
-          tailIteration++;
-          /// Reset the SIP Message
-          _pRequest.reset(new SIPMessage());
-
-          ret = _pRequest->consume(tail, end);
-          result = ret.get<0>();
-          tail = ret.get<1>();
-          if (result)
-          {
-            OSS_LOG_DEBUG("SIPStreamedConnection::handleRead() parsed " << tailIteration << " more SIP Request.");
-            dispatchMessage(_pRequest->shared_from_this(), shared_from_this());
-            continue;
-          }
-          else if (!boost::indeterminate(result))
-          {
-            //
-            // The message is not parsed correctly
-            //
-            OSS_LOG_WARNING("SIPStreamedConnection::handleRead() is not able to parse segment " << tailIteration);
-            continue;
-          }
-          else
-          {
-            OSS_LOG_WARNING("SIPStreamedConnection::handleRead() has marked segment " << tailIteration << " as partial request.")
-            //
-            // The message has been parsed but it is marked as indeterminate.
-            // We will not reset the buffer but instead continue the next read operation
-            //
-            readSome();
-            //
-            // We are done
-            //
-            return;
-          }
-        }
-        
-        _pRequest.reset();
-        readSome();
+        break;
       }
-    }
-    else if (!result)
-    {
-      _pRequest.reset();
-      readSome();
-    }
-    else
-    {
-      //
-      // We read a partial message.
-      // read again
-      //
-      if (_pRequest->idleBuffer() == "\r\n\r\n")
+      else if (result == SIPStreamFramer::FRAME_KEEP_ALIVE)
       {
         /// We received a PING, send a PONG
         std::string pong("\r\n");
         boost::system::error_code ec;
         writeMessage(pong, ec);
-       
+
         if (ec)
         {
           OSS_LOG_WARNING("SIPStreamedConnection::handleRead() Keep-Alive Exception - " << ec.message());
@@ -451,12 +414,47 @@ void SIPStreamedConnection::handleRead(const boost::system::error_code& e, std::
           _connectionManager.stop(shared_from_this());
           return;
         }
-        _pRequest.reset();
+        continue;
+      }
+      else if (result == SIPStreamFramer::FRAME_ERROR)
+      {
+        //
+        // Message boundaries are lost.  Whatever follows would be parsed
+        // from the middle of a message so drop the connection.
+        //
+        OSS_LOG_WARNING("SIPStreamedConnection::handleRead() is not able to frame the stream from "
+          << _lastReadAddress.toIpPortString() << ".  Closing connection.");
+        boost::system::error_code ignored_ec;
+        _pTcpSocket->shutdown(boost::asio::ip::tcp::socket::shutdown_both, ignored_ec);
+        _isStopping = true;
+        _connectionManager.stop(shared_from_this());
+        return;
       }
 
-      readSome();
-      return;
+      SIPMessage::Ptr pRequest;
+      try
+      {
+        pRequest = SIPMessage::Ptr(new SIPMessage(frame, frameSize));
+      }
+      catch(const OSS::Exception& ex)
+      {
+        OSS_LOG_WARNING("SIPStreamedConnection::handleRead() is not able to parse frame - " << ex.message());
+        continue;
+      }
+
+      if (rateLimit().isBannedAddress(_lastReadAddress.address()))
+      {
+        OSS_LOG_DEBUG("ALERT: Dropping " << frameSize << " bytes from blocked address "
+          << _lastReadAddress.address().to_string());
+      }
+      else
+      {
+        dispatchMessage(pRequest, shared_from_this());
+        rateLimit().logPacket(_lastReadAddress.address(), frameSize);
+      }
     }
+
+    readSome();
   }
   else
   {
@@ -482,6 +480,7 @@ void SIPStreamedConnection::handleWrite(const boost::system::error_code& e)
 {
   if (_isStopping)
   {
+    _sendQueue.clear();
     return;
   }
   
@@ -489,11 +488,16 @@ void SIPStreamedConnection::handleWrite(const boost::system::error_code& e)
   {
     // Initiate graceful connection closure.
     OSS_LOG_WARNING("SIPStreamedConnection::handleWrite() Exception " << e.message());
+    _sendQueue.clear();
     boost::system::error_code ignored_ec;
     _pTcpSocket->shutdown(boost::asio::ip::tcp::socket::shutdown_both, ignored_ec);
     _isStopping = true;
     _connectionManager.stop(shared_from_this());
+    return;
   }
+
+  _sendQueue.completeBatch();
+  startWrite();
 }
 
 void SIPStreamedConnection::writeMessage(SIPMessage::Ptr msg, const std::string& ip, const std::string& port)
@@ -581,6 +585,7 @@ bool SIPStreamedConnection::clientConnect(const OSS::Net::IPAddress& target, boo
       }
       else
       {
+        OSS::Net::TLSSessionCache::offerSessionForContext(_pTlsStream->native_handle(), _connectAddress.toIpPortString());
         _pTlsStream->async_handshake(boost::asio::ssl::stream_base::client,
             boost::bind(&SIPStreamedConnection::handleClientHandshake, shared_from_this(),
               boost::asio::placeholders::error));
@@ -616,6 +621,7 @@ void SIPStreamedConnection::handleConnect(const boost::system::error_code& e, bo
     }
     else
     {
+      OSS::Net::TLSSessionCache::offerSessionForContext(_pTlsStream->native_handle(), _connectAddress.toIpPortString());
       _pTlsStream->async_handshake(boost::asio::ssl::stream_base::client,
           boost::bind(&SIPStreamedConnection::handleClientHandshake, shared_from_this(),
             boost::asio::placeholders::error));
@@ -641,6 +647,7 @@ void SIPStreamedConnection::handleConnect(const boost::system::error_code& e, bo
 
 void SIPStreamedConnection::handleServerHandshake(const boost::system::error_code& e)
 {
+  OSS::Net::TLSSessionCache::recordHandshakeForContext(_pTlsStream->native_handle(), !e);
   if (!e)
   {
     //
@@ -677,6 +684,7 @@ void SIPStreamedConnection::handleServerHandshake(const boost::system::error_cod
 void SIPStreamedConnection::handleClientHandshake(const boost::system::error_code& e)
 {
   // this is only significant for TLS
+  OSS::Net::TLSSessionCache::recordHandshakeForContext(_pTlsStream->native_handle(), !e);
   if (!e && _isClient)
   {
     assert(_pTlsStream);
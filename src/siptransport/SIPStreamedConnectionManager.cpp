@@ -54,6 +54,7 @@ void SIPStreamedConnectionManager::add(SIPStreamedConnection::Ptr conn)
   if (!conn->getIdentifier())
     conn->setIdentifier(++_currentIdentifier);
   _connections[conn->getIdentifier()] = conn;
+  _addressIndex.add(conn->getIdentifier(), conn->getRemoteAddress(), conn->getTransportScheme(), conn);
   OSS_LOG_INFO("SIPStreamedConnectionManager Added transport (" << conn->getIdentifier() << ") "
     << conn->getLocalAddress().toIpPortString() <<
     "->" << conn->getRemoteAddress().toIpPortString() << " Count: " << _connections.size() );
@@ -65,6 +66,7 @@ void SIPStreamedConnectionManager::start(SIPStreamedConnection::Ptr conn)
   if (!conn->getIdentifier())
     conn->setIdentifier(++_currentIdentifier);
   _connections[conn->getIdentifier()] = conn;
+  _addressIndex.add(conn->getIdentifier(), conn->getRemoteAddress(), conn->getTransportScheme(), conn);
   conn->start(_dispatch);
   OSS_LOG_INFO("SIPStreamedConnectionManager started reading from transport (" << conn->getIdentifier() << ") "
     << conn->getLocalAddress().toIpPortString() <<
@@ -80,6 +82,7 @@ void SIPStreamedConnectionManager::stop(SIPStreamedConnection::Ptr conn)
     "->" << conn->getRemoteAddress().toIpPortString() << " Count: " << _connections.size() - 1);
 
   _connections.erase(conn->getIdentifier());
+  _addressIndex.remove(conn->getIdentifier());
   conn->stop();
 }
 
@@ -92,18 +95,20 @@ void SIPStreamedConnectionManager::stopAll()
     iter->second->stop();
   }
   _connections.clear();
+  _addressIndex.clear();
 }
 
 SIPStreamedConnection::Ptr SIPStreamedConnectionManager::findConnectionByAddress(const OSS::Net::IPAddress& target)
 {
-  OSS::mutex_read_lock rlock(_rwConnectionsMutex);
-  for (std::map<OSS::UInt64, SIPStreamedConnection::Ptr>::iterator iter = _connections.begin();
-    iter != _connections.end(); iter++)
-  {
-    if (iter->second->getRemoteAddress().compare(target, true))
-      return iter->second;
-  }
-  return SIPStreamedConnection::Ptr();
+  SIPStreamedConnection::Ptr conn = _addressIndex.find(target, "tcp");
+  if (!conn)
+    conn = _addressIndex.find(target, "tls");
+  return conn;
+}
+
+SIPStreamedConnection::Ptr SIPStreamedConnectionManager::findConnectionByAddress(const OSS::Net::IPAddress& target, const std::string& transport)
+{
+  return _addressIndex.find(target, transport);
 }
 
 SIPStreamedConnection::Ptr SIPStreamedConnectionManager::findConnectionById(OSS::UInt64 identifier)
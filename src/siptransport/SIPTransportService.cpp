@@ -54,6 +54,12 @@ SIPTransportService::SIPTransportService(const SIPTransportSession::Dispatch& di
   _wsPortMax(20000)
 #endif
 {
+  //
+  // Reconnect storms after a failover are dominated by handshake cost.
+  // Resume sessions on both sides by default.
+  //
+  _tlsSessionCache.attachServer(_tlsServerContext.native_handle(), "oss_core_sip");
+  _tlsSessionCache.attachClient(_tlsClientContext.native_handle());
 }
 
 SIPTransportService::~SIPTransportService()
@@ -626,7 +632,7 @@ SIPTransportSession::Ptr SIPTransportService::createClientTransport(
           << ". Trying remote-address=" << remoteAddress.toIpPortString());
       }
       
-      pTCPConnection = _tcpConMgr.findConnectionByAddress(remoteAddress);
+      pTCPConnection = _tcpConMgr.findConnectionByAddress(remoteAddress, "tcp");
     }
     
     if (!pTCPConnection)
@@ -699,7 +705,7 @@ SIPTransportSession::Ptr SIPTransportService::createClientTransport(
           << ". Trying remote-address=" << remoteAddress.toIpPortString());
       }
       
-      pTLSConnection = _tlsConMgr.findConnectionByAddress(remoteAddress);
+      pTLSConnection = _tlsConMgr.findConnectionByAddress(remoteAddress, "tls");
     }
 
     if (!pTLSConnection)
@@ -24,6 +24,8 @@
 #include <boost/asio.hpp>
 #include <boost/bind.hpp>
 #include <boost/function.hpp>
+#include <boost/make_shared.hpp>
+#include <boost/pool/pool_alloc.hpp>
 #include "OSS/SIP/SIPTransportSession.h"
 #include "OSS/SIP/SIPUDPConnection.h"
 #include "OSS/SIP/SIPUDPConnectionClone.h"
@@ -116,7 +118,7 @@ void SIPUDPConnection::handleRead(const boost::system::error_code& e, std::size_
   if (!e)
   {
     if (_pRequest == 0)
-      _pRequest = SIPMessage::Ptr(new SIPMessage());
+      _pRequest = _messagePool.acquire();
 
     _bytesRead =  bytes_transferred;
     if (_bytesRead > 20)
@@ -151,22 +153,19 @@ void SIPUDPConnection::handleRead(const boost::system::error_code& e, std::size_
         OSS_LOG_ERROR("Rate Limit Exception: Unknown exception.");
       }
 
-      std::string buffer(_buffer.data(), _buffer.data() + bytes_transferred);
-      
 #if ENABLE_FEATURE_XOR
       if (!SIPXOR::isEnabled())
       {
-        _pRequest->setData(buffer);
+        _pRequest->setData(_buffer.data(), bytes_transferred);
       }
-      else if (isSIPPacket(buffer.c_str()))
+      else if (isSIPPacket(_buffer.data()))
       {
-        _pRequest->setData(buffer);
+        _pRequest->setData(_buffer.data(), bytes_transferred);
       }
       else
       {
         SIPXOR::sipDecrypt(_buffer, bytes_transferred);
-        buffer = std::string(_buffer.begin(), bytes_transferred);//(char*)&newBuff[0];
-        if (!isSIPPacket(buffer.c_str()))
+        if (bytes_transferred < 4 || !isSIPPacket(_buffer.data()))
         {
           _pRequest.reset();
           if (_socket.is_open())
@@ -178,19 +177,22 @@ void SIPUDPConnection::handleRead(const boost::system::error_code& e, std::size_
           }
           return;
         }
-        _pRequest->setData(buffer);
+        _pRequest->setData(_buffer.data(), bytes_transferred);
         _pRequest->setProperty(OSS::PropertyMap::PROP_XOR, "1");
       }
 #else
-      _pRequest->setData(buffer);
+      _pRequest->setData(_buffer.data(), bytes_transferred);
 #endif
 
       //
       // Clone the current connection so that the dispatcher gets a static snapshot
       // since the old connection will be reused by the transport for UDP
       //
-      SIPUDPConnectionClone* clone = new SIPUDPConnectionClone(shared_from_this());
-      SIPTransportSession::Ptr pClone(clone);
+      // The clone and its reference count share one chunk from a fixed size
+      // pool that is recycled once the dispatcher lets go of the clone.
+      //
+      SIPTransportSession::Ptr pClone = boost::allocate_shared<SIPUDPConnectionClone>(
+        boost::fast_pool_allocator<SIPUDPConnectionClone>(), shared_from_this());
       dispatchMessage(_pRequest, pClone);
     }
     else if (_bytesRead == 4 &&
@@ -41,8 +41,12 @@ void SIPWebSocketConnection::ServerReadWriteHandler::on_close(websocketpp::serve
 void SIPWebSocketConnection::ServerReadWriteHandler::on_message(websocketpp::server::connection_ptr pConnection, websocketpp::server::handler::message_ptr pMsg)
 {
   	boost::system::error_code ec;
-  	std::string payload = pMsg->get_payload();
-  	_rConnection.handleRead(ec, payload.size(), &payload);
+  	//
+  	// handleRead() only parses the buffer so hand it the pooled payload
+  	// instead of copying it
+  	//
+  	const std::string& payload = pMsg->get_payload();
+  	_rConnection.handleRead(ec, payload.size(), const_cast<std::string*>(&payload));
 }
 
 void SIPWebSocketConnection::ServerReadWriteHandler::on_error(websocketpp::server::connection_ptr pConnection)
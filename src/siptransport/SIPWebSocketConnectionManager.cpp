@@ -60,6 +60,7 @@ void SIPWebSocketConnectionManager::add(SIPWebSocketConnection::Ptr conn)
     pConnection->setIdentifier((OSS::UInt64)pConnection->_pServerConnection.get());
 
   _connections[conn->getIdentifier()] = conn;
+  _addressIndex.add(conn->getIdentifier(), conn->getRemoteAddress(), conn->getTransportScheme(), conn);
   OSS_LOG_INFO("SIPWebSocketConnection Added transport (" << pConnection->getIdentifier() << ") "
     << pConnection->getLocalAddress().toIpPortString() <<
     "->" << pConnection->getRemoteAddress().toIpPortString() );
@@ -76,6 +77,7 @@ void SIPWebSocketConnectionManager::start(SIPWebSocketConnection::Ptr conn)
     pConnection->setIdentifier((OSS::UInt64)pConnection->_pServerConnection.get());
 
   _connections[conn->getIdentifier()] = conn;
+  _addressIndex.add(conn->getIdentifier(), conn->getRemoteAddress(), conn->getTransportScheme(), conn);
 
   pConnection->start(_dispatch);
   OSS_LOG_INFO("SIPWebSocketConnection started reading from transport (" << pConnection->getIdentifier() << ") "
@@ -92,6 +94,7 @@ void SIPWebSocketConnectionManager::stop(SIPWebSocketConnection::Ptr conn)
     "->" << conn->getRemoteAddress().toIpPortString() );
 
   _connections.erase(conn->getIdentifier());
+  _addressIndex.remove(conn->getIdentifier());
   conn->stop();
 }
 
@@ -104,18 +107,12 @@ void SIPWebSocketConnectionManager::stopAll()
     iter->second->stop();
   }
   _connections.clear();
+  _addressIndex.clear();
 }
 
 SIPWebSocketConnection::Ptr SIPWebSocketConnectionManager::findConnectionByAddress(const OSS::Net::IPAddress& target)
 {
-  OSS::mutex_read_lock rlock(_rwConnectionsMutex);
-  for (std::map<OSS::UInt64, SIPWebSocketConnection::Ptr>::iterator iter = _connections.begin();
-    iter != _connections.end(); iter++)
-  {
-    if (iter->second->getRemoteAddress().compare(target, true))
-      return iter->second;
-  }
-  return SIPWebSocketConnection::Ptr();
+  return _addressIndex.find(target, "ws");
 }
 
 SIPWebSocketConnection::Ptr SIPWebSocketConnectionManager::findConnectionById(OSS::UInt64 identifier)
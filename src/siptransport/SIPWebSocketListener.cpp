@@ -70,6 +70,7 @@ void SIPWebSocketListener::ServerAcceptHandler::on_open(websocketpp::server::con
 void SIPWebSocketListener::ServerAcceptHandler::validate(websocketpp::server::connection_ptr pConnection)
 {
   pConnection->select_subprotocol("sip");
+  pConnection->set_permessage_deflate(_rListener.getPerMessageDeflate());
 }
 
 SIPWebSocketListener::SIPWebSocketListener(
@@ -84,6 +85,7 @@ SIPWebSocketListener::SIPWebSocketListener(
 {
 	_pServerThread = 0;
 	_pClientThread = 0;
+	_deflateConfig.enabled = true;
 }
 
 SIPWebSocketListener::~SIPWebSocketListener()
@@ -101,6 +103,14 @@ void SIPWebSocketListener::run()
   }
 }
 
+void SIPWebSocketListener::setPerMessageDeflate(bool enabled, bool contextTakeover, int level, std::size_t minSize)
+{
+  _deflateConfig.enabled = enabled;
+  _deflateConfig.context_takeover = contextTakeover;
+  _deflateConfig.level = level;
+  _deflateConfig.min_size = minSize;
+}
+
 void SIPWebSocketListener::run_server()
 {
   assert(!_pServerEndPoint);
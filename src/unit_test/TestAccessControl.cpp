@@ -1,6 +1,10 @@
 #include "gtest/gtest.h"
 #include "OSS/Net/AccessControl.h"
 #include "OSS/UTL/AdaptiveDelay.h"
+#include "OSS/UTL/CoreUtils.h"
+#include "OSS/Net/PrefixTrie.h"
+#include "OSS/Net/SourceRateTable.h"
+#include "OSS/Net/Net.h"
 
 static const std::string DB_PATH = "access-control";
 static const std::string DOCUMENT_ROOT = "/root/" + DB_PATH;
@@ -57,6 +61,21 @@ TEST(AccessControlTest, WhiteListNetwork)
   
   ASSERT_FALSE(acc.isWhiteListed("192.168.4.4"));
   ASSERT_FALSE(acc.isWhiteListed("192.168.5.5"));
+
+  //
+  // Bulk load keeps what is already listed
+  //
+  OSS::Net::AccessControl::NetworkWhiteList networks;
+  networks.insert("10.0.0.0/8");
+  networks.insert("2001:db8::/32");
+  acc.whiteListNetworks(networks);
+  ASSERT_TRUE(acc.isWhiteListed("192.168.1.1"));
+  ASSERT_TRUE(acc.isWhiteListed("10.1.2.3"));
+  ASSERT_TRUE(acc.isWhiteListed("2001:db8::1"));
+  ASSERT_FALSE(acc.isWhiteListed("11.1.2.3"));
+
+  acc.clearWhiteListNetwork("10.0.0.0/8");
+  ASSERT_FALSE(acc.isWhiteListed("10.1.2.3"));
 }
 
 TEST(AccessControlTest, LogPacket)
@@ -80,3 +99,202 @@ TEST(AccessControlTest, LogPacket)
   }
   ASSERT_TRUE(acc.isBannedAddress("192.168.1.100"));
 }
+
+TEST(AccessControlTest, NetworkPrefixTrie)
+{
+  OSS::Net::PrefixTrie trie;
+  ASSERT_TRUE(trie.insert("10.0.0.0/8"));
+  ASSERT_TRUE(trie.insert("10.1.0.0/16"));
+  ASSERT_TRUE(trie.insert("10.1.2.3/32"));
+  ASSERT_TRUE(trie.insert("192.168.1.0"));
+  ASSERT_TRUE(trie.insert("2001:db8::/32"));
+  ASSERT_TRUE(trie.insert("2001:db8:1::/48"));
+  ASSERT_FALSE(trie.insert("10.0.0.0/33"));
+  ASSERT_FALSE(trie.insert("not-an-address/8"));
+  ASSERT_EQ(trie.size(), 6);
+
+  ASSERT_EQ(trie.lookup(boost::asio::ip::address::from_string("10.200.1.1")), 0);
+  ASSERT_EQ(trie.lookup(boost::asio::ip::address::from_string("10.1.200.1")), 1);
+  ASSERT_EQ(trie.lookup(boost::asio::ip::address::from_string("10.1.2.3")), 2);
+  ASSERT_EQ(trie.lookup(boost::asio::ip::address::from_string("10.1.2.4")), 1);
+  ASSERT_EQ(trie.lookup(boost::asio::ip::address::from_string("192.168.1.254")), 3);
+  ASSERT_EQ(trie.lookup(boost::asio::ip::address::from_string("::ffff:192.168.1.254")), 3);
+  ASSERT_EQ(trie.lookup(boost::asio::ip::address::from_string("192.168.2.1")), -1);
+  ASSERT_EQ(trie.lookup(boost::asio::ip::address::from_string("2001:db8:2::1")), 4);
+  ASSERT_EQ(trie.lookup(boost::asio::ip::address::from_string("2001:db8:1::1")), 5);
+  ASSERT_EQ(trie.lookup(boost::asio::ip::address::from_string("2001:db9::1")), -1);
+
+  OSS::Net::AccessControl acc;
+  acc.enabled() = true;
+  acc.blackListNetwork("172.16.0.0/12");
+  acc.blackListNetwork("2001:db8::/32");
+  ASSERT_TRUE(acc.isBlackListedNetwork("172.31.255.255"));
+  ASSERT_TRUE(acc.isBlackListedNetwork("2001:db8::5060"));
+  ASSERT_FALSE(acc.isBlackListedNetwork("172.32.0.1"));
+  acc.clearNetwork("172.16.0.0/12");
+  ASSERT_FALSE(acc.isBlackListedNetwork("172.31.255.255"));
+  ASSERT_TRUE(acc.isBlackListedNetwork("2001:db8::5060"));
+}
+
+TEST(AccessControlTest, NetworkPrefixTrieBenchmark)
+{
+  //
+  // 10k aligned IPv4 prefixes between /8 and /32.  Verify the trie agrees
+  // with socket_address_cidr_verify and compare lookup cost against the
+  // linear CIDR scan it replaces.
+  //
+  const int prefixCount = 10000;
+  const int lookupCount = 1000000;
+  const int scanCount = 100;
+
+  boost::uint32_t seed = 5060;
+  std::vector<std::string> networks;
+  OSS::Net::PrefixTrie trie;
+  for (int i = 0; i < prefixCount; i++)
+  {
+    seed = seed * 1664525 + 1013904223;
+    unsigned bits = 8 + (seed % 25);
+    seed = seed * 1664525 + 1013904223;
+    boost::uint32_t mask = bits == 32 ? 0xFFFFFFFF : ~(0xFFFFFFFF >> bits);
+    boost::asio::ip::address_v4 network(seed & mask);
+    std::ostringstream cidr;
+    cidr << network.to_string() << "/" << bits;
+    networks.push_back(cidr.str());
+    ASSERT_TRUE(trie.insert(cidr.str()));
+  }
+
+  std::vector<boost::asio::ip::address> addresses;
+  for (int i = 0; i < 1024; i++)
+  {
+    seed = seed * 1664525 + 1013904223;
+    addresses.push_back(boost::asio::ip::address_v4(seed));
+  }
+
+  for (int i = 0; i < scanCount; i++)
+  {
+    bool expected = false;
+    for (std::vector<std::string>::iterator iter = networks.begin(); iter != networks.end() && !expected; iter++)
+      expected = OSS::socket_address_cidr_verify(addresses[i].to_string(), *iter);
+    ASSERT_EQ(trie.match(addresses[i]), expected);
+  }
+
+  OSS::UInt64 start = OSS::getTime();
+  int matched = 0;
+  for (int i = 0; i < lookupCount; i++)
+  {
+    if (trie.match(addresses[i & 1023]))
+      ++matched;
+  }
+  OSS::UInt64 trieTime = OSS::getTime() - start;
+
+  start = OSS::getTime();
+  for (int i = 0; i < scanCount; i++)
+  {
+    std::string ip = addresses[i].to_string();
+    for (std::vector<std::string>::iterator iter = networks.begin(); iter != networks.end(); iter++)
+    {
+      if (OSS::socket_address_cidr_verify(ip, *iter))
+        break;
+    }
+  }
+  OSS::UInt64 scanTime = OSS::getTime() - start;
+
+  std::cout << "PrefixTrie nodes for " << prefixCount << " prefixes: " << trie.getNodeCount() << std::endl;
+  std::cout << "PrefixTrie lookup: " << (trieTime * 1000000.0) / lookupCount << " ns (" << matched << " matched)" << std::endl;
+  std::cout << "CIDR scan lookup: " << (scanTime * 1000000.0) / scanCount << " ns" << std::endl;
+}
+
+TEST(AccessControlTest, SourceRateTable)
+{
+  OSS::Net::SourceRateTable table(10, 5);
+  boost::asio::ip::address source = boost::asio::ip::address::from_string("10.0.0.1");
+  boost::asio::ip::address mapped = boost::asio::ip::address::from_string("::ffff:10.0.0.1");
+  boost::asio::ip::address other = boost::asio::ip::address::from_string("2001:db8::1");
+  OSS::UInt64 now = 1000;
+
+  //
+  // The burst goes through, the next packet is over the rate
+  //
+  for (int i = 0; i < 5; i++)
+    ASSERT_EQ(table.consume(source, now), OSS::Net::SourceRateTable::RATE_OK);
+  ASSERT_EQ(table.consume(mapped, now), OSS::Net::SourceRateTable::RATE_EXCEEDED);
+  ASSERT_EQ(table.consume(source, now), OSS::Net::SourceRateTable::RATE_STILL_EXCEEDED);
+  ASSERT_EQ(table.consume(other, now), OSS::Net::SourceRateTable::RATE_OK);
+  ASSERT_EQ(table.size(), 2);
+
+  //
+  // 10 per second is one token every 100 ms
+  //
+  ASSERT_EQ(table.getTokens(source, now + 99), 0);
+  ASSERT_EQ(table.consume(source, now + 100), OSS::Net::SourceRateTable::RATE_OK);
+  ASSERT_EQ(table.consume(source, now + 150), OSS::Net::SourceRateTable::RATE_EXCEEDED);
+  ASSERT_EQ(table.getTokens(source, now + 10000), 5);
+
+  //
+  // Idle sources are dropped
+  //
+  table.setIdleTimeout(5000);
+  ASSERT_EQ(table.evictIdle(now + 4000), 0);
+  table.consume(other, now + 4000);
+  ASSERT_EQ(table.evictIdle(now + 6000), 1);
+  ASSERT_EQ(table.size(), 1);
+  ASSERT_EQ(table.getTokens(source, now + 6000), 5);
+  table.clear();
+  ASSERT_EQ(table.size(), 0);
+
+  //
+  // A full table lets unknown sources through
+  //
+  OSS::Net::SourceRateTable small(1, 1, OSS::Net::SourceRateTable::SHARD_COUNT);
+  for (boost::uint32_t i = 0; i < 1024; i++)
+    ASSERT_EQ(small.consume(boost::asio::ip::address_v4(0x0A000000 + i), now), OSS::Net::SourceRateTable::RATE_OK);
+  ASSERT_LE(small.size(), (std::size_t)OSS::Net::SourceRateTable::SHARD_COUNT);
+  ASSERT_EQ(small.size() + small.getOverflowCount(), 1024);
+}
+
+TEST(AccessControlTest, SourceRateTableBenchmark)
+{
+  //
+  // One million distinct sources followed by a second pass over the same
+  // sources.  Compare against the mutex protected address map that
+  // logPacket used to increment for every packet.
+  //
+  const int sourceCount = 1000000;
+
+  std::vector<boost::asio::ip::address> sources;
+  sources.reserve(sourceCount);
+  boost::uint32_t seed = 5060;
+  for (int i = 0; i < sourceCount; i++)
+  {
+    seed = seed * 1664525 + 1013904223;
+    sources.push_back(boost::asio::ip::address_v4(seed));
+  }
+
+  OSS::Net::SourceRateTable table(50, 50);
+  OSS::UInt64 now = OSS::getTime();
+  OSS::UInt64 start = OSS::getTime();
+  for (int pass = 0; pass < 2; pass++)
+  {
+    for (int i = 0; i < sourceCount; i++)
+      ASSERT_EQ(table.consume(sources[i], now), OSS::Net::SourceRateTable::RATE_OK);
+  }
+  OSS::UInt64 tableTime = OSS::getTime() - start;
+  ASSERT_EQ(table.size(), sourceCount);
+
+  boost::recursive_mutex mutex;
+  std::map<boost::asio::ip::address, unsigned int> counter;
+  start = OSS::getTime();
+  for (int pass = 0; pass < 2; pass++)
+  {
+    for (int i = 0; i < sourceCount; i++)
+    {
+      mutex.lock();
+      ++counter[sources[i]];
+      mutex.unlock();
+    }
+  }
+  OSS::UInt64 mapTime = OSS::getTime() - start;
+
+  std::cout << "SourceRateTable consume: " << (tableTime * 1000000.0) / (sourceCount * 2) << " ns" << std::endl;
+  std::cout << "Packet counter map: " << (mapTime * 1000000.0) / (sourceCount * 2) << " ns" << std::endl;
+}
@@ -0,0 +1,198 @@
+#include "gtest/gtest.h"
+
+#include "OSS/build.h"
+#if ENABLE_FEATURE_B2BUA && ENABLE_FEATURE_NET_EXTRA
+
+#include "OSS/UTL/CoreUtils.h"
+#include "OSS/UTL/Thread.h"
+#include "OSS/SIP/B2BUA/SIPB2BRaftDataStore.h"
+#include <boost/lexical_cast.hpp>
+#include <algorithm>
+#include <vector>
+
+
+using OSS::SIP::B2BUA::SIPB2BRaftDataStore;
+using OSS::SIP::B2BUA::SIPB2BDialogDataStoreCb;
+using OSS::SIP::B2BUA::DialogData;
+using OSS::SIP::B2BUA::DialogList;
+using OSS::SIP::B2BUA::RegData;
+using OSS::SIP::B2BUA::RegList;
+
+
+//
+// Three B2BUA nodes replicating their state over loopback TCP
+//
+static const int RAFT_STORE_BASE_PORT = 27170;
+
+struct RaftStoreNode
+{
+  SIPB2BRaftDataStore store;
+  SIPB2BDialogDataStoreCb callbacks;
+};
+
+static std::string raft_store_port(int id)
+{
+  return boost::lexical_cast<std::string>(RAFT_STORE_BASE_PORT + id);
+}
+
+static RaftStoreNode* start_raft_store_node(int id, bool isMaster)
+{
+  SIPB2BRaftDataStore::Options opt;
+  opt.node_id = id;
+  opt.is_master = isMaster;
+  opt.periodic_timer_ms = 20;
+  opt.election_timeout_ms = 300;
+  
+  RaftStoreNode* pNode = new RaftStoreNode();
+  if (!pNode->store.initialize(opt) || !pNode->store.listen("127.0.0.1", raft_store_port(id)))
+  {
+    delete pNode;
+    return 0;
+  }
+  for (int peer = 1; peer <= 3; peer++)
+  {
+    if (peer != id)
+    {
+      pNode->store.addPeer(peer, "127.0.0.1", raft_store_port(peer));
+    }
+  }
+  pNode->store.attach(pNode->callbacks);
+  pNode->store.run();
+  return pNode;
+}
+
+static DialogData raft_store_dialog(const std::string& sessionId, const std::string& callId)
+{
+  DialogData dialog;
+  dialog.sessionId = sessionId;
+  dialog.leg1.callId = callId;
+  dialog.leg1.from = "<sip:alice@example.com>;tag=1234";
+  dialog.leg1.to = "<sip:bob@example.com>";
+  dialog.leg1.remoteContact = "<sip:alice@192.168.1.10:5060>";
+  dialog.leg2.callId = callId + "-2";
+  return dialog;
+}
+
+static bool wait_for_dialog(SIPB2BRaftDataStore& store, const std::string& sessionId, bool present, int timeoutMs)
+{
+  for (int waited = 0; store.hasDialog(sessionId) != present; waited++)
+  {
+    if (waited >= timeoutMs)
+    {
+      return false;
+    }
+    OSS::thread_sleep(1);
+  }
+  return true;
+}
+
+static int wait_for_leader(RaftStoreNode** nodes, int timeoutMs)
+{
+  for (int waited = 0; waited < timeoutMs; waited++)
+  {
+    for (int id = 1; id <= 3; id++)
+    {
+      if (nodes[id] && nodes[id]->store.isLeader())
+      {
+        return id;
+      }
+    }
+    OSS::thread_sleep(1);
+  }
+  return 0;
+}
+
+TEST(B2BUATest, TestB2BRaftDataStore)
+{
+  RaftStoreNode* nodes[4] = { 0, 0, 0, 0 };
+  for (int id = 1; id <= 3; id++)
+  {
+    nodes[id] = start_raft_store_node(id, id == 1);
+    ASSERT_TRUE(nodes[id] != 0);
+  }
+  ASSERT_EQ(wait_for_leader(nodes, 5000), 1);
+  
+  //
+  // Replication latency of a single update written on a follower until it
+  // can be read on the other follower
+  //
+  const int SAMPLES = 200;
+  std::vector<OSS::UInt64> latencies;
+  for (int i = 0; i < SAMPLES; i++)
+  {
+    std::string sessionId = "latency-" + boost::lexical_cast<std::string>(i);
+    OSS::UInt64 start = OSS::getTime();
+    ASSERT_TRUE(nodes[2]->callbacks.dbPersist(raft_store_dialog(sessionId, "call-" + sessionId)));
+    ASSERT_TRUE(wait_for_dialog(nodes[3]->store, sessionId, true, 2000));
+    latencies.push_back(OSS::getTime() - start);
+  }
+  std::sort(latencies.begin(), latencies.end());
+  std::cout << "SIPB2BRaftDataStore replication latency over TCP: median " << latencies[SAMPLES / 2]
+    << " ms, p99 " << latencies[SAMPLES * 99 / 100] << " ms" << std::endl;
+  
+  //
+  // A burst of updates from every node is coalesced into few log entries
+  //
+  const int BURST = 3000;
+  int firstIndex = nodes[1]->store.getCurrentIndex();
+  OSS::UInt64 start = OSS::getTime();
+  for (int i = 0; i < BURST; i++)
+  {
+    std::string sessionId = "burst-" + boost::lexical_cast<std::string>(i);
+    ASSERT_TRUE(nodes[1 + i % 3]->callbacks.dbPersist(raft_store_dialog(sessionId, "call-" + sessionId)));
+  }
+  for (int id = 1; id <= 3; id++)
+  {
+    ASSERT_TRUE(nodes[id]->store.waitForPending(10000));
+  }
+  ASSERT_TRUE(wait_for_dialog(nodes[3]->store, "burst-" + boost::lexical_cast<std::string>(BURST - 1), true, 2000));
+  int entries = nodes[1]->store.getCurrentIndex() - firstIndex;
+  std::cout << "SIPB2BRaftDataStore " << BURST << " updates replicated in " << OSS::getTime() - start
+    << " ms using " << entries << " log entries" << std::endl;
+  ASSERT_LT(entries, BURST);
+  
+  //
+  // Reads are served by the local copy on every node
+  //
+  DialogList dialogs;
+  nodes[3]->callbacks.dbGetAll(dialogs);
+  ASSERT_EQ(dialogs.size(), (std::size_t)(SAMPLES + BURST));
+  
+  RegData reg;
+  reg.key = "reg-alice";
+  reg.aor = "sip:alice@example.com";
+  reg.contact = "sip:alice@192.168.1.10:5060";
+  ASSERT_TRUE(nodes[3]->callbacks.dbPersistReg(reg));
+  nodes[3]->callbacks.dbRemoveAllDialogs("call-latency-0");
+  ASSERT_TRUE(nodes[3]->store.waitForPending(2000));
+  RegData found;
+  ASSERT_TRUE(nodes[3]->callbacks.dbGetOneReg(OSS::SIP::SIPMessage::Ptr(), "reg-alice", found));
+  ASSERT_EQ(found.contact, reg.contact);
+  ASSERT_FALSE(nodes[3]->store.hasDialog("latency-0"));
+  
+  //
+  // The leader goes away.  Time until the survivors elected a new leader
+  // and an update written on one is readable on the other.
+  //
+  ASSERT_TRUE(wait_for_dialog(nodes[2]->store, "latency-0", false, 2000));
+  start = OSS::getTime();
+  delete nodes[1];
+  nodes[1] = 0;
+  ASSERT_TRUE(nodes[2]->callbacks.dbPersist(raft_store_dialog("failover", "call-failover")));
+  ASSERT_TRUE(wait_for_dialog(nodes[3]->store, "failover", true, 10000));
+  OSS::UInt64 failover = OSS::getTime() - start;
+  int leader = wait_for_leader(nodes, 1000);
+  std::cout << "SIPB2BRaftDataStore failover: node " << leader << " took over and replicated in " << failover << " ms" << std::endl;
+  ASSERT_NE(leader, 0);
+  ASSERT_EQ(nodes[2]->store.getDialogCount(), (std::size_t)(SAMPLES + BURST));
+  ASSERT_EQ(nodes[2]->store.getRegistrationCount(), (std::size_t)1);
+  
+  delete nodes[2];
+  delete nodes[3];
+}
+
+#else
+
+TEST(NullTest, null_test_b2b_raft_data_store){}
+
+#endif
@@ -57,10 +57,13 @@ See also: For more string comparison tricks (substring, prefix, suffix, and regu
 
 #include <set>
 #include <memory>
+#include <iostream>
+#include <cstdlib>
 
 #include "gtest/gtest.h"
 #include "OSS/build.h"
 #include "OSS/BSON/BSON.h"
+#include "OSS/UTL/CoreUtils.h"
 
 
 
@@ -77,6 +80,8 @@ using OSS::BSON::BSONDocument;
 using OSS::BSON::BSONQueue;
 #endif
 using OSS::BSON::BSONIterator;
+using OSS::BSON::BSONWriter;
+using OSS::BSON::BSONView;
 
 
 TEST(BSONTest, BSONDoc)
@@ -267,6 +272,318 @@ TEST(BSONTest, BSONDoc)
   
 }
 
+TEST(BSONTest, BSONWriterView)
+{
+  std::string buffer;
+  BSONWriter writer(buffer);
+  ASSERT_TRUE(writer.appendString("string", "This is a UTF8 string"));
+  ASSERT_TRUE(writer.appendBoolean("bool", true));
+  ASSERT_TRUE(writer.appendDouble("double", 123.456));
+  ASSERT_TRUE(writer.appendInt32("int32", -123456));
+  ASSERT_TRUE(writer.appendInt64("int64", 1234567890123LL));
+  ASSERT_TRUE(writer.appendBinary("binary", std::string("\0\1\2", 3)));
+  ASSERT_TRUE(writer.appendArrayBegin("array"));
+  ASSERT_TRUE(writer.appendString("0", "Element 1"));
+  ASSERT_TRUE(writer.appendString("1", "Element 2"));
+  ASSERT_TRUE(writer.appendArrayEnd());
+  ASSERT_TRUE(writer.appendDocumentBegin("document"));
+  ASSERT_TRUE(writer.appendString("key1", "Element 1"));
+  ASSERT_TRUE(writer.appendDocumentBegin("inner"));
+  ASSERT_TRUE(writer.appendInt32("key2", 2));
+  ASSERT_FALSE(writer.finish());
+  ASSERT_FALSE(writer.appendArrayEnd());
+  ASSERT_TRUE(writer.appendDocumentEnd());
+  ASSERT_TRUE(writer.appendDocumentEnd());
+  ASSERT_TRUE(writer.finish());
+  ASSERT_EQ(buffer.size(), writer.getDataLength());
+  ASSERT_TRUE((const uint8_t*)buffer.data() == writer.getData());
+
+  //
+  // libbson must read what the writer produced
+  //
+  BSONParser parser(writer.getData(), writer.getDataLength());
+  std::string str;
+  bool b = false;
+  double d = 0;
+  int32_t i32 = 0;
+  int64_t i64 = 0;
+  ASSERT_TRUE(parser.getString("string", str));
+  ASSERT_STREQ(str.c_str(), "This is a UTF8 string");
+  ASSERT_TRUE(parser.getBoolean("bool", b));
+  ASSERT_TRUE(b);
+  ASSERT_TRUE(parser.getDouble("double", d));
+  ASSERT_EQ(d, 123.456);
+  ASSERT_TRUE(parser.getInt32("int32", i32));
+  ASSERT_EQ(i32, -123456);
+  ASSERT_TRUE(parser.getInt64("int64", i64));
+  ASSERT_EQ(i64, 1234567890123LL);
+  ASSERT_TRUE(parser.getString("array.1", str));
+  ASSERT_STREQ(str.c_str(), "Element 2");
+  ASSERT_TRUE(parser.getInt32("document.inner.key2", i32));
+  ASSERT_EQ(i32, 2);
+
+  BSONView view(writer.getData(), writer.getDataLength());
+  ASSERT_TRUE(view.isValid());
+  ASSERT_TRUE(view.getString("string", str));
+  ASSERT_STREQ(str.c_str(), "This is a UTF8 string");
+  const char* cstr = 0;
+  std::size_t len = 0;
+  ASSERT_TRUE(view.getString("document.key1", cstr, len));
+  ASSERT_EQ(len, 9);
+  ASSERT_TRUE(cstr > (const char*)buffer.data() && cstr < (const char*)buffer.data() + buffer.size());
+  ASSERT_TRUE(view.getBoolean("bool", b));
+  ASSERT_TRUE(b);
+  ASSERT_TRUE(view.getDouble("double", d));
+  ASSERT_EQ(d, 123.456);
+  ASSERT_TRUE(view.getInt32("int32", i32));
+  ASSERT_EQ(i32, -123456);
+  ASSERT_TRUE(view.getInt64("int64", i64));
+  ASSERT_EQ(i64, 1234567890123LL);
+  const uint8_t* bin = 0;
+  ASSERT_TRUE(view.getBinary("binary", bin, len));
+  ASSERT_EQ(len, 3);
+  ASSERT_EQ(bin[2], 2);
+  ASSERT_TRUE(view.getString("array.0", str));
+  ASSERT_STREQ(str.c_str(), "Element 1");
+  ASSERT_TRUE(view.getInt32("document.inner.key2", i32));
+  ASSERT_EQ(i32, 2);
+  ASSERT_TRUE(view.hasKey("document.inner"));
+  ASSERT_FALSE(view.hasKey("key1"));
+  ASSERT_FALSE(view.getInt64("int32", i64));
+
+  //
+  // The view must also read what libbson produced
+  //
+  BSONParser bson;
+  bson.appendString("string", "libbson");
+  bson.appendDocumentBegin("document");
+  bson.appendInt64("key1", 42);
+  bson.appendDocumentEnd("document");
+  ASSERT_TRUE(view.reset(bson.getData(), bson.getDataLength()));
+  ASSERT_TRUE(view.getString("string", str));
+  ASSERT_STREQ(str.c_str(), "libbson");
+  ASSERT_TRUE(view.getInt64("document.key1", i64));
+  ASSERT_EQ(i64, 42);
+
+  //
+  // Truncated and corrupted documents are rejected
+  //
+  std::string corrupt(buffer);
+  ASSERT_FALSE(view.reset((const uint8_t*)corrupt.data(), corrupt.size() - 1));
+  ASSERT_FALSE(view.isValid());
+  corrupt[4] = 0x7e;
+  ASSERT_FALSE(view.reset((const uint8_t*)corrupt.data(), corrupt.size()));
+
+  //
+  // Reusing the buffer keeps its allocation
+  //
+  std::size_t capacity = buffer.capacity();
+  const char* storage = buffer.data();
+  writer.reset();
+  ASSERT_TRUE(writer.appendInt32("int32", 1));
+  ASSERT_TRUE(writer.finish());
+  ASSERT_EQ(buffer.capacity(), capacity);
+  ASSERT_TRUE(buffer.data() == storage);
+  ASSERT_TRUE(view.reset((const uint8_t*)buffer.data(), buffer.size()));
+  ASSERT_EQ(view.size(), 1);
+}
+
+TEST(BSONTest, BSONWriterArena)
+{
+  uint8_t arena[64];
+  BSONWriter writer(arena, sizeof(arena));
+  ASSERT_TRUE(writer.appendString("key", "value"));
+  ASSERT_TRUE(writer.finish());
+  ASSERT_TRUE(writer.getData() == arena);
+
+  BSONView view(arena, writer.getDataLength());
+  std::string str;
+  ASSERT_TRUE(view.getString("key", str));
+  ASSERT_STREQ(str.c_str(), "value");
+
+  writer.reset();
+  ASSERT_FALSE(writer.appendString("key", std::string(100, 'x')));
+  ASSERT_TRUE(writer.hasOverflowed());
+  ASSERT_FALSE(writer.finish());
+  ASSERT_TRUE(writer.release() == 0);
+
+  BSONWriter owned;
+  for (int i = 0; i < 1000; i++)
+  {
+    ASSERT_TRUE(owned.appendInt32(OSS::string_from_number(i), i));
+  }
+  ASSERT_TRUE(owned.finish());
+  std::size_t len = owned.getDataLength();
+  uint8_t* data = owned.release();
+  ASSERT_TRUE(data != 0);
+  ASSERT_TRUE(view.reset(data, len));
+  int32_t value = 0;
+  ASSERT_TRUE(view.getInt32("999", value));
+  ASSERT_EQ(value, 999);
+  free(data);
+}
+
+TEST(BSONTest, BSONViewLookup)
+{
+  const int FIELD_COUNT = 32;
+  const int ITERATIONS = 20000;
+
+  BSONParser bson;
+  for (int i = 0; i < FIELD_COUNT; i++)
+  {
+    bson.appendInt32("field-" + OSS::string_from_number(i), i);
+  }
+
+  std::vector<std::string> keys;
+  for (int i = 0; i < FIELD_COUNT; i++)
+  {
+    keys.push_back("field-" + OSS::string_from_number(i));
+  }
+
+  int64_t sum = 0;
+  OSS::UInt64 start = OSS::getTime();
+  for (int n = 0; n < ITERATIONS; n++)
+  {
+    for (int i = 0; i < FIELD_COUNT; i++)
+    {
+      int32_t value = 0;
+      bson.getInt32(keys[i], value);
+      sum += value;
+    }
+  }
+  OSS::UInt64 parserElapsed = OSS::getTime() - start;
+
+  start = OSS::getTime();
+  for (int n = 0; n < ITERATIONS; n++)
+  {
+    BSONView view(bson.getData(), bson.getDataLength());
+    for (int i = 0; i < FIELD_COUNT; i++)
+    {
+      int32_t value = 0;
+      view.getInt32(keys[i], value);
+      sum -= value;
+    }
+  }
+  OSS::UInt64 viewElapsed = OSS::getTime() - start;
+
+  ASSERT_EQ(sum, 0);
+  std::cout << "BSON " << ITERATIONS << " documents x " << FIELD_COUNT << " fields: BSONParser "
+    << parserElapsed << " ms, BSONView (index included) " << viewElapsed << " ms" << std::endl;
+}
+
+#if ENABLE_FEATURE_ZMQ && OSS_HAVE_ZMQ
+
+static void bson_queue_produce(BSONQueue& producer, int count)
+{
+  BSONWriter writer;
+  for (int i = 0; i < count; i++)
+  {
+    writer.appendInt32("index", i);
+    writer.appendString("call-id", "a84b4c76e66710@pc33.atlanta.com");
+    writer.appendString("from-tag", "1928301774");
+    writer.appendInt64("timestamp", 1234567890123LL);
+    //
+    // Hands the buffer to ZMQ and starts over with a new one
+    //
+    producer.enqueue(writer);
+  }
+}
+
+static void bson_queue_produce_parser(BSONQueue& producer, int count)
+{
+  for (int i = 0; i < count; i++)
+  {
+    BSONParser msg;
+    msg.appendInt32("index", i);
+    msg.appendString("call-id", "a84b4c76e66710@pc33.atlanta.com");
+    msg.appendString("from-tag", "1928301774");
+    msg.appendInt64("timestamp", 1234567890123LL);
+    producer.enqueue(msg);
+  }
+}
+
+static void bson_queue_consume(int& received, bool& inOrder, int count, boost::asio::io_service& ioService, BSONView& msg)
+{
+  int32_t index = -1;
+  const char* callId = 0;
+  std::size_t len = 0;
+  if (!msg.getInt32("index", index) || index != received || !msg.getString("call-id", callId, len))
+  {
+    inOrder = false;
+  }
+  if (++received == count)
+  {
+    ioService.stop();
+  }
+}
+
+TEST(BSONTest, BSONQueueThroughput)
+{
+  const int MESSAGE_COUNT = 100000;
+  const char* addresses[] = { "inproc://bson-throughput", "ipc:///tmp/oss_core_bson_throughput.sock" };
+
+  for (std::size_t a = 0; a < sizeof(addresses) / sizeof(addresses[0]); a++)
+  {
+    //
+    // libbson documents and a blocking dequeue() per message
+    //
+    {
+      BSONQueue consumer(BSONQueue::CONSUMER, "throughput", addresses[a]);
+      BSONQueue producer(BSONQueue::PRODUCER, "throughput", addresses[a]);
+
+      OSS::UInt64 start = OSS::getTime();
+      boost::thread thread(boost::bind(bson_queue_produce_parser, boost::ref(producer), MESSAGE_COUNT));
+      int received = 0;
+      BSONParser msg;
+      while (received < MESSAGE_COUNT && consumer.dequeue(msg))
+      {
+        received++;
+      }
+      thread.join();
+      OSS::UInt64 elapsed = OSS::getTime() - start;
+      ASSERT_EQ(received, MESSAGE_COUNT);
+      std::cout << "BSONQueue " << addresses[a] << " BSONParser and blocking dequeue: " << MESSAGE_COUNT << " messages in "
+        << elapsed << " ms" << std::endl;
+    }
+
+    //
+    // BSONWriter buffers handed to ZMQ and batched delivery from an io_service
+    //
+    {
+      BSONQueue consumer(BSONQueue::CONSUMER, "throughput", addresses[a]);
+      BSONQueue producer(BSONQueue::PRODUCER, "throughput", addresses[a]);
+      boost::asio::io_service ioService;
+      OSS::ZMQ::ZMQPoller poller(ioService);
+      int received = 0;
+      bool inOrder = true;
+      ASSERT_TRUE(consumer.watch(poller, boost::bind(bson_queue_consume, boost::ref(received), boost::ref(inOrder), MESSAGE_COUNT, boost::ref(ioService), _1)));
+
+      boost::asio::deadline_timer timeout(ioService, boost::posix_time::seconds(30));
+      timeout.async_wait(boost::bind(&boost::asio::io_service::stop, &ioService));
+
+      OSS::UInt64 start = OSS::getTime();
+      boost::thread thread(boost::bind(bson_queue_produce, boost::ref(producer), MESSAGE_COUNT));
+      ioService.run();
+      thread.join();
+      OSS::UInt64 elapsed = OSS::getTime() - start;
+      consumer.unwatch(poller);
+      ASSERT_EQ(received, MESSAGE_COUNT);
+      ASSERT_TRUE(inOrder);
+      std::cout << "BSONQueue " << addresses[a] << " BSONWriter and ZMQPoller batches: " << MESSAGE_COUNT << " messages in "
+        << elapsed << " ms" << std::endl;
+    }
+  }
+
+  //
+  // Nothing queued
+  //
+  BSONQueue consumer(BSONQueue::CONSUMER, "empty");
+  BSONView msg;
+  ASSERT_FALSE(consumer.tryDequeue(msg));
+}
+
+#endif
+
 #if 0
 
 TEST(BSONTest, BSONBSONQueue)
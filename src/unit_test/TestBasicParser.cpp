@@ -4,6 +4,8 @@
 #include "OSS/SIP/SIPMessage.h"
 #include "OSS/SIP/SIPCSeq.h"
 #include "OSS/SIP/SIPURI.h"
+#include "OSS/SIP/SIPStreamFramer.h"
+#include "OSS/UTL/CoreUtils.h"
 #include "OSS/ABNF/ABNFParser.h"
 #include "OSS/ABNF/ABNFSIPUserInfo.h"
 #include "OSS/ABNF/ABNFSIPHostName.h"
@@ -1100,4 +1102,217 @@ TEST(ParserTest, test_message_consume_late_crlf)
   ASSERT_TRUE(boost::indeterminate(ret.get<0>()));
   ret = msg.consume(strm1, strm1 + strlen(strm1));
   ASSERT_TRUE(ret.get<0>() == true);
-}
\ No newline at end of file
+}
+TEST(ParserTest, test_message_header_batch)
+{
+  std::ostringstream strm;
+  strm << "INVITE sip:9001@192.168.0.152 SIP/2.0" << CRLF;
+  strm << "To: <sip:9001@192.168.0.152>" << CRLF;
+  strm << "From: 9011<sip:9011@192.168.0.103>;tag=6657e067" << CRLF;
+  strm << "Via: SIP/2.0/UDP 192.168.0.1;branch=001" << CRLF;
+  strm << "Call-ID: 885e5e180c04c509" << CRLF;
+  strm << "CSeq: 1 INVITE" << CRLF;
+  strm << "Route: <sip:10.0.0.1;lr>" << CRLF;
+  strm << "Route: <sip:10.0.0.2;lr>" << CRLF;
+  strm << "Subject: Remove Me" << CRLF;
+  strm << "Content-Length: 0" << CRLF;
+  strm << CRLF;
+
+  SIPMessage message(strm.str());
+  message.parse();
+
+  SIPHeaderList headers;
+  std::string startLine;
+  message.hdrGetAll(headers, startLine);
+  ASSERT_STREQ(startLine.c_str(), "INVITE sip:9001@192.168.0.152 SIP/2.0");
+  ASSERT_EQ(headers["route"].size(), 2);
+  ASSERT_STREQ(headers["call-id"][0].c_str(), "885e5e180c04c509");
+
+  SIPHeaderList mutations;
+  mutations["route"].push_back("<sip:10.0.0.3;lr>");
+  mutations["subject"];
+  mutations["X-Route-Id"].push_back("1234");
+  ASSERT_TRUE(message.hdrCommit(mutations, "INVITE sip:9002@192.168.0.152 SIP/2.0"));
+
+  ASSERT_STREQ(message.getStartLine().c_str(), "INVITE sip:9002@192.168.0.152 SIP/2.0");
+  ASSERT_EQ(message.hdrGetSize("route"), 1);
+  ASSERT_STREQ(message.hdrGet("route").c_str(), "<sip:10.0.0.3;lr>");
+  ASSERT_FALSE(message.hdrPresent("subject"));
+  ASSERT_STREQ(message.hdrGet("x-route-id").c_str(), "1234");
+}
+
+static std::string create_pipelined_stream(int count)
+{
+  const char* sdp =
+    "v=0\r\n"
+    "o=- 21952 32372 IN IP4 10.111.0.93\r\n"
+    "s=-\r\n"
+    "c=IN IP4 10.111.0.93\r\n"
+    "t=0 0\r\n"
+    "m=audio 24354 RTP/AVP 0 8 101\r\n"
+    "a=rtpmap:101 telephone-event/8000\r\n";
+
+  std::ostringstream strm;
+  for (int i = 0; i < count; i++)
+  {
+    strm << "INVITE sip:" << 1000 + i << "@10.0.0.1 SIP/2.0\r\n";
+    strm << "Via: SIP/2.0/TCP 10.0.0.2:5060;branch=z9hG4bK-" << i << "\r\n";
+    strm << "From: <sip:trunk@10.0.0.2>;tag=" << i << "\r\n";
+    strm << "To: <sip:" << 1000 + i << "@10.0.0.1>\r\n";
+    strm << "Call-ID: pipelined-" << i << "\r\n";
+    strm << "CSeq: 1 INVITE\r\n";
+    strm << "Max-Forwards: 70\r\n";
+    strm << "Content-Type: application/sdp\r\n";
+    if (i % 2)
+      strm << "l: " << strlen(sdp) << "\r\n";
+    else
+      strm << "Content-Length: " << strlen(sdp) << "\r\n";
+    strm << "\r\n";
+    strm << sdp;
+    if (i % 100 == 99)
+      strm << "\r\n\r\n";
+  }
+  return strm.str();
+}
+
+TEST(ParserTest, test_stream_framer)
+{
+  std::string stream = create_pipelined_stream(500);
+
+  //
+  // Feed the stream in MTU sized reads so frames straddle read boundaries
+  //
+  SIPStreamFramer framer;
+  std::size_t offset = 0;
+  int frames = 0;
+  int pings = 0;
+  while (offset < stream.size())
+  {
+    std::size_t readSize = std::min((std::size_t)1400, stream.size() - offset);
+    memcpy(framer.prepare(readSize), stream.data() + offset, readSize);
+    framer.commit(readSize);
+    offset += readSize;
+
+    const char* frame = 0;
+    std::size_t frameSize = 0;
+    SIPStreamFramer::FrameResult result;
+    while ((result = framer.next(frame, frameSize)) != SIPStreamFramer::FRAME_INCOMPLETE)
+    {
+      ASSERT_NE(result, SIPStreamFramer::FRAME_ERROR);
+      if (result == SIPStreamFramer::FRAME_KEEP_ALIVE)
+      {
+        ++pings;
+        continue;
+      }
+      SIPMessage msg(frame, frameSize);
+      std::ostringstream callId;
+      callId << "pipelined-" << frames++;
+      ASSERT_STREQ(msg.hdrGet("call-id").c_str(), callId.str().c_str());
+      ASSERT_TRUE(msg.body().find("telephone-event") != std::string::npos);
+    }
+  }
+  ASSERT_EQ(frames, 500);
+  ASSERT_EQ(pings, 5);
+  ASSERT_EQ(framer.size(), 0);
+
+  std::size_t contentLength = 0;
+  const char* bad = "INVITE sip:a@b SIP/2.0\r\nContent-Length: abc\r\n\r\n";
+  ASSERT_FALSE(SIPStreamFramer::findContentLength(bad, strlen(bad), contentLength));
+  framer.append(bad, strlen(bad));
+  const char* frame = 0;
+  std::size_t frameSize = 0;
+  ASSERT_EQ(framer.next(frame, frameSize), SIPStreamFramer::FRAME_ERROR);
+  ASSERT_EQ(framer.size(), 0);
+}
+
+TEST(ParserTest, test_stream_framer_shrink)
+{
+  //
+  // A large MESSAGE grows the buffer.  It must be released once the
+  // message has been framed so the connection does not keep it.
+  //
+  std::string body(512 * 1024, 'x');
+  std::ostringstream msg;
+  msg << "MESSAGE sip:bob@example.com SIP/2.0\r\n"
+    << "Call-ID: large-frame\r\n"
+    << "Content-Length: " << body.size() << "\r\n\r\n"
+    << body;
+  std::string large = msg.str();
+
+  SIPStreamFramer framer;
+  framer.append(large.data(), large.size());
+  ASSERT_GE(framer.capacity(), large.size());
+
+  const char* frame = 0;
+  std::size_t frameSize = 0;
+  ASSERT_EQ(framer.next(frame, frameSize), SIPStreamFramer::FRAME_COMPLETE);
+  ASSERT_EQ(frameSize, large.size());
+  ASSERT_EQ(framer.next(frame, frameSize), SIPStreamFramer::FRAME_INCOMPLETE);
+
+  framer.prepare(1400);
+  ASSERT_LE(framer.capacity(), (std::size_t)65536);
+
+  //
+  // Bytes of the next message that arrived with the large one survive the shrink
+  //
+  std::string pipelined = large + "\r\n\r\nOPTIONS sip:bob@example.com SIP/2.0\r\nContent-Length: 0\r\n";
+  framer.append(pipelined.data(), pipelined.size());
+  ASSERT_EQ(framer.next(frame, frameSize), SIPStreamFramer::FRAME_COMPLETE);
+  ASSERT_EQ(framer.next(frame, frameSize), SIPStreamFramer::FRAME_KEEP_ALIVE);
+  ASSERT_EQ(framer.next(frame, frameSize), SIPStreamFramer::FRAME_INCOMPLETE);
+  memcpy(framer.prepare(2), "\r\n", 2);
+  framer.commit(2);
+  ASSERT_LE(framer.capacity(), (std::size_t)65536);
+  ASSERT_EQ(framer.next(frame, frameSize), SIPStreamFramer::FRAME_COMPLETE);
+  ASSERT_EQ(std::string(frame, 7), "OPTIONS");
+}
+
+TEST(ParserTest, test_stream_framer_benchmark)
+{
+  //
+  // A trunk pipelining 500 INVITEs in a single read
+  //
+  const int iterations = 100;
+  std::string stream = create_pipelined_stream(500);
+
+  OSS::UInt64 start = OSS::getTime();
+  int consumed = 0;
+  for (int i = 0; i < iterations; i++)
+  {
+    const char* begin = stream.data();
+    const char* end = begin + stream.size();
+    while (begin < end)
+    {
+      SIPMessage::Ptr pMsg(new SIPMessage());
+      boost::tuple<boost::tribool, const char*> ret = pMsg->consume(begin, end);
+      begin = ret.get<1>();
+      if (ret.get<0>())
+        ++consumed;
+    }
+  }
+  OSS::UInt64 consumeTime = OSS::getTime() - start;
+
+  start = OSS::getTime();
+  int framed = 0;
+  SIPStreamFramer framer;
+  for (int i = 0; i < iterations; i++)
+  {
+    framer.append(stream.data(), stream.size());
+    const char* frame = 0;
+    std::size_t frameSize = 0;
+    SIPStreamFramer::FrameResult result;
+    while ((result = framer.next(frame, frameSize)) != SIPStreamFramer::FRAME_INCOMPLETE)
+    {
+      if (result == SIPStreamFramer::FRAME_COMPLETE)
+      {
+        SIPMessage::Ptr pMsg(new SIPMessage(frame, frameSize));
+        ++framed;
+      }
+    }
+  }
+  OSS::UInt64 framerTime = OSS::getTime() - start;
+
+  ASSERT_EQ(framed, 500 * iterations);
+  std::cout << "SIPMessage::consume: " << consumed << " messages in " << consumeTime << " ms" << std::endl;
+  std::cout << "SIPStreamFramer: " << framed << " messages in " << framerTime << " ms" << std::endl;
+}
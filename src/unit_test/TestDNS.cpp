@@ -60,6 +60,10 @@ See also: For more string comparison tricks (substring, prefix, suffix, and regu
 #include "gtest/gtest.h"
 #include "OSS/OSS.h"
 #include "OSS/Net/DNS.h"
+#include "OSS/Net/DNSTargetResolver.h"
+#include "OSS/UTL/CoreUtils.h"
+#include <boost/asio.hpp>
+#include <boost/thread.hpp>
 
 #if 0
 TEST(APITest, dns_lookup_host)
@@ -76,3 +80,362 @@ TEST(APITest, dns_lookup_srv)
 }
 #endif
 
+
+
+//
+// Minimal authoritative server on the loopback interface.  Answers from a
+// fixed table, counts the questions it receives and can delay its answers
+// to keep queries in flight.
+//
+class StubDNSServer
+{
+public:
+  StubDNSServer() :
+    _socket(_ioService, boost::asio::ip::udp::endpoint(boost::asio::ip::address::from_string("127.0.0.1"), 0)),
+    _delay(0),
+    _isRunning(true),
+    _thread(boost::bind(&StubDNSServer::run, this))
+  {
+  }
+
+  ~StubDNSServer()
+  {
+    _isRunning = false;
+    boost::asio::ip::udp::socket wake(_ioService, boost::asio::ip::udp::v4());
+    wake.send_to(boost::asio::buffer("", 1), _socket.local_endpoint());
+    _thread.join();
+    _senders.join_all();
+  }
+
+  unsigned short port() const
+  {
+    return _socket.local_endpoint().port();
+  }
+
+  void setDelay(int delay)
+  {
+    _delay = delay;
+  }
+
+  void addA(const std::string& name, const std::string& address, unsigned int ttl = 300)
+  {
+    boost::asio::ip::address_v4::bytes_type bytes = boost::asio::ip::address_v4::from_string(address).to_bytes();
+    add(name, 1, ttl, std::string(bytes.begin(), bytes.end()));
+  }
+
+  void addAAAA(const std::string& name, const std::string& address, unsigned int ttl = 300)
+  {
+    boost::asio::ip::address_v6::bytes_type bytes = boost::asio::ip::address_v6::from_string(address).to_bytes();
+    add(name, 28, ttl, std::string(bytes.begin(), bytes.end()));
+  }
+
+  void addSRV(const std::string& name, unsigned short priority, unsigned short weight, unsigned short port, const std::string& target, unsigned int ttl = 300)
+  {
+    add(name, 33, ttl, u16(priority) + u16(weight) + u16(port) + encodeName(target));
+  }
+
+  void addNAPTR(const std::string& name, unsigned short order, unsigned short preference, const std::string& service, const std::string& replacement, unsigned int ttl = 300)
+  {
+    add(name, 35, ttl, u16(order) + u16(preference) + charString("s") + charString(service) + charString("") + encodeName(replacement));
+  }
+
+  int getQueryCount(const std::string& name, unsigned short type)
+  {
+    boost::mutex::scoped_lock lock(_mutex);
+    return _queries[std::make_pair(name, type)];
+  }
+
+private:
+  struct Answer
+  {
+    unsigned short type;
+    unsigned int ttl;
+    std::string rdata;
+  };
+  typedef std::multimap<std::string, Answer> Zone;
+
+  static std::string u16(unsigned short value)
+  {
+    std::string str;
+    str.push_back((char)(value >> 8));
+    str.push_back((char)(value & 0xFF));
+    return str;
+  }
+
+  static std::string u32(unsigned int value)
+  {
+    return u16(value >> 16) + u16(value & 0xFFFF);
+  }
+
+  static std::string charString(const std::string& value)
+  {
+    return std::string(1, (char)value.size()) + value;
+  }
+
+  static std::string encodeName(const std::string& name)
+  {
+    std::string encoded;
+    std::vector<std::string> labels = OSS::string_tokenize(name, ".");
+    for (std::vector<std::string>::const_iterator iter = labels.begin(); iter != labels.end(); iter++)
+    {
+      if (!iter->empty())
+        encoded += charString(*iter);
+    }
+    encoded.push_back(0);
+    return encoded;
+  }
+
+  void add(const std::string& name, unsigned short type, unsigned int ttl, const std::string& rdata)
+  {
+    Answer answer;
+    answer.type = type;
+    answer.ttl = ttl;
+    answer.rdata = rdata;
+    boost::mutex::scoped_lock lock(_mutex);
+    _zone.insert(std::make_pair(name, answer));
+  }
+
+  void run()
+  {
+    while (_isRunning)
+    {
+      char buf[512];
+      boost::asio::ip::udp::endpoint sender;
+      boost::system::error_code ec;
+      std::size_t len = _socket.receive_from(boost::asio::buffer(buf), sender, 0, ec);
+      if (ec || !_isRunning || len < 17)
+        continue;
+
+      //
+      // Question name, type and class
+      //
+      std::string name;
+      std::size_t offset = 12;
+      while (offset < len && buf[offset])
+      {
+        std::size_t labelLength = (unsigned char)buf[offset];
+        if (!name.empty())
+          name += ".";
+        name.append(buf + offset + 1, labelLength);
+        offset += labelLength + 1;
+      }
+      offset++;
+      if (offset + 4 > len)
+        continue;
+      unsigned short type = ((unsigned char)buf[offset] << 8) | (unsigned char)buf[offset + 1];
+      offset += 4;
+      OSS::string_to_lower(name);
+
+      std::string answers;
+      unsigned short answerCount = 0;
+      bool exists = false;
+      {
+        boost::mutex::scoped_lock lock(_mutex);
+        _queries[std::make_pair(name, type)]++;
+        std::pair<Zone::iterator, Zone::iterator> range = _zone.equal_range(name);
+        for (Zone::iterator iter = range.first; iter != range.second; iter++)
+        {
+          exists = true;
+          if (iter->second.type != type)
+            continue;
+          answers += u16(0xC00C) + u16(type) + u16(1) + u32(iter->second.ttl) + u16(iter->second.rdata.size()) + iter->second.rdata;
+          answerCount++;
+        }
+      }
+
+      std::string response(buf, 2);
+      response += u16(exists ? 0x8180 : 0x8183);
+      response += u16(1) + u16(answerCount) + u16(0) + u16(0);
+      response.append(buf + 12, offset - 12);
+      response += answers;
+
+      _senders.create_thread(boost::bind(&StubDNSServer::send, this, response, sender));
+    }
+  }
+
+  void send(const std::string& response, const boost::asio::ip::udp::endpoint& target)
+  {
+    if (_delay)
+      boost::this_thread::sleep(boost::posix_time::milliseconds(_delay));
+    boost::system::error_code ec;
+    boost::mutex::scoped_lock lock(_mutex);
+    _socket.send_to(boost::asio::buffer(response), target, 0, ec);
+  }
+
+  boost::asio::io_service _ioService;
+  boost::asio::ip::udp::socket _socket;
+  boost::mutex _mutex;
+  Zone _zone;
+  std::map<std::pair<std::string, unsigned short>, int> _queries;
+  volatile int _delay;
+  volatile bool _isRunning;
+  boost::thread_group _senders;
+  boost::thread _thread;
+};
+
+static void count_host_answers(boost::mutex* pMutex, int* pCount, const OSS::dns_host_record_list& hosts)
+{
+  boost::mutex::scoped_lock lock(*pMutex);
+  if (!hosts.empty())
+    (*pCount)++;
+}
+
+TEST(DNSTest, DNSTargetResolverRFC3263)
+{
+  StubDNSServer server;
+  server.addNAPTR("example.test", 10, 10, "SIP+D2T", "_sip._tcp.example.test");
+  server.addNAPTR("example.test", 20, 10, "SIP+D2U", "_sip._udp.example.test");
+  server.addSRV("_sip._tcp.example.test", 10, 60, 5070, "sip1.example.test");
+  server.addSRV("_sip._tcp.example.test", 20, 0, 5080, "sip2.example.test");
+  server.addSRV("_sip._udp.example.test", 10, 0, 5060, "sip1.example.test");
+  server.addA("sip1.example.test", "10.0.0.1");
+  server.addAAAA("sip1.example.test", "2001:db8::1");
+  server.addA("sip2.example.test", "10.0.0.2");
+  server.addA("example.test", "10.0.0.9");
+
+  OSS::Net::DNSTargetResolver resolver;
+  ASSERT_TRUE(resolver.setNameServer("127.0.0.1", server.port()));
+  ASSERT_TRUE(resolver.start());
+
+  //
+  // NAPTR order decides the transport, SRV priority the host
+  //
+  OSS::Net::DNSTargetResolver::Targets targets = resolver.resolveTargets("example.test", "", false);
+  ASSERT_EQ(targets.size(), 3);
+  ASSERT_EQ(targets[0].transport, "tcp");
+  ASSERT_EQ(targets[0].address, "10.0.0.1");
+  ASSERT_EQ(targets[0].port, 5070);
+  ASSERT_EQ(targets[1].address, "10.0.0.2");
+  ASSERT_EQ(targets[1].port, 5080);
+  ASSERT_EQ(targets[2].transport, "udp");
+  ASSERT_EQ(targets[2].port, 5060);
+
+  targets = resolver.resolveTargets("example.test", "udp", false);
+  ASSERT_EQ(targets.size(), 1);
+  ASSERT_EQ(targets[0].address, "10.0.0.1");
+
+  //
+  // No TLS service published.  Falls back to the domain's own address.
+  //
+  targets = resolver.resolveTargets("example.test", "", true);
+  ASSERT_EQ(targets.size(), 1);
+  ASSERT_EQ(targets[0].transport, "tls");
+  ASSERT_EQ(targets[0].address, "10.0.0.9");
+  ASSERT_EQ(targets[0].port, 5061);
+
+  //
+  // TLS published under the legacy _sip._tls name only, and under both
+  // names for the same server
+  //
+  server.addSRV("_sip._tls.legacy.test", 10, 0, 5071, "sip1.example.test");
+  targets = resolver.resolveTargets("legacy.test", "", true);
+  ASSERT_EQ(targets.size(), 1);
+  ASSERT_EQ(targets[0].transport, "tls");
+  ASSERT_EQ(targets[0].address, "10.0.0.1");
+  ASSERT_EQ(targets[0].port, 5071);
+
+  server.addSRV("_sips._tcp.both.test", 10, 0, 5061, "sip2.example.test");
+  server.addSRV("_sip._tls.both.test", 10, 0, 5061, "sip2.example.test");
+  targets = resolver.resolveTargets("both.test", "", true);
+  ASSERT_EQ(targets.size(), 1);
+  ASSERT_EQ(targets[0].address, "10.0.0.2");
+  ASSERT_EQ(targets[0].port, 5061);
+
+  OSS::dns_host_record_list hosts = resolver.resolveHost("sip1.example.test");
+  ASSERT_EQ(hosts.size(), 2);
+  ASSERT_EQ(hosts.front(), "10.0.0.1");
+  ASSERT_EQ(hosts.back(), "2001:db8::1");
+
+  //
+  // Everything above was answered once and then served from the cache
+  //
+  ASSERT_EQ(server.getQueryCount("example.test", 35), 1);
+  ASSERT_EQ(server.getQueryCount("_sip._tcp.example.test", 33), 1);
+  ASSERT_EQ(server.getQueryCount("sip1.example.test", 1), 1);
+  ASSERT_GT(resolver.getCacheHitCount(), 0);
+}
+
+TEST(DNSTest, DNSTargetResolverCache)
+{
+  StubDNSServer server;
+  server.addA("short.example.test", "10.0.1.1", 1);
+  server.addA("long.example.test", "10.0.1.2", 3600);
+
+  OSS::Net::DNSTargetResolver resolver;
+  resolver.setNegativeTTL(1);
+  ASSERT_TRUE(resolver.setNameServer("127.0.0.1", server.port()));
+  ASSERT_TRUE(resolver.start());
+
+  ASSERT_FALSE(resolver.resolveHost("short.example.test").empty());
+  ASSERT_FALSE(resolver.resolveHost("long.example.test").empty());
+  ASSERT_TRUE(resolver.resolveHost("missing.example.test").empty());
+  ASSERT_TRUE(resolver.resolveHost("missing.example.test").empty());
+  ASSERT_EQ(server.getQueryCount("missing.example.test", 1), 1);
+
+  boost::this_thread::sleep(boost::posix_time::milliseconds(1100));
+
+  //
+  // The one second records expired, the one hour record did not
+  //
+  ASSERT_FALSE(resolver.resolveHost("short.example.test").empty());
+  ASSERT_FALSE(resolver.resolveHost("long.example.test").empty());
+  ASSERT_TRUE(resolver.resolveHost("missing.example.test").empty());
+  ASSERT_EQ(server.getQueryCount("short.example.test", 1), 2);
+  ASSERT_EQ(server.getQueryCount("long.example.test", 1), 1);
+  ASSERT_EQ(server.getQueryCount("missing.example.test", 1), 2);
+
+  resolver.flushCache();
+  ASSERT_EQ(resolver.getCacheSize(), 0);
+  ASSERT_FALSE(resolver.resolveHost("long.example.test").empty());
+  ASSERT_EQ(server.getQueryCount("long.example.test", 1), 2);
+}
+
+TEST(DNSTest, DNSTargetResolverCoalescing)
+{
+  StubDNSServer server;
+  server.addA("busy.example.test", "10.0.2.1");
+  server.addSRV("_sip._udp.farm.example.test", 10, 0, 5060, "node1.example.test");
+  server.addSRV("_sip._udp.farm.example.test", 20, 0, 5060, "node2.example.test");
+  server.addSRV("_sip._udp.farm.example.test", 30, 0, 5060, "node3.example.test");
+  server.addA("node1.example.test", "10.0.3.1");
+  server.addA("node2.example.test", "10.0.3.2");
+  server.addA("node3.example.test", "10.0.3.3");
+  server.setDelay(200);
+
+  OSS::Net::DNSTargetResolver resolver;
+  ASSERT_TRUE(resolver.setNameServer("127.0.0.1", server.port()));
+  ASSERT_TRUE(resolver.start());
+
+  //
+  // Identical lookups share the query on the wire
+  //
+  boost::mutex mutex;
+  int answered = 0;
+  for (int i = 0; i < 10; i++)
+    resolver.resolveHost("busy.example.test", boost::bind(count_host_answers, &mutex, &answered, _1));
+  for (int i = 0; i < 100; i++)
+  {
+    {
+      boost::mutex::scoped_lock lock(mutex);
+      if (answered == 10)
+        break;
+    }
+    boost::this_thread::sleep(boost::posix_time::milliseconds(50));
+  }
+  ASSERT_EQ(answered, 10);
+  ASSERT_EQ(server.getQueryCount("busy.example.test", 1), 1);
+  ASSERT_EQ(server.getQueryCount("busy.example.test", 28), 1);
+  ASSERT_EQ(resolver.getCoalescedCount(), 18);
+
+  //
+  // The three SRV targets are resolved in parallel
+  //
+  server.setDelay(300);
+  OSS::UInt64 start = OSS::getTime();
+  OSS::dns_srv_record_list srvRecords = resolver.resolveSRV("_sip._udp.farm.example.test");
+  OSS::UInt64 elapsed = OSS::getTime() - start;
+  ASSERT_EQ(srvRecords.size(), 3);
+  ASSERT_EQ(srvRecords.begin()->get<1>(), "10.0.3.1");
+  ASSERT_LT(elapsed, 1100);
+  std::cout << "SRV with 3 targets resolved in " << elapsed << " ms" << std::endl;
+}
@@ -59,10 +59,12 @@ See also: For more string comparison tricks (substring, prefix, suffix, and regu
 
 #include <set>
 #include <memory>
+#include <fstream>
 
 #include "gtest/gtest.h"
 #include "OSS/build.h"
 
+#include "OSS/UTL/CoreUtils.h"
 #include "OSS/JS/DUK/DuktapeContext.h"
 #include "OSS/JS/DUK/dukglue.h"
 
@@ -109,4 +111,103 @@ TEST(DUKTAPE, TestGlue)
     std::cout << duk_safe_to_string(ctx, -1) << std::endl;
     duk_pop(ctx);
   }
-}
\ No newline at end of file
+}
+static void writeCodeCacheBenchScript(const std::string& scriptFile, const std::string& extra)
+{
+  //
+  // Generate a script large enough for compilation to dominate load time
+  //
+  std::ofstream script(scriptFile.c_str(), std::ios::out | std::ios::trunc);
+  for (int i = 0; i < 2000; i++)
+  {
+    script << "function func_" << i << "(a, b) { var c = a + b * " << i << "; return c > 10 ? c - 1 : c + 1; }" << std::endl;
+  }
+  script << "var result = func_1999(1, 2);" << std::endl;
+  script << extra;
+}
+
+TEST(DUKTAPE, TestCodeCacheBenchmark)
+{
+  const std::string scriptFile = "duk_code_cache_bench.js";
+  writeCodeCacheBenchScript(scriptFile, "");
+  
+  const int iterations = 20;
+  
+  //
+  // Baseline: compile from source every time
+  //
+  OSS::UInt64 start = OSS::getTime();
+  for (int i = 0; i < iterations; i++)
+  {
+    DuktapeContext context("bench-source");
+    ASSERT_TRUE(context.evalFile(scriptFile, 0, stderr));
+  }
+  OSS::UInt64 sourceTime = OSS::getTime() - start;
+  
+  ASSERT_TRUE(DuktapeContext::setCodeCacheDirectory("duk_code_cache_bench.jscache"));
+  DuktapeContext::codeCache().clear();
+  
+  //
+  // First load populates the cache
+  //
+  start = OSS::getTime();
+  do
+  {
+    DuktapeContext context("bench-cold");
+    ASSERT_TRUE(context.evalFile(scriptFile, 0, stderr));
+  } while (false);
+  OSS::UInt64 coldTime = OSS::getTime() - start;
+  
+  //
+  // Every other load comes from bytecode
+  //
+  start = OSS::getTime();
+  for (int i = 0; i < iterations; i++)
+  {
+    DuktapeContext context("bench-warm");
+    ASSERT_TRUE(context.evalFile(scriptFile, 0, stderr));
+  }
+  OSS::UInt64 warmTime = OSS::getTime() - start;
+  
+  //
+  // Reload after the file is rewritten.  The new mtime alone does not
+  // invalidate the entry because it is keyed by the content hash.
+  //
+  writeCodeCacheBenchScript(scriptFile, "");
+  start = OSS::getTime();
+  for (int i = 0; i < iterations; i++)
+  {
+    DuktapeContext context("bench-reload");
+    ASSERT_TRUE(context.evalFile(scriptFile, 0, stderr));
+  }
+  OSS::UInt64 reloadTime = OSS::getTime() - start;
+  
+  //
+  // Reload after an edit.  The first context recompiles, the rest hit the new entry.
+  //
+  writeCodeCacheBenchScript(scriptFile, "result = func_0(result, 1);\n");
+  start = OSS::getTime();
+  do
+  {
+    DuktapeContext context("bench-edit");
+    ASSERT_TRUE(context.evalFile(scriptFile, 0, stderr));
+  } while (false);
+  OSS::UInt64 editTime = OSS::getTime() - start;
+  
+  start = OSS::getTime();
+  for (int i = 0; i < iterations; i++)
+  {
+    DuktapeContext context("bench-edit-warm");
+    ASSERT_TRUE(context.evalFile(scriptFile, 0, stderr));
+  }
+  OSS::UInt64 editWarmTime = OSS::getTime() - start;
+  
+  std::cout << "Duktape load from source: " << sourceTime / iterations << " ms per context" << std::endl;
+  std::cout << "Duktape cold cache load: " << coldTime << " ms" << std::endl;
+  std::cout << "Duktape warm cache load: " << warmTime / iterations << " ms per context" << std::endl;
+  std::cout << "Duktape reload of an unchanged script: " << reloadTime / iterations << " ms per context" << std::endl;
+  std::cout << "Duktape reload of an edited script: " << editTime << " ms, then " << editWarmTime / iterations << " ms per context" << std::endl;
+  
+  DuktapeContext::codeCache().clear();
+  boost::filesystem::remove(scriptFile);
+}
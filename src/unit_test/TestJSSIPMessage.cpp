@@ -148,3 +148,46 @@ TEST(JSTest, test_sip_message_basic_auth)
 
 
 
+
+static void process_isolate_pool_requests(OSS::JS::JSSIPMessage* pScript, const std::string& data)
+{
+  for (int i = 0; i < 100; i++)
+  {
+    OSS::SIP::SIPMessage::Ptr pMsg(new OSS::SIP::SIPMessage(data));
+    EXPECT_TRUE(pScript->processRequest(pMsg));
+  }
+}
+
+TEST(JSTest, test_sip_message_isolate_pool)
+{
+  using OSS::SIP::CRLF;
+
+  std::ostringstream msg;
+  msg << "INVITE sip:9001@192.168.0.152 SIP/2.0" << CRLF;
+  msg << "To: <sip:9001@192.168.0.152>" << CRLF;
+  msg << "From: 9011<sip:9011@192.168.0.103>;tag=6657e067" << CRLF;
+  msg << "Via: SIP/2.0/UDP 192.168.0.1;branch=001;rport" << CRLF;
+  msg << "Call-ID: 885e5e180c04c509" << CRLF;
+  msg << "CSeq: 1 INVITE" << CRLF;
+  msg << "Contact: <sip:9011@192.168.0.152:9644>" << CRLF;
+  msg << "Max-Forwards: 70" << CRLF;
+  msg << "Content-Length: 0" << CRLF;
+  msg << CRLF; /// End of headers
+
+  OSS::JS::JSSIPMessage jsMessage("test context", 4);
+  ASSERT_EQ(jsMessage.getPoolSize(), (std::size_t)4);
+  ASSERT_TRUE(jsMessage.initialize("data/js_test/jssipmessage.js", "handle_request"));
+  ASSERT_EQ(jsMessage.getScriptGeneration(), (OSS::UInt64)1);
+
+  //
+  // Hammer the pool from several threads while the script is being reloaded
+  //
+  boost::thread_group workers;
+  for (int t = 0; t < 8; t++)
+  {
+    workers.create_thread(boost::bind(process_isolate_pool_requests, &jsMessage, msg.str()));
+  }
+  ASSERT_TRUE(jsMessage.recompile());
+  workers.join_all();
+  ASSERT_EQ(jsMessage.getScriptGeneration(), (OSS::UInt64)2);
+}
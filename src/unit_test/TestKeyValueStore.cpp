@@ -188,6 +188,45 @@ TEST(KeyValueStoreTest, test_filter_multiple)
 }
 
 
+TEST(KeyValueStoreTest, test_batch_expires_sweep)
+{
+  KVRecords records;
+  for (int i = 0; i < 100; i++)
+  {
+    KVRecord record;
+    record.key = "sweepkey." + OSS::string_from_number(i);
+    record.value = data;
+    records.push_back(record);
+  }
+  ASSERT_TRUE(kv.putRecords(records, 1));
+  ASSERT_TRUE(kv.put("sweepkey.keep", data));
+  
+  KVKeys keys;
+  ASSERT_TRUE(kv.getKeys("sweepkey.*", keys));
+  ASSERT_EQ(keys.size(), 101);
+  
+  keys.clear();
+  ASSERT_TRUE(kv.getKeys("sweepkey.?5", keys));
+  ASSERT_EQ(keys.size(), 9);
+  
+  //
+  // The background sweeper purges the records without anyone reading them
+  //
+  OSS::thread_sleep(1000 + 2 * kv.getDB().getSweepInterval());
+  std::string result;
+  ASSERT_FALSE(kv.get("sweepkey.0", result, false));
+  ASSERT_FALSE(kv.get("sweepkey.99", result, false));
+  ASSERT_TRUE(kv.get("sweepkey.keep", result));
+  
+  keys.clear();
+  ASSERT_TRUE(kv.getKeys("sweepkey.*", keys));
+  ASSERT_EQ(keys.size(), 1);
+  
+  keys.push_back("sweepkey.missing");
+  ASSERT_TRUE(kv.delRecords(keys));
+  ASSERT_FALSE(kv.get("sweepkey.keep", result));
+}
+
 TEST(KeyValueStoreTest, test_rest_init_auth)
 {
   restkv.setCredentials("user", "password");
@@ -251,6 +290,36 @@ TEST(KeyValueStoreTest, test_rest_put_get_auth)
   }
 }
 
+TEST(KeyValueStoreTest, test_rest_stream_subtree)
+{
+  boost::filesystem::remove_all("bulk");
+  
+  const int count = 20000;
+  for (int i = 0; i < count; i++)
+  {
+    std::string item = OSS::string_from_number<int>(i);
+    ASSERT_EQ(200, restkv.restPUT("/root/bulk/items/" + item + "/name", "item " + item, 0));
+  }
+  ASSERT_EQ(200, restkv.restPUT("/root/bulk/quoted", "say \"hi\"", 0));
+  
+  std::ostringstream result;
+  ASSERT_EQ(200, restkv.restGET("/root/bulk/", result));
+  
+  std::stringstream input;
+  input << result.str();
+  json::Object jsonObject;
+  json::Reader::Read(jsonObject, input);
+  ASSERT_EQ(count, (int)((json::Object&)jsonObject["bulk"]["items"]).Size());
+  ASSERT_TRUE(((json::String&)jsonObject["bulk"]["items"]["123"]["name"]).Value() == "item 123");
+  ASSERT_TRUE(((json::String&)jsonObject["bulk"]["quoted"]).Value() == "say \"hi\"");
+  
+  std::ostringstream missing;
+  ASSERT_EQ(404, restkv.restGET("/root/bulk/nothing/", missing));
+  ASSERT_TRUE(missing.str().empty());
+  
+  ASSERT_EQ(200, restkv.restDELETE("/root/bulk/"));
+}
+
 TEST(KeyValueStoreTest, test_rest_tls)
 {
   if (!boost::filesystem::exists("rootcert.pem"))
@@ -311,3 +311,291 @@ TEST(LMDBTest, TestLMDBThreaded)
   ASSERT_TRUE(lmdb.drop(transaction));
 }
 
+
+
+TEST(LMDBTest, TestLMDBReadOnly)
+{
+  LMDatabase lmdb;
+  LMDatabase::Options opt;
+  opt.name = "test_db";
+  opt.size_mb = 1;
+  ASSERT_TRUE(lmdb.initialize(opt));
+  
+  LMDatabase::Transaction writer(&lmdb);
+  do {
+    LMDatabase::TransactionLock lock(writer);
+    ASSERT_TRUE(lmdb.clear(writer));
+    ASSERT_TRUE(lmdb.set(writer, "key", std::string("before")));
+  } while (false);
+  
+  //
+  // A reader sees its snapshot while a writer holds the database
+  //
+  LMDatabase::Transaction reader(&lmdb, LMDatabase::READ_ONLY);
+  ASSERT_TRUE(reader.isReadOnly());
+  ASSERT_TRUE(reader.begin());
+  
+  do {
+    LMDatabase::TransactionLock lock(writer);
+    ASSERT_TRUE(lmdb.set(writer, "key", std::string("after")));
+  } while (false);
+  
+  std::string value;
+  ASSERT_TRUE(lmdb.get(reader, "key", value));
+  ASSERT_STREQ(value.c_str(), "before");
+  ASSERT_TRUE(reader.end());
+  
+  //
+  // A renewed reader sees the latest commit
+  //
+  for (int i = 0; i < 10; i++)
+  {
+    LMDatabase::TransactionLock lock(reader);
+    ASSERT_TRUE(lmdb.get(reader, "key", value));
+    ASSERT_STREQ(value.c_str(), "after");
+    ASSERT_EQ(lmdb.count(reader), 1);
+  }
+  
+  do {
+    LMDatabase::TransactionLock lock(writer);
+    ASSERT_TRUE(lmdb.drop(writer));
+  } while (false);
+}
+
+
+static void lmdb_read_loop(LMDatabase* lmdb, LMDatabase::TransactionMode mode, int iterations, int keys, int* found)
+{
+  LMDatabase::Transaction transaction(lmdb, mode);
+  std::string value;
+  for (int i = 0; i < iterations; i++)
+  {
+    LMDatabase::TransactionLock lock(transaction);
+    if (lmdb->get(transaction, OSS::string_from_number<int>(i % keys), value))
+    {
+      (*found)++;
+    }
+  }
+}
+
+static double lmdb_read_rate(LMDatabase& lmdb, LMDatabase::TransactionMode mode, int threads, int iterations, int keys)
+{
+  std::vector<int> found(threads, 0);
+  boost::thread_group group;
+  OSS::UInt64 start = OSS::getTime();
+  for (int i = 0; i < threads; i++)
+  {
+    group.create_thread(boost::bind(lmdb_read_loop, &lmdb, mode, iterations, keys, &found[i]));
+  }
+  group.join_all();
+  OSS::UInt64 elapsed = OSS::getTime() - start;
+  
+  for (int i = 0; i < threads; i++)
+  {
+    EXPECT_EQ(found[i], iterations);
+  }
+  return (threads * iterations * 1000.0) / (elapsed ? elapsed : 1);
+}
+
+TEST(LMDBTest, TestLMDBReadScaling)
+{
+  LMDatabase lmdb;
+  LMDatabase::Options opt;
+  opt.name = "test_db";
+  opt.size_mb = 10;
+  ASSERT_TRUE(lmdb.initialize(opt));
+  
+  const int keys = 1000;
+  const int iterations = 100000;
+  LMDatabase::Transaction writer(&lmdb);
+  do {
+    LMDatabase::TransactionLock lock(writer);
+    ASSERT_TRUE(lmdb.clear(writer));
+    for (int i = 0; i < keys; i++)
+    {
+      ASSERT_TRUE(lmdb.set(writer, OSS::string_from_number<int>(i), std::string("Inserted Value")));
+    }
+  } while (false);
+  
+  int threadCounts[] = { 1, 2, 4, 8 };
+  for (std::size_t i = 0; i < sizeof(threadCounts) / sizeof(int); i++)
+  {
+    double locked = lmdb_read_rate(lmdb, LMDatabase::READ_WRITE, threadCounts[i], iterations, keys);
+    double snapshot = lmdb_read_rate(lmdb, LMDatabase::READ_ONLY, threadCounts[i], iterations, keys);
+    std::cout << "LMDB reads with " << threadCounts[i] << " thread(s): "
+      << (int)locked << " txn/s read-write, "
+      << (int)snapshot << " txn/s read-only" << std::endl;
+  }
+  
+  do {
+    LMDatabase::TransactionLock lock(writer);
+    ASSERT_TRUE(lmdb.drop(writer));
+  } while (false);
+}
+
+
+static void lmdb_batch_loop(LMDatabase* lmdb, int id, int count, int* failed)
+{
+  for (int i = 0; i < count; i++)
+  {
+    std::string key = OSS::string_from_number<int>(id) + "-" + OSS::string_from_number<int>(i);
+    if (!lmdb->batchSet(key, "Batched Value"))
+    {
+      (*failed)++;
+    }
+  }
+}
+
+TEST(LMDBTest, TestLMDBGroupCommit)
+{
+  LMDatabase lmdb;
+  LMDatabase::Options opt;
+  opt.name = "test_db";
+  opt.size_mb = 10;
+  ASSERT_TRUE(lmdb.initialize(opt));
+  
+  LMDatabase::Transaction transaction(&lmdb);
+  do {
+    LMDatabase::TransactionLock lock(transaction);
+    ASSERT_TRUE(lmdb.clear(transaction));
+  } while (false);
+  
+  const int threads = 8;
+  const int count = 200;
+  std::vector<int> failed(threads, 0);
+  boost::thread_group group;
+  for (int i = 0; i < threads; i++)
+  {
+    group.create_thread(boost::bind(lmdb_batch_loop, &lmdb, i, count, &failed[i]));
+  }
+  group.join_all();
+  
+  for (int i = 0; i < threads; i++)
+  {
+    ASSERT_EQ(failed[i], 0);
+  }
+  
+  ASSERT_EQ(lmdb.getBatchedWriteCount(), (OSS::UInt64)(threads * count));
+  ASSERT_LE(lmdb.getBatchCommitCount(), (OSS::UInt64)(threads * count));
+  std::cout << "LMDB group commit: " << lmdb.getBatchedWriteCount() << " writes in "
+    << lmdb.getBatchCommitCount() << " transactions" << std::endl;
+  
+  std::string value;
+  do {
+    LMDatabase::Transaction reader(&lmdb, LMDatabase::READ_ONLY);
+    LMDatabase::TransactionLock lock(reader);
+    ASSERT_EQ(lmdb.count(reader), (std::size_t)(threads * count));
+    ASSERT_TRUE(lmdb.get(reader, "7-199", value));
+    ASSERT_STREQ(value.c_str(), "Batched Value");
+  } while (false);
+  
+  ASSERT_TRUE(lmdb.batchDel("7-199"));
+  ASSERT_TRUE(lmdb.batchDel("7-199"));
+  
+  do {
+    LMDatabase::TransactionLock lock(transaction);
+    ASSERT_FALSE(lmdb.get(transaction, "7-199", value));
+    ASSERT_TRUE(lmdb.drop(transaction));
+  } while (false);
+}
+
+
+static bool lmdb_collect_int64(std::vector<int64_t>* keys, std::size_t limit, const LMDatabase::View& key, const LMDatabase::View& value)
+{
+  int64_t number = 0;
+  EXPECT_TRUE(LMDatabase::decodeInt64(key, number, 4));
+  EXPECT_STREQ(value.str().c_str(), "Scanned Value");
+  keys->push_back(number);
+  return keys->size() < limit;
+}
+
+TEST(LMDBTest, TestLMDBScan)
+{
+  LMDatabase lmdb;
+  LMDatabase::Options opt;
+  opt.name = "test_db";
+  opt.size_mb = 10;
+  ASSERT_TRUE(lmdb.initialize(opt));
+  
+  LMDatabase::Transaction transaction(&lmdb);
+  do {
+    LMDatabase::TransactionLock lock(transaction);
+    ASSERT_TRUE(lmdb.clear(transaction));
+    for (int64_t i = -500; i < 500; i++)
+    {
+      std::string reg("reg:");
+      LMDatabase::appendInt64(reg, i);
+      ASSERT_TRUE(lmdb.set(transaction, reg, std::string("Scanned Value")));
+      std::string dlg("dlg:");
+      LMDatabase::appendInt64(dlg, i);
+      ASSERT_TRUE(lmdb.set(transaction, dlg, std::string("Scanned Value")));
+    }
+  } while (false);
+  
+  LMDatabase::Transaction reader(&lmdb, LMDatabase::READ_ONLY);
+  do {
+    LMDatabase::TransactionLock lock(reader);
+  
+    //
+    // Encoded signed keys come back in numeric order
+    //
+    std::vector<int64_t> keys;
+    ASSERT_EQ(lmdb.scanPrefix(reader, "reg:", boost::bind(lmdb_collect_int64, &keys, 10000, _1, _2)), 1000);
+    ASSERT_EQ(keys.size(), 1000);
+    for (std::size_t i = 0; i < keys.size(); i++)
+    {
+      ASSERT_EQ(keys[i], (int64_t)i - 500);
+    }
+  
+    //
+    // Early termination
+    //
+    keys.clear();
+    ASSERT_EQ(lmdb.scanPrefix(reader, "dlg:", boost::bind(lmdb_collect_int64, &keys, 10, _1, _2)), 10);
+    ASSERT_EQ(keys.front(), -500);
+    ASSERT_EQ(keys.back(), -491);
+  
+    //
+    // Half open range
+    //
+    std::string first("reg:");
+    LMDatabase::appendInt64(first, -10);
+    std::string last("reg:");
+    LMDatabase::appendInt64(last, 10);
+    keys.clear();
+    ASSERT_EQ(lmdb.scanRange(reader, first, last, boost::bind(lmdb_collect_int64, &keys, 10000, _1, _2)), 20);
+    ASSERT_EQ(keys.front(), -10);
+    ASSERT_EQ(keys.back(), 9);
+    ASSERT_EQ(lmdb.scanPrefix(reader, "none:", boost::bind(lmdb_collect_int64, &keys, 10000, _1, _2)), 0);
+  
+    //
+    // Zero-copy access
+    //
+    LMDatabase::View view;
+    ASSERT_TRUE(lmdb.get(reader, first, view));
+    ASSERT_EQ(view.compare(LMDatabase::View(std::string("Scanned Value"))), 0);
+  
+    LMDatabase::Cursor cursor;
+    ASSERT_TRUE(lmdb.createCursor(reader, cursor));
+    ASSERT_TRUE(cursor.seek("reg:"));
+    ASSERT_TRUE(cursor.keyView().startsWith(LMDatabase::View(std::string("reg:"))));
+    ASSERT_TRUE(cursor.bottom());
+    ASSERT_TRUE(cursor.prev());
+    int64_t number = 0;
+    ASSERT_TRUE(LMDatabase::decodeInt64(cursor.keyView(), number, 4));
+    ASSERT_EQ(number, 498);
+    cursor.destroy();
+  
+    OSS::UInt32 u32 = 0;
+    ASSERT_TRUE(LMDatabase::decodeUInt32(LMDatabase::View(LMDatabase::encodeUInt32(0xDEADBEEF)), u32));
+    ASSERT_EQ(u32, 0xDEADBEEF);
+    ASSERT_LT(LMDatabase::encodeInt32(-1), LMDatabase::encodeInt32(0));
+    ASSERT_LT(LMDatabase::encodeUInt64(255), LMDatabase::encodeUInt64(256));
+    OSS::UInt64 u64 = 0;
+    ASSERT_FALSE(LMDatabase::decodeUInt64(LMDatabase::View(first), u64, 8));
+  } while (false);
+  
+  do {
+    LMDatabase::TransactionLock lock(transaction);
+    ASSERT_TRUE(lmdb.drop(transaction));
+  } while (false);
+}
@@ -0,0 +1,149 @@
+#include "gtest/gtest.h"
+#include "OSS/UTL/Logger.h"
+#include "OSS/UTL/LogAsyncSink.h"
+#include "OSS/UTL/CoreUtils.h"
+#include "OSS/UTL/Thread.h"
+#include <boost/bind.hpp>
+
+
+using OSS::UTL::LogAsyncSink;
+
+
+struct LogFormatCounter
+{
+  LogFormatCounter() : count(0) {}
+  mutable int count;
+};
+
+static std::ostream& operator << (std::ostream& strm, const LogFormatCounter& counter)
+{
+  ++counter.count;
+  return strm << counter.count;
+}
+
+static OSS::mutex_critic_sec gLogRecordMutex;
+static std::size_t gLogRecordCount = 0;
+static std::size_t gLogDropNotices = 0;
+
+static void count_log_records(const LogAsyncSink::Record* records, std::size_t count)
+{
+  OSS::mutex_critic_sec_lock lock(gLogRecordMutex);
+  for (std::size_t i = 0; i < count; i++)
+  {
+    if (records[i].text.find("LogAsyncSink dropped") == 0)
+      ++gLogDropNotices;
+    else
+      ++gLogRecordCount;
+  }
+}
+
+static void produce_log_records(LogAsyncSink* pSink, int count)
+{
+  for (int i = 0; i < count; i++)
+    pSink->enqueue(OSS::PRIO_INFORMATION, "The quick brown fox jumps over the lazy dog");
+}
+
+TEST(LogTest, test_level_check_before_format)
+{
+  OSS::LogPriority level = OSS::log_get_level();
+  OSS::log_reset_level(OSS::PRIO_NOTICE);
+
+  LogFormatCounter counter;
+  OSS_LOG_DEBUG("suppressed " << counter);
+  OSS_LOG_TRACE("suppressed " << counter);
+  ASSERT_EQ(counter.count, 0);
+  ASSERT_FALSE(OSS::log_will_log(OSS::PRIO_DEBUG));
+  ASSERT_TRUE(OSS::log_will_log(OSS::PRIO_ERROR));
+
+  OSS::log_reset_level(level);
+}
+
+TEST(LogTest, test_async_sink_delivery)
+{
+  gLogRecordCount = 0;
+  gLogDropNotices = 0;
+
+  LogAsyncSink sink(count_log_records, 65536);
+  sink.start();
+
+  boost::thread_group producers;
+  for (int i = 0; i < 4; i++)
+    producers.create_thread(boost::bind(produce_log_records, &sink, 10000));
+  producers.join_all();
+
+  sink.flush();
+  ASSERT_EQ(sink.getDroppedCount(), 0);
+  ASSERT_EQ(sink.getWrittenCount(), 40000);
+  sink.stop();
+
+  OSS::mutex_critic_sec_lock lock(gLogRecordMutex);
+  ASSERT_EQ(gLogRecordCount, 40000);
+  ASSERT_EQ(gLogDropNotices, 0);
+}
+
+TEST(LogTest, test_async_sink_drop_policy)
+{
+  gLogRecordCount = 0;
+  gLogDropNotices = 0;
+
+  //
+  // The writer is not started so the ring fills up.  Debug records are shed
+  // at the high water mark (12 of 16) while warnings still get the rest.
+  //
+  LogAsyncSink sink(count_log_records, 16);
+  for (int i = 0; i < 20; i++)
+    sink.enqueue(OSS::PRIO_DEBUG, "debug");
+  ASSERT_EQ(sink.getDroppedCount(), 8);
+
+  for (int i = 0; i < 4; i++)
+    ASSERT_TRUE(sink.enqueue(OSS::PRIO_WARNING, "warning"));
+  ASSERT_FALSE(sink.enqueue(OSS::PRIO_FATAL, "fatal"));
+  ASSERT_EQ(sink.getDroppedCount(), 9);
+
+  sink.start();
+  sink.flush();
+  sink.stop();
+
+  OSS::mutex_critic_sec_lock lock(gLogRecordMutex);
+  ASSERT_EQ(gLogRecordCount, 16);
+  ASSERT_EQ(gLogDropNotices, 1);
+}
+
+TEST(LogTest, test_log_benchmark)
+{
+  const int iterations = 1000000;
+  OSS::LogPriority level = OSS::log_get_level();
+  OSS::log_reset_level(OSS::PRIO_INFORMATION);
+
+  OSS::UInt64 start = OSS::getTime();
+  for (int i = 0; i < iterations; i++)
+  {
+    OSS_LOG_DEBUG("LogTest::test_log_benchmark - suppressed line " << i << " of " << iterations);
+  }
+  OSS::UInt64 suppressed = OSS::getTime() - start;
+  OSS::log_reset_level(level);
+
+  gLogRecordCount = 0;
+  gLogDropNotices = 0;
+  LogAsyncSink sink(count_log_records, 65536);
+  sink.start();
+
+  start = OSS::getTime();
+  for (int i = 0; i < iterations; i++)
+  {
+    std::ostringstream strm;
+    strm << "LogTest::test_log_benchmark - emitted line " << i << " of " << iterations;
+    sink.enqueue(OSS::PRIO_INFORMATION, strm.str());
+  }
+  OSS::UInt64 emitted = OSS::getTime() - start;
+  sink.flush();
+  OSS::UInt64 written = OSS::getTime() - start;
+  sink.stop();
+
+  std::cout << "Suppressed log line: " << (suppressed * 1000000.0) / iterations << " ns" << std::endl;
+  std::cout << "Emitted log line (caller): " << (emitted * 1000000.0) / iterations << " ns" << std::endl;
+  std::cout << "Emitted log line (written): " << (written * 1000000.0) / iterations << " ns" << std::endl;
+  std::cout << "Dropped log lines: " << sink.getDroppedCount() << std::endl;
+
+  ASSERT_EQ(sink.getWrittenCount() + sink.getDroppedCount(), (std::size_t)iterations);
+}
@@ -57,16 +57,25 @@ See also: For more string comparison tricks (substring, prefix, suffix, and regu
 
 #include <set>
 #include <memory>
+#include <fstream>
+#include <boost/asio.hpp>
+#include <boost/bind.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/lexical_cast.hpp>
 
 #include "gtest/gtest.h"
 #include "OSS/build.h"
 
+#include "OSS/UTL/CoreUtils.h"
 #include "OSS/RAFT/RaftConsensus.h"
 
 
 using OSS::RAFT::RaftConsensus;
+using OSS::RAFT::RaftLog;
 using OSS::RAFT::RaftNode;
 using OSS::RAFT::RaftConnection;
+using OSS::RAFT::msg_installsnapshot_t;
+using OSS::RAFT::msg_installsnapshot_response_t;
 
 class Server;
 
@@ -180,3 +189,536 @@ TEST(RAFTTest, TestRaftConsensus)
 #endif
 }
 
+
+
+static const char* RAFT_TEST_LOG_DIR = "raft_test_log";
+
+
+TEST(RAFTTest, TestRaftLogPersistence)
+{
+  boost::filesystem::remove_all(RAFT_TEST_LOG_DIR);
+  
+  std::string data[4] = { "first", "second", "", std::string(1000, 'x') };
+  {
+    RaftLog log;
+    ASSERT_TRUE(log.open(RAFT_TEST_LOG_DIR));
+    ASSERT_EQ(log.getLastIndex(), 0);
+    ASSERT_EQ(log.getVote(), -1);
+    ASSERT_TRUE(log.persistState(3, 2));
+    
+    for (int i = 0; i < 4; i++)
+    {
+      raft_entry_t entry;
+      entry.term = 3;
+      entry.id = i + 1;
+      entry.type = RAFT_LOGTYPE_NORMAL;
+      entry.data.buf = (void*)data[i].data();
+      entry.data.len = data[i].size();
+      ASSERT_TRUE(log.append(entry));
+    }
+    
+    //
+    // Four appends cost a single flush
+    //
+    ASSERT_TRUE(log.sync());
+    ASSERT_EQ(log.getSyncCount(), 1);
+    ASSERT_TRUE(log.sync());
+    ASSERT_EQ(log.getSyncCount(), 1);
+    
+    ASSERT_TRUE(log.truncate(4));
+    ASSERT_EQ(log.getLastIndex(), 3);
+  }
+  
+  {
+    RaftLog log;
+    ASSERT_TRUE(log.open(RAFT_TEST_LOG_DIR));
+    ASSERT_EQ(log.getTerm(), 3);
+    ASSERT_EQ(log.getVote(), 2);
+    ASSERT_EQ(log.getLastIndex(), 3);
+    for (int i = 0; i < 3; i++)
+    {
+      ASSERT_EQ(log.getEntry(i + 1)->id, (unsigned int)(i + 1));
+      ASSERT_EQ(log.getEntry(i + 1)->data, data[i]);
+    }
+    ASSERT_FALSE(log.getEntry(4));
+  }
+  
+  //
+  // A torn record at the tail is dropped on open
+  //
+  {
+    std::string logFile = (boost::filesystem::path(RAFT_TEST_LOG_DIR) / "raft.log").string();
+    std::ofstream strm(logFile.c_str(), std::ios::app | std::ios::binary);
+    strm.write("\0\0\0\x20garbage", 11);
+  }
+  {
+    RaftLog log;
+    ASSERT_TRUE(log.open(RAFT_TEST_LOG_DIR));
+    ASSERT_EQ(log.getLastIndex(), 3);
+    ASSERT_EQ(log.getEntry(2)->data, data[1]);
+  }
+  
+  boost::filesystem::remove_all(RAFT_TEST_LOG_DIR);
+}
+
+
+//
+// Three node cluster where every node delivers its messages on its own
+// io_service thread, the way a network transport would
+//
+class LoopbackNode;
+typedef std::map<int, LoopbackNode*> LoopbackCluster;
+
+class LoopbackConnection : public RaftConnection
+{
+public:
+  LoopbackConnection(LoopbackNode* pNode, RaftNode& node);
+  void shutdown();
+  int onSendRequestVote(msg_requestvote_t& data);
+  int onSendAppendEntries(msg_appendentries_t& data);
+  int onSendRequestVoteResponse(msg_requestvote_response_t& data);
+  int onSendAppendEntriesResponse(msg_appendentries_response_t& data);
+  int onSendInstallSnapshot(msg_installsnapshot_t& data);
+  int onSendInstallSnapshotResponse(msg_installsnapshot_response_t& data);
+  LoopbackNode* _pNode;
+};
+
+struct LoopbackAppendEntries
+{
+  msg_appendentries_t message;
+  std::vector<msg_entry_t> entries;
+  std::vector<std::string> payloads;
+};
+
+struct LoopbackInstallSnapshot
+{
+  msg_installsnapshot_t message;
+  std::string chunk;
+};
+
+class LoopbackNode : public RaftConsensus
+{
+public:
+  LoopbackNode(LoopbackCluster& cluster) :
+    _cluster(cluster),
+    _work(_io),
+    _ioThread(boost::bind(&boost::asio::io_service::run, &_io)),
+    _applied(0)
+  {
+  }
+  
+  ~LoopbackNode()
+  {
+    _io.stop();
+    _ioThread.join();
+  }
+  
+  Connection::Ptr createConnection(Node& node)
+  {
+    return Connection::Ptr(new LoopbackConnection(this, node));
+  }
+  
+  int onApplyEntry(const raft_entry_t& entry)
+  {
+    _applied++;
+    return 0;
+  }
+  
+  //
+  // The state machine is the number of applied entries
+  //
+  bool onCreateSnapshot(std::string& data)
+  {
+    data = boost::lexical_cast<std::string>(_applied);
+    return true;
+  }
+  
+  bool onInstallSnapshot(const std::string& data)
+  {
+    _applied = boost::lexical_cast<int>(data);
+    return true;
+  }
+  
+  template <typename T>
+  void deliver(int from, T data, int (RaftConsensus::*handler)(const Connection::Ptr&, T&))
+  {
+    _io.post(boost::bind(&LoopbackNode::receive<T>, this, from, data, handler));
+  }
+  
+  template <typename T>
+  void receive(int from, T data, int (RaftConsensus::*handler)(const Connection::Ptr&, T&))
+  {
+    Node node;
+    if (findNode(from, node))
+    {
+      (this->*handler)(findOrCreateConnection(node), data);
+    }
+  }
+  
+  void receiveAppendEntries(int from, boost::shared_ptr<LoopbackAppendEntries> pData)
+  {
+    Node node;
+    if (findNode(from, node))
+    {
+      onReceivedAppendEntries(findOrCreateConnection(node), pData->message);
+    }
+  }
+  
+  void receiveInstallSnapshot(int from, boost::shared_ptr<LoopbackInstallSnapshot> pData)
+  {
+    Node node;
+    if (findNode(from, node))
+    {
+      onReceivedInstallSnapshot(findOrCreateConnection(node), pData->message);
+    }
+  }
+  
+  LoopbackCluster& _cluster;
+  boost::asio::io_service _io;
+  boost::asio::io_service::work _work;
+  boost::thread _ioThread;
+  int _applied;
+};
+
+LoopbackConnection::LoopbackConnection(LoopbackNode* pNode, RaftNode& node) :
+  RaftConnection(pNode, node),
+  _pNode(pNode)
+{
+}
+
+void LoopbackConnection::shutdown()
+{
+}
+
+int LoopbackConnection::onSendRequestVote(msg_requestvote_t& data)
+{
+  _pNode->_cluster[_node.getId()]->deliver(_pNode->opt().node_id, data, &RaftConsensus::onReceivedRequestVote);
+  return 0;
+}
+
+int LoopbackConnection::onSendAppendEntries(msg_appendentries_t& data)
+{
+  //
+  // The message only borrows the leader's entries.  Copy them the way a
+  // transport would serialize them.
+  //
+  boost::shared_ptr<LoopbackAppendEntries> pData(new LoopbackAppendEntries());
+  pData->message = data;
+  pData->entries.assign(data.entries, data.entries + data.n_entries);
+  pData->payloads.resize(data.n_entries);
+  for (int i = 0; i < data.n_entries; i++)
+  {
+    pData->payloads[i].assign((const char*)data.entries[i].data.buf, data.entries[i].data.len);
+    pData->entries[i].data.buf = (void*)pData->payloads[i].data();
+  }
+  pData->message.entries = pData->entries.empty() ? 0 : &pData->entries[0];
+  
+  LoopbackNode* pTarget = _pNode->_cluster[_node.getId()];
+  pTarget->_io.post(boost::bind(&LoopbackNode::receiveAppendEntries, pTarget, _pNode->opt().node_id, pData));
+  return 0;
+}
+
+int LoopbackConnection::onSendRequestVoteResponse(msg_requestvote_response_t& data)
+{
+  _pNode->_cluster[_node.getId()]->deliver(_pNode->opt().node_id, data, &RaftConsensus::onReceivedRequestVoteResponse);
+  return 0;
+}
+
+int LoopbackConnection::onSendAppendEntriesResponse(msg_appendentries_response_t& data)
+{
+  _pNode->_cluster[_node.getId()]->deliver(_pNode->opt().node_id, data, &RaftConsensus::onReceivedAppendEntriesResponse);
+  return 0;
+}
+
+int LoopbackConnection::onSendInstallSnapshot(msg_installsnapshot_t& data)
+{
+  boost::shared_ptr<LoopbackInstallSnapshot> pData(new LoopbackInstallSnapshot());
+  pData->message = data;
+  pData->chunk.assign(data.data, data.len);
+  pData->message.data = pData->chunk.data();
+  
+  LoopbackNode* pTarget = _pNode->_cluster[_node.getId()];
+  pTarget->_io.post(boost::bind(&LoopbackNode::receiveInstallSnapshot, pTarget, _pNode->opt().node_id, pData));
+  return 0;
+}
+
+int LoopbackConnection::onSendInstallSnapshotResponse(msg_installsnapshot_response_t& data)
+{
+  _pNode->_cluster[_node.getId()]->deliver(_pNode->opt().node_id, data, &RaftConsensus::onReceivedInstallSnapshotResponse);
+  return 0;
+}
+
+
+static std::string loopback_log_directory(int id)
+{
+  return (boost::filesystem::path(RAFT_TEST_LOG_DIR) / boost::lexical_cast<std::string>(id)).string();
+}
+
+static bool start_loopback_cluster(LoopbackCluster& cluster, bool withLog)
+{
+  for (int id = 1; id <= 3; id++)
+  {
+    RaftConsensus::Options opt;
+    opt.node_id = id;
+    opt.is_master = (id == 1);
+    opt.periodic_timer_ms = 50;
+    opt.election_timeout_ms = 1000;
+    if (withLog)
+    {
+      opt.log_directory = loopback_log_directory(id);
+    }
+    cluster[id] = new LoopbackNode(cluster);
+    if (!cluster[id]->initialize(opt))
+    {
+      return false;
+    }
+  }
+  for (int id = 1; id <= 3; id++)
+  {
+    for (int peer = 1; peer <= 3; peer++)
+    {
+      if (peer != id && !cluster[id]->addNode(peer))
+      {
+        return false;
+      }
+    }
+  }
+  for (int id = 1; id <= 3; id++)
+  {
+    cluster[id]->run();
+  }
+  return true;
+}
+
+static void stop_loopback_cluster(LoopbackCluster& cluster)
+{
+  for (LoopbackCluster::iterator iter = cluster.begin(); iter != cluster.end(); iter++)
+  {
+    iter->second->stop();
+  }
+  for (LoopbackCluster::iterator iter = cluster.begin(); iter != cluster.end(); iter++)
+  {
+    delete iter->second;
+  }
+  cluster.clear();
+}
+
+static bool wait_for_commit(RaftConsensus& node, int index, int timeoutMs)
+{
+  for (int waited = 0; node.getCommitIndex() < index; waited++)
+  {
+    if (waited >= timeoutMs)
+    {
+      return false;
+    }
+    OSS::thread_sleep(1);
+  }
+  return true;
+}
+
+TEST(RAFTTest, TestRaftLoopbackThroughput)
+{
+  boost::filesystem::remove_all(RAFT_TEST_LOG_DIR);
+  
+  const int ENTRY_COUNT = 20000;
+  std::string payload(128, 'p');
+  
+  for (int withLog = 0; withLog < 2; withLog++)
+  {
+    LoopbackCluster cluster;
+    ASSERT_TRUE(start_loopback_cluster(cluster, !!withLog));
+    LoopbackNode& leader = *cluster[1];
+    ASSERT_TRUE(leader.isLeader());
+    
+    OSS::UInt64 start = OSS::getTime();
+    for (int i = 0; i < ENTRY_COUNT; i++)
+    {
+      ASSERT_TRUE(leader.submit(payload));
+    }
+    ASSERT_TRUE(wait_for_commit(leader, ENTRY_COUNT, 30000));
+    OSS::UInt64 elapsed = OSS::getTime() - start;
+    
+    std::cout << "RaftConsensus 3 node loopback " << (withLog ? "durable log" : "memory log") << ": "
+      << ENTRY_COUNT << " entries committed in " << elapsed << " ms ("
+      << (elapsed ? ENTRY_COUNT * 1000 / elapsed : ENTRY_COUNT) << " entries/s, "
+      << leader.getLogSyncCount() << " leader flushes)" << std::endl;
+    
+    //
+    // Followers learn the commit index with the next message from the leader
+    //
+    ASSERT_TRUE(wait_for_commit(*cluster[2], ENTRY_COUNT, 5000));
+    ASSERT_TRUE(wait_for_commit(*cluster[3], ENTRY_COUNT, 5000));
+    ASSERT_EQ(cluster[2]->getCurrentIndex(), ENTRY_COUNT);
+    if (withLog)
+    {
+      ASSERT_LT(leader.getLogSyncCount(), (std::size_t)ENTRY_COUNT);
+    }
+    stop_loopback_cluster(cluster);
+  }
+  
+  //
+  // The durable cluster comes back with its log and keeps going
+  //
+  {
+    LoopbackCluster cluster;
+    ASSERT_TRUE(start_loopback_cluster(cluster, true));
+    ASSERT_EQ(cluster[2]->getCurrentIndex(), ENTRY_COUNT);
+    ASSERT_EQ(cluster[1]->getCurrentIndex(), ENTRY_COUNT);
+    ASSERT_TRUE(cluster[1]->submit(payload));
+    ASSERT_TRUE(wait_for_commit(*cluster[1], ENTRY_COUNT + 1, 5000));
+    stop_loopback_cluster(cluster);
+  }
+  
+  boost::filesystem::remove_all(RAFT_TEST_LOG_DIR);
+}
+
+TEST(RAFTTest, TestRaftSnapshotRecovery)
+{
+  boost::filesystem::remove_all(RAFT_TEST_LOG_DIR);
+  
+  //
+  // A snapshot taken on a bare log survives reopening it
+  //
+  {
+    RaftLog log;
+    ASSERT_TRUE(log.open(RAFT_TEST_LOG_DIR));
+    std::string payload("entry");
+    for (int i = 1; i <= 10; i++)
+    {
+      raft_entry_t entry;
+      entry.term = 1;
+      entry.id = i;
+      entry.type = RAFT_LOGTYPE_NORMAL;
+      entry.data.buf = (void*)payload.data();
+      entry.data.len = payload.size();
+      ASSERT_TRUE(log.append(entry));
+    }
+    ASSERT_TRUE(log.compact(6, 1, "state"));
+    ASSERT_EQ(log.getFirstIndex(), 7);
+    ASSERT_FALSE(log.getEntry(6));
+  }
+  {
+    RaftLog log;
+    ASSERT_TRUE(log.open(RAFT_TEST_LOG_DIR));
+    ASSERT_EQ(log.getSnapshotIndex(), 6);
+    ASSERT_EQ(log.getSnapshotTerm(), 1);
+    ASSERT_EQ(log.getSnapshotData(), "state");
+    ASSERT_EQ(log.getFirstIndex(), 7);
+    ASSERT_EQ(log.getLastIndex(), 10);
+    ASSERT_EQ(log.getEntry(7)->id, 7u);
+  }
+  boost::filesystem::remove_all(RAFT_TEST_LOG_DIR);
+  
+  //
+  // A crash after the snapshot is written but before the segment is
+  // rewritten leaves the old segment behind.  Entries appended after
+  // reopening must not be numbered from its stale header.
+  //
+  std::string logFile = (boost::filesystem::path(RAFT_TEST_LOG_DIR) / "raft.log").string();
+  std::string staleFile = logFile + ".stale";
+  {
+    RaftLog log;
+    ASSERT_TRUE(log.open(RAFT_TEST_LOG_DIR));
+    std::string payload("entry");
+    for (int i = 1; i <= 10; i++)
+    {
+      raft_entry_t entry;
+      entry.term = 1;
+      entry.id = i;
+      entry.type = RAFT_LOGTYPE_NORMAL;
+      entry.data.buf = (void*)payload.data();
+      entry.data.len = payload.size();
+      ASSERT_TRUE(log.append(entry));
+    }
+    ASSERT_TRUE(log.sync());
+    boost::filesystem::copy_file(logFile, staleFile);
+    ASSERT_TRUE(log.installSnapshot(15, 2, "state"));
+  }
+  boost::filesystem::remove(logFile);
+  boost::filesystem::rename(staleFile, logFile);
+  {
+    RaftLog log;
+    ASSERT_TRUE(log.open(RAFT_TEST_LOG_DIR));
+    ASSERT_EQ(log.getSnapshotIndex(), 15);
+    ASSERT_EQ(log.getLastIndex(), 15);
+    std::string payload("acknowledged");
+    raft_entry_t entry;
+    entry.term = 2;
+    entry.id = 16;
+    entry.type = RAFT_LOGTYPE_NORMAL;
+    entry.data.buf = (void*)payload.data();
+    entry.data.len = payload.size();
+    ASSERT_TRUE(log.append(entry));
+    ASSERT_TRUE(log.sync());
+  }
+  {
+    RaftLog log;
+    ASSERT_TRUE(log.open(RAFT_TEST_LOG_DIR));
+    ASSERT_EQ(log.getLastIndex(), 16);
+    ASSERT_EQ(log.getEntry(16)->id, 16u);
+    ASSERT_EQ(log.getEntry(16)->data, "acknowledged");
+  }
+  boost::filesystem::remove_all(RAFT_TEST_LOG_DIR);
+  
+  const int ENTRY_COUNT = 1000000;
+  std::string payload(8, 'p');
+  
+  {
+    LoopbackCluster cluster;
+    ASSERT_TRUE(start_loopback_cluster(cluster, true));
+    for (int i = 0; i < ENTRY_COUNT; i++)
+    {
+      ASSERT_TRUE(cluster[1]->submit(payload));
+    }
+    ASSERT_TRUE(wait_for_commit(*cluster[1], ENTRY_COUNT, 120000));
+    ASSERT_TRUE(wait_for_commit(*cluster[2], ENTRY_COUNT, 5000));
+    stop_loopback_cluster(cluster);
+  }
+  
+  //
+  // Node 3 lost its disk.  Without a snapshot it gets the whole history.
+  //
+  boost::filesystem::remove_all(loopback_log_directory(3));
+  {
+    LoopbackCluster cluster;
+    OSS::UInt64 start = OSS::getTime();
+    ASSERT_TRUE(start_loopback_cluster(cluster, true));
+    ASSERT_TRUE(wait_for_commit(*cluster[3], ENTRY_COUNT, 120000));
+    OSS::UInt64 elapsed = OSS::getTime() - start;
+    ASSERT_EQ(cluster[3]->getCurrentIndex(), ENTRY_COUNT);
+    std::cout << "RaftConsensus recovery of " << ENTRY_COUNT << " entries by log replay: " << elapsed << " ms" << std::endl;
+    
+    ASSERT_TRUE(cluster[1]->takeSnapshot());
+    ASSERT_TRUE(cluster[2]->takeSnapshot());
+    ASSERT_EQ(cluster[1]->getSnapshotIndex(), ENTRY_COUNT);
+    stop_loopback_cluster(cluster);
+  }
+  
+  //
+  // Same loss again.  The leader's log starts after the snapshot so node 3
+  // is sent the snapshot instead.
+  //
+  boost::filesystem::remove_all(loopback_log_directory(3));
+  {
+    LoopbackCluster cluster;
+    OSS::UInt64 start = OSS::getTime();
+    ASSERT_TRUE(start_loopback_cluster(cluster, true));
+    ASSERT_EQ(cluster[1]->_applied, ENTRY_COUNT);
+    ASSERT_TRUE(wait_for_commit(*cluster[3], ENTRY_COUNT, 120000));
+    OSS::UInt64 elapsed = OSS::getTime() - start;
+    std::cout << "RaftConsensus recovery of " << ENTRY_COUNT << " entries by snapshot: " << elapsed << " ms" << std::endl;
+    ASSERT_EQ(cluster[3]->getSnapshotIndex(), ENTRY_COUNT);
+    ASSERT_EQ(cluster[3]->_applied, ENTRY_COUNT);
+    
+    //
+    // Replication carries on after the snapshot
+    //
+    ASSERT_TRUE(cluster[1]->submit(payload));
+    ASSERT_TRUE(wait_for_commit(*cluster[3], ENTRY_COUNT + 1, 5000));
+    ASSERT_EQ(cluster[3]->getCurrentIndex(), ENTRY_COUNT + 1);
+    stop_loopback_cluster(cluster);
+  }
+  
+  boost::filesystem::remove_all(RAFT_TEST_LOG_DIR);
+}
+
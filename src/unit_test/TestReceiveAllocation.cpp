@@ -0,0 +1,99 @@
+#include "gtest/gtest.h"
+#include <cstdlib>
+#include <new>
+#include <boost/pool/pool_alloc.hpp>
+#include "OSS/UTL/CoreUtils.h"
+#include "OSS/SIP/SIPTransportService.h"
+#include "OSS/SIP/SIPMessagePool.h"
+#include "OSS/SIP/SIPUDPConnectionClone.h"
+
+using namespace OSS::SIP;
+
+//
+// This file is linked into its own test program because it replaces the
+// global operator new to count heap allocations made by the receive path.
+//
+static volatile long allocationCount = 0;
+
+void* operator new(std::size_t size)
+#if __cplusplus < 201103L
+  throw(std::bad_alloc)
+#endif
+{
+  __sync_fetch_and_add(&allocationCount, 1);
+  void* ptr = std::malloc(size ? size : 1);
+  if (!ptr)
+  {
+    throw std::bad_alloc();
+  }
+  return ptr;
+}
+
+void operator delete(void* ptr)
+#if __cplusplus < 201103L
+  throw()
+#else
+  noexcept
+#endif
+{
+  std::free(ptr);
+}
+
+static const char* RECEIVED_PACKET =
+  "OPTIONS sip:bob@example.com SIP/2.0\r\n"
+  "Via: SIP/2.0/UDP 192.168.0.10:5060;branch=z9hG4bK776asdhds\r\n"
+  "From: <sip:alice@example.com>;tag=1928301774\r\n"
+  "To: <sip:bob@example.com>\r\n"
+  "Call-ID: a84b4c76e66710@pc33.example.com\r\n"
+  "CSeq: 314159 OPTIONS\r\n"
+  "Max-Forwards: 70\r\n"
+  "Content-Length: 0\r\n\r\n";
+
+TEST(ReceiveAllocationTest, test_udp_receive_allocation_benchmark)
+{
+  boost::asio::io_service ioService;
+  boost::asio::ip::udp::socket socket(ioService);
+  SIPUDPConnection::Ptr pConnection(new SIPUDPConnection(ioService, socket, 0));
+  std::size_t len = strlen(RECEIVED_PACKET);
+  const int messageCount = 100000;
+
+  //
+  // What the UDP receive path used to do for every datagram
+  //
+  long allocations = allocationCount;
+  OSS::UInt64 start = OSS::getTime();
+  for (int i = 0; i < messageCount; i++)
+  {
+    SIPMessage::Ptr pMsg = SIPMessage::Ptr(new SIPMessage());
+    std::string buffer(RECEIVED_PACKET, RECEIVED_PACKET + len);
+    pMsg->setData(buffer);
+    pMsg->parse();
+    SIPTransportSession::Ptr pClone(new SIPUDPConnectionClone(pConnection));
+  }
+  OSS::UInt64 before = OSS::getTime() - start;
+  double allocationsBefore = (double)(allocationCount - allocations) / messageCount;
+
+  //
+  // Pooled messages and clones.  parse() still allocates the header list
+  // because reset() empties it, so this is fewer allocations, not none.
+  //
+  SIPMessagePool pool;
+  allocations = allocationCount;
+  start = OSS::getTime();
+  for (int i = 0; i < messageCount; i++)
+  {
+    SIPMessage::Ptr pMsg = pool.acquire();
+    pMsg->setData(RECEIVED_PACKET, len);
+    pMsg->parse();
+    SIPTransportSession::Ptr pClone = boost::allocate_shared<SIPUDPConnectionClone>(
+      boost::fast_pool_allocator<SIPUDPConnectionClone>(), pConnection);
+  }
+  OSS::UInt64 after = OSS::getTime() - start;
+  double allocationsAfter = (double)(allocationCount - allocations) / messageCount;
+
+  ASSERT_LT(allocationsAfter, allocationsBefore);
+
+  std::cout << "ReceiveAllocationTest::test_udp_receive_allocation_benchmark " << messageCount << " datagrams: "
+    << allocationsBefore << " allocations/message in " << before << " ms before, "
+    << allocationsAfter << " allocations/message in " << after << " ms pooled" << std::endl;
+}
@@ -0,0 +1,304 @@
+#include "gtest/gtest.h"
+
+#include "OSS/build.h"
+#if ENABLE_FEATURE_REDIS
+#if OSS_HAVE_HIREDIS
+
+#include "OSS/UTL/Thread.h"
+#include "OSS/Persistent/RedisClient.h"
+#include "OSS/Persistent/RedisAsyncClient.h"
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <algorithm>
+
+
+using OSS::Persistent::RedisClient;
+using OSS::Persistent::RedisAsyncClient;
+using OSS::Persistent::RedisBroadcastClient;
+
+//
+// These tests need a redis-server listening on 127.0.0.1:6379 and return
+// early without one, same as TestRedisPubSub
+//
+
+static bool redis_async_available()
+{
+  RedisClient client("127.0.0.1", 6379);
+  return client.connect();
+}
+
+struct RedisAsyncTestLoop
+{
+  RedisAsyncTestLoop() : work(new boost::asio::io_service::work(ioService)), thread(boost::bind(&boost::asio::io_service::run, &ioService))
+  {
+  }
+  
+  ~RedisAsyncTestLoop()
+  {
+    work.reset();
+    if (!thread.timed_join(boost::posix_time::seconds(5)))
+    {
+      ioService.stop();
+      thread.join();
+    }
+  }
+  
+  boost::asio::io_service ioService;
+  boost::scoped_ptr<boost::asio::io_service::work> work;
+  boost::thread thread;
+};
+
+struct RedisAsyncBenchmark
+{
+  RedisAsyncBenchmark() : completed(0), failed(0) {}
+  
+  OSS::mutex_critic_sec mutex;
+  boost::condition_variable condition;
+  std::vector<boost::posix_time::ptime> sent;
+  std::vector<long> latency;
+  int completed;
+  int failed;
+};
+
+static void redis_async_benchmark_reply(RedisAsyncBenchmark* benchmark, int index, const RedisAsyncClient::Reply& reply)
+{
+  boost::posix_time::ptime now = boost::posix_time::microsec_clock::universal_time();
+  OSS::mutex_critic_sec_lock lock(benchmark->mutex);
+  benchmark->latency[index] = (now - benchmark->sent[index]).total_microseconds();
+  if (!reply.ok())
+  {
+    ++benchmark->failed;
+  }
+  ++benchmark->completed;
+  benchmark->condition.notify_all();
+}
+
+static long redis_async_p99(std::vector<long> latency)
+{
+  std::sort(latency.begin(), latency.end());
+  return latency.empty() ? 0 : latency[(latency.size() * 99) / 100];
+}
+
+TEST(TestRedisAsync, Pipelining)
+{
+  if (!redis_async_available())
+  {
+    return;
+  }
+  
+  RedisAsyncTestLoop loop;
+  RedisAsyncClient::Ptr client = RedisAsyncClient::create(loop.ioService, "127.0.0.1", 6379);
+  client->connect();
+  ASSERT_TRUE(client->waitForConnection());
+  
+  const int total = 100000;
+  const int window = 1000;
+  
+  //
+  // Blocking baseline.  One round trip per command.
+  //
+  RedisClient sync("127.0.0.1", 6379);
+  ASSERT_TRUE(sync.connect());
+  std::vector<long> syncLatency(total / 10);
+  boost::posix_time::ptime start = boost::posix_time::microsec_clock::universal_time();
+  for (int i = 0; i < total / 10; i++)
+  {
+    boost::posix_time::ptime sent = boost::posix_time::microsec_clock::universal_time();
+    ASSERT_TRUE(sync.set("test-redis-async-" + OSS::string_from_number<int>(i), "value"));
+    syncLatency[i] = (boost::posix_time::microsec_clock::universal_time() - sent).total_microseconds();
+  }
+  long elapsed = (boost::posix_time::microsec_clock::universal_time() - start).total_microseconds();
+  std::cout << "Redis blocking SET: " << (long long)(total / 10) * 1000000 / std::max(elapsed, 1L) << " ops/s, p99 "
+    << redis_async_p99(syncLatency) << " us" << std::endl;
+  
+  //
+  // Pipelined with up to window commands in flight
+  //
+  RedisAsyncBenchmark benchmark;
+  benchmark.sent.resize(total);
+  benchmark.latency.resize(total);
+  start = boost::posix_time::microsec_clock::universal_time();
+  for (int i = 0; i < total; i++)
+  {
+    {
+      boost::unique_lock<OSS::mutex_critic_sec> lock(benchmark.mutex);
+      while (i - benchmark.completed >= window)
+      {
+        benchmark.condition.wait(lock);
+      }
+      benchmark.sent[i] = boost::posix_time::microsec_clock::universal_time();
+    }
+    RedisAsyncClient::Command command;
+    command.push_back("SET");
+    command.push_back("test-redis-async-" + OSS::string_from_number<int>(i));
+    command.push_back("value");
+    client->execute(command, boost::bind(redis_async_benchmark_reply, &benchmark, i, _1));
+  }
+  
+  do
+  {
+    boost::unique_lock<OSS::mutex_critic_sec> lock(benchmark.mutex);
+    while (benchmark.completed < total)
+    {
+      benchmark.condition.wait(lock);
+    }
+  } while (false);
+  elapsed = (boost::posix_time::microsec_clock::universal_time() - start).total_microseconds();
+  std::cout << "Redis pipelined SET: " << (long long)total * 1000000 / std::max(elapsed, 1L) << " ops/s, p99 "
+    << redis_async_p99(benchmark.latency) << " us" << std::endl;
+  
+  ASSERT_EQ(0, benchmark.failed);
+  ASSERT_EQ(0, (int)client->getPendingCount());
+  
+  std::vector<std::string> keys;
+  ASSERT_TRUE(client->scanSync("test-redis-async-*", keys));
+  ASSERT_EQ(total, (int)keys.size());
+  
+  std::vector<std::string> values;
+  ASSERT_TRUE(sync.getAll(values, "test-redis-async-*"));
+  ASSERT_EQ(total, (int)values.size());
+  
+  for (std::vector<std::string>::iterator iter = keys.begin(); iter != keys.end(); iter++)
+  {
+    RedisAsyncClient::Command del;
+    del.push_back("DEL");
+    del.push_back(*iter);
+    client->execute(del);
+  }
+  RedisAsyncClient::Reply reply;
+  RedisAsyncClient::Command exists;
+  exists.push_back("EXISTS");
+  exists.push_back(keys.front());
+  ASSERT_TRUE(client->executeSync(exists, reply));
+  ASSERT_EQ(0, reply.integer);
+  
+  client->disconnect();
+}
+
+TEST(TestRedisAsync, Transaction)
+{
+  if (!redis_async_available())
+  {
+    return;
+  }
+  
+  RedisAsyncTestLoop loop;
+  RedisAsyncClient::Ptr client = RedisAsyncClient::create(loop.ioService, "127.0.0.1", 6379);
+  client->connect();
+  ASSERT_TRUE(client->waitForConnection());
+  
+  RedisAsyncClient::Commands commands;
+  RedisAsyncClient::Command command;
+  command.push_back("SET");
+  command.push_back("test-redis-async-multi");
+  command.push_back("1");
+  commands.push_back(command);
+  command.clear();
+  command.push_back("INCRBY");
+  command.push_back("test-redis-async-multi");
+  command.push_back("41");
+  commands.push_back(command);
+  command.clear();
+  command.push_back("DEL");
+  command.push_back("test-redis-async-multi");
+  commands.push_back(command);
+  
+  RedisAsyncClient::Reply reply;
+  ASSERT_TRUE(client->executeTransactionSync(commands, reply));
+  ASSERT_EQ(3, (int)reply.elements.size());
+  ASSERT_EQ("OK", reply.elements[0].str);
+  ASSERT_EQ(42, reply.elements[1].integer);
+  ASSERT_EQ(1, reply.elements[2].integer);
+  
+  client->disconnect();
+}
+
+TEST(TestRedisAsync, MultiPageScan)
+{
+  if (!redis_async_available())
+  {
+    return;
+  }
+  
+  RedisAsyncTestLoop loop;
+  RedisAsyncClient::Ptr client = RedisAsyncClient::create(loop.ioService, "127.0.0.1", 6379);
+  client->connect();
+  ASSERT_TRUE(client->waitForConnection());
+  
+  //
+  // A COUNT of 10 forces the scan over many round trips.  Every fifth key
+  // holds an empty value that getAll() must still return.
+  //
+  const int total = 250;
+  RedisClient sync("127.0.0.1", 6379);
+  ASSERT_TRUE(sync.connect());
+  for (int i = 0; i < total; i++)
+  {
+    RedisAsyncClient::Command command;
+    command.push_back("SET");
+    command.push_back("test-redis-scan-" + OSS::string_from_number<int>(i));
+    command.push_back(i % 5 ? "value" : "");
+    client->execute(command);
+  }
+  
+  std::vector<std::string> keys;
+  ASSERT_TRUE(client->scanSync("test-redis-scan-*", keys, 10));
+  ASSERT_EQ(total, (int)keys.size());
+  
+  std::vector<std::string> values;
+  ASSERT_TRUE(sync.getAll(values, "test-redis-scan-*"));
+  ASSERT_EQ(total, (int)values.size());
+  ASSERT_EQ(total / 5, (int)std::count(values.begin(), values.end(), std::string()));
+  
+  for (std::vector<std::string>::iterator iter = keys.begin(); iter != keys.end(); iter++)
+  {
+    RedisAsyncClient::Command del;
+    del.push_back("DEL");
+    del.push_back(*iter);
+    client->execute(del);
+  }
+  
+  keys.clear();
+  ASSERT_TRUE(client->scanSync("test-redis-scan-*", keys, 10));
+  ASSERT_TRUE(keys.empty());
+  
+  client->disconnect();
+}
+
+TEST(TestRedisAsync, Broadcast)
+{
+  if (!redis_async_available())
+  {
+    return;
+  }
+  
+  //
+  // Two names for the same server are enough to exercise the fan out
+  //
+  RedisBroadcastClient broadcast;
+  ASSERT_TRUE(broadcast.connect("127.0.0.1", 6379));
+  ASSERT_TRUE(broadcast.connect("localhost", 6379));
+  OSS::thread_sleep(100);
+  
+  ASSERT_TRUE(broadcast.set("test-redis-async-broadcast", "value"));
+  std::string value;
+  ASSERT_TRUE(broadcast.get("test-redis-async-broadcast", value));
+  ASSERT_EQ("value", value);
+  
+  ASSERT_TRUE(broadcast.hset("test-redis-async-hash", "field", "value"));
+  std::vector<std::string> keys;
+  ASSERT_TRUE(broadcast.getKeys("test-redis-async-*", keys));
+  ASSERT_EQ(2, (int)keys.size());
+  
+  ASSERT_TRUE(broadcast.del("test-redis-async-broadcast"));
+  ASSERT_TRUE(broadcast.del("test-redis-async-hash"));
+  ASSERT_FALSE(broadcast.get("test-redis-async-broadcast", value));
+  broadcast.disconnect();
+}
+
+#else
+
+TEST(NullTest, null_test_redis_async){}
+
+#endif
+#endif
@@ -1,6 +1,16 @@
 #include "gtest/gtest.h"
+#include <deque>
+#include <map>
+#include <algorithm>
+#include <sstream>
 #include "OSS/UTL/CoreUtils.h"
 #include "OSS/SIP/SIPTransportService.h" 
+#include "OSS/SIP/SIPConnectionIndex.h"
+#include "OSS/SIP/SIPStreamSendQueue.h"
+#include "OSS/SIP/SIPMessagePool.h"
+#include "OSS/SIP/SIPOverloadControl.h"
+#include "OSS/SIP/SIPIngressQueue.h"
+#include "OSS/Net/TLSSessionCache.h"
 #include "OSS/Net/Net.h"
 
 using namespace OSS::SIP;
@@ -111,3 +121,892 @@ TEST(TransportTest, test_get_default_address)
   ASSERT_FALSE(address.empty());
   std::cout << "TransportTest::test_get_default_address result: address=" << address << std::endl;
 }
+
+struct IndexedConnection
+{
+  OSS::UInt64 identifier;
+  IndexedConnection(OSS::UInt64 id) : identifier(id) {}
+};
+
+static OSS::Net::IPAddress indexed_address(unsigned i)
+{
+  boost::asio::ip::address_v4 ip((10u << 24) | (i >> 8));
+  return OSS::Net::IPAddress(ip.to_string(), (unsigned short)(5060 + (i & 0xFF)));
+}
+
+TEST(TransportTest, test_connection_index)
+{
+  typedef SIPConnectionIndex<IndexedConnection> Index;
+  Index index;
+
+  Index::ConnectionPtr tcp(new IndexedConnection(1));
+  Index::ConnectionPtr tls(new IndexedConnection(2));
+  OSS::Net::IPAddress remote("192.168.1.10", 5060);
+
+  ASSERT_FALSE(index.add(3, OSS::Net::IPAddress(), "tcp", tcp));
+  ASSERT_TRUE(index.add(1, remote, "tcp", tcp));
+  ASSERT_TRUE(index.add(2, remote, "tls", tls));
+  ASSERT_EQ(index.size(), 2);
+
+  ASSERT_TRUE(index.find(remote, "tcp") == tcp);
+  ASSERT_TRUE(index.find(remote, "tls") == tls);
+  ASSERT_FALSE(index.find(remote, "ws"));
+  ASSERT_FALSE(index.find(OSS::Net::IPAddress("192.168.1.10", 5061), "tcp"));
+  ASSERT_FALSE(index.find(OSS::Net::IPAddress("192.168.1.11", 5060), "tcp"));
+
+  //
+  // A reconnect from the same peer takes over the slot.  Removing the stale
+  // connection afterwards must not drop the new one.
+  //
+  Index::ConnectionPtr reconnect(new IndexedConnection(4));
+  ASSERT_TRUE(index.add(4, remote, "tcp", reconnect));
+  ASSERT_TRUE(index.find(remote, "tcp") == reconnect);
+  index.remove(1);
+  ASSERT_TRUE(index.find(remote, "tcp") == reconnect);
+  index.remove(4);
+  ASSERT_FALSE(index.find(remote, "tcp"));
+
+  //
+  // Re-adding an identifier under a new address moves the entry
+  //
+  OSS::Net::IPAddress moved("2001:db8::1", 5061);
+  ASSERT_TRUE(index.add(2, moved, "tls", tls));
+  ASSERT_FALSE(index.find(remote, "tls"));
+  ASSERT_TRUE(index.find(moved, "tls") == tls);
+
+  index.clear();
+  ASSERT_EQ(index.size(), 0);
+  ASSERT_FALSE(index.find(moved, "tls"));
+}
+
+TEST(TransportTest, test_connection_index_benchmark)
+{
+  typedef SIPConnectionIndex<IndexedConnection> Index;
+  const unsigned connectionCount = 60000;
+  const unsigned lookupCount = 1000000;
+
+  Index index;
+  std::vector<Index::ConnectionPtr> connections;
+  std::vector<OSS::Net::IPAddress> addresses;
+  for (unsigned i = 0; i < connectionCount; i++)
+  {
+    connections.push_back(Index::ConnectionPtr(new IndexedConnection(i + 1)));
+    addresses.push_back(indexed_address(i));
+    ASSERT_TRUE(index.add(i + 1, addresses.back(), "tcp", connections.back()));
+  }
+  ASSERT_EQ(index.size(), connectionCount);
+
+  OSS::UInt64 start = OSS::getTime();
+  unsigned found = 0;
+  for (unsigned i = 0; i < lookupCount; i++)
+  {
+    Index::ConnectionPtr conn = index.find(addresses[(i * 7919) % connectionCount], "tcp");
+    if (conn)
+    {
+      found++;
+    }
+  }
+  OSS::UInt64 indexed = OSS::getTime() - start;
+  ASSERT_EQ(found, lookupCount);
+
+  //
+  // The same lookups against a linear scan of the connection list
+  //
+  const unsigned scanCount = 1000;
+  start = OSS::getTime();
+  found = 0;
+  for (unsigned i = 0; i < scanCount; i++)
+  {
+    const OSS::Net::IPAddress& target = addresses[(i * 7919) % connectionCount];
+    for (unsigned j = 0; j < connectionCount; j++)
+    {
+      if (addresses[j].compare(target, true))
+      {
+        found++;
+        break;
+      }
+    }
+  }
+  OSS::UInt64 scanned = OSS::getTime() - start;
+  ASSERT_EQ(found, scanCount);
+
+  std::cout << "TransportTest::test_connection_index_benchmark " << connectionCount << " connections: "
+    << lookupCount << " indexed lookups in " << indexed << " ms, "
+    << scanCount << " linear scans in " << scanned << " ms" << std::endl;
+}
+
+static bool tls_loopback_handshake(SSL_CTX* pServerContext, SSL_CTX* pClientContext,
+  OSS::Net::TLSSessionCache& cache, const std::string& destination, bool& resumed)
+{
+  SSL* pServer = SSL_new(pServerContext);
+  SSL* pClient = SSL_new(pClientContext);
+  BIO* pServerBio = 0;
+  BIO* pClientBio = 0;
+  BIO_new_bio_pair(&pServerBio, 0, &pClientBio, 0);
+  SSL_set_bio(pServer, pServerBio, pServerBio);
+  SSL_set_bio(pClient, pClientBio, pClientBio);
+  SSL_set_accept_state(pServer);
+  SSL_set_connect_state(pClient);
+
+  cache.offerSession(pClient, destination);
+
+  bool serverDone = false;
+  bool clientDone = false;
+  bool failed = false;
+  for (int i = 0; i < 32 && !failed && !(serverDone && clientDone); i++)
+  {
+    if (!clientDone)
+    {
+      int ret = SSL_do_handshake(pClient);
+      clientDone = ret == 1;
+      failed = !clientDone && SSL_get_error(pClient, ret) != SSL_ERROR_WANT_READ;
+    }
+    if (!serverDone && !failed)
+    {
+      int ret = SSL_do_handshake(pServer);
+      serverDone = ret == 1;
+      failed = !serverDone && SSL_get_error(pServer, ret) != SSL_ERROR_WANT_READ;
+    }
+  }
+
+  //
+  // TLS 1.3 tickets arrive after the handshake.  Let the client read them.
+  //
+  char byte;
+  SSL_read(pClient, &byte, 1);
+
+  cache.recordHandshake(pServer, !failed);
+  cache.recordHandshake(pClient, !failed);
+  resumed = SSL_session_reused(pClient) == 1;
+
+  SSL_free(pServer);
+  SSL_free(pClient);
+  return !failed;
+}
+
+static bool tls_loopback_contexts(boost::asio::ssl::context& server, boost::asio::ssl::context& client)
+{
+  if (!boost::filesystem::exists(SERVER_KEY_FILE))
+  {
+    return false;
+  }
+#if OPENSSL_VERSION_NUMBER >= 0x10100000L
+  //
+  // The test keys are 1024 bit RSA
+  //
+  SSL_CTX_set_security_level(server.native_handle(), 0);
+  SSL_CTX_set_security_level(client.native_handle(), 0);
+#endif
+  server.set_password_callback(password_callback);
+  server.use_certificate_file(SERVER_CERT_FILE, boost::asio::ssl::context::pem);
+  server.use_private_key_file(SERVER_KEY_FILE, boost::asio::ssl::context::pem);
+  server.set_verify_mode(boost::asio::ssl::context::verify_none);
+  client.set_verify_mode(boost::asio::ssl::context::verify_none);
+  return true;
+}
+
+TEST(TransportTest, test_tls_session_resumption)
+{
+  boost::asio::ssl::context server(boost::asio::ssl::context::sslv23_server);
+  boost::asio::ssl::context client(boost::asio::ssl::context::sslv23_client);
+  if (!tls_loopback_contexts(server, client))
+  {
+    return;
+  }
+
+  OSS::Net::TLSSessionCache cache;
+  cache.attachServer(server.native_handle(), "oss_core_test");
+  cache.attachClient(client.native_handle());
+  ASSERT_TRUE(OSS::Net::TLSSessionCache::fromContext(server.native_handle()) == &cache);
+  ASSERT_TRUE(OSS::Net::TLSSessionCache::fromContext(client.native_handle()) == &cache);
+
+  bool resumed = true;
+  ASSERT_TRUE(tls_loopback_handshake(server.native_handle(), client.native_handle(), cache, "192.168.1.10:5061", resumed));
+  ASSERT_FALSE(resumed);
+  ASSERT_EQ(cache.getClientSessionCount(), 1);
+
+  ASSERT_TRUE(tls_loopback_handshake(server.native_handle(), client.native_handle(), cache, "192.168.1.10:5061", resumed));
+  ASSERT_TRUE(resumed);
+
+  //
+  // Nothing is cached for another destination
+  //
+  ASSERT_TRUE(tls_loopback_handshake(server.native_handle(), client.native_handle(), cache, "192.168.1.11:5061", resumed));
+  ASSERT_FALSE(resumed);
+  ASSERT_EQ(cache.getClientSessionCount(), 2);
+
+  //
+  // Tickets survive one key rotation but not two
+  //
+  cache.rotateTicketKey();
+  ASSERT_TRUE(tls_loopback_handshake(server.native_handle(), client.native_handle(), cache, "192.168.1.10:5061", resumed));
+  ASSERT_TRUE(resumed);
+  cache.rotateTicketKey();
+  cache.rotateTicketKey();
+  ASSERT_TRUE(tls_loopback_handshake(server.native_handle(), client.native_handle(), cache, "192.168.1.10:5061", resumed));
+  ASSERT_FALSE(resumed);
+
+  OSS::Net::TLSSessionCache::Stats stats = cache.getStats();
+  ASSERT_EQ(stats.fullHandshakes, 6);
+  ASSERT_EQ(stats.resumedHandshakes, 4);
+  ASSERT_EQ(stats.failedHandshakes, 0);
+  ASSERT_TRUE(stats.resumptionRatio > 0.39 && stats.resumptionRatio < 0.41);
+
+  cache.clearClientSessions();
+  ASSERT_EQ(cache.getClientSessionCount(), 0);
+}
+
+TEST(TransportTest, test_tls_session_resumption_benchmark)
+{
+  boost::asio::ssl::context server(boost::asio::ssl::context::sslv23_server);
+  boost::asio::ssl::context client(boost::asio::ssl::context::sslv23_client);
+  if (!tls_loopback_contexts(server, client))
+  {
+    return;
+  }
+
+  OSS::Net::TLSSessionCache cache;
+  cache.attachServer(server.native_handle(), "oss_core_test");
+  cache.attachClient(client.native_handle());
+
+  const int handshakeCount = 500;
+  bool resumed = false;
+
+  OSS::UInt64 start = OSS::getTime();
+  for (int i = 0; i < handshakeCount; i++)
+  {
+    ASSERT_TRUE(tls_loopback_handshake(server.native_handle(), client.native_handle(), cache, "", resumed));
+    ASSERT_FALSE(resumed);
+  }
+  OSS::UInt64 full = OSS::getTime() - start;
+
+  ASSERT_TRUE(tls_loopback_handshake(server.native_handle(), client.native_handle(), cache, "127.0.0.1:5061", resumed));
+  start = OSS::getTime();
+  for (int i = 0; i < handshakeCount; i++)
+  {
+    ASSERT_TRUE(tls_loopback_handshake(server.native_handle(), client.native_handle(), cache, "127.0.0.1:5061", resumed));
+    ASSERT_TRUE(resumed);
+  }
+  OSS::UInt64 resumption = OSS::getTime() - start;
+
+  OSS::Net::TLSSessionCache::Stats stats = cache.getStats();
+  std::cout << "TransportTest::test_tls_session_resumption_benchmark " << handshakeCount << " handshakes: full "
+    << (full ? handshakeCount * 1000 / full : 0) << "/s, resumed "
+    << (resumption ? handshakeCount * 1000 / resumption : 0) << "/s, resumption ratio "
+    << stats.resumptionRatio << std::endl;
+}
+
+TEST(TransportTest, test_stream_send_queue)
+{
+  SIPStreamSendQueue queue(1024, 100);
+  SIPStreamSendQueue::Buffers buffers;
+
+  //
+  // The first push makes the caller the writer.  Later pushes queue behind it.
+  //
+  ASSERT_EQ(queue.push("first"), SIPStreamSendQueue::PUSH_START_WRITE);
+  ASSERT_EQ(queue.push("second"), SIPStreamSendQueue::PUSH_QUEUED);
+  ASSERT_FALSE(queue.acquire());
+  ASSERT_TRUE(queue.nextBatch(buffers));
+  ASSERT_EQ(buffers.size(), 2);
+  ASSERT_EQ(std::string(boost::asio::buffer_cast<const char*>(buffers[0]), boost::asio::buffer_size(buffers[0])), "first");
+  ASSERT_EQ(std::string(boost::asio::buffer_cast<const char*>(buffers[1]), boost::asio::buffer_size(buffers[1])), "second");
+
+  //
+  // Messages pushed while the batch is in flight go to the next batch
+  //
+  ASSERT_EQ(queue.push("third"), SIPStreamSendQueue::PUSH_QUEUED);
+  ASSERT_EQ(queue.getQueuedMessages(), 3);
+  queue.completeBatch();
+  ASSERT_EQ(queue.getQueuedBytes(), 5);
+  ASSERT_TRUE(queue.nextBatch(buffers));
+  ASSERT_EQ(buffers.size(), 1);
+  queue.completeBatch();
+  ASSERT_FALSE(queue.nextBatch(buffers));
+  ASSERT_EQ(queue.getQueuedBytes(), 0);
+
+  //
+  // Nothing is in flight so a direct write may claim the writer role
+  //
+  ASSERT_TRUE(queue.acquire());
+  ASSERT_EQ(queue.push("fourth"), SIPStreamSendQueue::PUSH_QUEUED);
+  ASSERT_TRUE(queue.nextBatch(buffers));
+  queue.completeBatch();
+  ASSERT_FALSE(queue.nextBatch(buffers));
+
+  //
+  // Byte limit
+  //
+  std::string large(600, 'x');
+  ASSERT_EQ(queue.push(large), SIPStreamSendQueue::PUSH_START_WRITE);
+  ASSERT_EQ(queue.push(large), SIPStreamSendQueue::PUSH_REJECTED);
+  ASSERT_EQ(queue.getRejectedCount(), 1);
+  ASSERT_EQ(queue.getHighWaterMark(), 600);
+  queue.clear();
+  ASSERT_EQ(queue.getQueuedBytes(), 0);
+
+  //
+  // Message count limit and batch size limit
+  //
+  ASSERT_EQ(queue.push("x"), SIPStreamSendQueue::PUSH_START_WRITE);
+  for (int i = 1; i < 100; i++)
+  {
+    ASSERT_EQ(queue.push("x"), SIPStreamSendQueue::PUSH_QUEUED);
+  }
+  ASSERT_EQ(queue.push("x"), SIPStreamSendQueue::PUSH_REJECTED);
+  ASSERT_TRUE(queue.nextBatch(buffers));
+  ASSERT_EQ(buffers.size(), SIPStreamSendQueue::MAX_BATCH_BUFFERS);
+  queue.completeBatch();
+  ASSERT_TRUE(queue.nextBatch(buffers));
+  ASSERT_EQ(buffers.size(), 100 - SIPStreamSendQueue::MAX_BATCH_BUFFERS);
+  queue.completeBatch();
+  ASSERT_FALSE(queue.nextBatch(buffers));
+}
+
+static void drain_stream_socket(boost::asio::local::stream_protocol::socket* pSocket, std::size_t expected)
+{
+  char buf[65536];
+  std::size_t total = 0;
+  boost::system::error_code ec;
+  while (total < expected && !ec)
+  {
+    total += pSocket->read_some(boost::asio::buffer(buf), ec);
+  }
+}
+
+TEST(TransportTest, test_stream_send_queue_benchmark)
+{
+  boost::asio::io_service ioService;
+  boost::asio::local::stream_protocol::socket writer(ioService);
+  boost::asio::local::stream_protocol::socket reader(ioService);
+  boost::asio::local::connect_pair(writer, reader);
+
+  const std::size_t messageCount = 200000;
+  std::string message =
+    "SIP/2.0 200 OK\r\n"
+    "Via: SIP/2.0/TCP 192.168.0.10:5060;branch=z9hG4bK776asdhds\r\n"
+    "From: <sip:alice@example.com>;tag=1928301774\r\n"
+    "To: <sip:bob@example.com>;tag=a6c85cf\r\n"
+    "Call-ID: a84b4c76e66710@pc33.example.com\r\n"
+    "CSeq: 314159 OPTIONS\r\n"
+    "Content-Length: 0\r\n\r\n";
+
+  //
+  // One write per message
+  //
+  boost::thread directReader(boost::bind(drain_stream_socket, &reader, messageCount * message.size()));
+  OSS::UInt64 start = OSS::getTime();
+  for (std::size_t i = 0; i < messageCount; i++)
+  {
+    boost::asio::write(writer, boost::asio::buffer(message));
+  }
+  directReader.join();
+  OSS::UInt64 direct = OSS::getTime() - start;
+
+  //
+  // Gathered writes through the send queue
+  //
+  SIPStreamSendQueue queue(messageCount * message.size(), messageCount);
+  SIPStreamSendQueue::Buffers buffers;
+  boost::thread batchedReader(boost::bind(drain_stream_socket, &reader, messageCount * message.size()));
+  start = OSS::getTime();
+  for (std::size_t i = 0; i < messageCount; i++)
+  {
+    queue.push(message);
+    if ((i + 1) % SIPStreamSendQueue::MAX_BATCH_BUFFERS == 0 || i + 1 == messageCount)
+    {
+      while (queue.nextBatch(buffers))
+      {
+        boost::asio::write(writer, buffers);
+        queue.completeBatch();
+      }
+    }
+  }
+  batchedReader.join();
+  OSS::UInt64 batched = OSS::getTime() - start;
+
+  ASSERT_EQ(queue.getMessageCount(), messageCount);
+  ASSERT_EQ(queue.getQueuedBytes(), 0);
+
+  std::cout << "TransportTest::test_stream_send_queue_benchmark " << messageCount << " messages: direct "
+    << direct << " ms, batched " << batched << " ms in " << queue.getBatchCount() << " writes" << std::endl;
+}
+
+static const char* POOLED_PACKET =
+  "OPTIONS sip:bob@example.com SIP/2.0\r\n"
+  "Via: SIP/2.0/UDP 192.168.0.10:5060;branch=z9hG4bK776asdhds\r\n"
+  "From: <sip:alice@example.com>;tag=1928301774\r\n"
+  "To: <sip:bob@example.com>\r\n"
+  "Call-ID: a84b4c76e66710@pc33.example.com\r\n"
+  "CSeq: 314159 OPTIONS\r\n"
+  "Max-Forwards: 70\r\n"
+  "Content-Length: 0\r\n\r\n";
+
+TEST(TransportTest, test_sip_message_pool)
+{
+  SIPMessagePool pool(2);
+  std::size_t len = strlen(POOLED_PACKET);
+
+  SIPMessage* pRaw = 0;
+  {
+    SIPMessage::Ptr pMsg = pool.acquire();
+    pRaw = pMsg.get();
+    pMsg->setData(POOLED_PACKET, len);
+    pMsg->parse();
+    pMsg->setProperty("pooled", "1");
+    ASSERT_TRUE(pMsg->isRequest("OPTIONS"));
+    ASSERT_EQ(pMsg->getMethod(), "OPTIONS");
+  }
+
+  //
+  // The same object comes back with none of its previous state
+  //
+  SIPMessagePool::Stats stats = pool.getStats();
+  ASSERT_EQ(stats.created, 1);
+  ASSERT_EQ(stats.recycled, 1);
+  ASSERT_EQ(stats.available, 1);
+
+  SIPMessage::Ptr pMsg = pool.acquire();
+  ASSERT_EQ(pMsg.get(), pRaw);
+  ASSERT_TRUE(pMsg->data().empty());
+  ASSERT_TRUE(pMsg->getStartLine().empty());
+  ASSERT_TRUE(pMsg->properties().empty());
+  ASSERT_EQ(pMsg->hdrGetSize("Call-ID"), 0);
+  ASSERT_TRUE(pMsg->shared_from_this() == pMsg);
+
+  pMsg->setData(POOLED_PACKET, len);
+  pMsg->parse();
+  ASSERT_EQ(pMsg->hdrGet("call-id"), "a84b4c76e66710@pc33.example.com");
+  pMsg.reset();
+
+  //
+  // Oversized buffers are not kept and the pool never holds more than its capacity
+  //
+  SIPMessage::Ptr pLarge = pool.acquire();
+  std::string large(SIPMessagePool::MAX_RECYCLED_DATA + 1, 'x');
+  pLarge->setData(large.data(), large.size());
+  pLarge.reset();
+  ASSERT_EQ(pool.getStats().available, 0);
+
+  SIPMessage::Ptr a = pool.acquire(), b = pool.acquire(), c = pool.acquire();
+  a.reset(); b.reset(); c.reset();
+  ASSERT_EQ(pool.getStats().available, 2);
+
+  //
+  // Messages may outlive their pool
+  //
+  SIPMessage::Ptr pOrphan;
+  {
+    SIPMessagePool scoped;
+    pOrphan = scoped.acquire();
+  }
+  pOrphan.reset();
+}
+
+TEST(TransportTest, test_overload_control)
+{
+  SIPOverloadControl overload;
+  overload.setDelayBudget(100);
+  overload.setControlInterval(100);
+
+  //
+  // Disabled control admits everything and records nothing
+  //
+  overload.recordQueueDelay(1000, 1);
+  ASSERT_TRUE(overload.admit(1));
+  ASSERT_EQ(overload.getStats().samples, 0);
+
+  overload.setEnabled(true);
+  OSS::UInt64 now = 1000;
+  ASSERT_TRUE(overload.admit(now));
+
+  //
+  // Delay within budget never sheds
+  //
+  for (int i = 0; i < 50; i++)
+  {
+    now += 10;
+    overload.recordQueueDelay(50, now);
+    ASSERT_TRUE(overload.admit(now));
+  }
+  ASSERT_FALSE(overload.isOverloaded());
+
+  //
+  // Twenty offered INVITEs per interval while only ten get processed
+  // and each waits well past the budget
+  //
+  for (int i = 0; i < 20; i++)
+  {
+    now += 10;
+    overload.admit(now);
+    overload.admit(now);
+    overload.recordQueueDelay(400 + i * 10, now);
+  }
+  ASSERT_TRUE(overload.isOverloaded());
+  ASSERT_GE(overload.getReduction(), 50);
+  ASSERT_LE(overload.getReduction(), (unsigned int)SIPOverloadControl::MAX_REDUCTION);
+
+  //
+  // Rejections are spread evenly over arrivals
+  //
+  unsigned int reduction = overload.getReduction();
+  int rejected = 0;
+  for (int i = 0; i < 100; i++)
+  {
+    if (!overload.admit(now))
+      rejected++;
+  }
+  ASSERT_NEAR(rejected, (int)reduction, 1);
+
+  overload.prioritize();
+  SIPOverloadControl::Stats stats = overload.getStats();
+  ASSERT_TRUE(stats.enabled);
+  ASSERT_EQ(stats.prioritized, 1);
+  ASSERT_GT(stats.rejected, 0);
+  ASSERT_GT(stats.averageDelay, 100);
+
+  //
+  // Recovery once the delay is back within budget
+  //
+  for (int i = 0; i < 200; i++)
+  {
+    now += 10;
+    overload.recordQueueDelay(10, now);
+  }
+  ASSERT_FALSE(overload.isOverloaded());
+  ASSERT_TRUE(overload.admit(now));
+
+  //
+  // A depleted worker pool counts as twice the budget
+  //
+  for (int i = 0; i < 20; i++)
+  {
+    now += 10;
+    overload.admit(now);
+    overload.recordDepletion(now);
+  }
+  ASSERT_TRUE(overload.isOverloaded());
+  ASSERT_EQ(overload.getStats().depletions, 20);
+}
+
+//
+// Offered load of new INVITEs against a server that processes one INVITE
+// per millisecond.  Shedding an INVITE costs a tenth of processing it.
+// Goodput counts INVITEs per second that started processing within the
+// deadline, measured after the first second.
+//
+static double simulateOverload(double offeredLoad, bool enabled, OSS::UInt64 seconds)
+{
+  SIPOverloadControl overload;
+  overload.setDelayBudget(50);
+  overload.setEnabled(enabled);
+
+  std::deque<OSS::UInt64> queue;
+  const OSS::UInt64 deadline = 500;
+  double arrivals = 0;
+  double capacity = 0;
+  OSS::UInt64 goodput = 0;
+  for (OSS::UInt64 now = 1; now <= seconds * 1000; now++)
+  {
+    capacity += 1.0;
+    for (arrivals += offeredLoad; arrivals >= 1.0; arrivals -= 1.0)
+    {
+      if (overload.admit(now))
+        queue.push_back(now);
+      else
+        capacity -= 0.1;
+    }
+
+    while (capacity >= 1.0 && !queue.empty())
+    {
+      OSS::UInt64 delay = now - queue.front();
+      queue.pop_front();
+      capacity -= 1.0;
+      overload.recordQueueDelay(delay, now);
+      if (delay <= deadline && now > 1000)
+        goodput++;
+    }
+
+    if (capacity > 1.0)
+      capacity = 1.0;
+  }
+  return (double)goodput / (seconds - 1);
+}
+
+TEST(TransportTest, test_overload_control_load)
+{
+  const OSS::UInt64 seconds = 30;
+  double loads[] = {0.5, 1.0, 1.5, 2.0, 3.0};
+  double controlled[5];
+  double uncontrolled[5];
+  for (int i = 0; i < 5; i++)
+  {
+    controlled[i] = simulateOverload(loads[i], true, seconds);
+    uncontrolled[i] = simulateOverload(loads[i], false, seconds);
+    std::cout << "TransportTest::test_overload_control_load " << loads[i] << "x capacity: goodput "
+      << controlled[i] << "/s with overload control, " << uncontrolled[i] << "/s without" << std::endl;
+  }
+
+  //
+  // Below saturation the control stays out of the way
+  //
+  ASSERT_NEAR(controlled[0], 500, 5);
+  ASSERT_NEAR(controlled[1], 1000, 10);
+
+  //
+  // Past saturation goodput holds while it collapses without control.
+  // At three times capacity shedding alone consumes a fifth of the server.
+  //
+  ASSERT_GT(controlled[2], 850);
+  ASSERT_GT(controlled[3], 800);
+  ASSERT_GT(controlled[4], 650);
+  ASSERT_LT(uncontrolled[3], 100);
+}
+
+static SIPMessage::Ptr createIngressMessage(const std::string& startLine, const std::string& to = "<sip:bob@example.com>", const std::string& branch = "z9hG4bK776asdhds")
+{
+  std::ostringstream msg;
+  msg << startLine << "\r\n"
+    << "Via: SIP/2.0/UDP 192.168.0.10:5060;branch=" << branch << "\r\n"
+    << "From: <sip:alice@example.com>;tag=1928301774\r\n"
+    << "To: " << to << "\r\n"
+    << "Call-ID: a84b4c76e66710@pc33.example.com\r\n"
+    << "CSeq: 314159 INVITE\r\n"
+    << "Content-Length: 0\r\n\r\n";
+  SIPMessage::Ptr pMsg(new SIPMessage());
+  pMsg->setData(msg.str());
+  return pMsg;
+}
+
+TEST(TransportTest, test_ingress_queue_classify)
+{
+  ASSERT_EQ(SIPIngressQueue::classify(createIngressMessage("SIP/2.0 200 OK")), SIPIngressQueue::LANE_RESPONSE);
+  ASSERT_EQ(SIPIngressQueue::classify(createIngressMessage("INVITE sip:bob@example.com SIP/2.0")), SIPIngressQueue::LANE_NEW_INVITE);
+  ASSERT_EQ(SIPIngressQueue::classify(createIngressMessage("INVITE sip:bob@example.com SIP/2.0", "<sip:bob@example.com>;tag=abc")), SIPIngressQueue::LANE_IN_DIALOG);
+  ASSERT_EQ(SIPIngressQueue::classify(createIngressMessage("INVITE sip:bob@example.com SIP/2.0", "<sip:bob@example.com> ; TAG = abc")), SIPIngressQueue::LANE_IN_DIALOG);
+  ASSERT_EQ(SIPIngressQueue::classify(createIngressMessage("INVITE sip:bob@example.com SIP/2.0", "\"tag=\" <sip:bob@example.com>")), SIPIngressQueue::LANE_NEW_INVITE);
+  ASSERT_EQ(SIPIngressQueue::classify(createIngressMessage("BYE sip:bob@example.com SIP/2.0")), SIPIngressQueue::LANE_IN_DIALOG);
+  ASSERT_EQ(SIPIngressQueue::classify(createIngressMessage("ACK sip:bob@example.com SIP/2.0")), SIPIngressQueue::LANE_IN_DIALOG);
+  ASSERT_EQ(SIPIngressQueue::classify(createIngressMessage("CANCEL sip:bob@example.com SIP/2.0")), SIPIngressQueue::LANE_IN_DIALOG);
+  ASSERT_EQ(SIPIngressQueue::classify(createIngressMessage("REGISTER sip:example.com SIP/2.0")), SIPIngressQueue::LANE_BACKGROUND);
+  ASSERT_EQ(SIPIngressQueue::classify(createIngressMessage("OPTIONS sip:example.com SIP/2.0")), SIPIngressQueue::LANE_BACKGROUND);
+  ASSERT_EQ(SIPIngressQueue::classify(createIngressMessage("SUBSCRIBE sip:example.com SIP/2.0")), SIPIngressQueue::LANE_BACKGROUND);
+  ASSERT_EQ(SIPIngressQueue::classify(std::string("garbage")), SIPIngressQueue::LANE_BACKGROUND);
+
+  std::string compact = "INVITE sip:bob@example.com SIP/2.0\r\nt: <sip:bob@example.com>;tag=1\r\n\r\n";
+  ASSERT_EQ(SIPIngressQueue::classify(compact), SIPIngressQueue::LANE_IN_DIALOG);
+}
+
+static std::vector<SIPIngressQueue::Lane> ingressOrder;
+
+static void ingressHandler(const SIPMessage::Ptr& pMsg, const SIPTransportSession::Ptr& pTransport)
+{
+  ingressOrder.push_back(SIPIngressQueue::classify(pMsg));
+}
+
+TEST(TransportTest, test_ingress_queue_weights)
+{
+  SIPIngressQueue queue;
+  queue.setHandler(ingressHandler);
+  queue.setLaneCapacity(SIPIngressQueue::LANE_BACKGROUND, 100);
+  SIPTransportSession::Ptr pTransport;
+
+  //
+  // A REGISTER flood fills the background lane up to its capacity
+  //
+  SIPMessage::Ptr pRegister = createIngressMessage("REGISTER sip:example.com SIP/2.0");
+  for (int i = 0; i < 150; i++)
+  {
+    queue.enqueue(pRegister, pTransport);
+  }
+  SIPIngressQueue::LaneStats stats = queue.getLaneStats(SIPIngressQueue::LANE_BACKGROUND);
+  ASSERT_EQ(stats.depth, 100);
+  ASSERT_EQ(stats.dropped, 50);
+  ASSERT_EQ(stats.highWaterMark, 100);
+
+  SIPMessage::Ptr pBye = createIngressMessage("BYE sip:bob@example.com SIP/2.0");
+  SIPMessage::Ptr pOk = createIngressMessage("SIP/2.0 200 OK");
+  SIPMessage::Ptr pInvite = createIngressMessage("INVITE sip:bob@example.com SIP/2.0");
+  for (int i = 0; i < 12; i++)
+  {
+    queue.enqueue(pBye, pTransport);
+    queue.enqueue(pOk, pTransport);
+    queue.enqueue(pInvite, pTransport);
+  }
+
+  //
+  // The first round serves 8 responses, 6 BYEs, 3 INVITEs and a single REGISTER
+  //
+  ingressOrder.clear();
+  for (int i = 0; i < 18; i++)
+  {
+    ASSERT_TRUE(queue.dispatchOne());
+  }
+  ASSERT_EQ(std::count(ingressOrder.begin(), ingressOrder.end(), SIPIngressQueue::LANE_RESPONSE), 8);
+  ASSERT_EQ(std::count(ingressOrder.begin(), ingressOrder.end(), SIPIngressQueue::LANE_IN_DIALOG), 6);
+  ASSERT_EQ(std::count(ingressOrder.begin(), ingressOrder.end(), SIPIngressQueue::LANE_NEW_INVITE), 3);
+  ASSERT_EQ(std::count(ingressOrder.begin(), ingressOrder.end(), SIPIngressQueue::LANE_BACKGROUND), 1);
+  ASSERT_EQ(ingressOrder.front(), SIPIngressQueue::LANE_RESPONSE);
+
+  //
+  // Once the other lanes are drained the background lane gets every slot
+  //
+  while (queue.dispatchOne());
+  ASSERT_EQ(queue.getLaneStats(SIPIngressQueue::LANE_BACKGROUND).dispatched, 100);
+  ASSERT_EQ(queue.getLaneStats(SIPIngressQueue::LANE_RESPONSE).dispatched, 12);
+  ASSERT_EQ(queue.getLaneStats(SIPIngressQueue::LANE_IN_DIALOG).depth, 0);
+  ASSERT_FALSE(queue.dispatchOne());
+}
+
+static std::vector<std::string> ingressMethods;
+
+static void ingressMethodHandler(const SIPMessage::Ptr& pMsg, const SIPTransportSession::Ptr& pTransport)
+{
+  const std::string& data = pMsg->data();
+  ingressMethods.push_back(data.substr(0, data.find(' ')));
+}
+
+TEST(TransportTest, test_ingress_queue_cancel_follows_invite)
+{
+  SIPIngressQueue queue;
+  queue.setHandler(ingressMethodHandler);
+  SIPTransportSession::Ptr pTransport;
+
+  //
+  // The CANCEL and the ACK for a non-2xx response share the branch of the
+  // queued INVITE and must not overtake it.  The ACK for a 2xx response
+  // and the BYE keep the in-dialog lane.
+  //
+  queue.enqueue(createIngressMessage("INVITE sip:bob@example.com SIP/2.0"), pTransport);
+  queue.enqueue(createIngressMessage("CANCEL sip:bob@example.com SIP/2.0"), pTransport);
+  queue.enqueue(createIngressMessage("ACK sip:bob@example.com SIP/2.0", "<sip:bob@example.com>;tag=abc"), pTransport);
+  queue.enqueue(createIngressMessage("ACK sip:bob@example.com SIP/2.0", "<sip:bob@example.com>;tag=abc", "z9hG4bKnashds8"), pTransport);
+  queue.enqueue(createIngressMessage("BYE sip:bob@example.com SIP/2.0", "<sip:bob@example.com>;tag=abc", "z9hG4bK776asdhds"), pTransport);
+  ASSERT_EQ(queue.getLaneStats(SIPIngressQueue::LANE_NEW_INVITE).depth, 3);
+  ASSERT_EQ(queue.getLaneStats(SIPIngressQueue::LANE_IN_DIALOG).depth, 2);
+
+  ingressMethods.clear();
+  while (queue.dispatchOne());
+  ASSERT_EQ(ingressMethods.size(), (std::size_t)5);
+  ASSERT_EQ(ingressMethods[0], "ACK");
+  ASSERT_EQ(ingressMethods[1], "BYE");
+  ASSERT_EQ(ingressMethods[2], "INVITE");
+  ASSERT_EQ(ingressMethods[3], "CANCEL");
+  ASSERT_EQ(ingressMethods[4], "ACK");
+
+  //
+  // Once the INVITE is dispatched a late CANCEL goes back to the in-dialog lane
+  //
+  queue.enqueue(createIngressMessage("CANCEL sip:bob@example.com SIP/2.0"), pTransport);
+  ASSERT_EQ(queue.getLaneStats(SIPIngressQueue::LANE_IN_DIALOG).depth, 1);
+  ASSERT_EQ(queue.getLaneStats(SIPIngressQueue::LANE_NEW_INVITE).depth, 0);
+}
+
+static OSS::mutex_critic_sec ingressCallMutex;
+static std::map<std::string, int> ingressCallState; /// 1 while the INVITE runs, 2 once it is done
+static int ingressEarlyCancels = 0;
+static int ingressCancels = 0;
+static OSS::semaphore ingressCallsDone;
+
+static void ingressCallOrderHandler(const SIPMessage::Ptr& pMsg, const SIPTransportSession::Ptr& pTransport)
+{
+  const std::string& data = pMsg->data();
+  std::size_t start = data.find("Call-ID: ") + 9;
+  std::string callId = data.substr(start, data.find('\r', start) - start);
+  bool isInvite = data.compare(0, 7, "INVITE ") == 0;
+
+  if (isInvite)
+  {
+    do
+    {
+      OSS::mutex_critic_sec_lock lock(ingressCallMutex);
+      ingressCallState[callId] = 1;
+    } while (false);
+    boost::this_thread::sleep(boost::posix_time::milliseconds(2));
+  }
+
+  OSS::mutex_critic_sec_lock lock(ingressCallMutex);
+  if (isInvite)
+  {
+    ingressCallState[callId] = 2;
+  }
+  else
+  {
+    if (ingressCallState[callId] != 2)
+    {
+      ingressEarlyCancels++;
+    }
+    if (++ingressCancels == 50)
+    {
+      ingressCallsDone.set();
+    }
+  }
+}
+
+TEST(TransportTest, test_ingress_queue_call_order)
+{
+  SIPIngressQueue queue;
+  queue.setHandler(ingressCallOrderHandler);
+  queue.start(4);
+  SIPTransportSession::Ptr pTransport;
+
+  //
+  // With several workers a CANCEL must still wait for its INVITE to finish
+  //
+  for (int i = 0; i < 50; i++)
+  {
+    for (int j = 0; j < 2; j++)
+    {
+      std::ostringstream msg;
+      msg << (j ? "CANCEL" : "INVITE") << " sip:bob@example.com SIP/2.0\r\n"
+        << "Via: SIP/2.0/UDP 192.168.0.10:5060;branch=z9hG4bK-call-" << i << "\r\n"
+        << "To: <sip:bob@example.com>\r\n"
+        << "Call-ID: call-" << i << "\r\n"
+        << "Content-Length: 0\r\n\r\n";
+      SIPMessage::Ptr pMsg(new SIPMessage());
+      pMsg->setData(msg.str());
+      ASSERT_TRUE(queue.enqueue(pMsg, pTransport));
+    }
+  }
+  ASSERT_TRUE(ingressCallsDone.tryWait(10000));
+  queue.stop();
+  ASSERT_EQ(ingressEarlyCancels, 0);
+}
+
+static OSS::semaphore ingressDone;
+static volatile int ingressHandled = 0;
+
+static void ingressThreadHandler(const SIPMessage::Ptr& pMsg, const SIPTransportSession::Ptr& pTransport)
+{
+  if (__sync_add_and_fetch(&ingressHandled, 1) == 1000)
+  {
+    ingressDone.set();
+  }
+}
+
+TEST(TransportTest, test_ingress_queue_threads)
+{
+  SIPIngressQueue queue;
+  queue.setHandler(ingressThreadHandler);
+  queue.start(4);
+  ASSERT_TRUE(queue.isRunning());
+
+  SIPTransportSession::Ptr pTransport;
+  SIPMessage::Ptr pOk = createIngressMessage("SIP/2.0 200 OK");
+  SIPMessage::Ptr pRegister = createIngressMessage("REGISTER sip:example.com SIP/2.0");
+  for (int i = 0; i < 500; i++)
+  {
+    ASSERT_TRUE(queue.enqueue(pOk, pTransport));
+    ASSERT_TRUE(queue.enqueue(pRegister, pTransport));
+  }
+  ASSERT_TRUE(ingressDone.tryWait(5000));
+  queue.stop();
+  ASSERT_FALSE(queue.isRunning());
+
+  SIPIngressQueue::LaneStats stats = queue.getLaneStats(SIPIngressQueue::LANE_RESPONSE);
+  ASSERT_EQ(stats.dispatched, 500);
+  ASSERT_GE(stats.maxWait, stats.averageWait);
+  std::cout << "TransportTest::test_ingress_queue_threads response lane average wait " << stats.averageWait
+    << " ms, background lane average wait " << queue.getLaneStats(SIPIngressQueue::LANE_BACKGROUND).averageWait
+    << " ms" << std::endl;
+}
@@ -20,6 +20,9 @@
 
 #include "gtest/gtest.h"
 #include "OSS/SIP/SIPWebSocketListener.h"
+#if ENABLE_FEATURE_WEBSOCKETS
+#include "OSS/websocketpp/processors/permessage_deflate.hpp"
+#endif
 
 using namespace OSS;
 using namespace OSS::SIP;
@@ -32,4 +35,88 @@ TEST(SipTransportTest, test_websocket_listen)
   listener.run();
   OSS::thread_sleep(1000);
 #endif
-}
\ No newline at end of file
+}
+#if ENABLE_FEATURE_WEBSOCKETS
+TEST(SipTransportTest, test_websocket_permessage_deflate)
+{
+  using websocketpp::processor::deflate_config;
+  using websocketpp::processor::permessage_deflate;
+
+  deflate_config config;
+  config.enabled = true;
+
+  permessage_deflate client;
+  permessage_deflate server;
+
+  std::vector<std::string> offers;
+  permessage_deflate::parse_header("x-webkit-deflate-frame, " + client.offer(config), offers);
+  ASSERT_EQ(offers.size(), 2);
+
+  std::string response;
+  ASSERT_TRUE(server.negotiate(offers, config, response));
+  ASSERT_EQ(response, "permessage-deflate");
+  ASSERT_TRUE(client.accept(response));
+
+  std::string sdp =
+    "v=0\r\n"
+    "o=- 4611731400430051336 2 IN IP4 127.0.0.1\r\n"
+    "s=-\r\n"
+    "t=0 0\r\n"
+    "m=audio 9 UDP/TLS/RTP/SAVPF 111 0 8\r\n"
+    "a=candidate:842163049 1 udp 1677729535 203.0.113.10 53962 typ srflx raddr 192.168.1.10 rport 53962 generation 0\r\n"
+    "a=candidate:3098175849 1 udp 2122260223 192.168.1.10 53962 typ host generation 0\r\n"
+    "a=ice-ufrag:Xo3t\r\n"
+    "a=ice-pwd:FtcbBaLZQ1mXhxFhtTzr6M2c\r\n"
+    "a=rtpmap:111 opus/48000/2\r\n";
+
+  std::string compressed;
+  std::string inflated;
+  std::size_t firstSize = 0;
+  for (int i = 0; i < 3; i++)
+  {
+    ASSERT_TRUE(client.compress(sdp, compressed));
+    ASSERT_LT(compressed.size(), sdp.size());
+    if (i == 0)
+      firstSize = compressed.size();
+    else
+      ASSERT_LT(compressed.size(), firstSize / 4); // context takeover at work
+
+    server.decompress(compressed, inflated);
+    ASSERT_EQ(inflated, sdp);
+  }
+
+  //
+  // Without context takeover every message stands alone
+  //
+  config.context_takeover = false;
+  permessage_deflate isolatedClient;
+  permessage_deflate isolatedServer;
+  offers.clear();
+  permessage_deflate::parse_header(isolatedClient.offer(config), offers);
+  ASSERT_TRUE(isolatedServer.negotiate(offers, config, response));
+  ASSERT_EQ(response, "permessage-deflate; server_no_context_takeover; client_no_context_takeover");
+  ASSERT_TRUE(isolatedClient.accept(response));
+  for (int i = 0; i < 2; i++)
+  {
+    ASSERT_TRUE(isolatedClient.compress(sdp, compressed));
+    ASSERT_EQ(compressed.size(), firstSize);
+    isolatedServer.decompress(compressed, inflated);
+    ASSERT_EQ(inflated, sdp);
+  }
+
+  //
+  // Offers we can't honour are skipped
+  //
+  offers.clear();
+  offers.push_back("permessage-deflate; server_max_window_bits=8");
+  offers.push_back("permessage-deflate; unknown_param");
+  permessage_deflate rejecting;
+  ASSERT_FALSE(rejecting.negotiate(offers, config, response));
+  ASSERT_FALSE(rejecting.is_active());
+
+  //
+  // Garbage is reported as a payload violation
+  //
+  ASSERT_THROW(server.decompress(std::string("\xff\xff\xff\xff", 4), inflated), websocketpp::processor::exception);
+}
+#endif
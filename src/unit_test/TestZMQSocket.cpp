@@ -4,6 +4,7 @@
 #if ENABLE_FEATURE_ZMQ
 
 #include "OSS/ZMQ/ZMQSocket.h"
+#include "OSS/ZMQ/ZMQPoller.h"
 #include "OSS/SIP/SIPTransportService.h" 
 
 using namespace OSS::ZMQ;
@@ -101,6 +102,118 @@ TEST(ZMQ, test_zmq_send_and_receive_inproc)
   }
 }
 
+
+static void count_requests(std::size_t& count, ZMQSocket::Message& cmd, ZMQSocket::Message& data)
+{
+  ASSERT_EQ(cmd.size(), 4);
+  ASSERT_EQ(data.size(), sizeof(count));
+  std::size_t index;
+  memcpy(&index, data.data(), sizeof(index));
+  ASSERT_EQ(index, count);
+  count++;
+}
+
+TEST(ZMQ, test_zmq_multipart_zero_copy)
+{
+  ZMQSocket push(ZMQSocket::PUSH);
+  ZMQSocket pull(ZMQSocket::PULL, false);
+  
+  ASSERT_TRUE(pull.bind("inproc://multipart"));
+  ASSERT_TRUE(push.connect("inproc://multipart"));
+  
+  //
+  // inproc hands the message itself to the peer so a buffer given to ZMQ
+  // without a copy arrives at the same address
+  //
+  std::string header("header");
+  std::string body(64 * 1024, 'x');
+  const char* bodyData = body.data();
+  ZMQSocket::Message parts[3];
+  ZMQSocket::moveToMessage(header, parts[0]);
+  ZMQSocket::moveToMessage(body, parts[1]);
+  ASSERT_TRUE(body.empty());
+  ASSERT_TRUE(push.sendMultipart(parts, 3));
+  
+  ZMQSocket::Message received[2];
+  ASSERT_EQ(pull.receiveMultipart(received, 2, 1000), 2);
+  ASSERT_EQ(std::string((const char*)received[0].data(), received[0].size()), "header");
+  ASSERT_EQ(received[1].size(), 64 * 1024);
+  ASSERT_TRUE(received[1].data() == bodyData);
+  
+  //
+  // Non blocking receive and batched drain
+  //
+  ZMQSocket::Message cmd;
+  ZMQSocket::Message data;
+  ASSERT_FALSE(pull.tryReceiveRequest(cmd, data));
+  
+  for (std::size_t i = 0; i < 100; i++)
+  {
+    ZMQSocket::Message message(sizeof(i));
+    memcpy(message.data(), &i, sizeof(i));
+    ASSERT_TRUE(push.sendRequest("test", message));
+  }
+  
+  std::size_t count = 0;
+  ASSERT_EQ(pull.receiveRequests(boost::bind(count_requests, boost::ref(count), _1, _2), 60), 60);
+  ASSERT_EQ(count, 60);
+  ASSERT_TRUE(pull.tryReceiveRequest(cmd, data));
+  count++;
+  ASSERT_EQ(pull.receiveRequests(boost::bind(count_requests, boost::ref(count), _1, _2), 1000), 39);
+  ASSERT_EQ(count, 100);
+  ASSERT_EQ(pull.receiveRequests(boost::bind(count_requests, boost::ref(count), _1, _2), 1000), 0);
+}
+
+static void send_requests(ZMQSocket& socket, std::size_t first, std::size_t last)
+{
+  for (std::size_t i = first; i < last; i++)
+  {
+    ZMQSocket::Message message(sizeof(i));
+    memcpy(message.data(), &i, sizeof(i));
+    socket.sendRequest("test", message);
+  }
+}
+
+static void drain_requests(ZMQSocket& socket, std::size_t& count, std::size_t expected, boost::asio::io_service& ioService)
+{
+  socket.receiveRequests(boost::bind(count_requests, boost::ref(count), _1, _2), 16);
+  if (count == expected)
+  {
+    ioService.stop();
+  }
+}
+
+TEST(ZMQ, test_zmq_asio_poller)
+{
+  const std::size_t MESSAGE_COUNT = 10000;
+  
+  ZMQSocket push(ZMQSocket::PUSH);
+  ZMQSocket pull(ZMQSocket::PULL, false);
+  ASSERT_TRUE(pull.bind("inproc://poller"));
+  ASSERT_TRUE(push.connect("inproc://poller"));
+  
+  //
+  // Queued before the watch starts
+  //
+  send_requests(push, 0, 10);
+  
+  boost::asio::io_service ioService;
+  ZMQPoller poller(ioService);
+  std::size_t count = 0;
+  ASSERT_TRUE(poller.watch(pull, boost::bind(drain_requests, boost::ref(pull), boost::ref(count), MESSAGE_COUNT, boost::ref(ioService))));
+  ASSERT_FALSE(poller.watch(pull, boost::bind(drain_requests, boost::ref(pull), boost::ref(count), MESSAGE_COUNT, boost::ref(ioService))));
+  
+  boost::thread producer(boost::bind(send_requests, boost::ref(push), 10, MESSAGE_COUNT));
+  
+  boost::asio::deadline_timer timeout(ioService, boost::posix_time::seconds(10));
+  timeout.async_wait(boost::bind(&boost::asio::io_service::stop, &ioService));
+  ioService.run();
+  producer.join();
+  
+  ASSERT_EQ(count, MESSAGE_COUNT);
+  poller.unwatch(pull);
+}
+
 #else
 
 TEST(NullTest, null_test_zmq_pub_sub){}
@@ -0,0 +1,282 @@
+// Library: OSS_CORE - Foundation API for SIP B2BUA
+// Copyright (c) OSS Software Solutions
+// Contributor: Joegen Baclor - mailto:joegen@ossapp.com
+//
+// Permission is hereby granted, to any person or organization
+// obtaining a copy of the software and accompanying documentation covered by
+// this license (the "Software") to use, execute, and to prepare
+// derivative works of the Software, all subject to the
+// "GNU Lesser General Public License (LGPL)".
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+// SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+// FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+
+
+#include <sstream>
+#include <boost/bind.hpp>
+
+#include "OSS/UTL/LogAsyncSink.h"
+
+
+namespace OSS {
+namespace UTL {
+
+
+static const int WRITER_IDLE_WAIT = 100; /// Upper bound in ms for a missed wakeup
+
+
+LogAsyncSink::LogAsyncSink(const BatchWriter& writer, std::size_t capacity) :
+  _writer(writer),
+  _capacity(2),
+  _mask(1),
+  _highWaterMark(1),
+  _cells(0),
+  _enqueuePos(0),
+  _dequeuePos(0),
+  _writtenPos(0),
+  _dropped(0),
+  _reportedDrops(0),
+  _writerIdle(0),
+  _isRunning(false),
+  _pThread(0)
+{
+  while (_capacity < capacity)
+  {
+    _capacity <<= 1;
+  }
+  _mask = _capacity - 1;
+  _highWaterMark = _capacity - (_capacity / 4);
+
+  _cells = new Cell[_capacity];
+  for (std::size_t i = 0; i < _capacity; i++)
+  {
+    _cells[i].sequence = i;
+  }
+
+  //
+  // One extra slot for the dropped records notification
+  //
+  _batch.resize(DEFAULT_BATCH_SIZE + 1);
+}
+
+LogAsyncSink::~LogAsyncSink()
+{
+  stop();
+  delete [] _cells;
+}
+
+void LogAsyncSink::start()
+{
+  boost::mutex::scoped_lock lock(_runMutex);
+  if (_pThread)
+  {
+    return;
+  }
+  _isRunning = true;
+  _pThread = new boost::thread(boost::bind(&LogAsyncSink::run, this));
+}
+
+void LogAsyncSink::stop()
+{
+  boost::mutex::scoped_lock lock(_runMutex);
+  if (!_pThread)
+  {
+    return;
+  }
+  _isRunning = false;
+  __sync_synchronize();
+  _wakeup.signal();
+  _pThread->join();
+  delete _pThread;
+  _pThread = 0;
+}
+
+bool LogAsyncSink::enqueue(int priority, const std::string& text)
+{
+  std::size_t pos = _enqueuePos;
+  Cell* cell = 0;
+
+  for (;;)
+  {
+    cell = &_cells[pos & _mask];
+    std::size_t sequence = cell->sequence;
+    __sync_synchronize();
+    long diff = static_cast<long>(sequence) - static_cast<long>(pos);
+
+    if (diff == 0)
+    {
+      //
+      // Shed the chatty levels first once we are past the high water mark
+      //
+      if (priority > DROP_PRIORITY && pos - _dequeuePos >= _highWaterMark)
+      {
+        __sync_fetch_and_add(&_dropped, 1);
+        return false;
+      }
+
+      if (__sync_bool_compare_and_swap(&_enqueuePos, pos, pos + 1))
+      {
+        break;
+      }
+      pos = _enqueuePos;
+    }
+    else if (diff < 0)
+    {
+      //
+      // The ring is full
+      //
+      __sync_fetch_and_add(&_dropped, 1);
+      wakeup();
+      return false;
+    }
+    else
+    {
+      pos = _enqueuePos;
+    }
+  }
+
+  cell->record.priority = priority;
+  cell->record.text = text;
+  __sync_synchronize();
+  cell->sequence = pos + 1;
+
+  wakeup();
+  return true;
+}
+
+bool LogAsyncSink::dequeue(Record& record)
+{
+  //
+  // Only the writer thread calls this so _dequeuePos needs no CAS
+  //
+  std::size_t pos = _dequeuePos;
+  Cell* cell = &_cells[pos & _mask];
+  std::size_t sequence = cell->sequence;
+  __sync_synchronize();
+
+  if (sequence != pos + 1)
+  {
+    //
+    // Either empty or the producer has claimed the slot but has
+    // not published it yet
+    //
+    return false;
+  }
+
+  record.priority = cell->record.priority;
+  record.text.swap(cell->record.text);
+  cell->record.text.clear();
+  _dequeuePos = pos + 1;
+  __sync_synchronize();
+  cell->sequence = pos + _capacity;
+  return true;
+}
+
+void LogAsyncSink::wakeup()
+{
+  //
+  // Only pay for the condition variable when the writer is actually asleep.
+  // The fence orders our publish against the read of the idle flag.
+  //
+  __sync_synchronize();
+  if (_writerIdle && __sync_bool_compare_and_swap(&_writerIdle, 1, 0))
+  {
+    _wakeup.signal();
+  }
+}
+
+void LogAsyncSink::writeBatch(std::size_t count)
+{
+  std::size_t dropped = _dropped;
+  if (dropped != _reportedDrops)
+  {
+    std::ostringstream strm;
+    strm << "LogAsyncSink dropped " << dropped - _reportedDrops << " log record(s) due to overload";
+    _batch[count].priority = DROP_PRIORITY;
+    _batch[count].text = strm.str();
+    _reportedDrops = dropped;
+    ++count;
+  }
+
+  if (count && _writer)
+  {
+    try
+    {
+      _writer(&_batch[0], count);
+    }
+    catch(...)
+    {
+      //
+      // Never let a bad channel kill the writer thread
+      //
+    }
+  }
+}
+
+void LogAsyncSink::run()
+{
+  for (;;)
+  {
+    std::size_t count = 0;
+    while (count < DEFAULT_BATCH_SIZE && dequeue(_batch[count]))
+    {
+      ++count;
+    }
+
+    writeBatch(count);
+    if (count)
+    {
+      __sync_fetch_and_add(&_writtenPos, count);
+    }
+
+    if (count == DEFAULT_BATCH_SIZE)
+    {
+      continue;
+    }
+
+    if (!_isRunning)
+    {
+      //
+      // Drain anything published after we read the running flag
+      //
+      if (_cells[_dequeuePos & _mask].sequence == _dequeuePos + 1)
+      {
+        continue;
+      }
+      break;
+    }
+
+    //
+    // Announce that we are going to sleep and check the queue one more time
+    // so a producer that published after our last dequeue is not missed
+    //
+    _writerIdle = 1;
+    __sync_synchronize();
+    if (_cells[_dequeuePos & _mask].sequence == _dequeuePos + 1 || !_isRunning)
+    {
+      _writerIdle = 0;
+      continue;
+    }
+    _wakeup.wait(WRITER_IDLE_WAIT);
+    _writerIdle = 0;
+  }
+}
+
+void LogAsyncSink::flush()
+{
+  std::size_t target = _enqueuePos;
+  while (_isRunning && _writtenPos < target)
+  {
+    wakeup();
+    boost::this_thread::sleep(boost::posix_time::milliseconds(1));
+  }
+}
+
+
+} } // OSS::UTL
@@ -19,6 +19,7 @@
 
 
 #include <boost/thread.hpp>
+#include <boost/bind.hpp>
 #include "Poco/AutoPtr.h"
 #include "Poco/ConsoleChannel.h"
 #include "Poco/SplitterChannel.h"
@@ -136,6 +137,12 @@ namespace UTL {
 
   LogFile::~LogFile()
   {
+    //
+    // Stop the writer thread first.  It drains the queue and needs the
+    // channel to still be open.
+    //
+    enableAsync(false);
+
     //
     // Grab the mutex before calling close to make sure we do not corrupt
     // any pointers within the current executing log message
@@ -266,6 +273,11 @@ namespace UTL {
 
   void LogFile::fatal(const std::string& log)
   {
+    if (enqueue(PRIO_FATAL, log))
+    {
+      return;
+    }
+
     //
     // We need to make this thread safe or calls from 
     // different thread might try to reopen the logger
@@ -287,6 +299,11 @@ namespace UTL {
 
   void LogFile::critical(const std::string& log)
   {
+    if (enqueue(PRIO_CRITICAL, log))
+    {
+      return;
+    }
+
     //
     // We need to make this thread safe or calls from 
     // different thread might try to reopen the logger
@@ -308,6 +325,11 @@ namespace UTL {
 
   void LogFile::error(const std::string& log)
   {
+    if (enqueue(PRIO_ERROR, log))
+    {
+      return;
+    }
+
     //
     // We need to make this thread safe or calls from 
     // different thread might try to reopen the logger
@@ -329,6 +351,11 @@ namespace UTL {
 
   void LogFile::warning(const std::string& log)
   {
+    if (enqueue(PRIO_WARNING, log))
+    {
+      return;
+    }
+
     //
     // We need to make this thread safe or calls from 
     // different thread might try to reopen the logger
@@ -350,6 +377,11 @@ namespace UTL {
 
   void LogFile::notice(const std::string& log)
   {
+    if (enqueue(PRIO_NOTICE, log))
+    {
+      return;
+    }
+
     //
     // We need to make this thread safe or calls from 
     // different thread might try to reopen the logger
@@ -371,6 +403,11 @@ namespace UTL {
 
   void LogFile::information(const std::string& log)
   {
+    if (enqueue(PRIO_INFORMATION, log))
+    {
+      return;
+    }
+
     //
     // We need to make this thread safe or calls from 
     // different thread might try to reopen the logger
@@ -392,6 +429,11 @@ namespace UTL {
 
   void LogFile::debug(const std::string& log)
   {
+    if (enqueue(PRIO_DEBUG, log))
+    {
+      return;
+    }
+
     //
     // We need to make this thread safe or calls from 
     // different thread might try to reopen the logger
@@ -413,6 +455,11 @@ namespace UTL {
 
   void LogFile::trace(const std::string& log)
   {
+    if (enqueue(PRIO_TRACE, log))
+    {
+      return;
+    }
+
     //
     // We need to make this thread safe or calls from 
     // different thread might try to reopen the logger
@@ -432,6 +479,86 @@ namespace UTL {
     }
   }
   
+  void LogFile::enableAsync(bool enable, std::size_t capacity)
+  {
+    if (enable && !boost::atomic_load(&_pAsyncSink))
+    {
+      LogAsyncSink::Ptr pSink(new LogAsyncSink(boost::bind(&LogFile::writeBatch, this, _1, _2), capacity));
+      pSink->start();
+      boost::atomic_store(&_pAsyncSink, pSink);
+    }
+    else if (!enable)
+    {
+      //
+      // Unpublish first, then stop the writer.  A producer still inside
+      // enqueue() holds its own reference so the sink is only freed after
+      // it returns.  The writer is joined here so writeBatch() never runs
+      // after this call, even if a producer ends up releasing the sink.
+      //
+      LogAsyncSink::Ptr pSink = boost::atomic_exchange(&_pAsyncSink, LogAsyncSink::Ptr());
+      if (pSink)
+      {
+        pSink->stop();
+      }
+    }
+  }
+
+  void LogFile::flush()
+  {
+    LogAsyncSink::Ptr pSink = boost::atomic_load(&_pAsyncSink);
+    if (pSink)
+    {
+      pSink->flush();
+    }
+  }
+
+  std::size_t LogFile::getDroppedCount() const
+  {
+    LogAsyncSink::Ptr pSink = boost::atomic_load(&_pAsyncSink);
+    return pSink ? pSink->getDroppedCount() : 0;
+  }
+
+  bool LogFile::enqueue(Priority priority, const std::string& log)
+  {
+    LogAsyncSink::Ptr pSink = boost::atomic_load(&_pAsyncSink);
+    if (!pSink)
+    {
+      return false;
+    }
+
+    if (willLog(priority))
+    {
+      pSink->enqueue(priority, log);
+    }
+    return true;
+  }
+
+  void LogFile::writeBatch(const LogAsyncSink::Record* records, std::size_t count)
+  {
+    //
+    // Verification and rotation happen once per batch here in the writer
+    // thread rather than once per record in the caller's thread
+    //
+    mutex_lock lock(_mutex);
+
+    if (!(_enableVerification ? verifyLogFile(false) : isOpen()))
+    {
+      return;
+    }
+
+    Poco::Logger* pLogFile = Poco::Logger::has(_internalName);
+    if (!pLogFile)
+    {
+      return;
+    }
+
+    for (std::size_t i = 0; i < count; i++)
+    {
+      pLogFile->log(Poco::Message(_internalName, records[i].text,
+        poco_priority(static_cast<Priority>(records[i].priority))));
+    }
+  }
+
   bool LogFile::verifyLogFile(bool force)
   {    
     if (!_isOpen)
@@ -32,6 +32,7 @@
 #include "OSS/UTL/Logger.h"
 #include "OSS/UTL/CoreUtils.h"
 #include "OSS/UTL/Thread.h"
+#include "OSS/UTL/LogAsyncSink.h"
 
 
 using Poco::AutoPtr;
@@ -56,6 +57,8 @@ static OSS::mutex_critic_sec _consoleMutex;
 static bool _enableConsoleLogging = true;
 static bool _enableLogging = true;
 static LogPriority _consoleLogLevel = PRIO_INFORMATION;
+static LogPriority _fileLogLevel = PRIO_INFORMATION;
+static OSS::UTL::LogAsyncSink::Ptr _pAsyncSink;
   /*
 enum LogPriority
 {
@@ -79,6 +82,82 @@ void log_enable_logging(bool yes)
   _enableLogging = yes;
 }
 
+static void log_write_batch(const OSS::UTL::LogAsyncSink::Record* records, std::size_t count)
+{
+  //
+  // Called from the writer thread only.  Poco's FileChannel takes care of
+  // rotation and purging as the records go through.
+  //
+  if (!_pLogger)
+    return;
+
+  for (std::size_t i = 0; i < count; i++)
+  {
+    _pLogger->log(Message(_pLogger->name(), records[i].text, static_cast<Message::Priority>(records[i].priority)));
+  }
+}
+
+static bool log_async(LogPriority priority, const std::string& log)
+{
+  //
+  // Hold our own reference so log_enable_async(false) cannot free the sink
+  // while we are still enqueuing into it
+  //
+  OSS::UTL::LogAsyncSink::Ptr pSink = boost::atomic_load(&_pAsyncSink);
+  if (!pSink || !_pLogger)
+    return false;
+
+  if (priority <= _fileLogLevel)
+    pSink->enqueue(priority, log);
+
+  return true;
+}
+
+void log_enable_async(bool yes, std::size_t capacity)
+{
+  if (yes && !boost::atomic_load(&_pAsyncSink))
+  {
+    OSS::UTL::LogAsyncSink::Ptr pSink(new OSS::UTL::LogAsyncSink(log_write_batch, capacity));
+    pSink->start();
+    boost::atomic_store(&_pAsyncSink, pSink);
+  }
+  else if (!yes)
+  {
+    //
+    // Unpublish first, then stop the writer.  A producer that loaded the
+    // sink before the exchange keeps it alive until its enqueue returns.
+    // Records it queues after stop() are discarded with the sink.
+    //
+    OSS::UTL::LogAsyncSink::Ptr pSink = boost::atomic_exchange(&_pAsyncSink, OSS::UTL::LogAsyncSink::Ptr());
+    if (pSink)
+      pSink->stop();
+  }
+}
+
+void log_flush()
+{
+  OSS::UTL::LogAsyncSink::Ptr pSink = boost::atomic_load(&_pAsyncSink);
+  if (pSink)
+    pSink->flush();
+}
+
+std::size_t log_get_dropped_count()
+{
+  OSS::UTL::LogAsyncSink::Ptr pSink = boost::atomic_load(&_pAsyncSink);
+  return pSink ? pSink->getDroppedCount() : 0;
+}
+
+bool log_will_log(LogPriority priority)
+{
+  if (!_enableLogging)
+    return false;
+
+  if (_pLogger)
+    return priority <= _fileLogLevel;
+
+  return _enableConsoleLogging && priority <= _consoleLogLevel;
+}
+
 void logger_init(
   const std::string& path,
   LogPriority level,
@@ -108,11 +187,13 @@ void logger_init(
     AutoPtr<Formatter> formatter(new PatternFormatter(format.c_str()));
     AutoPtr<Channel> formattingChannel(new FormattingChannel(formatter, rotatedFileChannel));
     _pLogger = &(Logger::create("OSS.logger", formattingChannel, level));
+    _fileLogLevel = level;
   }
 }
 
 void logger_deinit()
 {
+  log_enable_async(false);
   if (_pLogger)
     _pLogger->destroy("OSS.logger");
 }
@@ -125,6 +206,7 @@ void log_reset_level(LogPriority level)
   if (_pLogger)
     _pLogger->setLevel(level);
 
+  _fileLogLevel = level;
   _consoleLogLevel = level;
 }
 
@@ -195,6 +277,9 @@ void log_fatal(const std::string& log)
     return;
   }
   
+  if (log_async(PRIO_FATAL, log))
+    return;
+
   if (_pLogger)
     _pLogger->fatal(log);
 }
@@ -212,6 +297,9 @@ void log_critical(const std::string& log)
     return;
   }
 
+  if (log_async(PRIO_CRITICAL, log))
+    return;
+
   if (_pLogger)
     _pLogger->critical(log);
 }
@@ -229,6 +317,9 @@ void log_error(const std::string& log)
     return;
   }
   
+  if (log_async(PRIO_ERROR, log))
+    return;
+
   if (_pLogger)
     _pLogger->error(log);
 }
@@ -246,6 +337,9 @@ void log_warning(const std::string& log)
     return;
   }
   
+  if (log_async(PRIO_WARNING, log))
+    return;
+
   if (_pLogger)
     _pLogger->warning(log);
 }
@@ -263,6 +357,9 @@ void log_notice(const std::string& log)
     return;
   }
 
+  if (log_async(PRIO_NOTICE, log))
+    return;
+
   if (_pLogger)
     _pLogger->notice(log);
 }
@@ -280,6 +377,9 @@ void log_information(const std::string& log)
     return;
   }
   
+  if (log_async(PRIO_INFORMATION, log))
+    return;
+
   if (_pLogger)
     _pLogger->information(log);
 }
@@ -297,6 +397,9 @@ void log_debug(const std::string& log)
     return;
   }
   
+  if (log_async(PRIO_DEBUG, log))
+    return;
+
   if (_pLogger)
     _pLogger->debug(log);
 }
@@ -314,6 +417,9 @@ void log_trace(const std::string& log)
     return;
   }
   
+  if (log_async(PRIO_TRACE, log))
+    return;
+
   if (_pLogger)
     _pLogger->trace(log);
 }
@@ -0,0 +1,179 @@
+// Library: OSS_CORE - Foundation API for SIP B2BUA
+// Copyright (c) OSS Software Solutions
+// Contributor: Joegen Baclor - mailto:joegen@ossapp.com
+//
+// Permission is hereby granted, to any person or organization
+// obtaining a copy of the software and accompanying documentation covered by
+// this license (the "Software") to use, execute, and to prepare
+// derivative works of the Software, all subject to the
+// "GNU Lesser General Public License (LGPL)".
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+// SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+// FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+
+
+#include "OSS/ZMQ/ZMQPoller.h"
+#include "OSS/UTL/Logger.h"
+
+#if ENABLE_FEATURE_ZMQ && OSS_HAVE_ZMQ
+
+#include <boost/bind.hpp>
+
+namespace OSS {
+namespace ZMQ {
+
+
+ZMQPoller::Watch::Watch(boost::asio::io_service& ioService, ZMQSocket& socket, int fd, const ReadHandler& handler) :
+  _ioService(ioService),
+  _socket(socket),
+  _descriptor(ioService, fd),
+  _handler(handler),
+  _isActive(true)
+{
+}
+
+void ZMQPoller::Watch::start()
+{
+  //
+  // Messages queued before the watch started never signal the descriptor
+  //
+  _ioService.post(boost::bind(&Watch::onReadable, shared_from_this(), boost::system::error_code()));
+}
+
+void ZMQPoller::Watch::stop()
+{
+  OSS::mutex_critic_sec_lock lock(_mutex);
+  if (!_isActive)
+  {
+    return;
+  }
+  _isActive = false;
+  //
+  // The descriptor belongs to ZMQ.  Take it back from asio without closing it.
+  //
+  boost::system::error_code ignored;
+  _descriptor.cancel(ignored);
+  _descriptor.release();
+}
+
+void ZMQPoller::Watch::arm()
+{
+  _descriptor.async_read_some(boost::asio::null_buffers(),
+    boost::bind(&Watch::onReadable, shared_from_this(), boost::asio::placeholders::error));
+}
+
+void ZMQPoller::Watch::onReadable(const boost::system::error_code& e)
+{
+  if (e == boost::asio::error::operation_aborted)
+  {
+    return;
+  }
+
+  if (e)
+  {
+    OSS_LOG_ERROR("ZMQPoller::Watch::onReadable - " << e.message());
+    stop();
+    return;
+  }
+
+  {
+    OSS::mutex_critic_sec_lock lock(_mutex);
+    if (!_isActive)
+    {
+      return;
+    }
+  }
+
+  _handler();
+
+  OSS::mutex_critic_sec_lock lock(_mutex);
+  if (!_isActive)
+  {
+    return;
+  }
+
+  //
+  // ZMQ_FD is edge triggered.  It will not signal again for messages that
+  // were already queued when the handler returned so those are picked up
+  // by posting instead of waiting.  Posting also gives other handlers on the
+  // io_service a turn when this socket is busy.
+  //
+  if (_socket.isReadable())
+  {
+    _ioService.post(boost::bind(&Watch::onReadable, shared_from_this(), boost::system::error_code()));
+  }
+  else
+  {
+    arm();
+  }
+}
+
+ZMQPoller::ZMQPoller(boost::asio::io_service& ioService) :
+  _ioService(ioService)
+{
+}
+
+ZMQPoller::~ZMQPoller()
+{
+  unwatchAll();
+}
+
+bool ZMQPoller::watch(ZMQSocket& socket, const ReadHandler& handler)
+{
+  int fd = socket.getDescriptor();
+  if (fd == -1)
+  {
+    return false;
+  }
+
+  OSS::mutex_critic_sec_lock lock(_watchesMutex);
+  if (_watches.find(&socket) != _watches.end())
+  {
+    return false;
+  }
+
+  Watch::Ptr watch(new Watch(_ioService, socket, fd, handler));
+  _watches[&socket] = watch;
+  watch->start();
+  return true;
+}
+
+void ZMQPoller::unwatch(ZMQSocket& socket)
+{
+  Watch::Ptr watch;
+  {
+    OSS::mutex_critic_sec_lock lock(_watchesMutex);
+    Watches::iterator iter = _watches.find(&socket);
+    if (iter == _watches.end())
+    {
+      return;
+    }
+    watch = iter->second;
+    _watches.erase(iter);
+  }
+  watch->stop();
+}
+
+void ZMQPoller::unwatchAll()
+{
+  Watches watches;
+  {
+    OSS::mutex_critic_sec_lock lock(_watchesMutex);
+    watches.swap(_watches);
+  }
+  for (Watches::iterator iter = watches.begin(); iter != watches.end(); iter++)
+  {
+    iter->second->stop();
+  }
+}
+
+
+} } // OSS::ZMQ
+
+#endif // ENABLE_FEATURE_ZMQ && OSS_HAVE_ZMQ
@@ -35,27 +35,30 @@ namespace ZMQ {
   
 zmq::context_t* ZMQSocket::_inproc_context = new zmq::context_t(1);
   
-static void zeromq_free (void *data, void *hint)
+static void zeromq_free_string (void *data, void *hint)
 {
-  free (data);
+  delete static_cast<std::string*>(hint);
 }
-//  Convert string to 0MQ string and send to socket
-static bool zeromq_send (zmq::socket_t & socket, const std::string & data)
+
+//
+// zmq keeps small messages inside zmq_msg_t itself so building them with
+// a size and copying is cheaper than handing over a malloc'ed buffer
+//
+static void zeromq_copy (zmq::message_t& message, const std::string& data)
 {
-  char * buff = (char*)malloc(data.size());
-  memcpy(buff, data.data(), data.size());
-  zmq::message_t message((void*)buff, data.size(), zeromq_free, 0);
-  bool rc = socket.send(message);
-  return (rc);
+  message.rebuild(data.size());
+  if (!data.empty())
+  {
+    memcpy(message.data(), data.data(), data.size());
+  }
 }
 
-//  Sends string as 0MQ string, as multipart non-terminal
-static bool zeromq_sendmore (zmq::socket_t & socket, const std::string & data)
+//  Convert string to 0MQ string and send to socket
+static bool zeromq_send (zmq::socket_t & socket, const std::string & data)
 {
-  char * buff = (char*)malloc(data.size());
-  memcpy(buff, data.data(), data.size());
-  zmq::message_t message((void*)buff, data.size(), zeromq_free, 0);
-  bool rc = socket.send(message, ZMQ_SNDMORE);
+  zmq::message_t message;
+  zeromq_copy(message, data);
+  bool rc = socket.send(message);
   return (rc);
 }
 
@@ -116,7 +119,19 @@ ZMQSocket::ZMQSocket(SocketType type) :
   _context(0),
   _socket(0),
   _canReconnect(false),
-  _isInproc(false)
+  _isInproc(false),
+  _isShared(true)
+{
+  _context = new zmq::context_t(1);
+}
+
+ZMQSocket::ZMQSocket(SocketType type, bool isShared) :
+  _type(type),
+  _context(0),
+  _socket(0),
+  _canReconnect(false),
+  _isInproc(false),
+  _isShared(isShared)
 {
   _context = new zmq::context_t(1);
 }
@@ -129,7 +144,7 @@ ZMQSocket::~ZMQSocket()
 
 bool ZMQSocket::bind(const std::string& bindAddress)
 {
-  OSS::mutex_critic_sec_lock lock(_mutex);
+  SocketLock lock(*this);
   
   if ( _socket || !_context)
   {
@@ -202,7 +217,7 @@ bool ZMQSocket::bind(const std::string& bindAddress)
 
 bool ZMQSocket::connect(const std::string& peerAddress)
 {
-  OSS::mutex_critic_sec_lock lock(_mutex);
+  SocketLock lock(*this);
   return internal_connect(peerAddress);
 }
 
@@ -277,7 +292,7 @@ bool ZMQSocket::internal_connect(const std::string& peerAddress)
 
 void ZMQSocket::close()
 {
-  OSS::mutex_critic_sec_lock lock(_mutex);
+  SocketLock lock(*this);
   _canReconnect = false;
   internal_close();
 }
@@ -300,7 +315,7 @@ bool ZMQSocket::sendAndReceive(const std::string& cmd, const std::string& data,
     return false;
   }
   
-  OSS::mutex_critic_sec_lock lock(_mutex);
+  SocketLock lock(*this);
   
   if (!internal_send_request(cmd, data))
   {
@@ -312,12 +327,39 @@ bool ZMQSocket::sendAndReceive(const std::string& cmd, const std::string& data,
 
 bool ZMQSocket::sendRequest(const std::string& cmd, const std::string& data)
 {
-  OSS::mutex_critic_sec_lock lock(_mutex);
+  SocketLock lock(*this);
+  return internal_send_request(cmd, data);
+}
+
+bool ZMQSocket::sendRequest(const std::string& cmd, zmq::message_t& data)
+{
+  SocketLock lock(*this);
   return internal_send_request(cmd, data);
 }
 
 bool ZMQSocket::internal_send_request(const std::string& cmd, const std::string& data)
-{  
+{
+  zmq::message_t message;
+  zeromq_copy(message, data);
+  return internal_send_request(cmd, message);
+}
+
+bool ZMQSocket::internal_send_request(const std::string& cmd, zmq::message_t& data)
+{
+  Message parts[2];
+  zeromq_copy(parts[0], cmd);
+  parts[1].move(&data);
+  return internal_send_multipart(parts, 2);
+}
+
+bool ZMQSocket::sendMultipart(Message* parts, std::size_t count)
+{
+  SocketLock lock(*this);
+  return internal_send_multipart(parts, count);
+}
+
+bool ZMQSocket::internal_send_multipart(Message* parts, std::size_t count)
+{
   //
   // reconnect the socket 
   //
@@ -330,17 +372,27 @@ bool ZMQSocket::internal_send_request(const std::string& cmd, const std::string&
     return false;
   }
   
-  if (!zeromq_sendmore(*_socket, cmd))
+  if (!_socket || !count)
   {
-    OSS_LOG_ERROR("ZMQSocket::send() - Exception: zeromq_sendmore(cmd) failed");
-    _canReconnect = true;
-    internal_close();    
     return false;
   }
   
-  if (!zeromq_send(*_socket, data))
+  try
   {
-    OSS_LOG_ERROR("ZMQSocket::send() - Exception: zeromq_send(data) failed");
+    for (std::size_t i = 0; i < count; i++)
+    {
+      if (!_socket->send(parts[i], i + 1 < count ? ZMQ_SNDMORE : 0))
+      {
+        OSS_LOG_ERROR("ZMQSocket::send() - Exception: send(part " << i << ") failed");
+        _canReconnect = true;
+        internal_close();
+        return false;
+      }
+    }
+  }
+  catch(zmq::error_t& error_)
+  {
+    OSS_LOG_ERROR("ZMQSocket::send() - ZMQ Exception: " << error_.what());
     _canReconnect = true;
     internal_close();
     return false;
@@ -351,7 +403,7 @@ bool ZMQSocket::internal_send_request(const std::string& cmd, const std::string&
 
 bool ZMQSocket::sendReply(const std::string& data)
 {
-  OSS::mutex_critic_sec_lock lock(_mutex);
+  SocketLock lock(*this);
   return internal_send_reply(data);
 }
 
@@ -373,7 +425,7 @@ bool ZMQSocket::receiveReply(std::string& data, unsigned int timeoutms)
     return false;
   }
   
-  OSS::mutex_critic_sec_lock lock(_mutex);
+  SocketLock lock(*this);
   return internal_receive_reply(data, timeoutms);
 }
 
@@ -404,7 +456,7 @@ bool ZMQSocket::receiveRequest(std::string& cmd, std::string& data, unsigned int
     return false;
   }
   
-  OSS::mutex_critic_sec_lock lock(_mutex);
+  SocketLock lock(*this);
   return internal_receive_request(cmd, data, timeoutms);
 }
 
@@ -426,6 +478,204 @@ bool ZMQSocket::internal_receive_request(std::string& cmd, std::string& data, un
   return true;
 }
 
+bool ZMQSocket::receiveRequest(std::string& cmd, zmq::message_t& data, unsigned int timeoutms)
+{
+  Message parts[2];
+  if (receiveMultipart(parts, 2, timeoutms) != 2)
+  {
+    return false;
+  }
+  cmd.assign(static_cast<const char*>(parts[0].data()), parts[0].size());
+  data.move(&parts[1]);
+  return true;
+}
+
+std::size_t ZMQSocket::receiveMultipart(Message* parts, std::size_t maxParts, unsigned int timeoutms)
+{
+  if (_type == PUSH)
+  {
+    return 0;
+  }
+  
+  SocketLock lock(*this);
+  if (!_socket)
+  {
+    return 0;
+  }
+  
+  if (timeoutms && !zeromq_poll_read(_socket, timeoutms))
+  {
+    return 0;
+  }
+  
+  return internal_receive_multipart(parts, maxParts, 0);
+}
+
+std::size_t ZMQSocket::internal_receive_multipart(Message* parts, std::size_t maxParts, int flags)
+{
+  std::size_t count = 0;
+  Message discard;
+  try
+  {
+    for (;;)
+    {
+      Message* part = count < maxParts ? &parts[count] : &discard;
+      if (!_socket->recv(part, flags))
+      {
+        //
+        // Only the first frame can fail with EAGAIN.  The rest of a
+        // multipart message is delivered atomically.
+        //
+        return 0;
+      }
+      
+      if (count < maxParts)
+      {
+        count++;
+      }
+      
+#if ZMQ_VERSION_MAJOR < 3
+      int64_t more = 0;
+#else
+      int more = 0;
+#endif
+      size_t moreSize = sizeof(more);
+      _socket->getsockopt(ZMQ_RCVMORE, &more, &moreSize);
+      if (!more)
+      {
+        break;
+      }
+      flags = 0;
+    }
+  }
+  catch(zmq::error_t& error_)
+  {
+    OSS_LOG_ERROR("ZMQSocket::receive() - ZMQ Exception: " << error_.what());
+    return 0;
+  }
+  return count;
+}
+
+bool ZMQSocket::tryReceiveRequest(Message& cmd, Message& data)
+{
+  if (_type == PUSH)
+  {
+    return false;
+  }
+  
+  SocketLock lock(*this);
+  if (!_socket)
+  {
+    return false;
+  }
+  
+  Message parts[2];
+  if (internal_receive_multipart(parts, 2, ZMQ_DONTWAIT) != 2)
+  {
+    return false;
+  }
+  cmd.move(&parts[0]);
+  data.move(&parts[1]);
+  return true;
+}
+
+std::size_t ZMQSocket::receiveRequests(const RequestHandler& handler, std::size_t maxCount)
+{
+  if (_type == PUSH)
+  {
+    return 0;
+  }
+  
+  SocketLock lock(*this);
+  if (!_socket)
+  {
+    return 0;
+  }
+  
+  std::size_t count = 0;
+  Message parts[2];
+  while (count < maxCount)
+  {
+    std::size_t frames = internal_receive_multipart(parts, 2, ZMQ_DONTWAIT);
+    if (!frames)
+    {
+      break;
+    }
+    count++;
+    if (frames == 2)
+    {
+      handler(parts[0], parts[1]);
+    }
+  }
+  return count;
+}
+
+int ZMQSocket::getDescriptor()
+{
+  SocketLock lock(*this);
+  if (!_socket)
+  {
+    return -1;
+  }
+#ifdef _WIN32
+  SOCKET fd = 0;
+#else
+  int fd = -1;
+#endif
+  size_t fdSize = sizeof(fd);
+  try
+  {
+    _socket->getsockopt(ZMQ_FD, &fd, &fdSize);
+  }
+  catch(zmq::error_t& error_)
+  {
+    OSS_LOG_ERROR("ZMQSocket::getDescriptor() - ZMQ Exception: " << error_.what());
+    return -1;
+  }
+  return (int)fd;
+}
+
+bool ZMQSocket::isReadable()
+{
+  SocketLock lock(*this);
+  if (!_socket)
+  {
+    return false;
+  }
+#if ZMQ_VERSION_MAJOR < 3
+  uint32_t events = 0;
+#else
+  int events = 0;
+#endif
+  size_t eventsSize = sizeof(events);
+  try
+  {
+    _socket->getsockopt(ZMQ_EVENTS, &events, &eventsSize);
+  }
+  catch(zmq::error_t& error_)
+  {
+    return false;
+  }
+  return (events & ZMQ_POLLIN) != 0;
+}
+
+void ZMQSocket::moveToMessage(std::string& data, Message& message)
+{
+  if (data.empty())
+  {
+    //
+    // Nothing to hand over.  Not every libzmq calls the free function for
+    // a zero sized buffer, so do not allocate an owner that could leak.
+    //
+    message.rebuild((size_t)0);
+    return;
+  }
+
+  std::string* owned = new std::string();
+  owned->swap(data);
+  message.rebuild(&(*owned)[0], owned->size(), zeromq_free_string, owned);
+}
+
 int ZMQSocket::poll(ZMQSocket::PollItems& pollItems, long timeoutms)
 {
   zmq::pollitem_t* items = pollItems.data();